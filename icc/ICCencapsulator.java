@@ -438,17 +438,32 @@ class PrependWords {
 		prependwords.add("ECDH_METHOD");
 		prependwords.add("ASN1_OBJECT");
 		prependwords.add("X509_ALGOR");
+		prependwords.add("ECDSA_POOL");
 		prependwords.add("ECDSA_SIG");
 		prependwords.add("EC_METHOD");
 		prependwords.add("EC_POINT");
 		prependwords.add("EC_GROUP");
+		prependwords.add("SP800_38F");
 		prependwords.add("PRNG_CTX");
+		prependwords.add("TLS_PRF");
+		prependwords.add("XOF_CTX");
+		prependwords.add("PHASH_CTX");
+		prependwords.add("KMAC_KEY");
+		prependwords.add("AES_IOV");
 		prependwords.add("AES_GCM");
+		prependwords.add("AES_CCM");
+		prependwords.add("AES_XTS");
+		prependwords.add("CHACHA_POLY");
+		prependwords.add("BATCH_OP");
+		prependwords.add("PKEY_JOB");
+		prependwords.add("DIGEST_REC");
 		prependwords.add("DSA_SIG");
 		prependwords.add("EC_KEY");
 		prependwords.add("BIGNUM");
+		prependwords.add("PBKDF2");
 		prependwords.add("PRNG");
 		prependwords.add("CMAC");
+		prependwords.add("HKDF");
 		prependwords.add("HMAC");
 		prependwords.add("KDF");
 		prependwords.add("DES");
@@ -694,6 +709,8 @@ class FileType {
 		// are swapped due to an error in another thread
 		writer.write("\t\t" + func.typedefname + " tempf = (" + func.typedefname + ")(*(pcb->funcs))["
 				+ ICCencapsulator.funcnum + "].func;\n");
+		// a dummy in the base class, but overridden is derived classes.
+		writeAnyCodeBeforeCall(func);
 
 		// Write code for conditional tests executed before we call the function
 		func.WriteBodyPreamble(writer, requiresicclibpcb && func.usespcb, func.genGlobal(this), genEnum(func.name));
@@ -727,6 +744,16 @@ class FileType {
 		writeAnyExtraFunction(func);
 	}
 
+    /**
+     * @brief Do any extra processing before the indirect function call,
+     * the output follows the declaration of tempf
+     * This is overridden in derived classes needing to do this
+     * @param func the function being processed 
+     */
+    public void writeAnyCodeBeforeCall(ICCFunction func) throws Exception
+    {
+
+    }
     /**
      * @brief Do any extra processing after the indirect function call
      * This is overridden in derived classes needing to do this
@@ -1017,8 +1044,8 @@ class File_ICC_A_C extends FileType
     public void Body(ICCFunction func) throws Exception
     {
 	prefix = ICCencapsulator.ICCPrefix;
-	// Suppress ICC_SetValue manually.
-	if(func.name.equals("SetValue") ) {
+	// Suppress ICC_SetValue and ICC_GetValue manually.
+	if(func.name.equals("SetValue") || func.name.equals("GetValue")) {
 	    func.WriteTypedef(writer,passesiccpcb || passesicclibpcb);
 	} else {
 	    super.Body(func);
@@ -1044,6 +1071,42 @@ class File_ICC_A_C extends FileType
     {
     }
 
+    /**
+     * @brief Start the per API timer, see api_stats.c
+     * @param func the function being processed 
+     */
+    public void writeAnyCodeBeforeCall(ICCFunction func) throws Exception
+    {
+	writer.write("\t\tICC_API_START(api_t0);\n");
+    }
+    /**
+     * @brief Count the call, see api_stats.c
+     * @param func the function being processed 
+     */
+    public void writeAnyExtraCodeInFunction(ICCFunction func) throws Exception
+    {
+	writer.write("\t\t\tICC_API_STOP(" + ICCencapsulator.funcnum + ",api_t0);\n");
+    }
+
+    /**
+     * @brief For 'D' functions also write ICC_func_direct()
+     * which hands back the current call table entry
+     * @param func the function being processed 
+     */
+    public void writeAnyExtraFunction(ICCFunction func) throws Exception
+    {
+	if (func.direct) {
+	    writer.write(func.directTypedefName() + " ICC_LINKAGE " + prefix + func.name + "_direct(" + pcbtype + ")\n{\n");
+	    writer.write("\t" + func.directTypedefName() + " rv = NULL;\n");
+	    writer.write("\tif ((NULL != pcb) && (NULL != pcb->funcs)) {\n");
+	    writer.write("\t\trv = (" + func.directTypedefName() + ")(*(pcb->funcs))["
+			 + ICCencapsulator.funcnum + "].func;\n");
+	    writer.write("\t}\n");
+	    writer.write("\treturn rv;\n");
+	    writer.write("}\n\n");
+	}
+    }
+
 
   /**
      * Generates the static header definition for the global/per-process ICCLib data
@@ -1097,9 +1160,36 @@ class File_ICC_A_H extends FileType {
 
 		if(! func.javaonly) {
 			emitHeader(func);
+			if (func.direct) {
+				emitDirectHeader(func);
+			}
 		}	
 	}
 
+	/**
+	 * @brief The public type and resolver for a 'D' function
+	 * @param func the function being processed
+	 */
+	public void emitDirectHeader(ICCFunction func) throws Exception {
+		writer.write("/*! @brief the type returned by ICC_" + func.name + "_direct() */\n");
+		func.WriteTypedef(writer, func.directTypedefName(), false);
+		writer.write("\n");
+		if (ICCencapsulator.ICCPrefix != "") {
+			writer.write("/*! \\sa " + ICCencapsulator.ICCPrefix + func.name + "_direct*/\n");
+			writer.write("#define ICC_" + func.name + "_direct " + ICCencapsulator.ICCPrefix + func.name
+					+ "_direct\n");
+		}
+		writer.write("/*! @brief Resolve ICC_" + func.name + "() once for a hot loop\n"
+				+ " *  @param pcb ICC context pointer\n"
+				+ " *  @return the function, called with the same arguments as ICC_" + func.name
+				+ "() but without the ICC context, or NULL\n"
+				+ " *  @note The pointer is only valid until ICC_Cleanup() on this context.\n"
+				+ " *  It skips the per call table lookup, use it for bulk data calls\n"
+				+ " */\n");
+		writer.write(func.directTypedefName() + " ICC_LINKAGE " + prefix + func.name + "_direct(" + pcbtype
+				+ ");\n\n");
+	}
+
 	public void Postamble() throws Exception {
 
 		writeExtraHeaderStuff(true);
@@ -1950,6 +2040,12 @@ class ICCFunction
 	 // 'C' tag in functions.txt, this function supports the FIPS callback function. Doc only for the code generator
 	 //     Note: This usually requires the M tag to trap the function
 	 public boolean FIPS_callback = false;
+	 // 'D' tag in functions.txt, hot path function, also generate ICC_func_direct() in the step library
+	 //     which returns the current table entry so the caller can resolve it once and call it directly
+	 public boolean direct = false;
+	 // 'D' tag in functions.txt, hot path function, also generate ICC_func_direct() in the step library
+	 //     which returns the current table entry so the caller can resolve it once and call it directly
+	 public boolean direct = false;
 
     public String comment = ""; // comment text for this function
     public boolean current = false; // instantiated in current functions.txt
@@ -1957,6 +2053,39 @@ class ICCFunction
 
     private String modifyerstring = ""; 
 
+    // Name fragments the error state table in icclib.c (ICCGlobal_Error) disables.
+    // A pointer resolved via a 'D' entry point is held by the caller and won't see
+    // that table swapped in, so these can't be direct bound.
+    // Keep in sync with the list in icclib.c
+    static final String NoDirect [] = {
+	"_new", "generate", "Generate", "Init", "get_", "RAND_",
+	"DES_random_key", "AES_CCM_Encrypt", "AES_CCM_Decrypt", "SP800_38F_KW"
+    };
+
+    // Drop the 'D' tag from functions where a cached pointer isn't safe
+    void CheckDirect()
+    {
+	if (usespcb) {
+	    System.out.println("Warning. "+ name + ": 'D' can't be used with 'P', ignored\n");
+	    direct = false;
+	    return;
+	}
+	for (String x : NoDirect) {
+	    if (name.indexOf(x) != -1) {
+		System.out.println("Warning. "+ name + ": is disabled in the error state\n"+
+				   "it can't be direct bound, 'D' ignored\n");
+		direct = false;
+		return;
+	    }
+	}
+    }
+
+    // Name of the public type for a 'D' entry point
+    public String directTypedefName()
+    {
+	return "ICC_" + name + "_fn";
+    }
+
     public void dump()
     {
 	System.out.println(returntype + " "+name+"\n"+
@@ -2009,6 +2138,14 @@ class ICCFunction
 	//
 	if (modifyerstring.indexOf('C') != -1) FIPS_callback = true;
 
+	// D Direct bound entry point also generated
+	//
+	if (modifyerstring.indexOf('D') != -1) direct = true;
+
+	// D Direct bound entry point also generated
+	//
+	if (modifyerstring.indexOf('D') != -1) direct = true;
+
 	s = s.substring(s.indexOf(' '),s.length()).trim();
 
 
@@ -2027,6 +2164,9 @@ class ICCFunction
 	}
 	// Just a prefix that won't conflict with real function names we use 
         typedefname = "fptr_" + name;
+	if (direct) {
+	    CheckDirect();
+	}
 
 	//type of argument
 	argumenttypes = new String[20];
@@ -2360,7 +2500,11 @@ class ICCFunction
     // Write a typedef prototype for an indirect call
     public void WriteTypedef(FileWriter writer,boolean haspcb) throws Exception
     {
-	writer.write("typedef " + returntype + " (*" + typedefname + ")(");
+	WriteTypedef(writer,typedefname,haspcb);
+    }
+    public void WriteTypedef(FileWriter writer,String tname,boolean haspcb) throws Exception
+    {
+	writer.write("typedef " + returntype + " (*" + tname + ")(");
 	if (haspcb) writer.write("void *pcb");
 	for (int i = 0; i < numarguments;i++) {
 	    if (! argumentnames[i].equals("void")) {
@@ -58,8 +58,9 @@ typedef enum {
   ICC_MUTEX_ERROR                 = 13, /*!< We expected a mutex to be set and it wasn't */
   ICC_UNABLE_TO_SET               = 14, /*!< ICC cannot set a value */
   ICC_NOT_ENOUGH_MEMORY           = 15, /*!< malloc() failed */
-  ICC_ALREADY_ATTACHED            = 16  /*!< ICC_Attach called, but this call 
+  ICC_ALREADY_ATTACHED            = 16, /*!< ICC_Attach called, but this call 
                                           has already been made */
+  ICC_WOULD_BLOCK                 = 17  /*!< A non-blocking call couldn't complete without waiting, retry */
 } ICC_MINOR_RC_ENUM ;
 
 /*! @brief 
@@ -12,9 +12,48 @@
   keep the future in mind here
 */
 #include <stdio.h>
+#include <string.h>
 #include "../icc/icc_cdefs.h"
+#include "../icc/cpufeat.h"
 
 extern int OPENSSL_cpuid(unsigned long long *id);
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_AMD64) || defined(_M_IX86)
+#define CPUF_X86 1
+extern unsigned int OPENSSL_ia32cap_P[4];
+#elif defined(__aarch64__)
+#define CPUF_ARM 1
+extern unsigned int OPENSSL_armcap_P;
+/* Constants from arm_arch.h */
+#define ARMV7_NEON      (1 << 0)
+#define ARMV8_AES       (1 << 2)
+#define ARMV8_SHA256    (1 << 4)
+#define ARMV8_PMULL     (1 << 5)
+#define ARMV8_SHA512    (1 << 6)
+#elif defined(__powerpc__) || defined(__powerpc64__) || defined(_ARCH_PPC)
+#define CPUF_PPC 1
+extern unsigned int OPENSSL_ppccap_P;
+/* Constants from ppc_arch.h */
+#define PPC_ALTIVEC     (1 << 1)
+#define PPC_CRYPTO207   (1 << 2)
+#endif
+
+#if defined(__linux__) && (defined(CPUF_ARM) || defined(CPUF_PPC))
+#include <sys/auxv.h>
+#define CPUF_AUXV 1
+#if !defined(HWCAP_SHA3)
+#define HWCAP_SHA3 (1 << 17)
+#endif
+#if !defined(HWCAP2_RNG)
+#define HWCAP2_RNG (1 << 16)
+#endif
+#if !defined(PPC_FEATURE_HAS_VSX)
+#define PPC_FEATURE_HAS_VSX 0x00000080
+#endif
+#if !defined(PPC_FEATURE2_ARCH_3_00)
+#define PPC_FEATURE2_ARCH_3_00 0x00800000
+#endif
+#endif
 /* Won't compile on z/OS */
 #if defined(__s390__) || defined(__MVS__)
 /* Constants from s390x_arch.h */
@@ -213,27 +252,165 @@ static FUNC flist[6] = {
   };
 #endif
 
+static unsigned int cpu_features = 0;
+static int cpu_features_set = 0;
+
+static const struct {
+  unsigned int bit;
+  const char *name;
+} cpu_feature_names[] = {
+  {ICC_CPUF_AESNI,"aesni"},
+  {ICC_CPUF_PCLMUL,"pclmul"},
+  {ICC_CPUF_VAES,"vaes"},
+  {ICC_CPUF_VPCLMUL,"vpclmul"},
+  {ICC_CPUF_SHANI,"sha-ni"},
+  {ICC_CPUF_AVX2,"avx2"},
+  {ICC_CPUF_AVX512,"avx512"},
+  {ICC_CPUF_RDSEED,"rdseed"},
+  {ICC_CPUF_NEON,"neon"},
+  {ICC_CPUF_ARMAES,"aes"},
+  {ICC_CPUF_PMULL,"pmull"},
+  {ICC_CPUF_ARMSHA2,"sha2"},
+  {ICC_CPUF_ARMSHA512,"sha512"},
+  {ICC_CPUF_ARMSHA3,"sha3"},
+  {ICC_CPUF_RNDR,"rndr"},
+  {ICC_CPUF_VSX,"vsx"},
+  {ICC_CPUF_VCRYPTO,"vcrypto"},
+  {ICC_CPUF_DARN,"darn"},
+  {ICC_CPUF_CPACF_AES,"cpacf-aes"},
+  {ICC_CPUF_CPACF_KMA,"cpacf-kma"},
+  {ICC_CPUF_CPACF_GHASH,"cpacf-ghash"},
+  {ICC_CPUF_CPACF_SHA3,"cpacf-sha3"},
+  {ICC_CPUF_CPACF_TRNG,"cpacf-trng"},
+  {0,NULL}
+};
+
+/*! @brief Probe the CPU features the accelerated paths use and cache them.
+    Called from ICCLoad() once OpenSSL's capability probe has run and 
+    ICC_CAP_MASK has been applied.
+    @note The OpenSSL capability vectors are used where they 
+    have the bit, so masking there also turns off our fast paths
+*/
+void OS_CpuFeaturesInit(void)
+{
+  unsigned int f = 0;
+#if defined(CPUF_X86)
+  const unsigned int *p = OPENSSL_ia32cap_P;
+
+  if(p[1] & (1U << 25)) f |= ICC_CPUF_AESNI;
+  if(p[1] & (1U << 1))  f |= ICC_CPUF_PCLMUL;
+  /* OpenSSL has already cleared these if the OS doesn't save ymm/zmm state */
+  if(p[2] & (1U << 5))  f |= ICC_CPUF_AVX2;
+  if(p[2] & (1U << 16)) f |= ICC_CPUF_AVX512;
+  if(p[2] & (1U << 29)) f |= ICC_CPUF_SHANI;
+  if(p[2] & (1U << 18)) f |= ICC_CPUF_RDSEED;
+  /* 256 bit forms, useless without AVX2 */
+  if(f & ICC_CPUF_AVX2) {
+    if((p[3] & (1U << 9)) && (f & ICC_CPUF_AESNI))   f |= ICC_CPUF_VAES;
+    if((p[3] & (1U << 10)) && (f & ICC_CPUF_PCLMUL)) f |= ICC_CPUF_VPCLMUL;
+  }
+#elif defined(CPUF_ARM)
+  if(OPENSSL_armcap_P & ARMV7_NEON)   f |= ICC_CPUF_NEON;
+  if(OPENSSL_armcap_P & ARMV8_AES)    f |= ICC_CPUF_ARMAES;
+  if(OPENSSL_armcap_P & ARMV8_PMULL)  f |= ICC_CPUF_PMULL;
+  if(OPENSSL_armcap_P & ARMV8_SHA256) f |= ICC_CPUF_ARMSHA2;
+  if(OPENSSL_armcap_P & ARMV8_SHA512) f |= ICC_CPUF_ARMSHA512;
+#if defined(CPUF_AUXV)
+  /* OpenSSL 1.1.1 has no bits for these */
+  if(getauxval(AT_HWCAP) & HWCAP_SHA3)   f |= ICC_CPUF_ARMSHA3;
+  if(getauxval(AT_HWCAP2) & HWCAP2_RNG)  f |= ICC_CPUF_RNDR;
+#endif
+#elif defined(CPUF_PPC)
+  /* vcipher/vpmsum are ISA 2.07 which implies VSX */
+  if(OPENSSL_ppccap_P & PPC_CRYPTO207) f |= ICC_CPUF_VCRYPTO | ICC_CPUF_VSX;
+#if defined(CPUF_AUXV)
+  if((OPENSSL_ppccap_P & PPC_ALTIVEC) && (getauxval(AT_HWCAP) & PPC_FEATURE_HAS_VSX)) {
+    f |= ICC_CPUF_VSX;
+  }
+  if(getauxval(AT_HWCAP2) & PPC_FEATURE2_ARCH_3_00) f |= ICC_CPUF_DARN;
+#endif
+#elif defined(__s390__) || defined(__MVS__)
+  {
+    unsigned long long cap = 0LL;
+    const unsigned long long all_aes = I_S390X_AES_128 | I_S390X_AES_192 | I_S390X_AES_256;
+    const unsigned long long all_sha3 = I_S390X_SHA3_224 | I_S390X_SHA3_256 | 
+                                        I_S390X_SHA3_384 | I_S390X_SHA3_512;
+
+    OPENSSL_cpuid(&cap);
+    /* The helper functions can do any key size, so insist on all of them */
+    if((cap & all_aes) == all_aes) {
+      f |= ICC_CPUF_CPACF_AES;
+      if(cap & I_S390X_KMA_GCM) f |= ICC_CPUF_CPACF_KMA;
+    }
+    if(cap & I_S390X_GHASH)           f |= ICC_CPUF_CPACF_GHASH;
+    if((cap & all_sha3) == all_sha3)  f |= ICC_CPUF_CPACF_SHA3;
+    if(cap & I_S390X_TRNG)            f |= ICC_CPUF_CPACF_TRNG;
+  }
+#endif
+  cpu_features = f;
+  cpu_features_set = 1;
+}
+
+/*! @brief The cached CPU feature bits, ICC_CPUF_*
+    @return the features, probed now if ICCLoad() hasn't yet
+*/
+unsigned int OS_CpuFeatures(void)
+{
+  if(!cpu_features_set) {
+    OS_CpuFeaturesInit();
+  }
+  return cpu_features;
+}
+
+/*! @brief The cached CPU features as a ' ' separated list of names
+    @param buf output, may be NULL if len is 0
+    @param len size of buf
+    @return the length of the full list, excluding the trailing '\0'.
+    The list is truncated if that's len or more.
+*/
+int OS_CpuFeatureNames(char *buf, int len)
+{
+  unsigned int f = OS_CpuFeatures();
+  int n = 0;
+  int w = 0;
+  int k = 0;
+  int i = 0;
+
+  if(len > 0) {
+    buf[0] = '\0';
+  }
+  for(i = 0; NULL != cpu_feature_names[i].name; i++) {
+    if(f & cpu_feature_names[i].bit) {
+      k = (int)strlen(cpu_feature_names[i].name) + ((n > 0) ? 1 : 0);
+      if((w == n) && (n + k < len)) { /* Whole names only */
+        sprintf(buf + n,"%s%s",(n > 0) ? " " : "",cpu_feature_names[i].name);
+        w = n + k;
+      }
+      n += k;
+    }
+  }
+  return n;
+}
+
 const FUNC *  OS_helpers() 
 {
 /* Now do the capabilities check and switch off anything 
    that won't be there
    */
 #if defined(__s390__) || defined(__MVS__)
-#define ALL_AES (I_S390X_AES_128 | I_S390X_AES_192 | I_S390X_AES_256 )
+  unsigned int f = OS_CpuFeatures();
 
-  unsigned long long cap = 0LL;
-  /* Add probe code and if GCM capability is missing, set ptr to NULL
-     Note that we insist that all of 128/192/256 are present as the functions
+  /* If a capability is missing, set ptr to NULL
+     Note that ICC_CPUF_CPACF_AES needs all of 128/192/256 as the functions
      provided can do any of these.
    */
-  OPENSSL_cpuid(&cap);
-  if(!((cap & I_S390X_KMA_GCM) && ((cap & ALL_AES) == ALL_AES))) {
+  if(!(f & ICC_CPUF_CPACF_KMA)) {
     flist[S390_GCM].func = NULL;
   }
-  if(!(cap & I_S390X_GHASH)) {
+  if(!(f & ICC_CPUF_CPACF_GHASH)) {
     flist[S390_GHASH].func = NULL;
   }
-  if( ! ((cap & ALL_AES) == ALL_AES) ) {
+  if(!(f & ICC_CPUF_CPACF_AES)) {
     flist[S390_CBC].func = NULL;
     flist[S390_ECB].func = NULL;
   }
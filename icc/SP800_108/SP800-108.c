@@ -167,73 +167,316 @@ static unsigned char kabuf[1024];
 #endif
 
 
-/*! @brief 
-  HMAC CTR KDF
-  @param x the HMAC message digest
+/*! @brief
+  A keyed PRF, HMAC or CMAC. Keyed once, then restarted for each 
+  PRF call so the key schedule (HMAC pads, CMAC subkeys) is reused
+*/
+typedef struct {
+  KDF_MODE mode;       /*!< CMAC or HMAC ? */
+  HMAC_CTX *hctx;      /*!< HMAC state, IS_HMAC */
+  CMAC_CTX *cctx;      /*!< CMAC state, IS_CMAC */
+  unsigned int size;   /*!< PRF output size */
+} KDF_PRF;
+
+/*! @brief Set up and key a PRF
+  @param p the PRF  
+  @param mode HMAC or CMAC
+  @param x the message digest or cipher
   @param Ki the input key
-  @param Kilen the length of the input key
+  @param Kilen the length of the input key, must match the cipher for CMAC
+  @return 1 on success, -1 on failure (invalid input)
+*/
+static int prf_new(KDF_PRF *p,KDF_MODE mode,void *x,
+		   unsigned char *Ki,unsigned int Kilen)
+{
+  int rv = -1;
+
+  memset(p,0,sizeof(KDF_PRF));
+  p->mode = mode;
+  if(NULL != x) {
+    if(IS_HMAC == mode) {
+      p->size = EVP_MD_size((const EVP_MD *)x);
+      p->hctx = HMAC_CTX_new();
+      if((NULL != p->hctx) && 
+	 (1 == my_HMAC_Init(p->hctx,Ki,Kilen,(const EVP_MD *)x))) {
+	rv = 1;
+      }
+    } else if(Kilen == (unsigned int)EVP_CIPHER_key_length((const EVP_CIPHER *)x)) {
+      p->size = EVP_CIPHER_block_size((const EVP_CIPHER *)x);
+      p->cctx = CMAC_CTX_new();
+      if((NULL != p->cctx) && 
+	 (1 == my_CMAC_Init(p->cctx,(const EVP_CIPHER *)x,Ki,Kilen))) {
+	rv = 1;
+      }
+    }
+  }
+  if(p->size > 64) { /* Larger than any buffer below */
+    rv = -1;
+  }
+  return rv;
+}
+/*! @brief Release a PRF, clears the key material
+  @param p the PRF  
+*/
+static void prf_free(KDF_PRF *p)
+{
+  if(NULL != p->hctx) {
+    HMAC_CTX_free(p->hctx);
+  }
+  if(NULL != p->cctx) {
+    CMAC_CTX_free(p->cctx);
+  }
+  memset(p,0,sizeof(KDF_PRF));
+}
+/*! @brief Restart a keyed PRF for a new PRF call
+  @param p the PRF  
+*/
+static void prf_start(KDF_PRF *p)
+{
+  if(IS_HMAC == p->mode) {
+    my_HMAC_Init(p->hctx,NULL,0,NULL);
+  } else {
+    my_CMAC_Init(p->cctx,NULL,NULL,0);
+  }
+}
+/*! @brief Feed data to the PRF
+  @param p the PRF  
+  @param data the data
+  @param len the length of the data
+*/
+static void prf_update(KDF_PRF *p,const unsigned char *data,unsigned int len)
+{
+  if(IS_HMAC == p->mode) {
+    HMAC_Update(p->hctx,data,len);
+  } else {
+    CMAC_Update(p->cctx,data,len);
+  }
+}
+/*! @brief Finish a PRF call
+  @param p the PRF  
+  @param out p->size bytes of output
+*/
+static void prf_final(KDF_PRF *p,unsigned char *out)
+{
+  unsigned int len = 0;
+
+  if(IS_HMAC == p->mode) {
+    HMAC_Final(p->hctx,out,&len);
+  } else {
+    my_CMAC_Final(p->cctx,out,p->size);
+  }
+}
+/*! @brief The fixed input data common to all modes
+   Label || 0x00 || Context || [L]
+*/
+static void prf_fixed(KDF_PRF *p,
+		      unsigned char *Label, unsigned int Llen,
+		      unsigned char *Context, unsigned int Clen,
+		      unsigned char LA[4])
+{
+  prf_update(p,Label,Llen);
+  prf_update(p,C00,1);
+  prf_update(p,Context,Clen);
+  prf_update(p,LA,4);
+}
+
+/*! @brief 
+  Counter mode KDF on a keyed PRF
+  @param p a keyed PRF
   @param Label nonce data, usually protocol dependent
   @param Llen length of the Label data
   @param Context Nonce Shared information between two parties
   @param Clen length of the Context data
   @param K0 a buffer to hold the generated key
   @param L the length of the generated key => in bits <=
-  @return 1 on success, 0 on failure, -1 "something bad happened"
-  (invalid input, invalid md_ctx etc)
+  @return 1 on success
 */
-int KDF_CTR_HMAC( void *x,
-		  unsigned char *Ki,unsigned int Kilen,
+static int kdf_ctr(KDF_PRF *p,
+		   unsigned char *Label, unsigned int Llen,
+		   unsigned char *Context, unsigned int Clen,
+		   unsigned char *K0,unsigned int L)
+{
+  unsigned long i = 1;
+  unsigned long j = 0;
+  unsigned char IA[4];
+  unsigned char LA[4];
+  unsigned char tmp[64]; /* the largest possible MAC using SHA512 */
+  unsigned int bytes = L;
+
+  uint2BS(L*8,LA);  
+  /* K(i) = PRF(K,[i] || Label || 0x00 || Context || [L]), the blocks 
+     don't depend on each other so they are run back to back on the one
+     keyed PRF, full blocks straight into K0, only the tail via tmp
+  */
+  while( bytes > 0 ) {      
+    uint2BS(i,IA);
+    prf_start(p);
+    prf_update(p,IA,4);
+    prf_fixed(p,Label,Llen,Context,Clen,LA);
+    if(bytes >= p->size) {
+      prf_final(p,K0);
+      j = p->size;
+    } else {
+      prf_final(p,tmp);
+      j = bytes;
+      memcpy(K0,tmp,j);
+    }
+    K0 += j;
+    bytes -= j;  
+    i++;
+  }
+  OPENSSL_cleanse(tmp,sizeof(tmp));
+  return 1;
+}
+/*! @brief 
+  Feedback mode KDF on a keyed PRF
+  @param p a keyed PRF
+  @param Label nonce data, usually protocol dependent
+  @param Llen length of the Label data
+  @param Context Nonce Shared information between two parties
+  @param Clen length of the Context data
+  @param K0 a buffer to hold the generated key
+  @param L the length of the generated key => in bits <=
+  @return 1 on success
+*/
+static int kdf_fb(KDF_PRF *p,
 		  unsigned char *Label, unsigned int Llen,
 		  unsigned char *Context, unsigned int Clen,
-		  unsigned char *K0,unsigned int L
-		 )
+		  unsigned char *K0,unsigned int L)
 {
-  const EVP_MD *md = (const EVP_MD *)x;
-  int rv = 1;
-  long n = 0;
   unsigned long i = 1;
-  unsigned long j = 0; 
-  HMAC_CTX *hctx = NULL;
+  unsigned long j = 0;
   unsigned char IA[4];
   unsigned char LA[4];
-  unsigned int len = 0;
-  unsigned int md_size = 0;
   unsigned char tmp[64]; /* the largest possible MAC using SHA512 */
   unsigned int bytes = L;
 
-  md_size = EVP_MD_size(md); 
-  n = L/md_size;
+  uint2BS(L*8,LA);
+  memset(tmp,0,sizeof(tmp));
+  while(bytes > 0) {      
+    uint2BS(i,IA);
+    /* K(i) = PRF(K,K(i-1) || [i] || Label || 0x00 || Context || [L] */
+    prf_start(p);
+    prf_update(p,tmp,p->size);
+    prf_update(p,IA,4);
+    prf_fixed(p,Label,Llen,Context,Clen,LA);
+    prf_final(p,tmp);
+    j = (bytes > p->size) ? p->size : bytes;
+    memcpy(K0,tmp,j);
+    K0 += p->size;
+    bytes -= j;
+    i++;
+  }
+  OPENSSL_cleanse(tmp,sizeof(tmp));
+  return 1;
+}
+/*! @brief 
+  Double pipeline mode KDF on a keyed PRF
+  @param p a keyed PRF
+  @param Label nonce data, usually protocol dependent
+  @param Llen length of the Label data
+  @param Context Nonce Shared information between two parties
+  @param Clen length of the Context data
+  @param K0 a buffer to hold the generated key
+  @param L the length of the generated key => in bits <=
+  @return 1 on success
+*/
+static int kdf_dp(KDF_PRF *p,
+		  unsigned char *Label, unsigned int Llen,
+		  unsigned char *Context, unsigned int Clen,
+		  unsigned char *K0,unsigned int L)
+{
+  unsigned long i = 1;
+  unsigned long j = 0;
+  unsigned char IA[4];
+  unsigned char LA[4];
+  unsigned char tmp[64]; /* the largest possible MAC using SHA512 */
+  unsigned char tmpA[64];
+  unsigned int bytes = L;
 
-  uint2BS(L*8,LA);  
-  if(n <= 0xffffffffL && md != NULL) {
-    hctx = HMAC_CTX_new();
-    if(NULL != hctx) {
-      uint2BS(i,IA);
-      while( bytes > 0 ) {      
-	my_HMAC_Init(hctx,Ki,Kilen,md);
-	HMAC_Update(hctx,IA,4);
-	HMAC_Update(hctx,Label,Llen);
-	HMAC_Update(hctx,C00,1);
-	HMAC_Update(hctx,Context,Clen);
-	HMAC_Update(hctx,LA,4);
-	HMAC_Final(hctx,tmp,&len);
-	HMAC_CTX_cleanup(hctx);
-	j = (bytes > md_size) ? md_size : bytes;
-	memcpy(K0,tmp,j);
-	K0 += md_size;
-	bytes -= j;  
-	i++;
-      }
-      HMAC_CTX_free(hctx);
-    } else {
-      rv = -1;
+  uint2BS(L*8,LA);
+  memset(tmp,0,sizeof(tmp));
+  memset(tmpA,0,sizeof(tmpA));
+  while( bytes > 0 ) {  
+    uint2BS(i,IA); 
+    prf_start(p);
+    if(i == 1) { /* A(0) = Label || 0x00 || Context || [L] */
+      prf_fixed(p,Label,Llen,Context,Clen,LA);
+    } else { /* A(i) = PRF(Ki,A(i-1) */
+      prf_update(p,tmpA,p->size);
     }
-  } else {
-    rv = -1;
+    prf_final(p,tmpA);
+    /* K(i) = PRF(K,A(i) || [i] || Label || 0x00 || Context || [L] */
+    prf_start(p);
+    prf_update(p,tmpA,p->size);
+    prf_update(p,IA,4);
+    prf_fixed(p,Label,Llen,Context,Clen,LA);
+    prf_final(p,tmp);
+
+    j = (bytes > p->size) ? p->size : bytes;
+    memcpy(K0,tmp,j);
+    K0 += p->size;
+    bytes -= j;    
+    i++;
   }
+  OPENSSL_cleanse(tmp,sizeof(tmp));
+  OPENSSL_cleanse(tmpA,sizeof(tmpA));
+  return 1;
+}
+
+/*! @brief
+  The mode body used for a one shot KDF call
+*/
+typedef int (*KDF_Body)(KDF_PRF *p,
+			unsigned char *Label, unsigned int Llen,
+			unsigned char *Context, unsigned int Clen,
+			unsigned char *K0,unsigned int L);
+
+/*! @brief
+  Key a PRF, run one derivation and release the PRF
+  @return 1 on success, -1 "something bad happened"
+  (invalid input, invalid md/cipher etc)
+*/
+static int kdf_once(KDF_Body body,KDF_MODE mode,void *x,
+		    unsigned char *Ki,unsigned int Kilen,
+		    unsigned char *Label, unsigned int Llen,
+		    unsigned char *Context, unsigned int Clen,
+		    unsigned char *K0,unsigned int L)
+{
+  KDF_PRF p;
+  int rv = -1;
 
+  rv = prf_new(&p,mode,x,Ki,Kilen);
+  if(1 == rv) {
+    rv = (*body)(&p,Label,Llen,Context,Clen,K0,L);
+  }
+  prf_free(&p);
   return rv;
 }
+
+/*! @brief 
+  HMAC CTR KDF
+  @param x the HMAC message digest
+  @param Ki the input key
+  @param Kilen the length of the input key
+  @param Label nonce data, usually protocol dependent
+  @param Llen length of the Label data
+  @param Context Nonce Shared information between two parties
+  @param Clen length of the Context data
+  @param K0 a buffer to hold the generated key
+  @param L the length of the generated key => in bits <=
+  @return 1 on success, 0 on failure, -1 "something bad happened"
+  (invalid input, invalid md_ctx etc)
+*/
+int KDF_CTR_HMAC( void *x,
+		  unsigned char *Ki,unsigned int Kilen,
+		  unsigned char *Label, unsigned int Llen,
+		  unsigned char *Context, unsigned int Clen,
+		  unsigned char *K0,unsigned int L
+		 )
+{
+  return kdf_once(kdf_ctr,IS_HMAC,x,Ki,Kilen,Label,Llen,Context,Clen,K0,L);
+}
 /*! @brief 
   HMAC Feedback KDF
   @param x the HMAC nmessage digest
@@ -255,53 +498,7 @@ int KDF_FB_HMAC(void *x,
 		unsigned char *K0,unsigned int L
 		)
 {
-  const EVP_MD *md = (const EVP_MD *)x;
-  int rv = 1;
-  long n;
-  unsigned long i = 1;
-  unsigned long j = 0; 
-  HMAC_CTX *hctx = NULL;
-  unsigned char IA[4];
-  unsigned char LA[4];
-  unsigned int len = 0;
-  unsigned int md_size = 0;
-  unsigned char tmp[64]; /* the largest possible MAC using SHA512 */
-  unsigned int bytes = L;
-  
-  md_size = EVP_MD_size(md);
-  n = L/md_size;
-
-  uint2BS(L*8,LA);
-  memset(tmp,0,sizeof(tmp));
-  if(n <= 0xffffffffL && md != NULL) {
-    hctx = HMAC_CTX_new();
-    if(NULL != hctx) {
-      while(bytes > 0) {      
-	uint2BS(i,IA);
-	my_HMAC_Init(hctx,Ki,Kilen,md);
-	HMAC_Update(hctx,tmp,md_size);
-	HMAC_Update(hctx,IA,4);
-	HMAC_Update(hctx,Label,Llen);
-	HMAC_Update(hctx,C00,1);
-	HMAC_Update(hctx,Context,Clen);
-	HMAC_Update(hctx,LA,4);
-	HMAC_Final(hctx,tmp,&len);
-	HMAC_CTX_cleanup(hctx);
-	j = (bytes > md_size) ? md_size : bytes;
-	memcpy(K0,tmp,j);
-	K0 += md_size;
-	bytes -= j;
-	i++;
-      }
-      HMAC_CTX_free(hctx);
-    } else {
-      rv = -1;
-    }
-  } else {
-    rv = -1;
-  }
-
-  return rv;
+  return kdf_once(kdf_fb,IS_HMAC,x,Ki,Kilen,Label,Llen,Context,Clen,K0,L);
 }
 /*! @brief 
   HMAC Dual Pipeline KDF
@@ -324,66 +521,7 @@ int KDF_DP_HMAC(void *x,
 		unsigned char *K0,unsigned int L
 		)
 {
-  const EVP_MD *md = (const EVP_MD*)x;
-  int rv = 1;
-  long n;
-  unsigned long i = 1;
-  unsigned long j = 0; 
-  HMAC_CTX *hctx = NULL;
-  unsigned char IA[4];
-  unsigned char LA[4];
-  unsigned int len = 0;
-  unsigned int md_size = 0;
-  unsigned char tmp[64]; /* the largest possible MAC using SHA512 */
-  unsigned char tmpA[64];
-  unsigned int bytes = L;
-
-  md_size = EVP_MD_size(md);
-  n = L/md_size;
-
-  uint2BS(L*8,LA);
-  memset(tmp,0,sizeof(tmp));
-  memset(tmpA,0,sizeof(tmpA));
-  if(n <= 0xffffffffL && md != NULL) {
-    hctx = HMAC_CTX_new();
-    if(NULL != hctx) {
-      while( bytes > 0 ) {  
-	uint2BS(i,IA); 
-	my_HMAC_Init(hctx,Ki,Kilen,md);
-	if(i == 1) { /* A(0) = Label || 0x00 || Context || [L] */
-	  HMAC_Update(hctx,Label,Llen);
-	  HMAC_Update(hctx,C00,1);
-	  HMAC_Update(hctx,Context,Clen);
-	  HMAC_Update(hctx,LA,4);
-	} else { /* A(i) = PRF(Ki,A(i-1) */
-	  HMAC_Update(hctx,tmpA,md_size);
-	}
-	HMAC_Final(hctx,tmpA,&len);
-	HMAC_CTX_cleanup(hctx);
-	/* K(i) = PRF(K,A(i) || [i] || Label || 0x00 || Context || [L] */
-	my_HMAC_Init(hctx,Ki,Kilen,md);
-	HMAC_Update(hctx,tmpA,md_size);
-	HMAC_Update(hctx,IA,4);
-	HMAC_Update(hctx,Label,Llen);
-	HMAC_Update(hctx,C00,1);
-	HMAC_Update(hctx,Context,Clen);
-	HMAC_Update(hctx,LA,4);
-	HMAC_Final(hctx,tmp,&len);
-	HMAC_CTX_cleanup(hctx);
-
-	j = (bytes > md_size) ? md_size : bytes;
-	memcpy(K0,tmp,j);
-	K0 += md_size;
-	bytes -= j;    
-	i++;
-      }
-      HMAC_CTX_free(hctx);
-    }
-  } else {
-    rv = -1;
-  }
-
-  return rv;
+  return kdf_once(kdf_dp,IS_HMAC,x,Ki,Kilen,Label,Llen,Context,Clen,K0,L);
 }
 
 /*! @brief 
@@ -407,49 +545,7 @@ int KDF_CTR_CMAC(void *x,
 		 unsigned char *K0,unsigned int L
 		 )
 {
-  const EVP_CIPHER *cipher = (const EVP_CIPHER *)x;
-  int rv = -11;
-  long n;
-  unsigned long i = 1;
-  unsigned long j = 0;
-  CMAC_CTX *cctx = NULL;
-  unsigned char IA[4];
-  unsigned char LA[4];
-  unsigned int cipher_size = 0;
-  unsigned char tmp[16]; /* the largest possible MAC using any supported alg */
-  unsigned int bytes = L;
-  unsigned int keylen = 0;
-
-  keylen = EVP_CIPHER_key_length(cipher);
-  if(Kilen == keylen) {
-    cipher_size = EVP_CIPHER_block_size(cipher);
-    n = L/cipher_size;
-    uint2BS(L*8,LA);  
-    if(n <= 0xffffffffL && cipher != NULL) {
-      cctx = CMAC_CTX_new();
-      if(NULL != cctx) {
-	uint2BS(i,IA);
-	while( bytes > 0 ) {      
-	  my_CMAC_Init(cctx,cipher,Ki,Kilen);
-	  CMAC_Update(cctx,IA,4);
-	  CMAC_Update(cctx,Label,Llen);
-	  CMAC_Update(cctx,(unsigned char *)C00,1);
-	  CMAC_Update(cctx,Context,Clen);
-	  CMAC_Update(cctx,LA,4);
-	  my_CMAC_Final(cctx,tmp,cipher_size);
-	  j = (bytes > cipher_size) ? cipher_size : bytes;
-	  memcpy(K0,tmp,j);
-	  K0 += cipher_size;
-	  bytes -= j;  
-	  i++;
-	}
-	rv = 1;
-	CMAC_CTX_free(cctx);
-      }
-    }
-  }
-
-  return rv;
+  return kdf_once(kdf_ctr,IS_CMAC,x,Ki,Kilen,Label,Llen,Context,Clen,K0,L);
 }
 /*! @brief 
   CMAC Feedback KDF
@@ -472,50 +568,7 @@ int KDF_FB_CMAC(void *x,
 		unsigned char *K0,unsigned int L
 		)
 {
-  const EVP_CIPHER *cipher = (const EVP_CIPHER *)x;
-  int rv = 1;
-  long n;
-  unsigned long i = 1;
-  unsigned long j = 0;
-  CMAC_CTX *cctx = NULL;
-  unsigned char IA[4];
-  unsigned char LA[4];
-  unsigned int cipher_size = 0;
-  unsigned char tmp[16]; /* the largest possible MAC using any supported alg */
-  unsigned int bytes = L;
-  unsigned int keylen = 0;
-
-  keylen = EVP_CIPHER_key_length(cipher);
-  if(Kilen == keylen) {
-    cipher_size = EVP_CIPHER_block_size(cipher);
-    n = L/cipher_size;
-    uint2BS(L*8,LA);
-    memset(tmp,0,sizeof(tmp));
-    if(n <= 0xffffffffL && cipher != NULL) {
-      cctx = CMAC_CTX_new();
-      if(NULL != cctx) {
-	while(bytes > 0) {      
-	  uint2BS(i,IA);
-	  my_CMAC_Init(cctx,cipher,Ki,Kilen);
-	  CMAC_Update(cctx,tmp,cipher_size);
-	  CMAC_Update(cctx,IA,4);
-	  CMAC_Update(cctx,Label,Llen);
-	  CMAC_Update(cctx,(unsigned char *)C00,1);
-	  CMAC_Update(cctx,Context,Clen);
-	  CMAC_Update(cctx,LA,4);
-	  my_CMAC_Final(cctx,tmp,cipher_size);
-	  j = (bytes > cipher_size) ? cipher_size : bytes;
-	  memcpy(K0,tmp,j);
-	  K0 += cipher_size;
-	  bytes -= j;
-	  i++;
-	}
-	rv = 1;
-	CMAC_CTX_free(cctx);
-      }
-    } 
-  }
-  return rv;
+  return kdf_once(kdf_fb,IS_CMAC,x,Ki,Kilen,Label,Llen,Context,Clen,K0,L);
 }
 /*! @brief 
   CMAC Dual Pipeline KDF
@@ -538,64 +591,7 @@ int KDF_DP_CMAC(void *x,
 		unsigned char *K0,unsigned int L
 		)
 {
-  const EVP_CIPHER *cipher = (const EVP_CIPHER *)x;
-  int rv = -1;
-  long n;
-  unsigned long i = 1;
-  unsigned long j = 0;
-  CMAC_CTX *cctx = NULL;
-  unsigned char IA[4];
-  unsigned char LA[4];
-  unsigned int cipher_size = 0;
-  unsigned char tmp[16]; /* the largest possible MAC using any supported alg */
-  unsigned char tmpA[16];
-  unsigned int bytes = L;
-  unsigned int keylen = 0;
-
-  keylen = EVP_CIPHER_key_length(cipher);
-  if(Kilen == keylen) {
-    cipher_size = EVP_CIPHER_block_size(cipher);
-    n = L/cipher_size;
-    uint2BS(L*8,LA);
-    memset(tmp,0,sizeof(tmp));
-    memset(tmpA,0,sizeof(tmpA));
-    if(n <= 0xffffffffL && cipher != NULL) {
-      cctx = CMAC_CTX_new();
-      if(NULL != cctx) {
-	while( bytes > 0 ) {  
-	  uint2BS(i,IA); 
-	  my_CMAC_Init(cctx,cipher,Ki,Kilen);
-	  if(i == 1) { /* A(0) = Label || 0x00 || Context || [L] */
-	    CMAC_Update(cctx,Label,Llen);
-	    CMAC_Update(cctx,(unsigned char *)C00,1);
-	    CMAC_Update(cctx,Context,Clen);
-	    CMAC_Update(cctx,LA,4);
-	  } else { /* A(i) = PRF(Ki,A(i-1) */
-	    CMAC_Update(cctx,tmpA,cipher_size);
-	  }
-	  my_CMAC_Final(cctx,tmpA,cipher_size);
-	  /* K(i) = PRF(K,A(i) || [i] || Label || 0x00 || Context || [L] */
-	  my_CMAC_Init(cctx,cipher,Ki,Kilen);
-	  CMAC_Update(cctx,tmpA,cipher_size);
-	  CMAC_Update(cctx,IA,4);
-	  CMAC_Update(cctx,Label,Llen);
-	  CMAC_Update(cctx,(unsigned char *)C00,1);
-	  CMAC_Update(cctx,Context,Clen);
-	  CMAC_Update(cctx,LA,4);
-	  my_CMAC_Final(cctx,tmp,cipher_size);
-
-	  j = (bytes > cipher_size) ? cipher_size : bytes;
-	  memcpy(K0,tmp,j);
-	  K0 += cipher_size;
-	  bytes -= j;    
-	  i++;
-	}
-	rv = 1;
-	CMAC_CTX_free(cctx);
-      } 
-    }
-  }
-  return rv;
+  return kdf_once(kdf_dp,IS_CMAC,x,Ki,Kilen,Label,Llen,Context,Clen,K0,L);
 }
 /*! 
   \known Data: KDF data objects contain known answer 
@@ -666,11 +662,11 @@ static KDF_data_t KDFS[] = {
    {0x28,0x78,0xd5,0x20,0x36,0x06,0x43,0x1c,
     0xc9,0x99,0x8a,0x3a,0x8f,0xf1,0x6e,0x98}},
   {"AES-192-CTR","AES-192-CBC",0,IS_CMAC,KDF_CTR_CMAC,NULL,0,
-   {0x7f,0xb8,0xaa,0x2a,0x58,0x0c,0x78,0xec,
-    0x24,0x5b,0x77,0x26,0x64,0x37,0x62,0x06}},
+   {0xc5,0xb4,0xf3,0x60,0xaf,0x8b,0x16,0xaf,
+    0x46,0x77,0x63,0x40,0xd2,0xd0,0xd6,0xb3}},
   {"AES-256-CTR","AES-256-CBC",0,IS_CMAC,KDF_CTR_CMAC,NULL,0,
-   {0xe9,0x29,0x94,0x29,0x31,0x59,0x2d,0x5d,
-    0xa5,0xfb,0x71,0x14,0xb7,0xe8,0x17,0xda}},
+   {0xcb,0xac,0xf8,0xd1,0xfe,0xa5,0xbd,0x9d,
+    0xdc,0x98,0xdc,0x85,0xc2,0xa0,0x5a,0xf1}},
 
   {"AES-128-FB","AES-128-CBC",0,IS_CMAC,KDF_FB_CMAC,NULL,0,
    {0x77,0x78,0xcf,0xc5,0x73,0x8d,0x2d,0x88,
@@ -696,11 +692,11 @@ static KDF_data_t KDFS[] = {
    {0xb5,0x4a,0x68,0x73,0x3e,0xd6,0x9d,0xb1,
     0x8b,0x4d,0xc8,0x52,0x09,0x60,0xec,0xe9}},
   {"CAMELLIA-192-CTR","CAMELLIA-192-CBC",0,IS_CMAC,KDF_CTR_CMAC,NULL,0,
-   {0x78,0x5b,0xaf,0x44,0x6c,0x02,0xb6,0x55,
-    0x33,0xc9,0x82,0x8a,0xb2,0x13,0xe4,0x55}},
+   {0x4d,0xa7,0xba,0xd3,0xc6,0x9c,0x7a,0x43,
+    0x2c,0x8f,0xb1,0xbe,0xae,0xba,0x60,0x42}},
   {"CAMELLIA-256-CTR","CAMELLIA-256-CBC",0,IS_CMAC,KDF_CTR_CMAC,NULL,0,
-   {0x25,0x33,0x4a,0xc9,0x84,0x66,0xfe,0x0a,
-    0xb2,0xdb,0xfd,0xcf,0x63,0x69,0x7e,0xbf}},
+   {0xa8,0x9c,0xf3,0x22,0x0d,0xac,0x9c,0x22,
+    0x39,0xa5,0xaa,0x9e,0x42,0xa1,0x68,0xca}},
 
   {"CAMELLIA-128-FB","CAMELLIA-128-CBC",0,IS_CMAC,KDF_FB_CMAC,NULL,0,
    {0x21,0xe1,0x6f,0x28,0xbf,0xc6,0x1e,0x92,
@@ -838,6 +834,69 @@ int SP800_108_KDF(const KDF *xctx,
   } 
   return rv;
 }
+/*! @brief map an exported KDF function to the mode body it wraps
+  @param f the KDF function from the KDFS table
+  @return the body, or NULL
+*/
+static KDF_Body kdf_body(KDF_Func f)
+{
+  KDF_Body body = NULL;
+
+  if((KDF_CTR_HMAC == f) || (KDF_CTR_CMAC == f)) {
+    body = kdf_ctr;
+  } else if((KDF_FB_HMAC == f) || (KDF_FB_CMAC == f)) {
+    body = kdf_fb;
+  } else if((KDF_DP_HMAC == f) || (KDF_DP_CMAC == f)) {
+    body = kdf_dp;
+  }
+  return body;
+}
+
+/*!
+ @brief Derive a set of keys from one derivation key
+ The HMAC or CMAC is keyed once and that key schedule is reused for
+ every entry, the result is the same as calling SP800_108_KDF() for each.
+ @param xctx a KDF 
+ @param Ki The derivation key
+ @param Kilen The length of the derivation key
+ @param recs The entries, Label, Context and L in, K0 out and rv set
+ @param n The number of entries
+ @return 1 if all entries were derived, 0 on failure, -1 on 
+ "something bad happened" (invalid key or KDF), check recs[i].rv
+ @note the KDF API is experimental, and may not be stable between ICC releases
+*/
+int SP800_108_KDF_Batch(const KDF *xctx,
+			unsigned char *Ki,unsigned int Kilen,
+			KDF_REC *recs,unsigned int n)
+{
+  KDF_data_t *kctx = (KDF_data_t *)xctx;
+  KDF_Body body = NULL;
+  KDF_PRF p;
+  KDF_REC *r = NULL;
+  unsigned int i = 0;
+  int keyed = -1;
+  int rv = 0;
+
+  if((NULL != kctx) && (NULL != kctx->handle) && (NULL != recs)) {
+    body = kdf_body(kctx->kdf);
+  }
+  if(NULL != body) {
+    keyed = prf_new(&p,kctx->mode,kctx->handle,Ki,Kilen);
+    rv = keyed;
+    for(i = 0; i < n; i++) {
+      r = &recs[i];
+      r->rv = -1;
+      if((1 == keyed) && (NULL != r->K0)) {
+	r->rv = (*body)(&p,r->Label,r->Llen,r->Context,r->Clen,r->K0,r->L);
+      }
+      if((1 == rv) && (1 != r->rv)) {
+	rv = 0;
+      }
+    }
+    prf_free(&p);
+  }
+  return rv;
+}
 /*!
   @brief get the list of FIPS compliant 
   SP800-108 modes so we can iterate through them
@@ -17,6 +17,20 @@
 
 typedef struct KDF_data_t KDF;
 
+/*!
+  @brief One entry for SP800_108_KDF_Batch()
+  @note Must match the layout of ICC_KDF_REC in icc.h
+*/
+typedef struct KDF_REC_t {
+  unsigned char *Label;   /*!< Protocol specific nonce data */
+  unsigned int Llen;      /*!< The length of Label */
+  unsigned char *Context; /*!< Instance specific nonce data */
+  unsigned int Clen;      /*!< The length of Context */
+  unsigned char *K0;      /*!< The buffer in which to store the derived key */
+  unsigned int L;         /*!< The length in BYTES of the derived key */
+  int rv;                 /*!< Returned, 1 if this key was derived */
+} KDF_REC;
+
 /*!
   @brief get the list of FIPS compliant 
   SP800-108 modes so we can iterate through them
@@ -52,4 +66,18 @@ int SP800_108_KDF(const KDF *xctx,
 		  unsigned char *Label, unsigned int Llen,
 		  unsigned char *Context, unsigned int Clen,
 		  unsigned char *K0,unsigned int L);
+
+/*!
+ @brief Derive a set of keys from one derivation key,
+ the HMAC/CMAC is keyed once for all entries
+ @param xctx a KDF 
+ @param Ki The derivation key
+ @param Kilen The length of the derivation key
+ @param recs The entries
+ @param n The number of entries
+ @return 1 if all entries were derived, 0 on failure, -1 on "something bad happened" 
+*/
+int SP800_108_KDF_Batch(const KDF *xctx,
+			unsigned char *Ki,unsigned int Kilen,
+			KDF_REC *recs,unsigned int n);
 #endif
@@ -15,9 +15,9 @@
 #include <openssl/evp.h>
 #include <string.h>
 #include "icc.h"
-#include "fips-prng/utils.h"
+#include "SP800_38F/SP80038F.h"
+#include "fips-prng/utils.h" /* load_be64(), store_be64() */
 
-extern void * CRYPTO_calloc(int nmemb,int size,const char *file, int line);
 
 /** @brief
     Data structure for a semi-block 
@@ -26,10 +26,6 @@ typedef struct {
   unsigned char F[8];
 } KWX;
 
-static unsigned char BE_1 = 1; /*!< Constant 1 */
-static unsigned char BE_6 = 6; /*!< Constant 6 */
-static unsigned char minus_1[8] = {0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff}; /*!< Constant -1 */
-
 static const KWX A0 = {{0xA6,0xA6,0xA6,0xA6,0xA6,0xA6,0xA6,0xA6}}; /*!< Check code for unpadded wrap */
 static const KWX AP = {{0xA6,0x59,0x59,0xA6,0x00,0x00,0x00,0x00}}; /*!< Check code for padded wrap */
 
@@ -59,18 +55,19 @@ static const EVP_CIPHER * GetCipher(int kl)
   }                  
   return cip;
 }
-/** @brief Initialize an encrypt operation
+/** @brief Key a cipher context for the wrap transform
     @param cctx cipher context
     @param key  a pointer to a buffer holding an AES key
     @param kl the key length (in bits)
+    @param enc 1 encrypt, 0 decrypt
     @return 1 O.K.
 */
-static SP800_38F_ERR EncryptInit(EVP_CIPHER_CTX *cctx,unsigned char *key, int kl)
+static SP800_38F_ERR CipherInit(EVP_CIPHER_CTX *cctx,unsigned char *key, int kl,int enc)
 {
   SP800_38F_ERR rv = SP800_38F_PARAM;
   const EVP_CIPHER *cip = GetCipher(kl);
   if(NULL != cip) {
-    if( 1 ==  EVP_EncryptInit(cctx,cip,key,NULL) ) {
+    if( 1 ==  EVP_CipherInit_ex(cctx,cip,NULL,key,NULL,enc) ) {
       rv = SP800_38F_OK;
     }
     EVP_CIPHER_CTX_set_padding(cctx,0);
@@ -78,300 +75,180 @@ static SP800_38F_ERR EncryptInit(EVP_CIPHER_CTX *cctx,unsigned char *key, int kl
   return rv;
 }
 
-/** @brief  Basic indexed encryption transform 
+/** @brief  Basic indexed transform, encrypt or decrypt as the
+    context was keyed
     @param cctx cipher context
-    @param in a pointer to an 8 byte input block
-    @param out a pointer to an 8 byte output block
+    @param in a pointer to a pair of 8 byte input blocks
+    @param out a pointer to a pair of 8 byte output blocks
     @return 1 O.K.
 */
-static int Encrypt(EVP_CIPHER_CTX *cctx,KWX * in,KWX *out)
+static int Cipher(EVP_CIPHER_CTX *cctx,KWX * in,KWX *out)
 {
   int outl = 0;
-  return EVP_EncryptUpdate(cctx,(unsigned char *)out,&outl,(unsigned char *)in,16);
+  return EVP_CipherUpdate(cctx,(unsigned char *)out,&outl,(unsigned char *)in,16);
 }
 
-#if 0
-/** @brief Cleanup from encrypt
-    @param cctx cipher context
-    @return 1 O.K.
-*/
-
-static int EncryptFinal(EVP_CIPHER_CTX *cctx) 
-{
-  int rv = 0;
-  int outl = 0;
-  char buffer[16];
-  rv = EVP_EncryptFinal(cctx,buffer,&outl);
-
-  
-  return rv;
-}
-#endif
-
-/** @brief Initialize a decrypt operation
-    @param cctx cipher context
-    @param key  a pointer to a buffer holding an AES key
-    @param kl the key length (in bits)
-    @return 1 O.K.
-*/
-static SP800_38F_ERR DecryptInit(EVP_CIPHER_CTX *cctx,unsigned char *key,int kl)
-{
-  SP800_38F_ERR rv = SP800_38F_PARAM;
-  const EVP_CIPHER *cip = GetCipher(kl);
-  if(NULL != cip) {
-    if(1  ==  EVP_DecryptInit(cctx,cip,key,NULL) ) {
-      rv = SP800_38F_OK;
-    }
-    EVP_CIPHER_CTX_set_padding(cctx,0);
-  }
-  return rv;
-}
-/** @brief  Basic indexed decryption transform 
-    @param cctx cipher context
-    @param in a pointer to an 8 byte input block
-    @param out a pointer to an 8 byte output block
-    @return 1 O.K.
+/** @brief
+    Does this flag combination use the forward (encrypt) cipher ?
+    Wrap normally encrypts and unwrap decrypts, ICC_KW_FORWARD_DECRYPT
+    swaps them over
+    @param flags the SP800_38F_KW() flags
+    @return 1 if an encrypt context is needed, 0 for decrypt
 */
-static int Decrypt(EVP_CIPHER_CTX *cctx,KWX *in,KWX *out)
+static int UsesEncrypt(unsigned int flags)
 {
-  int outl = 0;
-  return EVP_DecryptUpdate(cctx,(unsigned char *)out,&outl,(unsigned char *)in,16);
+  return ((flags & ICC_KW_WRAP) != 0) == ((flags & ICC_KW_FORWARD_DECRYPT) == 0);
 }
 
-#if 0
-/** @brief Cleanup from decrypt
-    @param cctx cipher context
-    @return 1 O.K.
+/** @brief
+    The state of one wrap or unwrap in progress. The 6*n rounds of one
+    key are serial, but the rounds of independent keys aren't, so 
+    several of these are stepped together and their AES blocks 
+    passed to the cipher in one call.
 */
-
-static int DecryptFinal(EVP_CIPHER_CTX *cctx)
-{
-  int rv = 0;
-  int outl;
-  char buffer[16];
-  rv = EVP_DecryptFinal(cctx,buffer,&outl);
-  return rv;
-}
-#endif
+typedef struct {
+  KWX A;              /*!< The integrity check register */
+  KWX *R;             /*!< The semiblocks, in the output buffer */
+  unsigned char *out; /*!< The output buffer */
+  int *outl;          /*!< Where the output length goes */
+  int n;              /*!< The number of semiblocks in R */
+  int s;              /*!< The current round */
+  int i;              /*!< The semiblock this round works on */
+  int rounds;         /*!< The number of rounds, 6*n, 0 if already done */
+  int wrap;           /*!< 1 wrap, 0 unwrap */
+  int pad;            /*!< 1 if padding is enabled */
+} KW_STATE;
 
 /**  
-     @brief Key Wrap function 
+     @brief Start a Key Wrap
+     @param st the wrap state
+     @param cctx a cipher context keyed in the wrap direction
      @param in input buffer
      @param inl length of input buffer
-     @param out output buffer (length of input +16)
+     @param out output buffer (length of input +16), may be the same buffer as in
      @param outl place to store the output length
-     @param key the AES key
-     @param kl Size of the AES key (bits)
-     @param isEnc 1 Encrypt is used as the wrap function, 0 decrypt is used as the wrap function
-     @param pad 1 if padding is enabled
-     @return 1 O.K., length of output in *outl, 3 range error in input, 2 Unwrap mac mismatch
+     @return 1 O.K., 0 Parameter error
+     @note The transform is done in place in the output buffer, no working
+     storage is allocated
+     @note short padded input is a single AES block and is completed here
  */
-static int KW(unsigned char *in, int inl, unsigned char *out, int *outl, unsigned char *key, int kl, int isEnc,int pad)
+static int KWStart(KW_STATE *st,EVP_CIPHER_CTX *cctx,unsigned char *in, int inl, unsigned char *out, int *outl)
 {
   SP800_38F_ERR rv = SP800_38F_OK;
   int i = 0;
-  int j = 0;
   int n = 0; 
-  int k = 0;
-  KWX *R = NULL; /* Temporary output buffers */
-  KWX *I = NULL; /* Overlay for the inpt buffer */ 
-  KWX *C = NULL; /* Overlay for the output buffer */
-  KWX t;
-  KWX B[2];
   KWX T[2];
-  KWX A;
   int padlen = 0;
 
-  EVP_CIPHER_CTX *cctx = NULL;
-  cctx = EVP_CIPHER_CTX_new();
-  if(NULL == cctx) {
-    rv = SP800_38F_MEM;
-  }
-  if(SP800_38F_OK == rv) {
-    if(isEnc) {
-      rv = EncryptInit(cctx,key,kl);
-    } else {
-      rv = DecryptInit(cctx,key,kl);
+  if(! st->pad) { /* unpadded */
+    /* Check that the length criteria for the input are met 
+       With padding off, it must be complete semi-blocks
+    */
+    n = inl/8;
+    if(((n*8) != inl) || (n < 2)) {
+      rv = SP800_38F_PARAM;
     }
-  }
-  if(SP800_38F_OK == rv) {
-    if(! pad) { /* unpadded */
-      /* Check that the length criteria for the input are met 
-	 With padding off, it must be complete semi-blocks
-      */
-      n = inl/8;
-      if(((n*8) != inl) || (n < 2)) {
-	*outl = 0;
-	rv = SP800_38F_PARAM;
-      }
-      /* 2 to (2^54)-1 semiblocks */
-      if((sizeof(n) > 4) && (sizeof(long) > 4)) {
+    /* 2 to (2^54)-1 semiblocks */
+    if((sizeof(n) > 4) && (sizeof(long) > 4)) {
 #if defined(WIN64)
-	long long l  = 0x40000000000000 - 1;
+      long long l  = 0x40000000000000 - 1;
 #else
-	long l = 0x40000000000000 - 1;
+      long l = 0x40000000000000 - 1;
 #endif
-	if(n > l) {
-	  rv = SP800_38F_PARAM;
-	}
-      }
-      /* Copy the tag to the working area */
-      memcpy(&A,&A0,sizeof(KWX));
-      k = n;
-    } else { /* Padded */
-      n = (inl+7)/8;
-      k = inl/8; /* Number of complete blocks */
-      /* Copy the different tag to the working area */
-      memcpy(&A,&AP,sizeof(KWX));
-      padlen = inl;
-      for(i = 7; i > 3; i--) { /* Insert pad length, BE, bytes */
-	A.F[i] = padlen & 0xff;
-	padlen >>= 8;
-      }
-      /* 1 to (2^32)-1 octets */
-      if(inl > 32767) {
+      if(n > l) {
 	rv = SP800_38F_PARAM;
       }
     }
-  }
-  if(SP800_38F_OK == rv) {
-  
-    memset(&t,0,sizeof(t));
-    /* Allocate working buffers */
-    R = CRYPTO_calloc(n,sizeof(KWX),__FILE__,__LINE__);
-    if(NULL == R) {
-      rv = SP800_38F_MEM;
+    /* Copy the tag to the working area */
+    memcpy(&st->A,&A0,sizeof(KWX));
+  } else { /* Padded */
+    n = (inl+7)/8;
+    /* Copy the different tag to the working area */
+    memcpy(&st->A,&AP,sizeof(KWX));
+    padlen = inl;
+    for(i = 7; i > 3; i--) { /* Insert pad length, BE, bytes */
+      st->A.F[i] = padlen & 0xff;
+      padlen >>= 8;
+    }
+    /* 1 to (2^32)-1 octets */
+    if((inl > 32767) || (inl < 1)) {
+      rv = SP800_38F_PARAM;
     }
   }
   if(SP800_38F_OK == rv) {
-    I = (KWX *)in;
-    /* Copy the whole semiblocks */
-    for( i = 0; i < k; i++) { 
-      memcpy(&R[i],&I[i],sizeof(KWX));
-    }
+    st->out = out;
+    st->outl = outl;
+    st->n = n;
+    st->s = 0;
+    st->i = 0;
+    st->rounds = 6 * n;
+    /* The semiblocks are processed where they'll finally sit in the
+       output, after the tag. memmove() as in and out may overlap
+    */
+    st->R = (KWX *)(out + sizeof(KWX));
+    memmove(st->R,in,inl);
     /* If there's a partial semiblock (padded mode)
-       copy that and zero pad the end of the block
+       zero pad the end of the block
     */
     if(inl & 7) {
-      for(i = 0; i < (inl & 7); i++) {
-	R[k].F[i] = in[(k*8)+i];
-      }
-      for( ; i < 8; i++) {
-	R[k].F[i] = 0;
-      }
+      memset(out + sizeof(KWX) + inl,0,8 - (inl & 7));
     }
     /* 
        If the length is <= 1 semi-block
        just encrypt the tag and data (One AES block)
        as the extra winding around doesn't add anything
-       useful. And to save time, just stuf fthat directly 
-       into the output buffer 
+       useful. 
     */
-    if(pad && (inl <= 8)) {
-      memcpy(&T[0],&A,sizeof(KWX));
-      memcpy(&T[1],&R[0],sizeof(KWX));
-      if(isEnc) {
-	Encrypt(cctx,&T[0],(KWX *)out);
-      } else {
-	Decrypt(cctx,&T[0],(KWX *)out);
-      }
+    if(st->pad && (inl <= 8)) {
+      memcpy(&T[0],&st->A,sizeof(KWX));
+      memcpy(&T[1],&st->R[0],sizeof(KWX));
+      Cipher(cctx,&T[0],(KWX *)out);
+      OPENSSL_cleanse(T,sizeof(T));
       *outl = 16;
-    } else  {
-      /* Else do the full rotate thing */
-      for(j = 0; j < 6; j++) {    
-	for( i = 0; i < n; i++) {
-	  Add_BE((unsigned char *)&t,(unsigned char *)&t,8,&BE_1,1); 
-	  memcpy(&T[0],&A,sizeof(KWX));
-	  memcpy(&T[1],&R[i],sizeof(KWX));
-	  if(isEnc) {
-	    Encrypt(cctx,&T[0],&B[0]);
-	  } else {
-	    Decrypt(cctx,&T[0],&B[0]);
-	  }
-	  xor((unsigned char *)&A,(unsigned char *)&B[0],(unsigned char *)&t,sizeof(KWX));
-	
-	  memcpy(&R[i],&B[1],sizeof(KWX));
-	}
-      }
-  
-      C = (KWX *)out;
-      memcpy(&C[0],&A,sizeof(KWX));
-      *outl = 8;
-      for(i = 0; i < n; i++) {
-	memcpy(&C[i+1],&R[i],sizeof(KWX));
-	*outl += 8;
-      }
+      st->rounds = 0;
     }
-    CRYPTO_free(R,__FILE__,__LINE__);
-  }
-  if( NULL != cctx ) {
-    EVP_CIPHER_CTX_cleanup(cctx);
-    EVP_CIPHER_CTX_free(cctx);
   }
   return rv;
 }
 
-
-
 /*! 
-  @brief Key unwrap function 
+  @brief Start a Key unwrap 
+  @param st the unwrap state
+  @param cctx a cipher context keyed in the unwrap direction
   @param in input buffer
   @param inl length of input buffer
-  @param out output buffer (length of input +16)
+  @param out output buffer (length of input), may be the same buffer as in
   @param outl place to store the output length
-  @param key the AES key
-  @param kl Size of the AES key (bits)
-  @param isEnc 1 Encrypt is used as the wrap function, 0 decrypt is used as the wrap function
-  @param isPad 1 if padding is enabled
-  @return 1 O.K., length of output in *outl, 3 range error in input, 2 Unwrap mac mismatch
+  @return 1 O.K., 3 range error in input
+  @note The transform is done in place in the output buffer, no working
+  storage is allocated.
+  @note A padded single AES block is completed here
 */
-static int KU(unsigned char *in, int inl, unsigned char *out, int *outl, unsigned char *key, int kl,int isEnc,int isPad)
+static int KUStart(KW_STATE *st,EVP_CIPHER_CTX *cctx,unsigned char *in, int inl, unsigned char *out, int *outl)
 {
   SP800_38F_ERR rv = SP800_38F_OK;
-  int i = 0;
-  int j = 0;
   int n = 0;
-  KWX *C = NULL; /* Working space, which may be quite considerable */
-  KWX *R = NULL; /* Temporary output buffers */
-  KWX *P = NULL; /* Overlay for the output buffer */
-  KWX t;
+  KWX *C = NULL; /* Overlay for the input buffer */
   KWX B[2];
   KWX T[2];
-  KWX A;
-  int bytes = 0;
 #if defined(WIN64)
   long long l = 0;
 #else
   long l = 0;
 #endif
-  EVP_CIPHER_CTX *cctx = NULL;
 
-  cctx = EVP_CIPHER_CTX_new();
-  if(NULL == cctx) {
-    rv = SP800_38F_MEM;
-  }
-  if(SP800_38F_OK == rv) {
-    if(isEnc) {  /* These are unwrap paths, Encrypt is used on the forward path, decrypt going back */
-      rv = DecryptInit(cctx,key,kl);
-    } else {
-      rv = EncryptInit(cctx,key,kl);
-    }
-  }
-  if(SP800_38F_OK == rv) {
-    n = inl/8;
+  n = inl/8;
  
-    /* Check that the length criteria for the input are met 
-       UnWrap input will always be a integer multiple of semiblocks
-       Padded mode, 2 semiblocks is the minimum
-       Unpadded 3
-    */
-    if((n*8) != inl) {
-      rv = SP800_38F_DATA;
-    }
+  /* Check that the length criteria for the input are met 
+     UnWrap input will always be a integer multiple of semiblocks
+     Padded mode, 2 semiblocks is the minimum
+     Unpadded 3
+  */
+  if((n*8) != inl) {
+    rv = SP800_38F_DATA;
   }
-  *outl = 0;
   if(SP800_38F_OK == rv) {
-    if(isPad) { /* Padded */
+    if(st->pad) { /* Padded */
       if(n < 2) {
 	rv = SP800_38F_DATA;
       }
@@ -391,115 +268,324 @@ static int KU(unsigned char *in, int inl, unsigned char *out, int *outl, unsigne
       }
     }
   }
-  if(SP800_38F_OK == rv) {
-    memset(&t,0,sizeof(t));
-    /* Allocate working buffers */
-    R = CRYPTO_calloc(n,sizeof(KWX),__FILE__,__LINE__);
-    if(NULL == R) {
-      rv = SP800_38F_MEM;
-    }
-  }
 
   C = (KWX *)in;
 
   if(SP800_38F_OK == rv) {
-    if(isPad && n == 2) {
+    st->out = out;
+    st->outl = outl;
+    st->R = (KWX *)out;
+    st->n = n - 1; /* The number of semiblocks in the output */
+    st->s = 0;
+    st->i = st->n - 1;
+    st->rounds = 6 * st->n;
+    if(st->pad && n == 2) {
       memcpy(&T[0],&C[0],2*sizeof(KWX));
-      if(isEnc) {
-	Decrypt(cctx,&T[0],&B[0]);
-      } else {
-	Encrypt(cctx,&T[0],&B[0]);
-      }
-      memcpy(&A,&B[0],sizeof(KWX));
-      memcpy(&R[0],&B[1],sizeof(KWX));
+      Cipher(cctx,&T[0],&B[0]);
+      memcpy(&st->A,&B[0],sizeof(KWX));
+      memcpy(&st->R[0],&B[1],sizeof(KWX));
+      OPENSSL_cleanse(T,sizeof(T));
+      OPENSSL_cleanse(B,sizeof(B));
+      st->rounds = 0;
     } else {
-      memcpy(&A,&C[0],sizeof(KWX));
-      for( i = 0; i < (n-1); i++) {
-	memcpy(&R[i],&C[i+1],sizeof(KWX));
-      }
-      n = n -1;
-      for( i = 0; i < n; i++) {
-	Add_BE((unsigned char *)&t,(unsigned char *)&t,8,&BE_6,1);
-      }
+      memcpy(&st->A,&C[0],sizeof(KWX));
+      /* memmove() as in and out may overlap */
+      memmove(st->R,&C[1],st->n*sizeof(KWX));
+    }
+  }
+  return rv;
+}
 
-      for(j = 0; j < 6 ; j++) {    
-	for( i = n; i > 0; i--) {
-	  xor((unsigned char *)&A,(unsigned char *)&A,(unsigned char *)&t,sizeof(KWX));
-	  memcpy(&T[0],&A,sizeof(KWX));
-	  memcpy(&T[1],&R[i-1],sizeof(KWX));
-	  if(isEnc) {
-	    Decrypt(cctx,&T[0],&B[0]);
-	  } else {
-	    Encrypt(cctx,&T[0],&B[0]); /* Yes, 0, param not needed now */
-	  }
-	  memcpy(&A,&B[0],sizeof(KWX));
-	  memcpy(&R[i-1],&B[1],sizeof(KWX));
-	  Add_BE((unsigned char *)&t,(unsigned char *)&t,8,minus_1,8);
-	}
+/** @brief xor the round count t, as a 64 bit BE value, into A 
+    @param A the integrity check register
+    @param t the round count, 1 to 6*n
+*/
+static void XorCount(KWX *A,unsigned long long t)
+{
+  store_be64(A->F,load_be64(A->F) ^ t);
+}
+
+/** @brief Set up the AES input block for the next round
+    @param st the wrap state
+    @param T where the AES input block is assembled
+*/
+static void KWRoundIn(KW_STATE *st,KWX *T)
+{
+  if(!st->wrap) { /* Unwrap counts down from 6*n */
+    XorCount(&st->A,(unsigned long long)(st->rounds - st->s));
+  }
+  memcpy(&T[0],&st->A,sizeof(KWX));
+  memcpy(&T[1],&st->R[st->i],sizeof(KWX));
+}
+
+/** @brief Take the AES output block for this round and advance
+    @param st the wrap state
+    @param B the AES output block
+*/
+static void KWRoundOut(KW_STATE *st,KWX *B)
+{
+  memcpy(&st->R[st->i],&B[1],sizeof(KWX));
+  memcpy(&st->A,&B[0],sizeof(KWX));
+  if(st->wrap) { /* Wrap counts up from 1 */
+    XorCount(&st->A,(unsigned long long)(st->s + 1));
+    /* Wrap runs forwards through the semiblocks */
+    if(++st->i == st->n) {
+      st->i = 0;
+    }
+  } else {
+    /* Unwrap runs backwards */
+    if(0 == st->i--) {
+      st->i = st->n - 1;
+    }
+  }
+  st->s++;
+}
+
+/** @brief All the rounds of one wrap or unwrap, the single key kernel
+    A stays in a register, each round builds the AES block A | R[i],
+    transforms it in place and splits it back, R[] is the output buffer.
+    KW/KWP and their inverses differ only in the initial A and the
+    checks, which KWStart()/KUStart()/KWFinish() handle.
+    @param st the wrap state from KWStart() or KUStart()
+    @param cctx the keyed cipher context
+*/
+static void KWRounds(KW_STATE *st,EVP_CIPHER_CTX *cctx)
+{
+  unsigned char T[16];
+  unsigned char *R = (unsigned char *)st->R;
+  unsigned long long a = load_be64(st->A.F);
+  unsigned long long t = 0;
+  int n = st->n;
+  int outl = 0;
+  int i = 0;
+  int j = 0;
+
+  if(st->wrap) {
+    /* W(S), t counts up from 1 */
+    t = 1;
+    for(j = 0; j < 6; j++) {
+      for(i = 0; i < n; i++, t++) {
+        store_be64(T,a);
+        memcpy(T + 8,R + 8 * i,8);
+        EVP_CipherUpdate(cctx,T,&outl,T,16);
+        a = load_be64(T) ^ t;
+        memcpy(R + 8 * i,T + 8,8);
+      }
+    }
+  } else {
+    /* W^-1(C), t counts down from 6*n */
+    t = (unsigned long long)(6 * n);
+    for(j = 0; j < 6; j++) {
+      for(i = n - 1; i >= 0; i--, t--) {
+        store_be64(T,a ^ t);
+        memcpy(T + 8,R + 8 * i,8);
+        EVP_CipherUpdate(cctx,T,&outl,T,16);
+        a = load_be64(T);
+        memcpy(R + 8 * i,T + 8,8);
       }
     }
+  }
+  store_be64(st->A.F,a);
+  st->s = st->rounds;
+  OPENSSL_cleanse(T,sizeof(T));
+}
+
+/** @brief Complete a wrap, or check an unwrap
+    @param st the wrap state, all rounds done
+    @return 1 O.K., length of output in *outl, 2 Unwrap mac mismatch
+    @note On an unwrap failure the output buffer is cleared
+*/
+static int KWFinish(KW_STATE *st)
+{
+  SP800_38F_ERR rv = SP800_38F_OK;
+  int i = 0;
+  int n = st->n;
+  int bytes = 0;
+  unsigned char *out = st->out;
 
-    P = (KWX *)out;
-    *outl = 0;
-    if(isPad) {
-      /* This is ugly, because once we extract the unpadded length
-	 we have to recalc the number of complete and partial
-	 blocks to copy to the output. Unlike unpadded mode
-	 it's not implicit in the input size
+  if(st->wrap) {
+    if(0 != st->rounds) { /* The single block case already wrote the output */
+      memcpy(out,&st->A,sizeof(KWX));
+      *(st->outl) = 8 * (n + 1);
+    }
+  } else {
+    if(st->pad) {
+      /* Once we extract the unpadded length check that it
+	 falls in the last semiblock and the padding was 0's 
       */
-      if(memcmp(&A,&AP,4) == 0 ) {
+      rv = SP800_38F_MAC;
+      if(memcmp(&st->A,&AP,4) == 0 ) {
 	bytes = 0;
 	for(i = 4; i < 8; i++) {
 	  bytes <<= 8;
-	  bytes += A.F[i];
+	  bytes += st->A.F[i];
 	}
-	n = (bytes/8);  /* Number of complete semi-blocks */
-	if(SP800_38F_OK == rv) {
-	  for(i = 0; i < n; i++) {
-	    memcpy(&P[i],&R[i],sizeof(KWX));
-	    (*outl) += 8;
-	  }
-	  j = i; /* The remaining bytes */
-	  for(i = 0; i < (bytes &7); i++) {
-	    P[j].F[i] = R[j].F[i];
-	    (*outl) ++;
-	  } 
-	  for(  ; i < 8; i++) { /* And check that the padding WAS 0's */
-	    if(R[j].F[i] != 0) {
-	      memset(out,0,*outl); /* On a padding error Scrub what was decrypted so far */
-	      (*outl) = 0;
+	if((bytes > (8 * (n - 1))) && (bytes <= (8 * n))) {
+	  rv = SP800_38F_OK;
+	  for(i = bytes; i < (8 * n); i++) {
+	    if(out[i] != 0) {
 	      rv = SP800_38F_MAC; /* Padding error in final block */
 	    }
 	  }
 	}
-      } else {
+      }
+    } else {
+      bytes = 8 * n;
+      if(memcmp(&st->A,&A0,sizeof(KWX)) != 0) { 
 	rv = SP800_38F_MAC;
-      }      
+      }
+    }
+    if(SP800_38F_OK == rv) {
+      *(st->outl) = bytes;
     } else {
-      if(memcmp(&A,&A0,sizeof(KWX)) == 0) { 
-	for(i = 0; i < n; i++) {
-	  memcpy(&P[i],&R[i],sizeof(KWX));
-	  *outl += 8;
+      memset(out,0,8 * n); /* Scrub what was decrypted */
+    }
+  }
+  return rv;
+}
+
+/*! @brief The maximum number of wraps stepped together. The AES-NI 
+  and similar ECB paths work on up to 8 blocks at once
+*/
+#define KW_LANES 8
+
+/** @brief Wrap or unwrap a set of independent keys on a keyed cipher context
+    @param cctx a cipher context, keyed in the direction UsesEncrypt() 
+    reports for these flags
+    @param recs the entries, in, inl and out are input, outl and rv are set
+    @param n the number of entries
+    @param flags the SP800_38F_KW() flags
+    @return 1 if every entry was processed O.K., otherwise the error
+    from the first entry that failed
+    @note Up to KW_LANES entries are in flight at once, each round
+    one AES block from each goes to the cipher in a single call so the
+    blocks are independent and pipeline. A lane that finishes is 
+    refilled from the next entry, entry lengths needn't match.
+*/
+static int KWMulti(EVP_CIPHER_CTX *cctx,SP800_38F_REC *recs,unsigned int n,unsigned int flags)
+{
+  int rv = SP800_38F_OK;
+  KW_STATE st[KW_LANES];
+  SP800_38F_REC *lr[KW_LANES]; /* The entry in each lane, NULL if free */
+  KWX T[2 * KW_LANES];
+  KWX B[2 * KW_LANES];
+  SP800_38F_REC *r = NULL;
+  unsigned int next = 0;
+  int active = 0;
+  int k = 0;
+  int m = 0;
+  int lanes = (n < KW_LANES) ? (int)n : KW_LANES;
+  int outl = 0;
+
+  if(0 != (flags & ~(ICC_KW_WRAP | ICC_KW_FORWARD_DECRYPT | ICC_KW_PAD))) {
+    rv = SP800_38F_PARAM;
+    for(next = 0; next < n; next++) {
+      recs[next].outl = 0;
+      recs[next].rv = SP800_38F_PARAM;
+    }
+  }
+  for(k = 0; k < lanes; k++) {
+    lr[k] = NULL;
+  }
+  for(;;) {
+    /* Fill free lanes */
+    for(k = 0; (k < lanes) && (next < n); k++) {
+      if(NULL == lr[k]) {
+	r = &recs[next++];
+	r->outl = 0;
+	st[k].wrap = (flags & ICC_KW_WRAP) ? 1 : 0;
+	st[k].pad = (flags & ICC_KW_PAD) ? 1 : 0;
+	if(st[k].wrap) {
+	  r->rv = KWStart(&st[k],cctx,r->in,r->inl,r->out,&(r->outl));
+	} else {
+	  r->rv = KUStart(&st[k],cctx,r->in,r->inl,r->out,&(r->outl));
+	}
+	if((SP800_38F_OK == r->rv) && (0 == st[k].rounds)) {
+	  r->rv = KWFinish(&st[k]);
+	} else if(SP800_38F_OK == r->rv) {
+	  lr[k] = r;
+	  active++;
+	}
+	if((SP800_38F_OK == rv) && (SP800_38F_OK != r->rv)) {
+	  rv = r->rv;
+	}
+      }
+    }
+    if(0 == active) {
+      break;
+    }
+    /* One round for every lane in flight, the AES blocks in one call */
+    for(k = m = 0; k < lanes; k++) {
+      if(NULL != lr[k]) {
+	KWRoundIn(&st[k],&T[2*m]);
+	m++;
+      }
+    }
+    EVP_CipherUpdate(cctx,(unsigned char *)B,&outl,(unsigned char *)T,m * 16);
+    for(k = m = 0; k < lanes; k++) {
+      if(NULL != lr[k]) {
+	KWRoundOut(&st[k],&B[2*m]);
+	m++;
+	if(st[k].s == st[k].rounds) {
+	  lr[k]->rv = KWFinish(&st[k]);
+	  if((SP800_38F_OK == rv) && (SP800_38F_OK != lr[k]->rv)) {
+	    rv = lr[k]->rv;
+	  }
+	  lr[k] = NULL;
+	  active--;
 	}
-      } else {
-	rv = SP800_38F_MAC;
       }
     }
-    CRYPTO_free(R,__FILE__,__LINE__);
   }
-  if(NULL != cctx) {
-    EVP_CIPHER_CTX_cleanup(cctx);
-    EVP_CIPHER_CTX_free(cctx);
+  if(lanes > 0) {
+    OPENSSL_cleanse(st,lanes * sizeof(KW_STATE));
+    OPENSSL_cleanse(T,lanes * 2 * sizeof(KWX));
+    OPENSSL_cleanse(B,lanes * 2 * sizeof(KWX));
   }
   return rv;
 }
 
+/** @brief Wrap or unwrap on a keyed cipher context
+    @param cctx a cipher context, keyed in the direction UsesEncrypt() 
+    reports for these flags
+    @param in input buffer
+    @param inl length of input buffer
+    @param out output buffer
+    @param outl place to store the output length
+    @param flags the SP800_38F_KW() flags
+    @return as SP800_38F_KW()
+*/
+static int KWop(EVP_CIPHER_CTX *cctx,unsigned char *in, int inl, unsigned char *out, int *outl, unsigned int flags)
+{
+  int rv = SP800_38F_PARAM;
+  KW_STATE st;
+
+  *outl = 0;
+  if(0 == (flags & ~(ICC_KW_WRAP | ICC_KW_FORWARD_DECRYPT | ICC_KW_PAD))) {
+    st.wrap = (flags & ICC_KW_WRAP) ? 1 : 0;
+    st.pad = (flags & ICC_KW_PAD) ? 1 : 0;
+    if(st.wrap) {
+      rv = KWStart(&st,cctx,in,inl,out,outl);
+    } else {
+      rv = KUStart(&st,cctx,in,inl,out,outl);
+    }
+    /* Only one key, nothing to interleave with, so just run the rounds */
+    if(SP800_38F_OK == rv) {
+      if(st.s < st.rounds) {
+	KWRounds(&st,cctx);
+      }
+      rv = KWFinish(&st);
+      OPENSSL_cleanse(&st,sizeof(st));
+    }
+  }
+  return rv;
+}
 
 /*! 
   @brief Key unwrap function, Public API
   @param in input buffer
   @param inl length of input buffer
-  @param out output buffer (length of input +16)
+  @param out output buffer (length of input +16), may be the same buffer as in
   @param outl place to store the output length
   @param key the AES key
   @param kl Size of the AES key (bits)
@@ -515,83 +601,134 @@ static int KU(unsigned char *in, int inl, unsigned char *out, int *outl, unsigne
 */
 int SP800_38F_KW(unsigned char *in, int inl, unsigned char *out, int *outl, unsigned char *key, int kl,unsigned int flags)
 {
-  int rv = 1;
-  switch(flags) {
-    /* Wrap paths */
-  case ICC_KW_WRAP:
-    rv = KW(in,inl,out,outl,key,kl,1,0);
-    break;
-  case ICC_KW_WRAP | ICC_KW_FORWARD_DECRYPT:
-    rv = KW(in,inl,out,outl,key,kl,0,0);
-    break;
-  case ICC_KW_WRAP  |  ICC_KW_PAD:
-    rv = KW(in,inl,out,outl,key,kl,1,1);
-    break;
-  case ICC_KW_WRAP  | ICC_KW_FORWARD_DECRYPT | ICC_KW_PAD:
-    rv = KW(in,inl,out,outl,key,kl,0,1);
-    break;
-    /* Unwrap paths */
-  case 0:
-    rv = KU(in,inl,out,outl,key,kl,1,0);
-    break;
-  case ICC_KW_FORWARD_DECRYPT:
-    rv = KU(in,inl,out,outl,key,kl,0,0);
-    break;
-  case ICC_KW_PAD:
-    rv = KU(in,inl,out,outl,key,kl,1,1);
-    break;
-  case  ICC_KW_FORWARD_DECRYPT | ICC_KW_PAD:
-    rv = KU(in,inl,out,outl,key,kl,0,1);
-    break;
-  default:
-    rv = 0;
-    break;
+  int rv = SP800_38F_PARAM;
+  EVP_CIPHER_CTX *cctx = NULL;
+
+  *outl = 0;
+  if(0 == (flags & ~(ICC_KW_WRAP | ICC_KW_FORWARD_DECRYPT | ICC_KW_PAD))) {
+    cctx = EVP_CIPHER_CTX_new();
+    if(NULL == cctx) {
+      rv = SP800_38F_MEM;
+    } else {
+      rv = CipherInit(cctx,key,kl,UsesEncrypt(flags));
+    }
+    if(SP800_38F_OK == rv) {
+      rv = KWop(cctx,in,inl,out,outl,flags);
+    }
+    if( NULL != cctx ) {
+      EVP_CIPHER_CTX_free(cctx);
+    }
   }
   return rv;
 }
 
+/*! @brief Allocate a reusable key wrap context
+  @return the context or NULL
+*/
+SP800_38F_CTX *SP800_38F_CTX_new(void)
+{
+  SP800_38F_CTX *ctx = NULL;
+
+  ctx = (SP800_38F_CTX *)OPENSSL_malloc(sizeof(SP800_38F_CTX));
+  if(NULL != ctx) {
+    memset(ctx,0,sizeof(SP800_38F_CTX));
+    ctx->enc = EVP_CIPHER_CTX_new();
+    ctx->dec = EVP_CIPHER_CTX_new();
+    if((NULL == ctx->enc) || (NULL == ctx->dec)) {
+      SP800_38F_CTX_free(ctx);
+      ctx = NULL;
+    }
+  }
+  return ctx;
+}
 
-#if defined(STANDALONE)
-void xor(unsigned char *dest, unsigned char *s1, unsigned char *s2, unsigned blen)
+/*! @brief Free a key wrap context, the expanded key is cleared
+  @param ctx the context, may be NULL
+*/
+void SP800_38F_CTX_free(SP800_38F_CTX *ctx)
 {
-  unsigned int i;
-  for(i = 0; i < blen; i++) {
-    dest[i] = s1[i] ^ s2[i];
+  if(NULL != ctx) {
+    if(NULL != ctx->enc) {
+      EVP_CIPHER_CTX_free(ctx->enc);
+    }
+    if(NULL != ctx->dec) {
+      EVP_CIPHER_CTX_free(ctx->dec);
+    }
+    OPENSSL_cleanse(ctx,sizeof(SP800_38F_CTX));
+    OPENSSL_free(ctx);
   }
 }
-void Add_BE(unsigned char *dest,
-         unsigned char *src1,unsigned int s1, 
-         unsigned char *src2,unsigned int s2)
+
+/*! @brief Set the key encryption key, the AES key schedule is 
+  expanded once here for both directions and reused by every
+  following SP800_38F_KW_CTX() call
+  @param ctx a key wrap context
+  @param key the AES key
+  @param kl Size of the AES key (bits)
+  @return 1 O.K., 0 Parameter error
+*/
+int SP800_38F_CTX_Init(SP800_38F_CTX *ctx,unsigned char *key,int kl)
 {
-  unsigned int t = 0,t1 = 0,t2 = 0;
-  int i = 0;
-  unsigned int cy = 0;
-  if(0 == s2) s2 = s1;
-  
-  for(i = 1; i <= (int)s1 ; i++) {
-    t1 = src1[s1-i];
-    t2 = 0;
-    if( ((int)s2 - i) >= 0) {
-      t2 = src2[s2 - i];
+  int rv = SP800_38F_PARAM;
+
+  if((NULL != ctx) && (NULL != key)) {
+    ctx->kl = 0;
+    rv = CipherInit(ctx->enc,key,kl,1);
+    if(SP800_38F_OK == rv) {
+      rv = CipherInit(ctx->dec,key,kl,0);
     }
-    t = t1 + t2 + cy;     
-    cy = 0;
-    if(t > 255 ) {
-      cy = 1;
+    if(SP800_38F_OK == rv) {
+      ctx->kl = kl;
     }
-    dest[s1-i] = t & 0xff;
   }
+  return rv;
 }
 
-void *CRYPTO_calloc(int nmemb, int size,const char *file,int line)
+/*! 
+  @brief Key wrap/unwrap with a keyed context
+  @param ctx a key wrap context set up with SP800_38F_CTX_Init()
+  @param in input buffer
+  @param inl length of input buffer
+  @param out output buffer (length of input +16), may be the same buffer as in
+  @param outl place to store the output length
+  @param flags as SP800_38F_KW()
+  @return as SP800_38F_KW()
+*/
+int SP800_38F_KW_CTX(SP800_38F_CTX *ctx,unsigned char *in, int inl, unsigned char *out, int *outl,unsigned int flags)
 {
-  void *ptr = NULL;
-  ptr = CRYPTO_malloc(nmemb*size,file,line);
-  if(NULL != ptr) {
-    memset(ptr,0,nmemb*size);
+  int rv = SP800_38F_PARAM;
+
+  *outl = 0;
+  if((NULL != ctx) && (0 != ctx->kl)) {
+    rv = KWop(UsesEncrypt(flags) ? ctx->enc : ctx->dec,in,inl,out,outl,flags);
+  }
+  return rv;
+}
+
+/*! 
+  @brief Key wrap/unwrap an array of independent keys under one 
+  key encryption key
+  @param ctx a key wrap context set up with SP800_38F_CTX_Init()
+  @param recs the entries, in, inl and out are input, outl and rv are set
+  @param n the number of entries
+  @param flags as SP800_38F_KW(), applied to every entry
+  @return 1 if every entry was processed O.K., otherwise the error
+  from the first entry that failed. A failure in one entry doesn't
+  stop the rest, check recs[i].rv
+  @note The entries are interleaved, see KWMulti()
+*/
+int SP800_38F_KW_Batch(SP800_38F_CTX *ctx,SP800_38F_REC *recs,unsigned int n,unsigned int flags)
+{
+  int rv = SP800_38F_PARAM;
+
+  if((NULL != ctx) && (0 != ctx->kl) && (NULL != recs)) {
+    rv = KWMulti(UsesEncrypt(flags) ? ctx->enc : ctx->dec,recs,n,flags);
   }
-  return ptr;
+  return rv;
 }
+
+
+#if defined(STANDALONE)
 int main(int argc, char *argv[])
 {
   int rv = 0;
@@ -25,3 +25,28 @@
 */
 int SP800_38F_KW(unsigned char *in, int inl, unsigned char *out, int *outl, unsigned char *key, int kl,unsigned int flags);
 
+/*! @brief A reusable key wrap context, holds the expanded key encryption key
+  for both directions so it's only set up once
+*/
+typedef struct SP800_38F_CTX_t {
+  EVP_CIPHER_CTX *enc;  /*!< AES-ECB keyed for encrypt */
+  EVP_CIPHER_CTX *dec;  /*!< AES-ECB keyed for decrypt */
+  int kl;               /*!< The key length, 0 until a key is set */
+} SP800_38F_CTX;
+
+/*! @brief One entry for SP800_38F_KW_Batch()
+    @note Must match the layout of ICC_SP800_38F_REC in icc.h
+*/
+typedef struct SP800_38F_REC_t {
+  unsigned char *in;   /*!< Input, the key to wrap or the wrapped key */
+  int inl;             /*!< Length of the input */
+  unsigned char *out;  /*!< Output (length of input +16), may be in */
+  int outl;            /*!< Returned, the output length */
+  int rv;              /*!< Returned, the SP800_38F_KW() return code for this entry */
+} SP800_38F_REC;
+
+SP800_38F_CTX *SP800_38F_CTX_new(void);
+void SP800_38F_CTX_free(SP800_38F_CTX *ctx);
+int SP800_38F_CTX_Init(SP800_38F_CTX *ctx,unsigned char *key,int kl);
+int SP800_38F_KW_CTX(SP800_38F_CTX *ctx,unsigned char *in, int inl, unsigned char *out, int *outl,unsigned int flags);
+int SP800_38F_KW_Batch(SP800_38F_CTX *ctx,SP800_38F_REC *recs,unsigned int n,unsigned int flags);
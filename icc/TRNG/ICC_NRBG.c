@@ -103,6 +103,45 @@ int global_trng_type_user_set = 0;
 static void TRNG_LocalCleanup(TRNG *T);
 int fips_rand_bytes(unsigned char *buffer, int num);
 
+/*! Shared NRBG's. With ICC_RNG_SHARED_TRNG=n TRNG_new() hands out one of
+   n reference counted instances per NRBG type instead of creating a new one,
+   so noise source setup, tuning and memory scale with n rather than with
+   the number of DRBG's. Seed requests on a shared instance are serialized
+   by it's mutex, the per instance health tests and CRNG test still apply 
+   to everything it returns.
+   @note TRNG test taps (TRNG_Inst_Type()) use the noise source directly
+   and always get a private instance.
+*/
+#define SHARED_MAX 8   /*!< Upper limit on shared instances per type */
+#define SHARED_TYPES 7 /*!< Slots for TRNG types, >= NTRNGS */
+
+typedef struct {
+  ICC_Mutex mtx;  /*!< Serializes seed generation on t */
+  TRNG *t;        /*!< The shared TRNG, created on first use */
+  int refs;       /*!< Owners of t */
+} SHARED_TRNG;
+
+static int shared_n = 0;              /*!< Shared instances requested per type, 0 off */
+static int shared_ok = 0;             /*!< Table and mutexes are valid */
+static unsigned int shared_next = 0;  /*!< Round robin allocation */
+static ICC_Mutex shared_mtx;          /*!< Protects the table and refs */
+static SHARED_TRNG shared_trng[SHARED_TYPES][SHARED_MAX];
+
+/*! Warm standby NRBG. With ICC_RNG_STANDBY=<NRBG name> a second NRBG of
+   that type is created and health tested at startup and kept ready.
+   If the active source then fails it's health tests, the request is 
+   served from the standby instead, the standby type becomes the default
+   and DRBG's move to it on their next reseed. That avoids a fresh source
+   setup (calibration) on the request path after, for example, live migration.
+   @note In FIPS mode only a FIPS approved type can be the standby.
+   If the standby fails as well the error is fatal, as before.
+*/
+static int standby_type = -1;      /*!< Requested standby type, -1 none */
+static int standby_ok = 0;         /*!< standby and it's mutex are valid */
+static TRNG *standby = NULL;       /*!< The standby NRBG */
+static ICC_Mutex standby_mtx;      /*!< Serializes use of standby */
+static unsigned int failovers = 0; /*!< Requests served by the standby */
+
 /* 
   TRNG works by measuring jitter between instruction execution and a CPU clock. While entropy does
   vary by CPU clock that's a second order effect (the clock rate went up because load was higher and the load
@@ -151,6 +190,54 @@ ENTROPY_IMPL TRNG_ARRAY[] = {
     TRNG_FIPS_Avail,    /*!< availability */
     NULL,
     1
+  },
+  {
+    "TRNG_CPACF",
+    TRNG_CPACF,
+    2,
+    CPACF_getbytes,
+    CPACF_Init,
+    CPACF_Cleanup,
+    CPACF_preinit,
+    CPACF_Avail,
+    NULL,
+    0
+  },
+  {
+    "TRNG_DARN",
+    TRNG_DARN,
+    2,
+    DARN_getbytes,
+    DARN_Init,
+    DARN_Cleanup,
+    DARN_preinit,
+    DARN_Avail,
+    NULL,
+    0
+  },
+  {
+    "TRNG_RNDR",
+    TRNG_RNDR,
+    2,
+    RNDR_getbytes,
+    RNDR_Init,
+    RNDR_Cleanup,
+    RNDR_preinit,
+    RNDR_Avail,
+    NULL,
+    0
+  },
+  {
+    "TRNG_HWRNG",
+    TRNG_HWRNG,
+    2,
+    HWRNG_getbytes,
+    HWRNG_Init,
+    HWRNG_Cleanup,
+    HWRNG_preinit,
+    HWRNG_Avail,
+    NULL,
+    0
   }
 };
 
@@ -287,6 +374,10 @@ TRNG_TYPE SetDefaultTrng(TRNG_TYPE trng) {
   case TRNG_OS:
   case TRNG_HW:
   case TRNG_FIPS:
+  case TRNG_CPACF:
+  case TRNG_DARN:
+  case TRNG_RNDR:
+  case TRNG_HWRNG:
     if(TRNG_ARRAY[trng].avail()) {
       global_trng_type = trng;
       global_trng_type_user_set = 1;
@@ -345,6 +436,7 @@ static TRNG_ERRORS TRNG_ESourceInit(E_SOURCE *es,int e_exp)
   if(NULL != es) {
     memset(es->nbuf,0,sizeof(es->nbuf));
     es->cnt = 0;
+    es->acnt = 0; /* abuf, if any, was freed by the source's cleanup */
     if(NULL != es->impl.avail) {
       if( 0 == (es->impl.avail())) {
         debug(printf("TRNG_ESourceInit:avail=0\n"));
@@ -406,10 +498,11 @@ TRNG_TYPE GetDefaultTrng()
   return global_trng_type;
 }
 /*!
-  @brief return a TRNG context
-  @return an uninitialized TRNG context or NULL if one couldn't be allocated
+  @brief return a TRNG context owned only by the caller, never shared
+  @param type the NRBG type
+  @return an initialized TRNG context or NULL if one couldn't be allocated
 */
-TRNG *TRNG_new(TRNG_TYPE type)
+TRNG *TRNG_new_private(TRNG_TYPE type)
 {
   TRNG *t = NULL;
   TRNG_ERRORS e;
@@ -427,6 +520,117 @@ TRNG *TRNG_new(TRNG_TYPE type)
   }
   return t;
 }
+
+/*! @brief Set the number of shared NRBG instances, see shared_trng
+    Must be called before TRNG_SharedInit()
+    @param n instances per NRBG type, 0 (default) gives each DRBG it's own
+    @return the setting in use
+*/
+int SetSharedTRNG(int n)
+{
+  if(!shared_ok) {
+    if(n < 0) {
+      n = 0;
+    }
+    if(n > SHARED_MAX) {
+      n = SHARED_MAX;
+    }
+    shared_n = n;
+  }
+  return shared_n;
+}
+
+int GetSharedTRNG(void)
+{
+  return shared_n;
+}
+
+/*! @brief Set up the shared NRBG table, a no-op unless enabled 
+    @note single threaded, at library startup
+*/
+void TRNG_SharedInit(void)
+{
+  int i, j;
+  if((shared_n > 0) && !shared_ok) {
+    memset(shared_trng, 0, sizeof(shared_trng));
+    if(0 == ICC_CreateMutex(&shared_mtx)) {
+      shared_ok = 1;
+      for(i = 0; (i < SHARED_TYPES) && shared_ok; i++) {
+        for(j = 0; j < shared_n; j++) {
+          if(0 != ICC_CreateMutex(&(shared_trng[i][j].mtx))) {
+            shared_n = j; /* Use what we managed to create */
+            break;
+          }
+        }
+      }
+      if(0 == shared_n) {
+        shared_ok = 0;
+        ICC_DestroyMutex(&shared_mtx);
+      }
+    }
+  }
+}
+
+/*! @brief Release the shared NRBG's
+    @note single threaded, at library shutdown after the DRBG's are freed.
+    Anything still referenced is left alone.
+*/
+void TRNG_SharedCleanup(void)
+{
+  int i, j, busy = 0;
+  if(shared_ok) {
+    shared_ok = 0;
+    for(i = 0; i < SHARED_TYPES; i++) {
+      for(j = 0; j < shared_n; j++) {
+        if(0 == shared_trng[i][j].refs) {
+          if(NULL != shared_trng[i][j].t) {
+            shared_trng[i][j].t->shared = NULL;
+            TRNG_free(shared_trng[i][j].t);
+            shared_trng[i][j].t = NULL;
+          }
+          ICC_DestroyMutex(&(shared_trng[i][j].mtx));
+        } else {
+          busy = 1;
+        }
+      }
+    }
+    if(!busy) {
+      ICC_DestroyMutex(&shared_mtx);
+      memset(shared_trng, 0, sizeof(shared_trng));
+    }
+  }
+}
+
+/*!
+  @brief return a TRNG context
+  @param type the NRBG type
+  @return an initialized TRNG context or NULL if one couldn't be allocated
+  @note the context may be shared (SetSharedTRNG()), callers must
+  only use it through the TRNG_ API and release it with TRNG_free()
+*/
+TRNG *TRNG_new(TRNG_TYPE type)
+{
+  TRNG *t = NULL;
+  SHARED_TRNG *s = NULL;
+
+  if(shared_ok && ((int)type >= 0) && ((int)type < (int)NTRNGS) && ((int)type < SHARED_TYPES)) {
+    ICC_LockMutex(&shared_mtx);
+    s = &(shared_trng[type][shared_next % shared_n]);
+    shared_next++;
+    if(NULL == s->t) {
+      s->t = TRNG_new_private(type);
+    }
+    if(NULL != s->t) {
+      s->t->shared = s;
+      s->refs++;
+      t = s->t;
+    }
+    ICC_UnlockMutex(&shared_mtx);
+  } else {
+    t = TRNG_new_private(type);
+  }
+  return t;
+}
 /* Return the entropy guarantee, actually the reciprocal of
    how many bytes are required to produce on byte of entropy
 */
@@ -439,6 +643,141 @@ unsigned int TRNG_guarantee(TRNG *T)
   return rv;
 }
 
+unsigned int TRNG_HealthRetries(TRNG *T)
+{
+  return (NULL != T) ? T->econd.retries : 0;
+}
+
+/*! @brief Memory held by one NRBG instance
+    The fixed structure plus the buffers allocated for its noise source 
+    and estimator. OpenSSL's digest and HMAC contexts aren't counted.
+    @param T a pointer to a TRNG structure
+    @return bytes, 0 if T is NULL
+*/
+unsigned int TRNG_Footprint(TRNG *T)
+{
+  unsigned int rv = 0;
+  if(NULL != T) {
+    rv = (unsigned int)sizeof(TRNG) + EntropyEstimatorFootprint(T);
+    if(NULL != T->econd.tf) {
+      rv += (unsigned int)sizeof(T_FILTER);
+    }
+    if(NULL != T->econd.abuf) {
+      rv += E_ESTB_BUFLEN;
+    }
+  }
+  return rv;
+}
+
+/*! @brief Select the warm standby NRBG, must be called before TRNG_StandbyInit()
+    @param name NRBG name (aliases allowed)
+    @return 1 if the name was recognized
+*/
+int SetStandbyTRNGName(char *name)
+{
+  int rv = 0;
+  int i = 0;
+  if(NULL != name) {
+    checkTRNGAlias(&name);
+    for (i = 0; i < TRNG_count(); i++) {
+      if (0 == strcasecmp(name,TRNG_ARRAY[i].name)) {
+        standby_type = TRNG_ARRAY[i].type;
+        rv = 1;
+        break;
+      }
+    }
+  }
+  return rv;
+}
+
+/*! @brief Number of requests the standby NRBG has served
+    @return count since load
+*/
+unsigned int GetTRNGFailovers(void)
+{
+  return failovers;
+}
+
+/*! @brief Create and health test the warm standby NRBG, a no-op unless configured
+    @note single threaded, at library startup
+*/
+void TRNG_StandbyInit(void)
+{
+  unsigned char tmp[SHA_DIGEST_SIZE];
+  TRNG *t = NULL;
+
+  if((standby_type >= 0) && !standby_ok) {
+    if((!FIPS_mode() || isFipsTrng(standby_type)) && TRNG_ARRAY[standby_type].avail()) {
+      t = TRNG_new_private(standby_type);
+      /* Pull a block through the noise health tests now, trng_raw() 
+         reports failure rather than making it fatal
+      */
+      if((NULL != t) && (0 != trng_raw(&(t->econd),tmp,sizeof(tmp)))) {
+        TRNG_free(t);
+        t = NULL;
+      }
+      memset(tmp,0,sizeof(tmp));
+      if(NULL != t) {
+        if(0 == ICC_CreateMutex(&standby_mtx)) {
+          standby = t;
+          standby_ok = 1;
+        } else {
+          TRNG_free(t);
+        }
+      }
+    }
+    if(!standby_ok) {
+      MARK("NRBG standby not available",GetTRNGNameR(standby_type));
+    }
+  }
+}
+
+void TRNG_StandbyCleanup(void)
+{
+  if(standby_ok) {
+    standby_ok = 0;
+    TRNG_free(standby);
+    standby = NULL;
+    ICC_DestroyMutex(&standby_mtx);
+  }
+}
+
+/*! @brief is there a standby that could take over from T
+    @param T the failing NRBG
+    @return !0 if TRNG_Failover() can be tried
+*/
+int TRNG_HasStandby(TRNG *T)
+{
+  return (standby_ok && (NULL != T) && (T != standby));
+}
+
+/*! @brief Serve a seed request from the standby NRBG after T failed
+    @param T the failing NRBG
+    @param data the seed buffer
+    @param len bytes wanted
+    @return 1 if the standby filled the request, 0 otherwise
+*/
+int TRNG_Failover(TRNG *T, unsigned char *data, unsigned int len)
+{
+  int rv = 0;
+  if(TRNG_HasStandby(T)) {
+    ICC_LockMutex(&standby_mtx);
+    /* A failure here is fatal, the standby has no standby */
+    if(TRNG_OK == Entropy_to_TRNG(standby, data, len)) {
+      rv = 1;
+      failovers++;
+    }
+    ICC_UnlockMutex(&standby_mtx);
+    if(rv) {
+      if(GetDefaultTrng() != (TRNG_TYPE)standby_type) {
+        MARK("NRBG failover to",GetTRNGNameR(standby_type));
+        SetDefaultTrng(standby_type);
+      }
+    }
+  }
+  return rv;
+}
+
 /*!
   @brief Clean up a TRNG context.
     - Free associated data structures (which scrub their state)
@@ -494,7 +833,10 @@ TRNG_ERRORS TRNG_TRNG_Init(TRNG *T, TRNG_TYPE type) {
   }
 
   if (NULL != T) {
+    /* A shared instance stays shared across a restart */
+    void *sh = T->shared;
     TRNG_LocalCleanup(T);
+    T->shared = sh;
     e_exp = E_GuarTo_Ein[TRNG_ARRAY[type].e_guarantee];
 
 
@@ -557,7 +899,8 @@ TRNG_ERRORS TRNG_TRNG_Init(TRNG *T, TRNG_TYPE type) {
   /** \FIPS Initialize the TRNG with a time/date
       based personalization string.
       - We reuse the SP800-90 personalization routine
-      the time/date fields PID/TID are early in the data so we do pick those up
+      the per call fields come first, then a hash of the time/date, PID
+      and machine identity
   */
   /* Set up personalization data */
   if (TRNG_OK == rv) {
@@ -587,9 +930,75 @@ TRNG_ERRORS TRNG_TRNG_Init(TRNG *T, TRNG_TYPE type) {
   @param T a context to free
 */
 void TRNG_free(TRNG *T) {
+  SHARED_TRNG *s = NULL;
   if (NULL != T) {
-    TRNG_LocalCleanup(T);
-    ICC_Free(T);
+    s = (SHARED_TRNG *)T->shared;
+    if (NULL != s) {
+      /* Shared, just drop our reference */
+      if (shared_ok) {
+        ICC_LockMutex(&shared_mtx);
+      }
+      s->refs--;
+      if (s->refs <= 0) {
+        s->refs = 0;
+        s->t = NULL;
+      } else {
+        T = NULL;
+      }
+      if (shared_ok) {
+        ICC_UnlockMutex(&shared_mtx);
+      }
+    }
+    if (NULL != T) {
+      TRNG_LocalCleanup(T);
+      ICC_Free(T);
+    }
+  }
+}
+
+/*!
+  @brief
+  Erase the buffered noise/entropy and conditioner key of a TRNG
+  context without freeing anything
+  @param T a context to scrub, may be NULL
+  @note ICC_FAST_EXIT, the context is left allocated but must not be
+  used again. The entropy source implementation isn't called.
+*/
+void TRNG_Scrub(TRNG *T) {
+  if (NULL != T) {
+    OPENSSL_cleanse(T->econd.nbuf, sizeof(T->econd.nbuf));
+    T->econd.cnt = 0;
+    OPENSSL_cleanse(T->econd.abuf, sizeof(T->econd.abuf));
+    T->econd.acnt = 0;
+    OPENSSL_cleanse(T->lastdigest, sizeof(T->lastdigest));
+    OPENSSL_cleanse(T->cond.key, sizeof(T->cond.key));
+    OPENSSL_cleanse(T->cond.rdata, sizeof(T->cond.rdata));
+    if (NULL != T->cond.hctx) {
+      HMAC_CTX_reset(T->cond.hctx);
+    }
+    if (NULL != T->md_ctx) {
+      EVP_MD_CTX_reset(T->md_ctx);
+    }
+    T->initialized = 0;
+  }
+}
+
+/*! @brief Scrub the shared and standby NRBG's in place
+    @note ICC_FAST_EXIT, at process exit, instead of TRNG_StandbyCleanup()
+    and TRNG_SharedCleanup(). Nothing is freed.
+*/
+void TRNG_ExitScrub(void)
+{
+  int i, j;
+  if (shared_ok) {
+    for (i = 0; i < SHARED_TYPES; i++) {
+      for (j = 0; j < shared_n; j++) {
+        TRNG_Scrub(shared_trng[i][j].t);
+      }
+    }
+  }
+  if (standby_ok) {
+    TRNG_Scrub(standby);
   }
 }
 
@@ -605,7 +1014,14 @@ void TRNG_free(TRNG *T) {
 
 TRNG_ERRORS TRNG_GenerateRandomSeed(TRNG *T, int seedLength, void *seed) {
   TRNG_ERRORS rv = TRNG_OK;
-  rv = Entropy_to_TRNG(T, seed, seedLength);
+  SHARED_TRNG *s = (NULL != T) ? (SHARED_TRNG *)T->shared : NULL;
+  if ((NULL != s) && shared_ok) {
+    ICC_LockMutex(&(s->mtx));
+    rv = Entropy_to_TRNG(T, seed, seedLength);
+    ICC_UnlockMutex(&(s->mtx));
+  } else {
+    rv = Entropy_to_TRNG(T, seed, seedLength);
+  }
   return rv;
 }
 
@@ -19,6 +19,10 @@
 #include "TRNG/TRNG_FIPS.h"
 #include "TRNG/TRNG_ALT.h"
 #include "TRNG/TRNG_ALT4.h"
+#include "TRNG/TRNG_CPACF.h"
+#include "TRNG/TRNG_DARN.h"
+#include "TRNG/TRNG_RNDR.h"
+#include "TRNG/TRNG_HWRNG.h"
 
 
  /*!
@@ -84,6 +88,35 @@ void CleanupGlobalTRNG(void);
 */
 TRNG *TRNG_new(TRNG_TYPE type);
 
+/*! @brief
+  Return a TRNG context that is never shared, for callers which use
+  the noise source directly
+  @return NULL or a valid (tested) TRNG context
+*/
+TRNG *TRNG_new_private(TRNG_TYPE type);
+
+/*! @brief Shared NRBG instances per type, 0 disables
+    @param n requested instances
+    @return setting in use
+*/
+int SetSharedTRNG(int n);
+int GetSharedTRNG(void);
+
+/*! @brief setup/release the shared NRBG table */
+void TRNG_SharedInit(void);
+void TRNG_SharedCleanup(void);
+
+/*! @brief Warm standby NRBG
+    @param name NRBG name
+    @return 1 if recognized
+*/
+int SetStandbyTRNGName(char *name);
+unsigned int GetTRNGFailovers(void);
+void TRNG_StandbyInit(void);
+void TRNG_StandbyCleanup(void);
+int TRNG_HasStandby(TRNG *T);
+int TRNG_Failover(TRNG *T, unsigned char *data, unsigned int len);
+
 /*! @brief
   Initialize a TRNG context
   @param T TRNG context
@@ -99,6 +132,14 @@ TRNG_ERRORS TRNG_TRNG_Init(TRNG *T,TRNG_TYPE type);
 */
 void TRNG_free(TRNG *T);
 
+/*!
+  @brief Erase a TRNG context's buffered and conditioner state in place
+  @param T the context to scrub
+*/
+void TRNG_Scrub(TRNG *T);
+/*! @brief Scrub the shared and standby NRBG's, ICC_FAST_EXIT */
+void TRNG_ExitScrub(void);
+
 /*!
   @brief return the type of a TRNG 
   @return the TRNG type
@@ -133,5 +174,13 @@ int my_GenerateRandomSeed(int num, unsigned char * buf);
 */
 unsigned int TRNG_guarantee(TRNG *T);
 
+/*! @brief return the number of noise buffers T has discarded for low entropy
+    @param T a pointer to a TRNG structure
+    @return the count, 0 if T is NULL
+*/
+unsigned int TRNG_HealthRetries(TRNG *T);
+
+unsigned int TRNG_Footprint(TRNG *T);
+
 #endif
 
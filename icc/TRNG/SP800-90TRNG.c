@@ -68,7 +68,7 @@ SP800_90STATE TRNG_Inst_Type(PRNG_CTX *ctx,
     TRNG_free(tctx->trng);
     tctx->trng = NULL;
   }
-  tctx->trng = TRNG_new(type);
+  tctx->trng = TRNG_new_private(type); /* We read the noise source directly, don't share it */
   if((NULL ==  tctx->trng) ) {
     tctx->state = SP800_90CRIT;
     tctx->error_reason = ERRAT(SP800_90_NOT_INIT);
@@ -29,6 +29,7 @@
 #undef WIN32_NO_STATUS
 #endif
 
+#include "platform_api.h"
 #include "TRNG/nist_algs.h"
 #include "TRNG/TRNG_ALT.h"
 #include "induced.h"
@@ -37,18 +38,115 @@
 #include <bcrypt.h>
 #include "ntstatus.h"
 #endif
+#if defined(__linux)
+#include <errno.h>
+#include <sys/syscall.h>
+#if defined(SYS_getrandom)
+#define ALT_GETRANDOM 1
+#if !defined(GRND_NONBLOCK)
+#define GRND_NONBLOCK 0x0001
+#endif
+#endif
+#endif
 
+/* fd_alt is an open fd, or one of these */
+#define ALT_NONE -1      /*!< No source found (yet) */
+#define ALT_BCRYPT -3    /*!< Windows BCryptGenRandom() */
+#define ALT_SYSCALL -4   /*!< Linux getrandom(), no fd needed */
 
-static int fd_alt = -1;
+static int fd_alt = ALT_NONE;
+static int fd_dev = -1; /*!< /dev/urandom fallback if getrandom() stops working, opened by ALT_Init() */
+static unsigned int alt_gen = 0; /*!< Bumped to invalidate every prefetch buffer */
+static ICC_Mutex src_mtx;   /*!< Serializes finding and opening the OS sources, TRNG_ALT and TRNG_HWRNG */
+static int src_mtx_ok = 0;  /*!< src_mtx is valid */
 
-/*! Pre-init function for TRNG_ALT
+/*! @brief Create the lock which serializes opening the OS sources
+    @note single threaded, at library load before any NRBG exists
+*/
+void ALT_Setup(void)
+{
+  if(!src_mtx_ok && (0 == ICC_CreateMutex(&src_mtx))) {
+    src_mtx_ok = 1;
+  }
+}
+
+/*! @brief Take the OS source setup lock, see ALT_Setup() */
+void ALT_Lock(void)
+{
+  if(src_mtx_ok) {
+    ICC_LockMutex(&src_mtx);
+  }
+}
+
+/*! @brief Release the OS source setup lock */
+void ALT_Unlock(void)
+{
+  if(src_mtx_ok) {
+    ICC_UnlockMutex(&src_mtx);
+  }
+}
 
+/*! Pre-init function for TRNG_ALT
+    @param reinit if !0 (i.e. after fork()) discard any prefetched data
 */
 
 void ALT_preinit(int reinit)
 {
-  
+  if (reinit) {
+    alt_gen++;
+  }
+}
+
+/*! @brief open the /dev source
+    @return fd or -1
+*/
+static int alt_open_dev()
+{
+  int fd = -1;
+#if !defined(_WIN32)
+  fd = open("/dev/urandom",O_RDONLY);
+  if(-1 == fd) {
+    fd = open("/dev/random",O_RDONLY);
+  }
+#endif
+  return fd;
+}
+
+/*! @brief read from an fd, some OS's limit the size of reads from
+    /dev/(u)random ==> HPUX
+    @return TRNG_OK or TRNG_REQ_SIZE
+*/
+static TRNG_ERRORS alt_read_fd(int fd,unsigned char *buffer,int k)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+#if !defined(_WIN32)
+  int i = 0;
+  while(k > 0) {
+    i = read(fd,buffer,k);
+    k -= i;
+    if((i > 0) && (k != 0) ) {
+      buffer += i;
+      continue;
+    } else {
+      if (k != 0) {
+        rv = TRNG_REQ_SIZE;
+      }
+      break;
+    }
+  }
+#endif
+  return rv;
+}
+
+#if defined(ALT_GETRANDOM)
+/*! @brief getrandom() without needing a libc that exports it
+    @return bytes read or -1 with errno set
+*/
+static long alt_getrandom(unsigned char *buffer,int n)
+{
+  return syscall(SYS_getrandom, buffer, (size_t)n, GRND_NONBLOCK);
 }
+#endif
 
 
 
@@ -76,18 +174,19 @@ int ALT_Avail()
   @param buffer the scratch buffer to fill
   @param n the size of the buffer
  */
-static int alt_read(unsigned char *buffer,int n)
+static TRNG_ERRORS alt_read(unsigned char *buffer,int n)
 {
   TRNG_ERRORS rv = TRNG_OK;
-#if !defined(_WIN32)
-  int i = 0,k = n;
+#if defined(ALT_GETRANDOM)
+  long i = 0;
+  int k = n;
 #endif
 
   memset(buffer,0,n); /* If all else fails, return 0's */
   switch(fd_alt) {
-  case -1: /* No PRNG source was found originally */
+  case ALT_NONE: /* No PRNG source was found originally */
     break;
-  case -3:
+  case ALT_BCRYPT:
 #if defined(_WIN32)
     NTSTATUS status = 0;
     status = BCryptGenRandom(BCRYPT_RNG_ALG_HANDLE, (PUCHAR)buffer, n, 0);
@@ -96,22 +195,31 @@ static int alt_read(unsigned char *buffer,int n)
     }
 #endif
     break;
-  default:
-#if !defined(_WIN32)
-  /* Some OS's limit the size of reads from /dev/(u)random ==> HPUX */
-   while(k > 0) {
-    i = read(fd_alt,buffer,k);
-    k -= i;
-    if((i > 0) && (k != 0) ) {
-      buffer += i;
-      continue;
-    } else {
-      rv = TRNG_REQ_SIZE;
-      break;
+  case ALT_SYSCALL:
+#if defined(ALT_GETRANDOM)
+    while(k > 0) {
+      i = alt_getrandom(buffer,k);
+      if(i > 0) {
+        buffer += i;
+        k -= (int)i;
+      } else if((i < 0) && (EINTR == errno)) {
+        continue;
+      } else {
+        /* Blocked by seccomp, or the pool isn't ready, use the device 
+           ALT_Init() opened */
+        if(-1 == fd_dev) {
+          rv = TRNG_REQ_SIZE;
+        } else {
+          rv = alt_read_fd(fd_dev,buffer,k);
+        }
+        break;
+      }
     }
-  }
 #endif
     break;
+  default:
+    rv = alt_read_fd(fd_alt,buffer,n);
+    break;
   }
   return rv;
 }
@@ -121,6 +229,7 @@ TRNG_ERRORS ALT_Init(E_SOURCE *E, unsigned char *pers, int perl)
 
   TRNG_ERRORS rv = TRNG_OK;
 
+  ALT_Lock();
   /* Else probe for something else */
   if(-1 == fd_alt) {
 #if defined(_WIN32)
@@ -139,16 +248,29 @@ TRNG_ERRORS ALT_Init(E_SOURCE *E, unsigned char *pers, int perl)
     }
 #else
     /* On Unix .... */
-    fd_alt = open("/dev/urandom",O_RDONLY);
-    if(-1 == fd_alt) {
-      fd_alt = open("/dev/random",O_RDONLY);
+#if defined(ALT_GETRANDOM)
+    unsigned char tmp[16];
+    if(sizeof(tmp) == alt_getrandom(tmp,sizeof(tmp))) {
+      fd_alt = ALT_SYSCALL;
     }
+    memset(tmp,0,sizeof(tmp));
+    if(ALT_NONE == fd_alt)
+#endif
+    fd_alt = alt_open_dev();
 #endif
   }
   /* If there's no /dev/ source, we'll return an error */
   if(-1 == fd_alt) {
     rv = TRNG_INIT;
   }
+#if defined(ALT_GETRANDOM)
+  /* Open the fallback for getrandom() now, under the lock, 
+     alt_read() only ever reads it */
+  if((ALT_SYSCALL == fd_alt) && (-1 == fd_dev)) {
+    fd_dev = alt_open_dev();
+  }
+#endif
+  ALT_Unlock();
 
   /*! \induced 203. TRNG_ALT external entropy source not available
    */
@@ -164,6 +286,80 @@ TRNG_ERRORS ALT_Init(E_SOURCE *E, unsigned char *pers, int perl)
 
 
 
+/*!
+ @brief Serve reads from an OS source through a prefetch in E->abuf,
+ shared by TRNG_ALT and TRNG_HWRNG so small reads don't each cost a
+ syscall. Reads of E_ESTB_BUFLEN or more, or without E, go straight
+ to the source. The prefetch is never reused across fork() or a 
+ change of generation, bytes are erased from it as they're handed out.
+ @param E Entropy source (optional), E->abuf is allocated on first use
+ @param gen the source's generation, bumped by it's preinit(1)
+ @param rd reads exactly n bytes from the source
+ @param buffer buffer for data
+ @param len size of buffer
+ @return status, on failure buffer is zeroed
+*/
+TRNG_ERRORS ALT_Prefetch(E_SOURCE *E,unsigned int gen,
+                         TRNG_ERRORS (*rd)(unsigned char *,int),
+                         unsigned char *buffer,int len)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+  unsigned long pid = 0;
+  int k = 0;
+  int n = len;
+  unsigned char *out = buffer;
+
+  if((NULL != E) && (NULL == E->abuf) && (len < E_ESTB_BUFLEN)) {
+    E->abuf = (unsigned char *)ICC_Calloc(1, E_ESTB_BUFLEN, __FILE__, __LINE__);
+    E->acnt = 0;
+  }
+  if((NULL == E) || (NULL == E->abuf) || (len >= E_ESTB_BUFLEN)) {
+    rv = (*rd)(buffer,len);
+  } else {
+    pid = (unsigned long)ICC_GetProcessId();
+    if((E->agen != gen) || (E->apid != pid)) {
+      memset(E->abuf,0,E_ESTB_BUFLEN);
+      E->acnt = 0;
+      E->agen = gen;
+      E->apid = pid;
+    }
+    while((TRNG_OK == rv) && (n > 0)) {
+      if(0 == E->acnt) {
+        rv = (*rd)(E->abuf,E_ESTB_BUFLEN);
+        if(TRNG_OK != rv) {
+          memset(E->abuf,0,E_ESTB_BUFLEN);
+          break;
+        }
+        E->acnt = E_ESTB_BUFLEN;
+      }
+      k = (n < E->acnt) ? n : E->acnt;
+      memcpy(out,E->abuf + E_ESTB_BUFLEN - E->acnt,k);
+      /* Don't keep what we've handed out */
+      memset(E->abuf + E_ESTB_BUFLEN - E->acnt,0,k);
+      E->acnt -= k;
+      out += k;
+      n -= k;
+    }
+  }
+  if((TRNG_OK != rv) && (len > 0)) {
+    memset(buffer,0,len);
+  }
+  return rv;
+}
+
+/*! @brief Free the prefetch from ALT_Prefetch()
+  @param E The entropy source data structure
+*/
+void ALT_PrefetchFree(E_SOURCE *E)
+{
+  if((NULL != E) && (NULL != E->abuf)) {
+    memset(E->abuf,0,E_ESTB_BUFLEN);
+    ICC_Free(E->abuf);
+    E->abuf = NULL;
+    E->acnt = 0;
+  }
+}
+
 /*!
  @brief get a byte of random data.
  @param E Entropy filter (optional)
@@ -180,7 +376,7 @@ TRNG_ERRORS ALT_getbytes(E_SOURCE *E,unsigned char *buffer, int len)
 {
   TRNG_ERRORS rv = TRNG_OK;
 
-  rv = alt_read(buffer,len); /* Read from the primary source */
+  rv = ALT_Prefetch(E,alt_gen,alt_read,buffer,len);
 
   /*! \induced 221. TRNG_ALT. Fake the failure condition 
 	  from the OS RNG source
@@ -203,6 +399,8 @@ TRNG_ERRORS ALT_Cleanup(E_SOURCE *E)
 
   TRNG_ERRORS rv = TRNG_OK;
 
+  ALT_PrefetchFree(E);
+
   return rv;
 }
 
@@ -212,8 +410,16 @@ void ALT_Final()
 #if !defined(_WIN32)
   if(fd_alt >= 0) {
     close(fd_alt);
-    fd_alt = -1;
+  }
+  fd_alt = ALT_NONE;
+  if(fd_dev >= 0) {
+    close(fd_dev);
+    fd_dev = -1;
   }
 #endif
+  if(src_mtx_ok) {
+    src_mtx_ok = 0;
+    ICC_DestroyMutex(&src_mtx);
+  }
 
 }
@@ -28,5 +28,19 @@ TRNG_ERRORS ALT_getbytes(E_SOURCE *E,unsigned char *buffer,int len );
 
 TRNG_ERRORS ALT_Cleanup(E_SOURCE *E);
 
+void ALT_Setup(void);
+
+void ALT_Lock(void);
+
+void ALT_Unlock(void);
+
+TRNG_ERRORS ALT_Prefetch(E_SOURCE *E,unsigned int gen,
+                         TRNG_ERRORS (*rd)(unsigned char *,int),
+                         unsigned char *buffer,int len);
+
+void ALT_PrefetchFree(E_SOURCE *E);
+
+void ALT_Final(void);
+
 
 #endif
@@ -23,9 +23,101 @@
 #include "TRNG/timer_entropy.h"
 #include "TRNG/TRNG_ALT4.h"
 #include "induced.h"
+#include "cpufeat.h"
+#include "TRNG/hw_entropy.h"
 
 int OPENSSL_HW_rand(unsigned char *buf);
 
+/* Bulk mode, hardware entropy instructions issued directly.
+   RDSEED (x86_64), DARN (POWER9+), RNDRRS (ARMv8.5)
+   Only with gcc compatible compilers, everything else always uses
+   OPENSSL_HW_rand()
+*/
+#if defined(__GNUC__) && defined(__x86_64__)
+#define ALT4_BULK 1
+#elif defined(__GNUC__) && defined(__linux__) && defined(__powerpc64__)
+#define ALT4_BULK 1
+#elif defined(__GNUC__) && defined(__linux__) && defined(__aarch64__)
+#define ALT4_BULK 1
+#endif
+
+static int alt4_bulk = 0;     /*!< Bulk sub-mode requested */
+static int alt4_bulk_hw = -1; /*!< -1 unknown, 0 no, 1 instruction present */
+
+#if defined(ALT4_BULK)
+/*! @brief Probe for the entropy instruction
+    @return 1 if present
+*/
+static int bulk_probe()
+{
+  return (0 != (OS_CpuFeatures() & (ICC_CPUF_RDSEED | ICC_CPUF_DARN | ICC_CPUF_RNDR)));
+}
+
+/*! @brief One word from the hardware entropy instruction
+    @param v where to put it
+    @return 1 on success, 0 if the hardware stayed empty for HW_ENTROPY_RETRIES tries
+*/
+static int bulk_word(unsigned long long *v)
+{
+  int ok = 0;
+#if defined(HW_ENTROPY_RDSEED)
+  ok = hw_rdseed_word(v);
+#elif defined(HW_ENTROPY_DARN)
+  ok = hw_darn_word(v);
+#elif defined(HW_ENTROPY_RNDR)
+  ok = hw_rndr_word(v);
+#endif
+  return ok;
+}
+
+/*! @brief fill a buffer with back to back hardware reads
+    @param buffer output
+    @param n bytes wanted
+    @return bytes filled, short if the hardware stayed empty for HW_ENTROPY_RETRIES tries
+*/
+static int bulk_read(unsigned char *buffer,int n)
+{
+  unsigned long long v = 0;
+  int done = 0;
+  int k = 0;
+
+  while(done < n) {
+    if(!bulk_word(&v)) {
+      break;
+    }
+    k = n - done;
+    if(k > (int)sizeof(v)) {
+      k = sizeof(v);
+    }
+    memcpy(buffer + done,&v,k);
+    done += k;
+  }
+  v = 0;
+  return done;
+}
+#endif
+
+/*! @brief Select bulk gathering for TRNG_HW
+    @param on !0 to issue the hardware entropy instructions directly
+    @return 1 if bulk mode is now active, 0 if not supported here
+*/
+int ALT4_SetBulk(int on)
+{
+  alt4_bulk = 0;
+#if defined(ALT4_BULK)
+  if(-1 == alt4_bulk_hw) {
+    alt4_bulk_hw = bulk_probe();
+  }
+  alt4_bulk = (on && alt4_bulk_hw);
+#endif
+  return alt4_bulk;
+}
+
+int ALT4_GetBulk()
+{
+  return alt4_bulk;
+}
+
 
 /*! @brief Pre-init function for TRNG_ALT4
     @param reinit if !0 reinitialize everything
@@ -53,6 +145,15 @@ static void alt4_read(unsigned char *buffer,int n)
   int i = 0;
   unsigned char x[sizeof(size_t)];
   memset(x,0,sizeof(x)); 
+#if defined(ALT4_BULK)
+  if(alt4_bulk) {
+    /* Anything the bulk path couldn't supply comes from the slow path below */
+    i = bulk_read(buffer,n);
+    buffer += i;
+    n -= i;
+    i = 0;
+  }
+#endif
   while(n > 0 ) {
     i = OPENSSL_HW_rand(&x[0]);
     for( ; i > 0 && n > 0; ) {
@@ -27,5 +27,9 @@ TRNG_ERRORS ALT4_getbytes(E_SOURCE *E,unsigned char *buf,int len );
 
 TRNG_ERRORS ALT4_Cleanup(E_SOURCE *T);
 
+int ALT4_SetBulk(int on);
+
+int ALT4_GetBulk();
+
 
 #endif
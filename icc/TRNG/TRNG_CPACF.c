@@ -0,0 +1,136 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Use the z Systems CPACF TRNG directly.
+//
+*************************************************************************/
+
+/*!
+  \FIPS TRNG_CPACF
+   This entropy source uses the PRNO TRNG function of the CPACF
+   (z14 and later) to provide entropy. A seed request is one 
+   instruction rather than timer sampling or one call per word.
+   The normal NRBG health tests and conditioning still apply.
+*/
+
+#include <stdio.h>
+#include "platform.h"
+#include "TRNG/TRNG_CPACF.h"
+#include "induced.h"
+#include "cpufeat.h"
+
+/* Inline asm only with gcc compatible compilers on Linux,
+   z/OS and everything else report the source as unavailable
+*/
+#if defined(__GNUC__) && defined(__s390__) && defined(__linux__)
+#define CPACF_PRNO 1
+#endif
+
+#define PRNO_TRNG 114 /*!< PRNO function code, TRNG */
+
+#if defined(CPACF_PRNO)
+/*! @brief PRNO TRNG, conditioned output only
+    @param buffer output
+    @param n bytes wanted
+    @note The instruction may complete partially (cc 3), in which
+    case it's reissued with the updated registers until done.
+*/
+static void prno_trng(unsigned char *buffer,unsigned long n)
+{
+  register unsigned long r0 asm("r0") = PRNO_TRNG;
+  register unsigned char *r2 asm("r2") = NULL; /* Raw output, not wanted */
+  register unsigned long r3 asm("r3") = 0;
+  register unsigned char *r4 asm("r4") = buffer;
+  register unsigned long r5 asm("r5") = n;
+
+  __asm__ __volatile__("0: .insn rre,0xb93c0000,2,4\n"
+                       "   brc 1,0b\n"
+                       : "+d"(r2), "+d"(r3), "+d"(r4), "+d"(r5)
+                       : "d"(r0)
+                       : "cc", "memory");
+}
+#endif
+
+/*! @brief Pre-init function for TRNG_CPACF
+    @param reinit if !0 reinitialize everything
+*/
+void CPACF_preinit(int reinit)
+{
+
+}
+
+/*! @brief
+  Determine whether this noise source is available
+  @return 0 is not available , !0 if available
+  @note This honours ICC_CAP_MASK, masking the TRNG capability 
+  bit disables this source.
+*/
+int CPACF_Avail()
+{
+  int rv = 0;
+#if defined(CPACF_PRNO)
+  rv = (0 != (OS_CpuFeatures() & ICC_CPUF_CPACF_TRNG));
+#endif
+  return rv;
+}
+
+/*! @brief Initialise
+    @param E pointer to an E_SOURCE struct
+    @param pers Optional personalisation data
+    @param perl length of personalisation data
+    @return status
+*/    
+TRNG_ERRORS CPACF_Init(E_SOURCE *E, unsigned char *pers, int perl)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+
+  if(!CPACF_Avail()) {
+    rv = TRNG_INIT;
+  }
+  return rv;
+}
+
+/*!
+ @brief get entropy from the CPACF TRNG
+ @param E pointer to an E_SOURCE struct
+ @param buffer buffer to fill with data
+ @param len length of requested data
+ @return status
+*/
+TRNG_ERRORS CPACF_getbytes(E_SOURCE *E,unsigned char *buffer,int len )
+{
+  TRNG_ERRORS rv = TRNG_OK;
+
+  if(len <= 0) {
+    rv = TRNG_REQ_SIZE;
+  } else {
+#if defined(CPACF_PRNO)
+    prno_trng(buffer,(unsigned long)len);
+#else
+    rv = TRNG_INIT;
+#endif
+    /*! \induced 223. TRNG_CPACF. Fake failure of HW source
+     */ 
+    if(223 == icc_failure) {
+      memset(buffer,0x5A,len);
+    }
+  }
+  return rv;
+}
+
+/*! @brief Cleanup any residual information in this entropy source 
+  @param E The entropy source data structure
+  @return TRNG_OK
+ */
+TRNG_ERRORS CPACF_Cleanup(E_SOURCE *E)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+
+  return rv;
+}
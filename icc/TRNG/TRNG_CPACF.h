@@ -0,0 +1,31 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Header for TRNG_CPACF
+//
+*************************************************************************/
+
+#if !defined(TRNG_CPACF_H)
+#define TRNG_CPACF_H
+
+#include "noise_to_entropy.h"
+
+
+void CPACF_preinit(int reinit);
+
+int CPACF_Avail();
+
+TRNG_ERRORS CPACF_Init(E_SOURCE *E, unsigned char *pers, int perl);
+
+TRNG_ERRORS CPACF_getbytes(E_SOURCE *E,unsigned char *buf,int len );
+
+TRNG_ERRORS CPACF_Cleanup(E_SOURCE *T);
+
+
+#endif
@@ -0,0 +1,129 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Use the POWER9 DARN instruction directly.
+//
+*************************************************************************/
+
+/*!
+  \FIPS TRNG_DARN
+   This entropy source uses the POWER9 and later DARN (Deliver A 
+   Random Number) instruction to provide entropy, 64 bits per 
+   instruction rather than timer sampling via mftb.
+   The normal NRBG health tests and conditioning still apply.
+*/
+
+#include <stdio.h>
+#include "platform.h"
+#include "TRNG/TRNG_DARN.h"
+#include "induced.h"
+#include "cpufeat.h"
+#include "TRNG/hw_entropy.h"
+
+/* Inline asm only with gcc compatible compilers on Linux,
+   AIX and everything else report the source as unavailable
+*/
+#if defined(__GNUC__) && defined(__powerpc64__) && defined(__linux__)
+#define DARN_INSN 1
+#endif
+
+/*! @brief Pre-init function for TRNG_DARN
+    @param reinit if !0 reinitialize everything
+*/
+void DARN_preinit(int reinit)
+{
+
+}
+
+/*! @brief
+  Determine whether this noise source is available
+  @return 0 is not available , !0 if available
+*/
+int DARN_Avail()
+{
+  int rv = 0;
+#if defined(DARN_INSN)
+  rv = (0 != (OS_CpuFeatures() & ICC_CPUF_DARN));
+#endif
+  return rv;
+}
+
+/*! @brief Initialise
+    @param E pointer to an E_SOURCE struct
+    @param pers Optional personalisation data
+    @param perl length of personalisation data
+    @return status
+*/    
+TRNG_ERRORS DARN_Init(E_SOURCE *E, unsigned char *pers, int perl)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+
+  if(!DARN_Avail()) {
+    rv = TRNG_INIT;
+  }
+  return rv;
+}
+
+/*!
+ @brief get entropy from DARN
+ @param E pointer to an E_SOURCE struct
+ @param buffer buffer to fill with data
+ @param len length of requested data
+ @return status
+ @note If the hardware stays empty for HW_ENTROPY_RETRIES tries the rest 
+ of the buffer is zeroed so it fails the entropy check in the NRBG layer
+*/
+TRNG_ERRORS DARN_getbytes(E_SOURCE *E,unsigned char *buffer,int len )
+{
+  TRNG_ERRORS rv = TRNG_OK;
+
+  if(len <= 0) {
+    rv = TRNG_REQ_SIZE;
+  } else {
+#if defined(DARN_INSN)
+    unsigned long long v = 0;
+    int done = 0;
+    int k = 0;
+
+    while(done < len) {
+      if(!hw_darn_word(&v)) {
+        memset(buffer + done,0,len - done);
+        rv = TRNG_ENTROPY;
+        break;
+      }
+      k = len - done;
+      if(k > (int)sizeof(v)) {
+        k = sizeof(v);
+      }
+      memcpy(buffer + done,&v,k);
+      done += k;
+    }
+    v = 0;
+#else
+    rv = TRNG_INIT;
+#endif
+    /*! \induced 224. TRNG_DARN. Fake failure of HW source
+     */ 
+    if(224 == icc_failure) {
+      memset(buffer,0x5A,len);
+    }
+  }
+  return rv;
+}
+
+/*! @brief Cleanup any residual information in this entropy source 
+  @param E The entropy source data structure
+  @return TRNG_OK
+ */
+TRNG_ERRORS DARN_Cleanup(E_SOURCE *E)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+
+  return rv;
+}
@@ -0,0 +1,31 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Header for TRNG_DARN
+//
+*************************************************************************/
+
+#if !defined(TRNG_DARN_H)
+#define TRNG_DARN_H
+
+#include "noise_to_entropy.h"
+
+
+void DARN_preinit(int reinit);
+
+int DARN_Avail();
+
+TRNG_ERRORS DARN_Init(E_SOURCE *E, unsigned char *pers, int perl);
+
+TRNG_ERRORS DARN_getbytes(E_SOURCE *E,unsigned char *buf,int len );
+
+TRNG_ERRORS DARN_Cleanup(E_SOURCE *T);
+
+
+#endif
@@ -30,19 +30,26 @@ int TRNG_FIPS_Avail()
  */
 void TRNG_FIPS_preinit(int reinit)
 {
-
+  FilterMemSelect();
 }
 
 /*! @brief Initialize the default TRNG instance
   @param E a pointer to the internal E_SOURCE object
   @param pers a pointer to personalization data - if needed
   @param perl length of personalization data provided
-  @note a No-op in this case
+  @note Allocates the timer filter state, only this source needs it
 */
 TRNG_ERRORS TRNG_FIPS_Init(E_SOURCE *E, unsigned char *pers, int perl)
 {
   TRNG_ERRORS rv = TRNG_OK;
-  T_FILTER_Init(&(E->tf));
+  if(NULL == E->tf) {
+    E->tf = (T_FILTER *)ICC_Calloc(1, sizeof(T_FILTER), __FILE__, __LINE__);
+  }
+  if(NULL == E->tf) {
+    rv = TRNG_MEM;
+  } else {
+    T_FILTER_Init(E->tf);
+  }
 
   return rv;
 }
@@ -90,8 +97,10 @@ TRNG_ERRORS TRNG_FIPS_getbytes(E_SOURCE *E,unsigned char *buffer,int len)
 */
 TRNG_ERRORS TRNG_FIPS_Cleanup(E_SOURCE *E)
 {
-  if(NULL != E ) {
-    T_FILTER_Init(&(E->tf));
+  if((NULL != E) && (NULL != E->tf)) {
+    T_FILTER_Init(E->tf);
+    ICC_Free(E->tf);
+    E->tf = NULL;
   }
    return TRNG_OK;
 }
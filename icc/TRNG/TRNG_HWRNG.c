@@ -0,0 +1,175 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Use the kernel hwrng device, virtio-rng in a VM.
+//
+*************************************************************************/
+
+/*!
+  \FIPS TRNG_HWRNG
+   This entropy source reads /dev/hwrng, which is the host's entropy
+   passed through virtio-rng in most VM's, rather than timer sampling.
+   Hypervisors coarsen the timers the FIPS source depends on, this 
+   doesn't care.
+   Small reads share TRNG_ALT's prefetch, ALT_Prefetch(), each byte is
+   handed out once and never reused across fork() or HWRNG_preinit(1).
+   The normal NRBG health tests and conditioning still apply.
+*/
+
+#include <stdio.h>
+#include "platform.h"
+#include "platform_api.h"
+#include "TRNG/TRNG_HWRNG.h"
+#include "TRNG/TRNG_ALT.h"
+#include "induced.h"
+
+#if defined(__linux__)
+#include <errno.h>
+#define HWRNG_DEV "/dev/hwrng"
+#endif
+
+static int fd_hwrng = -1;          /*!< /dev/hwrng, -1 not open */
+static int hwrng_ok = -1;          /*!< -1 not probed, 0 unusable, 1 O.K. Under ALT_Lock() */
+static unsigned int hwrng_gen = 0; /*!< Bumped to invalidate every prefetch buffer */
+
+/*! @brief read n bytes from /dev/hwrng
+    @param buffer where to put them
+    @param n bytes wanted
+    @return TRNG_OK or TRNG_REQ_SIZE
+*/
+static TRNG_ERRORS hwrng_read(unsigned char *buffer,int n)
+{
+  TRNG_ERRORS rv = TRNG_REQ_SIZE;
+#if defined(HWRNG_DEV)
+  long i = 0;
+
+  rv = TRNG_OK;
+  while(n > 0) {
+    i = read(fd_hwrng,buffer,n);
+    if(i > 0) {
+      buffer += i;
+      n -= (int)i;
+    } else if((i < 0) && (EINTR == errno)) {
+      continue;
+    } else {
+      rv = TRNG_REQ_SIZE;
+      break;
+    }
+  }
+#endif
+  return rv;
+}
+
+/*! @brief Pre-init function for TRNG_HWRNG
+    @param reinit if !0 (i.e. after fork()) discard any prefetched data
+*/
+void HWRNG_preinit(int reinit)
+{
+  if(reinit) {
+    hwrng_gen++;
+  }
+}
+
+/*! @brief
+  Determine whether this noise source is available, there has to be
+  a hwrng device with a backend that returns data
+  @return 0 is not available , !0 if available
+*/
+int HWRNG_Avail()
+{
+  int rv = 0;
+#if defined(HWRNG_DEV)
+  unsigned char tmp[16];
+  int fd = -1;
+
+  /* Probed and opened once, by whichever NRBG gets here first */
+  ALT_Lock();
+  if(-1 == hwrng_ok) {
+    hwrng_ok = 0;
+    fd = open(HWRNG_DEV,O_RDONLY);
+    if(-1 != fd) {
+      fd_hwrng = fd;
+      if(TRNG_OK == hwrng_read(tmp,sizeof(tmp))) {
+        hwrng_ok = 1;
+      } else {
+        close(fd_hwrng);
+        fd_hwrng = -1;
+      }
+    }
+    memset(tmp,0,sizeof(tmp));
+  }
+  rv = (1 == hwrng_ok);
+  ALT_Unlock();
+#endif
+  return rv;
+}
+
+/*! @brief Initialise
+    @param E pointer to an E_SOURCE struct
+    @param pers Optional personalisation data
+    @param perl length of personalisation data
+    @return status
+*/    
+TRNG_ERRORS HWRNG_Init(E_SOURCE *E, unsigned char *pers, int perl)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+
+  if(!HWRNG_Avail()) {
+    rv = TRNG_INIT;
+  }
+  return rv;
+}
+
+/*!
+ @brief get entropy from /dev/hwrng
+ @param E pointer to an E_SOURCE struct
+ @param buffer buffer to fill with data
+ @param len length of requested data
+ @return status
+ @note If the device fails the rest of the buffer is zeroed so it 
+ fails the entropy check in the NRBG layer
+*/
+TRNG_ERRORS HWRNG_getbytes(E_SOURCE *E,unsigned char *buffer,int len )
+{
+  TRNG_ERRORS rv = TRNG_REQ_SIZE;
+
+  if(len > 0) {
+    rv = ALT_Prefetch(E,hwrng_gen,hwrng_read,buffer,len);
+  }
+  /*! \induced 226. TRNG_HWRNG. Fake failure of the hwrng device
+   */ 
+  if((len > 0) && (226 == icc_failure)) {
+    memset(buffer,0x5A,len);
+  }
+  return rv;
+}
+
+/*! @brief Cleanup any residual information in this entropy source 
+  @param E The entropy source data structure
+  @return TRNG_OK
+ */
+TRNG_ERRORS HWRNG_Cleanup(E_SOURCE *E)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+
+  ALT_PrefetchFree(E);
+  return rv;
+}
+
+/*! @brief Close /dev/hwrng, at library unload */
+void HWRNG_Final(void)
+{
+#if defined(HWRNG_DEV)
+  if(fd_hwrng >= 0) {
+    close(fd_hwrng);
+  }
+#endif
+  fd_hwrng = -1;
+  hwrng_ok = -1;
+}
@@ -0,0 +1,32 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Header for TRNG_HWRNG
+//
+*************************************************************************/
+
+#if !defined(TRNG_HWRNG_H)
+#define TRNG_HWRNG_H
+
+#include "noise_to_entropy.h"
+
+void HWRNG_preinit(int reinit);
+
+int HWRNG_Avail();
+
+TRNG_ERRORS HWRNG_Init(E_SOURCE *E, unsigned char *pers, int perl);
+
+TRNG_ERRORS HWRNG_getbytes(E_SOURCE *E,unsigned char *buf,int len );
+
+TRNG_ERRORS HWRNG_Cleanup(E_SOURCE *T);
+
+void HWRNG_Final(void);
+
+
+#endif
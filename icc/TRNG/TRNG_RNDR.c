@@ -0,0 +1,129 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Use the ARMv8.5 RNDRRS instruction directly.
+//
+*************************************************************************/
+
+/*!
+  \FIPS TRNG_RNDR
+   This entropy source uses the ARMv8.5-RNG RNDRRS register, which
+   reseeds from the hardware entropy source on every read, 64 bits per
+   read rather than timer sampling.
+   The normal NRBG health tests and conditioning still apply.
+*/
+
+#include <stdio.h>
+#include "platform.h"
+#include "TRNG/TRNG_RNDR.h"
+#include "induced.h"
+#include "cpufeat.h"
+#include "TRNG/hw_entropy.h"
+
+/* Inline asm only with gcc compatible compilers on Linux,
+   everything else reports the source as unavailable
+*/
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#define RNDR_INSN 1
+#endif
+
+/*! @brief Pre-init function for TRNG_RNDR
+    @param reinit if !0 reinitialize everything
+*/
+void RNDR_preinit(int reinit)
+{
+
+}
+
+/*! @brief
+  Determine whether this noise source is available
+  @return 0 is not available , !0 if available
+*/
+int RNDR_Avail()
+{
+  int rv = 0;
+#if defined(RNDR_INSN)
+  rv = (0 != (OS_CpuFeatures() & ICC_CPUF_RNDR));
+#endif
+  return rv;
+}
+
+/*! @brief Initialise
+    @param E pointer to an E_SOURCE struct
+    @param pers Optional personalisation data
+    @param perl length of personalisation data
+    @return status
+*/    
+TRNG_ERRORS RNDR_Init(E_SOURCE *E, unsigned char *pers, int perl)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+
+  if(!RNDR_Avail()) {
+    rv = TRNG_INIT;
+  }
+  return rv;
+}
+
+/*!
+ @brief get entropy from RNDRRS
+ @param E pointer to an E_SOURCE struct
+ @param buffer buffer to fill with data
+ @param len length of requested data
+ @return status
+ @note If the hardware stays empty for HW_ENTROPY_RETRIES tries the rest 
+ of the buffer is zeroed so it fails the entropy check in the NRBG layer
+*/
+TRNG_ERRORS RNDR_getbytes(E_SOURCE *E,unsigned char *buffer,int len )
+{
+  TRNG_ERRORS rv = TRNG_OK;
+
+  if(len <= 0) {
+    rv = TRNG_REQ_SIZE;
+  } else {
+#if defined(RNDR_INSN)
+    unsigned long long v = 0;
+    int done = 0;
+    int k = 0;
+
+    while(done < len) {
+      if(!hw_rndr_word(&v)) {
+        memset(buffer + done,0,len - done);
+        rv = TRNG_ENTROPY;
+        break;
+      }
+      k = len - done;
+      if(k > (int)sizeof(v)) {
+        k = sizeof(v);
+      }
+      memcpy(buffer + done,&v,k);
+      done += k;
+    }
+    v = 0;
+#else
+    rv = TRNG_INIT;
+#endif
+    /*! \induced 225. TRNG_RNDR. Fake failure of HW source
+     */ 
+    if(225 == icc_failure) {
+      memset(buffer,0x5A,len);
+    }
+  }
+  return rv;
+}
+
+/*! @brief Cleanup any residual information in this entropy source 
+  @param E The entropy source data structure
+  @return TRNG_OK
+ */
+TRNG_ERRORS RNDR_Cleanup(E_SOURCE *E)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+
+  return rv;
+}
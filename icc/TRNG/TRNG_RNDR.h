@@ -0,0 +1,31 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Header for TRNG_RNDR
+//
+*************************************************************************/
+
+#if !defined(TRNG_RNDR_H)
+#define TRNG_RNDR_H
+
+#include "noise_to_entropy.h"
+
+
+void RNDR_preinit(int reinit);
+
+int RNDR_Avail();
+
+TRNG_ERRORS RNDR_Init(E_SOURCE *E, unsigned char *pers, int perl);
+
+TRNG_ERRORS RNDR_getbytes(E_SOURCE *E,unsigned char *buf,int len );
+
+TRNG_ERRORS RNDR_Cleanup(E_SOURCE *T);
+
+
+#endif
@@ -21,16 +21,44 @@
 #include "induced.h"
 static const char * TRNG_E_MEASUREtag = "E_MEASURE";
 
+#define E_EST_WINDOW 1024 /*!< Bytes per estimate, same window as the deflate estimator */
+#define E_EST_ZOUT 2048   /*!< Compressed bytes measured per window, at most */
+
+static int est_mode = E_EST_DEFLATE;
+
+/*! @brief Select the long term entropy estimator used by TRNG's
+    created after this call
+    @param mode E_EST_DEFLATE (default) or E_EST_MCV
+    @return the mode now in use
+*/
+int SetEntropyEstimator(int mode)
+{
+  if ((E_EST_DEFLATE == mode) || (E_EST_MCV == mode)) {
+    est_mode = mode;
+  }
+  return est_mode;
+}
+
+int GetEntropyEstimator()
+{
+  return est_mode;
+}
+
 /*!
   @brief zlib compatable calloc wrapper 
-  @param opaque - apparently just that
+  @param opaque the E_MEASURE the stream belongs to
   @param items number of blocks
   @param size size of each block
   @return Z_NULL or a valid pointer  
+  @note zlib only frees in deflateEnd() so the count is simply reset there
 */
 static void *izcalloc(void *opaque,unsigned items, unsigned size)
 {
-  return ICC_Calloc(items,size,__FILE__,__LINE__);
+  void *p = ICC_Calloc(items,size,__FILE__,__LINE__);
+  if((NULL != p) && (NULL != opaque)) {
+    ((E_MEASURE *)opaque)->zbytes += items * size;
+  }
+  return p;
 }
 
 static void izfree(void *opaque,void *ptr)
@@ -64,10 +92,68 @@ static void izfree(void *opaque,void *ptr)
   \FIPS This is the FIPS 140-3 TRNG entropy estimator
 */
 
+/*!
+  @brief streaming MCV estimator.
+  Byte counts accumulate across calls and every E_EST_WINDOW bytes the
+  most common value is converted to an estimate by pmaxLGetEntHist().
+  @param trng The trng instance to use
+  @param data the input data buffer
+  @param n the number of input bytes
+  @note Min-entropy from the most common value is never higher than the
+  compression ratio on the same data, so this is the stricter of the two
+  and costs a single table increment per byte.
+  \FIPS This is the SP800-90B most common value estimate on the TRNG output
+*/
+static void MCVEstimator(TRNG *trng,unsigned char *data,int n)
+{
+  int i;
+  unsigned int *hist = trng->e.hist;
+
+  while (n > 0) {
+    i = E_EST_WINDOW - trng->e.Tbytesin;
+    if (i > n) {
+      i = n;
+    }
+    /** \induced 201: Entropy test, see EntropyEstimator() */
+    if( 201 == icc_failure) {
+      memset(data,0xA5,i);
+    }
+    trng->e.Tbytesin += i;
+    n -= i;
+    while (i-- > 0) {
+      hist[*data++]++;
+    }
+    if (trng->e.Tbytesin >= E_EST_WINDOW) {
+      /* pmaxLGetEntHist() is % * 2 */
+      trng->e.EntropyEstimate = pmaxLGetEntHist(hist, trng->e.Tbytesin) / 2;
+      memset(trng->e.hist, 0, 256 * sizeof(unsigned int));
+      trng->e.Tbytesin = 0;
+    }
+  }
+}
+
 int EntropyEstimator(TRNG *trng,unsigned char *data,int n)
 {  
   int rv = 0; 
   int i,j;
+  Bytef out[E_EST_ZOUT]; /* Compressed data is only counted, never used */
+
+  if (E_EST_MCV == trng->e.mode) {
+    MCVEstimator(trng, data, n);
+    return rv;
+  }
+  if (!trng->e.zinit) {
+    /* Set up on first use, a TRNG that's never drawn on holds no zlib state */
+    trng->e.strm.zalloc = izcalloc;
+    trng->e.strm.zfree = izfree;
+    trng->e.strm.opaque = (voidpf)&(trng->e);
+    if (Z_OK != deflateInit2(&trng->e.strm,Z_DEFAULT_COMPRESSION,Z_DEFLATED,9,1,Z_DEFAULT_STRATEGY)) {
+      return rv; /* Keep the last estimate */
+    }
+    trng->e.zinit = 1;
+    trng->e.Tbytesin = 0;
+    trng->e.Tbytesout = 0;
+  }
 
   do {
     i = n;
@@ -84,24 +170,28 @@ int EntropyEstimator(TRNG *trng,unsigned char *data,int n)
       memset(data,0xA5,i);
     }
 
+    /* Output goes to the stack, only the running count of what was 
+       written in this window is kept
+    */
     trng->e.strm.avail_in = i;
     trng->e.strm.next_in = data;
+    trng->e.strm.avail_out = E_EST_ZOUT - trng->e.Tbytesout;
+    trng->e.strm.next_out = out;
     deflate(&trng->e.strm,Z_NO_FLUSH);
+    trng->e.Tbytesout = E_EST_ZOUT - trng->e.strm.avail_out;
     trng->e.Tbytesin += i;
     if(trng->e.Tbytesin >= 1024) {
       deflate(&(trng->e.strm),Z_SYNC_FLUSH);
-      memset(trng->e.out,0,sizeof(trng->e.out)); /* Don't use the compressed data, so zero this now */
-      trng->e.Tbytesout = 2048 - trng->e.strm.avail_out;
+      trng->e.Tbytesout = E_EST_ZOUT - trng->e.strm.avail_out;
       /* recalc the entropy - we have ~ 47 bytes overhead with uncompressable data */
       trng->e.EntropyEstimate = ((trng->e.Tbytesout - 48) * 100)/trng->e.Tbytesin;
       trng->e.Tbytesin = 0;
       trng->e.Tbytesout = 0;
-      trng->e.strm.avail_out = 2048;
-      trng->e.strm.next_out = &(trng->e.out[0]);
     }
     n -= i;
     data += i;
   } while (n > 0);
+  memset(out,0,sizeof(out)); /* Don't use the compressed data, so zero this now */
   return rv;
 }
 
@@ -162,12 +252,19 @@ TRNG_ERRORS InitEntropyEstimator(TRNG *trng)
 {
   TRNG_ERRORS rv = TRNG_OK;
   if(NULL != trng) {
-    trng->e.strm.zalloc = izcalloc;
-    trng->e.strm.zfree = izfree;
-    trng->e.strm.opaque = Z_NULL;
-    deflateInit2(&trng->e.strm,Z_DEFAULT_COMPRESSION,Z_DEFLATED,9,1,Z_DEFAULT_STRATEGY);
-    trng->e.strm.avail_out = 2048;
-    trng->e.strm.next_out = &(trng->e.out[0]);
+    trng->e.mode = est_mode;
+    trng->e.Tbytesin = 0;
+    trng->e.Tbytesout = 0;
+    if (E_EST_MCV == trng->e.mode) {
+      if (NULL == trng->e.hist) {
+        trng->e.hist = (unsigned int *)ICC_Calloc(256, sizeof(unsigned int), __FILE__, __LINE__);
+      }
+      if (NULL == trng->e.hist) {
+        return TRNG_MEM;
+      }
+      memset(trng->e.hist, 0, 256 * sizeof(unsigned int));
+    }
+    /* The deflate stream is set up by the first EntropyEstimator() call */
     trng->e.EntropyState = 1;
     trng->e.EntropyEstimate = 100; /* Until we have better information ... */
     trng->e.id = TRNG_E_MEASUREtag;
@@ -182,6 +279,31 @@ TRNG_ERRORS InitEntropyEstimator(TRNG *trng)
 void CleanupEntropyEstimator(TRNG *trng)
 {
 
-  deflateEnd(&trng->e.strm);
+  if (trng->e.zinit) {
+    deflateEnd(&trng->e.strm);
+    trng->e.zinit = 0;
+    trng->e.zbytes = 0;
+  }
+  if (NULL != trng->e.hist) {
+    ICC_Free(trng->e.hist);
+    trng->e.hist = NULL;
+  }
   trng->e.EntropyState = 0;
 }
+
+/*! @brief Memory the estimator has allocated for this TRNG
+  @param trng The trng instance
+  @return bytes, the histogram or the zlib state
+*/
+unsigned int EntropyEstimatorFootprint(TRNG *trng)
+{
+  unsigned int rv = 0;
+
+  if (NULL != trng) {
+    rv = trng->e.zbytes;
+    if (NULL != trng->e.hist) {
+      rv += 256 * sizeof(unsigned int);
+    }
+  }
+  return rv;
+}
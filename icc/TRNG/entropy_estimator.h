@@ -10,11 +10,18 @@
 #define ENTROPY_ESTIMATOR_H
 #include "noise_to_entropy.h"
 
+/*! Long term estimator selection, see SetEntropyEstimator() */
+#define E_EST_DEFLATE 0 /*!< zlib compression ratio */
+#define E_EST_MCV     1 /*!< Streaming most common value byte histogram */
+
+int SetEntropyEstimator(int mode);
+int GetEntropyEstimator();
 int GetDesignEntropy(TRNG *T);
 int GetEntropy(TRNG *T);
 int EntropyOK(TRNG *T);
 int EntropyEstimator(TRNG *T,unsigned char *data,int n);
 TRNG_ERRORS InitEntropyEstimator(TRNG *T);
 void CleanupEntropyEstimator(TRNG *T);
+unsigned int EntropyEstimatorFootprint(TRNG *T);
 
 #endif
@@ -35,7 +35,7 @@ static void printbin( char *s,int l)
 void xcompress(TRNG *T,unsigned char outbuf[SHA_DIGEST_SIZE],unsigned char *in, int len)
 {
   unsigned int mlen = SHA_DIGEST_SIZE;
-  HMAC_Init(T->cond.hctx,T->cond.key,sizeof(T->cond.key),T->md);
+  HMAC_Init_ex(T->cond.hctx,T->cond.key,sizeof(T->cond.key),T->md,NULL);
   HMAC_Update(T->cond.hctx,outbuf,SHA_DIGEST_SIZE);   
   HMAC_Update(T->cond.hctx,in,len);
   HMAC_Final(T->cond.hctx,outbuf,&mlen);
@@ -58,14 +58,26 @@ int conditioner(TRNG *T, unsigned char* outbuf, unsigned len)
   unsigned mlen = SHA_DIGEST_SIZE;
   int rv = 0;
   unsigned char tbuf[SHA_DIGEST_SIZE *2];
+  int keyed = 0;
+  int failed = 0;
   memset(tbuf,0,SHA_DIGEST_SIZE *2);  
   guarantee = TRNG_guarantee(T);
   while( n < len) {
-    HMAC_Init(T->cond.hctx,T->cond.key,sizeof(T->cond.key),T->md);
+    /* Key once per call, later blocks just reset to the keyed state */
+    if(!keyed) {
+      HMAC_Init_ex(T->cond.hctx,T->cond.key,sizeof(T->cond.key),T->md,NULL);
+      keyed = 1;
+    } else {
+      HMAC_Init_ex(T->cond.hctx,NULL,0,NULL,NULL);
+    }
     /* personalization data */
     HMAC_Update(T->cond.hctx,T->cond.rdata,sizeof(T->cond.rdata));
     for(j = 0; j < guarantee; j++) { 
       if( 0 != trng_raw(&(T->econd),tbuf,SHA_DIGEST_SIZE) ) {
+        if(TRNG_HasStandby(T)) {
+          failed = 1; /* Let the caller switch to the standby NRBG */
+          break;
+        }
         rv = SetRNGError("Insufficient entropy",__FILE__,__LINE__);
         if(TRNG_OK != rv) {
           break;
@@ -73,8 +85,13 @@ int conditioner(TRNG *T, unsigned char* outbuf, unsigned len)
       }
       HMAC_Update(T->cond.hctx,tbuf,sizeof(tbuf));
     }
+    if(failed) {
+      rv = TRNG_ENTROPY;
+      break;
+    }
     if(TRNG_RESTART == rv) {
       TRNG_TRNG_Init(T,-1);
+      keyed = 0; /* New conditioner state, maybe a new digest */
       rv = TRNG_OK;
       continue;
     }
@@ -101,13 +118,17 @@ int conditioner(TRNG *T, unsigned char* outbuf, unsigned len)
   3) Less vulnerable to allowing a counter through
 */
 
+#define COND_BATCH 4 /*!< Conditioned blocks produced per conditioner() call */
+
 TRNG_ERRORS Entropy_to_TRNG(TRNG *T, unsigned char *data, unsigned int len)
 {
   TRNG_ERRORS rv = TRNG_OK;
   int i = 0, j = 0,m = 0, k,l;
   int e = 0;
+  int nb = 0;
   unsigned int digestL = 0;
   unsigned char buffer[SHA_DIGEST_SIZE];
+  unsigned char cbuf[SHA_DIGEST_SIZE * COND_BATCH];
 
   memset(buffer,0,SHA_DIGEST_SIZE);
   while (i < len)
@@ -118,24 +139,47 @@ TRNG_ERRORS Entropy_to_TRNG(TRNG *T, unsigned char *data, unsigned int len)
      */
     for (j = 0; j < (TRNG_RETRIES) && (i < len);j++ )
     {
-      for (l = 0; l < len; l += SHA_DIGEST_SIZE)
+      /* Condition up to COND_BATCH blocks in one go (keying the HMAC once),
+         each block is still checked on it's own
+      */
+      e = 50;
+      while ((i < len) && (e >= 50))
       {
-        conditioner(T, buffer, SHA_DIGEST_SIZE);
-        e = pmax4(buffer,SHA_DIGEST_SIZE);
-        if(e < 50) {
-          break;
+        nb = ((len - i) + SHA_DIGEST_SIZE - 1) / SHA_DIGEST_SIZE;
+        if (nb > COND_BATCH) {
+          nb = COND_BATCH;
+        }
+        if ((TRNG_OK != conditioner(T, cbuf, nb * SHA_DIGEST_SIZE)) && TRNG_HasStandby(T)) {
+          if (TRNG_Failover(T, data, len)) {
+            rv = TRNG_OK;
+            goto done;
+          }
+          rv = SetRNGError("Insufficient entropy", __FILE__, __LINE__);
+          goto done;
         }
-        k = (len - i) < SHA_DIGEST_SIZE ? (len - i) : SHA_DIGEST_SIZE;
-        if (k > 0)
+        for (l = 0; l < nb; l++)
         {
-          memcpy(data + i, buffer, k);
-          i += k;
+          e = pmax4(cbuf + (l * SHA_DIGEST_SIZE),SHA_DIGEST_SIZE);
+          if(e < 50) {
+            break;
+          }
+          k = (len - i) < SHA_DIGEST_SIZE ? (len - i) : SHA_DIGEST_SIZE;
+          if (k > 0)
+          {
+            memcpy(data + i, cbuf + (l * SHA_DIGEST_SIZE), k);
+            i += k;
+          }
         }
       }
     }
+    memset(cbuf, 0, sizeof(cbuf));
 
     if (j >= TRNG_RETRIES)
     {
+      if (TRNG_Failover(T, data, len)) {
+        rv = TRNG_OK;
+        break;
+      }
       rv = SetRNGError("Unable to obtain sufficient entropy", __FILE__, __LINE__);
       if(TRNG_OK == rv) {
         j = 0;
@@ -148,6 +192,10 @@ TRNG_ERRORS Entropy_to_TRNG(TRNG *T, unsigned char *data, unsigned int len)
     EntropyEstimator(T, data, len);
     if (!EntropyOK(T))
     {
+      if (TRNG_Failover(T, data, len)) {
+        rv = TRNG_OK;
+        break;
+      }
       rv = SetRNGError("Long term entropy is below acceptable limits", __FILE__, __LINE__);
       if(TRNG_OK == rv) continue;
     }
@@ -170,6 +218,10 @@ TRNG_ERRORS Entropy_to_TRNG(TRNG *T, unsigned char *data, unsigned int len)
       i = 0;
       m++;
       if(m > 5) {
+        if (TRNG_Failover(T, data, len)) {
+          rv = TRNG_OK;
+          break;
+        }
         rv = SetRNGError("Repeated duplicate seeds from TRNG", __FILE__, __LINE__);
         if(TRNG_OK == rv) {
           continue;
@@ -179,6 +231,8 @@ TRNG_ERRORS Entropy_to_TRNG(TRNG *T, unsigned char *data, unsigned int len)
       continue;
     }
   }
+done:
+  memset(cbuf, 0, sizeof(cbuf));
   /* Scrub the state here, but don't free it */
   EVP_MD_CTX_reset(T->md_ctx);
   return rv;
@@ -41,7 +41,10 @@ typedef struct E_MEASURE_t {
   int EntropyEstimate;   /*!< The current entropy estimate from this PRNG instance */
   int Tbytesin;          /*!< Byte count in for this estimator */
   int Tbytesout;         /*!< Byte count out for this estimator */
-  Bytef out[2048]; 	     /*!< Compression buffer */
+  int zinit;             /*!< strm has been set up, done on the first data */
+  unsigned int zbytes;   /*!< Held by zlib for strm */
+  int mode;              /*!< Estimator this instance was set up with, see SetEntropyEstimator() */
+  unsigned int *hist;    /*!< Byte histogram for the MCV estimator, 256 entries, MCV mode only */
   const char *id;        /*!< Debug */
 } E_MEASURE;
 
@@ -66,6 +69,7 @@ struct TRNG_t {
   EVP_MD_CTX *md_ctx;   /*!< Working digest CTX for CRNG test */
   const EVP_MD *md;     /*!< Digest we are using */
   int type;             /*!< Type of TRNG instantiated */
+  void *shared;         /*!< Shared instance slot, NULL if this TRNG has a single owner */
   const char *id;             /*!< Debug */
 };
 
@@ -21,6 +21,17 @@ int ChkMem(T_FILTER *TF,unsigned char c)
 {
     return 1;
 } 
+int FilterMem(T_FILTER *TF,const ICC_UINT64 *samples,int n,unsigned char *out,int want)
+{
+    int i;
+    for(i = 0; (i < want) && (i < n); i++) {
+        out[i] = (unsigned char)(samples[i] & 0xff);
+    }
+    return i;
+}
+void FilterMemSelect(void)
+{
+}
 #endif
 
 
@@ -187,4 +198,168 @@ void proc_mem(T_FILTER *tf,unsigned char v)
    proc_mem_nocheck(tf,v);
 }
 
+/*! @brief The byte at a time filter over a block of samples
+   ChkMem() then proc_mem() on each candidate, this is the reference 
+   the table version is checked against
+   @param tf pointer to a T_FILTER struct
+   @param samples timer samples, the low byte of each is the candidate
+   @param n number of samples
+   @param out where accepted bytes go
+   @param want most bytes wanted
+   @return bytes written to out
+*/
+static int FilterMemScalar(T_FILTER *tf,const ICC_UINT64 *samples,int n,unsigned char *out,int want)
+{
+   int i;
+   int k = 0;
+   unsigned char c;
+
+   for(i = 0; (k < want) && (i < n); i++) {
+      c = (unsigned char)(samples[i] & 0xff);
+      if(1 == ChkMem(tf,c)) { /* Skip values that were frequent long term */
+         out[k++] = c;
+         proc_mem(tf,c);
+      }
+   }
+   return k;
+}
+
+/*! @brief The same filter over a block of samples with the state held 
+   in locals
+   The frequency table lookup decides each byte, the FIFO position and
+   fill are only written back once per block and the prefill and done 
+   checks are made once rather than per byte. Each decision depends on 
+   the ones before it, so this is a tighter loop rather than a vector one.
+   @param tf pointer to a T_FILTER struct
+   @param samples timer samples, the low byte of each is the candidate
+   @param n number of samples
+   @param out where accepted bytes go
+   @param want most bytes wanted
+   @return bytes written to out
+*/
+static int FilterMemTable(T_FILTER *tf,const ICC_UINT64 *samples,int n,unsigned char *out,int want)
+{
+   int i;
+   int k = 0;
+   int idx;
+   int check;
+   unsigned int totl;
+   unsigned char c, ov;
+   char *arry = tf->arry;
+   unsigned char *fifo = tf->fifo;
+
+   if(!tf->fifo_init) {
+      prefill(tf);
+      tf->fifo_init = 1;
+   }
+   check = (1 == tf->done);
+   idx = tf->idx;
+   totl = tf->totl;
+   for(i = 0; (k < want) && (i < n); i++) {
+      c = (unsigned char)(samples[i] & 0xff);
+      if(check && (arry[c] >= TOO_HIGH)) {
+         continue;
+      }
+      out[k++] = c;
+      if((idx >= HISTSZ) || (idx < 0)) {
+         idx = 0;
+      }
+      ov = fifo[idx];
+      fifo[idx++] = c;
+      if(totl < HISTSZ) {
+         totl++;
+      } else {
+         arry[ov] -= (arry[ov] > 0);
+      } 
+      arry[c]++;
+   }
+   tf->idx = idx;
+   tf->totl = totl;
+   return k;
+}
+
+/*! @brief The block filter in use, see FilterMemSelect() */
+static int (*filter_mem)(T_FILTER *,const ICC_UINT64 *,int,unsigned char *,int) = FilterMemScalar;
+
+/*! @brief Run the candidate bytes from one batch of samples through 
+   the distribution filter
+   @param tf pointer to a T_FILTER struct
+   @param samples timer samples, the low byte of each is the candidate
+   @param n number of samples
+   @param out where accepted bytes go
+   @param want most bytes wanted
+   @return bytes written to out
+*/
+int FilterMem(T_FILTER *tf,const ICC_UINT64 *samples,int n,unsigned char *out,int want)
+{
+   return (*filter_mem)(tf,samples,n,out,want);
+}
+
+/*! @brief Pick the block filter, once, when the timer source is set up
+   The table version is only used if it gives the same bytes and leaves
+   the same filter state as the scalar one on a fixed skewed input, 
+   run in pieces so the state carries across calls as it does in use
+*/
+void FilterMemSelect(void)
+{
+   static int selected = 0;
+   T_FILTER *tf[2] = {NULL, NULL};
+   ICC_UINT64 *in = NULL;
+   unsigned char *out[2] = {NULL, NULL};
+   unsigned int x = 0x2545F491;
+   int i, j, k;
+   int n[2] = {0, 0};
+   int ok = 1;
+
+   if(selected) {
+      return;
+   }
+   in = (ICC_UINT64 *)ICC_Calloc(TE_BUFLEN, sizeof(ICC_UINT64), __FILE__, __LINE__);
+   for(i = 0; i < 2; i++) {
+      tf[i] = (T_FILTER *)ICC_Calloc(1, sizeof(T_FILTER), __FILE__, __LINE__);
+      out[i] = (unsigned char *)ICC_Calloc(1, 16 * TE_BUFLEN, __FILE__, __LINE__);
+   }
+   if((NULL != in) && (NULL != tf[0]) && (NULL != tf[1]) && (NULL != out[0]) && (NULL != out[1])) {
+      for(i = 0; i < 2; i++) {
+         /* The same flat prefill both times, prefill() itself samples the timer */
+         T_FILTER_Init(tf[i]);
+         for(j = 0; j < (BASELINE - FREEDOM) * 256; j++) {
+            proc_mem_nocheck(tf[i],(unsigned char)((j * 167) ^ (j >> 8)));
+         }
+         tf[i]->fifo_init = 1;
+         tf[i]->done = 1;
+      }
+      for(j = 0; ok && (j < 16); j++) {
+         for(i = 0; i < TE_BUFLEN; i++) {
+            x = x * 1103515245 + 12345;
+            /* Skewed towards low values so some are filtered out */
+            in[i] = ((ICC_UINT64)x << 8) | (((x >> 16) & 0xff) & ((x >> 24) | 0x3f));
+         }
+         k = (j & 1) ? TE_BUFLEN : (TE_BUFLEN / 2 + j);
+         n[0] += FilterMemScalar(tf[0],in,TE_BUFLEN,out[0] + n[0],k);
+         n[1] += FilterMemTable(tf[1],in,TE_BUFLEN,out[1] + n[1],k);
+         ok = (n[0] == n[1]);
+      }
+      ok = ok && (0 == memcmp(out[0],out[1],n[0])) &&
+           (tf[0]->idx == tf[1]->idx) && (tf[0]->totl == tf[1]->totl) &&
+           (0 == memcmp(tf[0]->arry,tf[1]->arry,sizeof(tf[0]->arry))) &&
+           (0 == memcmp(tf[0]->fifo,tf[1]->fifo,sizeof(tf[0]->fifo)));
+      filter_mem = ok ? FilterMemTable : FilterMemScalar;
+      selected = 1;
+   }
+   for(i = 0; i < 2; i++) {
+      if(NULL != tf[i]) {
+         memset(tf[i],0,sizeof(T_FILTER));
+         ICC_Free(tf[i]);
+      }
+      if(NULL != out[i]) {
+         memset(out[i],0,16 * TE_BUFLEN);
+         ICC_Free(out[i]);
+      }
+   }
+   if(NULL != in) {
+      ICC_Free(in);
+   }
+}
+
 #endif
@@ -0,0 +1,93 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: On-CPU entropy instructions shared by the noise sources
+//              which issue them directly, TRNG_ALT4 bulk mode and the
+//              per-instruction sources.
+//
+*************************************************************************/
+
+#if !defined(HW_ENTROPY_H)
+#define HW_ENTROPY_H
+
+#define HW_ENTROPY_RETRIES 128 /*!< Attempts per word before we give up on the instruction */
+
+#if defined(__GNUC__) && defined(__powerpc64__)
+#define HW_ENTROPY_DARN 1
+
+#define DARN_ERROR 0xFFFFFFFFFFFFFFFFULL /*!< DARN's failure return */
+
+/*! @brief One conditioned 64 bit word from DARN
+    @param v where to put it
+    @return 1 on success, 0 if the hardware stayed empty for 
+    HW_ENTROPY_RETRIES tries
+*/
+static __inline__ int hw_darn_word(unsigned long long *v)
+{
+  int i = 0;
+
+  for(i = 0; i < HW_ENTROPY_RETRIES; i++) {
+    __asm__ __volatile__(".machine push\n\t.machine power9\n\tdarn %0,1\n\t.machine pop" : "=r"(*v));
+    if(DARN_ERROR != *v) {
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__)
+#define HW_ENTROPY_RNDR 1
+
+/*! @brief One 64 bit word from RNDRRS
+    @param v where to put it
+    @return 1 on success, 0 if the hardware stayed empty for 
+    HW_ENTROPY_RETRIES tries
+    @note RNDRRS sets Z on failure, s3_3_c2_c4_1 so older assemblers 
+    accept it
+*/
+static __inline__ int hw_rndr_word(unsigned long long *v)
+{
+  unsigned long long ok = 0;
+  int i = 0;
+
+  for(i = 0; i < HW_ENTROPY_RETRIES; i++) {
+    __asm__ __volatile__("mrs %0, s3_3_c2_c4_1\n\tcset %1, ne" : "=r"(*v), "=r"(ok) : : "cc");
+    if(ok) {
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HW_ENTROPY_RDSEED 1
+
+/*! @brief One 64 bit word from RDSEED
+    @param v where to put it
+    @return 1 on success, 0 if the hardware stayed empty for 
+    HW_ENTROPY_RETRIES tries
+*/
+static __inline__ int hw_rdseed_word(unsigned long long *v)
+{
+  unsigned char ok = 0;
+  int i = 0;
+
+  for(i = 0; i < HW_ENTROPY_RETRIES; i++) {
+    __asm__ __volatile__("rdseed %0\n\tsetc %1" : "=r"(*v), "=qm"(ok) : : "cc");
+    if(ok) {
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif
+
+#endif
@@ -81,14 +81,7 @@ static unsigned int ilog2(unsigned int v)
 
 unsigned int pmaxLGetEnt(unsigned char *data, int len)
 {
-#if defined(TEST_DOUBLE)
-  double p = 0.0, log2p = 0.0;
-  double hmin = 0.0;
-#endif
   int i = 0;
-  int k = 0;
-  int ip = 0;
-  int ilog2p = 0;
   unsigned int syms[256];
   unsigned int est = 0;
 
@@ -101,6 +94,33 @@ unsigned int pmaxLGetEnt(unsigned char *data, int len)
     {
       syms[data[i]]++;
     }
+    est = pmaxLGetEntHist(syms, len);
+  }
+  return est;
+}
+
+/*!
+  @brief The most common value estimate from pmaxLGetEnt(), but
+  working from an existing byte histogram so callers can accumulate
+  the counts incrementally
+  @param syms 256 entry histogram of byte values
+  @param len total number of bytes counted in syms (>= 512 for a useful result)
+  @return Entropy estimate (% * 2) i.e. 0 -200
+*/
+unsigned int pmaxLGetEntHist(const unsigned int *syms, int len)
+{
+#if defined(TEST_DOUBLE)
+  double p = 0.0, log2p = 0.0;
+  double hmin = 0.0;
+#endif
+  int i = 0;
+  unsigned int k = 0;
+  int ip = 0;
+  int ilog2p = 0;
+  unsigned int est = 0;
+
+  if (len >= 512)
+  {
     k = 0;
     for (i = 0; i < 256; i++)
     {
@@ -117,6 +137,9 @@ unsigned int pmaxLGetEnt(unsigned char *data, int len)
   */
     ip = len / k;
     ilog2p = ilog2(ip);
+    if (ilog2p > 8) {
+      ilog2p = 8; /* Can't get more than 8 bits/byte, longer histograms can overshoot */
+    }
     /*
       Our estimate is for 8 bits
       Convert to how many bits we need to guarantee 100 bits of entropy
@@ -293,16 +316,18 @@ int APtestBK(int N, unsigned char data[512])
     C = 0; /* Estimator wil fail */
     break;
   }
+  /* Track the most common value as we count, so we can stop as soon
+     as any symbol reaches the cutoff rather than scanning the
+     histogram afterwards
+  */
   memset(cnt,0,sizeof(cnt));
   for(i = 0; i < E_ESTB_BUFLEN; i++) {
     t = data[i];
-    cnt[t]++;
-  }
-
-  for(i = 0; i < 256; i++)
-  {
-    if(cnt[i] > maxc) {
-      maxc = cnt[i];
+    if(++cnt[t] > maxc) {
+      maxc = cnt[t];
+      if (maxc >= C) {
+        break;
+      }
     }
   }
   /* printf("C = %d, maxc = %d\n",C,maxc); */
@@ -315,6 +340,10 @@ int APtestBK(int N, unsigned char data[512])
   return rv;
 }
 
+/*! @brief Non-zero if any byte of the 64 bit word is zero 
+    (exact, no false positives) */
+#define RC_HASZERO(v) (((v) - 0x0101010101010101ULL) & ~(v) & 0x8080808080808080ULL)
+
 int RCtestBK(int H,unsigned char bk[512])
 {
   static int RCTable[3] = {16,9,6};
@@ -341,6 +370,22 @@ int RCtestBK(int H,unsigned char bk[512])
   {
     for (i = 0; i < 512; i++)
     {
+      /* Eight positions at a time: compare bk[i-1..i+6] with bk[i..i+7],
+         if no byte matches its predecessor every run is broken here
+         and only the last byte matters
+      */
+      if ((i > 0) && (i <= 512 - 8)) {
+        unsigned long long x, y;
+        memcpy(&x, bk + i - 1, sizeof(x));
+        memcpy(&y, bk + i, sizeof(y));
+        x ^= y;
+        if (!RC_HASZERO(x)) {
+          i += 7;
+          c = bk[i];
+          B = 0;
+          continue;
+        }
+      }
       if (c == bk[i])
       {
         B++;
@@ -59,6 +59,7 @@ typedef struct ENTROPY_HT_t {
 
 
 unsigned int pmaxLGetEnt(unsigned char *data, int len);
+unsigned int pmaxLGetEntHist(const unsigned int *syms, int len);
 
 /*! @brief Initialize a an Entropy health test structure, setting it up
   for the appropriate entropy guarantees
@@ -17,6 +17,7 @@
 #endif
 
 #include "noise_to_entropy.h"
+#include "icc_probes.h"
 
 extern unsigned int icc_failure;
 
@@ -95,12 +96,15 @@ int trng_raw(E_SOURCE *E,
       E->impl.gb(E,&(E->nbuf[0]), E_ESTB_BUFLEN);
       E->cnt = E_ESTB_BUFLEN; /* The FIPS RBG has done the health test */
       e = pmaxLGetEnt(E->nbuf, E_ESTB_BUFLEN); /* So just do an entropy check here for all modes, equivalent to AP anyway */
+      ICC_PROBE3(trng__gather, E, E_ESTB_BUFLEN, e);
       if(e < (50*2) ) { /* The entropy estimator uses integer maths, number back is 2x real entropy so we can handle 12.5, 87.5 etc */
        failcount++;
+        E->retries++;
         E->cnt = 0;
-
+        ICC_PROBE3(trng__health__fail, E, e, failcount);
       }
       if(failcount > MAX_HT_FAIL) {
+        ICC_PROBE1(trng__fail, E);
         rv = 1;
         goto error;
       }
@@ -44,6 +44,10 @@ typedef enum {
    TRNG_HW,     /*!< Pure hardware source */
    TRNG_OS,     /*!< RNG from the OS */
    TRNG_FIPS,   /*!< FIPS compliant version */ 
+   TRNG_CPACF,  /*!< z Systems CPACF PRNO TRNG */
+   TRNG_DARN,   /*!< POWER9 DARN */
+   TRNG_RNDR,   /*!< ARMv8.5 RNDRRS */
+   TRNG_HWRNG,  /*!< Kernel hwrng, virtio-rng */
  } NOISE_TYPE;
 
 #define TRNG_TYPE NOISE_TYPE
@@ -175,15 +179,21 @@ typedef struct T_FILTER_t {
    Collected data structures for an Entropy source (one byte at a time reads)
    Some of the structs are unused in some implementations but this is easier to
    debug than dereferenced anonymous pointers.
-   @note T_FILTER is large but the code is so complex I gave up on dynamically 
-   allocating it.
+   @note T_FILTER is large (~27K) and only the FIPS timer source uses it,
+   so it's allocated by TRNG_FIPS_Init(). The TRNG_ALT prefetch buffer is
+   likewise allocated on the first small read.
 */
 struct E_SOURCE_t {		
   ENTROPY_IMPL impl;    /*!< Implementation of this TRNG's entropy source (type/class) */	  
   ENTROPY_HT hti;       /*!< Health tests for input entropy in the TRNG core */
-  T_FILTER tf;          /*!< State data (i.e. for the FIPS timer source RBG's), make it a union if need be */
+  T_FILTER *tf;         /*!< State data for the FIPS timer source RBG's, NULL for other sources */
   unsigned char nbuf[E_ESTB_BUFLEN]; /*!< I'd rather not do this, but there's a mismatch between what the NIST algs need and what we need later */
   int cnt;              /*!< Number of bytes left in the buffer */
+  unsigned char *abuf;  /*!< TRNG_ALT/TRNG_HWRNG prefetch so small reads don't each cost a syscall, E_ESTB_BUFLEN bytes, see ALT_Prefetch() */
+  int acnt;             /*!< Bytes left in abuf */
+  unsigned int agen;    /*!< TRNG_ALT/TRNG_HWRNG generation abuf was filled in, see ALT_preinit() */
+  unsigned long apid;   /*!< Process abuf was filled in */
+  unsigned int retries; /*!< Noise buffers discarded for low entropy, ICC_RNG_STATS */
   const char *id;       /*!< Debug string */
 };
 
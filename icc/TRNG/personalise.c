@@ -12,6 +12,12 @@
 *************************************************************************/
 
 #include "icclib.h"
+#include "openssl/sha.h"
+#include "fips-prng/SP800-90.h"
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 extern unsigned long RdCTR();
@@ -58,68 +64,96 @@ static int eg_gethostname(char *buffer,int size)
 #define eg_gethostname(x,y) gethostname(x,y)
 #endif
 
-#define efPSIZE (sizeof(struct timeval) +  (2 * sizeof(DWORD)) + sizeof(unsigned long) +  sizeof(name) )
+/*! @brief The part of the personalization string that's the same for
+  every call in a process, computed once, and again after fork()
+*/
+typedef struct {
+  struct timeval tv;  /*!< When it was computed */
+  DWORD pid;          /*!< The process */
+  char name[80];      /*!< As much of the machine name as will fit */
+  char boot[40];      /*!< Linux boot id, so identical VM clones differ */
+} PERS_STATIC;
+
+#define efPSIZE ((2 * sizeof(unsigned long)) + sizeof(DWORD) + SHA256_DIGEST_LENGTH)
+
+/* These are static, and thread safe'ish.
+   i.e. the fixed data is the same, and random
+   mashing of the per call data across threads makes no large difference
+   to security
+*/
+static unsigned char pers_fixed[SHA256_DIGEST_LENGTH]; /*!< Hash of a PERS_STATIC */
+static unsigned int pers_gen = 0;  /*!< RNG_ForkGeneration() pers_fixed is from */
+static int pers_ok = 0;            /*!< pers_fixed has been computed */
+static unsigned long pers_seq = 0; /*!< Calls so far */
+
+/*! @brief Compute pers_fixed for this process
+    @param gen RNG_ForkGeneration()
+*/
+static void pers_static(unsigned int gen)
+{
+  PERS_STATIC ps;
+#if defined(__linux__)
+  int fd = -1;
+#endif
+
+  memset(&ps, 0, sizeof(ps));
+  gettimeofday(&ps.tv, NULL);
+  ps.pid = ICC_GetProcessId();
+  eg_gethostname(ps.name, sizeof(ps.name) - 1);
+#if defined(__linux__)
+  fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY);
+  if (fd >= 0) {
+    if (read(fd, ps.boot, sizeof(ps.boot) - 1) < 0) {
+      ps.boot[0] = '\0';
+    }
+    close(fd);
+  }
+#endif
+  SHA256((unsigned char *)&ps, sizeof(ps), pers_fixed);
+  memset(&ps, 0, sizeof(ps));
+  pers_gen = gen;
+  pers_ok = 1;
+}
 
+/*! @brief Default personalization string for DRBG's and NRBG's
+    @param buffer where to place it, NULL to return the size needed
+    @return the size needed if buffer is NULL
+    @note Per call this is one counter read, a sequence number and the
+    thread id, ahead of a hash of the date/time, PID and machine identity
+    taken once per process. The per call data comes first as some
+    callers only take a prefix.
+*/
 unsigned int Personalize(unsigned char *buffer)
 {
-  int rv = 0;
-  struct timeval tv;
+  unsigned int rv = 0;
+  unsigned int gen = 0;
   unsigned long ccount;
-  DWORD pid;
+  unsigned long seq;
   DWORD tid;
-  int i;
   unsigned char *tmp = NULL;
-  unsigned char s = 0;
-  unsigned long l;
-
-  /* As much of the machine name as will fit in 80 bytes 
-     This is static, and thread safe'ish.
-     i.e. the fixed data is the same, and random
-     mashing of the random data across threads makes no large difference
-     to security
-   */
-  static char name[80]; 
+
   if(NULL == buffer) {
     rv = efPSIZE;
   } else {
-    if('\0' == name[0]) {
-      eg_gethostname(name,79);
-    }    
-    gettimeofday(&tv,NULL);
-
-    pid = ICC_GetProcessId();
+    gen = RNG_ForkGeneration();
+    if(!pers_ok || (gen != pers_gen)) {
+      pers_static(gen);
+    }
+    ccount = RdCTR();
+    seq = ++pers_seq;
     tid = ICC_GetThreadId();
 
-    ccount = RdCTR();
-  
     tmp = buffer;
-    memcpy(tmp,&tv,sizeof(struct timeval));
-    tmp += sizeof(struct timeval);
-
     memcpy(tmp,&ccount,sizeof(ccount));
     tmp += sizeof(ccount);
 
-    memcpy(tmp,&pid,sizeof(pid));
-    tmp += sizeof(pid);
+    memcpy(tmp,&seq,sizeof(seq));
+    tmp += sizeof(seq);
 
     memcpy(tmp,&tid,sizeof(tid));
-    tmp += sizeof(pid);
-
-    strncpy((char *)tmp,name,sizeof(name)-1);
-
-    /* 
-       And if there's space left, i.e. the machine name was less than 80 bytes
-       fill with bytes from the raw noise source 
-     */
-    for( tmp = tmp+strlen((char *)tmp); tmp < (buffer + efPSIZE) ; tmp ++) {
-      l = RdCTR();
-      for(i = 0; i < sizeof(unsigned long); i++) {
-	      s ^= (l & 0xff);
-	      l >>= 8;
-      }
-      *tmp = s;
-    }
+    tmp += sizeof(tid);
+
+    memcpy(tmp,pers_fixed,sizeof(pers_fixed));
   }
   return rv;
 }
-
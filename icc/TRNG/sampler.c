@@ -15,6 +15,9 @@
 
 #define DO_STATS
 /* 
+ Manual experiments on the timer noise source. tools/iccbench_trng.c
+ measures the same things on the built library, per tuner and under load.
+
  gcc -fno-strict-aliasing  -m64  -g3 -O0 -D_REENTRANT -fno-strict-aliasing -fno-exceptions -fPIC -Wall  -DVTAG=085  -I ./ sampler.c  nist_algs.o timer_fips.o timer_entropy.o noise_to_entropy.o -lpthread -ldl -o sampler
 
 */
@@ -189,6 +192,10 @@ void ICC_Free(void *x)
 void SetFatalError(const char *msg, char *file,int line)
 {
 
+}
+unsigned long long ICC_GetTimeUS(void)
+{
+    return 0;
 }
 /* Where the bad things dwell */
 int SampleCounter(int span)
@@ -228,7 +235,7 @@ int SampleCounterReal(int span)
     for (i = 0; i < 1000; i++) {
         for(j = 0; j < k; j++);
         buffer[i] = (unsigned char)RdCTR_raw() >> shift;
-  
+    }
 
     est = pmaxLGetEnt(buffer,1000)/2;
     free(buffer);
@@ -10,7 +10,13 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <string.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
 
+#include "iccversion.h"
 #include "TRNG/timer_entropy.h"
 #include "TRNG/looper.h"
 /*! @brief delay loop
@@ -31,12 +37,22 @@ unsigned int shift = 0;
 int shift_done = 0;   /* Flag to indicate we've run CalcShift() */
 static int full_rng_setup = 0;
 
+/* Persisted calibration, see Set_calibration_file() */
+#define CAL_PATH_MAX 512
+#define CAL_MAGIC "ICCCAL1"
+#define CAL_STR2(x) #x
+#define CAL_STR(x) CAL_STR2(x)
+static char cal_file[CAL_PATH_MAX] = "";
+int cal_loops = -1;   /* loop count from the calibration file */
+int cal_pending = 0;  /* full calibration ran, results not yet saved */
+
 /* Low level timers used across OS variants */
 
 /* 
    START ia32 Linux, OS/X
  */
 #if (defined(__linux__) &&  defined(__i386__) ) || (defined(__APPLE__) && defined(__i386__) )
+#define CAL_TIMER_SRC "i386-rdtsc"
 ICC_UINT64 RdCTR_raw() {
     ICC_UINT32 lo;
     __asm__ __volatile__("rdtsc\n" : "=a" (lo) : : "edx");
@@ -49,6 +65,7 @@ ICC_UINT64 RdCTR_raw() {
 
 /* START Linux ia64 */
 #elif defined(__linux__) && defined(__ia64__)
+#define CAL_TIMER_SRC "ia64-itc"
 
 ICC_UINT64 RdCTR_raw() {
     ICC_UINT64 lo;
@@ -58,6 +75,7 @@ ICC_UINT64 RdCTR_raw() {
 
 /* START HP/UX Itanium with gcc */
 #elif defined(__hpux) && defined(__GNUC__)  &&  defined(__ia64) 
+#define CAL_TIMER_SRC "ia64-itc"
 ICC_UINT64 RdCTR_raw() {
     ICC_UINT64 lo;
     __asm__ __volatile__("mov %0=ar.itc" : "=r"(lo));
@@ -68,6 +86,7 @@ ICC_UINT64 RdCTR_raw() {
 
 /* START HP/UX Itanium with aCC */
 #elif defined(__hpux) &&  defined(__ia64)
+#define CAL_TIMER_SRC "ia64-itc"
 #include <machine/sys/inline.h>
 
 #define __TICKS _Asm_mov_from_ar(_AREG_ITC)
@@ -80,6 +99,7 @@ ICC_UINT64 RdCTR_raw() {
 /* Start X86_64 */
 /* START  X86_64 Linux, OS/X */
 #elif defined(__linux__) && defined(__x86_64__)   || (defined(__APPLE__) && defined(__x86_64__)) || (defined(__sun) && defined(__x86_64__) && defined(__GNUC__))
+#define CAL_TIMER_SRC "x86_64-rdtsc"
 
 ICC_UINT64 RdCTR_raw() {
     ICC_UINT64 lo;
@@ -90,6 +110,7 @@ ICC_UINT64 RdCTR_raw() {
 /* Start OSX_ARM64 */
 
 #elif defined(__APPLE__) && defined(__aarch64__)
+#define CAL_TIMER_SRC "aarch64-monoraw"
 /* OSX_ARM64
 Ref: https://stackoverflow.com/questions/74757124/rdtsc-rdtscp-for-arm-mac-m1-m2
 */
@@ -107,6 +128,7 @@ ICC_UINT64 RdCTR_raw() {
 
 /* START X86_64 Solaris SunPro compiler */
 #elif defined(__SUNPRO_C) && defined(__amd64) 
+#define CAL_TIMER_SRC "gethrtime"
 
 /* UNTESTED, AMD-64 Solaris 10 , should use rdtsc later*/
 
@@ -120,6 +142,7 @@ ICC_UINT64 RdCTR_raw() {
 
 /* START x86, Solaris SunPro compiler */
 #elif defined(__SUNPRO_C) && defined(__i386)
+#define CAL_TIMER_SRC "gethrtime"
 
 /* UNTESTED, Solaris x86 , should use rdtsc later*/
 
@@ -129,6 +152,7 @@ ICC_UINT64 RdCTR_raw() {
 /* END Solaris SunPro compiler */
 /* Solaris x86 with gcc (faster) */
 #elif defined(__sun__) && defined(__i386__) && defined(__GNUC__)
+#define CAL_TIMER_SRC "i386-rdtsc"
 
 ICC_UINT64 RdCTR_raw() {
     ICC_UINT64 lo;
@@ -139,6 +163,7 @@ ICC_UINT64 RdCTR_raw() {
 /* End  Solaris x86 */
 /* Solaris Sparc, external asm */
 #elif defined(__sun) &&  defined(__SUNPRO_C)
+#define CAL_TIMER_SRC "sparc-asm"
 extern volatile unsigned int RdCTR_asm();
 ICC_UINT64 RdCTR_raw() {
   ICC_UINT64 l = 0;
@@ -149,6 +174,7 @@ ICC_UINT64 RdCTR_raw() {
 /* End Solaris Sparc */
 /* PowerPC with GCC, Linux or OS/X - Note PPC on OS/X is dead now. */    
 #elif (defined(__linux__) &&  defined(__PPC__))
+#define CAL_TIMER_SRC "ppc-mftb"
 /* 32 & 64 bit PPC Linux  on PPC*/
 ICC_UINT64 RdCTR_raw() {
     ICC_UINT32 lo;
@@ -165,6 +191,7 @@ ICC_UINT64 RdCTR_raw() {
 // There can be some bias in the cycle counting ...  As far as I am aware, this behavior has been the same at least z13-z16.
 // Looking at [bits] 48:55 seems like probably your best option for the best entropy. - Jonathan Bradbury
 #elif defined(__MVS__)
+#define CAL_TIMER_SRC "z-stcke"
 #include <stdint.h>
 #include <builtins.h> 
 /* STCK1 provides more accuracy (but that may not be needed) .
@@ -184,6 +211,7 @@ ICC_UINT64 RdCTR_raw(void)
 }
 /* END z/OS */
 #elif (defined(__linux__) && defined(__s390__))   
+#define CAL_TIMER_SRC "s390-stcke"
 #include <stdint.h>
 /* Cycle counter on s390/zSeries  */
 
@@ -232,6 +260,7 @@ ICC_UINT64 RdCTR_raw(void)
 {
    ICC_UINT64 ret;
    ret = (ICC_UINT64)gethrtime();
+#define CAL_TIMER_SRC "gethrtime"
    return ret;
 }
 #endif
@@ -242,6 +271,7 @@ ICC_UINT64 RdCTR_raw(void)
 /* End HP/UX on parisc */
 /* Start AIX 32 & 64 bit, external asm used */
 #elif defined(_AIX)
+#define CAL_TIMER_SRC "ppc-tbr"
 extern ICC_UINT32 RdTBR();
 ICC_UINT64 RdCTR_raw()
 {
@@ -254,6 +284,7 @@ ICC_UINT64 RdCTR_raw()
 /* START Windows 32 bit (ia32) */
 
 #elif defined(_WIN32) && !defined(WIN64)
+#define CAL_TIMER_SRC "i386-rdtsc"
 /* 
    Windows on ia32 rdtsc , well this isn't QUITE right, but we only support
    x86 and itanium currently 
@@ -274,6 +305,7 @@ ICC_UINT64 RdCTR_raw()
 #if 1
     unsigned __int64 rv;
     rv = __rdtsc();
+#define CAL_TIMER_SRC "x86_64-rdtsc"
 #else
     LARGE_INTEGER ctr;
     ICC_UINT64 rv;
@@ -289,6 +321,7 @@ ICC_UINT64 RdCTR_raw()
 
 #elif defined(__ARMEL__) || defined(__ARMEB__) || defined(__aarch64__)
 #if 1
+#define CAL_TIMER_SRC "arm-monoraw"
 /* *_ARM - discovered for OSX but should work for all ARM linux
 Ref: https://stackoverflow.com/questions/74757124/rdtsc-rdtscp-for-arm-mac-m1-m2
 */
@@ -307,6 +340,7 @@ ICC_UINT64 RdCTR_raw() {
     Which is painful as generally there's no direct access to the timer registers
 */
 /* Only ARM Linux bypasses RdCTR_raw() at present */
+#define CAL_TIMER_SRC "arm-perf"
 #include <stdint.h>
 #include <sys/ioctl.h>
 #include <linux/perf_event.h>
@@ -360,25 +394,42 @@ unsigned long RdCTR_raw()
 #endif
 #endif
 
+/* The timer source is fixed at compile time so the build and the
+   RdCTR_raw() source above identify it. A calibration is only valid for
+   the timer it was measured with.
+*/
+#if !defined(CAL_TIMER_SRC)
+#define CAL_TIMER_SRC "unknown"
+#endif
+#if !defined(CAL_TIMER_ID)
+#define CAL_TIMER_ID CAL_STR(ICC_VERSION_VER) "." CAL_STR(ICC_VERSION_REL) "." \
+                     CAL_STR(ICC_VERSION_MOD) "." CAL_STR(ICC_VERSION_FIX) "." \
+                     CAL_TIMER_SRC
+#endif
+
+/*! @brief Take a burst of timer samples
+    @param buffer output, len samples already shifted to remove stuck LSBits
+    @param len number of samples
+    @param localloops delay between samples
+    @return len
+    @note the shift is applied as each sample is taken, it's a fixed cost
+    per sample so it doesn't perturb the sampling interval and saves a
+    second pass over the buffer.
+*/
 int RdCtrBurst(ICC_UINT64 *buffer,unsigned int len, int localloops)
 {
-   int rv = 0;
-   int i = 0;
+   unsigned int i = 0;
+   const unsigned int s = shift;
    volatile int k,l; /* Volatile so the compilers don't optimise the delay loop away */
 
     l = localloops;
     for (i = 0; i < len; i++)
     {
-        buffer[i] = RdCTR_raw() ; 
+        buffer[i] = RdCTR_raw() >> s; /* Remove stuck LSBits etc */
         k = 0;
         looper(&k,&l);
     }
-    rv = len;
-
-    for (i = 0; i < len; i++) {
-        buffer[i] = buffer[i] >> shift; /* Remove stuck LSBits etc */
-    }
-    return rv;
+    return (int)len;
 }
 
 
@@ -486,6 +537,128 @@ static int checkShift(int lps,int shft)
 	return prob; /* Probably needs another shift */
 }
 
+/*! @brief Select a file used to persist the timer calibration
+    Full calibration (CalcShift() plus loop tuning) dominates TRNG startup.
+    When a file is set, the result is saved after the first full calibration
+    and reused on later loads on the same host, provided the file is
+    owner-only and a quick checkShift() probe still passes.
+    @param path file name, NULL or "" disables
+    @return 1 if set, 0 if the path was too long
+*/
+int Set_calibration_file(const char *path)
+{
+    int rv = 1;
+    cal_file[0] = '\0';
+    if (NULL != path) {
+        if (strlen(path) < CAL_PATH_MAX) {
+            strcpy(cal_file, path);
+        } else {
+            rv = 0;
+        }
+    }
+    return rv;
+}
+/*! @brief open the calibration file for reading, refusing files
+    other users could have written
+    @return an open FILE or NULL
+*/
+static FILE *cal_open()
+{
+    FILE *fp = NULL;
+#if defined(_WIN32)
+    fp = fopen(cal_file, "r");
+#else
+    struct stat st;
+    int fd = open(cal_file, O_RDONLY);
+    if (fd >= 0) {
+        if ((0 == fstat(fd, &st)) && S_ISREG(st.st_mode) &&
+            (st.st_uid == getuid()) &&
+            (0 == (st.st_mode & (S_IWGRP | S_IWOTH)))) {
+            fp = fdopen(fd, "r");
+        }
+        if (NULL == fp) {
+            close(fd);
+        }
+    }
+#endif
+    return fp;
+}
+
+/*! @brief Try to use a persisted calibration
+    The cached shift is only trusted if checkShift() finds no biased bits
+    with it, anything else falls back to full calibration.
+    @return 1 if shift (and cal_loops) were set from the file
+*/
+static int Load_calibration()
+{
+    FILE *fp = NULL;
+    char id[64];
+    char magic[16];
+    int tuner = -1, shft = -1, lps = -1;
+    int rv = 0;
+
+    if ('\0' != cal_file[0]) {
+        fp = cal_open();
+        if (NULL != fp) {
+            if ((5 == fscanf(fp, "%15s %63s %d %d %d", magic, id, &tuner, &shft, &lps)) &&
+                (0 == strcmp(magic, CAL_MAGIC)) &&
+                (0 == strcmp(id, CAL_TIMER_ID)) &&
+                (tuner == Get_default_tuner()) &&
+                (shft >= 0) && (shft <= 16) && (lps > 0) &&
+                (0 == checkShift(1, shft))) {
+                shift = shft;
+                cal_loops = lps;
+                rv = 1;
+            }
+            fclose(fp);
+        }
+    }
+    return rv;
+}
+
+/*! @brief Persist the result of a full calibration
+    Written to a temporary file and renamed so readers never see a
+    partial record.
+    @param lps the loop count the entropy source settled on
+*/
+void Save_calibration(int lps)
+{
+    FILE *fp = NULL;
+    char tmp[CAL_PATH_MAX + 32];
+
+    cal_pending = 0;
+    if (('\0' != cal_file[0]) && (lps > 0)) {
+#if defined(_WIN32)
+        sprintf(tmp, "%s.tmp", cal_file);
+        fp = fopen(tmp, "w");
+#else
+        int fd = -1;
+        sprintf(tmp, "%s.%ld", cal_file, (long)getpid());
+        fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+        if (fd >= 0) {
+            fp = fdopen(fd, "w");
+            if (NULL == fp) {
+                close(fd);
+            }
+        }
+#endif
+        if (NULL != fp) {
+            int ok = (fprintf(fp, "%s %s %d %u %d\n", CAL_MAGIC, CAL_TIMER_ID,
+                              Get_default_tuner(), shift, lps) > 0);
+            if ((0 == fclose(fp)) && ok) {
+#if defined(_WIN32)
+                remove(cal_file);
+#endif
+                if (0 != rename(tmp, cal_file)) {
+                    remove(tmp);
+                }
+            } else {
+                remove(tmp);
+            }
+        }
+    }
+}
+
 ICC_UINT64 CalcShift(int mn)
 {
     unsigned int i;
@@ -502,8 +675,13 @@ ICC_UINT64 CalcShift(int mn)
     {
         shift = ex_shift;
     }
+    else if (Load_calibration())
+    {
+        /* Cached result still holds on this host, skip full calibration */
+    }
     else
     {
+        cal_pending = ('\0' != cal_file[0]);
         /* Add a sanity check to mn */
         if (mn > 15 || mn < 0)
         {
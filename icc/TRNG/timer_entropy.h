@@ -27,4 +27,6 @@ int Set_rng_setup(int setup);
 int timer_status();
 int RdCtrBurst(ICC_UINT64 *buffer,unsigned int len,int loops);
 ICC_UINT64 CalcShift(int min_loops);
+int Set_calibration_file(const char *path);
+void Save_calibration(int lps);
 #endif
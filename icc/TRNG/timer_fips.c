@@ -11,6 +11,7 @@
 #endif
 
 #include "platform.h"
+#include "platform_api.h"
 #include <string.h>
 #include "TRNG/nist_algs.h"
 #include "TRNG/timer_fips.h"
@@ -71,6 +72,9 @@ static void printbin( char *s,int l)
 */
 extern int shift_done;           /* Have we run CalcShift() */
 extern int ex_loops;    /* loops set from config file or environment */
+extern int cal_loops;   /* loops from the persisted calibration */
+extern int cal_pending; /* calibration still to be persisted */
+unsigned long long calibrate_us = 0; /* uS taken by CalcShift(), for ICC_STARTUP_TIMES */
 static unsigned int loops;       /* loops that we picked, set from here (different in FIPS/non-FIPS modes */
 
 #define PTE 11
@@ -212,12 +216,10 @@ static int dgl(T_FILTER *TF)
     if (NULL != TF)
     {
 
-        memset(TF->samples, 0, sizeof(TF->samples));
-
         /* Clear the histogram data */
         memset(TF->dist, 0, sizeof(DIST) * TE_BUFLEN);
 
-        /* Grab a load of samples */
+        /* Grab a load of samples, RdCtrBurst() fills every slot */
         RdCtrBurst(TF->samples, TE_BUFLEN, ptable[TF->lindex]);
  #if defined(INSTRUMENTED)
         if(NULL == Flogfile) {
@@ -300,21 +302,29 @@ int FIPS_getbytes(E_SOURCE *E, unsigned char *buffer, int len)
     T_FILTER *TF = NULL;
     TRNG_ERRORS rv = TRNG_OK;
     
-    if ((NULL == E) || (E_ESTB_BUFLEN != len))
+    if ((NULL == E) || (NULL == E->tf) || (E_ESTB_BUFLEN != len))
     {
         SetFatalError("Corrupted RNG state detected", __FILE__, __LINE__);
     }
     else
     {
-        TF = &(E->tf);
+        TF = E->tf;
         if (!shift_done)  {
+            unsigned long long t0 = ICC_GetTimeUS();
             CalcShift(0);
             shift_done = 1;
+            calibrate_us = ICC_GetTimeUS() - t0;
         }
         if (ex_loops > 0)
         {
             loops = ex_loops;
         }
+        else if ((0 == loops) && (cal_loops > 0))
+        {
+            /* Start tuning from the saved value, the filter below still
+               raises it if there's too little noise */
+            loops = cal_loops;
+        }
         if (loops > 0)
         {
             for(i = 0; i < PTE; i++) {
@@ -366,6 +376,9 @@ int FIPS_getbytes(E_SOURCE *E, unsigned char *buffer, int len)
                 }
             }
             loops = ptable[TF->lindex];
+            if (cal_pending) {
+                Save_calibration(loops);
+            }
 
             /*  We plausibly had outliers in the samples collected, process those as noise 
             The first two sets of data were assumed to be non-noisy 
@@ -376,17 +389,9 @@ int FIPS_getbytes(E_SOURCE *E, unsigned char *buffer, int len)
             At this point our entropy guarantee is still very low, all we are assured of here is that this was gathered from noise events
             Note the slighly improved collection technique.
             */
-           for (i = 0; (count < E_ESTB_BUFLEN) && (i < TF->nnoise); i++)
-            {
-                unsigned char c;
-                c  = ((TF->samples[i]) & 0xff);
-                if(1 == ChkMem(TF,c)) { /* Skip values that were frequent long term */
-                    /* Try and construct a byte of data from what was captured */
-                    buffer[count] = c;
-                    count++;
-                    proc_mem(TF,c); 
-                }    
-            }
+            /* Skip values that were frequent long term, the low byte of
+               each remaining sample is a byte of data */
+            count += FilterMem(TF, TF->samples, TF->nnoise, buffer + count, E_ESTB_BUFLEN - count);
             if(count == E_ESTB_BUFLEN) {
                 /*! \induced 222. TRNG_FIPS. Fake failure of TRNG source */
                 if(222 == icc_failure) {
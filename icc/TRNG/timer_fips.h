@@ -15,6 +15,8 @@ int FIPS_getbytes(E_SOURCE *E, unsigned char *buffer, int len);
 
 void T_FILTER_Init(T_FILTER *TF);
 
+void FilterMemSelect(void);
+
 unsigned int fips_loops();
 
 #endif
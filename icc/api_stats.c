@@ -0,0 +1,274 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*
+  Per API call counts and latency histograms, ICC_API_STATS.
+
+  Every generated stub in icc_a.c brackets the call into the crypto
+  library with ICC_API_START()/ICC_API_STOP(). Off, that's a test of
+  api_stats_on either side of the call and nothing else. On, the call is
+  timed and counted in the calling thread's shard, a row per API
+  allocated the first time that thread calls it, so there's no sharing
+  between threads on the hot path.
+
+  - Latencies go in log buckets with 4 linear sub-buckets per power of
+    2, see ICC_API_BUCKET_NS() in iccglobals.h.
+  - Shards are summed by ICC_GetValue(ICC_API_STATS_DATA), the totals are
+    approximate while other threads are running.
+  - A thread's counts are folded into the retired totals when it exits.
+  - ICC_SetValue(ICC_API_STATS) turns counting on (1) and off (0),
+    turning it on clears the counts so far.
+*/
+
+/*! @brief One API's counts on one thread */
+typedef struct {
+  unsigned long long calls;
+  unsigned long long total;
+  unsigned long long max;
+  unsigned long long hist[ICC_API_BUCKETS];
+} API_ROW;
+
+/*! @brief One thread's counts */
+typedef struct API_SHARD_t {
+  API_ROW *rows[NUM_ICCFUNCTIONS]; /*!< Allocated on first call */
+  unsigned int gen;                /*!< api_gen when the rows were last cleared */
+  struct API_SHARD_t *prev;        /*!< All threads shards, for reads */
+  struct API_SHARD_t *next;
+} API_SHARD;
+
+static volatile int api_stats_on = 0;   /*!< ICC_API_STATS */
+static int api_stats_ok = 0;            /*!< The key and mutex were created */
+static unsigned int api_gen = 0;        /*!< Bumped when the counts are cleared */
+static ICC_ThreadKey api_key;           /*!< The calling thread's shard */
+static ICC_Mutex api_mtx;               /*!< Protects the shard list and retired rows */
+static API_SHARD *api_shards = NULL;    /*!< Shards of running threads */
+static API_ROW *api_retired[NUM_ICCFUNCTIONS]; /*!< Counts from threads that exited */
+
+/*! Start timing a call, the declaration must start a block */
+#define ICC_API_START(t) unsigned long long t = api_stats_on ? ICC_GetTimeNS() : 0
+/*! Count a call started with ICC_API_START() */
+#define ICC_API_STOP(n, t) if (0 != (t)) api_stats_record((n), (t))
+
+/*! @brief The histogram bucket for a latency
+    @param ns the latency
+    @return 0 to ICC_API_BUCKETS-1
+*/
+static int api_bucket(unsigned long long ns)
+{
+  int p = 2;
+  int b = 0;
+
+  if (ns < 4) {
+    return (int)ns;
+  }
+  while ((p < 63) && ((ns >> (p + 1)) != 0)) {
+    p++;
+  }
+  b = 4 * (p - 1) + (int)((ns >> (p - 2)) & 3);
+  return (b < ICC_API_BUCKETS) ? b : ICC_API_BUCKETS - 1;
+}
+
+/*! @brief Add one set of counts to another
+    @param to the total
+    @param from the counts to add, may be NULL
+*/
+static void api_row_add(API_ROW *to, const API_ROW *from)
+{
+  int i = 0;
+
+  if (NULL != from) {
+    to->calls += from->calls;
+    to->total += from->total;
+    if (from->max > to->max) {
+      to->max = from->max;
+    }
+    for (i = 0; i < ICC_API_BUCKETS; i++) {
+      to->hist[i] += from->hist[i];
+    }
+  }
+}
+
+/*! @brief Unlink a shard and fold it's counts into the retired totals
+    @param sh the shard
+    @note caller holds api_mtx
+*/
+static void api_shard_retire(API_SHARD *sh)
+{
+  int i = 0;
+
+  if (NULL != sh->prev) {
+    sh->prev->next = sh->next;
+  } else {
+    api_shards = sh->next;
+  }
+  if (NULL != sh->next) {
+    sh->next->prev = sh->prev;
+  }
+  for (i = 0; i < NUM_ICCFUNCTIONS; i++) {
+    if (NULL != sh->rows[i]) {
+      if ((sh->gen == api_gen) && (NULL == api_retired[i])) {
+        api_retired[i] = (API_ROW *)calloc(1, sizeof(API_ROW));
+      }
+      if ((sh->gen == api_gen) && (NULL != api_retired[i])) {
+        api_row_add(api_retired[i], sh->rows[i]);
+      }
+      free(sh->rows[i]);
+    }
+  }
+  free(sh);
+}
+
+/*! @brief Thread exit
+    @param ptr the thread's shard
+*/
+static void ICC_TLS_CALLBACK api_thread_exit(void *ptr)
+{
+  if (NULL != ptr) {
+    ICC_LockMutex(&api_mtx);
+    api_shard_retire((API_SHARD *)ptr);
+    ICC_UnlockMutex(&api_mtx);
+  }
+}
+
+/*! @brief Count one call
+    @param n the API's index in the call table
+    @param t0 ICC_GetTimeNS() before the call
+*/
+static void api_stats_record(int n, unsigned long long t0)
+{
+  API_SHARD *sh = NULL;
+  API_ROW *row = NULL;
+  unsigned long long ns = ICC_GetTimeNS() - t0;
+  int i = 0;
+
+  if (!api_stats_ok || (n < 0) || (n >= NUM_ICCFUNCTIONS)) {
+    return;
+  }
+  sh = (API_SHARD *)ICC_GetThreadValue(&api_key);
+  if (NULL == sh) {
+    sh = (API_SHARD *)calloc(1, sizeof(API_SHARD));
+    if (NULL == sh) {
+      return;
+    }
+    ICC_LockMutex(&api_mtx);
+    sh->gen = api_gen;
+    sh->next = api_shards;
+    if (NULL != api_shards) {
+      api_shards->prev = sh;
+    }
+    api_shards = sh;
+    ICC_UnlockMutex(&api_mtx);
+    ICC_SetThreadValue(&api_key, sh);
+  }
+  /* The counts were cleared since this thread last counted */
+  if (sh->gen != api_gen) {
+    sh->gen = api_gen;
+    for (i = 0; i < NUM_ICCFUNCTIONS; i++) {
+      if (NULL != sh->rows[i]) {
+        memset(sh->rows[i], 0, sizeof(API_ROW));
+      }
+    }
+  }
+  row = sh->rows[n];
+  if (NULL == row) {
+    row = sh->rows[n] = (API_ROW *)calloc(1, sizeof(API_ROW));
+    if (NULL == row) {
+      return;
+    }
+  }
+  row->calls++;
+  row->total += ns;
+  if (ns > row->max) {
+    row->max = ns;
+  }
+  row->hist[api_bucket(ns)]++;
+}
+
+/*! @brief Turn counting on or off
+    @param on 1 to count, clearing the counts so far, 0 to stop
+    @return 1 if on was valid
+*/
+static int SetApiStats(int on)
+{
+  int i = 0;
+
+  if ((0 != on) && (1 != on)) {
+    return 0;
+  }
+  if (api_stats_ok && on && !api_stats_on) {
+    ICC_LockMutex(&api_mtx);
+    /* Running threads clear their own rows on their next call */
+    api_gen++;
+    for (i = 0; i < NUM_ICCFUNCTIONS; i++) {
+      if (NULL != api_retired[i]) {
+        memset(api_retired[i], 0, sizeof(API_ROW));
+      }
+    }
+    ICC_UnlockMutex(&api_mtx);
+  }
+  api_stats_on = api_stats_ok ? on : 0;
+  return 1;
+}
+
+/*! @brief Sum the counts over all threads
+    @param pcb the context, for the API names
+    @param out the caller's array
+    @param n entries in out, unused entries are zeroed
+*/
+static void api_stats_read(ICC_CTX *pcb, ICC_API_STAT *out, size_t n)
+{
+  API_SHARD *sh = NULL;
+  API_ROW sum;
+  const char *name = NULL;
+  size_t k = 0;
+  int i = 0;
+
+  memset(out, 0, n * sizeof(ICC_API_STAT));
+  if (!api_stats_ok) {
+    return;
+  }
+  ICC_LockMutex(&api_mtx);
+  for (i = 0; (i < NUM_ICCFUNCTIONS) && (k < n); i++) {
+    memset(&sum, 0, sizeof(sum));
+    api_row_add(&sum, api_retired[i]);
+    for (sh = api_shards; NULL != sh; sh = sh->next) {
+      if (sh->gen == api_gen) {
+        api_row_add(&sum, sh->rows[i]);
+      }
+    }
+    if (0 != sum.calls) {
+      name = NULL;
+      if ((NULL != pcb) && (NULL != pcb->funcs)) {
+        name = (*(pcb->funcs))[i].name;
+      }
+      strncpy(out[k].name, (NULL != name) ? name : "?", sizeof(out[k].name) - 1);
+      out[k].calls = sum.calls;
+      out[k].total_ns = sum.total;
+      out[k].max_ns = sum.max;
+      memcpy(out[k].hist, sum.hist, sizeof(sum.hist));
+      k++;
+    }
+  }
+  ICC_UnlockMutex(&api_mtx);
+}
+
+/*! @brief Create the thread key, on first ICC_Init()
+    @note Like ICCGlobal.mtx this races if the first ICC_Init() calls do
+*/
+static void api_stats_init(void)
+{
+  if (!api_stats_ok) {
+    if (0 == ICC_CreateMutex(&api_mtx)) {
+      if (0 == ICC_CreateThreadKey(&api_key, api_thread_exit)) {
+        api_stats_ok = 1;
+      } else {
+        ICC_DestroyMutex(&api_mtx);
+      }
+    }
+  }
+}
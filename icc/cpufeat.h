@@ -0,0 +1,54 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: CPU features the accelerated code paths depend on.
+//
+// Probed once at load (OS_CpuFeaturesInit() in OS_helpers.c) from the
+// capability vectors OpenSSL itself dispatches on, so ICC_CAP_MASK and
+// OPENSSL_ia32cap/OPENSSL_armcap/OPENSSL_ppccap masking are honoured.
+// Code picking a fast path tests OS_CpuFeatures() rather than probing
+// the hardware again. ICC_GetValue(ICC_CPU_FEATURES) returns the names.
+*************************************************************************/
+
+#if !defined(INCLUDED_CPUFEAT)
+#define INCLUDED_CPUFEAT
+
+/* x86 */
+#define ICC_CPUF_AESNI        0x00000001 /*!< AES-NI */
+#define ICC_CPUF_PCLMUL       0x00000002 /*!< PCLMULQDQ */
+#define ICC_CPUF_VAES         0x00000004 /*!< VAES */
+#define ICC_CPUF_VPCLMUL      0x00000008 /*!< VPCLMULQDQ */
+#define ICC_CPUF_SHANI        0x00000010 /*!< SHA extensions */
+#define ICC_CPUF_AVX2         0x00000020 /*!< AVX2, OS saves the state */
+#define ICC_CPUF_AVX512       0x00000040 /*!< AVX-512F, OS saves the state */
+#define ICC_CPUF_RDSEED       0x00000080 /*!< RDSEED */
+/* ARMv8 */
+#define ICC_CPUF_NEON         0x00000100 /*!< Advanced SIMD */
+#define ICC_CPUF_ARMAES       0x00000200 /*!< AESE/AESD */
+#define ICC_CPUF_PMULL        0x00000400 /*!< 64 bit polynomial multiply */
+#define ICC_CPUF_ARMSHA2      0x00000800 /*!< SHA-256 instructions */
+#define ICC_CPUF_ARMSHA512    0x00001000 /*!< SHA-512 instructions */
+#define ICC_CPUF_ARMSHA3      0x00002000 /*!< EOR3/RAX1/XAR/BCAX */
+#define ICC_CPUF_RNDR         0x00004000 /*!< RNDR/RNDRRS */
+/* POWER */
+#define ICC_CPUF_VSX          0x00010000 /*!< VSX */
+#define ICC_CPUF_VCRYPTO      0x00020000 /*!< POWER8 vcipher/vshasigma/vpmsum */
+#define ICC_CPUF_DARN         0x00040000 /*!< POWER9 darn */
+/* z, CPACF function codes */
+#define ICC_CPUF_CPACF_AES    0x00100000 /*!< KM/KMC AES-128/192/256 */
+#define ICC_CPUF_CPACF_KMA    0x00200000 /*!< KMA GCM, all AES key sizes */
+#define ICC_CPUF_CPACF_GHASH  0x00400000 /*!< KIMD GHASH */
+#define ICC_CPUF_CPACF_SHA3   0x00800000 /*!< KIMD/KLMD SHA3-224..512 */
+#define ICC_CPUF_CPACF_TRNG   0x01000000 /*!< PRNO TRNG */
+
+void OS_CpuFeaturesInit(void);
+unsigned int OS_CpuFeatures(void);
+int OS_CpuFeatureNames(char *buf, int len);
+
+#endif
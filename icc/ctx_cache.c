@@ -0,0 +1,270 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*
+  Per thread free lists of EVP_MD_CTX, EVP_CIPHER_CTX and HMAC_CTX.
+
+  Callers create and free a context per operation, with these lists
+  ICC_EVP_MD_CTX_free() resets the context and keeps it, and the next
+  ICC_EVP_MD_CTX_new() on that thread pops it again. An HMAC_CTX keeps
+  it's three digest contexts as well, so a reused one saves four
+  allocations.
+
+  - Contexts are reset before they go on a list, a popped context is
+    indistinguishable from a new one.
+  - Each list holds at most ctx_cache_depth contexts, set with
+    ICC_SetValue(ICC_CTX_CACHE) or ICC_CTX_CACHE in the environment.
+    0, the default, turns the lists off.
+  - A context freed on a different thread from the one that created it
+    just goes on the freeing thread's list.
+  - The lists are released at thread exit and at unload.
+  - Hit/miss counts are kept per thread, so counting costs no shared
+    cache lines. ICC_GetValue(ICC_CTX_CACHE_STATS) adds them up, the
+    totals are approximate while other threads are running.
+*/
+
+#define CTX_CACHE_MAX 64 /*!< Largest ICC_CTX_CACHE */
+
+#define CC_MD     0 /*!< EVP_MD_CTX list */
+#define CC_CIPHER 1 /*!< EVP_CIPHER_CTX list */
+#define CC_HMAC   2 /*!< HMAC_CTX list */
+#define CC_TYPES  3
+
+/*! @brief One thread's lists */
+typedef struct CTX_CACHE_t {
+  void *ctx[CC_TYPES][CTX_CACHE_MAX]; /*!< Reset contexts */
+  int n[CC_TYPES];                    /*!< Entries in use */
+  ICC_CTX_CACHE_COUNTS stats;          /*!< This thread's counts */
+  struct CTX_CACHE_t *prev;           /*!< All thread's lists, for stats and unload */
+  struct CTX_CACHE_t *next;
+} CTX_CACHE;
+
+static int ctx_cache_depth = 0;         /*!< Contexts kept per type per thread, 0 is off */
+static int ctx_cache_ok = 0;            /*!< The key and mutex were created */
+static ICC_ThreadKey ctx_cache_key;     /*!< The calling thread's lists */
+static ICC_Mutex ctx_cache_mtx;         /*!< Protects the thread list and retired counts */
+static CTX_CACHE *ctx_caches = NULL;    /*!< Lists of running threads */
+static ICC_CTX_CACHE_COUNTS ctx_cache_retired; /*!< Counts from threads that exited */
+
+/*! @brief Free a context of one type
+    @param type CC_MD, CC_CIPHER or CC_HMAC
+    @param ctx the context
+*/
+static void ctx_cache_release(int type, void *ctx)
+{
+  switch (type) {
+  case CC_MD:
+    EVP_MD_CTX_free((EVP_MD_CTX *)ctx);
+    break;
+  case CC_CIPHER:
+    EVP_CIPHER_CTX_free((EVP_CIPHER_CTX *)ctx);
+    break;
+  default:
+    HMAC_CTX_free((HMAC_CTX *)ctx);
+    break;
+  }
+}
+
+/*! @brief Free everything on a set of lists, fold the counts into the totals
+    @param cc the lists, already unlinked
+    @note caller holds ctx_cache_mtx
+*/
+static void ctx_cache_drain(CTX_CACHE *cc)
+{
+  int t = 0;
+
+  for (t = 0; t < CC_TYPES; t++) {
+    while (cc->n[t] > 0) {
+      ctx_cache_release(t, cc->ctx[t][--cc->n[t]]);
+    }
+  }
+  ctx_cache_retired.hits += cc->stats.hits;
+  ctx_cache_retired.misses += cc->stats.misses;
+  ctx_cache_retired.dropped += cc->stats.dropped;
+  free(cc);
+}
+
+/*! @brief Thread exit
+    @param ptr the thread's lists
+*/
+static void ICC_TLS_CALLBACK ctx_cache_thread_exit(void *ptr)
+{
+  CTX_CACHE *cc = (CTX_CACHE *)ptr;
+
+  /* Windows also calls this from FlsFree() at unload, after
+     ctx_cache_final() has freed everything
+  */
+  if ((NULL != cc) && ctx_cache_ok) {
+    ICC_LockMutex(&ctx_cache_mtx);
+    if (NULL != cc->prev) {
+      cc->prev->next = cc->next;
+    } else {
+      ctx_caches = cc->next;
+    }
+    if (NULL != cc->next) {
+      cc->next->prev = cc->prev;
+    }
+    ctx_cache_drain(cc);
+    ICC_UnlockMutex(&ctx_cache_mtx);
+  }
+}
+
+/*! @brief The calling thread's lists
+    @param create create them if this thread has none
+    @return the lists, or NULL if the cache is off or this thread has none
+*/
+static CTX_CACHE *ctx_cache_get(int create)
+{
+  CTX_CACHE *cc = NULL;
+
+  if (ctx_cache_ok) {
+    cc = (CTX_CACHE *)ICC_GetThreadValue(&ctx_cache_key);
+    if ((NULL == cc) && create && (ctx_cache_depth > 0)) {
+      cc = (CTX_CACHE *)calloc(1, sizeof(CTX_CACHE));
+      if (NULL != cc) {
+        ICC_LockMutex(&ctx_cache_mtx);
+        cc->next = ctx_caches;
+        if (NULL != ctx_caches) {
+          ctx_caches->prev = cc;
+        }
+        ctx_caches = cc;
+        ICC_UnlockMutex(&ctx_cache_mtx);
+        ICC_SetThreadValue(&ctx_cache_key, cc);
+      }
+    }
+  }
+  return cc;
+}
+
+/*! @brief Pop a reset context
+    @param type CC_MD, CC_CIPHER or CC_HMAC
+    @return the context, or NULL, the caller allocates a new one
+*/
+static void *ctx_cache_pop(int type)
+{
+  CTX_CACHE *cc = NULL;
+  void *ctx = NULL;
+
+  if (ctx_cache_depth > 0) {
+    cc = ctx_cache_get(1);
+    if (NULL != cc) {
+      if (cc->n[type] > 0) {
+        ctx = cc->ctx[type][--cc->n[type]];
+        cc->stats.hits++;
+      } else {
+        cc->stats.misses++;
+      }
+    }
+  }
+  return ctx;
+}
+
+/*! @brief Keep a reset context for reuse
+    @param type CC_MD, CC_CIPHER or CC_HMAC
+    @param ctx the context, already reset
+    @return 1 if it was kept, 0 if the caller must free it
+*/
+static int ctx_cache_push(int type, void *ctx)
+{
+  CTX_CACHE *cc = NULL;
+  int depth = ctx_cache_depth;
+
+  cc = ctx_cache_get(depth > 0);
+  if (NULL == cc) {
+    return 0;
+  }
+  /* The depth may have been lowered since these were kept */
+  while (cc->n[type] > depth) {
+    ctx_cache_release(type, cc->ctx[type][--cc->n[type]]);
+  }
+  if (cc->n[type] < depth) {
+    cc->ctx[type][cc->n[type]++] = ctx;
+    return 1;
+  }
+  cc->stats.dropped++;
+  return 0;
+}
+
+/*! @brief Set the number of contexts kept per type per thread
+    @param n 0 (off) to CTX_CACHE_MAX
+    @return 1 if n was valid, 0 otherwise
+*/
+static int SetCtxCacheDepth(int n)
+{
+  if ((n < 0) || (n > CTX_CACHE_MAX)) {
+    return 0;
+  }
+  ctx_cache_depth = n;
+  return 1;
+}
+
+/*! @brief Sum the hit counts over all threads
+    @param stats returned
+*/
+static void ctx_cache_stats(ICC_CTX_CACHE_COUNTS *stats)
+{
+  CTX_CACHE *cc = NULL;
+
+  memset(stats, 0, sizeof(ICC_CTX_CACHE_COUNTS));
+  if (ctx_cache_ok) {
+    ICC_LockMutex(&ctx_cache_mtx);
+    *stats = ctx_cache_retired;
+    for (cc = ctx_caches; NULL != cc; cc = cc->next) {
+      stats->hits += cc->stats.hits;
+      stats->misses += cc->stats.misses;
+      stats->dropped += cc->stats.dropped;
+    }
+    ICC_UnlockMutex(&ctx_cache_mtx);
+  }
+}
+
+/*! @brief Create the thread key, at load */
+static void ctx_cache_init(void)
+{
+  if (0 == ICC_CreateMutex(&ctx_cache_mtx)) {
+    if (0 == ICC_CreateThreadKey(&ctx_cache_key, ctx_cache_thread_exit)) {
+      ctx_cache_ok = 1;
+    } else {
+      ICC_DestroyMutex(&ctx_cache_mtx);
+    }
+  }
+}
+
+/*! @brief Release every thread's lists, at unload
+    @note no other thread may be using ICC
+*/
+static void ctx_cache_final(void)
+{
+  CTX_CACHE *cc = NULL;
+
+  if (ctx_cache_ok) {
+    ctx_cache_ok = 0;
+    ICC_LockMutex(&ctx_cache_mtx);
+    while (NULL != ctx_caches) {
+      cc = ctx_caches;
+      ctx_caches = cc->next;
+      ctx_cache_drain(cc);
+    }
+    ICC_UnlockMutex(&ctx_cache_mtx);
+    ICC_DestroyThreadKey(&ctx_cache_key);
+    ICC_DestroyMutex(&ctx_cache_mtx);
+  }
+}
+
+/*! @brief ICC_FAST_EXIT unload, delete the thread key but leave every
+    thread's lists for the OS to reclaim
+    @note ctx_cache_thread_exit() must not be left registered once the 
+    library is unmapped
+*/
+static void ctx_cache_forget(void)
+{
+  if (ctx_cache_ok) {
+    ctx_cache_ok = 0;
+    ICC_DestroyThreadKey(&ctx_cache_key);
+  }
+}
@@ -70,10 +70,18 @@ Equivalent environment variable (none)
 #else
 #include <sys/time.h>
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <time.h>
+#define HASH_MMAP 1 /*!< Hash files via a read only mapping where we can */
 #endif
 #include "openssl/err.h"
 #include "openssl/evp.h"
 #include "openssl/rsa.h"
+#include "openssl/hmac.h"
+#include "openssl/crypto.h"
 
 
 #include "extsig.h"
@@ -136,6 +144,52 @@ static int Block2Bin(char *in, unsigned char *outb) {
   return signL;
 }
 
+#if defined(HASH_MMAP)
+#define HASH_MMAP_CHUNK (1024 * 1024) /*!< Bytes per digest update from the map */
+/*! @brief Hash the start of a file through a read only mapping
+  @param fin the file pointer
+  @param pos the number of bytes to hash, must be > 0
+  @param md_ctx an initialized message digest context
+  @return 1 if the file was mapped and hashed, 0 if the caller should
+  fall back to reading it
+*/
+static int HashMapped(FILE *fin, long pos, EVP_MD_CTX *md_ctx) {
+  int rv = 0;
+  int rc = 0;
+  int fd = -1;
+  void *map = NULL;
+  long off = 0;
+  long amt = 0;
+  struct stat sbuf;
+
+  fd = fileno(fin);
+  if ((fd >= 0) && (pos > 0) && (0 == fstat(fd, &sbuf)) &&
+      S_ISREG(sbuf.st_mode) && ((off_t)pos <= sbuf.st_size)) {
+    map = mmap(NULL, (size_t)pos, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED != map) {
+#if defined(MADV_SEQUENTIAL)
+      (void)madvise(map, (size_t)pos, MADV_SEQUENTIAL);
+#endif
+      for (off = 0; off < pos; off += amt) {
+        amt = HASH_MMAP_CHUNK;
+        if ((pos - off) < amt) {
+          amt = pos - off;
+        }
+        rc = EVP_DigestUpdate(md_ctx, (unsigned char *)map + off, (size_t)amt);
+        if (1 != rc) {
+          printf("HashCore:EVP_DigestUpdate failed %d\n", rc);
+        }
+      }
+      munmap(map, (size_t)pos);
+      /* Leave the stream where the read loop would have */
+      fseek(fin, pos, SEEK_SET);
+      rv = 1;
+    }
+  }
+  return rv;
+}
+#endif
+
 /*! @brief
   @param fin the file pointer
   @param pos the offset in the file to hash to. (0 it's calculated as the total
@@ -146,6 +200,8 @@ static int Block2Bin(char *in, unsigned char *outb) {
   @note WARNING, this code uses an OpenSSL specific trick
   SignInit/VerifyInit are aliases to DigestInit
   "" Update
+  @note Where mmap() is available the file is mapped and hashed in large
+  blocks, the fread() loop is the fallback
 */
 static long HashCore(FILE *fin, long pos, EVP_MD_CTX *md_ctx,
                      const EVP_MD *md) {
@@ -164,6 +220,11 @@ static long HashCore(FILE *fin, long pos, EVP_MD_CTX *md_ctx,
     if (1 != rc) {
        printf("HashCore:EVP_DigestInit failed %d\n", rc);
     }
+#if defined(HASH_MMAP)
+    if ((1 == rc) && HashMapped(fin, pos, md_ctx)) {
+      pos = 0;
+    }
+#endif
     /* Work out how much to read */
     while (pos > 0) {
       amt = sizeof(fbuf);
@@ -230,6 +291,314 @@ static void GenPHash(FILE *fin, long pos) {
   GenHash(fin, digest, pos);
 }
 
+#if !defined(_WIN32)
+#define SIG_CACHE 1 /*!< Digest cache for the library check, keyed by inode */
+#endif
+
+#if defined(SIG_CACHE)
+/* Library digest cache, ICC_INTEGRITY_CACHE
+
+   One line per library,
+   ICCDC1 dev inode size mtime ctime digest mac
+   mac is HMAC-SHA256 over the rest of the line, keyed with the
+   library's FILE= signature. A record is only used when stat() of the
+   library still gives the same key and the cached digest verifies
+   against the signature, so it saves the hash, never the RSA verify.
+
+   The MAC ties a record to the signature it was made for and catches
+   corruption, the signature is public though, so what stops a forged
+   record is that the file and it's directory have to be owned by root
+   and not writable by anyone else, and only root writes it. Whoever can
+   write it as root could also replace the library.
+*/
+#define SIG_CACHE_TAG "ICCDC1"
+#define SIG_CACHE_MAX 32   /*!< Records kept, one per library */
+#define SIG_CACHE_SETTLE 2 /*!< Seconds a file must be unchanged to be cached */
+
+/*! @brief What identifies one version of a file */
+typedef struct {
+  unsigned long long dev;
+  unsigned long long ino;
+  unsigned long long size;
+  unsigned long long mtime;
+  unsigned long long ctime;
+} SIG_CACHE_KEY;
+
+/*! @brief Fill in the cache key for an open file
+  @return 1 on success
+*/
+static int CacheKey(FILE *f, SIG_CACHE_KEY *k) {
+  struct stat sbuf;
+
+  if ((0 != fstat(fileno(f), &sbuf)) || !S_ISREG(sbuf.st_mode)) {
+    return 0;
+  }
+  k->dev = (unsigned long long)sbuf.st_dev;
+  k->ino = (unsigned long long)sbuf.st_ino;
+  k->size = (unsigned long long)sbuf.st_size;
+  k->mtime = (unsigned long long)sbuf.st_mtime;
+  k->ctime = (unsigned long long)sbuf.st_ctime;
+  return 1;
+}
+
+/*! @brief Is an object owned by root and not writable by others */
+static int RootOnly(struct stat *sbuf) {
+  return (0 == sbuf->st_uid) && (0 == (sbuf->st_mode & (S_IWGRP | S_IWOTH)));
+}
+
+/*! @brief Check the directory holding the cache is root only */
+static int CacheDirOK(const char *path) {
+  char dir[1024];
+  char *p = NULL;
+  struct stat sbuf;
+
+  if (strlen(path) >= sizeof(dir)) {
+    return 0;
+  }
+  strcpy(dir, path);
+  p = strrchr(dir, '/');
+  if (NULL == p) {
+    strcpy(dir, ".");
+  } else if (p == dir) {
+    p[1] = '\0';
+  } else {
+    *p = '\0';
+  }
+  return (0 == stat(dir, &sbuf)) && S_ISDIR(sbuf.st_mode) && RootOnly(&sbuf);
+}
+
+/*! @brief Format a record, without the MAC or line end */
+static void CacheRecord(char *out, const SIG_CACHE_KEY *k, const unsigned char *dgst) {
+  int i = 0;
+
+  sprintf(out, "%s %llu %llu %llu %llu %llu ", SIG_CACHE_TAG, k->dev, k->ino, k->size,
+          k->mtime, k->ctime);
+  out += strlen(out);
+  for (i = 0; i < 32; i++) {
+    sprintf(out + 2 * i, "%02x", dgst[i]);
+  }
+}
+
+/*! @brief MAC a record, as hex */
+static int CacheMAC(const char *rec, const unsigned char *sig, int sigL, char *hex) {
+  unsigned char mac[EVP_MAX_MD_SIZE];
+  unsigned int macL = 0;
+  unsigned int i = 0;
+
+  if (NULL == HMAC(EVP_sha256(), sig, sigL, (const unsigned char *)rec, strlen(rec), mac, &macL)) {
+    return 0;
+  }
+  for (i = 0; i < macL; i++) {
+    sprintf(hex + 2 * i, "%02x", mac[i]);
+  }
+  return 1;
+}
+
+/*! @brief Open the cache for reading, if it's safe to trust
+  @return the open file or NULL
+*/
+static FILE *CacheOpen(const char *path) {
+  struct stat sbuf;
+  FILE *f = NULL;
+  int fd = -1;
+  int flags = O_RDONLY;
+
+#if defined(O_NOFOLLOW)
+  flags |= O_NOFOLLOW;
+#endif
+  if (!CacheDirOK(path)) {
+    return NULL;
+  }
+  fd = open(path, flags);
+  if (fd < 0) {
+    return NULL;
+  }
+  if ((0 != fstat(fd, &sbuf)) || !S_ISREG(sbuf.st_mode) || !RootOnly(&sbuf) ||
+      (NULL == (f = fdopen(fd, "r")))) {
+    close(fd);
+    return NULL;
+  }
+  return f;
+}
+
+/*! @brief Look for a valid record for a library
+  @param path the cache
+  @param k the library's key
+  @param sig the library's signature, the MAC key
+  @param sigL it's length
+  @param dgst where to return the digest
+  @return 1 if found
+*/
+static int CacheLookup(const char *path, const SIG_CACHE_KEY *k, const unsigned char *sig,
+                       int sigL, unsigned char *dgst) {
+  char line[512];
+  char rec[256];
+  char mac[2 * EVP_MAX_MD_SIZE + 1];
+  char *p = NULL;
+  SIG_CACHE_KEY rk;
+  FILE *f = NULL;
+  int rv = 0;
+
+  f = CacheOpen(path);
+  if (NULL == f) {
+    return 0;
+  }
+  while (!rv && (NULL != fgets(line, sizeof(line), f))) {
+    bClean(line);
+    p = strrchr(line, ' ');
+    if ((NULL == p) || (5 != sscanf(line, SIG_CACHE_TAG " %llu %llu %llu %llu %llu", &rk.dev,
+                                    &rk.ino, &rk.size, &rk.mtime, &rk.ctime))) {
+      continue;
+    }
+    if ((rk.dev != k->dev) || (rk.ino != k->ino) || (rk.size != k->size) ||
+        (rk.mtime != k->mtime) || (rk.ctime != k->ctime) || ((p - line) < 64) ||
+        ((size_t)(p - line) >= sizeof(rec))) {
+      continue;
+    }
+    memcpy(rec, line, p - line);
+    rec[p - line] = '\0';
+    if (CacheMAC(rec, sig, sigL, mac) && (strlen(mac) == strlen(p + 1)) &&
+        (0 == CRYPTO_memcmp(mac, p + 1, strlen(mac)))) {
+      rv = (32 == Block2Bin(rec + strlen(rec) - 64, dgst));
+    }
+  }
+  fclose(f);
+  return rv;
+}
+
+/*! @brief Add or replace the record for a library, root only
+  @param path the cache
+  @param k the library's key
+  @param sig the library's signature, the MAC key
+  @param sigL it's length
+  @param dgst the library's digest, which has verified
+*/
+static void CacheStore(const char *path, const SIG_CACHE_KEY *k, const unsigned char *sig,
+                       int sigL, const unsigned char *dgst) {
+  char tmp[1100];
+  char line[512];
+  char rec[256];
+  char mac[2 * EVP_MAX_MD_SIZE + 1];
+  char *keep[SIG_CACHE_MAX];
+  SIG_CACHE_KEY rk;
+  FILE *f = NULL;
+  int fd = -1;
+  int n = 0, i = 0, ok = 0;
+
+  if ((0 != geteuid()) || (strlen(path) > 1024) ||
+      ((time(NULL) - (time_t)k->mtime) < SIG_CACHE_SETTLE) ||
+      ((time(NULL) - (time_t)k->ctime) < SIG_CACHE_SETTLE)) {
+    /* A file changed in the last second or so could change again
+       without it's mtime moving, don't cache it yet */
+    return;
+  }
+  CacheRecord(rec, k, dgst);
+  if (!CacheMAC(rec, sig, sigL, mac)) {
+    return;
+  }
+  /* Keep the records for other libraries, drop the oldest past the limit */
+  f = CacheOpen(path);
+  if (NULL != f) {
+    while (NULL != fgets(line, sizeof(line), f)) {
+      bClean(line);
+      if ((5 != sscanf(line, SIG_CACHE_TAG " %llu %llu %llu %llu %llu", &rk.dev, &rk.ino,
+                       &rk.size, &rk.mtime, &rk.ctime)) ||
+          ((rk.dev == k->dev) && (rk.ino == k->ino))) {
+        continue;
+      }
+      if (n == SIG_CACHE_MAX - 1) {
+        free(keep[0]);
+        memmove(keep, keep + 1, (n - 1) * sizeof(char *));
+        n--;
+      }
+      keep[n] = strdup(line);
+      if (NULL != keep[n]) {
+        n++;
+      }
+    }
+    fclose(f);
+  } else if (!CacheDirOK(path)) {
+    return;
+  }
+  sprintf(tmp, "%s.%ld", path, (long)getpid());
+  fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (fd >= 0) {
+    f = fdopen(fd, "w");
+    if (NULL != f) {
+      for (i = 0; i < n; i++) {
+        fprintf(f, "%s\n", keep[i]);
+      }
+      fprintf(f, "%s %s\n", rec, mac);
+      ok = (0 == fflush(f)) && (0 == fsync(fd));
+      ok = (0 == fclose(f)) && ok;
+    } else {
+      close(fd);
+    }
+    if (!ok || (0 != rename(tmp, path))) {
+      unlink(tmp);
+    }
+  }
+  for (i = 0; i < n; i++) {
+    free(keep[i]);
+  }
+}
+
+/*! @brief Verify an RSA PKCS#1 signature on an already computed digest,
+  as EVP_VerifyFinal() does after finalizing the digest
+  @return 1 if the signature verifies
+*/
+static int VerifyDigest(EVP_PKEY *key, const EVP_MD *md, const unsigned char *dgst,
+                        unsigned int dgstL, const unsigned char *sig, int sigL) {
+  EVP_PKEY_CTX *pctx = NULL;
+  int rv = 0;
+
+  pctx = EVP_PKEY_CTX_new(key, NULL);
+  if ((NULL != pctx) && (1 == EVP_PKEY_verify_init(pctx)) &&
+      (EVP_PKEY_CTX_set_signature_md(pctx, md) > 0)) {
+    rv = EVP_PKEY_verify(pctx, sig, (size_t)sigL, dgst, (size_t)dgstL);
+  }
+  if (NULL != pctx) {
+    EVP_PKEY_CTX_free(pctx);
+  }
+  return (1 == rv) ? 1 : 0;
+}
+
+/*! @brief The library check, through the digest cache
+  @param targ the library
+  @param cache the cache path
+  @param md_ctx message digest context
+  @param md message digest, SHA256
+  @param sig the library's signature
+  @param sigL it's length
+  @param key the public key
+  @return 1 if the signature verifies, as EVP_VerifyFinal()
+  @note On a cache miss, or a cached digest that doesn't verify, the
+  library is hashed as without the cache and the result stored
+*/
+static int CachedVerify(FILE *targ, const char *cache, EVP_MD_CTX *md_ctx, const EVP_MD *md,
+                        unsigned char *sig, int sigL, EVP_PKEY *key) {
+  SIG_CACHE_KEY k;
+  unsigned char dgst[EVP_MAX_MD_SIZE];
+  unsigned int dgstL = 0;
+  int haskey = 0;
+  int rv = 0;
+
+  haskey = CacheKey(targ, &k);
+  if (haskey && CacheLookup(cache, &k, sig, sigL, dgst) &&
+      VerifyDigest(key, md, dgst, 32, sig, sigL)) {
+    return 1;
+  }
+  HashCore(targ, 0, md_ctx, md);
+  if (1 == EVP_DigestFinal(md_ctx, dgst, &dgstL)) {
+    rv = VerifyDigest(key, md, dgst, dgstL, sig, sigL);
+  }
+  if ((1 == rv) && haskey && (32 == dgstL)) {
+    CacheStore(cache, &k, sig, sigL, dgst);
+  }
+  return rv;
+}
+#endif
+
 int ReadConfigItems(FILE *fin, char *tweaks[], int n) {
   int i = 0;
   long pos = 0;
@@ -281,10 +650,13 @@ int ReadConfigItems(FILE *fin, char *tweaks[], int n) {
   @brief targ The open file handle of the binary
   @brief rsaPKey A pointer to the PKEY containing the public key
   @brief OnlySigFile if set only the signature file is checked
+  @brief cache the library digest cache, NULL to always hash the library
   @return 0 O.K. 1 self sig fails, 2 file sig fails,
           3 "something bad", 4 0 length file
+  @note The cache is only used on platforms with SIG_CACHE
 */
-int CheckSig(FILE *sigfile, FILE *targ, EVP_PKEY *rsaPKey, int OnlySigFile) {
+int CheckSigCached(FILE *sigfile, FILE *targ, EVP_PKEY *rsaPKey, int OnlySigFile,
+                   const char *cache) {
   int rv = 0; /* 0 O.K. 1 self sig fails, 2 file sig fails, 3 SBH */
   long fpos = 0;
   long pos = 0;
@@ -377,8 +749,15 @@ int CheckSig(FILE *sigfile, FILE *targ, EVP_PKEY *rsaPKey, int OnlySigFile) {
           bClean((char *)ptr);
           memset(signB, 0, sizeof(signB));
           signL = Block2Bin((char *)ptr, signB);
-          HashCore(targ, 0, md_ctx, md);
-          evpRC = EVP_VerifyFinal(md_ctx, signB, signL, rsaPKey);
+#if defined(SIG_CACHE)
+          if (NULL != cache) {
+            evpRC = CachedVerify(targ, cache, md_ctx, md, signB, signL, rsaPKey);
+          } else
+#endif
+          {
+            HashCore(targ, 0, md_ctx, md);
+            evpRC = EVP_VerifyFinal(md_ctx, signB, signL, rsaPKey);
+          }
           if (1 != evpRC) {
             rv = 2;
           }
@@ -395,6 +774,13 @@ int CheckSig(FILE *sigfile, FILE *targ, EVP_PKEY *rsaPKey, int OnlySigFile) {
   OUTRC(rv);
   return rv;
 }
+/*! @brief
+  Signature check, always hashing the library
+  @see CheckSigCached()
+*/
+int CheckSig(FILE *sigfile, FILE *targ, EVP_PKEY *rsaPKey, int OnlySigFile) {
+  return CheckSigCached(sigfile, targ, rsaPKey, OnlySigFile, NULL);
+}
 #if defined(STANDALONE)
 /*!
   @brief return the Day of the week as a string given a
@@ -645,8 +1031,126 @@ static int GenSig(FILE *fin, unsigned char *sigout, EVP_PKEY *key, long pos) {
   }
   return (int)signL;
 }
+#if defined(SIG_CACHE)
+/*! @brief Exercise the library digest cache on a scratch file
+  Verify twice, the second from the cache, then a planted record with
+  a bad digest, then change the file and check it no longer verifies
+  @param key the signing key
+  @return the number of failures
+  @note Only root writes the cache, otherwise the test is skipped
+*/
+static int CacheSelfTest(EVP_PKEY *key) {
+  char dir[] = "/tmp/iccdcXXXXXX";
+  char lib[64];
+  char cache[64];
+  unsigned char sig[1024];
+  unsigned char dgst[EVP_MAX_MD_SIZE];
+  unsigned char cdgst[EVP_MAX_MD_SIZE];
+  unsigned char bad[32];
+  EVP_MD_CTX *md_ctx = NULL;
+  const EVP_MD *md = NULL;
+  SIG_CACHE_KEY k;
+  FILE *f = NULL;
+  int sigL = 0;
+  int fails = 0;
+  int i = 0;
+
+  if (0 != geteuid()) {
+    printf("Cache test skipped, only root writes the cache\n");
+    return 0;
+  }
+  if (NULL == mkdtemp(dir)) {
+    printf("Cache test, mkdtemp failed\n");
+    return 1;
+  }
+  sprintf(lib, "%s/lib", dir);
+  sprintf(cache, "%s/cache", dir);
+  md_ctx = EVP_MD_CTX_new();
+  md = EVP_get_digestbyname("SHA256");
+  f = fopen(lib, "wb");
+  if ((NULL == f) || (NULL == md_ctx) || (NULL == md)) {
+    fails++;
+  } else {
+    for (i = 0; i < 100000; i++) {
+      fputc(i & 0xff, f);
+    }
+    fclose(f);
+    /* Changed in the last couple of seconds isn't cached */
+    sleep(SIG_CACHE_SETTLE + 1);
+    f = fopen(lib, "rb");
+  }
+  if ((0 == fails) && ((NULL == f) || !CacheKey(f, &k) ||
+                       (32 != GenHash(f, dgst, 0)) ||
+                       (0 >= (sigL = GenSig(f, sig, key, 0))))) {
+    printf("Cache test, setup failed\n");
+    fails++;
+  }
+  if (0 == fails) {
+    /* First check hashes and stores */
+    if (CacheLookup(cache, &k, sig, sigL, cdgst)) {
+      printf("Cache test, hit on an empty cache\n");
+      fails++;
+    }
+    if (1 != CachedVerify(f, cache, md_ctx, md, sig, sigL, key)) {
+      printf("Cache test, first verify failed\n");
+      fails++;
+    }
+    if (!CacheLookup(cache, &k, sig, sigL, cdgst) || (0 != memcmp(dgst, cdgst, 32))) {
+      printf("Cache test, no record after the first verify\n");
+      fails++;
+    }
+    /* Second is served from the cache */
+    if (1 != CachedVerify(f, cache, md_ctx, md, sig, sigL, key)) {
+      printf("Cache test, cached verify failed\n");
+      fails++;
+    }
+    /* A record with a digest that doesn't verify is ignored and replaced */
+    memcpy(bad, dgst, 32);
+    bad[0] ^= 0x01;
+    CacheStore(cache, &k, sig, sigL, bad);
+    if (!CacheLookup(cache, &k, sig, sigL, cdgst) || (0 != memcmp(bad, cdgst, 32)) ||
+        (1 != CachedVerify(f, cache, md_ctx, md, sig, sigL, key)) ||
+        !CacheLookup(cache, &k, sig, sigL, cdgst) || (0 != memcmp(dgst, cdgst, 32))) {
+      printf("Cache test, bad cached digest not replaced\n");
+      fails++;
+    }
+    fclose(f);
+    /* Change the file, the record no longer matches and the check fails */
+    f = fopen(lib, "r+b");
+    if (NULL != f) {
+      fputc(0xff, f);
+      fclose(f);
+      f = fopen(lib, "rb");
+    }
+    if ((NULL == f) || !CacheKey(f, &k)) {
+      printf("Cache test, changing the file failed\n");
+      fails++;
+    } else {
+      if (CacheLookup(cache, &k, sig, sigL, cdgst)) {
+        printf("Cache test, hit on a changed file\n");
+        fails++;
+      }
+      if (0 != CachedVerify(f, cache, md_ctx, md, sig, sigL, key)) {
+        printf("Cache test, changed file verified\n");
+        fails++;
+      }
+    }
+  }
+  if (NULL != f) {
+    fclose(f);
+  }
+  if (NULL != md_ctx) {
+    EVP_MD_CTX_free(md_ctx);
+  }
+  unlink(lib);
+  unlink(cache);
+  rmdir(dir);
+  printf("Cache test %s\n", (0 == fails) ? "passed" : "FAILED");
+  return fails;
+}
+#endif
 static void usage(char *pname, char *str) {
-  printf("usage:\t %s sigfile keyfile [-v(erify)] [-SELF] [-FILE file] "
+  printf("usage:\t %s sigfile keyfile [-v(erify)] [-SELF] [-FILE file] [-CACHETEST] "
          "[\"X=Y\"] ...[\"Z=K\"]\n",
          pname);
   printf("OR:\t$s sigfile keyfile -v(erify) -FILE file\n");
@@ -664,6 +1168,8 @@ static void usage(char *pname, char *str) {
          "it happens after FILE=\n");
   printf("\t\"X=Y ICC settings to be applied, must be provided before or with "
          "-SELF\n");
+  printf("\t-CACHETEST runs the library digest cache self test with the key "
+         "in keyfile, as root, and exits\n");
 }
 #define MAXTWEAKS 20
 int main(int argc, char *argv[]) {
@@ -708,6 +1214,20 @@ int main(int argc, char *argv[]) {
   for (i = 3; i < argc; i++) {
     if (NULL != strstr(argv[i], "-v")) {
       verify = 1;
+    } else if (NULL != strstr(argv[i], "-CACHETEST")) {
+      rsakey = read_key(rsaf, "private");
+      if (NULL == rsakey) {
+        usage(argv[0], "Could not read private key from file");
+        exit(1);
+      }
+#if defined(SIG_CACHE)
+      i = CacheSelfTest(rsakey);
+#else
+      printf("Cache test skipped, no digest cache on this platform\n");
+      i = 0;
+#endif
+      EVP_PKEY_free(rsakey);
+      exit((0 == i) ? 0 : 1);
     } else if (NULL != strstr(argv[i], "-SELF")) {
       signself = 1;
     } else if (NULL != strstr(argv[i], "-FILE")) {
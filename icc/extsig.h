@@ -18,4 +18,5 @@
 #endif
 
 int CheckSig(FILE *fin,FILE *targ,EVP_PKEY *rsaPKey,int SigFileOnly);
+int CheckSigCached(FILE *fin,FILE *targ,EVP_PKEY *rsaPKey,int SigFileOnly,const char *cache);
 int ReadConfigItems(FILE *fin, char *tweaks[], int n);
@@ -39,6 +39,9 @@
 #else
 #include <arpa/inet.h>
 #endif
+#if defined(__linux__)
+#include <pthread.h>
+#endif
 #include "icclib.h"
 #include "ds.h"
 #include "fips.h"
@@ -48,6 +51,28 @@
 #include "utils.h"
 #include "TRNG/ICC_NRBG.h"
 #include "induced.h"
+#include "icc_probes.h"
+
+/* Fork protection, each process must have unique DRBG state after fork().
+   Where we can hook fork() a pthread_atfork() child handler bumps
+   fork_gen and each DRBG compares that with the generation it was last
+   used in, a single load per call. Elsewhere the generation is the PID.
+   Only hooked on Linux, glibc drops the handler if we're unloaded,
+   other platforms would be left calling into an unmapped library.
+*/
+#if defined(__linux__)
+#define RNG_ATFORK
+#endif
+static volatile unsigned int fork_gen = 1; /*!< Bumped in each fork() child */
+static int fork_hooked = 0;                /*!< fork_child() is registered */
+
+#if defined(RNG_ATFORK)
+/*! @brief pthread_atfork() child handler, nothing else is safe here */
+static void fork_child(void)
+{
+  fork_gen++;
+}
+#endif
 
 
 extern SP800_90STATE TRNG_Inst_Type(PRNG_CTX *ctx,
@@ -179,6 +204,8 @@ static SP800_90PRNG_t *PRNG_list[] =
 
 static char *exclude_list = "";
 
+static int lazy_test = 0; /*!< Defer DRBG known answer tests to first use */
+
 static TRNG_TYPE typeofTRNG(SP800_90PRNG_mode mode)
 {
   TRNG_TYPE rv;
@@ -239,6 +266,27 @@ void Set_rng_exclude(char *lst)
   }
 }
 
+/*!
+  @brief defer the DRBG known answer tests to first use
+  @param on 1 to defer, 0 to run them all during POST
+  @note Each DRBG type already self tests on it's first RNG_CTX_Init()
+  (last_tested_at starts at 0), this just stops POST forcing the issue
+  for types the process never uses.
+*/
+void SetRNGLazyTest(int on)
+{
+  lazy_test = (0 != on) ? 1 : 0;
+}
+
+/*!
+  @brief return the deferred DRBG self test setting
+  @return 1 if DRBG known answer tests are deferred to first use
+*/
+int GetRNGLazyTest(void)
+{
+  return lazy_test;
+}
+
 static int matchstr(char *one, char *two, char delim) {
   int matched = 0;
   while (0 == matched) {
@@ -310,12 +358,14 @@ TRNG_ERRORS PRNG_GenerateRandomSeed(PRNG_CTX *P, unsigned int n,
                                     unsigned char *buf) {
   TRNG_ERRORS rv = TRNG_OK;
   SP800_90PRNG_Data_t *prng = (SP800_90PRNG_Data_t *)P;
+  unsigned long long t0 = 0;
  
   if (0 == n) {
     prng->state = SP800_90PARAM;
     prng->error_reason = ERRAT("0 bytes is not a valid entropy request");
     rv = TRNG_REQ_SIZE;
   } else {
+    t0 = ICC_GetTimeNS();
     rv = TRNG_GenerateRandomSeed(prng->trng, n, buf);
     /** \induced 401: Simulate a one off TRNG failure,
         force test case to fail, triggering this error path
@@ -339,6 +389,7 @@ TRNG_ERRORS PRNG_GenerateRandomSeed(PRNG_CTX *P, unsigned int n,
          rv = TRNG_ENTROPY;
       }
     }
+    prng->gather_ns += ICC_GetTimeNS() - t0;
   }
   return rv;
 }
@@ -376,11 +427,10 @@ unsigned BlocksReqd(unsigned int bytes,unsigned int blocksize)
 */
 void uint2BS(unsigned n,unsigned char N[4])
 {
-  int i;
-  for(i = 3; i >= 0 ; i--) {
-    N[i] = n % 256;
-    n = n / 256;
-  }
+  N[0] = (unsigned char)(n >> 24);
+  N[1] = (unsigned char)(n >> 16);
+  N[2] = (unsigned char)(n >> 8);
+  N[3] = (unsigned char)n;
 }
 
 
@@ -557,9 +607,13 @@ SP800_90STATE PRNG_Instantiate(SP800_90PRNG_Data_t *ctx,
          NB in the noDF modes maxNonce should be 0
       */
       if (NULL == *nonce && ctx->prng->maxNonce) {
-        *flags |= ALLOC_NONCE;
         *nonl = NeededBytes(ctx);
-        *nonce = ICC_Calloc(1, *nonl, __FILE__, __LINE__);
+        if (*nonl <= sizeof(ctx->nBuf)) {
+          *nonce = ctx->nBuf;
+        } else {
+          *flags |= ALLOC_NONCE;
+          *nonce = ICC_Calloc(1, *nonl, __FILE__, __LINE__);
+        }
         if (TRNG_OK != PRNG_GenerateRandomSeed((PRNG_CTX *)ctx, *nonl, *nonce)) {
           ctx->state = SP800_90ERROR;
           ctx->error_reason = ERRAT("TRNG failure, low entropy");
@@ -576,11 +630,15 @@ SP800_90STATE PRNG_Instantiate(SP800_90PRNG_Data_t *ctx,
          supply it, if maxPers is 0, then obviously it can't be used
       */
       if (NULL == *person && ctx->prng->maxPers) {
-        *flags |= ALLOC_PERSON;
         /* NULL returns the maximum length of the internal personalization
          * string */
         *perl = Personalize(NULL);
-        *person = ICC_Calloc(1, *perl, __FILE__, __LINE__);
+        if (*perl <= sizeof(ctx->pBuf)) {
+          *person = ctx->pBuf;
+        } else {
+          *flags |= ALLOC_PERSON;
+          *person = ICC_Calloc(1, *perl, __FILE__, __LINE__);
+        }
         Personalize(*person); /* Fill in the allocated buffer */
         if (ctx->prng->maxPers < *perl) {
           *perl = ctx->prng->maxPers; /* But lie about the length ... */
@@ -604,6 +662,8 @@ SP800_90STATE PRNG_Instantiate(SP800_90PRNG_Data_t *ctx,
   }
   if (SP800_90PARAM == ctx->state) {
     PRNG_free_scratch(ein, nonce, person, flags);
+    memset(ctx->nBuf, 0, sizeof(ctx->nBuf));
+    memset(ctx->pBuf, 0, sizeof(ctx->pBuf));
   }
 
   return ctx->state;
@@ -838,11 +898,13 @@ void Cln(PRNG_CTX *ctx)
   SP800_90PRNG_Data_t *ictx = (SP800_90PRNG_Data_t *)ctx;
   SP800_90PRNG_t *prng = ictx->prng;
   TRNG *trng = ictx->trng;
+  void *base = ictx->alloc;
   ictx->trng = NULL;
   prng->Cleanup(ctx);
   memset(ictx,0,sizeof(SP800_90PRNG_Data_t));
   ictx->prng = prng;
   ictx->trng = trng;
+  ictx->alloc = base;
   ictx->state = SP800_90UNINIT;
 }
 /*!
@@ -960,7 +1022,8 @@ void PRNG_self_test(PRNG_CTX *ctx, PRNG *alg)
           }
           if (NotZero(ictx->K, MAX_K) || NotZero(ictx->V, MAX_V) ||
               NotZero(ictx->C, MAX_C) || NotZero(ictx->T, MAX_T) ||
-              NotZero(ictx->eBuf, EBUF_SIZE) || (ictx->SecStr != 0) ||
+              NotZero(ictx->eBuf, EBUF_SIZE) || NotZero(ictx->nBuf, EBUF_SIZE) ||
+              NotZero(ictx->pBuf, PBUF_SIZE) || (ictx->SecStr != 0) ||
               (ictx->ReseedAt != 0) || (ictx->Paranoid != 0) ||
               (ictx->minEnt != 0) || (ictx->CallCount.u != 0) ||
               (ictx->ctx.cctx != NULL))
@@ -1098,8 +1161,16 @@ PRNG * my_get_RNGbyname(ICClib *pcb,const char *algname)
 PRNG_CTX *RNG_CTX_new_no_TRNG() 
 {
   SP800_90PRNG_Data_t  * ctx = NULL;
-  
-  ctx = CRYPTO_calloc(1,sizeof(SP800_90PRNG_Data_t),__FILE__,__LINE__);
+  unsigned char *base = NULL;
+
+  /* One cache line aligned block holds the context, it's working
+     state and the instantiate scratch 
+  */
+  base = OPENSSL_secure_zalloc(sizeof(SP800_90PRNG_Data_t) + CTX_ALIGN - 1);
+  if(NULL != base) {
+    ctx = (SP800_90PRNG_Data_t *)(base + ((CTX_ALIGN - ((size_t)base % CTX_ALIGN)) % CTX_ALIGN));
+    ctx->alloc = base;
+  }
   return (PRNG_CTX *)ctx; 
 }
 
@@ -1119,7 +1190,7 @@ PRNG_CTX *RNG_CTX_new()
     }
     ctx->trng = TRNG_new(GetDefaultTrng());
     if(NULL == ctx->trng) {
-      ICC_Free(ctx);
+      RNG_CTX_free((PRNG_CTX *)ctx);
       ctx = NULL;
     }
   }
@@ -1257,6 +1328,8 @@ SP800_90STATE RNG_CTX_Init(PRNG_CTX *ctx, PRNG *alg, unsigned char *person,
           }
           /* Clean up any buffers we provided in PRNG_Instantiate */
           PRNG_free_scratch(&ein, &nonce, &person, &flags);
+          memset(ictx->nBuf, 0, sizeof(ictx->nBuf));
+          memset(ictx->pBuf, 0, sizeof(ictx->pBuf));
 
           if ((SP800_90INIT == ictx->state) && (ictx->Paranoid)) {
             ictx->state = SP800_90RESEED;
@@ -1267,9 +1340,7 @@ SP800_90STATE RNG_CTX_Init(PRNG_CTX *ctx, PRNG *alg, unsigned char *person,
         ictx->error_reason = ERRAT("Invalid (NULL) parameter");
       }
     }
-#if !defined(_WIN32)    
-    ictx->lastPID = getpid();
-#endif
+    ictx->forkGen = RNG_ForkGeneration();
     state = ictx->state;
   }
   return state;
@@ -1296,6 +1367,7 @@ SP800_90STATE RNG_ReSeed(PRNG_CTX *ctx, unsigned char *adata,
 
   unsigned long l;
 
+  ICC_PROBE1(drbg__reseed__start, ctx);
   if ((NULL != ictx) && (NULL != ictx->prng))
   {
     if (IS_TRNG == (IS_TRNG & ictx->prng->type))
@@ -1336,6 +1408,9 @@ SP800_90STATE RNG_ReSeed(PRNG_CTX *ctx, unsigned char *adata,
           ictx->trng = NULL;
           ictx->trng = TRNG_new(GetDefaultTrng());
           /* printf("TRNG is of type %d\n",TRNG_type(ictx->trng)); */
+          /* Anything gathered ahead came from the old source */
+          memset(ictx->preSeed, 0, sizeof(ictx->preSeed));
+          ictx->preSeedl = 0;
  
           if (NULL == ictx->trng)
           {
@@ -1347,7 +1422,17 @@ SP800_90STATE RNG_ReSeed(PRNG_CTX *ctx, unsigned char *adata,
         {
           /* Provide an appropriate amount of entropy */
           einl = NeededBytes(ictx);
-          if (TRNG_OK != PRNG_GenerateRandomSeed(ctx, einl, ictx->eBuf))
+          if ((unsigned int)einl == ictx->preSeedl)
+          {
+            /* Gathered ahead by the reseed worker, already health tested */
+            memcpy(ictx->eBuf, ictx->preSeed, einl);
+            memset(ictx->preSeed, 0, einl);
+            ictx->preSeedl = 0;
+            ictx->prng->Res(ctx, ictx->eBuf, einl, adata, adatal);
+            memset(ictx->eBuf, 0, einl);
+            ictx->reseeds++;
+          }
+          else if (TRNG_OK != PRNG_GenerateRandomSeed(ctx, einl, ictx->eBuf))
           {
             ictx->state = SP800_90ERROR;
             ictx->error_reason = ERRAT("TRNG failure, low entropy");
@@ -1356,6 +1441,7 @@ SP800_90STATE RNG_ReSeed(PRNG_CTX *ctx, unsigned char *adata,
           {
             ictx->prng->Res(ctx, ictx->eBuf, einl, adata, adatal);
             memset(ictx->eBuf, 0, einl);
+            ictx->reseeds++;
           }
         }
         break;
@@ -1377,10 +1463,79 @@ SP800_90STATE RNG_ReSeed(PRNG_CTX *ctx, unsigned char *adata,
   }
 
   state = ictx->state;
+  ICC_PROBE2(drbg__reseed__done, ctx, state);
 
   return state;
 }
 
+/*!
+  @brief register the fork() hook, once, at library load
+*/
+void RNG_ForkInit(void)
+{
+#if defined(RNG_ATFORK)
+  if (!fork_hooked && (0 == pthread_atfork(NULL, NULL, fork_child))) {
+    fork_hooked = 1;
+  }
+#endif
+}
+
+/*!
+  @brief register more fork() handlers, as RNG_ForkInit() does
+  @param prepare called in the parent before fork(), may be NULL
+  @param parent called in the parent after fork(), may be NULL
+  @param child called in the child, still single threaded, may be NULL
+  @return 1 if registered, 0 where fork() isn't hooked
+*/
+int RNG_ForkHook(void (*prepare)(void), void (*parent)(void), void (*child)(void))
+{
+  int rv = 0;
+#if defined(RNG_ATFORK)
+  if (0 == pthread_atfork(prepare, parent, child)) {
+    rv = 1;
+  }
+#else
+  (void)prepare;
+  (void)parent;
+  (void)child;
+#endif
+  return rv;
+}
+
+/*!
+  @brief the current fork() generation
+  @return a value which changes in each fork() child
+*/
+unsigned int RNG_ForkGeneration(void)
+{
+#if defined(_WIN32)
+  return 0;
+#else
+  return fork_hooked ? fork_gen : (unsigned int)getpid();
+#endif
+}
+
+/*!
+  @brief give a DRBG unique state if we've fork()ed since it was last used
+  @param ictx the DRBG
+  @note The caller must hold whatever lock protects ictx
+*/
+static void fork_check(SP800_90PRNG_Data_t *ictx)
+{
+  unsigned char tbuf[512];
+  unsigned int gen = RNG_ForkGeneration();
+
+  if (ictx->forkGen != gen) {
+    TRNG_GenerateRandomSeed(ictx->trng,512,tbuf); /* We cache the noise input, so pull enough data to ensure that's cleared */
+    memset(tbuf, 0, sizeof(tbuf));
+    ictx->state = SP800_90RESEED; /* Force a reseed to fix the PRNG states */
+    ictx->forkGen = gen;
+    /* and never share entropy gathered ahead with the parent */
+    memset(ictx->preSeed, 0, sizeof(ictx->preSeed));
+    ictx->preSeedl = 0;
+  }
+}
+
 /*!
   @brief extract data from the PRNG, 
   this layer perform generic state checks
@@ -1398,25 +1553,12 @@ static SP800_90STATE OldefRNG_Generate(PRNG_CTX *ctx, unsigned char *buffer,
   SP800_90PRNG_Data_t *ictx = (SP800_90PRNG_Data_t *)ctx;
   SP800_90STATE state = SP800_90CRIT;
   unsigned int l;
-  unsigned char tbuf[512];
-#if !defined(_WIN32)
 
-  pid_t pid = -1;
-#endif
   if (NULL != ictx)
   {
     if (NULL != ictx->prng)
     {
-#if !defined(_WIN32)
-      /* Fork protection, ensure each process has unique state after fork() */
-      pid = getpid();
-      if(ictx->lastPID != pid) {
-        TRNG_GenerateRandomSeed(ictx->trng,512,tbuf); /* We cache the noise input, so pull enough data to ensure that's cleared */
-        ictx->state = SP800_90RESEED; /* Force a reseed to fix the PRNG states */
-        ictx->lastPID = pid;
-      }
-
-#endif  
+      fork_check(ictx);
       if (n > ictx->prng->maxBytes)
       {
         ictx->state = SP800_90PARAM;
@@ -1509,8 +1651,11 @@ static SP800_90STATE OldefRNG_Generate(PRNG_CTX *ctx, unsigned char *buffer,
     SP800_90STATE state = SP800_90CRIT;
     unsigned int chunksize = 0, req = 0;
 
+    ICC_PROBE2(drbg__generate__start, ctx, n);
     if (NULL != ictx)
     {
+      ictx->gens++;
+      ictx->gen_bytes += n;
       if (0 != ictx->Auto)
       {
         chunksize = ictx->prng->maxBytes;
@@ -1530,9 +1675,183 @@ static SP800_90STATE OldefRNG_Generate(PRNG_CTX *ctx, unsigned char *buffer,
     }
     state = ictx->state;
   }
+  ICC_PROBE2(drbg__generate__done, ctx, state);
+  return state;
+}
+
+/*!
+  @brief fill several buffers from one generate
+  @param ctx The PRNG context
+  @param iov the buffers, in order
+  @param cnt entries in iov
+  @param adata additional input data to mix in (NULL is acceptable)
+  @param adatal the length of the adata (0 is acceptable)
+  @return the PRNG state, as RNG_Generate()
+  @note The output of one RNG_Generate() of the total length is split 
+  between the buffers in order, so there's one state update and one 
+  continuity test rather than one per buffer. Totals up to RNG_IOV_TMP 
+  bytes go through a stack buffer, larger ones are allocated.
+  On failure every buffer is zeroed.
+*/
+#define RNG_IOV_TMP 1024
+SP800_90STATE RNG_GenerateV(PRNG_CTX *ctx, const ICC_RNG_IOV *iov, unsigned int cnt,
+                            unsigned char *adata, unsigned int adatal)
+{
+  SP800_90STATE state = SP800_90PARAM;
+  unsigned char stmp[RNG_IOV_TMP];
+  unsigned char *tmp = stmp;
+  unsigned long long total = 0;
+  unsigned int off = 0;
+  unsigned int i = 0;
+
+  if ((NULL != ctx) && ((NULL != iov) || (0 == cnt))) {
+    for (i = 0; i < cnt; i++) {
+      if ((NULL == iov[i].buf) && (0 != iov[i].len)) {
+        return SP800_90PARAM;
+      }
+      total += iov[i].len;
+    }
+    if (total > 0x7FFFFFFF) {
+      return SP800_90PARAM;
+    }
+    if (total > sizeof(stmp)) {
+      tmp = (unsigned char *)ICC_Calloc(1, (size_t)total, __FILE__, __LINE__);
+    }
+    if (NULL == tmp) {
+      state = SP800_90ERROR;
+    } else {
+      state = RNG_Generate(ctx, tmp, (unsigned int)total, adata, adatal);
+      for (i = 0; i < cnt; i++) {
+        if (0 != iov[i].len) {
+          if ((SP800_90RUN == state) || (SP800_90RESEED == state)) {
+            memcpy(iov[i].buf, tmp + off, iov[i].len);
+          } else {
+            memset(iov[i].buf, 0, iov[i].len);
+          }
+          off += iov[i].len;
+        }
+      }
+      memset(tmp, 0, (size_t)total);
+      if (tmp != stmp) {
+        ICC_Free(tmp);
+      }
+    }
+  }
   return state;
 }
 
+/*!
+  @brief how much entropy should be gathered ahead of this DRBG's next reseed
+  @param ctx The PRNG context
+  @return the number of bytes wanted, 0 if none are
+  @note 
+  - Only DRBG's in the last 1/PRESEED_AT of their reseed interval 
+    with nothing already gathered ask for entropy. 
+  - Prediction resistant DRBG's reseed every call and never ask.
+  - The caller must hold whatever lock protects ctx
+*/
+#define PRESEED_AT 8
+unsigned int RNG_SeedWanted(PRNG_CTX *ctx)
+{
+  SP800_90PRNG_Data_t *ictx = (SP800_90PRNG_Data_t *)ctx;
+  unsigned int rv = 0;
+  uint32_t t = 0;
+  int forked = 0;
+
+  if ((NULL != ictx) && (NULL != ictx->prng) && (NULL != ictx->trng) &&
+      (IS_TRNG != (IS_TRNG & ictx->prng->type)) &&
+      (0 == ictx->Paranoid) && (0 == ictx->TestMode)) {
+    /* After fork() it'll reseed on next use whatever the count,
+       and what it gathered ahead is discarded */
+    forked = (ictx->forkGen != RNG_ForkGeneration()) ? 1 : 0;
+    t = ntohl(ictx->CallCount.u);
+    if (forked || ((0 == ictx->preSeedl) &&
+                   ((SP800_90RESEED == ictx->state) ||
+                    ((SP800_90RUN == ictx->state) &&
+                     ((t + (ictx->ReseedAt / PRESEED_AT)) >= ictx->ReseedAt))))) {
+      rv = NeededBytes(ictx);
+      if (rv > EBUF_SIZE) {
+        rv = 0;
+      }
+    }
+  }
+  return rv;
+}
+
+/*!
+  @brief will this DRBG's next generate have to wait on it's NRBG
+  @param ctx The PRNG context
+  @return 1 if the next generate reseeds and nothing was gathered ahead,
+  0 if it can run from the DRBG state alone
+  @note 
+  - Prediction resistant DRBG's always report 1.
+  - TRNG types read the NRBG on every call, this can't tell and returns 0.
+  - The caller must hold whatever lock protects ctx
+*/
+int RNG_SeedPending(PRNG_CTX *ctx)
+{
+  SP800_90PRNG_Data_t *ictx = (SP800_90PRNG_Data_t *)ctx;
+  int rv = 0;
+
+  if ((NULL != ictx) && (NULL != ictx->prng) &&
+      (IS_TRNG != (IS_TRNG & ictx->prng->type)) && (0 == ictx->TestMode)) {
+    if ((0 != ictx->Paranoid) || (ictx->forkGen != RNG_ForkGeneration()) ||
+        ((SP800_90RESEED == ictx->state) && (0 == ictx->preSeedl))) {
+      rv = 1;
+    }
+  }
+  return rv;
+}
+
+/*!
+  @brief hand a DRBG entropy gathered ahead of it's next reseed
+  @param ctx The PRNG context
+  @param seed the entropy, this must be health tested TRNG output
+  @param seedl the number of bytes, as returned by RNG_SeedWanted()
+  @return 1 if the entropy was accepted, 0 otherwise
+  @note 
+  - The caller must hold whatever lock protects ctx
+  - The caller should erase seed
+*/
+int RNG_PreSeed(PRNG_CTX *ctx, const unsigned char *seed, unsigned int seedl)
+{
+  SP800_90PRNG_Data_t *ictx = (SP800_90PRNG_Data_t *)ctx;
+  int rv = 0;
+  /* In a fork() child, do the fork handling now rather than on the
+     request path, the entropy was gathered in this process */
+  if ((NULL != ictx) && (0 != RNG_SeedWanted(ctx))) {
+    fork_check(ictx);
+  }
+  /* Recheck, this may have reseeded while the entropy was gathered */
+  if ((0 != seedl) && (seedl == RNG_SeedWanted(ctx))) {
+    memcpy(ictx->preSeed, seed, seedl);
+    ictx->preSeedl = seedl;
+    rv = 1;
+  }
+  return rv;
+}
+
+/*!
+  @brief fill in the DRBG counts in an ICC_RNG_STAT
+  @param ctx The PRNG context, may be NULL if it was never instantiated
+  @param st the counts, pool and slot are left alone
+  @note The caller must hold whatever lock protects ctx
+*/
+void RNG_GetCounts(PRNG_CTX *ctx, ICC_RNG_STAT *st)
+{
+  SP800_90PRNG_Data_t *ictx = (SP800_90PRNG_Data_t *)ctx;
+
+  if (NULL != ictx) {
+    st->generates = ictx->gens;
+    st->bytes = ictx->gen_bytes;
+    st->reseeds = ictx->reseeds;
+    st->gather_ns = ictx->gather_ns;
+    st->retries = TRNG_HealthRetries(ictx->trng);
+    st->entropy = (NULL != ictx->trng) ? GetEntropy(ictx->trng) : 0;
+    st->trng_bytes = TRNG_Footprint(ictx->trng);
+  }
+}
+
 /*! 
   @brief perform some operation on an initialized PRNG CTX
   @param ctx The PRNG context
@@ -1684,6 +2003,14 @@ SP800_90STATE RNG_CTX_ctrl(PRNG_CTX *ctx, SP800_90CTRL type, int arg,
       *(unsigned int *)ptr = GetEntropy(ictx->trng);
       rv = ictx->state;
       break;
+    case SP800_90_GETRETRIES:
+      if (NULL != ptr) {
+        *(unsigned int *)ptr = TRNG_HealthRetries(ictx->trng);
+        rv = ictx->state;
+      } else {
+        rv = SP800_90PARAM;
+      }
+      break;
     case SP800_90_GETLASTERROR:
       if (NULL != ptr) {
         *(char **)ptr = ictx->error_reason;
@@ -1742,7 +2069,9 @@ SP800_90STATE RNG_CTX_ctrl(PRNG_CTX *ctx, SP800_90CTRL type, int arg,
 void RNG_CTX_free(PRNG_CTX *ctx)
 {
   SP800_90PRNG_Data_t *ictx = (SP800_90PRNG_Data_t *)ctx;
+  void *base = NULL;
   if(NULL != ictx) {
+    base = ictx->alloc;
      if(NULL != ictx->trng) {
       TRNG_free(ictx->trng);
       ictx->trng = NULL;
@@ -1751,8 +2080,63 @@ void RNG_CTX_free(PRNG_CTX *ctx)
       ictx->prng->Cln(ctx);
       ictx->prng = NULL;
     }
-    memset(ictx,0,sizeof(SP800_90PRNG_Data_t));
-    ICC_Free(ictx);
+    OPENSSL_secure_clear_free(base,sizeof(SP800_90PRNG_Data_t) + CTX_ALIGN - 1);
+  }
+}
+
+/*!
+  @brief Erase the secret state of a PRNG_CTX without freeing anything
+  @param ctx The PRNG_CTX to scrub, may be NULL
+  @note
+  - ICC_FAST_EXIT, process exit. The context is left unusable but
+    allocated, nothing it points to is released.
+  - The working EVP contexts are reset, which erases their key schedules
+  - The caller must hold whatever lock protects ctx
+*/
+void RNG_CTX_Scrub(PRNG_CTX *ctx)
+{
+  SP800_90PRNG_Data_t *ictx = (SP800_90PRNG_Data_t *)ctx;
+  SP800_90PRNG_mode mode;
+
+  if(NULL != ictx) {
+    OPENSSL_cleanse(ictx->K,sizeof(ictx->K));
+    OPENSSL_cleanse(ictx->V,sizeof(ictx->V));
+    OPENSSL_cleanse(ictx->C,sizeof(ictx->C));
+    OPENSSL_cleanse(ictx->T,sizeof(ictx->T));
+    OPENSSL_cleanse(ictx->eBuf,sizeof(ictx->eBuf));
+    OPENSSL_cleanse(ictx->preSeed,sizeof(ictx->preSeed));
+    ictx->preSeedl = 0;
+    OPENSSL_cleanse(ictx->nBuf,sizeof(ictx->nBuf));
+    OPENSSL_cleanse(ictx->pBuf,sizeof(ictx->pBuf));
+    OPENSSL_cleanse(ictx->lastdata,sizeof(ictx->lastdata));
+    if((NULL != ictx->prng) && (IS_TRNG != (IS_TRNG & ictx->prng->type))) {
+      mode = ictx->prng->type;
+      if(mode >= SP800_CTR_3DES) {
+        if(NULL != ictx->ctx.cctx) {
+          EVP_CIPHER_CTX_reset(ictx->ctx.cctx);
+        }
+        if(NULL != ictx->ctrctx) {
+          EVP_CIPHER_CTX_reset(ictx->ctrctx);
+        }
+        ictx->ctrkeyed = 0;
+        if(NULL != ictx->dfctx) {
+          EVP_CIPHER_CTX_reset(ictx->dfctx);
+        }
+        if(NULL != ictx->dfxctx) {
+          EVP_CIPHER_CTX_reset(ictx->dfxctx);
+        }
+      } else if(mode >= SP800_HMAC_SHA1) {
+        if(NULL != ictx->ctx.hmac_ctx) {
+          HMAC_CTX_reset(ictx->ctx.hmac_ctx);
+        }
+      } else if(NULL != ictx->ctx.md_ctx) {
+        EVP_MD_CTX_reset(ictx->ctx.md_ctx);
+      }
+    }
+    if(NULL != ictx->trng) {
+      TRNG_Scrub(ictx->trng);
+    }
+    ictx->state = SP800_90UNINIT;
   }
 }
 
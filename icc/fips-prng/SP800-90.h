@@ -95,6 +95,8 @@ PRNG_CTX *RNG_CTX_new_no_TRNG();
 PRNG_CTX *RNG_CTX_new();
 
 void RNG_CTX_free(PRNG_CTX *ctx);
+/*! @brief Erase ctx's secret state in place, ICC_FAST_EXIT */
+void RNG_CTX_Scrub(PRNG_CTX *ctx);
 SP800_90STATE  RNG_CTX_Init(PRNG_CTX *ctx,PRNG *alg, 
 			       unsigned char *person, unsigned int personal,
 			       unsigned int strength, int prediction_resistance
@@ -105,7 +107,34 @@ SP800_90STATE RNG_Generate(PRNG_CTX *ctx,
 			   unsigned char *buffer,unsigned int n,
 			   unsigned char *adata,unsigned int adatal);
 
+/*! @brief Fill several buffers from one generate, see RNG_Generate() */
+SP800_90STATE RNG_GenerateV(PRNG_CTX *ctx,const ICC_RNG_IOV *iov,unsigned int cnt,
+			    unsigned char *adata,unsigned int adatal);
+
 SP800_90STATE RNG_CTX_ctrl(PRNG_CTX *ctx,SP800_90CTRL type,int arg, void *ptr);
 
+/*! @brief Bytes of entropy to gather ahead of ctx's next reseed, 0 if none */
+unsigned int RNG_SeedWanted(PRNG_CTX *ctx);
+/*! @brief 1 if ctx's next generate would wait on it's NRBG, caller holds ctx's lock */
+int RNG_SeedPending(PRNG_CTX *ctx);
+/*! @brief Pass ctx entropy gathered ahead of it's next reseed 
+    @return 1 if accepted */
+int RNG_PreSeed(PRNG_CTX *ctx, const unsigned char *seed, unsigned int seedl);
+/*! @brief Add ctx's usage counts to an ICC_RNG_STAT, caller holds ctx's lock */
+void RNG_GetCounts(PRNG_CTX *ctx, ICC_RNG_STAT *st);
+
+/*! @brief Hook fork() so DRBG's reseed in the child, call at library load */
+void RNG_ForkInit(void);
+/*! @brief Register fork() handlers where fork() is hooked
+    @return 1 if registered */
+int RNG_ForkHook(void (*prepare)(void), void (*parent)(void), void (*child)(void));
+/*! @brief A value which changes in each fork() child */
+unsigned int RNG_ForkGeneration(void);
+
 void Set_rng_exclude(char *list);
+
+/*! @brief Defer DRBG known answer tests to the first RNG_CTX_Init() of each type */
+void SetRNGLazyTest(int on);
+/*! @brief return 1 if DRBG known answer tests are deferred */
+int GetRNGLazyTest(void);
 #endif
@@ -37,39 +37,57 @@ static const unsigned char C80[1] = {0x80};
   @brief SP800-90 Block cipher chaining function.
   Note: This is a compression function, it takes multiple blocks of input, and only returns one block
   of output
+  This runs the nc BCC chains Cipher_df() needs side by side. The chains 
+  only differ in their first (IV) block so the nc chaining values are 
+  encrypted in one ECB call per input block, which lets OpenSSL's AES-NI,
+  ARMv8 and POWER8 ECB kernels interleave them rather than paying one EVP
+  call and one pipeline drain per block.
   @param pctx an internal PRNG context
   @param ctx An initialized cipher context
-  @param in A Data chaining structure containing the input data
-  @param out a pointer to the output buffer
+  @param in A Data chaining structure containing the input data, the first 
+         block is the IV which is replaced with the chain number here
+  @param nc the number of chains, nc * OBL must fit in MAX_T
+  @param out a pointer to the output buffer, nc blocks
   @note key initialization is done outside this code. (Is expensive !)
 */
 
-static void BCC(SP800_90PRNG_Data_t *pctx,EVP_CIPHER_CTX *ctx,DS *in,unsigned char *out)
+static void BCC(SP800_90PRNG_Data_t *pctx,EVP_CIPHER_CTX *ctx,DS *in,unsigned nc,unsigned char *out)
 {
   int outl = 0;
-  unsigned i,n;
-  unsigned char T[MAX_OBL];
-  /* Chaining value = 0^outlen */
-  memset(out,0,pctx->prng->OBL); 
+  unsigned i,j,n;
+  unsigned obl = pctx->prng->OBL;
+  unsigned char B[MAX_OBL];
+  unsigned char T[MAX_T];
+
   DS_Reset(in);
   /* Exactly as specified, 
      Note input is always 0 padded to a full block 
      so partical blocks of input aren't a concern
   */
-  n = in->total / pctx->prng->OBL;
+  n = in->total / obl;
   for(i = 1; i <= n; i++) { 
-    DS_Copy(in,T,pctx->prng->OBL); /* Note that DS_Copy() 0 pads */    
-    /* input_block (T) = chaining_value (out) ^ block_i (in) */
-    xor(T,T,out,pctx->prng->OBL);
-    /* Chaining value = Block_Encrypt(key,input_block) */
-    if( 1 !=EVP_EncryptUpdate(ctx,out,&outl,T,(int)pctx->prng->OBL) || 
-	(outl != (int)pctx->prng->OBL) ) {
+    DS_Copy(in,B,obl); /* Note that DS_Copy() 0 pads */    
+    for(j = 0; j < nc; j++) {
+      if(1 == i) {
+        /* Chaining value = 0^outlen, so input_block = IV for chain j */
+        memset(T + (j * obl),0,obl);
+        uint2BS(j,T + (j * obl));
+      } else {
+        /* input_block (T) = chaining_value (out) ^ block_i (in) */
+        xor(T + (j * obl),out + (j * obl),B,obl);
+      }
+    }
+    /* Chaining values = Block_Encrypt(key,input_blocks) */
+    if( 1 !=EVP_EncryptUpdate(ctx,out,&outl,T,(int)(nc * obl)) || 
+	(outl != (int)(nc * obl)) ) {
       pctx->error_reason = ERRAT("Encrypt Update failed");
       pctx->state = SP800_90ERROR;
-      return;
+      break;
     }
   }
-  /* output block (1 block) = chaining value, it's already there */
+  memset(T,0,nc * obl);
+  memset(B,0,obl);
+  /* output blocks = chaining values, they're already there */
 }
 /*!
   @brief Extract a new K & V
@@ -85,7 +103,8 @@ void SetKV(SP800_90PRNG_Data_t *pctx)
      of K & V)
   */
   memcpy(pctx->V,(pctx->T)+keylen,pctx->prng->OBL); 
-  /* And set up the new key */
+  /* And set up the new key, ctrctx is keyed again when it's next used */
+  pctx->ctrkeyed = 0;
   EVP_CIPHER_CTX_cleanup(pctx->ctx.cctx);
   if(1 != EVP_EncryptInit(pctx->ctx.cctx,pctx->alg.cipher,pctx->K,NULL)  ) {
     pctx->error_reason = ERRAT("Encrypt Init failed");
@@ -106,23 +125,23 @@ void SetKV(SP800_90PRNG_Data_t *pctx)
 */
 static void Update(SP800_90PRNG_Data_t *pctx)
 {
-  unsigned int k = 0;
+  unsigned int i = 0;
   int outl = 0;
-  unsigned char *buf = pctx->T;
-  unsigned int blen = pctx->prng->seedlen;
+  unsigned int obl = pctx->prng->OBL;
+  unsigned int n = (pctx->prng->seedlen + obl - 1) / obl;
   
-  
-  while(blen > 0) {
-    Add(pctx->V,pctx->V,pctx->prng->OBL,(unsigned char *)C01,1);
-    if( 1 != EVP_EncryptUpdate(pctx->ctx.cctx,buf,&outl,pctx->V,(int)pctx->prng->OBL) ||
-	(outl != (int)pctx->prng->OBL)  ) {
-      pctx->error_reason = ERRAT("Encrypt Update failed");
-      pctx->state = SP800_90ERROR;
-      return;
-    }
-    k = (blen > pctx->prng->OBL) ? pctx->prng->OBL : blen;
-    buf += k;
-    blen -= k;
+  /* The counter blocks are independent, lay out V+1 .. V+n and
+     encrypt them in place with one ECB call
+  */
+  for(i = 0; i < n; i++) {
+    Add(pctx->V,pctx->V,obl,(unsigned char *)C01,1);
+    memcpy(pctx->T + (i * obl),pctx->V,obl);
+  }
+  if( 1 != EVP_EncryptUpdate(pctx->ctx.cctx,pctx->T,&outl,pctx->T,(int)(n * obl)) ||
+      (outl != (int)(n * obl))  ) {
+    pctx->error_reason = ERRAT("Encrypt Update failed");
+    pctx->state = SP800_90ERROR;
+    return;
   }
   /* XOR in any provided data, which must be seedlen long */
   xor(pctx->T,pctx->T,pctx->C,pctx->prng->seedlen);
@@ -130,6 +149,171 @@ static void Update(SP800_90PRNG_Data_t *pctx)
   SetKV(pctx);  
   memset(pctx->T,0,pctx->prng->seedlen);
 }
+/*!
+  Counter blocks encrypted per EVP call in Generate, 
+  1k for AES so a batch stays in L1 cache
+*/
+#define CTR_BATCH 64
+/*!
+  Batches of at least this many blocks go through CtrStream() where
+  that's faster
+*/
+#define CTR_STREAM_MIN 8
+/*!
+  CPU features that make CtrStream() faster, OpenSSL 1.1.1 has no bulk
+  ECB for vcipher or AESE but does interleave CTR mode
+*/
+#define CTR_STREAM_CPUF (ICC_CPUF_VCRYPTO | ICC_CPUF_ARMAES)
+/*!
+  @brief The CTR mode cipher matching the DRBG's ECB one
+  @param pctx a pointer to an internal PRNG ctx structure
+  @return the cipher or NULL
+*/
+static const EVP_CIPHER *CtrCipher(SP800_90PRNG_Data_t *pctx)
+{
+  const EVP_CIPHER *c = NULL;
+
+  switch(EVP_CIPHER_nid(pctx->alg.cipher)) {
+  case NID_aes_128_ecb:
+    c = EVP_aes_128_ctr();
+    break;
+  case NID_aes_192_ecb:
+    c = EVP_aes_192_ctr();
+    break;
+  case NID_aes_256_ecb:
+    c = EVP_aes_256_ctr();
+    break;
+  default:
+    break;
+  }
+  return c;
+}
+/*!
+  @brief Generate n blocks of DRBG output as a CTR mode key stream
+  @param pctx a pointer to an internal PRNG ctx structure
+  @param out where to place the output, n * OBL bytes
+  @param n the number of blocks
+  @return 1 on success, 0 on an encryption failure, -1 if CTR mode 
+  isn't usable and the caller should use ECB
+  @note E(V+1) ... E(V+n) is the CTR key stream starting from V+1 with
+  a full width counter, as OpenSSL's CTR mode increments it.
+  On POWER8 and later and ARMv8 OpenSSL's ECB mode runs a block at a time
+  but CTR mode interleaves 8 (aes_p8_ctr32_encrypt_blocks) or 
+  3 (aes_v8_ctr32_encrypt_blocks) blocks.
+  The extra key schedule is only paid by Generate calls big enough to use this.
+*/
+static int CtrStream(SP800_90PRNG_Data_t *pctx, unsigned char *out, unsigned n)
+{
+  const EVP_CIPHER *c = NULL;
+  unsigned char cnt[4];
+  unsigned obl = pctx->prng->OBL;
+  int outl = 0;
+  int rv = 1;
+
+  if(NULL == pctx->ctrctx) {
+    if((NULL == (c = CtrCipher(pctx))) || (NULL == (pctx->ctrctx = EVP_CIPHER_CTX_new()))) {
+      return -1;
+    }
+  }
+  Add(pctx->V,pctx->V,obl,(unsigned char *)C01,1);
+  if(!pctx->ctrkeyed) {
+    if(NULL == c) {
+      c = CtrCipher(pctx);
+    }
+    rv = EVP_EncryptInit_ex(pctx->ctrctx,c,NULL,pctx->K,pctx->V);
+    pctx->ctrkeyed = (1 == rv);
+  } else {
+    rv = EVP_EncryptInit_ex(pctx->ctrctx,NULL,NULL,NULL,pctx->V);
+  }
+  if(1 == rv) {
+    memset(out,0,n * obl);
+    if( 1 != EVP_EncryptUpdate(pctx->ctrctx,out,&outl,out,(int)(n * obl)) ||
+        (outl != (int)(n * obl)) ) {
+      OPENSSL_cleanse(out,n * obl); /* Don't return part of the output */
+      rv = 0;
+    }
+  }
+  /* V is left at V+n, as the block at a time loop would */
+  uint2BS(n - 1,cnt);
+  Add(pctx->V,pctx->V,obl,cnt,4);
+  return (1 == rv) ? 1 : 0;
+}
+/*!
+  @brief Generate n blocks of DRBG output directly into out
+  @param pctx a pointer to an internal PRNG ctx structure
+  @param out where to place the output, n * OBL bytes
+  @param n the number of blocks
+  @return 1 on success, 0 on an encryption failure
+  @note The counter blocks (V+1 ... V+n) are laid down in out and encrypted
+  in place with a single EVP call. The key schedule is ECB so this is
+  exactly the block at a time result, but lets the hardware pipeline
+  (AES-NI, POWER8, CPACF) process several blocks at once.
+  If the encryption fails out is cleared, it would otherwise hold the 
+  DRBG's V.
+*/
+static int CtrBlocks(SP800_90PRNG_Data_t *pctx, unsigned char *out, unsigned n)
+{
+  unsigned i = 0;
+  int outl = 0;
+  unsigned obl = pctx->prng->OBL;
+  unsigned char *p = out;
+  int rv = -1;
+
+  if ((n >= CTR_STREAM_MIN) && (OS_CpuFeatures() & CTR_STREAM_CPUF)) {
+    rv = CtrStream(pctx, out, n);
+  }
+  if (rv >= 0) {
+    return rv;
+  }
+  for (i = 0; i < n; i++) {
+    Add(pctx->V,pctx->V,obl,(unsigned char *)C01,1);
+    memcpy(p,pctx->V,obl);
+    p += obl;
+  }
+  if( 1 != EVP_EncryptUpdate(pctx->ctx.cctx,out,&outl,out,(int)(n * obl)) ||
+      (outl != (int)(n * obl)) ) {
+    OPENSSL_cleanse(out,n * obl);
+    return 0;
+  }
+  return 1;
+}
+/*!
+  @brief the CTR_DRBG output loop, shared by the DF and no DF modes
+  @param pctx a pointer to an internal PRNG ctx structure
+  @param buffer the output buffer
+  @param blen the number of bytes wanted
+  @return 1 on success, 0 on an encryption failure, buffer is cleared
+  @note whole blocks are generated in batches straight into the 
+  caller's buffer, only a trailing partial block goes via pctx->T
+*/
+static int CtrOutput(SP800_90PRNG_Data_t *pctx, unsigned char *buffer, unsigned blen)
+{
+  unsigned n = 0;
+  unsigned obl = pctx->prng->OBL;
+  unsigned char *start = buffer;
+  unsigned len = blen;
+
+  while(blen >= obl) {
+    n = blen / obl;
+    if (n > CTR_BATCH) {
+      n = CTR_BATCH;
+    }
+    if (!CtrBlocks(pctx, buffer, n)) {
+      OPENSSL_cleanse(start, len); /* Nothing from a failed generate */
+      return 0;
+    }
+    buffer += n * obl;
+    blen -= n * obl;
+  }
+  if (blen > 0) {
+    if (!CtrBlocks(pctx, pctx->T, 1)) {
+      OPENSSL_cleanse(start, len);
+      return 0;
+    }
+    memcpy(buffer,pctx->T,blen);
+  }
+  return 1;
+}
 /*!
   @brief SP800-90 Cipher derivation function
   @param pctx a PRNG context
@@ -137,6 +321,10 @@ static void Update(SP800_90PRNG_Data_t *pctx)
   @note Output always comes out in pctx->C and is pctx->prng->seedlen bytes
   ASSUME that this is supposed to not change the stored state 
   (Encryption key, pctx->K, pctx->V), so Cipher_df uses it's own EVP_CIPHER_CTX
+  The BCC context is created and keyed with the fixed df key on first use
+  and kept for the life of the DRBG, instantiate, reseed and every generate
+  with additional input come through here. The output chain context is 
+  kept as well and only has it's key schedule redone.
 */
 
 static void Cipher_df(SP800_90PRNG_Data_t *pctx,DS *dsin)
@@ -153,7 +341,25 @@ static void Cipher_df(SP800_90PRNG_Data_t *pctx,DS *dsin)
   int eol = 0;
   EVP_CIPHER_CTX *ctx = NULL;
 
-  ctx = EVP_CIPHER_CTX_new();
+  if(NULL == pctx->dfctx) {
+    pctx->dfctx = EVP_CIPHER_CTX_new();
+    /* Set the encryption key 0x00,0x01 ....*/
+    if((NULL == pctx->dfctx) || 
+       (1 != EVP_EncryptInit_ex(pctx->dfctx,pctx->alg.cipher,NULL,(unsigned char *)K,NULL))) {
+      EVP_CIPHER_CTX_free(pctx->dfctx);
+      pctx->dfctx = NULL; 
+      pctx->error_reason = ERRAT("Encrypt Init failed");
+      pctx->state = SP800_90ERROR;
+      return;
+    }
+  }
+  if(NULL == pctx->dfxctx) {
+    if(NULL == (pctx->dfxctx = EVP_CIPHER_CTX_new())) {
+      pctx->error_reason = ERRAT("Encrypt Init failed");
+      pctx->state = SP800_90ERROR;
+      return;
+    }
+  } 
   
   memset(IV,0,pctx->prng->OBL);
   DS_Reset(dsin);
@@ -181,27 +387,21 @@ static void Cipher_df(SP800_90PRNG_Data_t *pctx,DS *dsin)
   DS_Append(dsin,i,ZERO);
 
 
-  /* Set the encryption key 0x00,0x01 ....*/
-  if( 1 != EVP_EncryptInit(ctx,pctx->alg.cipher,(unsigned char *)K,NULL)  ) {
-    pctx->error_reason = ERRAT("Encrypt Init failed");
-    pctx->state = SP800_90ERROR;
+  /* All the seedlen / outlen chains in one pass, ECB so nothing 
+     carries over in dfctx between calls 
+  */
+  i = (pctx->prng->seedlen + pctx->prng->OBL - 1) / pctx->prng->OBL;
+  BCC(pctx,pctx->dfctx,dsin,i,pctx->T);
+  if(SP800_90ERROR == pctx->state) {
     return;
   }
-  outl = pctx->prng->seedlen; 
-  ptr = pctx->T;
-  i = 0;
-  while(outl > 0) {
-    uint2BS(i,IV);  /* Set the block # field in the IV */
-    DS_Reset(dsin);
-    BCC(pctx,ctx,dsin,ptr);
-    k = (outl > pctx->prng->OBL) ? pctx->prng->OBL: outl;
-    ptr += k;
-    outl -= k;
-    i = i + 1;
-  }
-  EVP_CIPHER_CTX_cleanup(ctx);
-  /*  K = Leftmost keylen bits of temp (pctx->T)*/
-  if( 1 != EVP_EncryptInit(ctx,pctx->alg.cipher,pctx->T,NULL)  ) {
+  /*  K = Leftmost keylen bits of temp (pctx->T)
+      Once the cipher is set, only the key is replaced
+  */
+  ctx = pctx->dfxctx;
+  if( 1 != EVP_EncryptInit_ex(ctx,
+                              (NULL == EVP_CIPHER_CTX_cipher(ctx)) ? pctx->alg.cipher : NULL,
+                              NULL,pctx->T,NULL)  ) {
     pctx->error_reason = ERRAT("Encrypt Init failed");
     pctx->state = SP800_90ERROR;
     return;
@@ -227,8 +427,6 @@ static void Cipher_df(SP800_90PRNG_Data_t *pctx,DS *dsin)
   }
   /* And clear our scratch area */
   memset(pctx->T,0,pctx->prng->OBL);
-  EVP_CIPHER_CTX_cleanup(ctx);
-  EVP_CIPHER_CTX_free(ctx);
 }
 
 /*! 
@@ -330,8 +528,6 @@ SP800_90STATE CIPHER_Generate(PRNG_CTX *ctx,
  
   SP800_90PRNG_Data_t *pctx = (SP800_90PRNG_Data_t *)ctx;
 
-  int j = 0;
-  int outl = 0;
   DS seedDS;
   /* Note that the ReSeed logic, state validation 
      and prediction resistance
@@ -349,18 +545,10 @@ SP800_90STATE CIPHER_Generate(PRNG_CTX *ctx,
   /*
     Data is generated by encrypting V and incrementing V for the next block
   */
-  while(blen > 0) {
-    Add(pctx->V,pctx->V,pctx->prng->OBL,(unsigned char *)C01,1);      
-    if( 1 != EVP_EncryptUpdate(pctx->ctx.cctx,pctx->T,&outl,pctx->V,(int)pctx->prng->OBL) ||
-	(outl != (int)pctx->prng->OBL)  ) {
-      pctx->error_reason = ERRAT("Encrypt Update failed");
-      pctx->state = SP800_90ERROR;
-      return pctx->state;
-    }
-    j = (blen > pctx->prng->OBL) ?  pctx->prng->OBL: blen; 
-    memcpy(buffer,pctx->T,j);
-    buffer += j;
-    blen -= j;
+  if (!CtrOutput(pctx, buffer, blen)) {
+    pctx->error_reason = ERRAT("Encrypt Update failed");
+    pctx->state = SP800_90ERROR;
+    return pctx->state;
   }
   /*
     Update K,V , with additional input if any fed through
@@ -391,6 +579,19 @@ SP800_90STATE CIPHER_Cleanup(PRNG_CTX *ctx)
     EVP_CIPHER_CTX_free(pctx->ctx.cctx);
     pctx->ctx.cctx = NULL;
   }
+  if(NULL != pctx->ctrctx) {
+    EVP_CIPHER_CTX_free(pctx->ctrctx);
+    pctx->ctrctx = NULL;
+  }
+  pctx->ctrkeyed = 0;
+  if(NULL != pctx->dfctx) {
+    EVP_CIPHER_CTX_free(pctx->dfctx);
+    pctx->dfctx = NULL;
+  }
+  if(NULL != pctx->dfxctx) {
+    EVP_CIPHER_CTX_free(pctx->dfxctx);
+    pctx->dfxctx = NULL;
+  }
   return pctx->state; 
 }
 
@@ -486,9 +687,6 @@ SP800_90STATE CIPHER_GenerateNoDF(PRNG_CTX *ctx,
  
   SP800_90PRNG_Data_t *pctx = (SP800_90PRNG_Data_t *)ctx;
 
-  int j = 0;
-  int outl = 0;
-
   /* Note that the ReSeed logic,parameter checks, 
      state validation and prediction resistance
      is handled in SP800_90.c
@@ -503,13 +701,10 @@ SP800_90STATE CIPHER_GenerateNoDF(PRNG_CTX *ctx,
   /*
     Data is generated by encrypting V and incrementing V for the next block
   */
-  while(blen > 0) {
-    Add(pctx->V,pctx->V,pctx->prng->OBL,(unsigned char *)C01,1);      
-    EVP_EncryptUpdate(pctx->ctx.cctx,pctx->T,&outl,pctx->V,pctx->prng->OBL);
-    j = (blen > pctx->prng->OBL) ?  pctx->prng->OBL: blen;
-    memcpy(buffer,pctx->T,j);
-    buffer += j;
-    blen -= j;
+  if (!CtrOutput(pctx, buffer, blen)) {
+    pctx->error_reason = ERRAT("Encrypt Update failed");
+    pctx->state = SP800_90ERROR;
+    return pctx->state;
   }
   /*
     Update K,V , with additional input if any fed through
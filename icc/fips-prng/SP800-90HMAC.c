@@ -186,16 +186,22 @@ static SP800_90STATE SP_HMAC_Generate(PRNG_CTX *ctx,
   }
  
   /* Works fine with no prediction resistance */
+  /* K is fixed for the whole output loop, so key the HMAC once.
+     HMAC_Init_ex() with a NULL key then just restores the saved
+     pre-keyed inner/outer digest states for each block rather than 
+     hashing the ipad/opad again.
+  */
+  HMAC_Init_ex(pctx->ctx.hmac_ctx,pctx->K,pctx->prng->OBL,pctx->alg.md,NULL);
   while(blen > 0 ) {
-    HMAC_Init_ex(pctx->ctx.hmac_ctx,pctx->K,pctx->prng->OBL,pctx->alg.md,NULL);
+    HMAC_Init_ex(pctx->ctx.hmac_ctx,NULL,0,NULL,NULL);
     HMAC_Update(pctx->ctx.hmac_ctx,pctx->V,pctx->prng->OBL);
     HMAC_Final(pctx->ctx.hmac_ctx,pctx->V,&l);
-    HMAC_CTX_cleanup(pctx->ctx.hmac_ctx);
     j = (blen > pctx->prng->OBL) ? pctx->prng->OBL: blen;
     memcpy(buffer,pctx->V,j);
     buffer += j;
     blen -= j;
   }
+  HMAC_CTX_cleanup(pctx->ctx.hmac_ctx);
   DS_Reset(&seedDS);
   SP_HMAC_Update(pctx,&seedDS);
 
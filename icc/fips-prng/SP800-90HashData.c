@@ -47,6 +47,7 @@ static void Hash_df(SP800_90PRNG_Data_t *pctx,DS *in, unsigned char *out, unsign
   unsigned char outbits[4]; 
   unsigned int digestL = 0;
   unsigned char *ptr = NULL;
+  unsigned char *dst = NULL;
   unsigned int n = 0;
 
   uint2BS(outl*8,outbits);
@@ -58,8 +59,12 @@ static void Hash_df(SP800_90PRNG_Data_t *pctx,DS *in, unsigned char *out, unsign
   */
   DS_Insert(in,4,outbits);
   DS_Insert(in,1,&counter);
+  /* The _ex forms re-use the digest state in place, the non _ex
+     forms free and reallocate it on every block
+  */
   while(outl > 0) {
-    if( 1 != EVP_DigestInit(pctx->ctx.md_ctx,pctx->alg.md) ) {
+    dst = (outl >= pctx->prng->OBL) ? out : pctx->T;
+    if( 1 != EVP_DigestInit_ex(pctx->ctx.md_ctx,pctx->alg.md,NULL) ) {
       pctx->error_reason = ERRAT("Digest Init failed");
       pctx->state = SP800_90ERROR;
       EVP_MD_CTX_reset(pctx->ctx.md_ctx);
@@ -75,19 +80,21 @@ static void Hash_df(SP800_90PRNG_Data_t *pctx,DS *in, unsigned char *out, unsign
 	return;
       }
     } 
-    if( 1 != EVP_DigestFinal(pctx->ctx.md_ctx,pctx->T, &digestL) ) {
+    if( 1 != EVP_DigestFinal_ex(pctx->ctx.md_ctx,dst, &digestL) ) {
      	pctx->error_reason = ERRAT("Digest Final failed");
 	pctx->state = SP800_90ERROR;
 	EVP_MD_CTX_reset(pctx->ctx.md_ctx);
 	return; 
     }
-    EVP_MD_CTX_reset(pctx->ctx.md_ctx);
     j = (outl > digestL) ? digestL : outl;
-    memcpy(out,pctx->T,j);
+    if(dst != out) {
+      memcpy(out,pctx->T,j);
+    }
     out += j;
     outl -= j;
     counter ++;
   }
+  EVP_MD_CTX_reset(pctx->ctx.md_ctx);
   /* Debugging aid as much as anything, 
      T should be zero if not being used 
   */
@@ -199,6 +206,7 @@ static SP800_90STATE SHA_Generate(PRNG_CTX *ctx,
   SP800_90PRNG_Data_t *pctx = (SP800_90PRNG_Data_t *)ctx;
   unsigned int l = 0;
   int j = 0;
+  unsigned char *dst = NULL;
 
   /* If additional input != NULL ... */
   if( (NULL != adata) && (0 != adatal)) {
@@ -248,9 +256,14 @@ static SP800_90STATE SHA_Generate(PRNG_CTX *ctx,
   /* Returned bits = Hashgen(requested,V) */
 
   memcpy(pctx->T,pctx->V,pctx->prng->seedlen);
-	 
+
+  /* Every block is independent. The digest state is set up once and 
+     re-initialized in place, and whole blocks are hashed straight 
+     into the caller's buffer, only the tail goes via eBuf.
+  */
   while(blen > 0) {
-    if( 1 != EVP_DigestInit(pctx->ctx.md_ctx,pctx->alg.md) ) {
+    dst = (blen >= pctx->prng->OBL) ? buffer : pctx->eBuf;
+    if( 1 != EVP_DigestInit_ex(pctx->ctx.md_ctx,pctx->alg.md,NULL) ) {
       pctx->error_reason = ERRAT("Digest Init failed");
       pctx->state = SP800_90ERROR;
       EVP_MD_CTX_reset(pctx->ctx.md_ctx);
@@ -262,23 +275,26 @@ static SP800_90STATE SHA_Generate(PRNG_CTX *ctx,
       EVP_MD_CTX_reset(pctx->ctx.md_ctx);
       return pctx->state;
     }
-    /* Can't just hash directly into buffer, it may not have enough room
-       for the hash result
+    /* Can't hash directly into the last partial block of buffer, 
+       it may not have enough room for the hash result
     */
-    if( 1 != EVP_DigestFinal(pctx->ctx.md_ctx,pctx->eBuf,&l) )  {
+    if( 1 != EVP_DigestFinal_ex(pctx->ctx.md_ctx,dst,&l) )  {
       pctx->error_reason = ERRAT("Digest Final failed");
       pctx->state = SP800_90ERROR;
       EVP_MD_CTX_reset(pctx->ctx.md_ctx);
       return pctx->state;
     }
-    EVP_MD_CTX_reset(pctx->ctx.md_ctx);
     /* data = data +1 */
     Add(pctx->T,pctx->T,pctx->prng->seedlen,(unsigned char *)C01,1);
     j = (blen > l) ? l: blen;
-    memcpy(buffer,pctx->eBuf,j);
+    if(dst != buffer) {
+      memcpy(buffer,pctx->eBuf,j);
+      memset(pctx->eBuf,0,l);
+    }
     buffer += j;
     blen -= j;
   }
+  EVP_MD_CTX_reset(pctx->ctx.md_ctx);
   /* create H in pctx->T 
      H = Hash(0x03 || V )
   */
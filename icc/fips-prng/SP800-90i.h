@@ -77,6 +77,10 @@ typedef enum {
    to guarantee meeting the entropy requirements
 */
 #define EBUF_SIZE (MAX_STRENGTH * ICC_GUARANTEED_ENTROPY)
+/*! Room for the default personalization string, see Personalize() */
+#define PBUF_SIZE 128
+/*! PRNG_CTX alignment, a cache line */
+#define CTX_ALIGN 64
 
 /*! \FIPS The number of times the NRBG can be instantiated 
   before self test is re-run
@@ -229,6 +233,10 @@ typedef struct {
   unsigned char T[MAX_T];  /*!< Scratch space */
   unsigned char eBuf[EBUF_SIZE]; /*!< A scratch buffer used to collect NRBG input,
 				   and DRBG output. It's scrubbed after each use */
+  unsigned char preSeed[EBUF_SIZE]; /*!< Health tested entropy gathered ahead of the next reseed */
+  unsigned int preSeedl;       /*!< Bytes held in preSeed, 0 if none */
+  unsigned char nBuf[EBUF_SIZE]; /*!< Nonce scratch for instantiate, scrubbed after use */
+  unsigned char pBuf[PBUF_SIZE]; /*!< Personalization scratch for instantiate, scrubbed after use */
   unsigned int TestMode;       /*!< Set if we are testing the DRBG, supresses scrubbing if fed in (const) data buffers */
   unsigned int SecStr;         /*!< The desired security strength in bits 112, 128,192,256 */
   unsigned int ReseedAt;       /*!< Number of CALLS (not bytes) before we Reseed */
@@ -253,9 +261,16 @@ typedef struct {
   char * error_reason;         /*!< A short reason for a failure */
   TRNG *trng;                  /*!< The seed source for this DRBG instance */
   unsigned char lastdata[CNT_SZ];   /*!< The first 8 bytes of the last data request */
-#if !defined(_WIN32)
-  pid_t lastPID;               /* The PID on the last call to generate, auto-reseed on fork() - lacking on Windows */
-#endif
+  void *alloc;                 /*!< The allocation holding this (cache line aligned) context */
+  unsigned long long gens;     /*!< RNG_Generate() calls, ICC_RNG_STATS */
+  unsigned long long gen_bytes;/*!< Bytes returned by those calls */
+  unsigned long long reseeds;  /*!< Reseeds from the NRBG, or from entropy gathered ahead */
+  unsigned long long gather_ns;/*!< Time spent waiting on the NRBG to reseed */
+  unsigned int forkGen;        /*!< RNG_ForkGeneration() on the last call to generate, auto-reseed on fork() */
+  EVP_CIPHER_CTX *ctrctx;      /*!< Cipher modes: CTR mode context for bulk output, see CtrStream() */
+  unsigned int ctrkeyed;       /*!< ctrctx holds the current K */
+  EVP_CIPHER_CTX *dfctx;       /*!< Cipher modes: Cipher_df() BCC context, keyed once with the fixed df key */
+  EVP_CIPHER_CTX *dfxctx;      /*!< Cipher modes: Cipher_df() output chain context, rekeyed per call */
 } SP800_90PRNG_Data_t;
 
 
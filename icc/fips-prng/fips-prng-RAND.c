@@ -30,6 +30,9 @@
 #include "TRNG/entropy_estimator.h"
 #include "fips-prng/SP800-90.h"
 #include "fips-prng/SP800-90i.h"
+#include "fips-prng/fips-prng-RAND.h"
+#include "TRNG/ICC_NRBG.h"
+#include "icc_probes.h"
 
 
 
@@ -67,6 +70,17 @@ static RAND_METHOD fips_rand_meth={
 
 #define MAX_rngs 256  /*!< The absolute limit on the number of RNG units in play */
 
+/*! Padding at the end of each pool slot. Slot locks are taken from 
+   every CPU, with at least a cache line between slots (x86 prefetches
+   lines in pairs, POWER has 128 byte lines, z 256) neighbours never
+   share one. 
+*/
+#if defined(__s390__) || defined(__MVS__)
+#define RNG_SLOT_PAD 256
+#else
+#define RNG_SLOT_PAD 128
+#endif
+
 /*! Why 38 bytes of AAD ?, well the strength of the PRNG is rated at
    256 bits, so more than 32 bytes is pointless. 
    However, regular sized blocks (like timestamps)  get fed in, 
@@ -78,8 +92,44 @@ static RAND_METHOD fips_rand_meth={
 
 #define AAD_SIZE 38
 
+/*! @brief Additional input accumulator for a seed DRBG.
+  Filled by RAND_seed() when ICC_RNG_SEED_COALESCE=1, and folded in as
+  additional input on the DRBG's next generate.
+*/
+typedef struct {
+  unsigned int bytes;           /*!< Bytes accumulated, capped at AAD_SIZE - 1 */
+  unsigned int index;           /*!< Next byte to xor into, 1 .. AAD_SIZE - 1 */
+  unsigned char aad[AAD_SIZE];  /*!< aad[0] tags the DRBG, the data follows */
+} RNG_AAD;
+
 static enum { UNDEF, INIT, FAIL }  status = UNDEF;
 
+/*! Output caching. With ICC_RNG_CACHE=<bytes> each RNG gets a buffer of
+   that size, filled by one Generate call, and small requests are served
+   from it with a copy. The continuous test still runs on every block 
+   the RNG generates. Bytes are cleared as they are handed out and the 
+   whole cache is discarded on a PID change so a forked child never 
+   hands out the same bytes as it's parent.
+*/
+#define RNG_CACHE_MAX 16384  /*!< Upper limit on the cache size */
+#define RNG_CACHE_SMALL 64   /*!< Requests larger than this bypass the cache */
+
+typedef struct {
+  unsigned char *buf;  /*!< cache_size bytes, allocated on first use */
+  unsigned int avail;  /*!< Unused bytes, these are at the start of buf */
+  unsigned int gen;    /*!< RNG_ForkGeneration() when the cache was filled */
+} RNG_CACHE;
+
+static unsigned int cache_size = 0; /*!< 0, the default, disables the cache */
+
+/*! @brief Contended locks on a pool slot, ICC_RNG_STATS.
+  Only updated by the thread which then holds the slot.
+*/
+typedef struct {
+  unsigned long long n;   /*!< Times the slot was found locked */
+  unsigned long long ns;  /*!< Time spent waiting for it */
+} RNG_WAITS;
+
 
 
 /*! \FIPS DRBG underlying OpenSSL's RAND_pseudo_bytes() and ICC's 
@@ -91,8 +141,13 @@ static enum { UNDEF, INIT, FAIL }  status = UNDEF;
 typedef struct {
   ICC_Mutex mtx;
   PRNG_CTX *rng;
+  RNG_CACHE cache;
+  RNG_WAITS waits;
+  unsigned char pad[RNG_SLOT_PAD]; /*!< Keeps the next slot off our cache lines */
 } PRNG_BLOCK;
 
+typedef struct RNG_BATCH_REQ_t RNG_BATCH_REQ; /*!< ICC_RNG_BATCH, see batch_rand_bytes() */
+
 /*! \FIPS RGB underyling OpenSSL's RAND_bytes() and ICC_GenerateRandomSeed().
   
    - See A.1 Draft NIST SP800-90C
@@ -103,21 +158,176 @@ typedef struct {
 typedef struct {
   ICC_Mutex mtx;
   PRNG_CTX *rng;
-  unsigned int bytes;
-  unsigned int index;
-  unsigned char aad[AAD_SIZE];
+  RNG_AAD aad;
+  RNG_CACHE cache;
+  RNG_WAITS waits;
+  ICC_Mutex bmtx;         /*!< Protects queue, never held while generating */
+  RNG_BATCH_REQ *queue;   /*!< Requests waiting on mtx, ICC_RNG_BATCH */
+  volatile int seedwait;  /*!< A non-blocking request found this slot not ready */
+  unsigned char pad[RNG_SLOT_PAD]; /*!< Keeps the next slot off our cache lines */
 } TRNG_BLOCK;
 
 static PRNG_BLOCK *pctx = NULL;  /*!< Standard SP800-90 PRNG */
 static TRNG_BLOCK *tctx = NULL; /*!< SP800-90B/C RBG used as seed source */
 
+/*! \FIPS Per-thread RBG's, an alternative to the pools above.
+  Each thread lazily gets it's own pair of DRBG's, held in thread local 
+  storage, so the common path takes no contended locks. 
+  The blocks are also chained so we can find them on library cleanup 
+  for threads which are still running.
+  @note the DRBG's are constructed exactly as the pool DRBG's are,
+  this only changes which thread owns them.
+  @note mtx is held by the owner while it uses the DRBG's, only 
+  RAND_FIPS_Scrub() ever contends for it.
+*/
+typedef struct THREAD_RNG_t {
+  ICC_Mutex mtx;               /*!< Owner, and RAND_FIPS_Scrub() */
+  PRNG_CTX *prng;              /*!< This thread's equivalent of pctx[].rng */
+  PRNG_CTX *trng;              /*!< This thread's equivalent of tctx[].rng */
+  RNG_CACHE pcache;            /*!< Output cache for prng */
+  RNG_CACHE tcache;            /*!< Output cache for trng */
+  RNG_AAD taad;                /*!< Coalesced RAND_seed() data for trng */
+  struct THREAD_RNG_t *next;   /*!< Chain of all per-thread blocks */
+} THREAD_RNG;
+
+static int per_thread = 0;            /*!< Per-thread RNG's requested */
+static int thread_key_ok = 0;         /*!< TLS key and list mutex are valid */
+static ICC_ThreadKey thread_key;       /*!< Key for the THREAD_RNG block */
+static ICC_Mutex thread_mtx;           /*!< Protects thread_list */
+static THREAD_RNG *thread_list = NULL; /*!< All live THREAD_RNG blocks */
+
 /* Yes, 7 is an odd number, in fact, it's a prime, so if there's some
    pattern in thread allocation, we have a better chance of distributing
    threads across RNG's well
 */
 static int N_rngs = 7; /*!< The number of RNG units in play */
+
+/*! Auto-sizing. With ICC_RNG_INSTANCES=auto the pool starts at the online
+   CPU count and doubles, up to N_alloc slots, when threads keep finding
+   their slot locked. Busy locks are counted over a sample window,
+   so contention spread over the life of the process never grows the pool,
+   only a burst of it does. The slots are all allocated (and their mutexes created)
+   up front so growing the pool never moves a lock that's in use,
+   the RNG's in the new slots are still only instantiated on first use.
+*/
+#define RNG_CONTENTION_THRESHOLD 256 /*!< Busy slot locks in one window before we grow */
+#define RNG_CONTENTION_WINDOW_NS 1000000000ULL /*!< The contention sample window, 1s */
+#define RNG_AUTO_SPREAD 4           /*!< Auto mode upper limit is this * CPU's */
+
+static int auto_rngs = 0;   /*!< Auto-size the pool */
+static int N_alloc = 0;     /*!< The number of RNG slots allocated, >= N_rngs */
+static volatile unsigned int contention = 0; /*!< Busy locks seen this window, approximate */
+static volatile unsigned long long contention_t0 = 0; /*!< Start of the current window */
+static ICC_Mutex pool_mtx;  /*!< Serializes pool resizing */
 static char icc_global_prng_name[20] = {"SHA256"}; /*!< The type of the default PRNG */
 
+/*! Background reseeding. With ICC_RNG_RESEED_THREAD=1 a worker thread 
+   polls the pool DRBG's and, for any close to a reseed, gathers the 
+   entropy it will need from it's own NRBG of the same type. 
+   The reseed on the request path then only consumes that.
+   @note The per-thread DRBG's are lock free so the worker can't touch them.
+   Threads don't survive fork(), a child starts it's own worker on it's
+   first RNG call, which then gathers entropy for all the DRBG's the fork
+   left needing a reseed.
+*/
+#define RESEED_POLL_MS 50 /*!< Worker polling interval */
+
+/*! RAND_seed() coalescing. By default every RAND_seed() call reseeds the
+   seed DRBG from it's NRBG, under the slot lock. With 
+   ICC_RNG_SEED_COALESCE=1 caller data is xor'd into the DRBG's RNG_AAD 
+   accumulator instead and used as additional input on it's next generate.
+   RAND_seed(NULL,0), which we use to force a reseed before key 
+   generation, still reseeds, as do the scheduled reseeds.
+*/
+static int seed_coalesce = 0;
+
+/*! Parallel fill. With ICC_RNG_PARALLEL=<threads> a fips_rand_bytes() 
+   request of at least RNG_PARALLEL_MIN bytes is split into segments, 
+   each generated, and continuity tested, by a different pool DRBG on 
+   it's own thread. The calling thread fills the first segment. 
+   Threads are started per request, that's noise at these sizes.
+*/
+#define RNG_PARALLEL_MIN (1024 * 1024) /*!< Smallest request we split */
+#define RNG_PARALLEL_SEG (256 * 1024)  /*!< Smallest segment */
+#define RNG_PARALLEL_MAX 64            /*!< Upper limit on the threads used */
+
+static int parallel_fill = 0; /*!< Threads used for a large request, < 2 disables */
+
+/*! Request batching. With ICC_RNG_BATCH=1 a small fips_rand_bytes() 
+   request queues itself on it's seed DRBG's slot before waiting for 
+   the lock. Whoever next holds the lock serves everything queued with 
+   one generate, split between the callers, so a burst of requests costs
+   one generate - and with prediction resistance one entropy gather - 
+   rather than one each. Every request is still served by a generate 
+   which started after it arrived.
+   Waiters find their request done when they get the lock, no extra 
+   synchronization is needed.
+*/
+#define RNG_BATCH_SMALL 128  /*!< Requests larger than this aren't batched */
+#define RNG_BATCH_REQS 32    /*!< Most requests served by one generate */
+
+static int batch_requests = 0; /*!< ICC_RNG_BATCH */
+
+/*! NUMA placement. With ICC_RNG_NUMA=1 callers pick their pool slot by
+   the CPU they're running on rather than by thread id. On a multi node
+   system the slots are split evenly between the nodes and a caller
+   only uses it's own node's slots. The slot DRBG's are instantiated on
+   first use, so each one's state is allocated and first touched on 
+   the node that uses it.
+   @note a thread which migrates just moves to another slot, slots are
+   still locked.
+*/
+static int rng_numa = 0;    /*!< ICC_RNG_NUMA */
+static int numa_nodes = 1;  /*!< NUMA nodes, read at startup with ICC_RNG_NUMA */
+
+/*! Non-blocking seed requests, fips_rand_try_bytes(). A request which 
+   would wait, on the NRBG or on a slot busy reseeding, returns at once
+   and may leave a callback. A helper thread then does the waiting: it 
+   takes each flagged slot's lock, instantiates the DRBG or gathers the 
+   entropy for it's next reseed, then runs the callbacks and exits.
+*/
+typedef struct SEED_WAIT_t {
+  void (*cb)(void *arg);       /*!< Caller's readiness callback */
+  void *arg;                   /*!< Passed to cb */
+  struct SEED_WAIT_t *next;
+} SEED_WAIT;
+
+static ICC_Mutex seedw_mtx;           /*!< Protects the seedw_ fields */
+static int seedw_ok = 0;              /*!< seedw_mtx is valid */
+static SEED_WAIT *seedw_list = NULL;  /*!< Callbacks to run when the helper's done */
+static int seedw_running = 0;         /*!< The helper thread is active */
+static int seedw_again = 0;           /*!< Slots were flagged while it was running */
+static int seedw_join = 0;            /*!< A finished helper is yet to be joined */
+static unsigned int seedw_gen = 0;    /*!< RNG_ForkGeneration() the helper was started in */
+static ICC_Thread seedw_thr;          /*!< The helper */
+
+/*! @brief A queued small request */
+struct RNG_BATCH_REQ_t {
+  unsigned char *buf;         /*!< Caller's buffer */
+  unsigned int num;           /*!< Bytes wanted, <= RNG_BATCH_SMALL */
+  int rc;                     /*!< Result, valid once done is set */
+  int done;                   /*!< Set, under the slot lock, when served */
+  struct RNG_BATCH_REQ_t *next;
+};
+
+/*! @brief One segment of a parallel fill */
+typedef struct {
+  unsigned char *buf;  /*!< Where this segment goes */
+  unsigned int len;    /*!< Segment length */
+  int slot;            /*!< The pool DRBG which fills it */
+  int rc;              /*!< RAND_R_PRNG_OK or an error */
+  int started;         /*!< thr is running */
+  ICC_Thread thr;      /*!< The thread filling it */
+} FILL_SEG;
+
+static int reseed_thread = 0;          /*!< Worker requested */
+static int reseed_running = 0;         /*!< Worker started */
+static volatile int reseed_stop = 0;   /*!< Tells the worker to exit */
+static ICC_Thread reseed_thr;          /*!< The worker */
+static unsigned int reseed_gen = 0;    /*!< RNG_ForkGeneration() the worker was started in */
+static ICC_Mutex reseed_mtx;           /*!< Serializes restarting the worker after fork() */
+static int reseed_mtx_ok = 0;          /*!< reseed_mtx is valid */
+
 /* Implementation of functions */
 /* =========================== */
 
@@ -182,6 +392,189 @@ int SetPRNGName(char *prngname)
   return rv;
 }
 
+/*! 
+  @brief return the state of the per-thread RNG mode
+  @return 1 if each thread gets it's own RNG's, 0 if the pools are in use
+*/
+int GetRNGPerThread()
+{
+  return (per_thread && ((status != INIT) || thread_key_ok)) ? 1 : 0;
+}
+
+/*!
+  @brief enable or disable the per-thread RNG's
+  @param on 1 to give each thread it's own RNG's, 0 to use the pools
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+*/
+int SetRNGPerThread(int on)
+{
+  int rv = 0;
+  if (status != INIT) {
+    per_thread = (0 != on) ? 1 : 0;
+    rv = 1;
+  }
+  return rv;
+}
+
+/*! 
+  @brief return the size of the per-RNG output cache
+  @return the cache size in bytes, 0 if caching is disabled
+*/
+int GetRNGCache()
+{
+  return (int)cache_size;
+}
+
+/*!
+  @brief set the size of the per-RNG output cache
+  @param bytes the cache size, 0 to disable, up to RNG_CACHE_MAX
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach(). 
+*/
+int SetRNGCache(int bytes)
+{
+  int rv = 0;
+  if ((status != INIT) && (bytes >= 0) && (bytes <= RNG_CACHE_MAX)) {
+    /* Must be able to serve at least one small request */
+    cache_size = (bytes > 0 && bytes < RNG_CACHE_SMALL) ? RNG_CACHE_SMALL : (unsigned int)bytes;
+    rv = 1;
+  }
+  return rv;
+}
+
+/*! 
+  @brief return the RAND_seed() coalescing mode
+  @return 1 if caller seed data is folded into the next generate, 
+  0 if each RAND_seed() reseeds
+*/
+int GetRNGSeedCoalesce()
+{
+  return seed_coalesce;
+}
+
+/*!
+  @brief enable or disable RAND_seed() coalescing
+  @param on 1 to fold caller seed data into the next generate, 
+  0 to reseed on every call
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+*/
+int SetRNGSeedCoalesce(int on)
+{
+  int rv = 0;
+  if (status != INIT) {
+    seed_coalesce = (0 != on) ? 1 : 0;
+    rv = 1;
+  }
+  return rv;
+}
+
+/*! 
+  @brief return the number of threads used to fill large requests
+  @return the thread count, 0 if parallel fill is disabled
+*/
+int GetRNGParallel()
+{
+  return parallel_fill;
+}
+
+/*!
+  @brief set the number of threads used to fill large requests
+  @param threads the number of pool DRBG's a request of 1MB or more is 
+  split across, 0 or 1 to disable, up to 64
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+*/
+int SetRNGParallel(int threads)
+{
+  int rv = 0;
+  if ((status != INIT) && (threads >= 0)) {
+    parallel_fill = (threads > RNG_PARALLEL_MAX) ? RNG_PARALLEL_MAX : threads;
+    if (parallel_fill < 2) {
+      parallel_fill = 0;
+    }
+    rv = 1;
+  }
+  return rv;
+}
+
+/*! 
+  @brief return the request batching mode
+  @return 1 if small concurrent requests share a generate, 0 otherwise
+*/
+int GetRNGBatch()
+{
+  return batch_requests;
+}
+
+/*!
+  @brief enable or disable request batching on the seed DRBG's
+  @param on 1 to serve small concurrent requests with one generate,
+  0 to generate for each
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+*/
+int SetRNGBatch(int on)
+{
+  int rv = 0;
+  if (status != INIT) {
+    batch_requests = (0 != on) ? 1 : 0;
+    rv = 1;
+  }
+  return rv;
+}
+
+/*!
+  @brief return the pool slot mapping
+  @return 1 if callers are mapped to a slot by CPU and NUMA node, 0 by thread id
+*/
+int GetRNGNuma()
+{
+  return rng_numa;
+}
+
+/*!
+  @brief map callers to pool slots by CPU and NUMA node
+  @param on 1 to map by CPU, 0 to map by thread id
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+*/
+int SetRNGNuma(int on)
+{
+  int rv = 0;
+  if (status != INIT) {
+    rng_numa = (0 != on) ? 1 : 0;
+    rv = 1;
+  }
+  return rv;
+}
+
+/*! 
+  @brief return the state of the background reseed worker
+  @return 1 if requested (before init) or running, 0 otherwise
+*/
+int GetRNGReseedThread()
+{
+  return (reseed_thread && ((status != INIT) || reseed_running)) ? 1 : 0;
+}
+
+/*!
+  @brief enable or disable the background reseed worker
+  @param on 1 to gather entropy ahead of DRBG reseeds, 0 to reseed inline
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+*/
+int SetRNGReseedThread(int on)
+{
+  int rv = 0;
+  if (status != INIT) {
+    reseed_thread = (0 != on) ? 1 : 0;
+    rv = 1;
+  }
+  return rv;
+}
+
 int SetRNGInstances(int instances)
 {
   int rv = 0;
@@ -190,70 +583,423 @@ int SetRNGInstances(int instances)
   */
   if( (status != INIT) && (instances > 0) && (instances <= MAX_rngs) ) {
       N_rngs = instances;
+      auto_rngs = 0;
+      rv = 1;
+  } else if ((status != INIT) && (RNG_INSTANCES_AUTO == instances)) {
+      auto_rngs = 1;
       rv = 1;
   }
   return rv;
 }
 
 /*!
-  @brief initialize a TRNG in the thread pool 
-  @param i the TRNG to initialize
+  @brief grow the pool if contention has passed the threshold
+  @note Readers pick up N_rngs unlocked, all slots up to N_alloc
+  are valid so a stale value only costs a little contention.
+*/
+static void grow_pool(void) {
+  int n = 0;
+  ICC_LockMutex(&pool_mtx);
+  if ((contention >= RNG_CONTENTION_THRESHOLD) && (N_rngs < N_alloc)) {
+    n = N_rngs * 2;
+    N_rngs = (n > N_alloc) ? N_alloc : n;
+  }
+  contention = 0;
+  contention_t0 = ICC_GetTimeNS();
+  ICC_UnlockMutex(&pool_mtx);
+}
+
+/*!
+  @brief pick the caller's slot in the pools
+  @return a slot index less than N_rngs
+  @note with ICC_RNG_NUMA a slot belonging to the caller's node, chosen 
+  by CPU. Falls back to the thread id if the CPU isn't known.
+*/
+static int rng_slot(void) {
+  int n = N_rngs; /* May grow under us, see grow_pool() */
+  int cpu = -1;
+  int node = 0;
+  int per = 0;
+
+  if (rng_numa) {
+    cpu = ICC_GetCurrentCPU(&node);
+  }
+  if (cpu < 0) {
+    return (int)(ICC_GetThreadId() % n);
+  }
+  if ((numa_nodes > 1) && (n >= numa_nodes)) {
+    per = n / numa_nodes;
+    return ((node % numa_nodes) * per) + (cpu % per);
+  }
+  return cpu % n;
+}
+
+/*!
+  @brief lock a slot in one of the pools, tracking contention in auto mode
+  @note only the contended path reads the clock or touches the shared counts
+  @param mtx the slot mutex
+  @param w the slot's wait counts
+  @note only a contended lock fires the rng__lock__ probes, the time
+  between them is the wait
+*/
+static void lock_slot(ICC_Mutex *mtx, RNG_WAITS *w) {
+  unsigned long long t0 = 0;
+
+  if (0 != ICC_TryLockMutex(mtx)) {
+    t0 = ICC_GetTimeNS();
+    ICC_PROBE1(rng__lock__wait, mtx);
+    if (auto_rngs) {
+      /* Start a new window if this one has expired, racy but 
+         only ever costs a window's worth of counts */
+      if ((t0 - contention_t0) > RNG_CONTENTION_WINDOW_NS) {
+        contention_t0 = t0;
+        contention = 0;
+      }
+      contention++;
+      if ((contention >= RNG_CONTENTION_THRESHOLD) && (N_rngs < N_alloc)) {
+        grow_pool();
+      }
+    }
+    ICC_LockMutex(mtx);
+    ICC_PROBE1(rng__lock__acquired, mtx);
+    w->n++;
+    w->ns += ICC_GetTimeNS() - t0;
+  }
+}
+
+/*!
+  @brief create and instantiate one of the system RNG's
+  @param rng where to return the new RNG
   @return RAND_R_PRNG_OK or an error
-  @note   
-   - i is assumed in range 
-   - locks are assumed to be taken/released outside this function
-   - TRNG already tested for not instantiated
+  @note *rng is NULL on failure
 */
-static int init_trng(int i) {
+static int init_rng(PRNG_CTX **rng) {
   int rc = RAND_R_PRNG_OK;
   PRNG *alg = NULL; 
 
   alg = get_RNGbyname(icc_global_prng_name,1);
-  tctx[i].rng = RNG_CTX_new();
+  *rng = RNG_CTX_new();
 
-  if((alg != NULL) && (NULL != tctx[i].rng) ) {
-    if(SP800_90INIT != RNG_CTX_Init(tctx[i].rng,alg,NULL,0,256,0)) {
+  if((alg != NULL) && (NULL != *rng) ) {
+    if(SP800_90INIT != RNG_CTX_Init(*rng,alg,NULL,0,256,0)) {
       rc = RAND_R_PRNG_NOT_INITIALIZED;
     } 
   } else {
     rc = RAND_R_PRNG_NOT_IMPLEMENTED;
   }
   if(RAND_R_PRNG_OK != rc) {
-    RNG_CTX_free(tctx[i].rng);
-    tctx[i].rng = NULL;
+    RNG_CTX_free(*rng);
+    *rng = NULL;
   }
   return rc;
 }
+
 /*!
   @brief initialize a TRNG in the thread pool 
   @param i the TRNG to initialize
   @return RAND_R_PRNG_OK or an error
+  @note   
+   - i is assumed in range 
+   - locks are assumed to be taken/released outside this function
+   - TRNG already tested for not instantiated
+*/
+static int init_trng(int i) {
+  return init_rng(&(tctx[i].rng));
+}
+/*!
+  @brief initialize a PRNG in the thread pool 
+  @param i the PRNG to initialize
+  @return RAND_R_PRNG_OK or an error
   @note 
    - i is assumed in range 
    - locks are assumed to be taken/released outside this function
    - rng has already been tested for not-instantiated
 */
 static int init_prng(int i) {
-  int rc =  RAND_R_PRNG_OK;
-  PRNG *alg = NULL;
+  return init_rng(&(pctx[i].rng));
+}
 
-  alg = get_RNGbyname(icc_global_prng_name,1);
-  pctx[i].rng = RNG_CTX_new();
-   if ((alg != NULL) && (NULL != pctx[i].rng)) {
-    if(SP800_90INIT != RNG_CTX_Init(pctx[i].rng,alg,NULL,0,256,0)) {
-      rc = RAND_R_PRNG_NOT_INITIALIZED;
-    } 
-  } else {
-    rc = RAND_R_PRNG_NOT_IMPLEMENTED;
+/*!
+  @brief discard anything held in an output cache
+  @param c the cache
+*/
+static void cache_clear(RNG_CACHE *c) {
+  if (NULL != c->buf) {
+    memset(c->buf, 0, cache_size);
   }
-  if(RAND_R_PRNG_OK != rc) {
-    RNG_CTX_free(pctx[i].rng);
-    pctx[i].rng = NULL;
+  c->avail = 0;
+}
+
+/*!
+  @brief clear and release an output cache
+  @param c the cache
+*/
+static void cache_free(RNG_CACHE *c) {
+  cache_clear(c);
+  if (NULL != c->buf) {
+    OPENSSL_secure_free(c->buf);
+    c->buf = NULL;
+  }
+}
+
+/*!
+  @brief Generate via the RNG's output cache
+  @param c the cache belonging to rng
+  @param rng the RNG
+  @param buf where to return the data
+  @param num the number of bytes wanted
+  @return the RNG state, as RNG_Generate()
+  @note Large requests, or any request when caching is off or the
+  cache can't be allocated, go straight to the RNG. 
+  Locking is the caller's problem, as with the RNG itself.
+*/
+static SP800_90STATE cached_generate(RNG_CACHE *c, PRNG_CTX *rng,
+                                     unsigned char *buf, unsigned int num) {
+  SP800_90STATE state = SP800_90RUN;
+  unsigned int gen = 0;
+
+  if ((0 == cache_size) || (num > RNG_CACHE_SMALL)) {
+    return RNG_Generate(rng, buf, num, NULL, 0);
+  }
+  if (NULL == c->buf) {
+    c->buf = OPENSSL_secure_malloc(cache_size);
+    c->avail = 0;
+    if (NULL == c->buf) {
+      return RNG_Generate(rng, buf, num, NULL, 0);
+    }
+  }
+  /* Never carry output across a fork() */
+  gen = RNG_ForkGeneration();
+  if (gen != c->gen) {
+    cache_clear(c);
+    c->gen = gen;
+  }
+  if (c->avail < num) {
+    cache_clear(c);
+    state = RNG_Generate(rng, c->buf, cache_size, NULL, 0);
+    switch (state) {
+    case SP800_90RUN:
+    case SP800_90RESEED:
+      c->avail = cache_size;
+      break;
+    default:
+      cache_clear(c);
+      return state;
+    }
+  }
+  /* Hand out from the end so the remainder stays contiguous */
+  c->avail -= num;
+  memcpy(buf, c->buf + c->avail, num);
+  memset(c->buf + c->avail, 0, num);
+  return state;
+}
+
+/*!
+  @brief TLS destructor, releases a thread's RNG's at thread exit
+  @param ptr the THREAD_RNG block
+  @note We only free blocks we can still find on the list, 
+  cleanup may already have released it.
+*/
+static void ICC_TLS_CALLBACK thread_rng_free(void *ptr) {
+  THREAD_RNG **pp = NULL;
+  THREAD_RNG *trng = NULL;
+
+  if (NULL != ptr) {
+    ICC_LockMutex(&thread_mtx);
+    for (pp = &thread_list; NULL != *pp; pp = &((*pp)->next)) {
+      if (*pp == (THREAD_RNG *)ptr) {
+        trng = *pp;
+        *pp = trng->next;
+        break;
+      }
+    }
+    ICC_UnlockMutex(&thread_mtx);
+    if (NULL != trng) {
+      cache_free(&(trng->pcache));
+      cache_free(&(trng->tcache));
+      RNG_CTX_free(trng->prng);
+      RNG_CTX_free(trng->trng);
+      ICC_DestroyMutex(&(trng->mtx));
+      ICC_Free(trng);
+    }
+  }
+}
+
+/*!
+  @brief return this thread's RNG, creating it if needed
+  @param seed 1 for the seed source (TRNG_BLOCK equivalent), 0 for the PRNG
+  @param cache where to return the matching output cache, may be NULL
+  @param aad where to return the additional input accumulator, may be NULL,
+  only the seed source has one
+  @param held set to the lock taken on the thread's block, the caller
+  unlocks it once it's done with the RNG, NULL if none was taken
+  @return an instantiated RNG or NULL in which case the caller 
+  should fall back to the pools
+*/
+static PRNG_CTX *thread_rng(int seed, RNG_CACHE **cache, RNG_AAD **aad,
+                            ICC_Mutex **held) {
+  THREAD_RNG *trng = NULL;
+  PRNG_CTX **rng = NULL;
+
+  *held = NULL;
+  if (thread_key_ok) {
+    trng = (THREAD_RNG *)ICC_GetThreadValue(&thread_key);
+    if (NULL == trng) {
+      trng = (THREAD_RNG *)ICC_Calloc(1, sizeof(THREAD_RNG), __FILE__, __LINE__);
+      if ((NULL != trng) && (0 != ICC_CreateMutex(&(trng->mtx)))) {
+        ICC_Free(trng);
+        trng = NULL;
+      }
+      if (NULL != trng) {
+        if (0 != ICC_SetThreadValue(&thread_key, trng)) {
+          ICC_DestroyMutex(&(trng->mtx));
+          ICC_Free(trng);
+          trng = NULL;
+        } else {
+          ICC_LockMutex(&thread_mtx);
+          trng->next = thread_list;
+          thread_list = trng;
+          ICC_UnlockMutex(&thread_mtx);
+        }
+      }
+    }
+    if (NULL != trng) {
+      ICC_LockMutex(&(trng->mtx));
+      *held = &(trng->mtx);
+      rng = seed ? &(trng->trng) : &(trng->prng);
+      if (NULL != cache) {
+        *cache = seed ? &(trng->tcache) : &(trng->pcache);
+      }
+      if (NULL != aad) {
+        *aad = seed ? &(trng->taad) : NULL;
+      }
+      if (NULL == *rng) {
+        init_rng(rng);
+      }
+      if (NULL == *rng) {
+        ICC_UnlockMutex(&(trng->mtx));
+        *held = NULL;
+      }
+      return *rng;
+    }
+  }
+  return NULL;
+}
+
+/*!
+  @brief gather entropy for one pool DRBG if it's close to a reseed
+  @param mtx the slot mutex
+  @param rng the slot RNG
+  @param src the worker's NRBG
+  @param buf scratch space, EBUF_SIZE bytes
+  @note the slot is only locked briefly, never while we gather
+*/
+static void preseed(ICC_Mutex *mtx, PRNG_CTX **rng, TRNG *src,
+                    unsigned char *buf) {
+  unsigned int n = 0;
+
+  /* Busy slots are in use, we'll get them next time round */
+  if (0 == ICC_TryLockMutex(mtx)) {
+    if (NULL != *rng) {
+      n = RNG_SeedWanted(*rng);
+    }
+    ICC_UnlockMutex(mtx);
+  }
+  if (n > 0) {
+    if (TRNG_OK == TRNG_GenerateRandomSeed(src, n, buf)) {
+      ICC_LockMutex(mtx);
+      if (NULL != *rng) {
+        RNG_PreSeed(*rng, buf, n);
+      }
+      ICC_UnlockMutex(mtx);
+    }
+    memset(buf, 0, n);
+  }
+}
+
+/*!
+  @brief background reseed worker
+  @param arg unused
+  @return 0
+*/
+static ICC_THREAD_RET ICC_THREAD_CALL reseed_worker(void *arg) {
+  TRNG *src = NULL;
+  unsigned char buf[EBUF_SIZE];
+  int i = 0;
+
+  while (!reseed_stop) {
+    /* Follow the global TRNG type, as the DRBG's do */
+    if ((NULL != src) && (TRNG_type(src) != GetDefaultTrng())) {
+      TRNG_free(src);
+      src = NULL;
+    }
+    if (NULL == src) {
+      src = TRNG_new(GetDefaultTrng());
+    }
+    if (NULL != src) {
+      for (i = 0; (i < N_alloc) && !reseed_stop; i++) {
+        preseed(&(pctx[i].mtx), &(pctx[i].rng), src, buf);
+        preseed(&(tctx[i].mtx), &(tctx[i].rng), src, buf);
+      }
+    }
+    ICC_Sleep(RESEED_POLL_MS);
+  }
+  if (NULL != src) {
+    TRNG_free(src);
+  }
+  return 0;
+}
+
+/*!
+  @brief release all per-thread RNG's and the TLS key
+  @note called with the library effectively single threaded
+*/
+static void thread_rng_cleanup(void) {
+  THREAD_RNG *trng = NULL;
+  THREAD_RNG *next = NULL;
+
+  if (thread_key_ok) {
+    thread_key_ok = 0;
+    /* This may call thread_rng_free() on some platforms */
+    ICC_DestroyThreadKey(&thread_key);
+    ICC_LockMutex(&thread_mtx);
+    trng = thread_list;
+    thread_list = NULL;
+    ICC_UnlockMutex(&thread_mtx);
+    for (; NULL != trng; trng = next) {
+      next = trng->next;
+      cache_free(&(trng->pcache));
+      cache_free(&(trng->tcache));
+      RNG_CTX_free(trng->prng);
+      RNG_CTX_free(trng->trng);
+      ICC_DestroyMutex(&(trng->mtx));
+      ICC_Free(trng);
+    }
+    ICC_DestroyMutex(&thread_mtx);
   }
-  return rc;
 }
 
 
+/*!
+  @brief start a reseed worker in a fork() child
+  @note the parent's worker didn't survive the fork, the thread handle
+  is stale so we just overwrite it. If reseed_mtx was held by a thread
+  which didn't survive either, this child simply reseeds inline.
+*/
+static void reseed_after_fork(void) {
+  if (reseed_running && reseed_mtx_ok && (reseed_gen != RNG_ForkGeneration()) &&
+      (0 == ICC_TryLockMutex(&reseed_mtx))) {
+    if (reseed_gen != RNG_ForkGeneration()) {
+      reseed_gen = RNG_ForkGeneration();
+      reseed_stop = 0;
+      if (0 != ICC_CreateThread(&reseed_thr, reseed_worker, NULL)) {
+        reseed_running = 0;
+      }
+    }
+    ICC_UnlockMutex(&reseed_mtx);
+  }
+}
+
 /* ------------------------------------- 
    Note 08/2008 Changed to use the SP800-90 API for
    the OpenSSL RNG.
@@ -293,14 +1039,42 @@ int RAND_FIPS_init(const void *seed, const unsigned int num) {
 
      */
     rc = RAND_R_PRNG_OK;
-    tctx = ICC_Malloc(sizeof(TRNG_BLOCK) * N_rngs, __FILE__, __LINE__);
+    RNG_ForkInit();
+    /* Before any pool DRBG exists so they all draw from the shared NRBG's */
+    TRNG_SharedInit();
+    TRNG_StandbyInit();
+    if (rng_numa) {
+      numa_nodes = ICC_GetNodeCount();
+    }
+    N_alloc = N_rngs;
+    if (auto_rngs) {
+      i = ICC_GetCPUCount();
+      if (i <= 0) {
+        i = N_rngs;
+      }
+      N_alloc = i * RNG_AUTO_SPREAD;
+      if (N_alloc < 7) {
+        N_alloc = 7;
+      }
+      if (N_alloc > MAX_rngs) {
+        N_alloc = MAX_rngs;
+      }
+      N_rngs = (i > N_alloc) ? N_alloc : i;
+      contention = 0;
+      if (0 != ICC_CreateMutex(&pool_mtx)) {
+        auto_rngs = 0;
+        N_alloc = N_rngs;
+      }
+    }
+    tctx = ICC_Malloc(sizeof(TRNG_BLOCK) * N_alloc, __FILE__, __LINE__);
     if (NULL == tctx) {
       rc = RAND_R_PRNG_NOT_INITIALIZED;
     }
     if (RAND_R_PRNG_OK == rc) {
-      memset(tctx, 0, sizeof(TRNG_BLOCK) * N_rngs);
-      for (i = 0; i < N_rngs; i++) {
-        if (0 != ICC_CreateMutex(&(tctx[i].mtx))) {
+      memset(tctx, 0, sizeof(TRNG_BLOCK) * N_alloc);
+      for (i = 0; i < N_alloc; i++) {
+        if ((0 != ICC_CreateMutex(&(tctx[i].mtx))) ||
+            (0 != ICC_CreateMutex(&(tctx[i].bmtx)))) {
           rc = RAND_R_PRNG_NOT_INITIALIZED;
           break;
         }
@@ -315,13 +1089,13 @@ int RAND_FIPS_init(const void *seed, const unsigned int num) {
        - Note that the PRNG construction allows for our minimum entropy
        guarantee internally
      */
-    pctx = ICC_Malloc(sizeof(PRNG_BLOCK) * N_rngs, __FILE__, __LINE__);
+    pctx = ICC_Malloc(sizeof(PRNG_BLOCK) * N_alloc, __FILE__, __LINE__);
     if (NULL == pctx) {
       rc = RAND_R_PRNG_NOT_INITIALIZED;
     }
     if (RAND_R_PRNG_OK == rc) {
-      memset(pctx, 0, sizeof(PRNG_BLOCK) * N_rngs);
-      for (i = 0; i < N_rngs; i++) {
+      memset(pctx, 0, sizeof(PRNG_BLOCK) * N_alloc);
+      for (i = 0; i < N_alloc; i++) {
         if (0 != ICC_CreateMutex(&(pctx[i].mtx))) {
           rc = RAND_R_PRNG_NOT_INITIALIZED;
           break;
@@ -329,13 +1103,43 @@ int RAND_FIPS_init(const void *seed, const unsigned int num) {
       }
     }
 
+    /* Per-thread RNG's, if we can't get TLS we quietly use the pools */
+    if ((RAND_R_PRNG_OK == rc) && per_thread && !thread_key_ok) {
+      if (0 == ICC_CreateMutex(&thread_mtx)) {
+        if (0 == ICC_CreateThreadKey(&thread_key, thread_rng_free)) {
+          thread_key_ok = 1;
+        } else {
+          ICC_DestroyMutex(&thread_mtx);
+        }
+      }
+    }
+
+    if ((RAND_R_PRNG_OK == rc) && !seedw_ok) {
+      seedw_ok = (0 == ICC_CreateMutex(&seedw_mtx)) ? 1 : 0;
+    }
+
+    if ((RAND_R_PRNG_OK == rc) && !reseed_mtx_ok) {
+      reseed_mtx_ok = (0 == ICC_CreateMutex(&reseed_mtx)) ? 1 : 0;
+    }
+
     if (RAND_R_PRNG_OK == rc) {
       status = INIT;
+      /* Without the worker reseeds are just done inline, 
+         as they are if it couldn't be restarted after a fork()
+      */
+      if (reseed_thread && reseed_mtx_ok && !reseed_running) {
+        reseed_stop = 0;
+        if (0 == ICC_CreateThread(&reseed_thr, reseed_worker, NULL)) {
+          reseed_running = 1;
+          reseed_gen = RNG_ForkGeneration();
+        }
+      }
     }
   cleanup:
     if (rc != RAND_R_PRNG_OK) {
       if (NULL != pctx) {
-        for (i = 0; i < N_rngs; i++) {
+        for (i = 0; i < N_alloc; i++) {
+          cache_free(&(pctx[i].cache));
           if (NULL != pctx[i].rng) {
             RNG_CTX_free(pctx[i].rng);
             pctx[i].rng = NULL;
@@ -346,24 +1150,95 @@ int RAND_FIPS_init(const void *seed, const unsigned int num) {
         pctx = NULL;
       }
       if (NULL != tctx) {
-        for (i = 0; i < N_rngs; i++) {
+        for (i = 0; i < N_alloc; i++) {
           if (NULL != tctx) {
+            cache_free(&(tctx[i].cache));
             RNG_CTX_free(tctx[i].rng);
             tctx[i].rng = NULL;
           }
           ICC_DestroyMutex(&(tctx[i].mtx));
+          ICC_DestroyMutex(&(tctx[i].bmtx));
         }
         ICC_Free(tctx);
         tctx = NULL;
       }
-      status = FAIL;
-      ERR_put_error(ERR_LIB_RAND, RAND_F_FIPS_PRNG_RAND_INIT, rc, __FILE__,
-                    __LINE__);
-      SetFatalError("Could not initialize system PRNG",__FILE__,__LINE__);
+      if (auto_rngs) {
+        ICC_DestroyMutex(&pool_mtx);
+      }
+      status = FAIL;
+      ERR_put_error(ERR_LIB_RAND, RAND_F_FIPS_PRNG_RAND_INIT, rc, __FILE__,
+                    __LINE__);
+      SetFatalError("Could not initialize system PRNG",__FILE__,__LINE__);
+    }
+  }
+  return rc;
+}
+/*!
+  @brief fill in one ICC_RNG_STAT for a pool slot
+  @param st where to return the counts
+  @param pool ICC_RNG_POOL_PRNG or ICC_RNG_POOL_SEED
+  @param i the slot
+  @param mtx the slot mutex
+  @param rng the slot RNG
+  @param w the slot wait counts
+*/
+static void slot_stats(ICC_RNG_STAT *st, int pool, int i, ICC_Mutex *mtx,
+                       PRNG_CTX **rng, RNG_WAITS *w) {
+  st->pool = pool;
+  st->slot = i;
+  ICC_LockMutex(mtx);
+  RNG_GetCounts(*rng, st);
+  st->waits = w->n;
+  st->wait_ns = w->ns;
+  ICC_UnlockMutex(mtx);
+}
+
+/*!
+  @brief usage counts for the RNG pools and per thread RNG's, ICC_RNG_STATS
+  @param out the caller's array, zeroed first
+  @param n entries in out
+  @note Pool slots in use, PRNG then seed pool, then per thread RNG's 
+  with the most recently created thread first.
+*/
+void GetRNGStats(ICC_RNG_STAT *out, size_t n) {
+  size_t k = 0;
+  int i = 0;
+  THREAD_RNG *trng = NULL;
+
+  memset(out, 0, n * sizeof(ICC_RNG_STAT));
+  if ((INIT != status) || (NULL == pctx) || (NULL == tctx)) {
+    return;
+  }
+  for (i = 0; (i < N_alloc) && (k < n); i++) {
+    if ((i < N_rngs) || (NULL != pctx[i].rng)) {
+      slot_stats(&out[k++], ICC_RNG_POOL_PRNG, i, &(pctx[i].mtx),
+                 &(pctx[i].rng), &(pctx[i].waits));
+    }
+  }
+  for (i = 0; (i < N_alloc) && (k < n); i++) {
+    if ((i < N_rngs) || (NULL != tctx[i].rng)) {
+      slot_stats(&out[k++], ICC_RNG_POOL_SEED, i, &(tctx[i].mtx),
+                 &(tctx[i].rng), &(tctx[i].waits));
+    }
+  }
+  if (thread_key_ok) {
+    ICC_LockMutex(&thread_mtx);
+    for (i = 0, trng = thread_list; (NULL != trng) && (k < n); trng = trng->next, i++) {
+      if (NULL != trng->prng) {
+        out[k].pool = ICC_RNG_THREAD_PRNG;
+        out[k].slot = i;
+        RNG_GetCounts(trng->prng, &out[k++]);
+      }
+      if ((NULL != trng->trng) && (k < n)) {
+        out[k].pool = ICC_RNG_THREAD_SEED;
+        out[k].slot = i;
+        RNG_GetCounts(trng->trng, &out[k++]);
+      }
     }
+    ICC_UnlockMutex(&thread_mtx);
   }
-  return rc;
 }
+
 /*!
   @brief return the entropy estimates for the core entropy sources
   @note We have three sets of potential sources, one feeding the PRNG and the other 
@@ -375,8 +1250,28 @@ int RAND_FIPS_Entropy()
   unsigned int eRNG = 0;
   unsigned int total = 100; /*! Underlying entropy source */
   int i = 0;
+  THREAD_RNG *trng = NULL;
+
+  if (thread_key_ok) {
+    ICC_LockMutex(&thread_mtx);
+    for (trng = thread_list; NULL != trng; trng = trng->next) {
+      if(NULL != trng->prng) {
+        RNG_CTX_ctrl(trng->prng,SP800_90_GETENTROPY,0,&eRNG);
+        if(eRNG < total) {
+          total = eRNG;
+        }
+      }
+      if(NULL != trng->trng) {
+        RNG_CTX_ctrl(trng->trng,SP800_90_GETENTROPY,0,&eRNG);
+        if(eRNG < total) {
+          total = eRNG;
+        }
+      }
+    }
+    ICC_UnlockMutex(&thread_mtx);
+  }
 
-  for(i = 0 ; i < N_rngs; i++) {
+  for(i = 0 ; i < N_alloc; i++) {
     if(NULL != pctx[i].rng) {
       RNG_CTX_ctrl(pctx[i].rng,SP800_90_GETENTROPY,0,&eRNG);
       if(eRNG < total) {
@@ -393,29 +1288,94 @@ int RAND_FIPS_Entropy()
   return total;
 }
 
+/*!
+  @brief xor caller seed data into an additional input accumulator
+  @param a the accumulator
+  @param tag identifies the DRBG, so the additional input each gets differs
+  @param buf the seed data
+  @param num the number of bytes of seed data
+*/
+static void aad_fold(RNG_AAD *a, unsigned char tag, const unsigned char *buf, int num) {
+  int i = 0;
+
+  a->aad[0] = tag;
+  if (0 == a->index) {
+    a->index = 1;
+  }
+  for (i = 0; i < num; i++) {
+    a->aad[a->index] ^= buf[i];
+    if (++(a->index) >= AAD_SIZE) {
+      a->index = 1;
+    }
+  }
+  a->bytes += (unsigned int)num;
+  if (a->bytes > (AAD_SIZE - 1)) {
+    a->bytes = AAD_SIZE - 1;
+  }
+}
+
+/*!
+  @brief take the pending additional input from an accumulator
+  @param a the accumulator
+  @param aad where to return a pointer to the data
+  @return the length of the additional input, 0 if there is none
+  @note the caller clears it with aad_clear() once it's been used
+*/
+static unsigned int aad_take(RNG_AAD *a, unsigned char **aad) {
+  unsigned int aadl = 0;
+
+  if (a->bytes > 0) {
+    *aad = a->aad;
+    aadl = a->bytes + 1; 
+    a->bytes = 0; /* Reset the aad accumulator state */
+    a->index = 1;
+  }
+  return aadl;
+}
+
+/*!
+  @brief scrub an accumulator after it's contents were used
+  @param a the accumulator
+*/
+static void aad_clear(RNG_AAD *a) {
+  memset(a->aad, 0, AAD_SIZE);
+}
+
 /*!
  @brief Manually reseed the PRNG
  @param ibuf the source seed data
  @param num the number of bytes of seed data
  @note the data supplied is nonce, primary seeding is internal
+ @note with ICC_RNG_SEED_COALESCE=1 seed data is only accumulated
+       and used as additional input on the next generate, 
+       RAND_seed(NULL,0) still forces a reseed
 */
 int fips_rand_seed(const void *ibuf, int num){
   int rc= RAND_R_PRNG_OK;
   int tid = 0;
   unsigned char *buf = (unsigned char *)ibuf;
   SP800_90STATE state = SP800_90RUN;
-
-  tid = ICC_GetThreadId() % N_rngs;
-
-  ICC_LockMutex(&(tctx[tid].mtx));
-  /* If it was never initialized  */
-  if (NULL == tctx[tid].rng ) {
-    rc = init_trng(tid);
-    /* No need to reseed if it was just instantiated */
-  } else { /* We allow NULL,0 because the primary seed source is internal */
-    if (num >= 0) {
-      state = RNG_ReSeed(tctx[tid].rng, buf, num);
+  PRNG_CTX *rng = NULL;
+  RNG_CACHE *cache = NULL;
+  RNG_AAD *taad = NULL;
+  ICC_Mutex *held = NULL;
+  int fold = 0;
+
+  tid = rng_slot();
+  fold = seed_coalesce && (NULL != buf) && (num > 0);
+
+  rng = thread_rng(1, &cache, &taad, &held);
+  if (NULL != rng) {
+    if (fold) {
+      /* Thread private, no contention */
+      aad_fold(taad, (unsigned char)ICC_GetThreadId(), buf, num);
+    } else {
+      cache_clear(cache);
+      if (num >= 0) {
+        state = RNG_ReSeed(rng, buf, num);
+      }
     }
+    ICC_UnlockMutex(held);
     switch (state)
     {
     case SP800_90RUN:
@@ -425,8 +1385,35 @@ int fips_rand_seed(const void *ibuf, int num){
       rc = RAND_R_PRNG_CRYPT_TEST_FAILED;
       break;
     }
+  } else {
+    lock_slot(&(tctx[tid].mtx), &(tctx[tid].waits));
+    if (fold) {
+      /* Held just long enough to xor the data in, 
+         the DRBG is instantiated on the next generate if need be 
+      */
+      aad_fold(&(tctx[tid].aad), (unsigned char)tid, buf, num);
+    } else if (NULL == tctx[tid].rng ) {
+      /* If it was never initialized  */
+      rc = init_trng(tid);
+      /* No need to reseed if it was just instantiated */
+    } else { /* We allow NULL,0 because the primary seed source is internal */
+      /* Nothing generated before the reseed should be handed out after it */
+      cache_clear(&(tctx[tid].cache));
+      if (num >= 0) {
+        state = RNG_ReSeed(tctx[tid].rng, buf, num);
+      }
+      switch (state)
+      {
+      case SP800_90RUN:
+      case SP800_90RESEED:
+        break;
+      default:
+        rc = RAND_R_PRNG_CRYPT_TEST_FAILED;
+        break;
+      }
+    }
+    ICC_UnlockMutex(&(tctx[tid].mtx));
   }
-  ICC_UnlockMutex(&(tctx[tid].mtx));
   
   if (rc != RAND_R_PRNG_OK)
   {
@@ -437,6 +1424,203 @@ int fips_rand_seed(const void *ibuf, int num){
 }
 
 
+/*!
+  @brief the seed wait helper thread
+  @param arg unused
+  @return 0
+  @note does the waiting fips_rand_try_bytes() callers couldn't, then 
+  runs their callbacks. It exits once there's nothing more to do.
+*/
+static ICC_THREAD_RET ICC_THREAD_CALL seed_waiter(void *arg) {
+  TRNG *src = NULL;
+  unsigned char buf[EBUF_SIZE];
+  SEED_WAIT *list = NULL;
+  SEED_WAIT *w = NULL;
+  unsigned int n = 0;
+  int more = 1;
+  int i = 0;
+
+  while (more) {
+    for (i = 0; i < N_rngs; i++) {
+      if (!tctx[i].seedwait) {
+        continue;
+      }
+      /* This is where the caller would have blocked */
+      ICC_LockMutex(&(tctx[i].mtx));
+      tctx[i].seedwait = 0;
+      n = 0;
+      if (NULL == tctx[i].rng) {
+        init_trng(i);
+      } else {
+        n = RNG_SeedWanted(tctx[i].rng);
+      }
+      ICC_UnlockMutex(&(tctx[i].mtx));
+      if (n > 0) {
+        if (NULL == src) {
+          src = TRNG_new(GetDefaultTrng());
+        }
+        if ((NULL != src) && (TRNG_OK == TRNG_GenerateRandomSeed(src, n, buf))) {
+          ICC_LockMutex(&(tctx[i].mtx));
+          if (NULL != tctx[i].rng) {
+            RNG_PreSeed(tctx[i].rng, buf, n);
+          }
+          ICC_UnlockMutex(&(tctx[i].mtx));
+        }
+        memset(buf, 0, n);
+      }
+    }
+    ICC_LockMutex(&seedw_mtx);
+    list = seedw_list;
+    seedw_list = NULL;
+    /* Callbacks run while we're still marked running, one that asks
+       again just queues more work for us and never joins this thread
+    */
+    more = seedw_again || (NULL != list);
+    seedw_again = 0;
+    if (!more) {
+      seedw_running = 0;
+      seedw_join = 1;
+    }
+    ICC_UnlockMutex(&seedw_mtx);
+    while (NULL != list) {
+      w = list;
+      list = w->next;
+      w->cb(w->arg);
+      ICC_Free(w);
+    }
+  }
+  if (NULL != src) {
+    TRNG_free(src);
+  }
+  return 0;
+}
+
+/*!
+  @brief flag a slot for the seed wait helper and leave a callback
+  @param tid the slot which wasn't ready
+  @param cb the callback, may be NULL
+  @param arg passed to cb
+  @return 1 if the helper will run cb, 0 if it couldn't be started
+*/
+static int seed_wait(int tid, void (*cb)(void *arg), void *arg) {
+  SEED_WAIT *w = NULL;
+  ICC_Thread old;
+  int join = 0;
+  int rv = 1;
+
+  if (!seedw_ok) {
+    return 0;
+  }
+  if (NULL != cb) {
+    w = (SEED_WAIT *)ICC_Malloc(sizeof(SEED_WAIT), __FILE__, __LINE__);
+    if (NULL == w) {
+      return 0;
+    }
+    w->cb = cb;
+    w->arg = arg;
+  }
+  tctx[tid].seedwait = 1;
+  ICC_LockMutex(&seedw_mtx);
+  /* Threads don't survive fork(), nor does anything they were doing */
+  if (seedw_running && (seedw_gen != RNG_ForkGeneration())) {
+    seedw_running = 0;
+    seedw_join = 0;
+  }
+  if (NULL != w) {
+    w->next = seedw_list;
+    seedw_list = w;
+  }
+  if (seedw_running) {
+    seedw_again = 1;
+  } else {
+    if (seedw_join) {
+      /* It's finished, or about to, join it once we've unlocked */
+      old = seedw_thr;
+      join = 1;
+      seedw_join = 0;
+    }
+    seedw_again = 0;
+    seedw_gen = RNG_ForkGeneration();
+    if (0 == ICC_CreateThread(&seedw_thr, seed_waiter, NULL)) {
+      seedw_running = 1;
+    } else {
+      if (NULL != w) {
+        seedw_list = w->next;
+        ICC_Free(w);
+      }
+      rv = 0;
+    }
+  }
+  ICC_UnlockMutex(&seedw_mtx);
+  if (join) {
+    ICC_JoinThread(&old);
+  }
+  return rv;
+}
+
+/*!
+  @brief Non-blocking variant of fips_rand_bytes() for ICC_TryGenerateRandomSeed()
+  @param buf the buffer in which to return the random data
+  @param num the number of bytes to return
+  @param cb called, from another thread, once a retry can be expected to 
+         succeed. May be NULL to just poll. Not called if the data was returned.
+  @param arg passed to cb
+  @return ICC_SEED_READY if buf was filled, ICC_SEED_WOULDBLOCK if getting 
+  it would have waited on the NRBG or on another thread's reseed, 
+  ICC_SEED_FAILED on error
+  @note Always uses the seed pools, even with ICC_RNG_PER_THREAD, 
+  as only those can be reseeded on the caller's behalf.
+  A callback doesn't guarantee the retry succeeds, another thread may have
+  used the reseed, the caller just tries again.
+*/
+int fips_rand_try_bytes(unsigned char *buf, int num, void (*cb)(void *arg), void *arg) {
+  int rv = ICC_SEED_WOULDBLOCK;
+  int tid = 0;
+  unsigned char *aad = NULL;
+  unsigned int aadl = 0;
+  SP800_90STATE state = SP800_90RUN;
+
+  if ((status != INIT) || (buf == NULL) || (num < 0)) {
+    ERR_put_error(ERR_LIB_RAND, RAND_F_FIPS_PRNG_RAND_BYTES, RAND_R_PRNG_INVALID_ARG,
+                  __FILE__, __LINE__);
+    return ICC_SEED_FAILED;
+  }
+  reseed_after_fork();
+  tid = rng_slot();
+
+  if (0 == ICC_TryLockMutex(&(tctx[tid].mtx))) {
+    if ((NULL != tctx[tid].rng) && !RNG_SeedPending(tctx[tid].rng)) {
+      aadl = aad_take(&(tctx[tid].aad), &aad);
+      memset(buf, 0, num);
+      if (0 != aadl) {
+        cache_clear(&(tctx[tid].cache));
+        state = RNG_Generate(tctx[tid].rng, buf, num, aad, aadl);
+        aad_clear(&(tctx[tid].aad));
+      } else {
+        state = cached_generate(&(tctx[tid].cache), tctx[tid].rng, buf, num);
+      }
+      switch (state) {
+      case SP800_90RUN:
+      case SP800_90RESEED:
+        rv = ICC_SEED_READY;
+        break;
+      default:
+        rv = ICC_SEED_FAILED;
+        break;
+      }
+    }
+    ICC_UnlockMutex(&(tctx[tid].mtx));
+  }
+  if ((ICC_SEED_WOULDBLOCK == rv) && !seed_wait(tid, cb, arg)) {
+    rv = ICC_SEED_FAILED;
+  }
+  if (ICC_SEED_FAILED == rv) {
+    ERR_put_error(ERR_LIB_RAND, RAND_F_FIPS_PRNG_RAND_BYTES, RAND_R_PRNG_CRYPT_TEST_FAILED,
+                  __FILE__, __LINE__);
+  }
+  return rv;
+}
+
 /* ------------------------------------- */
 static int fips_rand_add(const void *buf, int num, double add_entropy){
   /* ignore the entropy as we do not keep track of estimated entropy */
@@ -444,6 +1628,219 @@ static int fips_rand_add(const void *buf, int num, double add_entropy){
 }
 
 
+/*!
+  @brief fill one segment of a large request from a pool seed DRBG
+  @param seg the segment
+  @return RAND_R_PRNG_OK or an error
+  @note any additional input pending on that DRBG is used here
+*/
+static int fill_segment(FILL_SEG *seg) {
+  int rc = RAND_R_PRNG_OK;
+  TRNG_BLOCK *t = &(tctx[seg->slot]);
+  SP800_90STATE state = SP800_90RUN;
+  unsigned char *aad = NULL;
+  unsigned int aadl = 0;
+
+  lock_slot(&(t->mtx), &(t->waits));
+  if (NULL == t->rng) {
+    rc = init_trng(seg->slot);
+  }
+  if (RAND_R_PRNG_OK == rc) {
+    aadl = aad_take(&(t->aad), &aad);
+    memset(seg->buf, 0, seg->len);
+    state = RNG_Generate(t->rng, seg->buf, seg->len, aad, aadl);
+    if (0 != aadl) {
+      aad_clear(&(t->aad));
+    }
+    switch (state) {
+    case SP800_90RUN:
+    case SP800_90RESEED:
+      break;
+    default:
+      rc = RAND_R_PRNG_CRYPT_TEST_FAILED;
+      break;
+    }
+  }
+  ICC_UnlockMutex(&(t->mtx));
+  return rc;
+}
+
+/*!
+  @brief thread body for one segment of a parallel fill
+  @param arg the FILL_SEG
+  @return 0
+*/
+static ICC_THREAD_RET ICC_THREAD_CALL fill_worker(void *arg) {
+  FILL_SEG *seg = (FILL_SEG *)arg;
+
+  seg->rc = fill_segment(seg);
+  return 0;
+}
+
+/*!
+  @brief fill a large request from several pool DRBG's at once
+  @param buf the buffer to fill
+  @param num the number of bytes, at least RNG_PARALLEL_MIN
+  @param tid the caller's pool slot, it fills the first segment
+  @return RAND_R_PRNG_OK or an error
+  @note a segment whose thread couldn't be started is filled inline
+*/
+static int parallel_rand_bytes(unsigned char *buf, int num, int tid) {
+  FILL_SEG seg[RNG_PARALLEL_MAX];
+  int n = parallel_fill;
+  int nrngs = N_rngs; 
+  int i = 0;
+  int rc = RAND_R_PRNG_OK;
+  unsigned int seglen = 0;
+
+  if (n > nrngs) {
+    n = nrngs;
+  }
+  if (n > (num / RNG_PARALLEL_SEG)) {
+    n = num / RNG_PARALLEL_SEG;
+  }
+  /* Cache line multiples so the threads don't share a line */
+  seglen = ((unsigned int)num / n) & ~63U;
+  for (i = 0; i < n; i++) {
+    seg[i].buf = buf + (i * seglen);
+    seg[i].len = (i == (n - 1)) ? ((unsigned int)num - (i * seglen)) : seglen;
+    seg[i].slot = (tid + i) % nrngs;
+    seg[i].rc = RAND_R_PRNG_OK;
+    seg[i].started = 0;
+  }
+  for (i = 1; i < n; i++) {
+    seg[i].started = (0 == ICC_CreateThread(&(seg[i].thr), fill_worker, &seg[i]));
+  }
+  seg[0].rc = fill_segment(&seg[0]);
+  for (i = 1; i < n; i++) {
+    if (seg[i].started) {
+      ICC_JoinThread(&(seg[i].thr));
+    } else {
+      seg[i].rc = fill_segment(&seg[i]);
+    }
+  }
+  for (i = 0; i < n; i++) {
+    if (RAND_R_PRNG_OK != seg[i].rc) {
+      rc = seg[i].rc;
+    }
+  }
+  return rc;
+}
+
+/*!
+  @brief serve queued small requests with one generate
+  @param t the slot, it's DRBG is instantiated and mtx is held
+  @param mine the caller's request, it's always served
+  @note requests past RNG_BATCH_REQS stay queued, their owners 
+  serve them once they get the lock
+*/
+static void batch_serve(TRNG_BLOCK *t, RNG_BATCH_REQ *mine) {
+  RNG_BATCH_REQ *list = NULL;
+  RNG_BATCH_REQ **pp = NULL;
+  RNG_BATCH_REQ *r = NULL;
+  unsigned char tmp[RNG_BATCH_SMALL * RNG_BATCH_REQS];
+  unsigned char *aad = NULL;
+  unsigned int aadl = 0;
+  unsigned int total = 0;
+  unsigned int off = 0;
+  int n = 0;
+  int rc = RAND_R_PRNG_OK;
+  SP800_90STATE state = SP800_90RUN;
+
+  /* Take our own request, and as many of the others as fit */
+  ICC_LockMutex(&(t->bmtx));
+  pp = &(t->queue);
+  while (NULL != *pp) {
+    r = *pp;
+    if ((r == mine) || (n < (RNG_BATCH_REQS - 1))) {
+      *pp = r->next;
+      r->next = list;
+      list = r;
+      total += r->num;
+      if (r != mine) {
+        n++;
+      }
+    } else {
+      pp = &(r->next);
+    }
+  }
+  ICC_UnlockMutex(&(t->bmtx));
+
+  aadl = aad_take(&(t->aad), &aad);
+  /* Nothing cached before these requests arrived should be handed out */
+  cache_clear(&(t->cache));
+  state = RNG_Generate(t->rng, tmp, total, aad, aadl);
+  if (0 != aadl) {
+    aad_clear(&(t->aad));
+  }
+  switch (state) {
+  case SP800_90RUN:
+  case SP800_90RESEED:
+    break;
+  default:
+    rc = RAND_R_PRNG_CRYPT_TEST_FAILED;
+    break;
+  }
+  for (r = list; NULL != r; r = r->next) {
+    if (RAND_R_PRNG_OK == rc) {
+      memcpy(r->buf, tmp + off, r->num);
+    } else {
+      memset(r->buf, 0, r->num);
+    }
+    off += r->num;
+    r->rc = rc;
+    r->done = 1;
+  }
+  memset(tmp, 0, total);
+}
+
+/*!
+  @brief a small request from a pool seed DRBG, sharing a generate with any
+  others that queue up while it waits for the lock
+  @param buf the buffer to fill
+  @param num the number of bytes, <= RNG_BATCH_SMALL
+  @param tid the pool slot
+  @return RAND_R_PRNG_OK or an error
+*/
+static int batch_rand_bytes(unsigned char *buf, int num, int tid) {
+  TRNG_BLOCK *t = &(tctx[tid]);
+  RNG_BATCH_REQ **pp = NULL;
+  RNG_BATCH_REQ req;
+  int rc = RAND_R_PRNG_OK;
+
+  req.buf = buf;
+  req.num = (unsigned int)num;
+  req.rc = RAND_R_PRNG_OK;
+  req.done = 0;
+  ICC_LockMutex(&(t->bmtx));
+  req.next = t->queue;
+  t->queue = &req;
+  ICC_UnlockMutex(&(t->bmtx));
+
+  lock_slot(&(t->mtx), &(t->waits));
+  if (!req.done) {
+    if (NULL == t->rng) {
+      rc = init_trng(tid);
+    }
+    if (RAND_R_PRNG_OK == rc) {
+      batch_serve(t, &req);
+    } else {
+      /* Take ourselves off the queue, the others can try again */
+      ICC_LockMutex(&(t->bmtx));
+      for (pp = &(t->queue); NULL != *pp; pp = &((*pp)->next)) {
+        if (*pp == &req) {
+          *pp = req.next;
+          break;
+        }
+      }
+      ICC_UnlockMutex(&(t->bmtx));
+      req.rc = rc;
+    }
+  }
+  ICC_UnlockMutex(&(t->mtx));
+  return req.rc;
+}
+
 /*!
    @brief OpenSSL callback for a TRNG
    Wired to an SP800_90 PRNG in prediction resistance mode
@@ -461,8 +1858,12 @@ int fips_rand_bytes(unsigned char *buf, int num){
   unsigned char *aad = NULL;
   unsigned int aadl = 0;
   SP800_90STATE state = SP800_90RUN;
+  PRNG_CTX *rng = NULL;
+  RNG_CACHE *cache = NULL;
+  RNG_AAD *taad = NULL;
+  ICC_Mutex *held = NULL;
 
-  tid = ICC_GetThreadId() % N_rngs;
+  tid = rng_slot();
 
   if ((status != INIT) ||
       (buf==NULL) ||
@@ -470,23 +1871,59 @@ int fips_rand_bytes(unsigned char *buf, int num){
     rc=RAND_R_PRNG_INVALID_ARG; 
     goto cleanup;
   }
-  ICC_LockMutex(&(tctx[tid].mtx));
+  reseed_after_fork();
+  /* Large requests are spread over the pool, whichever mode we're in */
+  if ((parallel_fill > 1) && (num >= RNG_PARALLEL_MIN) && (N_rngs > 1)) {
+    rc = parallel_rand_bytes(buf, num, tid);
+    goto cleanup;
+  }
+  /* This thread's private RBG, the lock is never contended */
+  rng = thread_rng(1, &cache, &taad, &held);
+  if (NULL != rng) {
+    memset(buf,0,num);
+    aadl = aad_take(taad, &aad);
+    if (0 != aadl) {
+      /* The AAD has to influence this output, so bypass the cache */
+      cache_clear(cache);
+      state = RNG_Generate(rng, buf, num, aad, aadl);
+      aad_clear(taad);
+    } else {
+      state = cached_generate(cache, rng, buf, num);
+    }
+    ICC_UnlockMutex(held);
+    switch (state) {
+    case SP800_90RUN:
+    case SP800_90RESEED:
+      break;
+    default:
+      rc = RAND_R_PRNG_CRYPT_TEST_FAILED;
+      break;
+    }
+    goto cleanup;
+  }
+  if (batch_requests && (num > 0) && (num <= RNG_BATCH_SMALL)) {
+    rc = batch_rand_bytes(buf, num, tid);
+    goto cleanup;
+  }
+  lock_slot(&(tctx[tid].mtx), &(tctx[tid].waits));
   /* If it was never initialized  */
   if (NULL == tctx[tid].rng ) {
     rc = init_trng(tid);
   }
 
   if (rc == RAND_R_PRNG_OK) {
-    if (tctx[tid].bytes > 16) { /* Don't bother unless there's a decent amount of aad */
-      aad = tctx[tid].aad;
-      /* Pick up the TID as well, just to make sure the AAD fed to each
-               RNG does differ */
-      aadl = tctx[tid].bytes + 1;
-      tctx[tid].bytes = 0; /* Reset the aad accumulator state */
-      tctx[tid].index = 1;
-    }
+    /* Pick up the TID as well (aad[0]), just to make sure the AAD fed to each
+       RNG does differ */
+    aadl = aad_take(&(tctx[tid].aad), &aad);
     memset(buf,0,num);
-    state = RNG_Generate(tctx[tid].rng, buf, num, aad, aadl);
+    if (0 != aadl) {
+      /* The AAD has to influence this output, so bypass the cache */
+      cache_clear(&(tctx[tid].cache));
+      state = RNG_Generate(tctx[tid].rng, buf, num, aad, aadl);
+      aad_clear(&(tctx[tid].aad));
+    } else {
+      state = cached_generate(&(tctx[tid].cache), tctx[tid].rng, buf, num);
+    }
 
     switch (state) {
     case SP800_90RUN:
@@ -525,7 +1962,10 @@ static int fips_rand_pseudo_bytes(unsigned char *buf, int num) {
   int rc = RAND_R_PRNG_OK;
   SP800_90STATE state;
   int tid = 0;
-  tid = ICC_GetThreadId() % N_rngs;
+  PRNG_CTX *rng = NULL;
+  RNG_CACHE *cache = NULL;
+  ICC_Mutex *held = NULL;
+  tid = rng_slot();
 
   if ((status != INIT) ||
       (buf==NULL) ||
@@ -533,8 +1973,24 @@ static int fips_rand_pseudo_bytes(unsigned char *buf, int num) {
     rc=RAND_R_PRNG_INVALID_ARG; 
     goto cleanup;
   }
+  reseed_after_fork();
+  /* This thread's private DRBG, the lock is never contended */
+  rng = thread_rng(0, &cache, NULL, &held);
+  if (NULL != rng) {
+    state = cached_generate(cache, rng, buf, num);
+    ICC_UnlockMutex(held);
+    switch(state) {
+    case SP800_90RUN:
+    case SP800_90RESEED:
+      break;
+    default:
+      rc=RAND_R_PRNG_CRYPT_TEST_FAILED;
+      break;
+    }
+    goto cleanup;
+  }
 
-  ICC_LockMutex(&(pctx[tid].mtx));
+  lock_slot(&(pctx[tid].mtx), &(pctx[tid].waits));
 
   if( rc == RAND_R_PRNG_OK ) {
     if(NULL == pctx[tid].rng) {
@@ -542,7 +1998,7 @@ static int fips_rand_pseudo_bytes(unsigned char *buf, int num) {
     }
   }
  
-  state = RNG_Generate(pctx[tid].rng,buf,num,NULL,0);
+  state = cached_generate(&(pctx[tid].cache), pctx[tid].rng, buf, num);
 
   /* We could be in a RUN or RESEED state on return
    */
@@ -568,6 +2024,58 @@ cleanup:
   return rc;
 }
 
+/*! @brief Fill several buffers from the system wide PRNG pool, one
+  generate (one slot lock, one DRBG state update) for all of them
+  @param iov the buffers, in order
+  @param cnt entries in iov
+  @return 1 on success, 0 on failure
+  @note totals up to RAND_IOV_TMP bytes go through a stack buffer, 
+  larger ones are allocated. On failure every buffer is zeroed
+*/
+#define RAND_IOV_TMP 1024
+int RAND_FIPS_bytes_v(const ICC_RNG_IOV *iov, unsigned int cnt) {
+  unsigned char stmp[RAND_IOV_TMP];
+  unsigned char *tmp = stmp;
+  unsigned long long total = 0;
+  unsigned int off = 0;
+  unsigned int i = 0;
+  int rc = 0;
+
+  if ((NULL == iov) && (0 != cnt)) {
+    return 0;
+  }
+  for (i = 0; i < cnt; i++) {
+    if ((NULL == iov[i].buf) && (0 != iov[i].len)) {
+      return 0;
+    }
+    total += iov[i].len;
+  }
+  if (total > 0x7FFFFFFF) {
+    return 0;
+  }
+  if (total > sizeof(stmp)) {
+    tmp = (unsigned char *)ICC_Calloc(1, (size_t)total, __FILE__, __LINE__);
+    if (NULL == tmp) {
+      return 0;
+    }
+  }
+  rc = (1 == fips_rand_pseudo_bytes(tmp, (int)total)) ? 1 : 0;
+  for (i = 0; i < cnt; i++) {
+    if (0 != iov[i].len) {
+      if (rc) {
+        memcpy(iov[i].buf, tmp + off, iov[i].len);
+      } else {
+        memset(iov[i].buf, 0, iov[i].len);
+      }
+      off += iov[i].len;
+    }
+  }
+  memset(tmp, 0, (size_t)total);
+  if (tmp != stmp) {
+    ICC_Free(tmp);
+  }
+  return rc;
+}
 
 /* ------------------------------------- */
 static  int fips_rand_status(void){
@@ -575,6 +2083,89 @@ static  int fips_rand_status(void){
 }
 
 
+/*! @brief stop the reseed worker and the seed wait helper
+    @note the library is unloading, both touch the pools
+*/
+static void rand_threads_stop(void) {
+  int join = 0;
+
+  if (reseed_running) {
+    reseed_stop = 1;
+    /* In a fork() child the handle is the parent's, there's nothing to join */
+    if (reseed_gen == RNG_ForkGeneration()) {
+      ICC_JoinThread(&reseed_thr);
+    }
+    reseed_running = 0;
+  }
+  if (seedw_ok) {
+    ICC_LockMutex(&seedw_mtx);
+    join = seedw_running || seedw_join;
+    seedw_running = seedw_join = 0;
+    ICC_UnlockMutex(&seedw_mtx);
+    if (join && (seedw_gen == RNG_ForkGeneration())) {
+      ICC_JoinThread(&seedw_thr); /* Runs any callbacks still queued */
+    }
+  }
+}
+
+/*! @brief ICC_FAST_EXIT. Erase the system RNG's secret state at process 
+    exit, instead of fips_rand_cleanup().
+    The worker threads are stopped, then every DRBG, output cache and 
+    coalesced seed buffer is scrubbed in place. Nothing is freed and
+    no mutex is destroyed, so cold pages are only touched to erase them.
+    The RNG's fail from here on.
+    @note Other threads may still be calling in, each DRBG is scrubbed
+    under the lock it's used under, so a generate in progress finishes
+    first and anything after it fails. The TLS key is deleted, the 
+    per-thread blocks are left to the OS.
+*/
+void RAND_FIPS_Scrub(void) {
+  int i = 0;
+  THREAD_RNG *trng = NULL;
+
+  if (status != INIT) {
+    return;
+  }
+  status = FAIL;
+  rand_threads_stop();
+  if (thread_key_ok) {
+    thread_key_ok = 0; /* New requests use the (failed) pools */
+    ICC_LockMutex(&thread_mtx);
+    for (trng = thread_list; NULL != trng; trng = trng->next) {
+      ICC_LockMutex(&(trng->mtx));
+      cache_clear(&(trng->pcache));
+      cache_clear(&(trng->tcache));
+      aad_clear(&(trng->taad));
+      RNG_CTX_Scrub(trng->prng);
+      RNG_CTX_Scrub(trng->trng);
+      ICC_UnlockMutex(&(trng->mtx));
+    }
+    ICC_UnlockMutex(&thread_mtx);
+    /* No destructor may be left pointing into the library once it's
+       unmapped. This may call thread_rng_free() on some platforms 
+    */
+    ICC_DestroyThreadKey(&thread_key);
+  }
+  if (NULL != pctx) {
+    for (i = 0; i < N_alloc; i++) {
+      ICC_LockMutex(&(pctx[i].mtx));
+      cache_clear(&(pctx[i].cache));
+      RNG_CTX_Scrub(pctx[i].rng);
+      ICC_UnlockMutex(&(pctx[i].mtx));
+    }
+  }
+  if (NULL != tctx) {
+    for (i = 0; i < N_alloc; i++) {
+      ICC_LockMutex(&(tctx[i].mtx));
+      cache_clear(&(tctx[i].cache));
+      aad_clear(&(tctx[i].aad));
+      RNG_CTX_Scrub(tctx[i].rng);
+      ICC_UnlockMutex(&(tctx[i].mtx));
+    }
+  }
+  TRNG_ExitScrub();
+}
+
 /*! @brief cleanup the system RNG's
     Note that it's assumed locks are already held or irrelevant
     at this point.
@@ -582,8 +2173,20 @@ static  int fips_rand_status(void){
 static void fips_rand_cleanup(void) {
   int rc = RAND_R_PRNG_OK;
   int i = 0;
+
+  rand_threads_stop();
+  if (seedw_ok) {
+    ICC_DestroyMutex(&seedw_mtx);
+    seedw_ok = 0;
+  }
+  if (reseed_mtx_ok) {
+    ICC_DestroyMutex(&reseed_mtx);
+    reseed_mtx_ok = 0;
+  }
+  thread_rng_cleanup();
   if (NULL != pctx) {
-    for (i = 0; i < N_rngs; i++) {
+    for (i = 0; i < N_alloc; i++) {
+      cache_free(&(pctx[i].cache));
       if (NULL != pctx[i].rng) {
         RNG_CTX_free(pctx[i].rng);
         pctx[i].rng = NULL;
@@ -595,16 +2198,23 @@ static void fips_rand_cleanup(void) {
   }
   /* Free the TRNG's */
   if (NULL != tctx) {
-    for (i = 0; i < N_rngs; i++) {
+    for (i = 0; i < N_alloc; i++) {
+      cache_free(&(tctx[i].cache));
       if (NULL != tctx[i].rng) {
         RNG_CTX_free(tctx[i].rng);
         tctx[i].rng = NULL;
       }
       ICC_DestroyMutex(&(tctx[i].mtx));
+      ICC_DestroyMutex(&(tctx[i].bmtx));
     }
     ICC_Free(tctx);
     tctx = NULL;
   }
+  if (auto_rngs && (status == INIT)) {
+    ICC_DestroyMutex(&pool_mtx);
+  }
+  TRNG_StandbyCleanup();
+  TRNG_SharedCleanup();
   status = UNDEF;
 
   if (rc != RAND_R_PRNG_OK) {
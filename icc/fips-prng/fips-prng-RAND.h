@@ -27,6 +27,9 @@
 #define RAND_FIPS_MAX_SEED_BYTES FIPS_DSS_PRNG_MIN_SEED_BYTES
 
 
+/*! Passed to SetRNGInstances() to size the RNG pools automatically */
+#define RNG_INSTANCES_AUTO -1
+
 /* Prototypes of exported functions */
 /* ================================ */
 
@@ -53,7 +56,7 @@ RAND_METHOD *RAND_FIPS(void);
   @brief return the name of the PRNG ICC uses
   @return The name of the PRNG ICC uses
 */
-char *GetPRNGName();
+const char *GetPRNGName();
   
 /*!
   @brief set the global ICC PRNG
@@ -92,21 +95,161 @@ int SetTRNGName(char *trngname);
 */
 int RAND_FIPS_Entropy();
 
+/*!
+  @brief fill several buffers from the system wide PRNG pool in one generate
+  @param iov the buffers
+  @param cnt entries in iov
+  @return 1 on success, 0 on failure
+*/
+int RAND_FIPS_bytes_v(const ICC_RNG_IOV *iov, unsigned int cnt);
+
+/*!
+  @brief ICC_FAST_EXIT, erase the system RNG's secret state in place at 
+  process exit rather than freeing it
+  @note the RNG's are unusable afterwards
+*/
+void RAND_FIPS_Scrub(void);
+
 
 /*! 
   @brief return the number of RNG instances in use
 */
 int GetRNGInstances();
 
+/*!
+  @brief usage counts for each RNG pool slot and per thread RNG
+  @param out the caller's array, unused entries are zeroed
+  @param n entries in out
+*/
+void GetRNGStats(ICC_RNG_STAT *out, size_t n);
+
 /*!
   @brief set the global ICC TRNG
   @param instances The number of RNG instances (0 < X <= MAX)
   @return 1 on sucess, 0 otherwise
   @note this must be called before the first ICC_Attach() 
   - MAX is currently 256
+  - RNG_INSTANCES_AUTO sizes the pools from the online CPU count and
+    grows them at runtime under lock contention
 */
 int SetRNGInstances(int instances);
 
+/*! 
+  @brief return the state of the per-thread RNG mode
+  @return 1 if each thread gets it's own RNG's, 0 if the pools are in use
+*/
+int GetRNGPerThread();
+
+/*!
+  @brief give each thread it's own RNG's rather than sharing the pools
+  @param on 1 to enable, 0 to disable
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+  - The pools are still used if thread local storage isn't available
+*/
+int SetRNGPerThread(int on);
+
+/*! 
+  @brief return the size of the per-RNG output cache
+  @return the cache size in bytes, 0 if caching is disabled
+*/
+int GetRNGCache();
+
+/*!
+  @brief set the size of the per-RNG output cache
+  @param bytes the cache size, 0 to disable, up to 16384
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach(). 
+  Requests of 64 bytes or less are then served from the cache
+*/
+int SetRNGCache(int bytes);
+
+/*! 
+  @brief return the RAND_seed() coalescing mode
+  @return 1 if caller seed data is folded into the next generate, 0 otherwise
+*/
+int GetRNGSeedCoalesce();
+
+/*!
+  @brief fold RAND_seed() data into the seed DRBG's next generate as 
+  additional input rather than reseeding from the NRBG on every call
+  @param on 1 to enable, 0 to disable
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+  - RAND_seed(NULL,0) still forces a reseed
+*/
+int SetRNGSeedCoalesce(int on);
+
+/*! 
+  @brief return the number of threads used to fill large requests
+  @return the thread count, 0 if parallel fill is disabled
+*/
+int GetRNGParallel();
+
+/*!
+  @brief split RAND_bytes() requests of 1MB or more across this many 
+  pool DRBG's, each filling it's segment on it's own thread
+  @param threads 0 or 1 to disable, up to 64
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+*/
+int SetRNGParallel(int threads);
+
+/*!
+  @brief fill buf from the seed pools without waiting on the NRBG
+  @param buf the buffer to fill
+  @param num the number of bytes
+  @param cb called from another thread when a retry should succeed, may be NULL
+  @param arg passed to cb
+  @return ICC_SEED_READY, ICC_SEED_WOULDBLOCK or ICC_SEED_FAILED
+*/
+int fips_rand_try_bytes(unsigned char *buf, int num, void (*cb)(void *arg), void *arg);
+
+/*! 
+  @brief return the request batching mode
+  @return 1 if small concurrent requests share a generate, 0 otherwise
+*/
+int GetRNGBatch();
+
+/*!
+  @brief let small RAND_bytes() requests that arrive while their seed DRBG 
+  is busy be served together by one generate
+  @param on 1 to enable, 0 to disable
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+*/
+int SetRNGBatch(int on);
+
+/*! 
+  @brief return the pool slot mapping
+  @return 1 if callers use a slot on their own CPU's NUMA node, 0 otherwise
+*/
+int GetRNGNuma();
+
+/*!
+  @brief map callers to pool slots by the CPU and NUMA node they run on
+  rather than by thread id
+  @param on 1 to enable, 0 to disable
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+*/
+int SetRNGNuma(int on);
+
+/*! 
+  @brief return the state of the background reseed worker
+  @return 1 if requested (before init) or running, 0 otherwise
+*/
+int GetRNGReseedThread();
+
+/*!
+  @brief enable a worker thread which gathers entropy ahead of 
+  DRBG reseeds, so requests don't block on the NRBG
+  @param on 1 to enable, 0 to disable
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach() 
+*/
+int SetRNGReseedThread(int on);
+
 
 
 #endif /* HEADER_FIPS_PRNG_RAND_H */
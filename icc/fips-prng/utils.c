@@ -13,6 +13,7 @@
 *************************************************************************/
 
 
+#include <string.h>
 #include "utils.h"
 
 #if defined(STANDALONE)
@@ -242,6 +243,49 @@ void Add_LE(unsigned char *dest,
 }
 
 
+/* 64 bit big endian loads/stores, used here and by the SP800-38F
+   key wrap rounds. On little endian targets these compile to a 
+   load/store and a byte swap instruction.
+*/
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define BSWAP64(x) __builtin_bswap64(x)
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define BSWAP64(x) (x)
+#elif defined(_MSC_VER)
+#include <stdlib.h>
+#define BSWAP64(x) _byteswap_uint64(x)
+#endif
+
+#if defined(BSWAP64)
+unsigned long long load_be64(const unsigned char *p)
+{
+  unsigned long long v;
+  memcpy(&v,p,8);
+  return BSWAP64(v);
+}
+void store_be64(unsigned char *p,unsigned long long v)
+{
+  v = BSWAP64(v);
+  memcpy(p,&v,8);
+}
+#else
+unsigned long long load_be64(const unsigned char *p)
+{
+  return ((unsigned long long)p[0] << 56) | ((unsigned long long)p[1] << 48) |
+         ((unsigned long long)p[2] << 40) | ((unsigned long long)p[3] << 32) |
+         ((unsigned long long)p[4] << 24) | ((unsigned long long)p[5] << 16) |
+         ((unsigned long long)p[6] << 8)  |  (unsigned long long)p[7];
+}
+void store_be64(unsigned char *p,unsigned long long v)
+{
+  int i;
+  for(i = 7; i >= 0; i--) {
+    p[i] = (unsigned char)(v & 0xff);
+    v >>= 8;
+  }
+}
+#endif
+
 /*!
   @brief  Binary add src1 + src2 result in dest
   Numbers are assumed big endian.
@@ -253,28 +297,63 @@ void Add_LE(unsigned char *dest,
   @param s2 length of src2
   @note s2 may be set to 0, in which case s1 is used for s2.
   s2 = 1 and src->0, A single "1" byte is typical for an increment.
+  - src2 is tail aligned with src1, if longer only it's last s1 bytes count
+  - Works 64 bits at a time from the least significant end and stops 
+    as soon as src2 is used up and there's no carry, so an increment
+    on a 55 or 111 byte DRBG counter is usually one word operation.
 */
 void Add_BE(unsigned char *dest,
 	 unsigned char *src1,unsigned int s1, 
 	 unsigned char *src2,unsigned int s2)
 {
-  unsigned int t = 0,t1 = 0,t2 = 0;
-  int i = 0;
+  unsigned long long a = 0, b = 0, r = 0;
+  unsigned int t = 0;
   unsigned int cy = 0;
+  unsigned int n = s1;
+  unsigned int k = 0;
+
   if(0 == s2) s2 = s1;
-  
-  for(i = 1; i <= (int)s1 ; i++) {
-    t1 = src1[s1-i];
-    t2 = 0;
-    if( ((int)s2 - i) >= 0) {
-      t2 = src2[s2 - i];
+  if(s2 > s1) {
+    src2 += s2 - s1;
+    s2 = s1;
+  }
+  while(n >= 8) {
+    if((0 == s2) && (0 == cy)) {
+      break;
     }
-    t = t1 + t2 + cy;     
-    cy = 0;
-    if(t > 255 ) {
-      cy = 1;
+    n -= 8;
+    a = load_be64(src1 + n);
+    if(s2 >= 8) {
+      s2 -= 8;
+      b = load_be64(src2 + s2);
+    } else {
+      for(b = 0, k = 0; k < s2; k++) {
+        b = (b << 8) | src2[k];
+      }
+      s2 = 0;
     }
-    dest[s1-i] = t & 0xff;
+    r = a + b;
+    t = (r < a) ? 1 : 0;
+    r += cy;
+    cy = t | ((cy && (0 == r)) ? 1 : 0);
+    store_be64(dest + n, r);
+  }
+  /* Leftover high order bytes */
+  while(n > 0) {
+    if((0 == s2) && (0 == cy)) {
+      break;
+    }
+    n--;
+    t = src1[n] + cy;
+    if(s2 > 0) {
+      t += src2[--s2];
+    }
+    cy = (t > 255) ? 1 : 0;
+    dest[n] = t & 0xff;
+  }
+  /* Nothing left to add, just copy anything untouched */
+  if((n > 0) && (dest != src1)) {
+    memmove(dest,src1,n);
   }
 }
 
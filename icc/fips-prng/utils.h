@@ -22,6 +22,11 @@ void Add_BE(unsigned char *dest,
 	    unsigned char *src1,unsigned int s1, 
 	    unsigned char *src2,unsigned int s2);
 
+/*! @brief Load 8 bytes as a big endian 64 bit number */
+unsigned long long load_be64(const unsigned char *p);
+/*! @brief Store a 64 bit number as 8 big endian bytes */
+void store_be64(unsigned char *p,unsigned long long v);
+
 /* Assume the NIST spec uses a Big Endian representation of bit streams */
 #define Add(a,b,c,d,e) Add_BE(a,b,c,d,e)
 
@@ -836,6 +836,39 @@ static const unsigned char cmac_ka[] = {
   0xbd,0x4b,0xf2,0x8d,0x8c,0x37,0xc3,0x5c
 };
 
+/** \known Data: (kmac_ka_key) KMAC key, SP800-185 samples, used for all KMAC's */
+static const unsigned char kmac_ka_key[] = {
+  0x40,0x41,0x42,0x43,0x44,0x45,0x46,0x47,
+  0x48,0x49,0x4a,0x4b,0x4c,0x4d,0x4e,0x4f,
+  0x50,0x51,0x52,0x53,0x54,0x55,0x56,0x57,
+  0x58,0x59,0x5a,0x5b,0x5c,0x5d,0x5e,0x5f
+};
+/** \known Data: (kmac_ka_data) KMAC input */
+static const unsigned char kmac_ka_data[] = {
+  0x00,0x01,0x02,0x03
+};
+/** \known Data: KMAC customization string */
+static const char kmac_ka_S[] = "My Tagged Application";
+
+/** \known Data: (kmac128_ka) KMAC128 output, SP800-185 sample 2 */
+static const unsigned char kmac128_ka[] = {
+  0x3b,0x1f,0xba,0x96,0x3c,0xd8,0xb0,0xb5,
+  0x9e,0x8c,0x1a,0x6d,0x71,0x88,0x8b,0x71,
+  0x43,0x65,0x1a,0xf8,0xba,0x0a,0x70,0x70,
+  0xc0,0x97,0x9e,0x28,0x11,0x32,0x4a,0xa5
+};
+/** \known Data: (kmac256_ka) KMAC256 output, SP800-185 sample 4 */
+static const unsigned char kmac256_ka[] = {
+  0x20,0xc5,0x70,0xc3,0x13,0x46,0xf7,0x03,
+  0xc9,0xac,0x36,0xc6,0x1c,0x03,0xcb,0x64,
+  0xc3,0x97,0x0d,0x0c,0xfc,0x78,0x7e,0x9b,
+  0x79,0x59,0x9d,0x27,0x3a,0x68,0xd2,0xf7,
+  0xf6,0x9d,0x4c,0xc3,0xde,0x9d,0x10,0x4a,
+  0x35,0x16,0x89,0xf2,0x7c,0xf6,0xf5,0x95,
+  0x1f,0x01,0x03,0xf3,0x3f,0x4f,0x24,0x87,
+  0x10,0x24,0xd9,0xc2,0x77,0x73,0xa8,0xdd
+};
+
 #if defined(KNOWN) 
 /** \known Data. OpenSSL curve name corresponding to NIST B-233  
     for binary field KAT
@@ -1191,6 +1224,19 @@ static const unsigned char SHAKE128_CT[128] = {
     0x06, 0xBA, 0x31, 0x14, 0x53, 0xC2, 0x12, 0x35, 0x1C, 0xFF, 0xB0, 0x4A,
     0x94, 0xA2, 0x9A, 0xF0, 0x62, 0x2C, 0x3F, 0x49
 };
+/** \known Data: ParallelHash128, SP800-185 sample 2, B = 8, S = "Parallel Data"
+*/
+static const unsigned char PHASH128_in[24] = {
+  0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,
+  0x10,0x11,0x12,0x13,0x14,0x15,0x16,0x17,
+  0x20,0x21,0x22,0x23,0x24,0x25,0x26,0x27
+};
+static const unsigned char PHASH128_ka[32] = {
+  0xfc,0x48,0x4d,0xcb,0x3f,0x84,0xdc,0xee,
+  0xdc,0x35,0x34,0x38,0x15,0x1b,0xee,0x58,
+  0x15,0x7d,0x6e,0xfe,0xd0,0x44,0x5a,0x81,
+  0xf1,0x65,0xe4,0x95,0x79,0x5b,0x72,0x06
+};
 /** \known Data: TLS1 KDF
  * inputs are 'secret' and 'salt' non-0 terminated
  */
@@ -2004,6 +2050,7 @@ static int iccTestTLS_KDF(ICC_STATUS *stat,const EVP_MD *digest, unsigned char *
 
   unsigned char out[16] = {0,0,0,0,0,0,0,0,0,0,0,00,0,0,0,0};
   EVP_PKEY_CTX *kctx = NULL;
+  TLS_PRF_CTX *pctx = NULL;
   size_t outlen = 16;
   IN();
   kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF,NULL);
@@ -2016,6 +2063,17 @@ static int iccTestTLS_KDF(ICC_STATUS *stat,const EVP_MD *digest, unsigned char *
     EVP_PKEY_CTX_free(kctx);
     iccCheckKnownAnswer(out,explen,expected,explen,stat,__FILE__,__LINE__,"TLS KDF",""); 
   }
+  /* and the context ICC_TLS_PRF_Init()/ICC_TLS_PRF_KeyBlock() use */
+  if(ICC_OK == stat->majRC) {
+    memset(out,0,sizeof(out));
+    pctx = TLS_PRF_CTX_new();
+    if(NULL != pctx) {
+      (void)TLS_PRF_Init(pctx,digest,secret,seclen);
+      (void)TLS_PRF_Derive(pctx,seed,seedlen,NULL,0,NULL,0,out,explen);
+      TLS_PRF_CTX_free(pctx);
+    }
+    iccCheckKnownAnswer(out,explen,expected,explen,stat,__FILE__,__LINE__,"TLS PRF",""); 
+  }
   OUTRC(stat->majRC);       
   return stat->majRC;
 }
@@ -2903,6 +2961,94 @@ int iccECKEYPairTest(ICClib *iccLib, EC_KEY *eckey)
 
   return rv;
 }
+
+/**
+   @brief Continuous EC key pair test for key agreement keys
+   The public key is recomputed from the private key, Q' = d.G, and 
+   compared with Q. FIPS 140-3 IG 10.3.A allows this in place of a 
+   sign/verify for keys that are only used for key agreement.
+   @param iccLib internal ICC context
+   @param eckey key PAIR, flagged with ICC_EC_FLAG_KEY_AGREEMENT
+   @return ICC_OK if the test passed. ICC_ERROR if it didn't.
+   @note This is called when a new EC key agreement key is created
+   \known Continuous Test: ECC key agreement key consistancy
+*/
+int iccECKEYRegenTest(ICClib *iccLib, EC_KEY *eckey)
+{
+  int rv = ICC_ERROR;
+  const EC_GROUP *grp = NULL;
+  const BIGNUM *d = NULL;
+  const EC_POINT *q = NULL;
+  EC_POINT *qq = NULL;
+  BN_CTX *ctx = NULL;
+
+  grp = EC_KEY_get0_group(eckey);
+  d = EC_KEY_get0_private_key(eckey);
+  q = EC_KEY_get0_public_key(eckey);
+  if((NULL != grp) && (NULL != d) && (NULL != q)) {
+    ctx = BN_CTX_new();
+    qq = EC_POINT_new(grp);
+    if((NULL != ctx) && (NULL != qq)) {
+      if(1 == EC_POINT_mul(grp,qq,d,NULL,NULL,ctx)) {
+        if( 82 == icc_failure ) {
+          EC_POINT_invert(grp,qq,ctx);
+        }
+        if(0 == EC_POINT_cmp(grp,qq,q,ctx)) {
+          rv = ICC_OK;
+        }
+      }
+      if(ICC_OK != rv) {
+        /*  disable ICC when an error doing the known answer        */
+        SetFatalError("EC key agreement key consistency test failed",__FILE__,__LINE__);
+      }
+    }
+    EC_POINT_free(qq);
+    BN_CTX_free(ctx);
+  }
+  return rv;
+}
+/**
+   @brief Continuous X25519/X448 key pair test
+   The public key is recomputed from the private key and compared, 
+   as iccECKEYRegenTest() does for key agreement keys on other curves.
+   @param iccLib internal ICC context
+   @param pkey key PAIR, EVP_PKEY_X25519 or EVP_PKEY_X448
+   @return ICC_OK if the test passed. ICC_ERROR if it didn't.
+   @note This is called when a pooled ephemeral key is created
+   \known Continuous Test: X25519/X448 key consistancy
+*/
+int iccECXKEYRegenTest(ICClib *iccLib, EVP_PKEY *pkey)
+{
+  int rv = ICC_ERROR;
+  unsigned char priv[64];
+  unsigned char pub[64];
+  unsigned char pub2[64];
+  size_t privlen = sizeof(priv);
+  size_t publen = sizeof(pub);
+  size_t publen2 = sizeof(pub2);
+  EVP_PKEY *tpk = NULL;
+
+  if((1 == EVP_PKEY_get_raw_private_key(pkey,priv,&privlen)) &&
+     (1 == EVP_PKEY_get_raw_public_key(pkey,pub,&publen))) {
+    tpk = EVP_PKEY_new_raw_private_key(EVP_PKEY_id(pkey),NULL,priv,privlen);
+    if((NULL != tpk) && 
+       (1 == EVP_PKEY_get_raw_public_key(tpk,pub2,&publen2))) {
+      if( 83 == icc_failure ) {
+        pub2[0] = ~pub2[0];
+      }
+      if((publen == publen2) && (0 == memcmp(pub,pub2,publen))) {
+        rv = ICC_OK;
+      }
+      if(ICC_OK != rv) {
+        /*  disable ICC when an error doing the known answer        */
+        SetFatalError("X25519/X448 key consistency test failed",__FILE__,__LINE__);
+      }
+    }
+    EVP_PKEY_free(tpk);
+  }
+  OPENSSL_cleanse(priv,sizeof(priv));
+  return rv;
+}
 /** @brief NIST internal key consistancy check for RSA keys
     @param iccLib ICC internal context
     @param rsa to verify. Newly generated key pair - contains both public and private keys
@@ -3326,7 +3472,7 @@ static void iccHMACTest(ICClib *iccLib,
     }
   }
   if(ICC_OK == icc_stat->majRC) {
-    my_HMAC_Init(hmac_ctx,Key,keylen,digest);
+    HMAC_Init_ex(hmac_ctx,Key,keylen,digest,NULL);
     /** \induced 101.  HMAC-SHA1 
 	Corrupt the known data
     */
@@ -3442,6 +3588,57 @@ static void iccCMACTest(ICClib *iccLib,
   memset(Result,0,sizeof(Result));
   OUT();
 }
+/** @brief KMAC known answer test, through a key state so the
+    handle used by KMAC_KEY_Sign() is what's tested
+    @param iccLib ICC internal context
+    @param icc_stat error status
+    @param digestname SHAKE128 for KMAC128, SHAKE256 for KMAC256
+    @param Expected the known answer for kmac_ka_data
+    @param explen the MAC length
+*/
+static void iccKMACTest(ICClib *iccLib,
+                        ICC_STATUS *icc_stat,
+                        char *digestname,
+                        const unsigned char *Expected,
+                        int explen
+                        )
+{
+  KMAC_KEY *kk = NULL;
+  const EVP_MD *md = NULL;
+  unsigned char Result[64];
+  IN();
+  md = EVP_get_digestbyname(digestname);
+  if( md == NULL) {
+    SetStatusLn2(iccLib,icc_stat,ICC_ERROR,ICC_INCOMPATIBLE_LIBRARY,
+		 ICC_NO_ALG_FOUND,digestname,__FILE__,__LINE__);
+  }
+  if(ICC_OK == icc_stat->majRC) {
+    kk = KMAC_KEY_new();
+    if( kk == NULL) {
+      SetStatusMem(iccLib,icc_stat,__FILE__,__LINE__);
+    }
+  }
+  if(ICC_OK == icc_stat->majRC) {
+    memset(Result,0,sizeof(Result));
+    if((1 != KMAC_KEY_Init(kk,md,kmac_ka_key,sizeof(kmac_ka_key),
+                           (const unsigned char *)kmac_ka_S,strlen(kmac_ka_S))) ||
+       (1 != KMAC_KEY_Sign(kk,kmac_ka_data,sizeof(kmac_ka_data),Result,explen))) {
+      SetStatusLn(NULL,icc_stat,FATAL_ERROR,ICC_LIBRARY_VERIFICATION_FAILED,
+                  "KMAC failed",__FILE__,__LINE__);
+    }
+    KMAC_KEY_free(kk);
+  }
+  if(ICC_OK == icc_stat->majRC) {
+#if defined(KNOWN)
+    printf("KMAC %s known answer\n",digestname);
+    iccPrintBytes(Result,explen);
+#endif
+    iccCheckKnownAnswer(Result,explen, Expected,explen,
+			icc_stat,__FILE__,__LINE__,"KMAC",digestname);
+  }
+  memset(Result,0,sizeof(Result));
+  OUT();
+}
 /** @brief NIST internal key consistancy check for AES-CCM
     @param iccLib ICC internal context
     @param icc_stat error status  
@@ -3793,6 +3990,15 @@ unsigned char *my_HKDF_Extract(const EVP_MD *evp_md,
                             const unsigned char *key, size_t key_len,
                             unsigned char *prk, size_t *prk_len);
 
+HKDF_CTX *HKDF_CTX_new(void);
+void HKDF_CTX_free(HKDF_CTX *ctx);
+int HKDF_CTX_Extract(ICClib *pcb,HKDF_CTX *ctx,const EVP_MD *evp_md,
+                     const unsigned char *salt, size_t salt_len,
+                     const unsigned char *key, size_t key_len);
+unsigned char *HKDF_CTX_Expand(ICClib *pcb,HKDF_CTX *ctx,
+                               const unsigned char *info, size_t info_len,
+                               unsigned char *okm, size_t okm_len);
+
 static void iccHKDFTest(ICC_STATUS *status,
   const char *digest,
   const unsigned char *ikm, int keyLen, const unsigned char *salt,int saltLen, const unsigned char *data, int dataLen, 
@@ -3802,6 +4008,8 @@ static void iccHKDFTest(ICC_STATUS *status,
   unsigned char my_prk[EVP_MAX_MD_SIZE];
   unsigned char *my_okm = NULL;
   size_t my_prkLen = 0;
+  HKDF_CTX *hctx = NULL;
+  int i = 0;
   IN();
   memset(my_prk,0,EVP_MAX_MD_SIZE);
   my_okm = (unsigned char *)ICC_Calloc(1,okLen,__FILE__,__LINE__);
@@ -3823,6 +4031,24 @@ static void iccHKDFTest(ICC_STATUS *status,
     iccCheckKnownAnswer(my_okm,okLen,ref_okm,okLen,status,
 			__FILE__,__LINE__,digest,"HKDF_Expand");
   }
+  /* The context path ICC_HKDF_CTX_Expand() uses, 
+     the second expand checks the keyed state survives the first 
+  */
+  if(status->majRC == ICC_OK) {
+    hctx = HKDF_CTX_new();
+    if((NULL == hctx) || 
+       (1 != HKDF_CTX_Extract(NULL,hctx,md,salt,saltLen,ikm,keyLen))) {
+      SetStatusLn2(NULL,status,FATAL_ERROR,ICC_LIBRARY_VERIFICATION_FAILED,
+		   ICC_NO_ALG_FOUND,digest,__FILE__,__LINE__); 
+    }
+    for(i = 0; (i < 2) && (status->majRC == ICC_OK); i++) {
+      memset(my_okm,0,okLen);
+      HKDF_CTX_Expand(NULL,hctx,data,dataLen,my_okm,okLen);
+      iccCheckKnownAnswer(my_okm,okLen,ref_okm,okLen,status,
+			  __FILE__,__LINE__,digest,"HKDF_CTX_Expand");
+    }
+    HKDF_CTX_free(hctx);
+  }
   ICC_Free(my_okm);
   OUT();
 }
@@ -3880,6 +4106,8 @@ static void iccChaChaPolyTest(ICC_STATUS *status,
   - The ICC implementation runs the self test at all strengths 
   for each PRNG type when that type is instantiated so 
   we don't need to loop through at each strength again here.
+  - With ICC_RNG_LAZY_TEST only the system DRBG type is tested here, 
+  the others are tested on their first instantiation.
   @param ctx an ICC library context
   @param status an ICC_STATUS structure
 */
@@ -3905,6 +4133,8 @@ static void iccSP800_90Test(ICClib *ctx,ICC_STATUS *status)
   for(i = 0; (NULL != Fips_list[i]) && (ICC_OK == status->majRC) ; i++) {
     /* The NRBG's test taps don't have deterministic tests */
     if(NULL != strstr(Fips_list[i],"TRNG")) continue;
+    /* Deferred, the self test runs when the type is first used */
+    if(GetRNGLazyTest() && (0 != strcmp(Fips_list[i],GetPRNGName()))) continue;
 
     prng = get_RNGbyname(Fips_list[i],1);
     if(NULL == prng) {
@@ -4007,7 +4237,8 @@ static void iccPBKDF2Test(ICC_STATUS *status,
   }
 
   if(ICC_OK == status->majRC) { 
-    PKCS5_PBKDF2_HMAC(pwd,pwdlen,salt,saltlen,iters,md,keylen,my_key);
+    /* The implementation ICC_PKCS5_PBKDF2_HMAC() uses */
+    PBKDF2_HMAC(pwd,pwdlen,salt,saltlen,iters,md,keylen,my_key);
     iccCheckKnownAnswer((unsigned char *)ref_key,keylen,my_key,keylen,status,
 		  	__FILE__,__LINE__,digest,"PKCS5_PBKDF2_HMAC");
   }
@@ -4417,9 +4648,11 @@ static int DoSigTests(ICClib *pcb, ICC_STATUS *stat)
       - PBKDF2
       @param iccLib ICC internal context
       @param icc_stat error return
+      @param groups a mask of KA_GROUP_ values, the groups share no
+      state so they can run concurrently on separate statuses
       \FIPS Known answer tests are carried out here.
   */
-void iccDoKnownAnswer(ICClib * iccLib, ICC_STATUS * icc_stat) {
+void iccDoKnownAnswerGroups(ICClib * iccLib, ICC_STATUS * icc_stat, int groups) {
   unsigned char digest[256];
   unsigned digestL = 0;
   RSA *rsaKey = NULL;
@@ -4445,7 +4678,7 @@ void iccDoKnownAnswer(ICClib * iccLib, ICC_STATUS * icc_stat) {
   {
 
     SetStatusOK(iccLib, icc_stat);
-    if (ICC_OK == icc_stat->majRC)
+    if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_SIG))
     {
       if (insecure_rand_meth.bytes != NULL)
       {
@@ -4456,565 +4689,697 @@ void iccDoKnownAnswer(ICClib * iccLib, ICC_STATUS * icc_stat) {
         DoSigTests(iccLib, icc_stat);
       }
     }
+    if (groups & ~KA_GROUP_SIG)
+    {
 #if defined(KNOWN)
-    GenerateKAData(iccLib, icc_stat);
+      GenerateKAData(iccLib, icc_stat);
 #endif
 
-    ibuf = (unsigned char *)ICC_Malloc(SCRATCH_SIZE, __FILE__, __LINE__);
-    signature = (unsigned char *)ICC_Malloc(SCRATCH_SIZE, __FILE__, __LINE__);
+      ibuf = (unsigned char *)ICC_Malloc(SCRATCH_SIZE, __FILE__, __LINE__);
+      signature = (unsigned char *)ICC_Malloc(SCRATCH_SIZE, __FILE__, __LINE__);
 
-    rsaPkey = EVP_PKEY_new();
+      rsaPkey = EVP_PKEY_new();
 
-    /** \induced 60. Memory allocation failure in self test code. (Out of
-   * memory)
-   */
-    if (60 == icc_failure)
-    {
-      EVP_PKEY_free(rsaPkey);
-      rsaPkey = NULL;
-    }
-
-    if ((NULL == signature) || (NULL == rsaPkey) || (NULL == ibuf))
-    {
-      SetStatusMem(iccLib, icc_stat, (char *)__FILE__, __LINE__);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** Cycle the system RNG twice */
-      MARK("SelfTest", "fips_rand_bytes 1");
-      if (ICC_OSSL_SUCCESS != fips_rand_bytes(ibuf, 80))
+      /** \induced 60. Memory allocation failure in self test code. (Out of
+     * memory)
+     */
+      if (60 == icc_failure)
       {
-        SetStatusLn(NULL, &(Global.status), ICC_ERROR | ICC_FATAL,
-                    ICC_LIBRARY_VERIFICATION_FAILED, "RNG failure", __FILE__,
-                    __LINE__);
+        EVP_PKEY_free(rsaPkey);
+        rsaPkey = NULL;
       }
-      MARK("SelfTest", "fips_rand_bytes 2");
-      if (ICC_OSSL_SUCCESS != fips_rand_bytes(ibuf, 80))
+
+      if ((NULL == signature) || (NULL == rsaPkey) || (NULL == ibuf))
       {
-        SetStatusLn(NULL, &(Global.status), ICC_ERROR | ICC_FATAL,
-                    ICC_LIBRARY_VERIFICATION_FAILED, "RNG failure", __FILE__,
-                    __LINE__);
+        SetStatusMem(iccLib, icc_stat, (char *)__FILE__, __LINE__);
       }
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: SHA1 digest test with known input and output
-        @note This isn't strictly needed as the library verification test
-       also validates this but the time taken is so short that it may as
-       well be done anyway.
-    */
-      iccDigest(iccLib, (unsigned char *)in, sizeof(in), digest, &digestL, "SHA1",
-                icc_stat);
-      p1 = sha1_ka;
-      /* make sure known answer is correct                     */
-      /** \induced 12. SHA-1 digest test, wrong known answer
-     */
-      if (12 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CORE))
       {
-        memcpy(ibuf, sha1_ka, sizeof(sha1_ka));
-        ibuf[sizeof(sha1_ka) - 1] ^= 0x01;
-        p1 = (const unsigned char *)ibuf;
+        /** Cycle the system RNG twice */
+        MARK("SelfTest", "fips_rand_bytes 1");
+        if (ICC_OSSL_SUCCESS != fips_rand_bytes(ibuf, 80))
+        {
+          SetStatusLn(NULL, &(Global.status), ICC_ERROR | ICC_FATAL,
+                      ICC_LIBRARY_VERIFICATION_FAILED, "RNG failure", __FILE__,
+                      __LINE__);
+        }
+        MARK("SelfTest", "fips_rand_bytes 2");
+        if (ICC_OSSL_SUCCESS != fips_rand_bytes(ibuf, 80))
+        {
+          SetStatusLn(NULL, &(Global.status), ICC_ERROR | ICC_FATAL,
+                      ICC_LIBRARY_VERIFICATION_FAILED, "RNG failure", __FILE__,
+                      __LINE__);
+        }
       }
-      if (ICC_OK == icc_stat->majRC)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CORE))
       {
-        iccCheckKnownAnswer(digest, digestL, p1, sizeof(sha1_ka), icc_stat,
-                            __FILE__, __LINE__, "HASH", "SHA1");
+        /** \known Test: SHA1 digest test with known input and output
+          @note This isn't strictly needed as the library verification test
+         also validates this but the time taken is so short that it may as
+         well be done anyway.
+      */
+        iccDigest(iccLib, (unsigned char *)in, sizeof(in), digest, &digestL, "SHA1",
+                  icc_stat);
+        p1 = sha1_ka;
+        /* make sure known answer is correct                     */
+        /** \induced 12. SHA-1 digest test, wrong known answer
+       */
+        if (12 == icc_failure)
+        {
+          memcpy(ibuf, sha1_ka, sizeof(sha1_ka));
+          ibuf[sizeof(sha1_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        if (ICC_OK == icc_stat->majRC)
+        {
+          iccCheckKnownAnswer(digest, digestL, p1, sizeof(sha1_ka), icc_stat,
+                              __FILE__, __LINE__, "HASH", "SHA1");
+        }
       }
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: SHA256 digest test with known input and output */
-      iccDigest(iccLib, (unsigned char *)in, sizeof(in), digest, &digestL,
-                "SHA256", icc_stat);
-      /* make sure known answer is correct                     */
-      p1 = sha256_ka;
-      /** \induced 14. SHA-256 digest test, wrong known answer
-     */
-      if (14 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CORE))
       {
-        memcpy(ibuf, sha256_ka, sizeof(sha256_ka));
-        ibuf[sizeof(sha256_ka) - 1] ^= 0x01;
-        p1 = (const unsigned char *)ibuf;
+        /** \known Test: SHA256 digest test with known input and output */
+        iccDigest(iccLib, (unsigned char *)in, sizeof(in), digest, &digestL,
+                  "SHA256", icc_stat);
+        /* make sure known answer is correct                     */
+        p1 = sha256_ka;
+        /** \induced 14. SHA-256 digest test, wrong known answer
+       */
+        if (14 == icc_failure)
+        {
+          memcpy(ibuf, sha256_ka, sizeof(sha256_ka));
+          ibuf[sizeof(sha256_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        if (ICC_OK == icc_stat->majRC)
+        {
+          iccCheckKnownAnswer(digest, digestL, p1, sizeof(sha256_ka), icc_stat,
+                              __FILE__, __LINE__, "HASH", "SHA256");
+        }
       }
-      if (ICC_OK == icc_stat->majRC)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CORE))
       {
-        iccCheckKnownAnswer(digest, digestL, p1, sizeof(sha256_ka), icc_stat,
-                            __FILE__, __LINE__, "HASH", "SHA256");
+        /** \known Test: SHA256 multi-buffer digest, 5 copies of the
+            SHA256 known input so both lane groups are used */
+        DIGEST_REC drecs[5];
+        unsigned char dout[5][32];
+        int k;
+
+        memset(drecs, 0, sizeof(drecs));
+        for (k = 0; k < 5; k++)
+        {
+          drecs[k].in = (const unsigned char *)in;
+          drecs[k].inlen = sizeof(in);
+          drecs[k].out = dout[k];
+        }
+        if (1 != DIGEST_Multi(EVP_get_digestbyname("SHA256"), drecs, 5))
+        {
+          SetStatusLn(NULL, icc_stat, FATAL_ERROR, ICC_LIBRARY_VERIFICATION_FAILED,
+                      "SHA256 multi-buffer digest failed", __FILE__, __LINE__);
+        }
+        p1 = sha256_ka;
+        /** \induced 15. SHA-256 multi-buffer digest test, wrong known answer
+       */
+        if (15 == icc_failure)
+        {
+          memcpy(ibuf, sha256_ka, sizeof(sha256_ka));
+          ibuf[sizeof(sha256_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        for (k = 0; (k < 5) && (ICC_OK == icc_stat->majRC); k++)
+        {
+          iccCheckKnownAnswer(dout[k], sizeof(dout[k]), p1, sizeof(sha256_ka), icc_stat,
+                              __FILE__, __LINE__, "HASH", "SHA256 multi-buffer");
+        }
       }
-    }
 
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: SHA512 digest test with known input and output  */
-      iccDigest(iccLib, (unsigned char *)in, sizeof(in), digest, &digestL,
-                "SHA512", icc_stat);
-      /* make sure known answer is correct                     */
-      p1 = sha512_ka;
-      /** \induced 16. SHA-512 digest test, wrong known answer
-     */
-      if (16 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CORE))
       {
-        memcpy(ibuf, sha512_ka, sizeof(sha512_ka));
-        ibuf[sizeof(sha512_ka) - 1] ^= 0x01;
-        p1 = (const unsigned char *)ibuf;
+        /** \known Test: SHA512 digest test with known input and output  */
+        iccDigest(iccLib, (unsigned char *)in, sizeof(in), digest, &digestL,
+                  "SHA512", icc_stat);
+        /* make sure known answer is correct                     */
+        p1 = sha512_ka;
+        /** \induced 16. SHA-512 digest test, wrong known answer
+       */
+        if (16 == icc_failure)
+        {
+          memcpy(ibuf, sha512_ka, sizeof(sha512_ka));
+          ibuf[sizeof(sha512_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        if (ICC_OK == icc_stat->majRC)
+        {
+          iccCheckKnownAnswer(digest, digestL, p1, sizeof(sha512_ka), icc_stat,
+                              __FILE__, __LINE__, "HASH", "SHA512");
+        }
       }
-      if (ICC_OK == icc_stat->majRC)
+
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CORE))
       {
-        iccCheckKnownAnswer(digest, digestL, p1, sizeof(sha512_ka), icc_stat,
-                            __FILE__, __LINE__, "HASH", "SHA512");
+        /** \known Test: SHA512 digest test with known input and output  */
+        iccDigest(iccLib, (unsigned char *)in, sizeof(in), digest, &digestL,
+                  "SHA3-512", icc_stat);
+        /* make sure known answer is correct                     */
+        p1 = sha3_512_ka;
+        /** \induced 64. SHA3-512 digest test, wrong known answer
+       */
+        if (64 == icc_failure)
+        {
+          memcpy(ibuf, sha3_512_ka, sizeof(sha3_512_ka));
+          ibuf[sizeof(sha3_512_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        if (ICC_OK == icc_stat->majRC)
+        {
+          iccCheckKnownAnswer(digest, digestL, p1, sizeof(sha3_512_ka), icc_stat,
+                              __FILE__, __LINE__, "HASH", "SHA3-512");
+        }
       }
-    }
 
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: SHA512 digest test with known input and output  */
-      iccDigest(iccLib, (unsigned char *)in, sizeof(in), digest, &digestL,
-                "SHA3-512", icc_stat);
-      /* make sure known answer is correct                     */
-      p1 = sha3_512_ka;
-      /** \induced 64. SHA3-512 digest test, wrong known answer
-     */
-      if (64 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CORE))
       {
-        memcpy(ibuf, sha3_512_ka, sizeof(sha3_512_ka));
-        ibuf[sizeof(sha3_512_ka) - 1] ^= 0x01;
-        p1 = (const unsigned char *)ibuf;
+        digestL = 128;
+        /** \known Test: SHAKE128 XOF digest test with known input and output  */
+        iccXOF(iccLib, (unsigned char *)in, sizeof(in), digest, sizeof(SHAKE128_CT),
+               "SHAKE128", icc_stat);
+        /* make sure known answer is correct                     */
+        p1 = SHAKE128_CT;
+        /** \induced 65. SHAKE128 XOF test, wrong known answer
+       */
+        if (65 == icc_failure)
+        {
+          memcpy(ibuf, SHAKE128_CT, sizeof(SHAKE128_CT));
+          ibuf[sizeof(SHAKE128_CT) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        if (ICC_OK == icc_stat->majRC)
+        {
+          iccCheckKnownAnswer(digest, digestL, p1, sizeof(SHAKE128_CT), icc_stat,
+                              __FILE__, __LINE__, "XOF", "SHAKE128");
+        }
       }
-      if (ICC_OK == icc_stat->majRC)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CORE))
       {
-        iccCheckKnownAnswer(digest, digestL, p1, sizeof(sha3_512_ka), icc_stat,
-                            __FILE__, __LINE__, "HASH", "SHA3-512");
+        /** \known Test: SHAKE128 incremental squeeze with known input and
+            output, squeezed in three pieces, 1, 7 and 120 bytes */
+        XOF_CTX *xctx = XOF_CTX_new();
+
+        memset(digest, 0, sizeof(SHAKE128_CT));
+        if ((NULL == xctx) ||
+            (1 != XOF_CTX_Init(xctx, EVP_get_digestbyname("SHAKE128"))) ||
+            (1 != XOF_CTX_Absorb(xctx, (const unsigned char *)in, sizeof(in))) ||
+            (1 != XOF_CTX_Squeeze(xctx, digest, 1)) ||
+            (1 != XOF_CTX_Squeeze(xctx, digest + 1, 7)) ||
+            (1 != XOF_CTX_Squeeze(xctx, digest + 8, sizeof(SHAKE128_CT) - 8)))
+        {
+          SetStatusLn(NULL, icc_stat, FATAL_ERROR, ICC_LIBRARY_VERIFICATION_FAILED,
+                      "SHAKE128 incremental squeeze failed", __FILE__, __LINE__);
+        }
+        XOF_CTX_free(xctx);
+        p1 = SHAKE128_CT;
+        /** \induced 66. SHAKE128 incremental squeeze test, wrong known answer
+       */
+        if (66 == icc_failure)
+        {
+          memcpy(ibuf, SHAKE128_CT, sizeof(SHAKE128_CT));
+          ibuf[sizeof(SHAKE128_CT) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        if (ICC_OK == icc_stat->majRC)
+        {
+          iccCheckKnownAnswer(digest, sizeof(SHAKE128_CT), p1, sizeof(SHAKE128_CT), icc_stat,
+                              __FILE__, __LINE__, "XOF", "SHAKE128 incremental");
+        }
       }
-    }
-
-    if (ICC_OK == icc_stat->majRC)
-    {
-      digestL = 128;
-      /** \known Test: SHAKE128 XOF digest test with known input and output  */
-      iccXOF(iccLib, (unsigned char *)in, sizeof(in), digest, sizeof(SHAKE128_CT),
-             "SHAKE128", icc_stat);
-      /* make sure known answer is correct                     */
-      p1 = SHAKE128_CT;
-      /** \induced 65. SHAKE128 XOF test, wrong known answer
-     */
-      if (65 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CORE))
       {
-        memcpy(ibuf, SHAKE128_CT, sizeof(SHAKE128_CT));
-        ibuf[sizeof(SHAKE128_CT) - 1] ^= 0x01;
-        p1 = (const unsigned char *)ibuf;
+        /** \known Test: ParallelHash128 with known input and output,
+            which also covers cSHAKE128 */
+        PHASH_CTX *pctx = PHASH_CTX_new();
+
+        memset(digest, 0, sizeof(PHASH128_ka));
+        if ((NULL == pctx) ||
+            (1 != PHASH_CTX_Init(pctx, EVP_get_digestbyname("SHAKE128"), 8,
+                                 (const unsigned char *)"Parallel Data", 13)) ||
+            (1 != PHASH_CTX_Update(pctx, PHASH128_in, 5)) ||
+            (1 != PHASH_CTX_Update(pctx, PHASH128_in + 5, sizeof(PHASH128_in) - 5)) ||
+            (1 != PHASH_CTX_Final(pctx, digest, sizeof(PHASH128_ka))))
+        {
+          SetStatusLn(NULL, icc_stat, FATAL_ERROR, ICC_LIBRARY_VERIFICATION_FAILED,
+                      "ParallelHash128 failed", __FILE__, __LINE__);
+        }
+        PHASH_CTX_free(pctx);
+        p1 = PHASH128_ka;
+        /** \induced 67. ParallelHash128 test, wrong known answer
+       */
+        if (67 == icc_failure)
+        {
+          memcpy(ibuf, PHASH128_ka, sizeof(PHASH128_ka));
+          ibuf[sizeof(PHASH128_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        if (ICC_OK == icc_stat->majRC)
+        {
+          iccCheckKnownAnswer(digest, sizeof(PHASH128_ka), p1, sizeof(PHASH128_ka), icc_stat,
+                              __FILE__, __LINE__, "XOF", "ParallelHash128");
+        }
       }
-      if (ICC_OK == icc_stat->majRC)
+
+      /* End SHA3 */
+
+      /** \known Test: RSA encrypt/decrypt test with known keys, inputs and
+     * outputs */
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_PKEY))
       {
-        iccCheckKnownAnswer(digest, digestL, p1, sizeof(SHAKE128_CT), icc_stat,
-                            __FILE__, __LINE__, "XOF", "SHAKE128");
+        tmp = RSA_key;
+        d2i_RSAPrivateKey(&rsaKey, &tmp, sizeof(RSA_key));
+        iccRSACipherTest(iccLib, rsaKey, 1, in, sizeof(in), rsa_privK_ka,
+                         sizeof(rsa_privK_ka), rsa_pubK_ka, sizeof(rsa_pubK_ka),
+                         icc_stat);
       }
-    }
 
-    /* End SHA3 */
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_PKEY))
+      {
 
-    /** \known Test: RSA encrypt/decrypt test with known keys, inputs and
-   * outputs */
-    if (ICC_OK == icc_stat->majRC)
-    {
-      tmp = RSA_key;
-      d2i_RSAPrivateKey(&rsaKey, &tmp, sizeof(RSA_key));
-      iccRSACipherTest(iccLib, rsaKey, 1, in, sizeof(in), rsa_privK_ka,
-                       sizeof(rsa_privK_ka), rsa_pubK_ka, sizeof(rsa_pubK_ka),
-                       icc_stat);
-    }
+        /** \known Test: RSA key pair verification with known (good) keys */
+        if (ICC_OK != iccRSAKeyPair(iccLib, rsaKey))
+        {
+          SetStatusLn(iccLib, icc_stat, FATAL_ERROR,
+                      ICC_LIBRARY_VERIFICATION_FAILED,
+                      "Verification of RSA key pair failed.", __FILE__, __LINE__);
+        }
+      }
 
-    if (ICC_OK == icc_stat->majRC)
-    {
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_PKEY))
+      {
+        dsa = DSA_new();
 
-      /** \known Test: RSA key pair verification with known (good) keys */
-      if (ICC_OK != iccRSAKeyPair(iccLib, rsaKey))
+        p1 = dsa_privK_ka;
+        /** \induced 73. DSA key pair consistency test, corrupt key
+       */
+        if (73 == icc_failure)
+        {
+          memcpy(ibuf, dsa_privK_ka, sizeof(dsa_privK_ka));
+          ibuf[sizeof(dsa_privK_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        d2i_DSAPrivateKey(&dsa, &p1, sizeof(dsa_privK_ka));
+        /** \known Test: DSA key pair test with known (good) keys */
+        if (iccDSAPairTest(iccLib, dsa) != ICC_OK)
+        {
+          SetStatusLn(iccLib, icc_stat, FATAL_ERROR,
+                      ICC_LIBRARY_VERIFICATION_FAILED,
+                      "Verification of DSA key pair failed.", __FILE__, __LINE__);
+        }
+      }
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_PKEY))
       {
-        SetStatusLn(iccLib, icc_stat, FATAL_ERROR,
-                    ICC_LIBRARY_VERIFICATION_FAILED,
-                    "Verification of RSA key pair failed.", __FILE__, __LINE__);
+        /** \known Test: DSA verify with known public key and signature
+          @note you can't check the signatures themselves, they vary each time
+      */
+        if (1 != DSA_verify(0, in, 20, dsa_sig_ka, sizeof(dsa_sig_ka), dsa))
+        {
+          OpenSSLError(iccLib, icc_stat, __FILE__, __LINE__);
+        }
       }
-    }
-
-    if (ICC_OK == icc_stat->majRC)
-    {
-      dsa = DSA_new();
 
-      p1 = dsa_privK_ka;
-      /** \induced 73. DSA key pair consistency test, corrupt key
-     */
-      if (73 == icc_failure)
+      DSA_free(dsa);
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_MAC))
       {
-        memcpy(ibuf, dsa_privK_ka, sizeof(dsa_privK_ka));
-        ibuf[sizeof(dsa_privK_ka) - 1] ^= 0x01;
-        p1 = (const unsigned char *)ibuf;
+        /** \known Test: SHA1-HMAC test with known key, input and output */
+        p1 = hmac_ka;
+        /** \induced 17. SHA-1 HMAC test, wrong known answer
+       */
+        if (17 == icc_failure)
+        {
+          memcpy(ibuf, hmac_ka, sizeof(hmac_ka));
+          ibuf[sizeof(hmac_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        iccHMACTest(iccLib, icc_stat, (unsigned char *)hmac_ka_key,
+                    sizeof(hmac_ka_key), "SHA1", (unsigned char *)hmac_ka_data,
+                    sizeof(hmac_ka_data), p1, sizeof(hmac_ka), ibuf);
       }
-      d2i_DSAPrivateKey(&dsa, &p1, sizeof(dsa_privK_ka));
-      /** \known Test: DSA key pair test with known (good) keys */
-      if (iccDSAPairTest(iccLib, dsa) != ICC_OK)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_MAC))
       {
-        SetStatusLn(iccLib, icc_stat, FATAL_ERROR,
-                    ICC_LIBRARY_VERIFICATION_FAILED,
-                    "Verification of DSA key pair failed.", __FILE__, __LINE__);
+        /** \known Test: SHA256 HMAC test with known key, input and output */
+        p1 = hmac256_ka;
+        /** \induced 19. SHA-256 HMAC test, wrong known answer
+       */
+        if (21 == icc_failure)
+        {
+          memcpy(ibuf, hmac256_ka, sizeof(hmac256_ka));
+          ibuf[sizeof(hmac256_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        iccHMACTest(iccLib, icc_stat, (unsigned char *)hmacsha2_ka_key,
+                    sizeof(hmacsha2_ka_key), "SHA256",
+                    (unsigned char *)hmacsha2_ka_data, sizeof(hmacsha2_ka_data), p1,
+                    sizeof(hmac256_ka), ibuf);
       }
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: DSA verify with known public key and signature
-        @note you can't check the signatures themselves, they vary each time
-    */
-      if (1 != DSA_verify(0, in, 20, dsa_sig_ka, sizeof(dsa_sig_ka), dsa))
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_MAC))
       {
-        OpenSSLError(iccLib, icc_stat, __FILE__, __LINE__);
+        /** \known Test: SHA3-512-HMAC test with known key, input and output */
+        p1 = hmac3_512_ka;
+        /** \induced 68. SHA3-512 HMAC test, wrong known answer
+       */
+        if (68 == icc_failure)
+        {
+          memcpy(ibuf, hmac3_512_ka, sizeof(hmac3_512_ka));
+          ibuf[sizeof(hmac3_512_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        iccHMACTest(iccLib, icc_stat, (unsigned char *)hmacsha2_ka_key,
+                    sizeof(hmacsha2_ka_key), "SHA3-512",
+                    (unsigned char *)hmacsha2_ka_data, sizeof(hmacsha2_ka_data), p1,
+                    sizeof(hmac3_512_ka), ibuf);
       }
-    }
-
-    DSA_free(dsa);
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: SHA1-HMAC test with known key, input and output */
-      p1 = hmac_ka;
-      /** \induced 17. SHA-1 HMAC test, wrong known answer
-     */
-      if (17 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_MAC))
       {
-        memcpy(ibuf, hmac_ka, sizeof(hmac_ka));
-        ibuf[sizeof(hmac_ka) - 1] ^= 0x01;
-        p1 = (const unsigned char *)ibuf;
+        /** \known Test: AES-256 CMAC test with known key, input and output */
+        p1 = cmac_ka;
+        /** \induced 27. AES-CMAC test, wrong known answer
+       */
+        if (27 == icc_failure)
+        {
+          memcpy(ibuf, cmac_ka, sizeof(cmac_ka));
+          ibuf[sizeof(cmac_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        iccCMACTest(iccLib, icc_stat, (unsigned char *)cmac_ka_key, 32, "AES-256-CBC",
+                    (unsigned char *)cmac_ka_data, sizeof(cmac_ka_data), p1,
+                    sizeof(cmac_ka), ibuf);
       }
-      iccHMACTest(iccLib, icc_stat, (unsigned char *)hmac_ka_key,
-                  sizeof(hmac_ka_key), "SHA1", (unsigned char *)hmac_ka_data,
-                  sizeof(hmac_ka_data), p1, sizeof(hmac_ka), ibuf);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: SHA256 HMAC test with known key, input and output */
-      p1 = hmac256_ka;
-      /** \induced 19. SHA-256 HMAC test, wrong known answer
-     */
-      if (21 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_MAC))
       {
-        memcpy(ibuf, hmac256_ka, sizeof(hmac256_ka));
-        ibuf[sizeof(hmac256_ka) - 1] ^= 0x01;
-        p1 = (const unsigned char *)ibuf;
+        /** \known Test: KMAC128 test with known key, input and output */
+        p1 = kmac128_ka;
+        /** \induced 69. KMAC128 test, wrong known answer
+       */
+        if (69 == icc_failure)
+        {
+          memcpy(ibuf, kmac128_ka, sizeof(kmac128_ka));
+          ibuf[sizeof(kmac128_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        iccKMACTest(iccLib, icc_stat, "SHAKE128", p1, sizeof(kmac128_ka));
       }
-      iccHMACTest(iccLib, icc_stat, (unsigned char *)hmacsha2_ka_key,
-                  sizeof(hmacsha2_ka_key), "SHA256",
-                  (unsigned char *)hmacsha2_ka_data, sizeof(hmacsha2_ka_data), p1,
-                  sizeof(hmac256_ka), ibuf);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: SHA3-512-HMAC test with known key, input and output */
-      p1 = hmac3_512_ka;
-      /** \induced 68. SHA3-512 HMAC test, wrong known answer
-     */
-      if (68 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_MAC))
       {
-        memcpy(ibuf, hmac3_512_ka, sizeof(hmac3_512_ka));
-        ibuf[sizeof(hmac3_512_ka) - 1] ^= 0x01;
-        p1 = (const unsigned char *)ibuf;
+        /** \known Test: KMAC256 test with known key, input and output */
+        p1 = kmac256_ka;
+        /** \induced 70. KMAC256 test, wrong known answer
+       */
+        if (70 == icc_failure)
+        {
+          memcpy(ibuf, kmac256_ka, sizeof(kmac256_ka));
+          ibuf[sizeof(kmac256_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        iccKMACTest(iccLib, icc_stat, "SHAKE256", p1, sizeof(kmac256_ka));
       }
-      iccHMACTest(iccLib, icc_stat, (unsigned char *)hmacsha2_ka_key,
-                  sizeof(hmacsha2_ka_key), "SHA3-512",
-                  (unsigned char *)hmacsha2_ka_data, sizeof(hmacsha2_ka_data), p1,
-                  sizeof(hmac3_512_ka), ibuf);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: AES-256 CMAC test with known key, input and output */
-      p1 = cmac_ka;
-      /** \induced 27. AES-CMAC test, wrong known answer
-     */
-      if (27 == icc_failure)
+
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CIPHER))
       {
-        memcpy(ibuf, cmac_ka, sizeof(cmac_ka));
-        ibuf[sizeof(cmac_ka) - 1] ^= 0x01;
-        p1 = (const unsigned char *)ibuf;
+        /** \known Test: AES-256-CBC known answer with known key, iv, input and
+       * output */
+        p1 = aes_ka;
+        /** \induced 80. AES-256-CBC encryption/decryption test, wrong known
+       * answer
+       */
+        if (80 == icc_failure)
+        {
+          memcpy(ibuf, aes_ka, sizeof(aes_ka));
+          ibuf[sizeof(aes_ka) - 1] ^= 0x01;
+          p1 = (const unsigned char *)ibuf;
+        }
+        iccCipherTest(iccLib, "AES-256-CBC", in, sizeof(in), p1, sizeof(aes_ka),
+                      aes_key, cbc_iv, icc_stat, ibuf);
       }
-      iccCMACTest(iccLib, icc_stat, (unsigned char *)cmac_ka_key, 32, "AES-256-CBC",
-                  (unsigned char *)cmac_ka_data, sizeof(cmac_ka_data), p1,
-                  sizeof(cmac_ka), ibuf);
-    }
-
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: AES-256-CBC known answer with known key, iv, input and
-     * output */
-      p1 = aes_ka;
-      /** \induced 80. AES-256-CBC encryption/decryption test, wrong known
-     * answer
-     */
-      if (80 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CORE))
       {
-        memcpy(ibuf, aes_ka, sizeof(aes_ka));
-        ibuf[sizeof(aes_ka) - 1] ^= 0x01;
-        p1 = (const unsigned char *)ibuf;
+        RNGAlgTests(iccLib, icc_stat);
       }
-      iccCipherTest(iccLib, "AES-256-CBC", in, sizeof(in), p1, sizeof(aes_ka),
-                    aes_key, cbc_iv, icc_stat, ibuf);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      RNGAlgTests(iccLib, icc_stat);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      iccDSA2KA(icc_stat);
-    }
-    /** \known Test: EC key pair verification prime field with known (good)
-   * keys P384 */
-    if (ICC_OK == icc_stat->majRC)
-    {
-      EC_KEY *eckey = NULL;
-      const unsigned char *ptr = EC_key_P384;
-      eckey = d2i_ECPrivateKey(NULL, &ptr, sizeof(EC_key_P384));
-      if (ICC_OK != iccECKEYPairTest(iccLib, eckey))
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_PKEY))
       {
-        SetStatusLn(
-            iccLib, icc_stat, FATAL_ERROR, ICC_LIBRARY_VERIFICATION_FAILED,
-            "Verification of ECDSA key pair failed (P-284).", __FILE__, __LINE__);
+        iccDSA2KA(icc_stat);
       }
-      EC_KEY_free(eckey);
-    }
-    /** \known Test: EC key pair verification (binary field) with known (good)
-   * keys B233 */
-    if (ICC_OK == icc_stat->majRC)
-    {
-      EC_KEY *eckey = NULL;
-      const unsigned char *ptr = EC_key_B233;
-      eckey = d2i_ECPrivateKey(NULL, &ptr, sizeof(EC_key_B233));
-      if (ICC_OK != iccECKEYPairTest(iccLib, eckey))
+      /** \known Test: EC key pair verification prime field with known (good)
+     * keys P384 */
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_PKEY))
       {
-        SetStatusLn(
-            iccLib, icc_stat, FATAL_ERROR, ICC_LIBRARY_VERIFICATION_FAILED,
-            "Verification of ECDSA key pair failed (B233).", __FILE__, __LINE__);
+        EC_KEY *eckey = NULL;
+        const unsigned char *ptr = EC_key_P384;
+        eckey = d2i_ECPrivateKey(NULL, &ptr, sizeof(EC_key_P384));
+        if (ICC_OK != iccECKEYPairTest(iccLib, eckey))
+        {
+          SetStatusLn(
+              iccLib, icc_stat, FATAL_ERROR, ICC_LIBRARY_VERIFICATION_FAILED,
+              "Verification of ECDSA key pair failed (P-284).", __FILE__, __LINE__);
+        }
+        EC_KEY_free(eckey);
       }
-      EC_KEY_free(eckey);
-    }
-
-    if (ICC_OK == icc_stat->majRC)
-    {
-
-      EC_KEY *mine = NULL;
-      EC_POINT *otherp = NULL;
-      EC_POINT *minep = NULL;
-      BN_CTX *bn_ctx = NULL;
-      BIGNUM *x = NULL;
-      BIGNUM *y = NULL;
-      BIGNUM *priv = NULL;
-      const EC_GROUP *group = NULL;
-      int nid = 0;
-      nid = OBJ_txt2nid("secp521r1");
-
-      mine = EC_KEY_new_by_curve_name(nid);
-      bn_ctx = BN_CTX_new();
-      group = EC_KEY_get0_group(mine);
-      strncpy((char *)ibuf, ECDH_pub_otherX, SCRATCH_SIZE - 1);
-      /* \induced 140. EDCH, change other public key */
-      if (icc_failure == 140)
+      /** \known Test: EC key pair verification (binary field) with known (good)
+     * keys B233 */
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_PKEY))
       {
-        ibuf[10] = ~ibuf[10];
+        EC_KEY *eckey = NULL;
+        const unsigned char *ptr = EC_key_B233;
+        eckey = d2i_ECPrivateKey(NULL, &ptr, sizeof(EC_key_B233));
+        if (ICC_OK != iccECKEYPairTest(iccLib, eckey))
+        {
+          SetStatusLn(
+              iccLib, icc_stat, FATAL_ERROR, ICC_LIBRARY_VERIFICATION_FAILED,
+              "Verification of ECDSA key pair failed (B233).", __FILE__, __LINE__);
+        }
+        EC_KEY_free(eckey);
       }
-      BN_hex2bn(&x, (char *)ibuf);
-      BN_hex2bn(&y, ECDH_pub_otherY);
-      otherp = EC_POINT_new(group);
-      EC_POINT_set_affine_coordinates_GFp(group, otherp, x, y, bn_ctx);
-      BN_clear_free(x);
-      BN_clear_free(y);
-      x = y = NULL;
-      BN_hex2bn(&x, ECDH_pub_mineX);
-      BN_hex2bn(&y, ECDH_pub_mineY);
-      minep = EC_POINT_new(group);
-      EC_POINT_set_affine_coordinates_GFp(group, minep, x, y, bn_ctx);
-      BN_clear_free(x);
-      BN_clear_free(y);
-      EC_KEY_set_public_key(mine, minep);
-      strncpy((char *)ibuf, ECDH_priv_mine, SCRATCH_SIZE - 1);
-      /* \induced 141. EDCH, change my private key */
-      if (icc_failure == 141)
+
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_PKEY))
       {
-        ibuf[10] = ~ibuf[10];
+
+        EC_KEY *mine = NULL;
+        EC_POINT *otherp = NULL;
+        EC_POINT *minep = NULL;
+        BN_CTX *bn_ctx = NULL;
+        BIGNUM *x = NULL;
+        BIGNUM *y = NULL;
+        BIGNUM *priv = NULL;
+        const EC_GROUP *group = NULL;
+        int nid = 0;
+        nid = OBJ_txt2nid("secp521r1");
+
+        mine = EC_KEY_new_by_curve_name(nid);
+        bn_ctx = BN_CTX_new();
+        group = EC_KEY_get0_group(mine);
+        strncpy((char *)ibuf, ECDH_pub_otherX, SCRATCH_SIZE - 1);
+        /* \induced 140. EDCH, change other public key */
+        if (icc_failure == 140)
+        {
+          ibuf[10] = ~ibuf[10];
+        }
+        BN_hex2bn(&x, (char *)ibuf);
+        BN_hex2bn(&y, ECDH_pub_otherY);
+        otherp = EC_POINT_new(group);
+        EC_POINT_set_affine_coordinates_GFp(group, otherp, x, y, bn_ctx);
+        BN_clear_free(x);
+        BN_clear_free(y);
+        x = y = NULL;
+        BN_hex2bn(&x, ECDH_pub_mineX);
+        BN_hex2bn(&y, ECDH_pub_mineY);
+        minep = EC_POINT_new(group);
+        EC_POINT_set_affine_coordinates_GFp(group, minep, x, y, bn_ctx);
+        BN_clear_free(x);
+        BN_clear_free(y);
+        EC_KEY_set_public_key(mine, minep);
+        strncpy((char *)ibuf, ECDH_priv_mine, SCRATCH_SIZE - 1);
+        /* \induced 141. EDCH, change my private key */
+        if (icc_failure == 141)
+        {
+          ibuf[10] = ~ibuf[10];
+        }
+        BN_hex2bn(&priv, (char *)ibuf);
+        EC_KEY_set_private_key(mine, priv);
+        memcpy(ibuf, ECDH_shared, sizeof(ECDH_shared));
+        /* \induced 142. EDCH, change shared secret */
+        if (icc_failure == 142)
+        {
+          ibuf[10] = ~ibuf[10];
+        }
+
+        /* \known Test: ECDH
+       */
+        iccECDHVerifyKAS(icc_stat, otherp, mine, ibuf, sizeof(ECDH_shared));
+        EC_POINT_free(otherp);
+        EC_KEY_free(mine);
+        EC_POINT_free(minep);
+        BN_clear_free(priv);
+        BN_CTX_free(bn_ctx);
       }
-      BN_hex2bn(&priv, (char *)ibuf);
-      EC_KEY_set_private_key(mine, priv);
-      memcpy(ibuf, ECDH_shared, sizeof(ECDH_shared));
-      /* \induced 142. EDCH, change shared secret */
-      if (icc_failure == 142)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CIPHER))
       {
-        ibuf[10] = ~ibuf[10];
+        /** \known Test: AES_CCM
+          - Encrypt: check against known ciphertext + tag
+          - Decrypt: check flags (tags matched),
+          - Decrypt: check decrypted text against plaintext
+      */
+        iccAES_CCMTest(iccLib, icc_stat, (unsigned char *)AES_CCM_key,
+                       sizeof(AES_CCM_key), (unsigned char *)AES_CCM_nonce,
+                       sizeof(AES_CCM_nonce), (unsigned char *)AES_CCM_AAD,
+                       sizeof(AES_CCM_AAD), (unsigned char *)AES_CCM_PT,
+                       sizeof(AES_CCM_PT), (unsigned char *)AES_CCM_CT,
+                       sizeof(AES_CCM_CT), 4, ibuf);
       }
-
-      /* \known Test: ECDH
-     */
-      iccECDHVerifyKAS(icc_stat, otherp, mine, ibuf, sizeof(ECDH_shared));
-      EC_POINT_free(otherp);
-      EC_KEY_free(mine);
-      EC_POINT_free(minep);
-      BN_clear_free(priv);
-      BN_CTX_free(bn_ctx);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: AES_CCM
-        - Encrypt: check against known ciphertext + tag
-        - Decrypt: check flags (tags matched),
-        - Decrypt: check decrypted text against plaintext
-    */
-      iccAES_CCMTest(iccLib, icc_stat, (unsigned char *)AES_CCM_key,
-                     sizeof(AES_CCM_key), (unsigned char *)AES_CCM_nonce,
-                     sizeof(AES_CCM_nonce), (unsigned char *)AES_CCM_AAD,
-                     sizeof(AES_CCM_AAD), (unsigned char *)AES_CCM_PT,
-                     sizeof(AES_CCM_PT), (unsigned char *)AES_CCM_CT,
-                     sizeof(AES_CCM_CT), 4, ibuf);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: AES_GCM
-        - Encrypt: check against known ciphertext + tag
-        - Decrypt: check flags (tags matched),
-        - Decrypt: check decrypted text against plaintext
-    */
-      iccAES_GCMTest(iccLib, icc_stat, (unsigned char *)gcm_ka_key,
-                     sizeof(gcm_ka_key), (unsigned char *)gcm_ka_iv,
-                     sizeof(gcm_ka_iv), (unsigned char *)gcm_ka_aad,
-                     sizeof(gcm_ka_aad), (unsigned char *)gcm_ka_plaintext,
-                     sizeof(gcm_ka_plaintext), (unsigned char *)gcm_ka_ciphertext,
-                     sizeof(gcm_ka_ciphertext), (unsigned char *)gcm_ka_authtag,
-                     sizeof(gcm_ka_authtag), ibuf);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: AES-128-XTS
-        - Encrypt: check against known data
-        - Decrypt: check decrypted text against plaintext
-    */
-      iccAES_XTSTest(iccLib, icc_stat, "AES-128-XTS",
-                     (unsigned char *)XTS_128_Key, (unsigned char *)XTS_128_IV,
-                     (unsigned char *)XTS_128_PT, sizeof(XTS_128_PT),
-                     (unsigned char *)XTS_128_CT, sizeof(XTS_128_CT), ibuf);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: SP800-90 PRNG's
-     */
-      iccSP800_90Test(iccLib, icc_stat);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: SP800-108 PRNG's
-     */
-      iccSP800_108Test(iccLib, icc_stat);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: SP800-38F Key wrap, no pad */
-      memcpy(ibuf, KW_P, sizeof(KW_P));
-      /*! \induced 180. SP800-38F Key wrap, no pad*/
-      if (180 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CIPHER))
       {
-        ibuf[3] = ~ibuf[3];
+        /** \known Test: AES_GCM
+          - Encrypt: check against known ciphertext + tag
+          - Decrypt: check flags (tags matched),
+          - Decrypt: check decrypted text against plaintext
+      */
+        iccAES_GCMTest(iccLib, icc_stat, (unsigned char *)gcm_ka_key,
+                       sizeof(gcm_ka_key), (unsigned char *)gcm_ka_iv,
+                       sizeof(gcm_ka_iv), (unsigned char *)gcm_ka_aad,
+                       sizeof(gcm_ka_aad), (unsigned char *)gcm_ka_plaintext,
+                       sizeof(gcm_ka_plaintext), (unsigned char *)gcm_ka_ciphertext,
+                       sizeof(gcm_ka_ciphertext), (unsigned char *)gcm_ka_authtag,
+                       sizeof(gcm_ka_authtag), ibuf);
       }
-      iccCheckKW(icc_stat, (unsigned char *)KW_K, sizeof(KW_K),
-                 (unsigned char *)ibuf, sizeof(KW_P), (unsigned char *)KW_C,
-                 sizeof(KW_C), 0);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: SP800-38F Key wrap, padded */
-      memcpy(ibuf, KWP_P, sizeof(KWP_P));
-      /*! \induced 181. SP800-38F Key wrap, padded */
-      if (181 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CIPHER))
       {
-        ibuf[3] = ~ibuf[3];
+        /** \known Test: AES-128-XTS
+          - Encrypt: check against known data
+          - Decrypt: check decrypted text against plaintext
+      */
+        iccAES_XTSTest(iccLib, icc_stat, "AES-128-XTS",
+                       (unsigned char *)XTS_128_Key, (unsigned char *)XTS_128_IV,
+                       (unsigned char *)XTS_128_PT, sizeof(XTS_128_PT),
+                       (unsigned char *)XTS_128_CT, sizeof(XTS_128_CT), ibuf);
       }
-      iccCheckKW(icc_stat, (unsigned char *)KWP_K, sizeof(KWP_K),
-                 (unsigned char *)ibuf, sizeof(KWP_P), (unsigned char *)KWP_C,
-                 sizeof(KWP_C), ICC_KW_PAD);
-    }
-
-    if (ICC_OK == icc_stat->majRC)
-    {
-      int i;
-      /** \known Test: HKDF */
-
-      /** \induced 158 HKDF mess up the salt */
-      memcpy(ibuf, HKDF_salt, sizeof(HKDF_salt));
-      if (158 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CORE))
       {
-        ibuf[0] = ~ibuf[0];
+        /** \known Test: SP800-90 PRNG's
+       */
+        iccSP800_90Test(iccLib, icc_stat);
       }
-
-      /** \induced 159 HKDF mess up the reference output */
-      i = SCRATCH_SIZE / 2;
-      memcpy(&ibuf[i], HKDF_OKM, sizeof(HKDF_OKM));
-
-      if (159 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_KDF))
       {
-        ibuf[i] = ~ibuf[i];
+        /** \known Test: SP800-108 PRNG's
+       */
+        iccSP800_108Test(iccLib, icc_stat);
       }
-
-      iccHKDFTest(icc_stat, "SHA256", HKDF_IKM, sizeof(HKDF_IKM), ibuf, sizeof(HKDF_salt),
-                  HKDF_data, sizeof(HKDF_data), HKDF_PRK, sizeof(HKDF_PRK), &ibuf[i], sizeof(HKDF_OKM));
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: TLS1_prf. In hex because of EBCDIC systems */
-      static const char TLS_seed[4] = {0x73, 0x65, 0x65, 0x64}; /* "seed" */
-      static const char TLS_secret[6] = {0x73, 0x65, 0x63, 0x72, 0x65, 0x74}; /* "secret" */
-      const EVP_MD *md = NULL;
-      md = EVP_get_digestbyname("SHA256");
-      /** \induced 160 TLS1 kdf mess up the seed */
-      memcpy(&ibuf[0], TLS_seed, 4);
-      if (160 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CIPHER))
       {
-        ibuf[0] = ~ibuf[0];
+        /** \known Test: SP800-38F Key wrap, no pad */
+        memcpy(ibuf, KW_P, sizeof(KW_P));
+        /*! \induced 180. SP800-38F Key wrap, no pad*/
+        if (180 == icc_failure)
+        {
+          ibuf[3] = ~ibuf[3];
+        }
+        iccCheckKW(icc_stat, (unsigned char *)KW_K, sizeof(KW_K),
+                   (unsigned char *)ibuf, sizeof(KW_P), (unsigned char *)KW_C,
+                   sizeof(KW_C), 0);
       }
-      /** \induced 161 TLS1 kdf mess up the secret */
-      memcpy(&ibuf[16], TLS_secret, 6);
-      if (161 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CIPHER))
       {
-        ibuf[18] = ~ibuf[18];
+        /** \known Test: SP800-38F Key wrap, padded */
+        memcpy(ibuf, KWP_P, sizeof(KWP_P));
+        /*! \induced 181. SP800-38F Key wrap, padded */
+        if (181 == icc_failure)
+        {
+          ibuf[3] = ~ibuf[3];
+        }
+        iccCheckKW(icc_stat, (unsigned char *)KWP_K, sizeof(KWP_K),
+                   (unsigned char *)ibuf, sizeof(KWP_P), (unsigned char *)KWP_C,
+                   sizeof(KWP_C), ICC_KW_PAD);
       }
-      iccTestTLS_KDF(icc_stat, md, &ibuf[16], 6, &ibuf[0], 4, (unsigned char *)TLS1_ka, 16);
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      iccDHTest(icc_stat);
-    }
 
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: ChaCha-Poly1305 */
-      int i = 256; /* Offset into temp buffer */
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_KDF))
+      {
+        int i;
+        /** \known Test: HKDF */
+
+        /** \induced 158 HKDF mess up the salt */
+        memcpy(ibuf, HKDF_salt, sizeof(HKDF_salt));
+        if (158 == icc_failure)
+        {
+          ibuf[0] = ~ibuf[0];
+        }
+
+        /** \induced 159 HKDF mess up the reference output */
+        i = SCRATCH_SIZE / 2;
+        memcpy(&ibuf[i], HKDF_OKM, sizeof(HKDF_OKM));
 
-      /** \induced 182 ChaCha20-Poly1305 mess up the ciphertext */
-      memcpy(ibuf, CHAPOLY_PT, sizeof(CHAPOLY_PT));
-      if (182 == icc_failure)
+        if (159 == icc_failure)
+        {
+          ibuf[i] = ~ibuf[i];
+        }
+
+        iccHKDFTest(icc_stat, "SHA256", HKDF_IKM, sizeof(HKDF_IKM), ibuf, sizeof(HKDF_salt),
+                    HKDF_data, sizeof(HKDF_data), HKDF_PRK, sizeof(HKDF_PRK), &ibuf[i], sizeof(HKDF_OKM));
+      }
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_KDF))
       {
-        ibuf[0] = ~ibuf[0];
+        /** \known Test: TLS1_prf. In hex because of EBCDIC systems */
+        static const char TLS_seed[4] = {0x73, 0x65, 0x65, 0x64}; /* "seed" */
+        static const char TLS_secret[6] = {0x73, 0x65, 0x63, 0x72, 0x65, 0x74}; /* "secret" */
+        const EVP_MD *md = NULL;
+        md = EVP_get_digestbyname("SHA256");
+        /** \induced 160 TLS1 kdf mess up the seed */
+        memcpy(&ibuf[0], TLS_seed, 4);
+        if (160 == icc_failure)
+        {
+          ibuf[0] = ~ibuf[0];
+        }
+        /** \induced 161 TLS1 kdf mess up the secret */
+        memcpy(&ibuf[16], TLS_secret, 6);
+        if (161 == icc_failure)
+        {
+          ibuf[18] = ~ibuf[18];
+        }
+        iccTestTLS_KDF(icc_stat, md, &ibuf[16], 6, &ibuf[0], 4, (unsigned char *)TLS1_ka, 16);
       }
-      /* i = sizeof(CHAPOLY_PT); */
-      /** \induced 183 ChaCha-Poly1305 mess up the AAD to cause a tag mismatch */
-      memcpy(ibuf + i, CHAPOLY_AAD, sizeof(CHAPOLY_AAD));
-      if (183 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_PKEY))
       {
-        ibuf[i] = ~ibuf[i];
+        iccDHTest(icc_stat);
       }
 
-      iccChaChaPolyTest(icc_stat, CHAPOLY_Key, CHAPOLY_IV, sizeof(CHAPOLY_IV), ibuf + i, sizeof(CHAPOLY_AAD),
-                        ibuf, sizeof(CHAPOLY_PT), CHAPOLY_TAG, sizeof(CHAPOLY_TAG), CHAPOLY_CT, sizeof(CHAPOLY_CT));
-    }
-    if (ICC_OK == icc_stat->majRC)
-    {
-      /** \known Test: PBKDF2 */
-      /** \induced 184 Change the Password */
-      memcpy(ibuf, PBKDF2_PWD, sizeof(PBKDF2_PWD));
-      if (184 == icc_failure)
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_CIPHER))
       {
-        ibuf[0] = ~ibuf[0];
+        /** \known Test: ChaCha-Poly1305 */
+        int i = 256; /* Offset into temp buffer */
+
+        /** \induced 182 ChaCha20-Poly1305 mess up the ciphertext */
+        memcpy(ibuf, CHAPOLY_PT, sizeof(CHAPOLY_PT));
+        if (182 == icc_failure)
+        {
+          ibuf[0] = ~ibuf[0];
+        }
+        /* i = sizeof(CHAPOLY_PT); */
+        /** \induced 183 ChaCha-Poly1305 mess up the AAD to cause a tag mismatch */
+        memcpy(ibuf + i, CHAPOLY_AAD, sizeof(CHAPOLY_AAD));
+        if (183 == icc_failure)
+        {
+          ibuf[i] = ~ibuf[i];
+        }
+
+        iccChaChaPolyTest(icc_stat, CHAPOLY_Key, CHAPOLY_IV, sizeof(CHAPOLY_IV), ibuf + i, sizeof(CHAPOLY_AAD),
+                          ibuf, sizeof(CHAPOLY_PT), CHAPOLY_TAG, sizeof(CHAPOLY_TAG), CHAPOLY_CT, sizeof(CHAPOLY_CT));
+      }
+      if ((ICC_OK == icc_stat->majRC) && (groups & KA_GROUP_KDF))
+      {
+        /** \known Test: PBKDF2 */
+        /** \induced 184 Change the Password */
+        memcpy(ibuf, PBKDF2_PWD, sizeof(PBKDF2_PWD));
+        if (184 == icc_failure)
+        {
+          ibuf[0] = ~ibuf[0];
+        }
+        iccPBKDF2Test(icc_stat, PBKDF2_digest, PBKDF2_Iters,
+                      (const char *)ibuf, sizeof(PBKDF2_PWD), PBKDF2_Salt, sizeof(PBKDF2_Salt), PBKDF2_key, sizeof(PBKDF2_key));
       }
-      iccPBKDF2Test(icc_stat, PBKDF2_digest, PBKDF2_Iters,
-                    (const char *)ibuf, sizeof(PBKDF2_PWD), PBKDF2_Salt, sizeof(PBKDF2_Salt), PBKDF2_key, sizeof(PBKDF2_key));
     }
     if (rsaPkey != NULL)
     {
@@ -5049,6 +5414,14 @@ void iccDoKnownAnswer(ICClib * iccLib, ICC_STATUS * icc_stat) {
   }
   OUT();
 }
+
+/** @brief Run all the NIST known answer tests, see iccDoKnownAnswerGroups()
+      @param iccLib ICC internal context
+      @param icc_stat error return
+*/
+void iccDoKnownAnswer(ICClib * iccLib, ICC_STATUS * icc_stat) {
+  iccDoKnownAnswerGroups(iccLib, icc_stat, KA_GROUP_ALL);
+}
 /**
    @brief helper function for the new version of the signature checks
    @param stat a pointer to an ICC_STATUS structure
@@ -53,6 +53,17 @@ void iccCleanupRNG();
 
 
 void iccDoKnownAnswer(ICClib *iccLib, ICC_STATUS *icc_stat);
+
+/* The public ICC_KAT_ values in iccglobals.h */
+#define KA_GROUP_SIG    ICC_KAT_SIG     /*!< RSA/DSA/ECDSA sign/verify known answer tests */
+#define KA_GROUP_CORE   ICC_KAT_CORE    /*!< RNG and digest tests, always run at power up */
+#define KA_GROUP_PKEY   ICC_KAT_PKEY    /*!< RSA/DSA/EC pair-wise, RSA cipher, DH and ECDH */
+#define KA_GROUP_MAC    ICC_KAT_MAC     /*!< HMAC and CMAC */
+#define KA_GROUP_CIPHER ICC_KAT_CIPHER  /*!< AES modes, key wrap and ChaCha20-Poly1305 */
+#define KA_GROUP_KDF    ICC_KAT_KDF     /*!< SP800-108, HKDF, TLS PRF and PBKDF2 */
+#define KA_GROUP_ALL    ICC_KAT_ALL
+
+void iccDoKnownAnswerGroups(ICClib *iccLib, ICC_STATUS *icc_stat, int groups);
   
 
 
@@ -70,5 +81,9 @@ int iccDSAPairTest(ICClib *icclib, DSA *dsa);
 
 int iccECKEYPairTest(ICClib *icclib, EC_KEY *eckey);
 
+int iccECKEYRegenTest(ICClib *icclib, EC_KEY *eckey);
+
+int iccECXKEYRegenTest(ICClib *icclib, EVP_PKEY *pkey);
+
 
 #endif /*INCLUDED_FIPS*/
@@ -424,6 +424,8 @@ _MBPG_Receiver_T* ProgramRequest(_PROGRAM_T* pProgram, unsigned int modnum, unsi
 
     /* We know the size so create a receiver to hold the results */
     result = (_MBPG_Receiver_T*) ICC_Malloc(receiver->Bytes_Used,__FILE__,__LINE__);
+    if (result == NULL)
+        return(0);
     memset(result, 0, receiver->Bytes_Used);
     result->Template_Size = receiver->Bytes_Used;
     matReqTemplate.Request[0].Receiver = result;
@@ -442,6 +444,10 @@ MatErr:
    @param pRead the data buffer
    @param pathfilename the path to the file to verify
    @return  0 -> successful
+   @note All the module components are materialized by a single _MATBPGM
+   request (plus one to size the receiver) into one buffer, read_pgm() then
+   hands back pointers into it without copying. There's no per chunk
+   machine interface call left to batch or overlap with the hashing.
    \Platf OS400 only
  */
 int init_read_pgm(READ_PGM_T * pRead, char * pathfilename)
@@ -96,6 +96,9 @@ struct ICC_t
 
 static void SetStatusPrivateLn2(ICC_STATUS *stat,int majRC,int minRC,const char *m1, const char *m2);
 
+/* Per API call counts and latency histograms, used by the stubs in icc_a.c */
+#include "api_stats.c"
+
 #define ICC 1
 #include "icc_a.c"
 #undef ICC
@@ -275,6 +278,7 @@ ICC_CTX *ICC_InitW(ICC_STATUS *status, const wchar_t *iccpath) {
   wchar_t **paths = NULL;
   fptr_lib_init *tmpf = NULL;
 
+  api_stats_init();
   if (!ICCGlobal.mutexInit) { /* Race, but unavoidable */
     if (0 == ICC_CreateMutex(&(ICCGlobal.mtx))) {
       ICCGlobal.mutexInit = 1;
@@ -402,6 +406,7 @@ ICC_CTX *ICC_Init(ICC_STATUS *status, const char *iccpath) {
    */
   const char *bogusVariable = ICC_SCCSInfo;
 
+  api_stats_init();
   if (!ICCGlobal.mutexInit) { /* Race, but unavoidable */
     if (0 == ICC_CreateMutex(&(ICCGlobal.mtx))) {
       ICCGlobal.mutexInit = 1;
@@ -910,6 +915,14 @@ int ICC_SetValue(ICC_CTX *pcb,ICC_STATUS* status,ICC_VALUE_IDS_ENUM valueID,cons
 
   if(NULL == status) return ICC_ERROR;
   SetStatusPrivateOK(status);
+  /* Counted here in the stubs, the crypto library never sees it */
+  if (ICC_API_STATS == valueID) {
+    if ((NULL == value) || !SetApiStats(*(const int *)value)) {
+      SetStatusPrivate(status,ICC_WARNING,ICC_VALUE_NOT_SET,"ICC_API_STATS must be 0 or 1");
+      temp = ICC_WARNING;
+    }
+    return temp;
+  }
   /* Check to see if ICC_Attach() has been called sucessfully yet - i.e.
      has the function table been set up ?
   */
@@ -928,6 +941,49 @@ int ICC_SetValue(ICC_CTX *pcb,ICC_STATUS* status,ICC_VALUE_IDS_ENUM valueID,cons
 
 
 
+/*!
+ *  @brief Get configuration data
+ *  @param pcb ICC context pointer returned by a sucessful call to ICC_Init
+ *  @param status pointer to a pre-allocated ICC_STATUS variable in which status will be returned
+ *  @param valueID ID of parameter to get
+ *  @param value pointer to a buffer for the value
+ *  @param valueLength the size of value
+ *  @return ICC_OK, ICC_WARNING, ICC_ERROR or ICC_FAILURE.
+ */
+int ICC_GetValue(ICC_CTX *pcb,ICC_STATUS* status,ICC_VALUE_IDS_ENUM valueID,void* value,int valueLength)
+{
+  int temp =  (int)ICC_FAILURE;
+  fptr_GetValue tempf = NULL;
+
+  if(NULL == status) return ICC_ERROR;
+  /* Kept here in the stubs, the crypto library never sees these */
+  if ((ICC_API_STATS == valueID) || (ICC_API_STATS_DATA == valueID)) {
+    SetStatusPrivateOK(status);
+    temp = ICC_OK;
+    if ((NULL == value) ||
+        (valueLength < (int)((ICC_API_STATS == valueID) ? sizeof(int) : sizeof(ICC_API_STAT)))) {
+      SetStatusPrivate(status,ICC_ERROR,ICC_INVALID_PARAMETER,"Value does not meet the minimum size requirement");
+      temp = ICC_FAILURE;
+    } else if (ICC_API_STATS == valueID) {
+      *(int *)value = api_stats_on;
+    } else {
+      api_stats_read(pcb,(ICC_API_STAT *)value,(size_t)valueLength / sizeof(ICC_API_STAT));
+    }
+    return temp;
+  }
+  if ((NULL != pcb) && (NULL != pcb->funcs) ) {
+    tempf = (fptr_GetValue)(*pcb->funcs)[indexOf_GetValue].func;
+    if(NULL != tempf) {
+      temp = (tempf)((void*)pcb->funcs,status,valueID,value,valueLength);
+    }
+  } else {
+    SetStatusPrivate(status,ICC_ERROR,ICC_NOT_INITIALIZED,"ICC has not been initialized");
+  }
+
+  return temp;
+}
+
+
 /*!
   @brief Library initialization.
   With the 2014 update most of the initialization is done internally by the single crypto. library
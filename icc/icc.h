@@ -56,6 +56,19 @@ struct ICC_KDF_t;
 struct ICC_DSA_SIG_t;
 struct ICC_CMAC_CTX_t;
 struct ICC_AES_GCM_CTX_t;
+struct ICC_AES_GCM_IVGEN_t;
+struct ICC_AES_CCM_CTX_t;
+struct ICC_AES_XTS_CTX_t;
+struct ICC_CHACHA_POLY_CTX_t;
+struct ICC_SP800_38F_CTX_t;
+struct ICC_HKDF_CTX_t;
+struct ICC_XOF_CTX_t;
+struct ICC_PHASH_CTX_t;
+struct ICC_HMAC_KEY_t;
+struct ICC_KMAC_KEY_t;
+struct ICC_TLS_PRF_CTX_t;
+struct ICC_ECDSA_POOL_t;
+struct ICC_PKEY_JOB_t;
 struct ICC_EVP_PKEY_CTX_t;
 struct ICC_ASN1_OBJECT_t;
 /*! @brief 
@@ -220,6 +233,70 @@ typedef struct ICC_PKCS8_PRIV_KEY_INFO_t      ICC_PKCS8_PRIV_KEY_INFO;
 */
 typedef struct ICC_KDF_t ICC_KDF;
 
+/*! @brief  
+   - One entry for ICC_SP800_108_KDF_Batch()
+   - Caller allocated and filled in, an array of these is derived
+     from one derivation key
+*/   
+typedef struct ICC_KDF_REC_t {
+  unsigned char *Label;   /*!< Protocol specific nonce data */
+  unsigned int Llen;      /*!< The length of Label */
+  unsigned char *Context; /*!< Instance specific nonce data */
+  unsigned int Clen;      /*!< The length of Context */
+  unsigned char *K0;      /*!< The buffer in which to store the derived key */
+  unsigned int L;         /*!< The length in BYTES of the derived key */
+  int rv;                 /*!< Returned, 1 if this key was derived */
+} ICC_KDF_REC;
+
+/*! @brief  
+   - Placeholder for the reusable SP800-38F key wrap context
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_SP800_38F_CTX_t ICC_SP800_38F_CTX;
+
+/*! @brief  
+   - One entry for ICC_SP800_38F_KW_Batch()
+   - Caller allocated and filled in, an array of these is wrapped or
+     unwrapped under one key encryption key
+*/   
+typedef struct ICC_SP800_38F_REC_t {
+  unsigned char *in;   /*!< Input, the key to wrap or the wrapped key */
+  int inl;             /*!< Length of the input */
+  unsigned char *out;  /*!< Output (length of input +16), may be in */
+  int outl;            /*!< Returned, the output length */
+  int rv;              /*!< Returned, the ICC_SP800_38F_KW() return code for this entry */
+} ICC_SP800_38F_REC;
+
+/*! @brief  
+   - One entry for ICC_PBKDF2_HMAC_Batch()
+   - Caller allocated and filled in, i.e. to check a set of stored
+     password hashes in one call
+*/   
+typedef struct ICC_PBKDF2_REC_t {
+  const char *pass;            /*!< The passphrase */
+  int passlen;                 /*!< The length of the passphrase */
+  const unsigned char *salt;   /*!< The salt */
+  int saltlen;                 /*!< The length of the salt */
+  int iters;                   /*!< The iteration count */
+  int keylen;                  /*!< The derived key length */
+  unsigned char *out;          /*!< The derived key, keylen bytes */
+  const unsigned char *expect; /*!< If not NULL, the key out must match */
+  int rv;                      /*!< Returned, 1 if derived (and matched) */
+} ICC_PBKDF2_REC;
+
+/*! @brief  
+   - One message for ICC_DIGEST_Multi()
+   - Caller allocated and filled in, i.e. the chunks of a file being
+     deduplicated or the leaves of a Merkle tree
+*/   
+typedef struct ICC_DIGEST_REC_t {
+  const unsigned char *in;     /*!< The message */
+  size_t inlen;                /*!< The length of the message, may differ per entry */
+  unsigned char *out;          /*!< The digest, ICC_EVP_MD_size() bytes */
+  int rv;                      /*!< Returned, 1 if hashed */
+} ICC_DIGEST_REC;
+
 /*! @brief  
    - Placeholder for CMAC_CTX structures
    - Must be allocated/freed using ICC API's only.    
@@ -234,6 +311,162 @@ typedef struct ICC_CMAC_CTX_t         ICC_CMAC_CTX;
 */   
 typedef struct ICC_AES_GCM_CTX_t         ICC_AES_GCM_CTX;
 
+/*! @brief  
+   - Placeholder for the deterministic AES_GCM IV generator
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_AES_GCM_IVGEN_t       ICC_AES_GCM_IVGEN;
+
+/*! @brief  
+   - Placeholder for reusable AES_CCM structures
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_AES_CCM_CTX_t         ICC_AES_CCM_CTX;
+
+/*! @brief  
+   - Placeholder for AES_XTS bulk sector structures
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_AES_XTS_CTX_t         ICC_AES_XTS_CTX;
+
+/*! @brief  
+   - Placeholder for reusable ChaCha20-Poly1305 structures
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_CHACHA_POLY_CTX_t         ICC_CHACHA_POLY_CTX;
+
+/*! @brief  
+   - Placeholder for the HKDF context, a PRK held as keyed HMAC state
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_HKDF_CTX_t         ICC_HKDF_CTX;
+
+/*! @brief  
+   - Placeholder for the XOF context, a SHAKE sponge which can be 
+     squeezed repeatedly
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_XOF_CTX_t         ICC_XOF_CTX;
+
+/*! @brief  
+   - Placeholder for the SP800-185 ParallelHash context
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_PHASH_CTX_t       ICC_PHASH_CTX;
+
+/*! @brief  
+   - Placeholder for the HMAC key handle, holds the precomputed pad states
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_HMAC_KEY_t         ICC_HMAC_KEY;
+
+/*! @brief  
+   - Placeholder for the KMAC key handle, holds the keyed sponge state
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_KMAC_KEY_t         ICC_KMAC_KEY;
+
+/*! @brief  
+   - Placeholder for the TLS 1.0-1.2 PRF context, holds the secret as keyed HMAC state
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_TLS_PRF_CTX_t         ICC_TLS_PRF_CTX;
+
+/*! @brief  
+   - Placeholder for a pool of precomputed ECDSA nonces for one key
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_ECDSA_POOL_t         ICC_ECDSA_POOL;
+
+/*! @brief  
+   - Placeholder for an asynchronous RSA/EC private key job
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_PKEY_JOB_t         ICC_PKEY_JOB;
+
+/*! @brief  
+   - One fragment of a scatter/gather list for the ICC_AES_GCM_..UpdateV() and
+     ICC_AES_CCM_..V() calls
+   - Caller allocated and filled in
+*/   
+typedef struct ICC_AES_IOV_t {
+  unsigned char *base;   /*!< Fragment data */
+  unsigned long len;     /*!< Fragment length */
+} ICC_AES_IOV;
+
+/*! @brief  
+   - One record for ICC_AES_GCM_EncryptBatch()/ICC_AES_GCM_DecryptBatch()
+   - Caller allocated and filled in, an array of these is processed 
+     under one key
+*/   
+typedef struct ICC_AES_GCM_REC_t {
+  unsigned char *iv;     /*!< IV for this record */
+  unsigned long ivlen;   /*!< Length of the IV */
+  unsigned char *aad;    /*!< Additional authentication data, may be NULL */
+  unsigned long aadlen;  /*!< Length of the aad */
+  unsigned char *in;     /*!< Input, plaintext or ciphertext */
+  unsigned long inlen;   /*!< Length of the input */
+  unsigned char *out;    /*!< Output, at least inlen bytes */
+  unsigned char *tag;    /*!< 16 byte auth tag, written on encrypt, checked on decrypt */
+  int rv;                /*!< Returned, ICC_OSSL_SUCCESS if this record was processed O.K. */
+} ICC_AES_GCM_REC;
+
+/*! @brief  
+   - One record for ICC_CHACHA_POLY_SealBatch()/ICC_CHACHA_POLY_OpenBatch()
+   - Caller allocated and filled in, an array of these is processed 
+     under one key
+*/   
+typedef struct ICC_CHACHA_POLY_REC_t {
+  unsigned char *iv;     /*!< 12 byte nonce for this record */
+  unsigned char *aad;    /*!< Additional authentication data, may be NULL */
+  unsigned long aadlen;  /*!< Length of the aad */
+  unsigned char *in;     /*!< Input, plaintext or ciphertext */
+  unsigned long inlen;   /*!< Length of the input */
+  unsigned char *out;    /*!< Output, at least inlen bytes */
+  unsigned char *tag;    /*!< 16 byte tag, written on seal, checked on open */
+  int rv;                /*!< Returned, ICC_OSSL_SUCCESS if this record was processed O.K. */
+} ICC_CHACHA_POLY_REC;
+
+/*! @brief  
+   - One operation for ICC_BATCH_Run()
+   - Caller allocated and filled in, only the fields op needs are used
+   - op is one of the ICC_BATCH_ values
+*/   
+typedef struct ICC_BATCH_OP_t {
+  int op;                       /*!< ICC_BATCH_DIGEST ... ICC_BATCH_DERIVE */
+  const ICC_EVP_MD *md;         /*!< Digest, HMAC, sign and verify, may be NULL for Ed25519/Ed448 */
+  const ICC_EVP_CIPHER *cipher; /*!< AEAD only, GCM or ChaCha20-Poly1305 */
+  ICC_EVP_PKEY *pkey;           /*!< Sign and verify, for derive our private key, X25519 or EC */
+  unsigned char *key;           /*!< HMAC and AEAD key */
+  unsigned long keylen;         /*!< Length of the key */
+  unsigned char *iv;            /*!< AEAD nonce */
+  unsigned long ivlen;          /*!< Length of the nonce */
+  unsigned char *aad;           /*!< AEAD additional authentication data, may be NULL */
+  unsigned long aadlen;         /*!< Length of the aad */
+  unsigned char *in;            /*!< Input, data to hash/MAC/sign/verify or plaintext/ciphertext.
+                                     For derive, the peer's public value, 32 bytes X25519 or an encoded EC point */
+  unsigned long inlen;          /*!< Length of the input */
+  unsigned char *out;           /*!< Output, the digest, MAC, signature, AEAD output or shared secret.
+                                     For verify, the signature to check */
+  unsigned long outlen;         /*!< In, the size of out. Returned, the bytes written.
+                                     For verify, the signature length */
+  unsigned char *tag;           /*!< AEAD tag, written on seal, checked on open */
+  unsigned long taglen;         /*!< Length of the tag */
+  int rv;                       /*!< Returned, ICC_OSSL_SUCCESS if this operation succeeded */
+} ICC_BATCH_OP;
+
 /*! @brief  
    - Placeholder for DSA_SIG structures
    - Must be allocated/freed using ICC API's only.    
@@ -0,0 +1,791 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*! @file
+  @brief Header only C++17 binding for the ICC API.
+
+  A thin layer over the C API in icc.h / icc_a.h, nothing here is
+  exported from the ICC library and nothing is needed at link time
+  beyond what a C caller uses.
+
+  - The handles, icc::context, icc::digest_ctx, icc::cipher_ctx,
+    icc::gcm_ctx and icc::rng_ctx, are move only and free what they
+    own in their destructor.
+  - Buffers are passed as icc::bytes_view (input) and icc::mut_bytes
+    (output), a pointer and a length built from any contiguous byte
+    container, nothing is copied.
+  - The object handles are meant to be kept and reused, one context
+    per thread for a stream of messages. A digest context restarts
+    itself after final(), a cipher context can be restarted with a new
+    IV without repeating the key schedule, a GCM context keeps it's key
+    between seal() and open() calls.
+  - Errors are thrown as icc::error. The text is only looked up once a
+    call has failed, the success path does no string handling and no
+    allocation.
+  - The ICC context must outlive the handles created from it.
+*/
+
+#ifndef INCLUDED_ICC_HPP
+#define INCLUDED_ICC_HPP
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <exception>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+
+#include "icc.h"
+
+namespace icc {
+
+/*! @brief Largest number of buffers in one scatter call */
+constexpr std::size_t max_iov = 16;
+
+/*! @brief AES-GCM auth tag length */
+constexpr std::size_t gcm_tag_len = 16;
+
+namespace detail {
+template <class C, class = void>
+struct is_contiguous : std::false_type {};
+template <class C>
+struct is_contiguous<C, std::void_t<decltype(std::declval<C&>().data()),
+                                    decltype(std::declval<C&>().size())>>
+  : std::integral_constant<bool, sizeof(*std::declval<C&>().data()) == 1> {};
+}
+
+/*! @brief A read only view of caller owned bytes */
+class bytes_view {
+public:
+  constexpr bytes_view() noexcept : p_(nullptr), n_(0) {}
+  bytes_view(const void *p, std::size_t n) noexcept
+    : p_(static_cast<const unsigned char *>(p)), n_(n) {}
+  template <std::size_t N>
+  bytes_view(const unsigned char (&a)[N]) noexcept : p_(a), n_(N) {}
+  /*! @brief From std::string, std::vector<unsigned char>, std::array ... */
+  template <class C, class = std::enable_if_t<detail::is_contiguous<const C>::value>>
+  bytes_view(const C &c) noexcept
+    : p_(reinterpret_cast<const unsigned char *>(c.data())), n_(c.size()) {}
+
+  const unsigned char *data() const noexcept { return p_; }
+  std::size_t size() const noexcept { return n_; }
+  bool empty() const noexcept { return 0 == n_; }
+  /*! @brief The C API takes non const input pointers, it doesn't write to them */
+  unsigned char *c_ptr() const noexcept { return const_cast<unsigned char *>(p_); }
+
+private:
+  const unsigned char *p_;
+  std::size_t n_;
+};
+
+/*! @brief A writable view of caller owned bytes */
+class mut_bytes {
+public:
+  constexpr mut_bytes() noexcept : p_(nullptr), n_(0) {}
+  mut_bytes(void *p, std::size_t n) noexcept
+    : p_(static_cast<unsigned char *>(p)), n_(n) {}
+  template <std::size_t N>
+  mut_bytes(unsigned char (&a)[N]) noexcept : p_(a), n_(N) {}
+  /*! @brief From std::vector<unsigned char>, std::array ..., the current size is the capacity */
+  template <class C, class = std::enable_if_t<detail::is_contiguous<C>::value &&
+                                              !std::is_const<C>::value>>
+  mut_bytes(C &c) noexcept
+    : p_(reinterpret_cast<unsigned char *>(c.data())), n_(c.size()) {}
+
+  unsigned char *data() const noexcept { return p_; }
+  std::size_t size() const noexcept { return n_; }
+  bool empty() const noexcept { return 0 == n_; }
+  /*! @brief The bytes from off on */
+  mut_bytes sub(std::size_t off) const noexcept
+  {
+    return (off < n_) ? mut_bytes(p_ + off, n_ - off) : mut_bytes();
+  }
+
+private:
+  unsigned char *p_;
+  std::size_t n_;
+};
+
+/*! @brief An ICC failure
+  - ICC status failures carry majRC, minRC and the ICC description
+  - Crypto call failures carry the OpenSSL error code, or for a
+    disabled library, the ICC status at the time
+*/
+class error : public std::exception {
+public:
+  /*! @brief From an ICC_STATUS returned by ICC_Init/ICC_Attach etc */
+  explicit error(const ICC_STATUS &st) noexcept
+    : maj_(st.majRC), min_(st.minRC), code_(0)
+  {
+    copy(st.desc);
+  }
+  /*! @brief An argument the C API can't take */
+  error(int maj, int min, const char *text) noexcept
+    : maj_(maj), min_(min), code_(0)
+  {
+    copy(text);
+  }
+  /*! @brief A crypto call failed, collect the reason
+    @param ctx the ICC context, may be NULL
+    @param func the ICC call that failed
+  */
+  error(ICC_CTX *ctx, const char *func) noexcept
+    : maj_(ICC_OPENSSL_ERROR), min_(0), code_(0)
+  {
+    ICC_STATUS st;
+
+    msg_[0] = '\0';
+    if(NULL != ctx) {
+      code_ = ICC_ERR_get_error(ctx);
+    }
+    if((0 != code_) && (NULL != ctx)) {
+      ICC_ERR_error_string_n(ctx, code_, msg_, sizeof(msg_));
+    } else if(NULL != ctx) {
+      std::memset(&st, 0, sizeof(st));
+      ICC_GetStatus(ctx, &st);
+      if(ICC_OK != st.majRC) {
+        maj_ = st.majRC;
+        min_ = st.minRC;
+        copy(st.desc);
+      }
+    }
+    if('\0' == msg_[0]) {
+      std::snprintf(msg_, sizeof(msg_), "%s failed", func);
+    }
+  }
+
+  /*! @brief An SP800-90 PRNG call left the PRNG in state st */
+  error(const char *func, SP800_90STATE st) noexcept
+    : maj_(ICC_ERROR), min_(ICC_INVALID_STATE), code_(static_cast<unsigned long>(st))
+  {
+    std::snprintf(msg_, sizeof(msg_), "%s failed, PRNG state %d", func, static_cast<int>(st));
+  }
+
+  const char *what() const noexcept override { return msg_; }
+  /*! @brief @see ICC_MAJOR_RC_ENUM */
+  int major_rc() const noexcept { return maj_; }
+  /*! @brief @see ICC_MINOR_RC_ENUM */
+  int minor_rc() const noexcept { return min_; }
+  /*! @brief The OpenSSL error code, or the SP800_90STATE for a PRNG failure, 0 if neither applies */
+  unsigned long code() const noexcept { return code_; }
+
+private:
+  void copy(const char *s) noexcept
+  {
+    std::strncpy(msg_, (NULL != s) ? s : "", sizeof(msg_) - 1);
+    msg_[sizeof(msg_) - 1] = '\0';
+  }
+
+  int maj_;
+  int min_;
+  unsigned long code_;
+  char msg_[ICC_DESCLENGTH];
+};
+
+namespace detail {
+/*! @brief Out of line throw, keeps the string handling off the call path */
+[[noreturn]] inline void fail(ICC_CTX *ctx, const char *func)
+{
+  throw error(ctx, func);
+}
+
+[[noreturn]] inline void fail_arg(const char *text)
+{
+  throw error(ICC_ERROR, ICC_INVALID_PARAMETER, text);
+}
+
+inline void check(ICC_CTX *ctx, int rv, const char *func)
+{
+  if(ICC_OSSL_SUCCESS != rv) {
+    fail(ctx, func);
+  }
+}
+
+/*! @brief Lengths are int or unsigned int in the C API */
+inline int to_int(std::size_t n)
+{
+  if(n > static_cast<std::size_t>(INT_MAX)) {
+    fail_arg("buffer too large");
+  }
+  return static_cast<int>(n);
+}
+
+inline unsigned int to_uint(std::size_t n)
+{
+  if(n > static_cast<std::size_t>(UINT_MAX)) {
+    fail_arg("buffer too large");
+  }
+  return static_cast<unsigned int>(n);
+}
+
+/*! @brief mut_bytes list to ICC_RNG_IOV, on the stack */
+inline unsigned int to_iov(std::initializer_list<mut_bytes> bufs, ICC_RNG_IOV *iov)
+{
+  unsigned int i = 0;
+
+  if(bufs.size() > max_iov) {
+    fail_arg("too many buffers");
+  }
+  for(const mut_bytes &b : bufs) {
+    iov[i].buf = b.data();
+    iov[i].len = to_uint(b.size());
+    i++;
+  }
+  return i;
+}
+
+/*! @brief An SP800-90 generate/instantiate result that isn't usable */
+inline bool rng_ok(SP800_90STATE st) noexcept
+{
+  return (SP800_90RUN == st) || (SP800_90RESEED == st) || (SP800_90INIT == st);
+}
+
+inline void check_rng(SP800_90STATE st, const char *func)
+{
+  if(!rng_ok(st)) {
+    throw error(func, st);
+  }
+}
+}
+
+/*! @brief An initialized and attached ICC context, ICC_Init()/ICC_Attach()/ICC_Cleanup() */
+class context {
+public:
+  /*! @brief Load and attach ICC
+    @param path the ICC install path, NULL for the default
+    @param fips true for FIPS approved mode, false for the library default
+    @throw icc::error if the library can't be loaded or attached
+  */
+  explicit context(const char *path = NULL, bool fips = false)
+  {
+    int rc = ICC_OSSL_FAILURE;
+
+    std::memset(&status_, 0, sizeof(status_));
+    ctx_ = ICC_Init(&status_, path);
+    if(NULL == ctx_) {
+      throw error(status_);
+    }
+    if(fips) {
+      ICC_SetValue(ctx_, &status_, ICC_FIPS_APPROVED_MODE, "on");
+    }
+    if(ICC_WARNING >= status_.majRC) {
+      rc = ICC_Attach(ctx_, &status_);
+    }
+    if((ICC_OSSL_FAILURE == rc) || (ICC_FAILURE == rc) || (ICC_WARNING < status_.majRC)) {
+      error e(status_);
+      ICC_Cleanup(ctx_, &status_);
+      ctx_ = NULL;
+      throw e;
+    }
+  }
+  ~context() { reset(); }
+  context(const context &) = delete;
+  context &operator=(const context &) = delete;
+  context(context &&o) noexcept : ctx_(o.ctx_), status_(o.status_) { o.ctx_ = NULL; }
+  context &operator=(context &&o) noexcept
+  {
+    if(this != &o) {
+      reset();
+      ctx_ = o.ctx_;
+      status_ = o.status_;
+      o.ctx_ = NULL;
+    }
+    return *this;
+  }
+
+  /*! @brief The C handle, for calls this binding doesn't cover */
+  ICC_CTX *get() const noexcept { return ctx_; }
+  /*! @brief The status from the last call made through this object */
+  const ICC_STATUS &status() const noexcept { return status_; }
+
+  /*! @brief Look up a digest, ICC_EVP_get_digestbyname() */
+  const ICC_EVP_MD *digest(const char *name) const
+  {
+    const ICC_EVP_MD *md = ICC_EVP_get_digestbyname(ctx_, name);
+    if(NULL == md) {
+      detail::fail(ctx_, "ICC_EVP_get_digestbyname");
+    }
+    return md;
+  }
+  /*! @brief Look up a cipher, ICC_EVP_get_cipherbyname() */
+  const ICC_EVP_CIPHER *cipher(const char *name) const
+  {
+    const ICC_EVP_CIPHER *c = ICC_EVP_get_cipherbyname(ctx_, name);
+    if(NULL == c) {
+      detail::fail(ctx_, "ICC_EVP_get_cipherbyname");
+    }
+    return c;
+  }
+
+  /*! @brief Random bytes from the shared PRNG, ICC_RAND_bytes() */
+  void rand(mut_bytes out) const
+  {
+    detail::check(ctx_, ICC_RAND_bytes(ctx_, out.data(), detail::to_int(out.size())),
+                  "ICC_RAND_bytes");
+  }
+  /*! @brief Fill several buffers in one call, ICC_RAND_bytes_v() */
+  void rand(std::initializer_list<mut_bytes> outs) const
+  {
+    ICC_RNG_IOV iov[max_iov];
+    unsigned int n = detail::to_iov(outs, iov);
+    detail::check(ctx_, ICC_RAND_bytes_v(ctx_, iov, n), "ICC_RAND_bytes_v");
+  }
+
+private:
+  void reset() noexcept
+  {
+    if(NULL != ctx_) {
+      ICC_Cleanup(ctx_, &status_);
+      ctx_ = NULL;
+    }
+  }
+
+  ICC_CTX *ctx_;
+  ICC_STATUS status_;
+};
+
+/*! @brief A message digest context, ICC_EVP_MD_CTX
+  Initialized once, final() leaves it ready for the next message
+*/
+class digest_ctx {
+public:
+  digest_ctx(const context &c, const ICC_EVP_MD *md)
+    : ctx_(c.get()), md_(md), mdctx_(ICC_EVP_MD_CTX_new(ctx_))
+  {
+    if(NULL == mdctx_) {
+      detail::fail(ctx_, "ICC_EVP_MD_CTX_new");
+    }
+    if(ICC_OSSL_SUCCESS != ICC_EVP_DigestInit(ctx_, mdctx_, md_)) {
+      error e(ctx_, "ICC_EVP_DigestInit");
+      ICC_EVP_MD_CTX_free(ctx_, mdctx_);
+      throw e;
+    }
+  }
+  digest_ctx(const context &c, const char *name) : digest_ctx(c, c.digest(name)) {}
+  ~digest_ctx() { reset(); }
+  digest_ctx(const digest_ctx &) = delete;
+  digest_ctx &operator=(const digest_ctx &) = delete;
+  digest_ctx(digest_ctx &&o) noexcept : ctx_(o.ctx_), md_(o.md_), mdctx_(o.mdctx_) { o.mdctx_ = NULL; }
+  digest_ctx &operator=(digest_ctx &&o) noexcept
+  {
+    if(this != &o) {
+      reset();
+      ctx_ = o.ctx_;
+      md_ = o.md_;
+      mdctx_ = o.mdctx_;
+      o.mdctx_ = NULL;
+    }
+    return *this;
+  }
+
+  ICC_EVP_MD_CTX *get() const noexcept { return mdctx_; }
+  /*! @brief The digest length, bytes */
+  std::size_t size() const { return static_cast<std::size_t>(ICC_EVP_MD_size(ctx_, md_)); }
+
+  digest_ctx &update(bytes_view in)
+  {
+    detail::check(ctx_, ICC_EVP_DigestUpdate(ctx_, mdctx_, in.data(), detail::to_uint(in.size())),
+                  "ICC_EVP_DigestUpdate");
+    return *this;
+  }
+  /*! @brief Finish the message and restart, ICC_EVP_DigestFinal_reset()
+    @param out at least size() bytes
+    @return the digest length
+  */
+  std::size_t final(mut_bytes out)
+  {
+    unsigned int len = 0;
+
+    if(out.size() < size()) {
+      detail::fail_arg("digest buffer too small");
+    }
+    detail::check(ctx_, ICC_EVP_DigestFinal_reset(ctx_, mdctx_, out.data(), &len, NULL),
+                  "ICC_EVP_DigestFinal_reset");
+    return len;
+  }
+  /*! @brief One message, update() and final() */
+  std::size_t digest(bytes_view in, mut_bytes out) { return update(in).final(out); }
+
+private:
+  void reset() noexcept
+  {
+    if(NULL != mdctx_) {
+      ICC_EVP_MD_CTX_free(ctx_, mdctx_);
+      mdctx_ = NULL;
+    }
+  }
+
+  ICC_CTX *ctx_;
+  const ICC_EVP_MD *md_;
+  ICC_EVP_MD_CTX *mdctx_;
+};
+
+/*! @brief A symmetric cipher context, ICC_EVP_CIPHER_CTX
+  init() sets the cipher and key, restart() starts the next message
+  with a new IV and the key schedule already in place
+*/
+class cipher_ctx {
+public:
+  explicit cipher_ctx(const context &c)
+    : ctx_(c.get()), cctx_(ICC_EVP_CIPHER_CTX_new(ctx_)), enc_(true)
+  {
+    if(NULL == cctx_) {
+      detail::fail(ctx_, "ICC_EVP_CIPHER_CTX_new");
+    }
+  }
+  ~cipher_ctx() { reset(); }
+  cipher_ctx(const cipher_ctx &) = delete;
+  cipher_ctx &operator=(const cipher_ctx &) = delete;
+  cipher_ctx(cipher_ctx &&o) noexcept : ctx_(o.ctx_), cctx_(o.cctx_), enc_(o.enc_) { o.cctx_ = NULL; }
+  cipher_ctx &operator=(cipher_ctx &&o) noexcept
+  {
+    if(this != &o) {
+      reset();
+      ctx_ = o.ctx_;
+      cctx_ = o.cctx_;
+      enc_ = o.enc_;
+      o.cctx_ = NULL;
+    }
+    return *this;
+  }
+
+  ICC_EVP_CIPHER_CTX *get() const noexcept { return cctx_; }
+
+  /*! @brief Set the cipher, key and IV
+    @param encrypt true to encrypt, false to decrypt
+  */
+  cipher_ctx &init(const ICC_EVP_CIPHER *cipher, bytes_view key, bytes_view iv, bool encrypt)
+  {
+    int rv = 0;
+
+    enc_ = encrypt;
+    if(enc_) {
+      rv = ICC_EVP_EncryptInit(ctx_, cctx_, cipher, key.c_ptr(), iv.c_ptr());
+    } else {
+      rv = ICC_EVP_DecryptInit(ctx_, cctx_, cipher, key.c_ptr(), iv.c_ptr());
+    }
+    detail::check(ctx_, rv, enc_ ? "ICC_EVP_EncryptInit" : "ICC_EVP_DecryptInit");
+    return *this;
+  }
+  /*! @brief Start the next message with the same cipher and key */
+  cipher_ctx &restart(bytes_view iv) { return init(NULL, bytes_view(), iv, enc_); }
+  /*! @brief ICC_EVP_CIPHER_CTX_set_padding(), after init() */
+  cipher_ctx &padding(bool on)
+  {
+    detail::check(ctx_, ICC_EVP_CIPHER_CTX_set_padding(ctx_, cctx_, on ? 1 : 0),
+                  "ICC_EVP_CIPHER_CTX_set_padding");
+    return *this;
+  }
+
+  /*! @brief Process some data
+    @param out at least in.size() plus one block
+    @return the bytes written to out
+  */
+  std::size_t update(bytes_view in, mut_bytes out)
+  {
+    int outl = detail::to_int(out.size());
+    int rv = 0;
+
+    if(enc_) {
+      rv = ICC_EVP_EncryptUpdate(ctx_, cctx_, out.data(), &outl, in.c_ptr(), detail::to_int(in.size()));
+    } else {
+      rv = ICC_EVP_DecryptUpdate(ctx_, cctx_, out.data(), &outl, in.c_ptr(), detail::to_int(in.size()));
+    }
+    detail::check(ctx_, rv, enc_ ? "ICC_EVP_EncryptUpdate" : "ICC_EVP_DecryptUpdate");
+    return static_cast<std::size_t>(outl);
+  }
+  /*! @brief Finish the message
+    @param out at least one block
+    @return the bytes written to out
+  */
+  std::size_t final(mut_bytes out)
+  {
+    int outl = 0;
+    int rv = 0;
+
+    if(enc_) {
+      rv = ICC_EVP_EncryptFinal(ctx_, cctx_, out.data(), &outl);
+    } else {
+      rv = ICC_EVP_DecryptFinal(ctx_, cctx_, out.data(), &outl);
+    }
+    detail::check(ctx_, rv, enc_ ? "ICC_EVP_EncryptFinal" : "ICC_EVP_DecryptFinal");
+    return static_cast<std::size_t>(outl);
+  }
+
+private:
+  void reset() noexcept
+  {
+    if(NULL != cctx_) {
+      ICC_EVP_CIPHER_CTX_free(ctx_, cctx_);
+      cctx_ = NULL;
+    }
+  }
+
+  ICC_CTX *ctx_;
+  ICC_EVP_CIPHER_CTX *cctx_;
+  bool enc_;
+};
+
+/*! @brief An AES-GCM context, ICC_AES_GCM_CTX
+  seal() and open() pass the key only when it changes, an empty key
+  reuses the one already set up
+*/
+class gcm_ctx {
+public:
+  explicit gcm_ctx(const context &c) : ctx_(c.get()), gctx_(ICC_AES_GCM_CTX_new(ctx_))
+  {
+    if(NULL == gctx_) {
+      detail::fail(ctx_, "ICC_AES_GCM_CTX_new");
+    }
+  }
+  ~gcm_ctx() { reset(); }
+  gcm_ctx(const gcm_ctx &) = delete;
+  gcm_ctx &operator=(const gcm_ctx &) = delete;
+  gcm_ctx(gcm_ctx &&o) noexcept : ctx_(o.ctx_), gctx_(o.gctx_) { o.gctx_ = NULL; }
+  gcm_ctx &operator=(gcm_ctx &&o) noexcept
+  {
+    if(this != &o) {
+      reset();
+      ctx_ = o.ctx_;
+      gctx_ = o.gctx_;
+      o.gctx_ = NULL;
+    }
+    return *this;
+  }
+
+  ICC_AES_GCM_CTX *get() const noexcept { return gctx_; }
+
+  /*! @brief One shot encrypt, ICC_AES_GCM_Seal()
+    @param key the key, empty to keep the current one
+    @param out at least data.size() + gcm_tag_len, ciphertext then tag
+    @return the bytes written to out
+  */
+  std::size_t seal(bytes_view key, bytes_view iv, bytes_view aad, bytes_view data, mut_bytes out)
+  {
+    unsigned long outl = 0;
+
+    if(out.size() < (data.size() + gcm_tag_len)) {
+      detail::fail_arg("AES-GCM output buffer too small");
+    }
+    detail::check(ctx_, ICC_AES_GCM_Seal(ctx_, gctx_, iv.c_ptr(), iv.size(),
+                                         key.empty() ? NULL : key.c_ptr(), detail::to_uint(key.size()),
+                                         aad.c_ptr(), aad.size(), data.c_ptr(), data.size(),
+                                         out.data(), &outl),
+                  "ICC_AES_GCM_Seal");
+    return outl;
+  }
+  /*! @brief One shot decrypt and verify
+    @param key the key, empty to keep the current one
+    @param data ciphertext then tag
+    @param out at least data.size() - gcm_tag_len
+    @param outlen set to the plaintext length
+    @return false if the tag didn't match, out is cleared
+    @note a mismatch is an expected outcome so it isn't thrown, any other
+    failure (bad key length, IV reuse refused, library in error state) is.
+    ICC_AES_GCM_Open() returns 0 for all of those, so this runs
+    Init/DecryptUpdate/DecryptFinal itself to tell them apart.
+  */
+  bool open(bytes_view key, bytes_view iv, bytes_view aad, bytes_view data, mut_bytes out,
+            std::size_t &outlen)
+  {
+    unsigned long l = 0;
+    unsigned long fl = 0;
+    std::size_t clen = 0;
+    int rv = 0;
+
+    outlen = 0;
+    if((data.size() < gcm_tag_len) || (out.size() < (data.size() - gcm_tag_len))) {
+      detail::fail_arg("AES-GCM output buffer too small");
+    }
+    clen = data.size() - gcm_tag_len;
+    detail::check(ctx_, ICC_AES_GCM_Init(ctx_, gctx_, iv.c_ptr(), iv.size(),
+                                         key.empty() ? NULL : key.c_ptr(), detail::to_uint(key.size())),
+                  "ICC_AES_GCM_Init");
+    detail::check(ctx_, ICC_AES_GCM_DecryptUpdate(ctx_, gctx_, aad.c_ptr(), aad.size(), data.c_ptr(),
+                                                  clen, out.data(), &l),
+                  "ICC_AES_GCM_DecryptUpdate");
+    rv = ICC_AES_GCM_DecryptFinal(ctx_, gctx_, out.data() + l, &fl, data.c_ptr() + clen,
+                                  static_cast<unsigned int>(gcm_tag_len));
+    if(ICC_OSSL_FAILURE == rv) {
+      std::memset(out.data(), 0, clen);
+      return false;
+    }
+    detail::check(ctx_, rv, "ICC_AES_GCM_DecryptFinal");
+    outlen = l + fl;
+    return true;
+  }
+
+  /*! @brief Start a streamed message, ICC_AES_GCM_Init() */
+  gcm_ctx &init(bytes_view key, bytes_view iv)
+  {
+    detail::check(ctx_, ICC_AES_GCM_Init(ctx_, gctx_, iv.c_ptr(), iv.size(), key.c_ptr(),
+                                         detail::to_uint(key.size())),
+                  "ICC_AES_GCM_Init");
+    return *this;
+  }
+  /*! @brief ICC_AES_GCM_EncryptUpdate(), all the aad before any data
+    @param out at least data.size() plus one block
+    @return the bytes written to out
+  */
+  std::size_t encrypt_update(bytes_view aad, bytes_view data, mut_bytes out)
+  {
+    unsigned long outl = 0;
+
+    detail::check(ctx_, ICC_AES_GCM_EncryptUpdate(ctx_, gctx_, aad.c_ptr(), aad.size(), data.c_ptr(),
+                                                  data.size(), out.data(), &outl),
+                  "ICC_AES_GCM_EncryptUpdate");
+    return outl;
+  }
+  /*! @brief ICC_AES_GCM_DecryptUpdate(), all the aad before any data */
+  std::size_t decrypt_update(bytes_view aad, bytes_view data, mut_bytes out)
+  {
+    unsigned long outl = 0;
+
+    detail::check(ctx_, ICC_AES_GCM_DecryptUpdate(ctx_, gctx_, aad.c_ptr(), aad.size(), data.c_ptr(),
+                                                  data.size(), out.data(), &outl),
+                  "ICC_AES_GCM_DecryptUpdate");
+    return outl;
+  }
+  /*! @brief ICC_AES_GCM_EncryptFinal()
+    @param out remaining ciphertext, up to one block
+    @param tag gcm_tag_len bytes
+    @return the bytes written to out
+  */
+  std::size_t encrypt_final(mut_bytes out, mut_bytes tag)
+  {
+    unsigned long outl = 0;
+
+    if(tag.size() < gcm_tag_len) {
+      detail::fail_arg("AES-GCM tag buffer too small");
+    }
+    detail::check(ctx_, ICC_AES_GCM_EncryptFinal(ctx_, gctx_, out.data(), &outl, tag.data()),
+                  "ICC_AES_GCM_EncryptFinal");
+    return outl;
+  }
+  /*! @brief ICC_AES_GCM_DecryptFinal()
+    @param out remaining plaintext, up to one block
+    @param tag the tag to check
+    @param outlen set to the bytes written to out
+    @return false on a tag mismatch (0 from the C call), other failures
+    (ICC_FAILURE) are thrown
+  */
+  bool decrypt_final(mut_bytes out, bytes_view tag, std::size_t &outlen)
+  {
+    unsigned long outl = 0;
+    int rv = 0;
+
+    outlen = 0;
+    if(tag.empty() || (tag.size() > gcm_tag_len)) {
+      detail::fail_arg("AES-GCM tag length invalid");
+    }
+    rv = ICC_AES_GCM_DecryptFinal(ctx_, gctx_, out.data(), &outl, tag.c_ptr(),
+                                  static_cast<unsigned int>(tag.size()));
+    if(ICC_OSSL_FAILURE == rv) {
+      return false;
+    }
+    detail::check(ctx_, rv, "ICC_AES_GCM_DecryptFinal");
+    outlen = outl;
+    return true;
+  }
+
+private:
+  void reset() noexcept
+  {
+    if(NULL != gctx_) {
+      ICC_AES_GCM_CTX_free(ctx_, gctx_);
+      gctx_ = NULL;
+    }
+  }
+
+  ICC_CTX *ctx_;
+  ICC_AES_GCM_CTX *gctx_;
+};
+
+/*! @brief A private SP800-90 PRNG instance, ICC_PRNG_CTX */
+class rng_ctx {
+public:
+  /*! @brief Instantiate a PRNG
+    @param alg the PRNG name, "SHA256", "AES-256-ECB" ... @see ICC_get_RNGbyname()
+    @param strength the security strength wanted, 0 for the PRNG's default
+    @param pr prediction resistance, reseed on every call (slow)
+    @param person personalization string, may be empty
+  */
+  rng_ctx(const context &c, const char *alg, unsigned int strength = 0, bool pr = false,
+          bytes_view person = bytes_view())
+    : ctx_(c.get()), rctx_(NULL)
+  {
+    ICC_PRNG *prng = ICC_get_RNGbyname(ctx_, alg);
+    SP800_90STATE st = SP800_90ERROR;
+
+    if(NULL == prng) {
+      detail::fail(ctx_, "ICC_get_RNGbyname");
+    }
+    rctx_ = ICC_RNG_CTX_new(ctx_);
+    if(NULL == rctx_) {
+      detail::fail(ctx_, "ICC_RNG_CTX_new");
+    }
+    st = ICC_RNG_CTX_Init(ctx_, rctx_, prng, person.c_ptr(), detail::to_uint(person.size()),
+                          strength, pr ? 1 : 0);
+    if(!detail::rng_ok(st)) {
+      error e("ICC_RNG_CTX_Init", st);
+      reset();
+      throw e;
+    }
+  }
+  ~rng_ctx() { reset(); }
+  rng_ctx(const rng_ctx &) = delete;
+  rng_ctx &operator=(const rng_ctx &) = delete;
+  rng_ctx(rng_ctx &&o) noexcept : ctx_(o.ctx_), rctx_(o.rctx_) { o.rctx_ = NULL; }
+  rng_ctx &operator=(rng_ctx &&o) noexcept
+  {
+    if(this != &o) {
+      reset();
+      ctx_ = o.ctx_;
+      rctx_ = o.rctx_;
+      o.rctx_ = NULL;
+    }
+    return *this;
+  }
+
+  ICC_PRNG_CTX *get() const noexcept { return rctx_; }
+
+  /*! @brief ICC_RNG_Generate() */
+  void generate(mut_bytes out, bytes_view adata = bytes_view())
+  {
+    detail::check_rng(ICC_RNG_Generate(ctx_, rctx_, out.data(), detail::to_uint(out.size()),
+                                             adata.c_ptr(), detail::to_uint(adata.size())),
+                      "ICC_RNG_Generate");
+  }
+  /*! @brief Fill several buffers from one generate, ICC_RNG_GenerateV() */
+  void generate(std::initializer_list<mut_bytes> outs, bytes_view adata = bytes_view())
+  {
+    ICC_RNG_IOV iov[max_iov];
+    unsigned int n = detail::to_iov(outs, iov);
+    detail::check_rng(ICC_RNG_GenerateV(ctx_, rctx_, iov, n, adata.c_ptr(),
+                                              detail::to_uint(adata.size())),
+                      "ICC_RNG_GenerateV");
+  }
+
+private:
+  void reset() noexcept
+  {
+    if(NULL != rctx_) {
+      ICC_RNG_CTX_free(ctx_, rctx_);
+      rctx_ = NULL;
+    }
+  }
+
+  ICC_CTX *ctx_;
+  ICC_PRNG_CTX *rctx_;
+};
+
+}
+
+#endif /* INCLUDED_ICC_HPP */
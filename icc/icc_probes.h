@@ -0,0 +1,64 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description:
+//    Static (USDT) probes at the crypto hot paths, provider "icc".
+//    On Linux these are SystemTap SDT notes from <sys/sdt.h>, built in
+//    automatically when that header is installed (systemtap-sdt-dev or
+//    systemtap-sdt-devel), -DICC_NO_USDT leaves them out.
+//    Everywhere else, or without the header, they compile to nothing.
+//
+//    A disabled probe is a single nop, the arguments are only read
+//    by the tracer, so keep them to values already in registers.
+//
+//    e.g. bpftrace -e 'usdt:/path/libicclib085.so:icc:drbg__reseed__done
+//                      { @[arg1] = count(); }'
+//
+//    Probes, arguments in order
+//    drbg__generate__start ctx, bytes requested
+//    drbg__generate__done  ctx, SP800_90STATE
+//    drbg__reseed__start   ctx
+//    drbg__reseed__done    ctx, SP800_90STATE
+//    trng__gather          E_SOURCE, bytes, entropy estimate (x2)
+//    trng__health__fail    E_SOURCE, entropy estimate (x2), failures
+//    trng__fail            E_SOURCE
+//    rng__lock__wait       slot mutex
+//    rng__lock__acquired   slot mutex
+//    gcm__init             ctx, key length, iv length, rv
+//    gcm__final            ctx, 1 encrypt 0 decrypt, rv
+//    integrity__start      partial check
+//    integrity__opened     ICC_MAJOR_RC_ENUM
+//    integrity__done       ICC_MAJOR_RC_ENUM, CheckSig() result
+*************************************************************************/
+
+#if !defined(ICC_PROBES_H)
+#define ICC_PROBES_H
+
+#if defined(__linux__) && !defined(ICC_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define ICC_USDT 1
+#endif
+#endif
+
+#if defined(ICC_USDT)
+#define ICC_PROBE(n) DTRACE_PROBE(icc, n)
+#define ICC_PROBE1(n, a) DTRACE_PROBE1(icc, n, a)
+#define ICC_PROBE2(n, a, b) DTRACE_PROBE2(icc, n, a, b)
+#define ICC_PROBE3(n, a, b, c) DTRACE_PROBE3(icc, n, a, b, c)
+#define ICC_PROBE4(n, a, b, c, d) DTRACE_PROBE4(icc, n, a, b, c, d)
+#else
+#define ICC_PROBE(n)
+#define ICC_PROBE1(n, a)
+#define ICC_PROBE2(n, a, b)
+#define ICC_PROBE3(n, a, b, c)
+#define ICC_PROBE4(n, a, b, c, d)
+#endif
+
+#endif
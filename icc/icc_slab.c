@@ -0,0 +1,344 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*
+  Optional slab allocator behind CRYPTO_malloc()/CRYPTO_free(), and so
+  behind ICC_Malloc()/ICC_Free() and every OpenSSL object ICC creates.
+  Enabled with ICC_ALT_ALLOCATOR=slab.
+
+  Crypto code allocates and frees a lot of small objects of a few fixed
+  sizes (EVP_MD_CTX, EVP_CIPHER_CTX, BIGNUM's, HMAC_CTX) and with many
+  threads the system allocator lock becomes the bottleneck.
+
+  - Requests up to 1024 bytes are rounded up to one of a few size
+    classes and served from a per thread heap, no locking at all.
+  - Each block carries a 16 byte header naming the heap it came from.
+    A block freed by another thread is pushed onto that heap's remote
+    list with a compare and swap, the owner takes the whole list back
+    with one atomic exchange when it's own list runs out.
+    Taking everything at once means there's no ABA problem.
+  - When a thread exits it's heap goes onto an orphan list and the next
+    new thread adopts it, blocks still in use elsewhere can be freed into
+    it at any time.
+  - Larger requests go to malloc() with the same header.
+  - Memory is taken from the system in 64k chunks and kept for reuse,
+    it's never returned. Memory use will be higher than with the system
+    allocator.
+  - At library unload the TLS key is deleted so no thread exit
+    destructor is left pointing into an unmapped library. The heaps
+    are leaked, allocations after that go to malloc().
+
+  OpenSSL only allows the allocator to be changed before it's first
+  allocation, so this has to be decided while ICC loads and can't be
+  changed afterwards. Platforms without pointer sized atomics keep the
+  system allocator.
+*/
+
+#if defined(__GNUC__) && defined(__GCC_ATOMIC_POINTER_LOCK_FREE) && (2 == __GCC_ATOMIC_POINTER_LOCK_FREE)
+#define SLAB_ATOMICS
+#define SLAB_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define SLAB_CAS(p, o, n) __atomic_compare_exchange_n((p), &(o), (n), 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)
+#define SLAB_TAKE(p) __atomic_exchange_n((p), NULL, __ATOMIC_ACQUIRE)
+#elif defined(_WIN32)
+#define SLAB_ATOMICS
+#define SLAB_LOAD(p) (*(p))
+#define SLAB_CAS(p, o, n) ((o) == InterlockedCompareExchangePointer((PVOID volatile *)(p), (n), (o)))
+#define SLAB_TAKE(p) InterlockedExchangePointer((PVOID volatile *)(p), NULL)
+#endif
+
+#define SLAB_CLASSES 12          /*!< Number of size classes */
+#define SLAB_MAX 1024            /*!< Largest request served from a slab */
+#define SLAB_CHUNK (64 * 1024)   /*!< Bytes taken from the system at a time */
+#define SLAB_HDR 16              /*!< Header size, keeps 16 byte alignment */
+
+/*! @brief Size classes, all multiples of 16 */
+static const unsigned short slab_sizes[SLAB_CLASSES] = {
+  16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024
+};
+
+/*! @brief A free block, the link is kept where the caller's data was */
+typedef struct SLAB_BLK_t {
+  struct SLAB_BLK_t *next;
+} SLAB_BLK;
+
+/*! @brief One thread's heap */
+typedef struct SLAB_HEAP_t {
+  SLAB_BLK *local[SLAB_CLASSES];            /*!< Owner only */
+  SLAB_BLK * volatile remote[SLAB_CLASSES]; /*!< Freed by other threads */
+  unsigned char *bump;                      /*!< Unused part of the current chunk */
+  size_t left;                              /*!< Bytes left at bump */
+  struct SLAB_HEAP_t *next;                 /*!< Orphan list */
+} SLAB_HEAP;
+
+/*! @brief Block header, heap is NULL for blocks from malloc() */
+typedef union {
+  struct {
+    SLAB_HEAP *heap;  /*!< Owning heap */
+    size_t info;      /*!< Size class, or the size for malloc() blocks */
+  } h;
+  unsigned char pad[SLAB_HDR];
+} SLAB_HDR_T;
+
+static int slab_enabled = 0;       /*!< ICC_ALT_ALLOCATOR=slab was set */
+static int slab_active = 0;        /*!< OpenSSL accepted the allocator */
+static ICC_ThreadKey slab_key;     /*!< The calling thread's heap */
+static ICC_Mutex slab_mtx;         /*!< Protects the orphan list */
+static SLAB_HEAP *slab_orphans = NULL; /*!< Heaps from threads that exited */
+
+#if defined(SLAB_ATOMICS)
+
+static volatile int slab_closed = 0; /*!< slab_key was deleted at unload */
+
+/*! @brief Thread exit, leave the heap for the next new thread
+    @param ptr the heap
+*/
+static void ICC_TLS_CALLBACK slab_thread_exit(void *ptr)
+{
+  SLAB_HEAP *heap = (SLAB_HEAP *)ptr;
+
+  if ((NULL != heap) && !slab_closed) {
+    ICC_LockMutex(&slab_mtx);
+    heap->next = slab_orphans;
+    slab_orphans = heap;
+    ICC_UnlockMutex(&slab_mtx);
+  }
+}
+
+/*! @brief The calling thread's heap, adopts an orphan or creates one
+    @return the heap, or NULL if one couldn't be allocated
+*/
+static SLAB_HEAP *slab_heap(void)
+{
+  SLAB_HEAP *heap = NULL;
+
+  if (slab_closed) {
+    return NULL;
+  }
+  heap = (SLAB_HEAP *)ICC_GetThreadValue(&slab_key);
+  if (NULL == heap) {
+    ICC_LockMutex(&slab_mtx);
+    heap = slab_orphans;
+    if (NULL != heap) {
+      slab_orphans = heap->next;
+    }
+    ICC_UnlockMutex(&slab_mtx);
+    if (NULL == heap) {
+      heap = (SLAB_HEAP *)calloc(1, sizeof(SLAB_HEAP));
+    }
+    if (NULL != heap) {
+      heap->next = NULL;
+      ICC_SetThreadValue(&slab_key, heap);
+    }
+  }
+  return heap;
+}
+
+/*! @brief Smallest size class that holds sz bytes
+    @param sz the request, 1 to SLAB_MAX
+    @return the class index
+*/
+static int slab_class(size_t sz)
+{
+  int c = 0;
+  while (slab_sizes[c] < sz) {
+    c++;
+  }
+  return c;
+}
+
+/*! @brief A new block of class c, carved from the heap's chunk
+    @param heap the heap
+    @param c the size class
+    @return the block, header filled in, or NULL
+*/
+static SLAB_HDR_T *slab_carve(SLAB_HEAP *heap, int c)
+{
+  SLAB_HDR_T *hdr = NULL;
+  size_t need = SLAB_HDR + slab_sizes[c];
+
+  if (heap->left < need) {
+    /* The tail of the old chunk is abandoned, it's less than one block */
+    heap->bump = (unsigned char *)malloc(SLAB_CHUNK + SLAB_HDR);
+    if (NULL == heap->bump) {
+      heap->left = 0;
+      return NULL;
+    }
+    /* align, malloc() only promises 8 bytes on some platforms */
+    heap->bump += (SLAB_HDR - ((size_t)heap->bump % SLAB_HDR)) % SLAB_HDR;
+    heap->left = SLAB_CHUNK;
+  }
+  hdr = (SLAB_HDR_T *)heap->bump;
+  heap->bump += need;
+  heap->left -= need;
+  hdr->h.heap = heap;
+  hdr->h.info = (size_t)c;
+  return hdr;
+}
+
+/*! @brief CRYPTO_malloc() replacement
+    @param sz bytes wanted
+    @param file unused
+    @param line unused
+    @return the memory or NULL, NULL for 0 bytes as OpenSSL would
+*/
+static void *slab_malloc(size_t sz, const char *file, int line)
+{
+  SLAB_HEAP *heap = NULL;
+  SLAB_HDR_T *hdr = NULL;
+  SLAB_BLK *blk = NULL;
+  int c = 0;
+
+  if (0 == sz) {
+    return NULL;
+  }
+  if (sz <= SLAB_MAX) {
+    heap = slab_heap();
+  }
+  if (NULL == heap) {
+    if (sz > ((size_t)-1) - SLAB_HDR) {
+      return NULL;
+    }
+    hdr = (SLAB_HDR_T *)malloc(SLAB_HDR + sz);
+    if (NULL != hdr) {
+      hdr->h.heap = NULL;
+      hdr->h.info = sz;
+    }
+  } else {
+    c = slab_class(sz);
+    blk = heap->local[c];
+    if (NULL == blk) {
+      blk = (SLAB_BLK *)SLAB_TAKE(&(heap->remote[c]));
+    }
+    if (NULL != blk) {
+      heap->local[c] = blk->next;
+      hdr = ((SLAB_HDR_T *)blk) - 1;
+    } else {
+      hdr = slab_carve(heap, c);
+    }
+  }
+  return (NULL == hdr) ? NULL : (void *)(hdr + 1);
+}
+
+/*! @brief CRYPTO_free() replacement
+    @param ptr memory from slab_malloc() or NULL
+    @param file unused
+    @param line unused
+*/
+static void slab_free(void *ptr, const char *file, int line)
+{
+  SLAB_HDR_T *hdr = NULL;
+  SLAB_HEAP *owner = NULL;
+  SLAB_BLK *blk = (SLAB_BLK *)ptr;
+  SLAB_BLK *old = NULL;
+  int c = 0;
+
+  if (NULL != ptr) {
+    hdr = ((SLAB_HDR_T *)ptr) - 1;
+    owner = hdr->h.heap;
+    if (NULL == owner) {
+      free(hdr);
+    } else {
+      c = (int)hdr->h.info;
+      if (!slab_closed && (owner == (SLAB_HEAP *)ICC_GetThreadValue(&slab_key))) {
+        blk->next = owner->local[c];
+        owner->local[c] = blk;
+      } else {
+        do {
+          old = (SLAB_BLK *)SLAB_LOAD(&(owner->remote[c]));
+          blk->next = old;
+        } while (!SLAB_CAS(&(owner->remote[c]), old, blk));
+      }
+    }
+  }
+}
+
+/*! @brief CRYPTO_realloc() replacement
+    @param ptr memory from slab_malloc() or NULL
+    @param sz the new size, 0 frees ptr
+    @param file unused
+    @param line unused
+    @return the memory or NULL, ptr is untouched on failure
+*/
+static void *slab_realloc(void *ptr, size_t sz, const char *file, int line)
+{
+  SLAB_HDR_T *hdr = NULL;
+  void *nptr = NULL;
+  size_t have = 0;
+
+  if (NULL == ptr) {
+    return slab_malloc(sz, file, line);
+  }
+  if (0 == sz) {
+    slab_free(ptr, file, line);
+    return NULL;
+  }
+  hdr = ((SLAB_HDR_T *)ptr) - 1;
+  if (NULL == hdr->h.heap) {
+    if ((sz > SLAB_MAX) && (sz <= ((size_t)-1) - SLAB_HDR)) {
+      hdr = (SLAB_HDR_T *)realloc(hdr, SLAB_HDR + sz);
+      if (NULL != hdr) {
+        hdr->h.info = sz;
+      }
+      return (NULL == hdr) ? NULL : (void *)(hdr + 1);
+    }
+    have = hdr->h.info;
+  } else {
+    have = slab_sizes[hdr->h.info];
+    if (sz <= have) {
+      return ptr;
+    }
+  }
+  nptr = slab_malloc(sz, file, line);
+  if (NULL != nptr) {
+    memcpy(nptr, ptr, (have < sz) ? have : sz);
+    slab_free(ptr, file, line);
+  }
+  return nptr;
+}
+#endif
+
+/*! @brief Install the slab allocator if ICC_ALT_ALLOCATOR=slab was set
+    @note Must run before OpenSSL's first allocation
+*/
+static void slab_init(void)
+{
+#if defined(SLAB_ATOMICS)
+  if (slab_enabled && !slab_active) {
+    if (0 != ICC_CreateMutex(&slab_mtx)) {
+      return;
+    }
+    if (0 != ICC_CreateThreadKey(&slab_key, slab_thread_exit)) {
+      ICC_DestroyMutex(&slab_mtx);
+      return;
+    }
+    if (1 == CRYPTO_set_mem_functions(slab_malloc, slab_realloc, slab_free)) {
+      slab_active = 1;
+    } else {
+      /* Too late, OpenSSL has already allocated memory */
+      MARK("ICC_ALT_ALLOCATOR", "CRYPTO_set_mem_functions() refused");
+      ICC_DestroyThreadKey(&slab_key);
+      ICC_DestroyMutex(&slab_mtx);
+    }
+  }
+#endif
+}
+
+/*! @brief Library unload, delete the TLS key
+    Per thread heaps, and anything still allocated from them, are
+    leaked. The allocator has to stay installed, OpenSSL may still free
+    slab blocks, those go onto the owning heap's remote list.
+*/
+static void slab_final(void)
+{
+#if defined(SLAB_ATOMICS)
+  if (slab_active && !slab_closed) {
+    slab_closed = 1;
+    ICC_DestroyThreadKey(&slab_key);
+  }
+#endif
+}
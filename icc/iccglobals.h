@@ -255,8 +255,9 @@ typedef enum {
   ICC_MUTEX_ERROR                 = 13, /*!< We expected a mutex to be set and it wasn't */
   ICC_UNABLE_TO_SET               = 14, /*!< ICC cannot set a value */
   ICC_NOT_ENOUGH_MEMORY           = 15, /*!< malloc() failed */
-  ICC_ALREADY_ATTACHED            = 16  /*!< ICC_Attach called, but this call 
+  ICC_ALREADY_ATTACHED            = 16, /*!< ICC_Attach called, but this call 
 					  has already been made */
+  ICC_WOULD_BLOCK                 = 17  /*!< A non-blocking call couldn't complete without waiting, retry */
 } ICC_MINOR_RC_ENUM ;
 
 /*! @brief 
@@ -399,6 +400,10 @@ typedef enum {
 				   - "TRNG_HW" (default)
 				   - "TRNG_OS"
 				   - "TRNG_FIPS"
+				   - "TRNG_CPACF" (z Systems, z14 and later)
+				   - "TRNG_DARN" (POWER9 and later, Linux)
+				   - "TRNG_RNDR" (ARMv8.5-RNG, Linux)
+				   - "TRNG_HWRNG" (/dev/hwrng, virtio-rng, Linux)
 			    */
   ICC_INDUCED_FAILURE = 11,     /*!< Set to an active value (>0)
 				  before ICC_Init is called for the first time 
@@ -453,6 +458,10 @@ typedef enum {
 				        to reduce impacts of locking on the system RNG's
 				        Default is 7
 				     - Valid values 1-255. (<b>R/W1</b>)
+				     - The environment variable ICC_RNG_INSTANCES also accepts
+				       "auto", the pool is then sized from the online CPU count
+				       and grows at runtime under lock contention. 
+				       ICC_GetValue() returns the current size.
 				     - FIPS: Allowed in FIPS mode
 				       - Reason. PRNGS/TRNGS are still approved design
 				*/
@@ -472,6 +481,11 @@ typedef enum {
 				     - FIPS: Allowed in FIPS mode
 				       - Reason. Changes underly allocator used. Out of scope.
 				     - Note: Environment variable. "yes" or "1".
+				     - The environment variable (or ICCSIG.txt entry)
+				       ICC_ALT_ALLOCATOR=slab selects per thread
+				       size class slabs for all OpenSSL and ICC
+				       allocations on any platform. ICC_GetValue()
+				       returns "slab" when that is active, else "off"
 				*/
   ICC_SHIFT = 18,   /*!< Manual RNG tuning. ONLY use after direct
                          instruction from GSkit L3. This disables
@@ -501,6 +515,95 @@ typedef enum {
                                       To clear the callback, close the context and
                                       create a new one.
                                 */                                    				
+  ICC_TRNG_FAILOVERS = 21,      /*!< Number of seed requests served by the warm
+                                     standby NRBG (ICC_RNG_STANDBY) after the 
+                                     active NRBG failed (<b>RO</b>)
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - informational only
+                                */
+  ICC_PBKDF2_THREADS = 22,      /*!< The number of threads ICC_PKCS5_PBKDF2_HMAC() may
+                                     use when asked for more than one digest length 
+                                     of output. Each output block is an independent
+                                     iteration chain and runs on it's own thread.
+                                     Default 1 (off), process wide.
+                                   - Valid values 1-8 (<b>R/W</b>), can be changed at any time
+                                   - The environment variable ICC_PBKDF2_THREADS 
+                                     sets the default
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - the results are unchanged
+                                */
+  ICC_STARTUP_TIMES = 23,       /*!< Per phase startup timings for this ICC instance,
+                                     returned as an ICC_STARTUP_TIMING structure (<b>RO</b>)
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - informational only
+                                */
+  ICC_CTX_CACHE = 24,           /*!< The number of freed EVP_MD_CTX, EVP_CIPHER_CTX
+                                     and HMAC_CTX contexts each thread keeps, reset,
+                                     for reuse by the next ..._new(). Bounds the memory
+                                     retained. Default 0 (off), process wide.
+                                   - Valid values 0-64 (<b>R/W</b>), can be changed at any time
+                                   - The environment variable ICC_CTX_CACHE 
+                                     sets the default
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - contexts are reset before reuse
+                                */
+  ICC_CTX_CACHE_STATS = 25,     /*!< Context reuse counts, summed over all threads,
+                                     returned as an ICC_CTX_CACHE_COUNTS structure (<b>RO</b>)
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - informational only
+                                */
+  ICC_MEM_PROFILE = 26,         /*!< Allocation profiling, the sampling rate n set by 
+                                     the environment variable ICC_MEM_PROFILE=n at load,
+                                     0 if profiling is off or paused.
+                                   - Set 0 to pause recording, non-zero to resume (<b>R/W</b>).
+                                     Can't be turned on if it wasn't enabled at load
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - informational only
+                                */
+  ICC_MEM_SITES = 27,           /*!< Allocation counts by call site, an array of
+                                     ICC_MEM_SITE structures, largest live bytes first.
+                                     As many sites as fit are returned, unused entries
+                                     are zeroed (<b>RO</b>)
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - informational only
+                                */
+  ICC_API_STATS = 28,           /*!< Per API call counts and latency histograms, 
+                                     kept by the ICC stub layer (icc.c). 1 on, 0 off, 
+                                     default off, setting 1 also clears the counts so far.
+                                   - <b>R/W</b>, can be changed at any time
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - informational only
+                                */
+  ICC_API_STATS_DATA = 29,      /*!< The counts, an array of ICC_API_STAT structures,
+                                     one per API called at least once, in call table 
+                                     order. Unused entries are zeroed, room for 
+                                     NUM_ICCFUNCTIONS entries always suffices (<b>RO</b>)
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - informational only
+                                */
+  ICC_RNG_STATS = 30,           /*!< Usage counts for each RNG pool slot and per thread
+                                     RNG, an array of ICC_RNG_STAT structures. As many
+                                     as fit are returned, unused entries are zeroed,
+                                     room for 2 * ICC_RNG_INSTANCES is enough unless
+                                     per thread RNG's are in use (<b>RO</b>)
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - informational only
+                                */
+  ICC_CPU_FEATURES = 31,        /*!< The CPU features the accelerated code paths use, 
+                                     probed once at load after ICC_CAP_MASK is applied.
+                                     A ' ' separated list of names, "aesni pclmul avx2" 
+                                     for example, empty if there are none.
+                                     256 bytes is always enough (<b>RO</b>)
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - informational only
+                                */
+  ICC_VERIFY_CACHE_STATS = 32,  /*!< Signature verification cache counts, 
+                                     returned as an ICC_VERIFY_CACHE_COUNTS structure.
+                                     entries is 0 if ICC_VERIFY_CACHE is off, or 
+                                     not used by this context (<b>RO</b>)
+                                   - FIPS: Allowed in FIPS mode
+                                     - Reason - informational only
+                                */
   GSK_ICC_ACTIVE_LIBS = 52     /*!< Integer bit mask, the low two bits are used.
                                      Bit 0 = 1 the FIPS library is loadable
                                      Bit 1 = 1 the non-FIPS library is loadable
@@ -552,12 +655,18 @@ typedef enum {
     ICC_NID_X9_62_id_ecPublicKey = 408 /*!< EC Public key */  	
 } ICC_EC_NID_ENUM ;
 
-  /*! @brief mode for setting AES_GCM acceleration level, no longer has an effect */ 
+  /*! @brief mode for setting AES_GCM acceleration level, only ICC_GCM_ACCEL_direct has an effect */ 
 #define ICC_AES_GCM_CTRL_SET_ACCEL 0
-  /*! @brief mode for getting AES_GCM acceleration level, always 1 */
+  /*! @brief mode for getting AES_GCM acceleration level, 1, or ICC_GCM_ACCEL_direct if that's in use */
 #define ICC_AES_GCM_CTRL_GET_ACCEL 1
- /*! @brief Force check of TLSV1.3 compatible GCM IV rollover, set only, no parameters */ 
+ /*! @brief Force check of TLSV1.3 compatible GCM IV rollover, set only. 
+     With ptr the 12 byte static IV (accel 12) selects record mode, see ICC_AES_GCM_RecordSeal() */ 
 #define ICC_AES_GCM_CTRL_TLS13 2
+ /*! @brief Force check of TLSV1.2 compatible GCM IV rollover, set only. 
+     With ptr the 4 byte salt (accel 4) selects record mode, see ICC_AES_GCM_RecordSeal() */ 
+#define ICC_AES_GCM_CTRL_TLS12 4
+ /*! @brief Length of the nonce prefix for ICC_AES_GCM_SegmentSeal()/ICC_AES_GCM_SegmentOpen() */
+#define ICC_AES_GCM_SEG_NONCELEN 7
 
 
 /*!
@@ -569,7 +678,11 @@ typedef enum ICC_GCM_ACCEL {
   ICC_GCM_ACCEL_level1,         /*!< Uses a 256 byte table to speed up GHASH computation */
   ICC_GCM_ACCEL_level2,         /*!< Uses a 4 Kbyte table to speed up GHASH computation */
   ICC_GCM_ACCEL_level3,         /*!< Uses an 8 Kbyte table to speed up GHASH computation */
-  ICC_GCM_ACCEL_level4          /*!< Uses a 64 Kbyte table to speed up GHASH computation */
+  ICC_GCM_ACCEL_level4,         /*!< Uses a 64 Kbyte table to speed up GHASH computation */
+  ICC_GCM_ACCEL_direct          /*!< s390x, POWER8 and later and ARMv8 only: drive CPACF KMA, 
+                                     vcipher/vpmsumd or AESE/PMULL directly rather than via EVP, 
+                                     fails if the instructions aren't available. 
+                                     Any other value switches back */
 } ICC_GCM_ACCEL;
 
 /*! 
@@ -621,7 +734,11 @@ typedef enum {
   SP800_90_GETMAXNONCE,   /*!< Returns the maximum nonce allowed in this mode */
   SP800_90_SETAUTO,       /*!< Set the autoreseed status - defaults to on (!0) */
   SP800_90_GETAUTO,       /*! Get the autoreseed status 0 == off !0 == on */
-  SP800_90_SET_PARANOID   /*!< Set prediction resistance mode, continually reseed. (slow) */
+  SP800_90_SET_PARANOID,  /*!< Set prediction resistance mode, continually reseed. (slow) */
+  SP800_90_GETRETRIES     /*!< Returns the number of noise buffers the health tests
+                             have discarded in the TRNG used for seeding this RNG,
+                             or in the case of a TRNG, it's own count
+                         */
 } SP800_90CTRL;
 
 /*
@@ -654,6 +771,151 @@ struct ICC_STATUS_t
 
 typedef struct ICC_STATUS_t ICC_STATUS;
 
+#define ICC_KAT_GROUPS 6 /*!< Entries in ICC_STARTUP_TIMING.kat */
+
+/* Known answer test groups for ICC_SelfTestGroup(), may be or'ed together */
+#define ICC_KAT_NEXT    0  /*!< The next group in a round robin schedule */
+#define ICC_KAT_SIG     1  /*!< RSA/DSA/ECDSA sign/verify */
+#define ICC_KAT_CORE    2  /*!< DRBG and digests */
+#define ICC_KAT_PKEY    4  /*!< Asymmetric pair-wise, RSA cipher, DH and ECDH */
+#define ICC_KAT_MAC     8  /*!< HMAC and CMAC */
+#define ICC_KAT_CIPHER  16 /*!< Symmetric ciphers and key wrap */
+#define ICC_KAT_KDF     32 /*!< SP800-108, HKDF, TLS PRF and PBKDF2 */
+#define ICC_KAT_ALL     63 /*!< Everything, as ICC_SelfTest() */
+
+/* Operation types for ICC_BATCH_OP, see ICC_BATCH_Run() */
+#define ICC_BATCH_DIGEST    1 /*!< Hash in with md, to out */
+#define ICC_BATCH_HMAC      2 /*!< HMAC in with md and key, to out */
+#define ICC_BATCH_AEAD_SEAL 3 /*!< GCM or ChaCha20-Poly1305 encrypt in to out, tag written */
+#define ICC_BATCH_AEAD_OPEN 4 /*!< GCM or ChaCha20-Poly1305 decrypt in to out, tag checked */
+#define ICC_BATCH_SIGN      5 /*!< Sign in with pkey and md, signature to out */
+#define ICC_BATCH_VERIFY    6 /*!< Verify the signature in out over in with pkey and md */
+#define ICC_BATCH_VERIFY_DIGEST 7 /*!< Verify the signature in out over the digest in, made with md, grouped by pkey */
+#define ICC_BATCH_DERIVE    8 /*!< Key agreement, pkey's private key with the peer public value in, secret to out */
+
+/* Operation types for ICC_PKEY_JOB_Submit() */
+#define ICC_PKEY_JOB_SIGN    1 /*!< EVP_PKEY_sign() of a digest */
+#define ICC_PKEY_JOB_DECRYPT 2 /*!< EVP_PKEY_decrypt() */
+
+/*! EC_KEY flag, ICC_EC_KEY_set_flags() before ICC_EC_KEY_generate_key().
+  The key is for ECDH only, in FIPS mode key generation checks it with
+  Q = d.G (FIPS 140-3 IG 10.3.A) rather than an ECDSA sign/verify. 
+  The caller must not sign with it. Clear of the OpenSSL EC_FLAG_ bits. 
+*/
+#define ICC_EC_FLAG_KEY_AGREEMENT 0x4000
+
+/*! @brief Startup timings returned by ICC_GetValue(ICC_STARTUP_TIMES)
+  All times are in microseconds, 0 if the phase hasn't run (yet).
+  kat[] is indexed by known answer test group, 0 signature, 1 RNG and digest,
+  2 public key, 3 MAC, 4 cipher, 5 KDF. With ICC_CONDITIONAL_POST the deferred 
+  groups are filled in on first use.
+*/
+typedef struct ICC_STARTUP_TIMING_t {
+  unsigned long long load;      /*!< Library load to the end of POST, ICCLoad() */
+  unsigned long long config;    /*!< Locating the install and reading ICCSIG.txt */
+  unsigned long long openssl;   /*!< OpenSSL initialization, includes rng_init */
+  unsigned long long calibrate; /*!< TRNG timer calibration, CalcShift() */
+  unsigned long long rng_init;  /*!< RNG pool instantiation, RAND_FIPS_init() */
+  unsigned long long integrity; /*!< Library integrity check */
+  unsigned long long kat[ICC_KAT_GROUPS]; /*!< Known answer tests by group */
+} ICC_STARTUP_TIMING;
+
+/*! @brief Context reuse counts returned by ICC_GetValue(ICC_CTX_CACHE_STATS)
+  Counts are kept per thread and summed when read, so they are approximate 
+  while other threads are running.
+*/
+typedef struct ICC_CTX_CACHE_COUNTS_t {
+  unsigned long long hits;    /*!< ..._new() calls served from a free list */
+  unsigned long long misses;  /*!< ..._new() calls that allocated, list empty */
+  unsigned long long dropped; /*!< Frees that released the context, list full */
+} ICC_CTX_CACHE_COUNTS;
+
+/*! @brief Signature verification cache counts returned by 
+  ICC_GetValue(ICC_VERIFY_CACHE_STATS), process wide
+*/
+typedef struct ICC_VERIFY_CACHE_COUNTS_t {
+  unsigned long long entries; /*!< Cache size, 0 if it's not in use */
+  unsigned long long hits;    /*!< Verifies answered from the cache */
+  unsigned long long misses;  /*!< Lookups that found nothing, or an expired entry */
+  unsigned long long stored;  /*!< Good signatures added */
+  unsigned long long evicted; /*!< Entries replaced by another signature, set full */
+} ICC_VERIFY_CACHE_COUNTS;
+
+/*! Latency buckets in an ICC_API_STAT */
+#define ICC_API_BUCKETS 144
+
+/*! @brief Smallest latency in ns counted in bucket b of ICC_API_STAT.hist.
+  Buckets 0-3 are 0-3ns, after that each power of 2 is split into 4, so
+  a bucket is within 25% of the latencies in it. The last bucket also 
+  counts everything longer.
+*/
+#define ICC_API_BUCKET_NS(b) (((b) < 4) ? (unsigned long long)(b) : \
+                              ((4ULL + ((b) & 3)) << (((b) >> 2) - 1)))
+
+/*! @brief One API's counts returned by ICC_GetValue(ICC_API_STATS_DATA)
+  Counts are kept per thread and summed when read, so they are approximate 
+  while other threads are running. Calls through ICC_..._direct() 
+  function pointers aren't counted.
+*/
+typedef struct ICC_API_STAT_t {
+  char name[32];                 /*!< The API, as in the call table */
+  unsigned long long calls;      /*!< Calls */
+  unsigned long long total_ns;   /*!< Time spent in those calls */
+  unsigned long long max_ns;     /*!< Longest call */
+  unsigned long long hist[ICC_API_BUCKETS]; /*!< Calls by latency, see ICC_API_BUCKET_NS() */
+} ICC_API_STAT;
+
+/*! @brief One call site returned by ICC_GetValue(ICC_MEM_SITES)
+  Only 1 in n allocations is counted, the counts are scaled by n and are
+  estimates unless ICC_MEM_PROFILE=1. file is the end of the path if 
+  it's too long to fit.
+*/
+typedef struct ICC_MEM_SITE_t {
+  char file[48];              /*!< Allocating source file */
+  int line;                   /*!< Allocating source line */
+  unsigned long long allocs;  /*!< Allocations */
+  unsigned long long frees;   /*!< Frees */
+  unsigned long long live;    /*!< Bytes still allocated */
+  unsigned long long peak;    /*!< Highest live bytes */
+} ICC_MEM_SITE;
+
+/*! ICC_TryGenerateRandomSeed() return values */
+#define ICC_SEED_READY       1  /*!< The seed was generated */
+#define ICC_SEED_WOULDBLOCK  0  /*!< Not without waiting, the callback runs when a retry should succeed */
+#define ICC_SEED_FAILED     -1  /*!< The seed source failed */
+
+/*! ICC_RNG_STAT.pool values */
+#define ICC_RNG_POOL_PRNG   1   /*!< The pool behind ICC_RAND_bytes() */
+#define ICC_RNG_POOL_SEED   2   /*!< The pool behind ICC_GenerateRandomSeed() */
+#define ICC_RNG_THREAD_PRNG 3   /*!< A thread's own ICC_RAND_bytes() RNG */
+#define ICC_RNG_THREAD_SEED 4   /*!< A thread's own ICC_GenerateRandomSeed() RNG */
+
+/*! @brief One RNG returned by ICC_GetValue(ICC_RNG_STATS)
+  Counts since the RNG was instantiated. Pool slots are read under the
+  slot lock, per thread RNG's are read while their thread may be using
+  them, so their counts are approximate.
+*/
+typedef struct ICC_RNG_STAT_t {
+  int pool;                     /*!< ICC_RNG_POOL_..., ICC_RNG_THREAD_..., 0 unused */
+  int slot;                     /*!< Slot in the pool, or thread RNG number */
+  unsigned int entropy;         /*!< Seed source entropy estimate, 0-100 */
+  unsigned long long generates; /*!< Calls to the DRBG, output cache refills count once */
+  unsigned long long bytes;     /*!< Bytes those calls returned */
+  unsigned long long reseeds;   /*!< Reseeds */
+  unsigned long long gather_ns; /*!< Time in reseeds waiting on the seed source */
+  unsigned long long retries;   /*!< Seed source buffers discarded by the health tests */
+  unsigned long long waits;     /*!< Times a thread found the slot locked */
+  unsigned long long wait_ns;   /*!< Time those threads waited */
+  unsigned long long trng_bytes; /*!< Memory the seed source instance holds, a shared
+                                      seed source is reported by each RNG using it */
+} ICC_RNG_STAT;
+
+/*! @brief One output of ICC_RNG_GenerateV() / ICC_RAND_bytes_v() */
+typedef struct {
+  unsigned char *buf;           /*!< Where to put the bytes */
+  unsigned int len;             /*!< How many */
+} ICC_RNG_IOV;
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 
 
 #include "iccversion.h"
@@ -62,7 +63,12 @@ unsigned long d[10];
 */
 #define TRACE_CODE 1
 
+/* Binary trace timestamps come from the cycle counter, TRNG/timer_entropy.c */
+ICC_UINT64 RdCTR_raw();
+#define TRACE_CLOCK() RdCTR_raw()
+
 #include "tracer.h"
+#include "icc_probes.h"
 
 #if defined(_WIN32)
 #   define strdup(x) _strdup(x)
@@ -73,6 +79,29 @@ extern int ex_loops,ex_shift;
 extern int Shift();
 extern unsigned int Loops();
 extern int isFipsTrng(TRNG_TYPE t);
+extern int Set_calibration_file(const char *path);
+extern int SetEntropyEstimator(int mode);
+extern int ALT4_SetBulk(int on);
+extern int SetSharedTRNG(int n);
+extern int SetStandbyTRNGName(char *name);
+extern unsigned int GetTRNGFailovers(void);
+extern unsigned long long calibrate_us;
+static int SetPBKDF2Threads(int n);
+static int ParallelPOST(ICC_STATUS *status,int groups);
+static int CondKAT(int group);
+static int SelfTestGroups(ICClib *pcb,ICC_STATUS *status,int groups);
+static void TimedKAT(ICClib *pcb,ICC_STATUS *status,int groups);
+static void SetRSAPoolDepth(int n);
+static void RSAPoolStop(void);
+static void SetECPoolDepth(int n);
+static void ECPoolStop(void);
+static void pool_fork_prepare(void);
+static void pool_fork_parent(void);
+static void pool_fork_child(void);
+static void rsa_tc_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad,
+                        int idx, long argl, void *argp);
+static void SetPKEYJobThreads(int n);
+static void PKEYJobStop(void);
 
 /* Prototype for the FIPS compliant keygen function */
 
@@ -93,6 +122,7 @@ int my_EVP_DigestInit(EVP_MD_CTX *ctx,const EVP_MD *md);
 int my_EVP_DigestFinal(EVP_MD_CTX *ctx,unsigned char *md,unsigned int *size);
 
 int my_RAND_bytes(unsigned char *buf,int n);
+int my_RAND_bytes_v(const ICC_RNG_IOV *iov,unsigned int cnt);
 int my_EVP_PKEY_encrypt_new(EVP_PKEY_CTX *ctx, 
 			    unsigned char *out, size_t *outlen,
 			    const unsigned char *in, size_t inlen);
@@ -101,9 +131,17 @@ int my_EVP_PKEY_decrypt_new(EVP_PKEY_CTX *ctx,
 			    const unsigned char *in, size_t inlen);
 int my_EVP_PKEY_keygen(ICClib *pcb, EVP_PKEY_CTX *cctx, EVP_PKEY **pk);
 int my_EVP_CIPHER_CTX_free(EVP_CIPHER_CTX * x);
+EVP_MD_CTX *my_EVP_MD_CTX_new(void);
+EVP_CIPHER_CTX *my_EVP_CIPHER_CTX_new(void);
+HMAC_CTX *my_HMAC_CTX_new(void);
+void my_HMAC_CTX_free(HMAC_CTX *ctx);
 int my_EVP_DigestSignInit(ICClib *pcb,EVP_MD_CTX *ctx, EVP_PKEY_CTX **pctx,const EVP_MD *type, ENGINE *e, EVP_PKEY *pkey);
 int my_EVP_DigestVerifyInit(ICClib *pcb,EVP_MD_CTX *ctx, EVP_PKEY_CTX **pctx,const EVP_MD *type, ENGINE *e, EVP_PKEY *pkey);
+int my_EVP_DigestVerifyFinal(ICClib *pcb,EVP_MD_CTX *ctx,unsigned char *sig, size_t siglen);
+int my_EVP_DigestVerify(ICClib *pcb,EVP_MD_CTX *md_ctx, const unsigned char *sigret, size_t siglen, const unsigned char *tbs, size_t tbslen);
+int my_ECDSA_verify(ICClib *pcb,int type, const unsigned char *dgst,int dgstlen, const unsigned char *sig,int siglen, EC_KEY *eckey);
 int my_SP800_38F_KW(ICClib *pcb,unsigned char *in, int inl, unsigned char *out, int *outl, unsigned char *key, int kl,unsigned int flags) ;
+int my_SP800_38F_CTX_Init(ICClib *pcb,SP800_38F_CTX *ctx,unsigned char *key,int kl) ;
 int my_EVP_PKEY_sign_init(ICClib *pcb,EVP_PKEY_CTX *pctx);
 int my_EVP_PKEY_verify_init(ICClib *pcb,EVP_PKEY_CTX *pctx);
 void my_GHASH(AES_GCM_CTX *gcm_ctx,unsigned char *H,unsigned char *Hash,unsigned char *data,unsigned long datalen);
@@ -118,13 +156,30 @@ int my_RSA_public_decrypt(ICClib *pcb,int flen, unsigned char *from,unsigned cha
 int my_DH_compute_key(ICClib *pcb,unsigned char *key,BIGNUM *pub_key,DH *dh);
 int my_DH_compute_key_padded(ICClib *pcb,unsigned char *key,BIGNUM *pub_key,DH *dh);
 int my_PKCS5_PBKDF2_HMAC(ICClib *pcb,const char *pass, int passlen, const unsigned char *salt, int saltlen, int iters, const EVP_MD *digest, int keylen, unsigned char *out);
+int my_PBKDF2_HMAC_Batch(ICClib *pcb,const EVP_MD *digest,PBKDF2_REC *recs,unsigned int n);
+int my_DIGEST_Multi(ICClib *pcb,const EVP_MD *md,DIGEST_REC *recs,unsigned int n);
+int my_XOF_CTX_Init(ICClib *pcb,XOF_CTX *ctx,const EVP_MD *md);
+int my_XOF_CTX_InitCustom(ICClib *pcb,XOF_CTX *ctx,const EVP_MD *md,const unsigned char *N,size_t Nlen,const unsigned char *S,size_t Slen);
+int my_PHASH_CTX_Init(ICClib *pcb,PHASH_CTX *ctx,const EVP_MD *md,size_t B,const unsigned char *S,size_t Slen);
+int my_HMAC_KEY_Init(ICClib *pcb,HMAC_KEY *hk,const EVP_MD *digest,const unsigned char *key,int keylen);
+int my_KMAC_KEY_Init(ICClib *pcb,KMAC_KEY *kk,const EVP_MD *md,const unsigned char *key,size_t keylen,const unsigned char *S,size_t Slen);
+int my_TLS_PRF_Init(ICClib *pcb,TLS_PRF_CTX *ctx,const EVP_MD *md,const unsigned char *secret,int seclen);
+int my_TLS_PRF_KeyBlock(ICClib *pcb,TLS_PRF_CTX *ctx,const EVP_MD *md,const unsigned char *pms,int pmslen,const unsigned char *crandom,const unsigned char *srandom,const unsigned char *shash,int shashlen,unsigned char *master,unsigned char *keyblock,int kblen);
+int my_ECDSA_POOL_Fill(ICClib *pcb,ECDSA_POOL *pool,unsigned int n);
+ECDSA_SIG *my_ECDSA_POOL_Sign(ICClib *pcb,ECDSA_POOL *pool,const unsigned char *dgst,int dlen);
+int my_BATCH_Run(ICClib *pcb,BATCH_OP *ops,unsigned int n);
+int my_PKEY_JOB_Submit(ICClib *pcb,PKEY_JOB *job,EVP_PKEY *pkey,int op,const EVP_MD *md,int padding,const unsigned char *in,size_t inlen,void (*cb)(void *arg),void *arg);
 unsigned char *HKDF_Extract(ICClib *pcb,const EVP_MD *evp_md,const unsigned char *salt, size_t salt_len,const unsigned char *key, size_t key_len,unsigned char *prk, size_t *prk_len);
 unsigned char *HKDF_Expand(ICClib *pcb,const EVP_MD *evp_md,const unsigned char *prk, size_t prk_len,const unsigned char *info, size_t info_len,unsigned char *okm, size_t okm_len);
 unsigned char *HKDF(ICClib *pcb,const EVP_MD *evp_md,const unsigned char *salt, size_t salt_len,const unsigned char *key, size_t key_len,const unsigned char *info, size_t info_len,unsigned char *okm, size_t okm_len);
+int HKDF_CTX_Init(ICClib *pcb,HKDF_CTX *ctx,const EVP_MD *evp_md,const unsigned char *prk, size_t prk_len);
+int HKDF_CTX_Extract(ICClib *pcb,HKDF_CTX *ctx,const EVP_MD *evp_md,const unsigned char *salt, size_t salt_len,const unsigned char *key, size_t key_len);
+unsigned char *HKDF_CTX_Expand(ICClib *pcb,HKDF_CTX *ctx,const unsigned char *info, size_t info_len,unsigned char *okm, size_t okm_len);
 int dsa_paramgen_check_g(DSA *dsa);
 
 /* From extsig.c */
 int CheckSig(FILE *fin,FILE *targ,EVP_PKEY *rsaPKey,int SigFileOnly);
+int CheckSigCached(FILE *fin,FILE *targ,EVP_PKEY *rsaPKey,int SigFileOnly,const char *cache);
 int ReadConfigItems(FILE *fin, char *tweaks[], int n);
 /* from fips.c */
 EVP_PKEY *get_pubkey(ICC_STATUS *stat);
@@ -158,7 +213,9 @@ int RSA_FixEncodingZeros(RSA* pri, const RSA* pub, int allowDisableBlinding);
 int InternalIntegrityCheck(ICClib *pcb,ICC_STATUS *status,int partial);
 int IntegrityCheck(ICClib *pcb,ICC_STATUS *status);
 
+void ALT_Setup(void); /* Lock used while opening the OS entropy sources */
 void ALT_Final(); /* Clean up the fd used for /dev/random */
+void HWRNG_Final(void); /* and /dev/hwrng */
 /*
  *-----------------------------------------------------------------------------
  * INCLUDED source. 
@@ -167,6 +224,30 @@ void ALT_Final(); /* Clean up the fd used for /dev/random */
 /* Drop in code for digsetbyname,cipherbyname */
 #include "nid_cache.c"
 
+/* Optional slab allocator, ICC_ALT_ALLOCATOR=slab */
+#include "icc_slab.c"
+
+/* Per thread context free lists, ICC_CTX_CACHE */
+#include "ctx_cache.c"
+
+/* Sampled allocation accounting by call site, ICC_MEM_PROFILE */
+#include "mem_prof.c"
+
+/* SP800-185 ParallelHash, ICC_PHASH_THREADS */
+#include "phash.c"
+
+/* Signature verification result cache, ICC_VERIFY_CACHE */
+#include "verify_cache.c"
+
+/* Threaded prime search for RSA keygen, ICC_RSA_KEYGEN_THREADS */
+#include "rsa_par.c"
+
+/* Faster DH/DSA parameters, ICC_PARAMGEN_THREADS, ICC_DH_NAMED_GROUPS */
+#include "param_par.c"
+
+/* RSA offload to Crypto Express adapters, ICC_ZCRYPT */
+#include "zcrypt.c"
+
 /* Include the function table */
 #include "icclib_a.c"
 
@@ -191,6 +272,28 @@ static int config_run_post = 1;
 #endif
 static char *exclude_list = NULL; /*!< List of excluded RNG modes */
 static int trng_set = 0; /*!< Some clever for TRNG handling in testing */
+static int pbkdf2_threads = 1; /*!< Threads used per multi-block PBKDF2 call */
+static int parallel_post = 0; /*!< Run the POST groups and integrity check concurrently */
+static int conditional_post = 0; /*!< Defer all but KA_GROUP_CORE to first use */
+static char *integrity_cache = NULL; /*!< Library digest cache, ICC_INTEGRITY_CACHE */
+static int integrity_cache_fips = 0; /*!< Use it in the FIPS module too */
+static int ka_pending = 0; /*!< KA_GROUP_ bits still to be tested before use */
+static int ka_failed = 0; /*!< KA_GROUP_ bits whose conditional tests failed */
+static ICC_Mutex ka_mtx; /*!< Serializes the conditional tests */
+static ICC_STARTUP_TIMING startup_times; /*!< Returned by ICC_STARTUP_TIMES */
+static int rsa_pool_depth = 0; /*!< Pre-generated RSA keys held per size, 0 is off */
+static ICC_Mutex rsa_pool_mtx; /*!< Protects the RSA key pool */
+static int ec_pool_depth = 0; /*!< Pre-generated ephemeral EC/X25519 keys held per curve, 0 is off */
+static ICC_Mutex ec_pool_mtx; /*!< Protects the ephemeral key pool */
+static int pool_fork_hooked = 0; /*!< The key pools are reset in a fork() child, see pool_fork_child() */
+static int rsa_tc_idx = -1; /*!< RSA ex_data index for RSA_ThreadCache() clones */
+static ICC_Mutex rsa_tc_mtx; /*!< Protects the thread numbering */
+static ICC_ThreadKey rsa_tc_key; /*!< Each thread's number for RSA_ThreadCache() */
+static size_t rsa_tc_next = 0; /*!< The last thread number handed out */
+static int pkey_job_threads = 2; /*!< Workers for PKEY_JOB_Submit(), 0 if the queue couldn't be set up */
+static size_t secure_heap_size = 0; /*!< ICC_SECURE_HEAP, bytes, 0 is off */
+static ICC_Mutex pkey_job_mtx; /*!< Protects the PKEY_JOB queue and job states */
+static ICC_Sem pkey_job_sem; /*!< Counts queued PKEY_JOBs, wakes the workers */
 const char ICC_SCCSInfo[] =
 {
     "@(#)CompanyName:      IBM Corporation\n"
@@ -272,6 +375,9 @@ static unsigned int icc_failure_mask = 0;
 */
 unsigned int clean_at_exit = 0;
 
+/*! @brief ICC_FAST_EXIT, unload only scrubs secrets, see ICCUnload() */
+static int fast_exit = 0;
+
 
 static void OpenSSL_Init(ICClib *pcb,ICC_STATUS * status);
 static void OpenSSL_Cleanup();
@@ -286,6 +392,25 @@ static void iccLoadErr(ICC_STATUS* status);
 void OPENSSL_cpuid_setup(void);
 
 
+/*! @brief Set up OpenSSL's secure heap if ICC_SECURE_HEAP was set
+    @note OpenSSL does the mlock(), MADV_DONTDUMP and guard pages,
+    OPENSSL_secure_malloc() falls back to the heap if this wasn't done.
+*/
+static void secure_heap_init(void)
+{
+  size_t sz = 65536;
+  int rc = 0;
+
+  if (0 != secure_heap_size) {
+    while ((sz < secure_heap_size) && (sz < ((size_t)1 << 30))) {
+      sz <<= 1;
+    }
+    rc = CRYPTO_secure_malloc_init(sz, 16);
+    MARK("ICC_SECURE_HEAP", (1 == rc) ? "Locked" : 
+         ((2 == rc) ? "Not locked, mlock() failed" : "Not available"));
+  }
+}
+
 /* Legacy, from when these could be set at startup */
 
 void *ICC_Malloc(size_t sz, const char *file, int line)
@@ -331,7 +456,11 @@ static unsigned char x2bin(unsigned char b)
   return c;
 
 }
-/* Called from the status code when a fatal error is tripped */
+/* Called from the status code when a fatal error is tripped 
+   The error table is copied over the live one in place, the generated 
+   stubs must keep loading (*pcb->funcs)[n].func on every call rather than
+   caching it, or a disabled function would stay callable
+*/
 void DisableAPI(void) 
 {
    memcpy(ICCGlobal_default, ICCGlobal_Error, sizeof(ICCGlobal_default));
@@ -373,6 +502,30 @@ static int set_cap(const char *cptr, unsigned long long *cap)
   }
   return temp;
 }
+/*! @brief parse an ICC_RNG_INSTANCES setting, a count or "auto" */
+static int rng_instances(const char *val)
+{
+  int i = 0;
+  if (0 == strcasecmp(val, "auto")) {
+    i = RNG_INSTANCES_AUTO;
+  } else {
+    i = atoi(val);
+  }
+  return i;
+}
+/*! @brief Set or clear the library digest cache path
+    @param path the cache, NULL or "" for none
+*/
+static void SetIntegrityCache(const char *path)
+{
+  if(NULL != integrity_cache) {
+    free(integrity_cache);
+    integrity_cache = NULL;
+  }
+  if((NULL != path) && ('\0' != *path)) {
+    integrity_cache = strdup(path);
+  }
+}
 static void EnvVars()
 {
   unsigned long long cap = (unsigned long long)(-1LL);
@@ -457,17 +610,159 @@ static void EnvVars()
   /*! \EnvVar ICC_RNG_INSTANCES
     - Sets the number of RNG's in the thread pool. Used to improve scaling
       on really large systems.
+    - "auto" sizes the pool from the online CPU count and grows it 
+      at runtime if threads contend for the pool locks.
     - FIPS mode: Yes
    */
 
   tmp = getenv("ICC_RNG_INSTANCES");
   if(NULL != tmp) {
     MARK("ICC_RNG_INSTANCES", tmp);
+    SetRNGInstances(rng_instances(tmp));
+  }
+  /*! \EnvVar ICC_RNG_PER_THREAD
+    - Give each thread it's own RNG's rather than sharing the pool. 
+      Removes lock contention in heavily threaded processes at the 
+      cost of one RNG pair per thread. 
+    - Usage: export ICC_RNG_PER_THREAD=1
+    - FIPS mode: Yes
+   */
+
+  tmp = getenv("ICC_RNG_PER_THREAD");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_PER_THREAD", tmp);
+    i = atoi(tmp);
+    SetRNGPerThread(i);
+  }
+  /*! \EnvVar ICC_RNG_CACHE
+    - Size in bytes of an output cache held by each system RNG.
+      Requests of 64 bytes or less (nonces, IV's) are then served 
+      from the cache, which is refilled in bulk. 
+      Default 0 (off), maximum 16384.
+    - Usage: export ICC_RNG_CACHE=4096
+    - FIPS mode: Yes
+   */
+
+  tmp = getenv("ICC_RNG_CACHE");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_CACHE", tmp);
+    i = atoi(tmp);
+    SetRNGCache(i);
+  }
+  /*! \EnvVar ICC_RNG_RESEED_THREAD
+    - Start a worker thread which gathers entropy for the pooled 
+      DRBG's ahead of their scheduled reseeds, so a request never
+      waits on the entropy source. 
+    - Usage: export ICC_RNG_RESEED_THREAD=1
+    - FIPS mode: Yes
+   */
+
+  tmp = getenv("ICC_RNG_RESEED_THREAD");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_RESEED_THREAD", tmp);
+    i = atoi(tmp);
+    SetRNGReseedThread(i);
+  }
+  /*! \EnvVar ICC_RNG_SEED_COALESCE
+    - RAND_seed() calls with data no longer reseed the seed DRBG from 
+      the entropy source under it's lock. The data is accumulated and 
+      used as additional input on that DRBG's next generate. 
+      Scheduled reseeds, and RAND_seed(NULL,0), still reseed.
+    - Usage: export ICC_RNG_SEED_COALESCE=1
+    - FIPS mode: Yes
+   */
+
+  tmp = getenv("ICC_RNG_SEED_COALESCE");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_SEED_COALESCE", tmp);
+    i = atoi(tmp);
+    SetRNGSeedCoalesce(i);
+  }
+  /*! \EnvVar ICC_RNG_PARALLEL
+    - RAND_bytes() requests of 1MB or more are split across this many 
+      of the pooled seed DRBG's, each segment generated on it's own 
+      thread by it's own DRBG instance. 0 or 1, the default, disables it.
+      Limited to the number of RNG instances.
+    - Usage: export ICC_RNG_PARALLEL=8
+    - FIPS mode: Yes, every segment comes from an approved DRBG
+   */
+
+  tmp = getenv("ICC_RNG_PARALLEL");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_PARALLEL", tmp);
+    i = atoi(tmp);
+    SetRNGParallel(i);
+  }
+  /*! \EnvVar ICC_RNG_BATCH
+    - RAND_bytes()/ICC_GenerateRandomSeed() requests of 128 bytes or less 
+      which find their pooled seed DRBG busy queue up and are served 
+      together by the next generate on it, split between the callers.
+      Each request is still served by a generate that started after it 
+      arrived. Applies to the pools, not ICC_RNG_PER_THREAD DRBG's.
+    - Usage: export ICC_RNG_BATCH=1
+    - FIPS mode: Yes
+   */
+
+  tmp = getenv("ICC_RNG_BATCH");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_BATCH", tmp);
+    i = atoi(tmp);
+    SetRNGBatch(i);
+  }
+  /*! \EnvVar ICC_RNG_NUMA
+    - Callers pick their pooled RNG by the CPU they run on rather than 
+      by thread id, and on multi socket systems only use the RNG's 
+      assigned to their own NUMA node, whose state is allocated there.
+      Most useful with ICC_RNG_INSTANCES=auto.
+    - Usage: export ICC_RNG_NUMA=1
+    - FIPS mode: Yes
+   */
+
+  tmp = getenv("ICC_RNG_NUMA");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_NUMA", tmp);
     i = atoi(tmp);
-    SetRNGInstances(i);
+    SetRNGNuma(i);
+  }
+  /*! \EnvVar ICC_FAST_EXIT
+    - Library unload only erases secret state (DRBG state, seed and 
+      output buffers, pooled RSA keys) and stops ICC's worker threads.
+      The per object frees, cache releases and OpenSSL cleanup are 
+      skipped, the process is exiting and they only touch cold memory.
+      Speeds up teardown of short lived processes with large RNG pools.
+    - Only for processes which keep ICC loaded until exit. If the library
+      is unloaded earlier everything it allocated is leaked, the TLS
+      keys are still deleted so threads can exit safely afterwards.
+      Any thread still inside an RNG call at unload has it fail, other
+      ICC calls racing the unload are unsafe, as without ICC_FAST_EXIT.
+    - Usage: export ICC_FAST_EXIT=1
+    - FIPS mode: Yes, secrets are still zeroized
+   */
+
+  tmp = getenv("ICC_FAST_EXIT");
+  if(NULL != tmp) {
+    MARK("ICC_FAST_EXIT", tmp);
+    fast_exit = atoi(tmp) ? 1 : 0;
+  }
+  /*! \EnvVar ICC_RNG_LAZY_TEST
+    - Only the system DRBG type runs it's known answer tests during POST,
+      other DRBG types run them on their first instantiation.
+      Reduces startup time for short lived processes.
+    - Usage: export ICC_RNG_LAZY_TEST=1
+    - FIPS mode: Yes, each DRBG type is still tested before first use
+   */
+
+  tmp = getenv("ICC_RNG_LAZY_TEST");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_LAZY_TEST", tmp);
+    SetRNGLazyTest(atoi(tmp));
   }
   /*! \EnvVar ICC_TRNG
     - Sets the type of the TRNG used by default.
+    - TRNG_CPACF uses the CPACF PRNO TRNG directly on z14 and later
+    - TRNG_DARN uses the DARN instruction directly on POWER9 and later
+    - TRNG_RNDR uses the RNDRRS register directly on ARMv8.5 and later
+    - TRNG_HWRNG reads /dev/hwrng on Linux, virtio-rng in a VM
    */
 
   
@@ -477,6 +772,318 @@ static void EnvVars()
     SetTRNGName((char *)tmp);
     trng_set = 1;
   }
+  /*! \EnvVar ICC_RNG_SHARED_TRNG
+    - Usage: ICC_RNG_SHARED_TRNG=n (1-8)
+    - All DRBG's seed from n shared NRBG instances per type rather than 
+      each owning one, cuts startup time and memory with large RNG pools
+    - Default 0, every DRBG has it's own NRBG
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_RNG_SHARED_TRNG");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_SHARED_TRNG", tmp);
+    SetSharedTRNG(atoi(tmp));
+  }
+  /*! \EnvVar ICC_RNG_STANDBY
+    - Usage: ICC_RNG_STANDBY=<NRBG name> i.e. TRNG_OS
+    - Keeps a second, already health tested NRBG of that type ready, if the
+      active NRBG fails it's health tests requests switch to it immediately
+    - The number of requests it served is available as ICC_TRNG_FAILOVERS
+    - FIPS mode: Yes, but only a FIPS approved NRBG can be the standby
+   */
+  tmp = getenv("ICC_RNG_STANDBY");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_STANDBY", tmp);
+    SetStandbyTRNGName((char *)tmp);
+  }
+  /*! \EnvVar ICC_HW_TRNG_BULK
+    - Usage: ICC_HW_TRNG_BULK=1
+    - TRNG_HW sub-mode, issue RDSEED/DARN/RNDRRS directly and back to back
+      rather than one OPENSSL_HW_rand() call per word
+    - Ignored where the CPU lacks the instruction
+    - FIPS mode: No
+   */
+  tmp = getenv("ICC_HW_TRNG_BULK");
+  if(NULL != tmp) {
+    MARK("ICC_HW_TRNG_BULK", tmp);
+    ALT4_SetBulk(atoi(tmp));
+  }
+  /*! \EnvVar ICC_PBKDF2_THREADS
+    - Usage: ICC_PBKDF2_THREADS=n (1-8)
+    - PBKDF2 calls asking for more than one digest length of output
+      compute the output blocks on up to n threads, default 1
+    - Also settable at runtime as ICC_PBKDF2_THREADS via ICC_SetValue()
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_PBKDF2_THREADS");
+  if(NULL != tmp) {
+    MARK("ICC_PBKDF2_THREADS", tmp);
+    SetPBKDF2Threads(atoi(tmp));
+  }
+  /*! \EnvVar ICC_PARALLEL_POST
+    - Usage: ICC_PARALLEL_POST=1
+    - During ICC_Attach run the library integrity check, the signature
+      known answer tests and the remaining known answer tests on
+      separate threads, default 0 (one after another)
+    - The same tests run and any failure is still fatal
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_PARALLEL_POST");
+  if(NULL != tmp) {
+    MARK("ICC_PARALLEL_POST", tmp);
+    parallel_post = atoi(tmp);
+  }
+  /*! \EnvVar ICC_CONDITIONAL_POST
+    - Usage: ICC_CONDITIONAL_POST=1
+    - FIPS 140-3 conditional self tests. POST only runs the RNG and
+      digest known answer tests, the signature, public key, MAC, cipher
+      and KDF groups run on the first use of an algorithm in that group
+    - A failing group makes its algorithms unusable and is fatal as in POST
+    - ICC_SelfTest() still runs everything
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_CONDITIONAL_POST");
+  if(NULL != tmp) {
+    MARK("ICC_CONDITIONAL_POST", tmp);
+    conditional_post = atoi(tmp);
+  }
+  /*! \EnvVar ICC_INTEGRITY_CACHE
+    - Usage: ICC_INTEGRITY_CACHE=/path/to/cache
+    - The library's SHA-256 digest is cached, keyed by device, inode, 
+      size, mtime and ctime, so the integrity check at load skips 
+      hashing the library while it's unchanged. The RSA signature is 
+      still verified every time, a cached digest that fails is ignored
+    - The cache and it's directory must be owned by root and not group 
+      or world writable, else it's ignored. Only root processes update 
+      it, each record carries an HMAC keyed with the library signature
+    - ICC_IntegrityCheck() always hashes the library. Unix only
+    - Default unset, off. Also read from ICCSIG.txt
+    - FIPS mode: Not used by the FIPS module unless 
+      ICC_INTEGRITY_CACHE_FIPS=1 as well
+   */
+  tmp = getenv("ICC_INTEGRITY_CACHE");
+  if(NULL != tmp) {
+    MARK("ICC_INTEGRITY_CACHE", tmp);
+    SetIntegrityCache(tmp);
+  }
+  /*! \EnvVar ICC_INTEGRITY_CACHE_FIPS
+    - Usage: ICC_INTEGRITY_CACHE_FIPS=1
+    - Allow ICC_INTEGRITY_CACHE in the FIPS module. Leave unset where 
+      policy requires the module to be hashed at every load
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_INTEGRITY_CACHE_FIPS");
+  if(NULL != tmp) {
+    MARK("ICC_INTEGRITY_CACHE_FIPS", tmp);
+    integrity_cache_fips = atoi(tmp);
+  }
+  /*! \EnvVar ICC_RSA_KEY_POOL
+    - Usage: ICC_RSA_KEY_POOL=n (1-16)
+    - A background thread keeps up to n RSA key pairs ready for each
+      key size and public exponent requested, keygen calls without a
+      callback take one from the pool when there's one available
+    - Pooled keys have already passed the pair-wise consistency test
+    - Sizes are learned from the calls made, the first call for a size
+      still generates in line. Default 0, off
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_RSA_KEY_POOL");
+  if(NULL != tmp) {
+    MARK("ICC_RSA_KEY_POOL", tmp);
+    SetRSAPoolDepth(atoi(tmp));
+  }
+  /*! \EnvVar ICC_EC_KEY_POOL
+    - Usage: ICC_EC_KEY_POOL=n (1-64)
+    - A background thread keeps up to n ephemeral key pairs ready for
+      each of X25519, X448 and the named EC curves requested, 
+      EVP_PKEY_keygen() takes one from the pool when there's one 
+      available. Each key is handed out once
+    - Pooled keys have already passed the pair-wise consistency test
+    - Curves are learned from the calls made, the first call for a 
+      curve still generates in line. Pooled keys are discarded in a
+      forked child. Default 0, off
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_EC_KEY_POOL");
+  if(NULL != tmp) {
+    MARK("ICC_EC_KEY_POOL", tmp);
+    SetECPoolDepth(atoi(tmp));
+  }
+  /*! \EnvVar ICC_PKEY_JOB_THREADS
+    - Usage: ICC_PKEY_JOB_THREADS=n (1-16)
+    - The number of worker threads that run RSA/EC private key 
+      operations queued with ICC_PKEY_JOB_Submit(). Started on the
+      first submission. Default 2
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_PKEY_JOB_THREADS");
+  if(NULL != tmp) {
+    MARK("ICC_PKEY_JOB_THREADS", tmp);
+    SetPKEYJobThreads(atoi(tmp));
+  }
+  /*! \EnvVar ICC_PHASH_THREADS
+    - Usage: ICC_PHASH_THREADS=n (1-16)
+    - The most threads one ICC_PHASH_CTX_Update() call uses to hash
+      ParallelHash leaves, each gets at least 256KB. 1 hashes on the
+      caller's thread only. Default one per CPU, up to 16
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_PHASH_THREADS");
+  if(NULL != tmp) {
+    MARK("ICC_PHASH_THREADS", tmp);
+    SetPHashThreads(atoi(tmp));
+  }
+  /*! \EnvVar ICC_RSA_KEYGEN_THREADS
+    - Usage: ICC_RSA_KEYGEN_THREADS=n (1-16)
+    - Search for the primes of one RSA key on n threads, the first 
+      prime found is used. 2048 bit and larger keys generated with 
+      no callback only. Default 1, off
+    - FIPS mode: Yes, the candidates are tested as in the FIPS 
+      module keygen
+   */
+  tmp = getenv("ICC_RSA_KEYGEN_THREADS");
+  if(NULL != tmp) {
+    MARK("ICC_RSA_KEYGEN_THREADS", tmp);
+    SetRSAKeygenThreads(atoi(tmp));
+  }
+  /*! \EnvVar ICC_PARAMGEN_THREADS
+    - Usage: ICC_PARAMGEN_THREADS=n (1-16)
+    - Run n independent DH or DSA parameter searches at once, the 
+      first to finish is returned. 2048 bit and larger parameters 
+      requested with no callback (and no DSA seed) only. Default 1, off
+    - FIPS mode: Yes, DH/DSA parameter generation is never FIPS compliant
+   */
+  tmp = getenv("ICC_PARAMGEN_THREADS");
+  if(NULL != tmp) {
+    MARK("ICC_PARAMGEN_THREADS", tmp);
+    SetParamGenThreads(atoi(tmp));
+  }
+  /*! \EnvVar ICC_DH_NAMED_GROUPS
+    - Usage: ICC_DH_NAMED_GROUPS=1
+    - ICC_DH_generate_parameters() with generator 2 returns the 
+      RFC 7919 ffdhe group for 2048, 3072, 4096, 6144 and 8192 bits,
+      and RFC 3526 group 5 for 1536 bits, rather than generating new 
+      parameters. Default 0, off
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_DH_NAMED_GROUPS");
+  if(NULL != tmp) {
+    MARK("ICC_DH_NAMED_GROUPS", tmp);
+    dh_named_groups = atoi(tmp);
+  }
+  /*! \EnvVar ICC_ZCRYPT
+    - Usage: ICC_ZCRYPT=bits (0-4096)
+    - Linux on Z. Send RSA operations on keys of at least bits to the 
+      Crypto Express adapters through /dev/z90crypt, falling back to 
+      software for anything the adapters can't do. Default 0, off
+    - FIPS mode: No, the FIPS module ignores this
+   */
+  tmp = getenv("ICC_ZCRYPT");
+  if(NULL != tmp) {
+    MARK("ICC_ZCRYPT", tmp);
+    SetZcrypt(atoi(tmp));
+  }
+  /*! \EnvVar ICC_VERIFY_CACHE
+    - Usage: ICC_VERIFY_CACHE=n (0-1048576)
+    - Remember up to n signatures that verified, keyed by a hash of the 
+      public key, digest algorithm, message digest and signature. Verifying 
+      one again returns 1 without the public key operation. Used by 
+      RSA_verify(), ECDSA_verify(), EVP_DigestVerifyFinal() and 
+      EVP_DigestVerify(). Failures are never cached
+    - Hit rates are returned by ICC_GetValue(ICC_VERIFY_CACHE_STATS)
+    - Default 0, off 
+    - FIPS mode: Not used by the FIPS module unless 
+      ICC_VERIFY_CACHE_FIPS=1 as well
+   */
+  tmp = getenv("ICC_VERIFY_CACHE");
+  if(NULL != tmp) {
+    MARK("ICC_VERIFY_CACHE", tmp);
+    SetVerifyCache(atoi(tmp));
+  }
+  /*! \EnvVar ICC_VERIFY_CACHE_TTL
+    - Usage: ICC_VERIFY_CACHE_TTL=seconds
+    - How long an ICC_VERIFY_CACHE entry is trusted. Default 300
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_VERIFY_CACHE_TTL");
+  if(NULL != tmp) {
+    MARK("ICC_VERIFY_CACHE_TTL", tmp);
+    SetVerifyCacheTTL(atoi(tmp));
+  }
+  /*! \EnvVar ICC_VERIFY_CACHE_FIPS
+    - Usage: ICC_VERIFY_CACHE_FIPS=1
+    - Allow ICC_VERIFY_CACHE in FIPS mode. Leave unset where policy 
+      requires every signature to be verified
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_VERIFY_CACHE_FIPS");
+  if(NULL != tmp) {
+    MARK("ICC_VERIFY_CACHE_FIPS", tmp);
+    verify_cache_fips = atoi(tmp);
+  }
+  /*! \EnvVar ICC_ALT_ALLOCATOR
+    - Usage: ICC_ALT_ALLOCATOR=slab
+    - All OpenSSL and ICC allocations up to 1024 bytes come from per 
+      thread size class slabs, a block freed on another thread is handed 
+      back without locking. Removes malloc lock contention in heavily 
+      threaded processes, memory use will increase
+    - Only takes effect while ICC loads, also read from ICCSIG.txt.
+      Platforms without pointer sized atomics ignore it
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_ALT_ALLOCATOR");
+  if(NULL != tmp) {
+    MARK("ICC_ALT_ALLOCATOR", tmp);
+    slab_enabled = (0 == strcasecmp(tmp, "slab"));
+  }
+  /*! \EnvVar ICC_MEM_PROFILE
+    - Usage: ICC_MEM_PROFILE=n
+    - Counts 1 in n OpenSSL and ICC allocations against the file and 
+      line that made them, allocations, frees, live and peak bytes per 
+      site. The sites are returned by ICC_GetValue(ICC_MEM_SITES), 
+      ICC_SetValue(ICC_MEM_PROFILE) pauses and resumes recording
+    - Adds a 16 byte header to every allocation, use a large n in 
+      production. Combines with ICC_ALT_ALLOCATOR
+    - Only takes effect while ICC loads, also read from ICCSIG.txt.
+      Platforms without 64 bit atomics ignore it
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_MEM_PROFILE");
+  if(NULL != tmp) {
+    MARK("ICC_MEM_PROFILE", tmp);
+    prof_rate = (size_t)strtoul(tmp, NULL, 10);
+  }
+  /*! \EnvVar ICC_CTX_CACHE
+    - Usage: ICC_CTX_CACHE=n (0-64)
+    - Each thread keeps up to n freed EVP_MD_CTX, EVP_CIPHER_CTX and 
+      HMAC_CTX contexts, reset, for the next ..._new() call. Default 0, off
+    - Also settable at runtime as ICC_CTX_CACHE via ICC_SetValue(),
+      hit rates are returned by ICC_GetValue(ICC_CTX_CACHE_STATS)
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_CTX_CACHE");
+  if(NULL != tmp) {
+    MARK("ICC_CTX_CACHE", tmp);
+    SetCtxCacheDepth(atoi(tmp));
+  }
+  /*! \EnvVar ICC_SECURE_HEAP
+    - Usage: ICC_SECURE_HEAP=n (bytes, rounded up to a power of 2, 64k - 1G)
+    - Key material is allocated from one locked pool: mlock()'d, 
+      excluded from core dumps, guard pages either side. 
+      DRBG states and output caches, AES-GCM contexts and the RSA/EC/DH 
+      private key BIGNUM's OpenSSL creates come from it
+    - Allocation stays on the pool's free lists, nothing is locked per 
+      object. When the pool is full allocations fall back to the heap
+    - Only takes effect while ICC loads, also read from ICCSIG.txt. 
+      Unix only, ignored elsewhere
+    - Default 0, off
+    - FIPS mode: Yes
+   */
+  tmp = getenv("ICC_SECURE_HEAP");
+  if(NULL != tmp) {
+    MARK("ICC_SECURE_HEAP", tmp);
+    secure_heap_size = (size_t)strtoul(tmp, NULL, 10);
+  }
   /*! \EnvVar ICC_RANDOM_GENERATOR
     - Sets the type of the PRNG used by default.
     - TRNG, the default timer based entropy source on most platforms.
@@ -511,6 +1118,30 @@ static void EnvVars()
     i = atoi(tmp);
     Set_rng_setup(i);
   }
+  /*! \EnvVar ICC_RNG_CALIBRATION
+    - Usage: ICC_RNG_CALIBRATION=<file>
+    - Persists the TRNG timer calibration (shift/loops) in <file> and reuses it
+      on later loads, a quick sanity probe replaces full calibration
+    - The file must be owned by the current user and not group/world writable
+    - FIPS mode: Yes, the TRNG health tests still apply
+  */
+  tmp = getenv("ICC_RNG_CALIBRATION");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_CALIBRATION", tmp);
+    Set_calibration_file(tmp);
+  }
+  /*! \EnvVar ICC_RNG_ESTIMATOR
+    - Usage: ICC_RNG_ESTIMATOR=0|1
+    - Selects the long term entropy check on TRNG output
+    - 0 (default) zlib compression ratio, 1 streaming most common value
+      byte histogram which is stricter and much cheaper per byte
+    - FIPS mode: Yes
+  */
+  tmp = getenv("ICC_RNG_ESTIMATOR");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_ESTIMATOR", tmp);
+    SetEntropyEstimator(atoi(tmp));
+  }
   /*! \EnvVar ICC_SHIFT
     - Manual setting of RNG modes
     - May be required to bypass problems on virtualized systems/new hardware
@@ -639,7 +1270,61 @@ void SetParams(char *params[],int n)
         if (0 == strncmp(params[i], "ICC_RNG_INSTANCES",
                          strlen("ICC_RNG_INSTANCES"))) {
           MARK("ICC_RNG_INSTANCES", ptr);
-          SetRNGInstances(atoi(ptr));
+          SetRNGInstances(rng_instances(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_RNG_PER_THREAD",
+                         strlen("ICC_RNG_PER_THREAD"))) {
+          MARK("ICC_RNG_PER_THREAD", ptr);
+          SetRNGPerThread(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_RNG_CACHE",
+                         strlen("ICC_RNG_CACHE"))) {
+          MARK("ICC_RNG_CACHE", ptr);
+          SetRNGCache(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_RNG_RESEED_THREAD",
+                         strlen("ICC_RNG_RESEED_THREAD"))) {
+          MARK("ICC_RNG_RESEED_THREAD", ptr);
+          SetRNGReseedThread(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_RNG_SEED_COALESCE",
+                         strlen("ICC_RNG_SEED_COALESCE"))) {
+          MARK("ICC_RNG_SEED_COALESCE", ptr);
+          SetRNGSeedCoalesce(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_RNG_PARALLEL",
+                         strlen("ICC_RNG_PARALLEL"))) {
+          MARK("ICC_RNG_PARALLEL", ptr);
+          SetRNGParallel(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_RNG_BATCH",
+                         strlen("ICC_RNG_BATCH"))) {
+          MARK("ICC_RNG_BATCH", ptr);
+          SetRNGBatch(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_RNG_NUMA",
+                         strlen("ICC_RNG_NUMA"))) {
+          MARK("ICC_RNG_NUMA", ptr);
+          SetRNGNuma(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_FAST_EXIT",
+                         strlen("ICC_FAST_EXIT"))) {
+          MARK("ICC_FAST_EXIT", ptr);
+          fast_exit = atoi(ptr) ? 1 : 0;
+        }
+
+        if (0 == strncmp(params[i], "ICC_RNG_LAZY_TEST",
+                         strlen("ICC_RNG_LAZY_TEST"))) {
+          MARK("ICC_RNG_LAZY_TEST", ptr);
+          SetRNGLazyTest(atoi(ptr));
         }
 
         if (0 == strncmp(params[i], "ICC_TRNG", strlen("ICC_TRNG"))) {
@@ -666,6 +1351,104 @@ void SetParams(char *params[],int n)
            MARK("ICC_RNG_SETUP", ptr);
            Set_rng_setup(atoi(ptr));
         }
+        if (0 == strncmp(params[i], "ICC_RNG_CALIBRATION", strlen("ICC_RNG_CALIBRATION"))) {
+           MARK("ICC_RNG_CALIBRATION", ptr);
+           Set_calibration_file(ptr);
+        }
+        if (0 == strncmp(params[i], "ICC_RNG_ESTIMATOR", strlen("ICC_RNG_ESTIMATOR"))) {
+           MARK("ICC_RNG_ESTIMATOR", ptr);
+           SetEntropyEstimator(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_RNG_SHARED_TRNG", strlen("ICC_RNG_SHARED_TRNG"))) {
+           MARK("ICC_RNG_SHARED_TRNG", ptr);
+           SetSharedTRNG(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_RNG_STANDBY", strlen("ICC_RNG_STANDBY"))) {
+           MARK("ICC_RNG_STANDBY", ptr);
+           SetStandbyTRNGName(ptr);
+        }
+        if (0 == strncmp(params[i], "ICC_HW_TRNG_BULK", strlen("ICC_HW_TRNG_BULK"))) {
+           MARK("ICC_HW_TRNG_BULK", ptr);
+           ALT4_SetBulk(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_PBKDF2_THREADS", strlen("ICC_PBKDF2_THREADS"))) {
+           MARK("ICC_PBKDF2_THREADS", ptr);
+           SetPBKDF2Threads(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_PARALLEL_POST", strlen("ICC_PARALLEL_POST"))) {
+           MARK("ICC_PARALLEL_POST", ptr);
+           parallel_post = atoi(ptr);
+        }
+        if (0 == strncmp(params[i], "ICC_CONDITIONAL_POST", strlen("ICC_CONDITIONAL_POST"))) {
+           MARK("ICC_CONDITIONAL_POST", ptr);
+           conditional_post = atoi(ptr);
+        }
+        if (0 == strncmp(params[i], "ICC_ALT_ALLOCATOR", strlen("ICC_ALT_ALLOCATOR"))) {
+           MARK("ICC_ALT_ALLOCATOR", ptr);
+           slab_enabled = (0 == strcasecmp(ptr, "slab"));
+        }
+        if (0 == strncmp(params[i], "ICC_MEM_PROFILE", strlen("ICC_MEM_PROFILE"))) {
+           MARK("ICC_MEM_PROFILE", ptr);
+           prof_rate = (size_t)strtoul(ptr, NULL, 10);
+        }
+        if (0 == strncmp(params[i], "ICC_CTX_CACHE", strlen("ICC_CTX_CACHE"))) {
+           MARK("ICC_CTX_CACHE", ptr);
+           SetCtxCacheDepth(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_SECURE_HEAP", strlen("ICC_SECURE_HEAP"))) {
+           MARK("ICC_SECURE_HEAP", ptr);
+           secure_heap_size = (size_t)strtoul(ptr, NULL, 10);
+        }
+        if (0 == strncmp(params[i], "ICC_RSA_KEY_POOL", strlen("ICC_RSA_KEY_POOL"))) {
+           MARK("ICC_RSA_KEY_POOL", ptr);
+           SetRSAPoolDepth(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_EC_KEY_POOL", strlen("ICC_EC_KEY_POOL"))) {
+           MARK("ICC_EC_KEY_POOL", ptr);
+           SetECPoolDepth(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_INTEGRITY_CACHE=", strlen("ICC_INTEGRITY_CACHE="))) {
+           MARK("ICC_INTEGRITY_CACHE", ptr);
+           SetIntegrityCache(ptr);
+        }
+        if (0 == strncmp(params[i], "ICC_INTEGRITY_CACHE_FIPS", strlen("ICC_INTEGRITY_CACHE_FIPS"))) {
+           MARK("ICC_INTEGRITY_CACHE_FIPS", ptr);
+           integrity_cache_fips = atoi(ptr);
+        }
+        if (0 == strncmp(params[i], "ICC_PKEY_JOB_THREADS", strlen("ICC_PKEY_JOB_THREADS"))) {
+           MARK("ICC_PKEY_JOB_THREADS", ptr);
+           SetPKEYJobThreads(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_PHASH_THREADS", strlen("ICC_PHASH_THREADS"))) {
+           MARK("ICC_PHASH_THREADS", ptr);
+           SetPHashThreads(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_RSA_KEYGEN_THREADS", strlen("ICC_RSA_KEYGEN_THREADS"))) {
+           MARK("ICC_RSA_KEYGEN_THREADS", ptr);
+           SetRSAKeygenThreads(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_PARAMGEN_THREADS", strlen("ICC_PARAMGEN_THREADS"))) {
+           MARK("ICC_PARAMGEN_THREADS", ptr);
+           SetParamGenThreads(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_DH_NAMED_GROUPS", strlen("ICC_DH_NAMED_GROUPS"))) {
+           MARK("ICC_DH_NAMED_GROUPS", ptr);
+           dh_named_groups = atoi(ptr);
+        }
+        if (0 == strncmp(params[i], "ICC_ZCRYPT", strlen("ICC_ZCRYPT"))) {
+           MARK("ICC_ZCRYPT", ptr);
+           SetZcrypt(atoi(ptr));
+        }
+        if (0 == strncmp(params[i], "ICC_VERIFY_CACHE_TTL", strlen("ICC_VERIFY_CACHE_TTL"))) {
+           MARK("ICC_VERIFY_CACHE_TTL", ptr);
+           SetVerifyCacheTTL(atoi(ptr));
+        } else if (0 == strncmp(params[i], "ICC_VERIFY_CACHE_FIPS", strlen("ICC_VERIFY_CACHE_FIPS"))) {
+           MARK("ICC_VERIFY_CACHE_FIPS", ptr);
+           verify_cache_fips = atoi(ptr);
+        } else if (0 == strncmp(params[i], "ICC_VERIFY_CACHE", strlen("ICC_VERIFY_CACHE"))) {
+           MARK("ICC_VERIFY_CACHE", ptr);
+           SetVerifyCache(atoi(ptr));
+        }
 
         if (0 == strncmp(params[i], "ICC_RNG_EXCLUDED", strlen("ICC_RNG_EXCLUDED"))) {
           MARK("ICC_RNG_EXCLUDED", ptr);
@@ -726,6 +1509,8 @@ static void LoadTables(ICC_STATUS *status)
     memcpy(&ICCGlobal_Error,&ICCGlobal_default, sizeof(ICCGlobal_Error));  
     /* Now winnow the entry points down 
        Error state table, I know, but really, it's accurate enough
+       Note: ICCencapsulator.java keeps a copy of this list, functions
+       matching it can't be tagged 'D' (direct bound) in functions.txt
     */
     for (i = 0; i < (NUM_ICCLIBFUNCTIONS - 1); i++) {
       if (NULL == ICCGlobal_Error[i].name)
@@ -870,18 +1655,24 @@ int ICCLoad ()
   int runpost = 1;
   FILE *sigfile = NULL;
   int trc = ICC_OSSL_SUCCESS;
+  int checked = 0;
+  unsigned long long t0 = 0;
+  unsigned long long t1 = 0;
   char *params[20];
   long long cap = 0LL;
   char cpuid[30];
 
   TRACE_START_EX("icclib",NULL);
   IN();
+  t0 = ICC_GetTimeUS();
 #if defined(STANDALONE_ICCLIB)
   Delta_T(1,&d[0]);
 #endif
   MARK("OPENSSL_cpuid_setup()","Crypto capability probe");
   /* CPUID must be determined before we set TRNG's */
   OPENSSL_cpuid_setup();
+  /* and the OS source lock created before anything probes them */
+  ALT_Setup();
 
   memset(params,0,sizeof(params));
 
@@ -916,6 +1707,10 @@ int ICCLoad ()
     }   
     SetParams(params,20);    
   }
+  /* Before anything allocates through OpenSSL */
+  slab_init();
+  mem_prof_init();
+  secure_heap_init();
 #if (NON_FIPS_ICC == 1) /* Built as non-FIPS */
   /* If we aren't the FIPS instance we won't run POST by default. 
      But run POST even if we are pretending we have FIPS as we need
@@ -951,17 +1746,53 @@ int ICCLoad ()
 #if defined(STANDALONE_ICCLIB)
   d[2] = Delta_T(0,&d[0]);
 #endif
+  t1 = ICC_GetTimeUS();
+  startup_times.config = t1 - t0;
 
   OpenSSL_Init(NULL,&(Global.status));
-
-  init_name_caches();
+  startup_times.openssl = ICC_GetTimeUS() - t1;
+  /* After ICC_CAP_MASK and before anything picks a fast path */
+  OS_CpuFeaturesInit();
+
+  init_ec_group_cache();
+  ctx_cache_init();
+  verify_cache_init();
+  if((0 != rsa_pool_depth) && (0 != ICC_CreateMutex(&rsa_pool_mtx))) {
+    rsa_pool_depth = 0;
+  }
+  if((0 != ec_pool_depth) && (0 != ICC_CreateMutex(&ec_pool_mtx))) {
+    ec_pool_depth = 0;
+  }
+  if((0 != rsa_pool_depth) || (0 != ec_pool_depth)) {
+    pool_fork_hooked = RNG_ForkHook(pool_fork_prepare, pool_fork_parent, 
+                                    pool_fork_child);
+  }
+  if((0 == ICC_CreateMutex(&rsa_tc_mtx)) && 
+     (0 == ICC_CreateThreadKey(&rsa_tc_key, NULL))) {
+    rsa_tc_idx = RSA_get_ex_new_index(0, NULL, NULL, NULL, rsa_tc_free);
+  }
+  if(0 != ICC_CreateMutex(&pkey_job_mtx)) {
+    pkey_job_threads = 0;
+  } else if(0 != ICC_CreateSem(&pkey_job_sem)) {
+    ICC_DestroyMutex(&pkey_job_mtx);
+    pkey_job_threads = 0;
+  }
 
 #if defined(STANDALONE_ICCLIB)
   d[3] = Delta_T(0,&d[0]);
 #endif
   if(runpost) {
+    if(conditional_post && (0 == ICC_CreateMutex(&ka_mtx))) {
+      ka_pending = KA_GROUP_ALL & ~KA_GROUP_CORE;
+    }
     if(ICC_OK == Global.status.majRC ) {
-      trc = SelfTest(NULL,&(Global.status)); 
+      if(parallel_post) {
+        /* Also does the integrity check */
+        trc = ParallelPOST(&(Global.status),KA_GROUP_ALL & ~ka_pending);
+        checked = 1;
+      } else {
+        trc = SelfTestGroups(NULL,&(Global.status),KA_GROUP_ALL & ~ka_pending); 
+      }
     } else {
       SetFatalError("Self Test failed",__FILE__,__LINE__); /* Should be tripped earlier */
     }
@@ -977,9 +1808,11 @@ int ICCLoad ()
     SetFatalError("Could not initialize OpenSSL",__FILE__,__LINE__);
   }
 
-  if(ICC_OK == Global.status.majRC ) {
+  if((ICC_OK == Global.status.majRC) && !checked) {
     /* And check the binary only if we run full POST */
+    t1 = ICC_GetTimeUS();
     rc =  InternalIntegrityCheck(NULL,&(Global.status),(runpost == 0));
+    startup_times.integrity = ICC_GetTimeUS() - t1;
     if((ICC_WARNING == rc) || (ICC_ERROR == rc)) {
        SetFatalError("Integrity check failed",__FILE__,__LINE__);
     }
@@ -995,7 +1828,7 @@ int ICCLoad ()
     sprintf(cpuid,"%016llx",cap);
     MARK("CPUID",cpuid);
   }  
-
+  startup_times.load = ICC_GetTimeUS() - t0;
 
 
   OUTRC(rc);
@@ -1009,18 +1842,42 @@ int ICCLoad ()
   We do try to do this on platforms that support it, but
   unlike ICCLoad() it's not critical if it's not called
   @return 0 on sucess, !0 otherwise
+  @note With ICC_FAST_EXIT only the worker threads are stopped 
+  and secrets erased, see RAND_FIPS_Scrub()
 */
 int ICCUnload ()
 {
   int rc = 0;
 
   IN();
-  ALT_Final(); /* Clean up fd used by TRNG_ALT */
+  HWRNG_Final(); /* Clean up fd used by TRNG_HWRNG */
+  ALT_Final(); /* Clean up fd used by TRNG_ALT, and the source lock */
+  RSAPoolStop();
+  ECPoolStop();
+  PKEYJobStop();
+  if(fast_exit) {
+    /* Process exit, erase the RNG state in place and leave the
+       rest for the OS to reclaim. The TLS keys still go, their
+       destructors would run from an unmapped library otherwise
+    */
+    RAND_FIPS_Scrub();
+    ctx_cache_forget();
+    slab_final();
+    OUTRC(rc);
+    TRACE_END_EX();
+    return rc;
+  }
+  free_dh_comb_cache();
+  free_ec_group_cache();
+  ctx_cache_final();
+  verify_cache_final();
   OpenSSL_Cleanup();
   if(NULL != exclude_list) {
     free(exclude_list);
     exclude_list = NULL;
   }
+  SetIntegrityCache(NULL);
+  slab_final();
 
   OUTRC(rc);
   TRACE_END_EX();
@@ -1049,8 +1906,10 @@ int InternalIntegrityCheck(ICClib *pcb, ICC_STATUS *status, int partcheck)
   FILE *sigfile = NULL; /* File handle for the signature file */
   FILE *self = NULL;    /* File handle for ourself (shared lib) */
   EVP_PKEY *rsakey = NULL;
+  const char *cache = NULL;
   IN();
 
+  ICC_PROBE1(integrity__start, partcheck);
   if (NULL == status)
   {
     rc = ICC_ERROR;
@@ -1066,6 +1925,7 @@ int InternalIntegrityCheck(ICClib *pcb, ICC_STATUS *status, int partcheck)
     {
       rc = SetStatusLn(pcb, status, ICC_WARNING, ICC_LIBRARY_VERIFICATION_FAILED, "Could not open files to perform integrity check", __FILE__, __LINE__);
     }
+    ICC_PROBE1(integrity__opened, rc);
   }
   if (ICC_OK == rc)
   {
@@ -1077,7 +1937,15 @@ int InternalIntegrityCheck(ICClib *pcb, ICC_STATUS *status, int partcheck)
   }
   if (ICC_OK == rc)
   {
-    rv = CheckSig(sigfile, self, rsakey, partcheck);
+    /* The cache only serves the checks at load, ICC_IntegrityCheck() hashes */
+    if (NULL == pcb) {
+#if (NON_FIPS_ICC == 1)
+      cache = integrity_cache;
+#else
+      cache = integrity_cache_fips ? integrity_cache : NULL;
+#endif
+    }
+    rv = CheckSigCached(sigfile, self, rsakey, partcheck, cache);
     /** \induced 154. Signature test, Signature test fails "unknown error"
 	       basically a crypto. failure somewhere
     */
@@ -1128,6 +1996,7 @@ int InternalIntegrityCheck(ICClib *pcb, ICC_STATUS *status, int partcheck)
   if(NULL != rsakey) {
     EVP_PKEY_free(rsakey);
   }
+  ICC_PROBE2(integrity__done, rc, rv);
   OUTRC(rc);
   return rc;
 }
@@ -1336,6 +2205,9 @@ int SetValue (ICClib * pcb, ICC_STATUS * status,ICC_VALUE_IDS_ENUM valueID,
     switch(valueID) {
       case ICC_INDUCED_FAILURE:
       case ICC_FIPS_CALLBACK:
+      case ICC_PBKDF2_THREADS:
+      case ICC_CTX_CACHE:
+      case ICC_MEM_PROFILE:
       break;
       default:
       SetStatusLn (pcb,status, ICC_ERROR, ICC_INVALID_STATE,
@@ -1494,6 +2366,27 @@ int SetValue (ICClib * pcb, ICC_STATUS * status,ICC_VALUE_IDS_ENUM valueID,
       }
       MARK("ICC_FIPS_CALLBACK set","");
     break;
+  case ICC_PBKDF2_THREADS:
+    if ((NULL == value) || (0 == SetPBKDF2Threads(*(int *)value))) {
+      SetStatusLn(pcb, status, ICC_WARNING, ICC_VALUE_NOT_SET,
+                  (char *)"PBKDF2 threads must be 1-8", __FILE__, __LINE__);
+    }
+    MARK("ICC_PBKDF2_THREADS","");
+    break;
+  case ICC_CTX_CACHE:
+    if ((NULL == value) || (0 == SetCtxCacheDepth(*(int *)value))) {
+      SetStatusLn(pcb, status, ICC_WARNING, ICC_VALUE_NOT_SET,
+                  (char *)"Context cache depth must be 0-64", __FILE__, __LINE__);
+    }
+    MARK("ICC_CTX_CACHE","");
+    break;
+  case ICC_MEM_PROFILE:
+    if ((NULL == value) || (0 == SetMemProfile(*(int *)value))) {
+      SetStatusLn(pcb, status, ICC_WARNING, ICC_VALUE_NOT_SET,
+                  (char *)"Allocation profiling was not enabled at load", __FILE__, __LINE__);
+    }
+    MARK("ICC_MEM_PROFILE","");
+    break;
 
   default:
     SetStatusLn(pcb, status, ICC_ERROR, ICC_UNSUPPORTED_VALUE_ID,
@@ -1547,11 +2440,33 @@ int GetValue (ICClib * pcb, ICC_STATUS * status,ICC_VALUE_IDS_ENUM valueID,
    case ICC_INDUCED_FAILURE:
    case ICC_LOOPS:
    case ICC_SHIFT:
+   case ICC_TRNG_FAILOVERS:
+   case ICC_PBKDF2_THREADS:
+   case ICC_CTX_CACHE:
+   case ICC_MEM_PROFILE:
      tmp = sizeof(int);
      break;
+  case ICC_CTX_CACHE_STATS:
+    tmp = sizeof(ICC_CTX_CACHE_COUNTS);
+    break;
+  case ICC_VERIFY_CACHE_STATS:
+    tmp = sizeof(ICC_VERIFY_CACHE_COUNTS);
+    break;
+  case ICC_MEM_SITES:
+    tmp = sizeof(ICC_MEM_SITE);
+    break;
+  case ICC_RNG_STATS:
+    tmp = sizeof(ICC_RNG_STAT);
+    break;
+  case ICC_CPU_FEATURES:
+    tmp = 1;
+    break;
   case ICC_FIPS_CALLBACK:
     tmp = sizeof(CALLBACK_T);
     break;
+  case ICC_STARTUP_TIMES:
+    tmp = sizeof(ICC_STARTUP_TIMING);
+    break;
    default:
      tmp = sizeof(void *);
      break;
@@ -1571,6 +2486,10 @@ int GetValue (ICClib * pcb, ICC_STATUS * status,ICC_VALUE_IDS_ENUM valueID,
      }
      MARK("ICC_FIPS_APPROVED_MODE",(char *)value);
      break;
+   case ICC_ALT_ALLOCATOR:
+     strncpy((char *)value, slab_active ? "slab" : "off", valueLength);
+     MARK("ICC_ALT_ALLOCATOR",(char *)value);
+     break;
    case ICC_INSTALL_PATH:
      if (Global.iccpath[0] == '\0') {
        SetStatusLn (pcb,status, ICC_WARNING, ICC_VALUE_NOT_SET,
@@ -1658,18 +2577,63 @@ int GetValue (ICClib * pcb, ICC_STATUS * status,ICC_VALUE_IDS_ENUM valueID,
      *(int *)value = Loops();
       MARK("ICC_LOOPS","");
     break;
-  case ICC_CPU_CAPABILITY_MASK:
-     if(valueLength > 0) {
-       *(char *)value = '\0';
-     }
-     if(valueLength < 17) {
-       SetStatusLn (pcb,status, ICC_WARNING, ICC_INVALID_PARAMETER,
-		    (char *)"Return field must be at least 17 bytes",
-		    __FILE__,__LINE__);
-     } else {
-       long long cpuid = 0;
-       if( 0 != OPENSSL_cpuid(&cpuid) ) {
-	        sprintf((char *)value,"%016llx",cpuid);
+    case ICC_TRNG_FAILOVERS:
+     *(int *)value = (int)GetTRNGFailovers();
+      MARK("ICC_TRNG_FAILOVERS","");
+    break;
+    case ICC_PBKDF2_THREADS:
+     *(int *)value = pbkdf2_threads;
+      MARK("ICC_PBKDF2_THREADS","");
+    break;
+    case ICC_CTX_CACHE:
+     *(int *)value = ctx_cache_depth;
+      MARK("ICC_CTX_CACHE","");
+    break;
+    case ICC_CTX_CACHE_STATS:
+     ctx_cache_stats((ICC_CTX_CACHE_COUNTS *)value);
+      MARK("ICC_CTX_CACHE_STATS","");
+    break;
+    case ICC_VERIFY_CACHE_STATS:
+     vc_stats(pcb,(ICC_VERIFY_CACHE_COUNTS *)value);
+      MARK("ICC_VERIFY_CACHE_STATS","");
+    break;
+    case ICC_MEM_PROFILE:
+     *(int *)value = GetMemProfile();
+      MARK("ICC_MEM_PROFILE","");
+    break;
+    case ICC_MEM_SITES:
+     mem_prof_sites((ICC_MEM_SITE *)value, (size_t)valueLength / sizeof(ICC_MEM_SITE));
+      MARK("ICC_MEM_SITES","");
+    break;
+    case ICC_RNG_STATS:
+     GetRNGStats((ICC_RNG_STAT *)value, (size_t)valueLength / sizeof(ICC_RNG_STAT));
+      MARK("ICC_RNG_STATS","");
+    break;
+    case ICC_STARTUP_TIMES:
+     memcpy(value,&startup_times,sizeof(ICC_STARTUP_TIMING));
+     ((ICC_STARTUP_TIMING *)value)->calibrate = calibrate_us;
+      MARK("ICC_STARTUP_TIMES","");
+    break;
+  case ICC_CPU_FEATURES:
+     if(OS_CpuFeatureNames((char *)value, valueLength) >= valueLength) {
+       SetStatusLn (pcb,status, ICC_WARNING, ICC_INVALID_PARAMETER,
+		    (char *)"Return field too small, list truncated",
+		    __FILE__,__LINE__);
+     }
+     MARK("ICC_CPU_FEATURES",(char *)value);
+     break;
+  case ICC_CPU_CAPABILITY_MASK:
+     if(valueLength > 0) {
+       *(char *)value = '\0';
+     }
+     if(valueLength < 17) {
+       SetStatusLn (pcb,status, ICC_WARNING, ICC_INVALID_PARAMETER,
+		    (char *)"Return field must be at least 17 bytes",
+		    __FILE__,__LINE__);
+     } else {
+       long long cpuid = 0;
+       if( 0 != OPENSSL_cpuid(&cpuid) ) {
+	        sprintf((char *)value,"%016llx",cpuid);
        }
      }
      MARK("ICC_CPU_CAPABILITY_MASK",(value != NULL)? (char *)value:"");
@@ -1704,12 +2668,16 @@ int GetValue (ICClib * pcb, ICC_STATUS * status,ICC_VALUE_IDS_ENUM valueID,
   - Initialize internal ICC state. (FIPS mode etc)
   - Initialize OpenSSL
   - Initialize PRNG seed
-  - Run NIST self tests
+  - Pick up the result of the NIST self tests
   The ICC Mutex is held during this operation.
   - Most port errors happen here.
   @param pcb ICC internal context
   @param status status return
   @return ICC_OSSL_SUCCESS or ICC_FAILURE - Note need to check status.
+  @note POST and the integrity check run once per loaded library image, 
+  in ICCLoad(). Their outcome is kept in Global.status/Global.initialized 
+  and every later ICC_CTX attaching to this image reuses it. Only an
+  explicit SelfTest() reruns the known answer tests.
 */
 int lib_attach (ICClib * pcb, ICC_STATUS * status)
 {
@@ -1789,6 +2757,7 @@ static int iccSetUpRSAFIPS(ICC_STATUS *icc_stat)
 #else       
        RSA_meth_set_keygen(FIPS_RSA_meth, (PF_keygen)fips_rsa_builtin_keygen);
 #endif
+       ZcryptSetMethod(FIPS_RSA_meth);
        RSA_set_default_method((const RSA_METHOD *)FIPS_RSA_meth);
      }   
    } 
@@ -1808,6 +2777,8 @@ static int iccSetUpRSAFIPS(ICC_STATUS *icc_stat)
 */
 static void OpenSSL_Init(ICClib *pcb, ICC_STATUS * status)
 {
+  unsigned long long t0 = 0;
+
   IN();
 
   /* Make sure this is done before we do any crypto */
@@ -1828,7 +2799,9 @@ static void OpenSSL_Init(ICClib *pcb, ICC_STATUS * status)
     /* Set the FIPS RNG methods */
     if(ICC_OK == status->majRC) {
       /* Note, the RNG's now auto-seed/reseed */
+      t0 = ICC_GetTimeUS();
       iccSetRNG(pcb, status,NULL,0);
+      startup_times.rng_init = ICC_GetTimeUS() - t0;
     }
     /* Set the RSA FIPS method */
     if(ICC_OK == status->majRC) {
@@ -1848,6 +2821,7 @@ static void OpenSSL_Cleanup()
 { 
   IN();
 
+  ZcryptClose();
   if(NULL != FIPS_RSA_meth) {
     RSA_meth_free(FIPS_RSA_meth);
     FIPS_RSA_meth = NULL;
@@ -1861,6 +2835,10 @@ static void OpenSSL_Cleanup()
    */
   CleanupSP800_90(); 
 
+  /* Only releases the pool if nothing is left in it */
+  if (CRYPTO_secure_malloc_initialized()) {
+    CRYPTO_secure_malloc_done();
+  }
 
   OUT();
 }
@@ -1918,22 +2896,49 @@ int lib_cleanup (ICClib *pcb,ICC_STATUS * status)
   return rv;
 }
 
+/*!
+  @brief Run known answer test groups one at a time, recording how long
+  each group took the first time it ran, stops at the first failure
+  @param pcb ICC internal context
+  @param status status return
+  @param groups the KA_GROUP_ mask to run
+*/
+static void TimedKAT(ICClib *pcb,ICC_STATUS *status,int groups)
+{
+  int i = 0;
+  unsigned long long t0 = 0;
+
+  for(i = 0; i < ICC_KAT_GROUPS; i++) {
+    if(0 != (groups & (1 << i))) {
+      t0 = ICC_GetTimeUS();
+      iccDoKnownAnswerGroups(pcb,status,1 << i);
+      if(0 == startup_times.kat[i]) {
+        startup_times.kat[i] = ICC_GetTimeUS() - t0;
+      }
+      if(ICC_OK != status->majRC) {
+        break;
+      }
+    }
+  }
+}
+
 /*!
   @brief
   Self test code
   - run NIST mandated self tests
   @param pcb ICC internal context
   @param status status return
+  @param groups the KA_GROUP_ mask to run
   @return ICC_OSSL_SUCCESS or ICC_FAILURE
 */
-int SelfTest (ICClib *pcb,ICC_STATUS * status)
+static int SelfTestGroups (ICClib *pcb,ICC_STATUS * status,int groups)
 {
   int iccRC = ICC_OSSL_SUCCESS;
 
 	
   MARK("SelfTest","iccDoKnownAnser");
   /*! \FIPS call the known answer tests during POST */
-  iccDoKnownAnswer (pcb, status);
+  TimedKAT (pcb, status, groups);
   if (status->majRC != ICC_OK) {
     iccRC = ICC_OSSL_FAILURE;
     /* And if it's a FIPS context or POST, make sure this
@@ -1946,6 +2951,181 @@ int SelfTest (ICClib *pcb,ICC_STATUS * status)
   return iccRC;
 }
 
+/*!
+  @brief
+  Self test code
+  - run NIST mandated self tests
+  @param pcb ICC internal context
+  @param status status return
+  @return ICC_OSSL_SUCCESS or ICC_FAILURE
+  @note This always runs every group, a pass also satisfies any 
+  conditional tests still pending
+*/
+int SelfTest (ICClib *pcb,ICC_STATUS * status)
+{
+  int iccRC = ICC_OSSL_SUCCESS;
+
+  iccRC = SelfTestGroups(pcb,status,KA_GROUP_ALL);
+  if((ICC_OSSL_SUCCESS == iccRC) && (0 != ka_pending)) {
+    ICC_LockMutex(&ka_mtx);
+    ka_pending = 0;
+    ICC_UnlockMutex(&ka_mtx);
+  }
+  return iccRC;
+}
+
+/*!
+  @brief
+  Incremental self test
+  - run a subset of the NIST mandated self tests, so that periodic
+  testing of a long running process can be spread over several calls
+  @param pcb ICC internal context
+  @param status status return
+  @param groups an or'ed set of ICC_KAT_ groups, or ICC_KAT_NEXT to
+  run the next group of a round robin over all of them
+  @return ICC_OSSL_SUCCESS or ICC_FAILURE
+  @note A failure has the same global effect as a SelfTest() failure.
+  A pass also satisfies any of these groups' conditional tests still pending
+*/
+int SelfTestGroup (ICClib *pcb,ICC_STATUS * status,int groups)
+{
+  int iccRC = ICC_OSSL_SUCCESS;
+  static int next = 0; /* round robin position, a race only skips or repeats a group */
+  int i = 0;
+
+  if(ICC_KAT_NEXT == groups) {
+    i = next;
+    next = (i + 1) % ICC_KAT_GROUPS;
+    groups = 1 << i;
+  }
+  groups &= KA_GROUP_ALL;
+  if(0 == groups) {
+    SetStatusLn(pcb,status,ICC_ERROR,ICC_INVALID_PARAMETER,"Invalid self test group",__FILE__,__LINE__);
+    iccRC = ICC_OSSL_FAILURE;
+  } else {
+    iccRC = SelfTestGroups(pcb,status,groups);
+    if((ICC_OSSL_SUCCESS == iccRC) && (0 != (ka_pending & groups))) {
+      ICC_LockMutex(&ka_mtx);
+      ka_pending &= ~groups;
+      ICC_UnlockMutex(&ka_mtx);
+    }
+  }
+  return iccRC;
+}
+
+/*!
+  @brief Conditional self test, with ICC_CONDITIONAL_POST the known
+  answer tests for a group of algorithms run before the first use of
+  any of them, once per process
+  @param group the KA_GROUP_ the caller's algorithm belongs to
+  @return 1 if the algorithm may be used, 0 if its tests failed
+  @note a failure is fatal, SetFatalError() is called by the tests
+*/
+static int CondKAT(int group)
+{
+  int rv = 1;
+  ICC_STATUS status;
+
+  /* Unlocked peek, pending bits are only ever cleared */
+  if(0 != (ka_pending & group)) {
+    ICC_LockMutex(&ka_mtx);
+    if(0 != (ka_pending & group)) {
+      MARK("Conditional self test","");
+      memset(&status,0,sizeof(status));
+      TimedKAT(NULL,&status,group);
+      if(ICC_OK != status.majRC) {
+        ka_failed |= group;
+      }
+      ka_pending &= ~group;
+    }
+    ICC_UnlockMutex(&ka_mtx);
+  }
+  if(0 != (ka_failed & group)) {
+    rv = 0;
+  }
+  return rv;
+}
+
+/*! @brief One independent piece of the POST */
+typedef struct {
+  int groups;         /*!< KA_GROUP_ mask, -1 for the integrity check */
+  int rc;             /*!< Integrity check return */
+  ICC_STATUS status;  /*!< Private status, merged when all are done */
+} POST_SHARE;
+
+static ICC_THREAD_RET ICC_THREAD_CALL post_worker(void *arg)
+{
+  POST_SHARE *w = (POST_SHARE *)arg;
+  unsigned long long t0 = 0;
+  if(-1 != w->groups) {
+    TimedKAT(NULL,&(w->status),w->groups);
+  } else {
+    t0 = ICC_GetTimeUS();
+    w->rc = InternalIntegrityCheck(NULL,&(w->status),0);
+    startup_times.integrity = ICC_GetTimeUS() - t0;
+  }
+  return 0;
+}
+
+/*!
+  @brief
+  POST with the library integrity check, the signature known answer
+  tests and the remaining known answer tests on a transient thread each.
+  The results are merged as the serial SelfTest() then
+  InternalIntegrityCheck() sequence would leave them, known answer 
+  failures first. Pieces that can't get a thread run on the caller.
+  @param status status return
+  @param groups the KA_GROUP_ mask to run
+  @return ICC_OSSL_SUCCESS or ICC_OSSL_FAILURE, as SelfTest()
+*/
+static int ParallelPOST(ICC_STATUS *status,int groups)
+{
+  int iccRC = ICC_OSSL_SUCCESS;
+  POST_SHARE w[3];
+  ICC_Thread thr[3];
+  int started[3];
+  int i = 0;
+  int threads = 0;
+
+  IN();
+  memset(w,0,sizeof(w));
+  w[0].groups = groups & ~KA_GROUP_SIG;
+  w[1].groups = groups & KA_GROUP_SIG;
+  w[2].groups = -1;
+  threads = (ICC_GetCPUCount() > 1);
+  MARK("SelfTest","parallel POST");
+  for(i = 0; i < 3; i++) {
+    started[i] = 0;
+    if(threads && (i > 0) && (0 == ICC_CreateThread(&thr[i],post_worker,&w[i]))) {
+      started[i] = 1;
+    }
+  }
+  for(i = 0; i < 3; i++) {
+    if(started[i]) {
+      ICC_JoinThread(&thr[i]);
+    } else {
+      post_worker(&w[i]);
+    }
+  }
+  if(ICC_OK != w[1].status.majRC) {
+    memcpy(status,&(w[1].status),sizeof(ICC_STATUS));
+  } else {
+    memcpy(status,&(w[0].status),sizeof(ICC_STATUS));
+  }
+  if (status->majRC != ICC_OK) {
+    iccRC = ICC_OSSL_FAILURE;
+    MARK("SelfTest","failed");
+    SetStatusLn(NULL,status,ICC_ERROR | ICC_FATAL,ICC_LIBRARY_VERIFICATION_FAILED,"Self Test failed",__FILE__,__LINE__);
+  } else {
+    memcpy(status,&(w[2].status),sizeof(ICC_STATUS));
+    if((ICC_WARNING == w[2].rc) || (ICC_ERROR == w[2].rc)) {
+       SetFatalError("Integrity check failed",__FILE__,__LINE__);
+    }
+  }
+  OUTRC(iccRC);
+  return iccRC;
+}
+
 
 /*!
   @brief
@@ -1978,12 +3158,28 @@ int my_EVP_MD_CTX_free (EVP_MD_CTX * x)
   {
    if (x != NULL) {
      EVP_MD_CTX_cleanup(x);     
-     ICC_Free (x);
+     if (!ctx_cache_push(CC_MD, x)) {
+       ICC_Free (x);
+     }
      return ICC_OSSL_SUCCESS;
    }
    return ICC_OSSL_FAILURE;
 }
 
+/*! 
+  @brief
+  Allocate an MD context, from this thread's free list if ICC_CTX_CACHE is on
+  @return the context or NULL
+*/
+EVP_MD_CTX *my_EVP_MD_CTX_new(void)
+{
+  EVP_MD_CTX *x = (EVP_MD_CTX *)ctx_cache_pop(CC_MD);
+  if (NULL == x) {
+    x = EVP_MD_CTX_new();
+  }
+  return x;
+}
+
 /*! 
   @brief
   Free an ENCODE context
@@ -2031,17 +3227,61 @@ int EVP_CIPHER_CTX_flags(EVP_CIPHER_CTX *ctx)
 */
 int my_EVP_CIPHER_CTX_free(EVP_CIPHER_CTX * x)
 {
-     
-  EVP_CIPHER_CTX_free(x);
+  if ((NULL == x) || (1 != EVP_CIPHER_CTX_reset(x)) || !ctx_cache_push(CC_CIPHER, x)) {
+    EVP_CIPHER_CTX_free(x);
+  }
   return ICC_OSSL_SUCCESS;
 }
 
+/*! 
+  @brief
+  Allocate an EVP_CIPHER context, from this thread's free list if ICC_CTX_CACHE is on
+  @return the context or NULL
+*/
+EVP_CIPHER_CTX *my_EVP_CIPHER_CTX_new(void)
+{
+  EVP_CIPHER_CTX *x = (EVP_CIPHER_CTX *)ctx_cache_pop(CC_CIPHER);
+  if (NULL == x) {
+    x = EVP_CIPHER_CTX_new();
+  }
+  return x;
+}
+
 #undef HMAC_CTX_cleanup
 int HMAC_CTX_cleanup(HMAC_CTX *ctx)
 {
   return HMAC_CTX_reset(ctx);
 }  
 
+/*! 
+  @brief
+  Allocate an HMAC context, from this thread's free list if ICC_CTX_CACHE is on
+  @return the context or NULL
+*/
+HMAC_CTX *my_HMAC_CTX_new(void)
+{
+  HMAC_CTX *x = (HMAC_CTX *)ctx_cache_pop(CC_HMAC);
+  if (NULL == x) {
+    x = HMAC_CTX_new();
+  }
+  return x;
+}
+
+/*! 
+  @brief
+  Free an HMAC context, kept on this thread's free list if ICC_CTX_CACHE is on.
+  HMAC_CTX_reset() keeps the inner, outer and working digest contexts, 
+  so a reused context saves four allocations.
+  @param ctx the context, may be NULL
+*/
+void my_HMAC_CTX_free(HMAC_CTX *ctx)
+{
+  if ((NULL != ctx) && 
+      ((1 != HMAC_CTX_reset(ctx)) || !ctx_cache_push(CC_HMAC, ctx))) {
+    HMAC_CTX_free(ctx);
+  }
+}
+
 /*! @brief initializes or reuses a HMAC_CTX structure to use the;
       function evp_md and key key. Either can be NULL, in which case the;
       existing one will be reused.
@@ -2053,22 +3293,32 @@ int HMAC_CTX_cleanup(HMAC_CTX *ctx)
 
 int my_HMAC_Init(HMAC_CTX *ctx, const void *key, int key_len,const EVP_MD *md)
 {
-  return HMAC_Init_ex(ctx,key,key_len,md,NULL);
+  int rv = 0;
+  if(CondKAT(KA_GROUP_MAC)) {
+    rv = HMAC_Init_ex(ctx,key,key_len,md,NULL);
+  }
+  return rv;
 }
 
 
-/*! @brief Update phase of a CMAC operation
+/*! @brief Initialize a CMAC operation
     @param cmac_ctx a pointer to a CMAC_CTX
-    @param cipher the cipher to use
-    @param key the CMAC key
-    @param keylen the length of the CMAC key
-    @note blocked/aligned data will be more efficient, but this will
-          survive incorrectly blocked/misaligned data
+    @param cipher the cipher to use, NULL to reuse the key already set
+    @param key the CMAC key, NULL to reuse the key already set 
+    @param keylen the length of the CMAC key, 0 to reuse the key already set
+    @return 1 on success, 0 on failure
+    @note With cipher, key and keylen all NULL/0 the context restarts
+    with the expanded key and K1/K2 subkeys it already holds, no key 
+    schedule or subkey derivation is repeated. This fails if the context
+    has never been keyed.
 */
 int my_CMAC_Init(CMAC_CTX *cmac_ctx,const EVP_CIPHER *cipher,unsigned char *key,unsigned int keylen)
 {
-  return CMAC_Init(cmac_ctx,key,keylen,cipher,NULL);
-
+  int rv = 0;
+  if(CondKAT(KA_GROUP_MAC)) {
+    rv = CMAC_Init(cmac_ctx,key,keylen,cipher,NULL);
+  }
+  return rv;
 }
 /* @brief Finish a CMAC operation and return the CMAC value;
     @param cmac_ctx a pointer to a CMAC_CTX;
@@ -2135,6 +3385,143 @@ int my_EVP_DigestFinal(EVP_MD_CTX *ctx,unsigned char *md,unsigned int *s)
   return EVP_DigestFinal_ex(ctx,md,s);
 }
 
+/* The _off variants below take (base, offset, length) buffers and return
+   the output length, so a JNI caller can hand over a direct ByteBuffer or
+   pinned array as is, with no pointer fix ups or a second call for the size.
+*/
+
+/*! @brief EVP_EncryptUpdate()/EVP_DecryptUpdate() on (base, offset, length) buffers
+   @param ctx an initialized cipher context, runs in the direction it was initialized for
+   @param out output base, may be NULL for AEAD additional authentication data
+   @param outoff offset into out
+   @param outcap bytes available at out + outoff, at least inl + the block size (- 1 
+   when encrypting), as OpenSSL requires, or inl for a stream or AEAD cipher
+   @param in input base
+   @param inoff offset into in
+   @param inl bytes of input
+   @return the number of bytes written, -1 on failure
+*/
+int EVP_CipherUpdate_off(EVP_CIPHER_CTX *ctx,unsigned char *out,int outoff,int outcap,unsigned char *in,int inoff,int inl)
+{
+  int rv = -1;
+  int outl = 0;
+  int bs = 0;
+  int need = 0;
+
+  if((NULL != ctx) && (NULL != EVP_CIPHER_CTX_cipher(ctx)) && 
+     (outoff >= 0) && (outcap >= 0) && (inoff >= 0) && (inl >= 0) &&
+     ((NULL != in) || (0 == inl))) {
+    bs = EVP_CIPHER_CTX_block_size(ctx);
+    need = inl;
+    if(bs > 1) {
+      need = (inl > INT_MAX - bs) ? -1 : inl + bs - (EVP_CIPHER_CTX_encrypting(ctx) ? 1 : 0);
+    }
+    if(NULL == out) {
+      /* Only valid as AAD */
+      if(0 == (EVP_CIPHER_flags(EVP_CIPHER_CTX_cipher(ctx)) & EVP_CIPH_FLAG_AEAD_CIPHER)) {
+        need = -1;
+      }
+    } else if(outcap < need) {
+      need = -1;
+    }
+    if((need >= 0) &&
+       (1 == EVP_CipherUpdate(ctx,(NULL == out) ? NULL : out + outoff,&outl,
+                              (NULL == in) ? NULL : in + inoff,inl))) {
+      rv = outl;
+    }
+  }
+  return rv;
+}
+
+/*! @brief EVP_EncryptFinal()/EVP_DecryptFinal() on a (base, offset, length) buffer
+   @param ctx an initialized cipher context
+   @param out output base
+   @param outoff offset into out
+   @param outcap bytes available at out + outoff, at least the block size
+   @return the number of bytes written, -1 on failure
+*/
+int EVP_CipherFinal_off(EVP_CIPHER_CTX *ctx,unsigned char *out,int outoff,int outcap)
+{
+  int rv = -1;
+  int outl = 0;
+
+  if((NULL != ctx) && (NULL != out) && (outoff >= 0) &&
+     (outcap >= EVP_CIPHER_CTX_block_size(ctx))) {
+    if(1 == EVP_CipherFinal_ex(ctx,out + outoff,&outl)) {
+      rv = outl;
+    }
+  }
+  return rv;
+}
+
+/*! @brief EVP_DigestUpdate() on a (base, offset, length) buffer
+   @param ctx an initialized digest context
+   @param in input base
+   @param inoff offset into in
+   @param inl bytes of input
+   @return 1 on success, 0 on failure
+*/
+int EVP_DigestUpdate_off(EVP_MD_CTX *ctx,unsigned char *in,int inoff,int inl)
+{
+  int rv = 0;
+  if((NULL != ctx) && (inoff >= 0) && (inl >= 0) && ((NULL != in) || (0 == inl))) {
+    rv = EVP_DigestUpdate(ctx,(NULL == in) ? NULL : in + inoff,(size_t)inl);
+  }
+  return rv;
+}
+
+/*! @brief EVP_DigestFinal() on a (base, offset, length) buffer
+   @param ctx an initialized digest context
+   @param out output base
+   @param outoff offset into out
+   @param outcap bytes available at out + outoff, at least the digest size
+   @return the digest length, -1 on failure
+*/
+int EVP_DigestFinal_off(EVP_MD_CTX *ctx,unsigned char *out,int outoff,int outcap)
+{
+  int rv = -1;
+  unsigned int s = 0;
+
+  if((NULL != ctx) && (NULL != out) && (outoff >= 0) &&
+     (NULL != EVP_MD_CTX_md(ctx)) && (outcap >= EVP_MD_CTX_size(ctx))) {
+    if(1 == EVP_DigestFinal_ex(ctx,out + outoff,&s)) {
+      rv = (int)s;
+    }
+  }
+  return rv;
+}
+
+/*! @brief EVP_DigestFinal() and then start the next message on the same context
+   @param ctx a digest context set up by EVP_DigestInit
+   @param md pointer to buffer which will contain the hash
+   @param s if not NULL, the size of the hash is returned here
+   @param prefix NULL, or a context for the same digest that has already
+   absorbed a common prefix, i.e. a domain separation tag. Its state is
+   copied into ctx and it isn't modified.
+   @return ICC_OSSL_SUCCESS, ICC_OSSL_FAILURE
+   @note The digest and its state buffer are kept, a reset reuses them
+   rather than freeing and reallocating as a new context per message would.
+   EVP_MD_CTX_copy_ex() reuses the state buffer when both contexts
+   are for the same digest.
+*/
+int EVP_DigestFinal_reset(EVP_MD_CTX *ctx,unsigned char *md,unsigned int *s,const EVP_MD_CTX *prefix)
+{
+  int rv = ICC_OSSL_FAILURE;
+  const EVP_MD *type = NULL;
+
+  if((NULL != ctx) && (NULL != md) && (NULL != (type = EVP_MD_CTX_md(ctx))) &&
+     ((NULL == prefix) || (type == EVP_MD_CTX_md(prefix)))) {
+    if(1 == EVP_DigestFinal_ex(ctx,md,s)) {
+      if(NULL == prefix) {
+        rv = EVP_DigestInit_ex(ctx,type,NULL);
+      } else {
+        rv = EVP_MD_CTX_copy_ex(ctx,prefix);
+      }
+    }
+  }
+  return rv;
+}
+
 /*!
  @brief sets up cipher context ctx for encryption 
  @param ctx the cipher context to use
@@ -2148,7 +3535,11 @@ int my_EVP_DigestFinal(EVP_MD_CTX *ctx,unsigned char *md,unsigned int *s)
 */
 int my_EVP_EncryptInit(EVP_CIPHER_CTX *ctx,const EVP_CIPHER *type,unsigned char *key, unsigned char *iv) 
 {
-  return EVP_EncryptInit_ex(ctx,type,NULL,key,iv);
+  int rv = 0;
+  if(CondKAT(KA_GROUP_CIPHER)) {
+    rv = EVP_EncryptInit_ex(ctx,type,NULL,key,iv);
+  }
+  return rv;
 }
 
 /*!
@@ -2163,7 +3554,11 @@ int my_EVP_EncryptInit(EVP_CIPHER_CTX *ctx,const EVP_CIPHER *type,unsigned char
 */
 int my_EVP_DecryptInit(EVP_CIPHER_CTX *ctx,const EVP_CIPHER *type,unsigned char *key, unsigned char *iv) 
 {
-  return EVP_DecryptInit_ex(ctx,type,NULL,key,iv);
+  int rv = 0;
+  if(CondKAT(KA_GROUP_CIPHER)) {
+    rv = EVP_DecryptInit_ex(ctx,type,NULL,key,iv);
+  }
+  return rv;
 }
 
 
@@ -2202,6 +3597,31 @@ void GenerateRandomSeed(ICClib *pcb, ICC_STATUS *status,int num, unsigned char *
   }	  
 }
 
+/*! @brief Non-blocking ICC_GenerateRandomSeed()
+    @param pcb the ICC library context
+    @param status the status, ICC_WARNING with ICC_WOULD_BLOCK if it would block
+    @param num the number of bytes requested
+    @param buff the buffer to fill
+    @param cb called from another thread once a retry should succeed, may be NULL
+    @param arg passed to cb
+    @return ICC_SEED_READY, ICC_SEED_WOULDBLOCK or ICC_SEED_FAILED
+*/
+int TryGenerateRandomSeed(ICClib *pcb, ICC_STATUS *status,int num, unsigned char *buff,void (*cb)(void *arg),void *arg) {
+  int rv = ICC_SEED_FAILED;
+
+  if(NULL != status) {
+    SetStatusOK(pcb,status);
+  }  
+  rv = fips_rand_try_bytes(buff,num,cb,arg);
+  if(NULL != status) {
+    if(ICC_SEED_FAILED == rv) {
+      SetStatusLn(pcb,status,ICC_ERROR,ICC_DISABLED,(char *)"RNG seed source failed",__FILE__,__LINE__);
+    } else if(ICC_SEED_WOULDBLOCK == rv) {
+      SetStatusLn(pcb,status,ICC_WARNING,ICC_WOULD_BLOCK,(char *)"RNG seed source not ready, retry",__FILE__,__LINE__);
+    }
+  }
+  return rv;
+}
 
 RSA *  my_RSA_generate_key(ICClib *pcb,int bits, unsigned long e,void (*callback)(int,int,void *),void *cb_arg)
 {
@@ -2230,44 +3650,694 @@ RSA *  my_RSA_generate_key(ICClib *pcb,int bits, unsigned long e,void (*callback
   }
   return rsa;
 }
-/*
-  Note: We use this code in both FIPS and non-FIPS modes so the policy checks that were 
-  in OpenSSL are lifted and done at this level instead
-  i.e. valid FIPS key size range and minimum exponent size
+/* Background RSA key pool, ICC_RSA_KEY_POOL */
+#define RSA_POOL_MAX 16   /*!< Largest pool depth per size */
+#define RSA_POOL_SIZES 4  /*!< Distinct key size/exponent pairs pooled */
+#define RSA_POOL_IDLE 50  /*!< mS the worker sleeps when the pool is full */
 
+/*! @brief Pre-generated keys of one size and public exponent */
+typedef struct {
+  int bits;                  /*!< Key size, 0 for an unused slot */
+  BIGNUM *e;                 /*!< Public exponent */
+  int n;                     /*!< Keys held */
+  RSA *keys[RSA_POOL_MAX];   /*!< The keys, all passed the pair-wise test */
+} RSA_POOL_SLOT;
+
+static RSA_POOL_SLOT rsa_pool[RSA_POOL_SIZES];
+static ICC_Thread rsa_pool_thr;
+static int rsa_pool_state = 0; /*!< 0 not started, 1 running, 2 stopping, -1 no thread */
+static DWORD rsa_pool_pid = 0; /*!< The process the pool was filled in */
+
+/*! @brief Set the number of keys pooled per size, 0 disables the pool
+  @param n 0-RSA_POOL_MAX
+  @note Only effective before the first keygen
 */
-
-int my_RSA_generate_key_ex(ICClib *pcb, RSA *rsa, int bits, BIGNUM *e, void *callback)
+static void SetRSAPoolDepth(int n)
 {
-  int rv = 1;
-  int nid = 0;
-  int fips = 0;
-  BIGNUM *elim = NULL;
-  /* Overall sanity check, the KeyPair check has a fixed length buffer but this is sane even in non-FIPS mode  */
-  if (bits < 512 || bits > 16384)
-  {
-    rv = 0;
+  if((n >= 0) && (n <= RSA_POOL_MAX)) {
+    rsa_pool_depth = n;
   }
-  /* Unlike OpenSSL, we make the policy decisions, key size, exponent at this level 
-    and are more permissive if not in FIPS mode.
-  */
-  if ((1 == rv) && (pcb->flags & ICC_FIPS_FLAG))
-  {
-    elim = BN_new();
-    BN_set_word(elim, 0x10001);
-    if ((bits < 2048) || (bits > 8192) || (BN_cmp(e, elim) < 0) || !BN_is_odd(e) || (BN_num_bits(e) > 256))
-    {
-      rv = 0;
+}
+
+/*! @brief Free every pooled key and the registered sizes
+  @note The caller holds the pool mutex or is the only thread left
+*/
+static void RSAPoolEmpty(void)
+{
+  int i = 0;
+
+  for(i = 0; i < RSA_POOL_SIZES; i++) {
+    while(rsa_pool[i].n > 0) {
+      rsa_pool[i].n--;
+      RSA_free(rsa_pool[i].keys[rsa_pool[i].n]);
+      rsa_pool[i].keys[rsa_pool[i].n] = NULL;
     }
-    BN_free(elim);
+    if(NULL != rsa_pool[i].e) {
+      BN_free(rsa_pool[i].e);
+      rsa_pool[i].e = NULL;
+    }
+    rsa_pool[i].bits = 0;
   }
-  if (1 == rv)
-  {
+}
+
+/*! @brief Keep every registered size topped up
+  Keys are generated outside the lock with the same reseed and pair-wise
+  test as an in line keygen, a failed pair-wise test is fatal as usual
+*/
+static ICC_THREAD_RET ICC_THREAD_CALL rsa_pool_worker(void *arg)
+{
+  int i = 0;
+  int bits = 0;
+  int failed = 0;
+  BIGNUM *e = NULL;
+  RSA *rsa = NULL;
+
+  (void)arg;
+  while(1 == rsa_pool_state) {
+    bits = 0;
+    failed = 0;
+    ICC_LockMutex(&rsa_pool_mtx);
+    for(i = 0; i < RSA_POOL_SIZES; i++) {
+      if((0 != rsa_pool[i].bits) && (rsa_pool[i].n < rsa_pool_depth)) {
+        bits = rsa_pool[i].bits;
+        e = BN_dup(rsa_pool[i].e);
+        break;
+      }
+    }
+    ICC_UnlockMutex(&rsa_pool_mtx);
+    if((0 == bits) || (NULL == e)) {
+      ICC_Sleep(RSA_POOL_IDLE);
+      continue;
+    }
+    rsa = RSA_new();
+    if(NULL != rsa) {
+      RAND_seed(NULL,0); /* Reseed the RNG before keygen */
+      if((1 != RSA_generate_key_ex(rsa, bits, e, NULL)) || 
+         (ICC_OK != iccRSAKeyPair(NULL, rsa))) {
+        RSA_free(rsa);
+        rsa = NULL;
+      }
+    }
+    if(NULL == rsa) {
+      failed = 1;
+    }
+    ICC_LockMutex(&rsa_pool_mtx);
+    if((NULL != rsa) && (1 == rsa_pool_state) && 
+       (rsa_pool[i].bits == bits) && (rsa_pool[i].n < rsa_pool_depth)) {
+      rsa_pool[i].keys[rsa_pool[i].n++] = rsa;
+      rsa = NULL;
+    }
+    ICC_UnlockMutex(&rsa_pool_mtx);
+    if(NULL != rsa) {
+      RSA_free(rsa);
+      rsa = NULL;
+    }
+    if(failed) {
+      ICC_Sleep(RSA_POOL_IDLE);
+    }
+    BN_free(e);
+    e = NULL;
+  }
+  return 0;
+}
+
+/*! @brief Copy the private key components of one RSA object to another
+  @param rsa the key to fill in
+  @param key the source key, must carry the CRT parameters
+  @return 1 on success, 0 on failure
+*/
+static int RSACopyKey(RSA *rsa, const RSA *key)
+{
+  int rv = 0;
+  const BIGNUM *n = NULL, *e = NULL, *d = NULL;
+  const BIGNUM *p = NULL, *q = NULL;
+  const BIGNUM *dmp1 = NULL, *dmq1 = NULL, *iqmp = NULL;
+  BIGNUM *c[8];
+  int i = 0;
+
+  RSA_get0_key(key, &n, &e, &d);
+  RSA_get0_factors(key, &p, &q);
+  RSA_get0_crt_params(key, &dmp1, &dmq1, &iqmp);
+  c[0] = BN_dup(n);
+  c[1] = BN_dup(e);
+  c[2] = BN_dup(d);
+  c[3] = BN_dup(p);
+  c[4] = BN_dup(q);
+  c[5] = BN_dup(dmp1);
+  c[6] = BN_dup(dmq1);
+  c[7] = BN_dup(iqmp);
+  for(i = 0; (i < 8) && (NULL != c[i]); i++) {
+    BN_set_flags(c[i], BN_FLG_CONSTTIME);
+  }
+  if((8 == i) && RSA_set0_key(rsa, c[0], c[1], c[2])) {
+    c[0] = c[1] = c[2] = NULL;
+    if(RSA_set0_factors(rsa, c[3], c[4])) {
+      c[3] = c[4] = NULL;
+      if(RSA_set0_crt_params(rsa, c[5], c[6], c[7])) {
+        c[5] = c[6] = c[7] = NULL;
+        rv = 1;
+      }
+    }
+  }
+  for(i = 0; i < 8; i++) {
+    BN_clear_free(c[i]);
+  }
+  return rv;
+}
+
+/*! @brief Move a pooled key into the caller's RSA object
+  @param rsa the key to fill in
+  @param key the pooled key, freed
+  @return 1 on success, 0 on failure
+*/
+static int RSAPoolCopy(RSA *rsa, RSA *key)
+{
+  int rv = RSACopyKey(rsa, key);
+
+  RSA_free(key);
+  return rv;
+}
+
+/*! @brief Take a key of this size and exponent from the pool
+  The first call starts the worker and each new size is registered so
+  the worker fills it.
+  @param rsa the key to fill in
+  @param bits the key size
+  @param e the public exponent
+  @return 1 if rsa now holds a pooled key, 0 generate in line
+  @note Keys made before a fork() aren't handed out in the child, 
+  both processes would hold the same private key
+*/
+static int RSAPoolTake(RSA *rsa, int bits, BIGNUM *e)
+{
+  int rv = 0;
+  int i = 0;
+  int slot = -1;
+  RSA *key = NULL;
+
+  if((0 == rsa_pool_depth) || (-1 == rsa_pool_state)) {
+    return 0;
+  }
+  if(!pool_fork_hooked && (1 == rsa_pool_state) && 
+     (rsa_pool_pid != ICC_GetProcessId())) {
+    /* Forked child and fork() isn't hooked, the lock may have been 
+       held by a thread which didn't come with us. Leave the parent's 
+       pool alone and generate in line */
+    return 0;
+  }
+  ICC_LockMutex(&rsa_pool_mtx);
+  if(0 == rsa_pool_state) {
+    rsa_pool_pid = ICC_GetProcessId();
+    rsa_pool_state = 1;
+    if(0 != ICC_CreateThread(&rsa_pool_thr, rsa_pool_worker, NULL)) {
+      rsa_pool_state = -1;
+    }
+  }
+  for(i = 0; (1 == rsa_pool_state) && (i < RSA_POOL_SIZES); i++) {
+    if((bits == rsa_pool[i].bits) && (0 == BN_cmp(e, rsa_pool[i].e))) {
+      slot = i;
+      break;
+    }
+    if((slot < 0) && (0 == rsa_pool[i].bits)) {
+      slot = i; /* first free, used if there's no match */
+    }
+  }
+  if(slot >= 0) {
+    if((bits == rsa_pool[slot].bits) && (rsa_pool[slot].n > 0)) {
+      rsa_pool[slot].n--;
+      key = rsa_pool[slot].keys[rsa_pool[slot].n];
+      rsa_pool[slot].keys[rsa_pool[slot].n] = NULL;
+    } else if(0 == rsa_pool[slot].bits) {
+      rsa_pool[slot].e = BN_dup(e);
+      if(NULL != rsa_pool[slot].e) {
+        rsa_pool[slot].bits = bits;
+      }
+    }
+  }
+  ICC_UnlockMutex(&rsa_pool_mtx);
+  if(NULL != key) {
+    rv = RSAPoolCopy(rsa, key);
+  }
+  return rv;
+}
+
+/*! @brief Stop the pool worker and free the pooled keys
+  Only called in the library unload path
+*/
+static void RSAPoolStop(void)
+{
+  if(0 != rsa_pool_depth) {
+    if((1 == rsa_pool_state) && (rsa_pool_pid == ICC_GetProcessId())) {
+      rsa_pool_state = 2;
+      ICC_JoinThread(&rsa_pool_thr);
+    }
+    RSAPoolEmpty();
+    rsa_pool_depth = 0; /* before the mutex goes, see pool_fork_prepare() */
+    ICC_DestroyMutex(&rsa_pool_mtx);
+  }
+  rsa_pool_state = 0;
+}
+
+/* Background ephemeral EC/X25519 key pool, ICC_EC_KEY_POOL */
+#define EC_POOL_MAX 64   /*!< Largest pool depth per curve */
+#define EC_POOL_CURVES 4 /*!< Distinct curves pooled */
+#define EC_POOL_IDLE 10  /*!< mS the worker sleeps when the pool is full */
+
+/*! @brief Pre-generated ephemeral keys on one curve */
+typedef struct {
+  int nid;                     /*!< NID_X25519, NID_X448 or the EC curve, 0 for an unused slot */
+  int n;                       /*!< Keys held */
+  EVP_PKEY *keys[EC_POOL_MAX]; /*!< The keys, all passed the pair-wise test */
+} EC_POOL_SLOT;
+
+static EC_POOL_SLOT ec_pool[EC_POOL_CURVES];
+static ICC_Thread ec_pool_thr;
+static int ec_pool_state = 0; /*!< 0 not started, 1 running, 2 stopping, -1 no thread */
+static DWORD ec_pool_pid = 0; /*!< The process the pool was filled in */
+
+/*! @brief Set the number of keys pooled per curve, 0 disables the pool
+  @param n 0-EC_POOL_MAX
+  @note Only effective before the first keygen
+*/
+static void SetECPoolDepth(int n)
+{
+  if((n >= 0) && (n <= EC_POOL_MAX)) {
+    ec_pool_depth = n;
+  }
+}
+
+/*! @brief Free every pooled key and the registered curves
+  EVP_PKEY_free() clears the private keys
+  @note The caller holds the pool mutex or is the only thread left
+*/
+static void ECPoolEmpty(void)
+{
+  int i = 0;
+
+  for(i = 0; i < EC_POOL_CURVES; i++) {
+    while(ec_pool[i].n > 0) {
+      ec_pool[i].n--;
+      EVP_PKEY_free(ec_pool[i].keys[ec_pool[i].n]);
+      ec_pool[i].keys[ec_pool[i].n] = NULL;
+    }
+    ec_pool[i].nid = 0;
+  }
+}
+
+/*! @brief Generate and pair-wise test one key for the pool
+  @param nid NID_X25519, NID_X448 or a named EC curve
+  @return the key, NULL on failure
+*/
+static EVP_PKEY *ECPoolGen(int nid)
+{
+  int rv = 0;
+  EVP_PKEY_CTX *cctx = NULL;
+  EVP_PKEY *pk = NULL;
+
+  if((NID_X25519 == nid) || (NID_X448 == nid)) {
+    cctx = EVP_PKEY_CTX_new_id(nid, NULL);
+    rv = (NULL != cctx) && (1 == EVP_PKEY_keygen_init(cctx));
+  } else {
+    cctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    rv = (NULL != cctx) && (1 == EVP_PKEY_keygen_init(cctx)) &&
+         (1 == EVP_PKEY_CTX_set_ec_paramgen_curve_nid(cctx, nid));
+  }
+  if(rv) {
     RAND_seed(NULL,0); /* Reseed the RNG before keygen */
-    rv = RSA_generate_key_ex(rsa, bits, e, callback);
+    if(1 == EVP_PKEY_keygen(cctx, &pk)) {
+      if(ICC_OK != ((EVP_PKEY_EC == EVP_PKEY_base_id(pk)) ?
+                    iccECKEYPairTest(NULL, EVP_PKEY_get0_EC_KEY(pk)) :
+                    iccECXKEYRegenTest(NULL, pk))) {
+        EVP_PKEY_free(pk);
+        pk = NULL;
+      }
+    }
+  }
+  EVP_PKEY_CTX_free(cctx);
+  return pk;
+}
+
+/*! @brief Keep every registered curve topped up
+  Keys are generated outside the lock, a failed pair-wise test is fatal
+  as usual
+*/
+static ICC_THREAD_RET ICC_THREAD_CALL ec_pool_worker(void *arg)
+{
+  int i = 0;
+  int nid = 0;
+  int failed = 0;
+  EVP_PKEY *pk = NULL;
+
+  (void)arg;
+  while(1 == ec_pool_state) {
+    nid = 0;
+    ICC_LockMutex(&ec_pool_mtx);
+    for(i = 0; i < EC_POOL_CURVES; i++) {
+      if((0 != ec_pool[i].nid) && (ec_pool[i].n < ec_pool_depth)) {
+        nid = ec_pool[i].nid;
+        break;
+      }
+    }
+    ICC_UnlockMutex(&ec_pool_mtx);
+    if(0 == nid) {
+      ICC_Sleep(EC_POOL_IDLE);
+      continue;
+    }
+    pk = ECPoolGen(nid);
+    failed = (NULL == pk);
+    ICC_LockMutex(&ec_pool_mtx);
+    if((NULL != pk) && (1 == ec_pool_state) && 
+       (ec_pool[i].nid == nid) && (ec_pool[i].n < ec_pool_depth)) {
+      ec_pool[i].keys[ec_pool[i].n++] = pk;
+      pk = NULL;
+    }
+    ICC_UnlockMutex(&ec_pool_mtx);
+    if(NULL != pk) {
+      EVP_PKEY_free(pk);
+      pk = NULL;
+    }
+    if(failed) {
+      ICC_Sleep(EC_POOL_IDLE);
+    }
+  }
+  return 0;
+}
+
+/*! @brief Take a key for this keygen context from the pool
+  The first call starts the worker and each new curve is registered so
+  the worker fills it.
+  @param cctx the keygen context, only plain X25519, X448 and named 
+  curve EC contexts are served, see EVP_PKEY_CTX_keygen_nid()
+  @param pk where the key goes, *pk must be NULL
+  @return 1 if *pk now holds a pooled key, 0 generate in line
+  @note A key is removed from the pool as it's taken so it's never
+  handed out twice. Keys made before a fork() aren't handed out in the 
+  child, both processes would hold the same private key
+*/
+static int ECPoolTake(EVP_PKEY_CTX *cctx, EVP_PKEY **pk)
+{
+  int i = 0;
+  int nid = 0;
+  int slot = -1;
+  EVP_PKEY *key = NULL;
+
+  if((0 == ec_pool_depth) || (-1 == ec_pool_state) || 
+     (NULL == pk) || (NULL != *pk)) {
+    return 0;
+  }
+  nid = EVP_PKEY_CTX_keygen_nid(cctx);
+  if(NID_undef == nid) {
+    return 0;
+  }
+  if(!pool_fork_hooked && (1 == ec_pool_state) && 
+     (ec_pool_pid != ICC_GetProcessId())) {
+    /* Forked child and fork() isn't hooked, the lock may have been 
+       held by a thread which didn't come with us. Leave the parent's 
+       pool alone and generate in line */
+    return 0;
+  }
+  ICC_LockMutex(&ec_pool_mtx);
+  if(0 == ec_pool_state) {
+    ec_pool_pid = ICC_GetProcessId();
+    ec_pool_state = 1;
+    if(0 != ICC_CreateThread(&ec_pool_thr, ec_pool_worker, NULL)) {
+      ec_pool_state = -1;
+    }
+  }
+  for(i = 0; (1 == ec_pool_state) && (i < EC_POOL_CURVES); i++) {
+    if(nid == ec_pool[i].nid) {
+      slot = i;
+      break;
+    }
+    if((slot < 0) && (0 == ec_pool[i].nid)) {
+      slot = i; /* first free, used if there's no match */
+    }
+  }
+  if(slot >= 0) {
+    if((nid == ec_pool[slot].nid) && (ec_pool[slot].n > 0)) {
+      ec_pool[slot].n--;
+      key = ec_pool[slot].keys[ec_pool[slot].n];
+      ec_pool[slot].keys[ec_pool[slot].n] = NULL;
+    } else if(0 == ec_pool[slot].nid) {
+      ec_pool[slot].nid = nid;
+    }
   }
+  ICC_UnlockMutex(&ec_pool_mtx);
+  if((NULL != key) && getErrorState()) {
+    /* The module failed since this was made, don't hand it out */
+    EVP_PKEY_free(key);
+    key = NULL;
+  }
+  *pk = key;
+  return (NULL != key) ? 1 : 0;
+}
+
+/*! @brief Stop the pool worker and free the pooled keys
+  Only called in the library unload path
+*/
+static void ECPoolStop(void)
+{
+  if(0 != ec_pool_depth) {
+    if((1 == ec_pool_state) && (ec_pool_pid == ICC_GetProcessId())) {
+      ec_pool_state = 2;
+      ICC_JoinThread(&ec_pool_thr);
+    }
+    ECPoolEmpty();
+    ec_pool_depth = 0;
+    ICC_DestroyMutex(&ec_pool_mtx);
+  }
+  ec_pool_state = 0;
+}
+
+static int pool_fork_locked = 0; /*!< 1 RSA, 2 EC pool mutex taken by pool_fork_prepare() */
+
+/*! @brief fork() prepare handler, hold both pool locks across the fork()
+  so the child gets them in a consistent state. The workers never hold
+  them while generating a key so this doesn't wait long
+*/
+static void pool_fork_prepare(void)
+{
+  pool_fork_locked = 0;
+  if(0 != rsa_pool_depth) {
+    ICC_LockMutex(&rsa_pool_mtx);
+    pool_fork_locked |= 1;
+  }
+  if(0 != ec_pool_depth) {
+    ICC_LockMutex(&ec_pool_mtx);
+    pool_fork_locked |= 2;
+  }
+}
+
+/*! @brief fork() parent handler, release the pool locks */
+static void pool_fork_parent(void)
+{
+  if(pool_fork_locked & 2) {
+    ICC_UnlockMutex(&ec_pool_mtx);
+  }
+  if(pool_fork_locked & 1) {
+    ICC_UnlockMutex(&rsa_pool_mtx);
+  }
+}
+
+/*! @brief fork() child handler, runs once before any other thread exists.
+  The workers didn't come with us and the keys are the parent's, so the
+  pools are emptied and the next take starts a new worker
+*/
+static void pool_fork_child(void)
+{
+  if(pool_fork_locked & 2) {
+    ECPoolEmpty();
+    if(1 == ec_pool_state) {
+      ec_pool_state = 0;
+    }
+    ICC_UnlockMutex(&ec_pool_mtx);
+  }
+  if(pool_fork_locked & 1) {
+    RSAPoolEmpty();
+    if(1 == rsa_pool_state) {
+      rsa_pool_state = 0;
+    }
+    ICC_UnlockMutex(&rsa_pool_mtx);
+  }
+}
+
+/* Per thread RSA private key clones, RSA_ThreadCache() */
+#define RSA_TC_MAX 64 /*!< Most clones held per key */
+
+/*! @brief The clones of one key, held in the key's ex_data */
+typedef struct {
+  int n;          /*!< Clones held */
+  RSA *c[1];      /*!< The clones, n of them */
+} RSA_TC;
+
+/*! @brief Free a key's clones when the key is freed */
+static void rsa_tc_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad,
+                        int idx, long argl, void *argp)
+{
+  int i = 0;
+  RSA_TC *tc = (RSA_TC *)ptr;
+
+  (void)parent; (void)ad; (void)idx; (void)argl; (void)argp;
+  if(NULL != tc) {
+    for(i = 0; i < tc->n; i++) {
+      RSA_free(tc->c[i]);
+    }
+    ICC_Free(tc);
+  }
+}
+
+/*! @brief The key to use for a private key operation on this thread
+  Threads are numbered the first time they get here and always use the
+  same clone, so each clone's blinding belongs to the first thread that
+  used it and OpenSSL doesn't fall back to the shared, locked, mt_blinding
+  @param rsa the caller's key
+  @return the calling thread's clone if rsa was set up by RSA_ThreadCache(),
+  otherwise rsa
+*/
+static RSA *RSAThreadKey(RSA *rsa)
+{
+  RSA_TC *tc = NULL;
+  size_t slot = 0;
+
+  if((rsa_tc_idx < 0) || (NULL == rsa) || 
+     (NULL == (tc = (RSA_TC *)RSA_get_ex_data(rsa, rsa_tc_idx)))) {
+    return rsa;
+  }
+  slot = (size_t)ICC_GetThreadValue(&rsa_tc_key);
+  if(0 == slot) {
+    ICC_LockMutex(&rsa_tc_mtx);
+    slot = ++rsa_tc_next;
+    if(0 == slot) {
+      slot = ++rsa_tc_next; /* 0 is "not numbered yet" */
+    }
+    ICC_UnlockMutex(&rsa_tc_mtx);
+    ICC_SetThreadValue(&rsa_tc_key, (void *)slot);
+  }
+  return tc->c[(slot - 1) % (size_t)tc->n];
+}
+
+/*! @brief Give an RSA private key per thread blinding and Montgomery contexts
+  The key gets n private clones, each with it's own blinding factors and
+  cached Montgomery contexts for N, P and Q. RSA_sign(), RSA_private_encrypt()
+  and RSA_private_decrypt() then run on the calling thread's clone. 
+  For one hot key shared by many threads.
+  @param rsa the key, with the CRT parameters
+  @param n the number of clones (1-64), 0 for one per CPU
+  @return 1 on success, 0 on failure
+  @note Call this before the key is shared between threads and don't change
+  the key afterwards. The clones are freed with the key
+*/
+int RSA_ThreadCache(RSA *rsa, int n)
+{
+  int rv = 0;
+  int i = 0;
+  RSA_TC *tc = NULL;
+  const BIGNUM *p = NULL, *q = NULL;
+
+  if((NULL == rsa) || (rsa_tc_idx < 0) || (NULL == FIPS_RSA_meth)) {
+    return 0;
+  }
+  if(0 == n) {
+    n = ICC_GetCPUCount();
+  }
+  if(n < 1) {
+    n = 1;
+  }
+  if(n > RSA_TC_MAX) {
+    n = RSA_TC_MAX;
+  }
+  if(NULL != RSA_get_ex_data(rsa, rsa_tc_idx)) {
+    return 1; /* Already set up */
+  }
+  RSA_get0_factors(rsa, &p, &q);
+  if((NULL == p) || (NULL == q) || 
+     ((const RSA_METHOD *)FIPS_RSA_meth != RSA_get_method(rsa))) {
+    return 0; /* No CRT, or an engine/HSM method the clones wouldn't have */
+  }
+  tc = (RSA_TC *)ICC_Calloc(1, sizeof(RSA_TC) + (n - 1) * sizeof(RSA *), 
+                            __FILE__, __LINE__);
+  if(NULL != tc) {
+    for(i = 0; i < n; i++) {
+      tc->c[i] = RSA_new();
+      if((NULL == tc->c[i]) || !RSACopyKey(tc->c[i], rsa)) {
+        break;
+      }
+      RSA_set_flags(tc->c[i], RSA_flags(rsa));
+      tc->n++;
+    }
+    if(i == n) {
+      rv = RSA_set_ex_data(rsa, rsa_tc_idx, tc);
+    }
+    if(1 != rv) {
+      if(i < n) {
+        RSA_free(tc->c[i]);
+      }
+      rsa_tc_free(NULL, tc, NULL, 0, 0, NULL);
+      rv = 0;
+    }
+  }
+  return rv;
+}
+
+/*
+  Note: We use this code in both FIPS and non-FIPS modes so the policy checks that were 
+  in OpenSSL are lifted and done at this level instead
+  i.e. valid FIPS key size range and minimum exponent size
+
+*/
 
+int my_RSA_generate_key_ex(ICClib *pcb, RSA *rsa, int bits, BIGNUM *e, void *callback)
+{
+  int rv = 1;
+  int nid = 0;
+  int fips = 0;
+  int pooled = 0;
+  BIGNUM *elim = NULL;
+  /* Overall sanity check, the KeyPair check has a fixed length buffer but this is sane even in non-FIPS mode  */
+  if (bits < 512 || bits > 16384)
+  {
+    rv = 0;
+  }
+  if (!CondKAT(KA_GROUP_PKEY))
+  {
+    rv = 0;
+  }
+  /* Unlike OpenSSL, we make the policy decisions, key size, exponent at this level 
+    and are more permissive if not in FIPS mode.
+  */
   if ((1 == rv) && (pcb->flags & ICC_FIPS_FLAG))
+  {
+    elim = BN_new();
+    BN_set_word(elim, 0x10001);
+    if ((bits < 2048) || (bits > 8192) || (BN_cmp(e, elim) < 0) || !BN_is_odd(e) || (BN_num_bits(e) > 256))
+    {
+      rv = 0;
+    }
+    BN_free(elim);
+  }
+  if ((1 == rv) && (NULL == callback))
+  {
+    pooled = RSAPoolTake(rsa, bits, e);
+  }
+  if ((1 == rv) && !pooled)
+  {
+    RAND_seed(NULL,0); /* Reseed the RNG before keygen */
+    if (RSAKeygenParallelOK(rsa, bits, e, callback))
+    {
+      rv = RSAKeygenParallel(rsa, bits, e);
+    }
+    else
+    {
+      rv = RSA_generate_key_ex(rsa, bits, e, callback);
+    }
+  }
+
+  if ((1 == rv) && pooled && (pcb->flags & ICC_FIPS_FLAG))
+  {
+    /* Passed the pair-wise test when it was generated */
+    fips = 1;
+  }
+  else if ((1 == rv) && (pcb->flags & ICC_FIPS_FLAG))
   {
     /* The RSA size check here is to cater for the NIST test case where the key is preloaded with P&Q 
       keygen isn't actually done so rsa->n is 0 length. 
@@ -2296,7 +4366,7 @@ int my_RSA_generate_key_ex(ICClib *pcb, RSA *rsa, int bits, BIGNUM *e, void *cal
 DH * my_DH_generate_parameters(ICClib *pcb,int bits, int generator,void (*callback)(int,int,void *),void *cb_arg)
 {
   DH *temp = NULL;
-  temp = DH_generate_parameters(bits, generator,callback,cb_arg);
+  temp = DHParamGen(bits, generator, callback, cb_arg);
   if((NULL != pcb->callback) && (NULL != temp)) {
     (*pcb->callback)("ICC_DH_generate_parameters",946,0); /* Never FIPS compliant */
   }
@@ -2306,7 +4376,7 @@ DSA * my_DSA_generate_parameters(ICClib *pcb,int bits,unsigned char *seed,int se
 {
   DSA *temp = NULL;
   RAND_seed(NULL,0); /* Reseed the RNG before keygen */
-  temp = DSA_generate_parameters(bits,seed,seed_len,counter_ret,h_ret,callback,cb_arg);
+  temp = DSAParamGen(bits,seed,seed_len,counter_ret,h_ret,callback,cb_arg);
   if((NULL != pcb->callback) && (NULL != temp)) {
     (*pcb->callback)("ICC_DSA_generate_parameters",116,0); /* Never FIPS compliant */
   }
@@ -2317,7 +4387,8 @@ int my_DSA_generate_key(ICClib *pcb, DSA *a) {
   int temp = ICC_FAILURE;
 
   int i = 0;
-  if ((NULL != pcb) && !((pcb->flags & ICC_FIPS_FLAG) && getErrorState())) {
+  if ((NULL != pcb) && !((pcb->flags & ICC_FIPS_FLAG) && getErrorState()) &&
+      CondKAT(KA_GROUP_PKEY)) {
     RAND_seed(NULL,0); /* Reseed the RNG before keygen */
     temp = DSA_generate_key(a);
     if (pcb->flags & ICC_FIPS_FLAG) {
@@ -2353,8 +4424,19 @@ int my_DSA_generate_key(ICClib *pcb, DSA *a) {
 EC_KEY *my_EC_KEY_new_by_curve_name(ICClib *pcb,int nid)
 {
   EC_KEY *temp = NULL;
+  const EC_GROUP *grp = NULL;
   int fips = 0;
-  temp = EC_KEY_new_by_curve_name(nid);
+  grp = ec_group_lookup(nid);
+  if(NULL != grp) {
+    /* Copies the group, the precomputed multiples are shared */
+    temp = EC_KEY_new();
+    if((NULL != temp) && (1 != EC_KEY_set_group(temp, grp))) {
+      EC_KEY_free(temp);
+      temp = NULL;
+    }
+  } else {
+    temp = EC_KEY_new_by_curve_name(nid);
+  }
   if(NULL != temp) {
     switch (nid)
     {
@@ -2383,12 +4465,16 @@ EC_KEY *my_EC_KEY_new_by_curve_name(ICClib *pcb,int nid)
 }
 int my_EC_KEY_generate_key(ICClib *pcb, EC_KEY *eckey) {
   int temp = ICC_FAILURE;
-  if ((NULL != pcb) && !((pcb->flags & ICC_FIPS_FLAG) && getErrorState())) {
+  if ((NULL != pcb) && !((pcb->flags & ICC_FIPS_FLAG) && getErrorState()) &&
+      CondKAT(KA_GROUP_PKEY)) {
     RAND_seed(NULL,0); /* Reseed the RNG before keygen */
     temp = EC_KEY_generate_key(eckey);
     if (pcb->flags & ICC_FIPS_FLAG) {
+      /* Key agreement only keys get the cheaper Q = d.G test */
       if ((((ECDSA_size(eckey) - 8) / 2) < 20) ||
-          (ICC_OK != iccECKEYPairTest(pcb, eckey))) {
+          (ICC_OK != ((EC_KEY_get_flags(eckey) & ICC_EC_FLAG_KEY_AGREEMENT) ?
+                      iccECKEYRegenTest(pcb, eckey) :
+                      iccECKEYPairTest(pcb, eckey)))) {
         temp = (int)ICC_FAILURE;
       }
     }
@@ -2403,6 +4489,10 @@ int my_RAND_bytes(unsigned char *buf,int n)
   rv = RAND_pseudo_bytes(buf,n);
   return rv;
 }
+int my_RAND_bytes_v(const ICC_RNG_IOV *iov,unsigned int cnt)
+{
+  return RAND_FIPS_bytes_v(iov,cnt);
+}
 int my_EVP_PKEY_decrypt_new(EVP_PKEY_CTX *ctx, 
 			    unsigned char *out, size_t *outlen,
 			    const unsigned char *in, size_t inlen) {
@@ -2527,6 +4617,10 @@ typedef struct {
   @param check 0 not capable of doing a sign/verify check. 1 capable of doing a sign/verify check on keygen
         2 Verify only is FIPS approved
   @param nid NID of the algorithm if it can be identified
+  @note Only called when a FIPS callback is installed. Every lookup here
+  reads a field already held in the key (type, modulus bit count, curve NID),
+  there's no BN or EC arithmetic, so a verdict cached in ex_data would cost
+  about the same to fetch and could go stale if the key is reassigned.
 */
 static int PKEY_FIPS_id(EVP_PKEY *pk, int *check,int *nid)
 {
@@ -2649,15 +4743,27 @@ int my_EVP_PKEY_keygen(ICClib *pcb, EVP_PKEY_CTX *cctx, EVP_PKEY **pk)
   static unsigned char in[32] = "01234567890abcdefghi01234567890";
   int inlen = 20;
   int nid = 0;
+  int pooled = 0;
 
-  RAND_seed(NULL,0); /* Reseed before keygen */
-  rv = EVP_PKEY_keygen(cctx, pk);
+  if(CondKAT(KA_GROUP_PKEY)) {
+    pooled = ECPoolTake(cctx, pk);
+    if(pooled) {
+      rv = 1;
+    } else {
+      RAND_seed(NULL,0); /* Reseed before keygen */
+      rv = EVP_PKEY_keygen(cctx, pk);
+    }
+  }
   md = EVP_get_digestbyname("SHA-224");
   if ((pcb != NULL) && (pcb->flags & ICC_FIPS_FLAG))
   {
     if ((1 == rv) && (NULL != pk) )
     {
       fips = PKEY_FIPS_id(*pk,&check,&nid);
+      if (pooled)
+      {
+        check = 0; /* Passed the pair-wise test when it was generated */
+      }
       if (1 == check)
       {
         md_ctx = EVP_MD_CTX_new();
@@ -2719,7 +4825,9 @@ int my_EVP_PKEY_sign_init(ICClib *pcb,EVP_PKEY_CTX *pctx)
   int check = 0;
   EVP_PKEY *pk = NULL;
 
-  rv = EVP_PKEY_sign_init(pctx);
+  if(CondKAT(KA_GROUP_SIG)) {
+    rv = EVP_PKEY_sign_init(pctx);
+  }
   if((NULL != pcb->callback) && (1 == rv)) {
     pk =  EVP_PKEY_CTX_get0_pkey(pctx);
     if(NULL != pk) { 
@@ -2737,7 +4845,9 @@ int my_EVP_PKEY_verify_init(ICClib *pcb,EVP_PKEY_CTX *pctx)
   int check = 0;
   EVP_PKEY *pk = NULL;
 
-  rv = EVP_PKEY_verify_init(pctx);
+  if(CondKAT(KA_GROUP_SIG)) {
+    rv = EVP_PKEY_verify_init(pctx);
+  }
   if((NULL != pcb->callback) && (1 == rv)) {
     pk =  EVP_PKEY_CTX_get0_pkey(pctx);
     if(NULL != pk) {
@@ -2757,7 +4867,9 @@ int my_EVP_DigestSignInit(ICClib *pcb,EVP_MD_CTX *ctx, EVP_PKEY_CTX **pctx,const
   int nid = 0;
   int hnid = 0;
 
-  rv = EVP_DigestSignInit(ctx,pctx,type, e, pkey);
+  if(CondKAT(KA_GROUP_SIG)) {
+    rv = EVP_DigestSignInit(ctx,pctx,type, e, pkey);
+  }
   /* Now check the pkey and the digest for fips validity 
     We'll try to return the nid of the failed whatever in the fail case
   */
@@ -2789,7 +4901,9 @@ int my_EVP_DigestVerifyInit(ICClib *pcb,EVP_MD_CTX *ctx, EVP_PKEY_CTX **pctx,con
   int nid = 0;
   int hnid = 0;
 
-  rv = EVP_DigestVerifyInit(ctx,pctx,type, e,pkey);
+  if(CondKAT(KA_GROUP_SIG)) {
+    rv = EVP_DigestVerifyInit(ctx,pctx,type, e,pkey);
+  }
   if((NULL != pcb->callback) && (1 == rv) ) {
     fips = PKEY_FIPS_id(pkey,&check,&nid);
     if(NULL != type) {  
@@ -2807,12 +4921,42 @@ int my_EVP_DigestVerifyInit(ICClib *pcb,EVP_MD_CTX *ctx, EVP_PKEY_CTX **pctx,con
   return rv;
 }
 
-int my_SP800_38F_KW(ICClib *pcb,unsigned char *in, int inl, unsigned char *out, int *outl, unsigned char *key, int kl,unsigned int flags) 
+int my_EVP_DigestVerifyFinal(ICClib *pcb,EVP_MD_CTX *ctx,unsigned char *sig, size_t siglen)
+{
+  int rv = 0;
+
+  if(!vc_digest_verify(pcb,ctx,sig,siglen,&rv)) {
+    rv = EVP_DigestVerifyFinal(ctx,sig,siglen);
+  }
+  return rv;
+}
+
+int my_EVP_DigestVerify(ICClib *pcb,EVP_MD_CTX *md_ctx, const unsigned char *sigret, size_t siglen, const unsigned char *tbs, size_t tbslen)
 {
   int rv = 0;
+
+  if(vc_use_evp(pcb,md_ctx)) {
+    /* EVP_DigestVerify() is update + final for these keys */
+    if(EVP_DigestVerifyUpdate(md_ctx,tbs,tbslen) <= 0) {
+      rv = -1;
+    } else if(!vc_digest_verify(pcb,md_ctx,sigret,siglen,&rv)) {
+      rv = EVP_DigestVerifyFinal(md_ctx,sigret,siglen);
+    }
+  } else {
+    rv = EVP_DigestVerify(md_ctx,sigret,siglen,tbs,tbslen);
+  }
+  return rv;
+}
+
+/*! @brief Report a key wrap operation to the FIPS callback
+  @param pcb ICC library context
+  @param name the API name
+  @param kl the AES key length, bits or bytes
+*/
+static void KW_callback(ICClib *pcb,const char *name,int kl)
+{
   int nid = 0;
   int fips = 0;
-  rv = SP800_38F_KW(in, inl, out, outl, key, kl,flags);
   if(pcb->callback) {
     switch (kl)
     {
@@ -2834,8 +4978,27 @@ int my_SP800_38F_KW(ICClib *pcb,unsigned char *in, int inl, unsigned char *out,
     default:
       break;
     }
-    (*pcb->callback)("ICC_SP800_38F_KW",nid,fips);
+    (*pcb->callback)(name,nid,fips);
+  }
+}
+
+int my_SP800_38F_KW(ICClib *pcb,unsigned char *in, int inl, unsigned char *out, int *outl, unsigned char *key, int kl,unsigned int flags) 
+{
+  int rv = 0;
+  if(CondKAT(KA_GROUP_CIPHER)) {
+    rv = SP800_38F_KW(in, inl, out, outl, key, kl,flags);
+  }
+  KW_callback(pcb,"ICC_SP800_38F_KW",kl);
+  return rv;
+}
+
+int my_SP800_38F_CTX_Init(ICClib *pcb,SP800_38F_CTX *ctx,unsigned char *key,int kl) 
+{
+  int rv = 0;
+  if(CondKAT(KA_GROUP_CIPHER)) {
+    rv = SP800_38F_CTX_Init(ctx,key,kl);
   }
+  KW_callback(pcb,"ICC_SP800_38F_CTX_Init",kl);
   return rv;
 }
 
@@ -2846,7 +5009,9 @@ int my_EVP_PKEY_derive_init(ICClib *pcb,EVP_PKEY_CTX *ctx)
   int nid = 0;
   int check = 0;
   EVP_PKEY *pkey = NULL;
-  rv = EVP_PKEY_derive_init(ctx);
+  if(CondKAT(KA_GROUP_PKEY)) {
+    rv = EVP_PKEY_derive_init(ctx);
+  }
   if((NULL != pcb->callback) && (1 == rv) ) {
     pkey = EVP_PKEY_CTX_get0_pkey(ctx);
     if(NULL != pkey) {
@@ -2862,7 +5027,9 @@ int my_RSA_sign(ICClib *pcb,int nid, const unsigned char *dgst, int dlen, unsign
   int fips = 0; 
   int len = 0;
 
-  rv = RSA_sign(nid,dgst, dlen, sig, siglen,rsa);
+  if(CondKAT(KA_GROUP_SIG)) {
+    rv = RSA_sign(nid,dgst, dlen, sig, siglen,RSAThreadKey(rsa));
+  }
   if((NULL != pcb->callback) && (1 == rv)) {
     len = RSA_size(rsa);
     if(len >= 256 && len <= 512) { /* Key length is plausible, 2k->4k */
@@ -2878,7 +5045,21 @@ int my_RSA_verify(ICClib *pcb,int nid, const unsigned char *dgst, int dgst_len,
   int fips = 0; 
   int len = 0;
 
-  rv = RSA_verify(nid,dgst, dgst_len, sigbuf, siglen, rsa);
+  int cached = 0;
+  unsigned char h[SHA256_DIGEST_LENGTH];
+
+  if(CondKAT(KA_GROUP_SIG)) {
+    if(vc_use(pcb) && vc_key_low(h,rsa,NULL,nid,dgst,dgst_len,sigbuf,siglen)) {
+      cached = 1;
+      rv = vc_lookup(h);
+    }
+    if(1 != rv) {
+      rv = RSA_verify(nid,dgst, dgst_len, sigbuf, siglen, rsa);
+      if(cached && (1 == rv)) {
+        vc_store(h);
+      }
+    }
+  }
   if((NULL != pcb->callback) && (1 == rv)) {
     len = RSA_size(rsa);
     if(len >= 256 && len <= 512) { /* Key length is plausible */
@@ -2889,6 +5070,25 @@ int my_RSA_verify(ICClib *pcb,int nid, const unsigned char *dgst, int dgst_len,
   return rv;
 }
 
+int my_ECDSA_verify(ICClib *pcb,int type, const unsigned char *dgst,int dgstlen, const unsigned char *sig,int siglen, EC_KEY *eckey)
+{
+  int rv = 0;
+  int cached = 0;
+  unsigned char h[SHA256_DIGEST_LENGTH];
+
+  if(vc_use(pcb) && vc_key_low(h,NULL,eckey,0,dgst,dgstlen,sig,siglen)) {
+    cached = 1;
+    rv = vc_lookup(h);
+  }
+  if(1 != rv) {
+    rv = ECDSA_verify(type,dgst,dgstlen,sig,siglen,eckey);
+    if(cached && (1 == rv)) {
+      vc_store(h);
+    }
+  }
+  return rv;
+}
+
 int my_RSA_public_encrypt(ICClib *pcb,int flen, unsigned char *from,unsigned char *to, RSA *rsa,int padding)
 {
   int rv = 0;
@@ -2903,7 +5103,9 @@ int my_RSA_public_encrypt(ICClib *pcb,int flen, unsigned char *from,unsigned cha
   if(len > flen) {
     cklen = flen;
   }
-  rv = RSA_public_encrypt(flen,from,to,rsa,padding);
+  if(CondKAT(KA_GROUP_PKEY)) {
+    rv = RSA_public_encrypt(flen,from,to,rsa,padding);
+  }
   if(1 == rv) {
     if(0 == memcmp(from,to,cklen)) { /* Output unmodified , fail */
       rv = -1;
@@ -2934,7 +5136,9 @@ int my_RSA_private_decrypt(ICClib *pcb,int flen, const unsigned char *from,unsig
   if(len > flen) {
     cklen = flen;
   }
-  rv = RSA_private_decrypt(flen,from,to,rsa,padding);
+  if(CondKAT(KA_GROUP_PKEY)) {
+    rv = RSA_private_decrypt(flen,from,to,RSAThreadKey(rsa),padding);
+  }
   if(1 == rv) {
     if(0 == memcmp(from,to,cklen)) { /* Output unmodified , fail */
       rv = -1;
@@ -2965,7 +5169,9 @@ int my_RSA_public_decrypt(ICClib *pcb,int flen, unsigned char *from,unsigned cha
   if(len > flen) {
     cklen = flen;
   }
-  rv = RSA_public_decrypt(flen,from,to,rsa,padding);
+  if(CondKAT(KA_GROUP_PKEY)) {
+    rv = RSA_public_decrypt(flen,from,to,rsa,padding);
+  }
   if( 1 == rv) {
     if(0 == memcmp(from,to,cklen)) { /* Output unmodified , fail */
       rv = -1;
@@ -2996,7 +5202,9 @@ int my_RSA_private_encrypt(ICClib *pcb,int flen, const unsigned char *from,unsig
   if(len > flen) {
     cklen = flen;
   }
-  rv = RSA_private_encrypt(flen,from,to,rsa,padding);
+  if(CondKAT(KA_GROUP_PKEY)) {
+    rv = RSA_private_encrypt(flen,from,to,RSAThreadKey(rsa),padding);
+  }
   if(1 == rv) {
     if(0 == memcmp(from,to,cklen)) { /* Output unmodified , fail */
       rv = -1;
@@ -3012,32 +5220,891 @@ int my_RSA_private_encrypt(ICClib *pcb,int flen, const unsigned char *from,unsig
   return rv;
 }
 
+/*! @brief Is this PBKDF2 call FIPS compliant ?
+  @param nid the digest NID
+  @param passlen the length of the passphrase
+  @param saltlen the length of the salt
+  @param iters the iteration count
+  @param keylen the length of the output
+  @return 1 if it is
+*/
+static int PBKDF2_fips(int nid,int passlen,int saltlen,int iters,int keylen)
+{
+  int fips = FIPS_MDbyNID(nid);
+  if( 1 == fips) {
+    if((saltlen < 16) ||  (iters < 1000) || (keylen < 14) || (passlen < 10) ){
+      fips = 0;
+    }      
+  }
+  return fips;
+}
+
+/*! @brief The maximum for ICC_PBKDF2_THREADS */
+#define PBKDF2_MAX_THREADS 8
+
+/*! @brief Set the number of threads a multi-block PBKDF2 call may use
+  @param n the thread count, 1-8, 1 disables threading
+  @return 1 if the value was accepted, 0 otherwise
+*/
+static int SetPBKDF2Threads(int n)
+{
+  int rv = 0;
+  if((n >= 1) && (n <= PBKDF2_MAX_THREADS)) {
+    pbkdf2_threads = n;
+    rv = 1;
+  }
+  return rv;
+}
+
+/*! @brief One worker's share of a threaded PBKDF2 call */
+typedef struct {
+  const char *pass;
+  int passlen;
+  const unsigned char *salt;
+  int saltlen;
+  int iters;
+  const EVP_MD *digest;
+  int keylen;
+  unsigned char *out;
+  unsigned int first;  /*!< First output block, from 1 */
+  unsigned int step;   /*!< Block stride, the number of shares */
+  int rv;
+} PBKDF2_SHARE;
+
+static ICC_THREAD_RET ICC_THREAD_CALL pbkdf2_worker(void *arg)
+{
+  PBKDF2_SHARE *w = (PBKDF2_SHARE *)arg;
+  w->rv = PBKDF2_HMAC_Blocks(w->pass,w->passlen,w->salt,w->saltlen,w->iters,
+                             w->digest,w->keylen,w->out,w->first,w->step);
+  return 0;
+}
+
+/*! @brief PBKDF2 with the output blocks spread over worker threads
+  Each output block is an independent iteration chain, so block j 
+  goes to share (j-1) % shares. The calling thread runs the first share.
+  Falls back to a single thread when threading is off, there's only 
+  one block or a thread can't be started.
+  @return 1 on success, 0 on failure
+*/
+static int PBKDF2_threaded(const char *pass, int passlen, const unsigned char *salt, int saltlen, int iters, const EVP_MD *digest, int keylen, unsigned char *out)
+{
+  int rv = 0;
+  PBKDF2_SHARE w[PBKDF2_MAX_THREADS];
+  ICC_Thread thr[PBKDF2_MAX_THREADS];
+  int started[PBKDF2_MAX_THREADS];
+  int shares = pbkdf2_threads;
+  int hlen = 0;
+  int cpus = 0;
+  int i = 0;
+
+  if((shares > 1) && (NULL != digest) && (keylen > 0)) {
+    hlen = EVP_MD_size(digest);
+    if(hlen > 0) {
+      if(shares > (keylen + hlen - 1) / hlen) {
+        shares = (keylen + hlen - 1) / hlen;
+      }
+      cpus = ICC_GetCPUCount();
+      if((cpus > 0) && (shares > cpus)) {
+        shares = cpus;
+      }
+    }
+  }
+  /* Only digests and parameters the block engine accepts are split,
+     asking for a block past the end of the key just checks that */
+  if((shares > 1) && 
+     (1 == PBKDF2_HMAC_Blocks(pass,passlen,salt,saltlen,iters,digest,
+                              keylen,out,(unsigned int)(keylen / hlen) + 2,1))) {
+    for(i = 0; i < shares; i++) {
+      w[i].pass = pass;
+      w[i].passlen = passlen;
+      w[i].salt = salt;
+      w[i].saltlen = saltlen;
+      w[i].iters = iters;
+      w[i].digest = digest;
+      w[i].keylen = keylen;
+      w[i].out = out;
+      w[i].first = (unsigned int)i + 1;
+      w[i].step = (unsigned int)shares;
+      w[i].rv = 0;
+      started[i] = 0;
+    }
+    rv = 1;
+    for(i = 1; i < shares; i++) {
+      if(0 == ICC_CreateThread(&thr[i],pbkdf2_worker,&w[i])) {
+        started[i] = 1;
+      }
+    }
+    pbkdf2_worker(&w[0]);
+    for(i = 0; i < shares; i++) {
+      if(started[i]) {
+        ICC_JoinThread(&thr[i]);
+      } else if(i > 0) {
+        /* Couldn't start that one, do it here */
+        pbkdf2_worker(&w[i]);
+      }
+      if(1 != w[i].rv) {
+        rv = 0;
+      }
+    }
+    if(1 != rv) {
+      OPENSSL_cleanse(out,keylen);
+    }
+  } else {
+    rv = PBKDF2_HMAC(pass, passlen,salt, saltlen, iters, digest, keylen, out);
+  }
+  return rv;
+}
+
 int my_PKCS5_PBKDF2_HMAC(ICClib *pcb,const char *pass, int passlen, const unsigned char *salt, int saltlen, int iters, const EVP_MD *digest, int keylen, unsigned char *out)
 {
   int rv = 0;
   int fips = 0; 
   int nid = 0;
-  rv = PKCS5_PBKDF2_HMAC(pass, passlen,salt, saltlen, iters, digest, keylen, out);
+  if(CondKAT(KA_GROUP_KDF)) {
+    rv = PBKDF2_threaded(pass, passlen,salt, saltlen, iters, digest, keylen, out);
+  }
+  if((pcb->callback) && (1 == rv)) {
+    nid = EVP_MD_type(digest);
+    fips = PBKDF2_fips(nid,passlen,saltlen,iters,keylen);
+    (*pcb->callback)("ICC_PKCS5_PBKDF2_HMAC",nid,fips);
+  }
+  return rv;
+}
+
+int my_PBKDF2_HMAC_Batch(ICClib *pcb,const EVP_MD *digest,PBKDF2_REC *recs,unsigned int n)
+{
+  int rv = 0;
+  int fips = 1; 
+  int nid = 0;
+  unsigned int i = 0;
+  if(CondKAT(KA_GROUP_KDF)) {
+    rv = PBKDF2_HMAC_Batch(digest,recs,n);
+  }
+  if((pcb->callback) && (NULL != recs) && (NULL != digest)) {
+    nid = EVP_MD_type(digest);
+    /* FIPS only if every entry was */
+    for(i = 0; (1 == fips) && (i < n); i++) {
+      fips = PBKDF2_fips(nid,recs[i].passlen,recs[i].saltlen,recs[i].iters,recs[i].keylen);
+    }
+    (*pcb->callback)("ICC_PBKDF2_HMAC_Batch",nid,fips);
+  }
+  return rv;
+}
+
+int my_DIGEST_Multi(ICClib *pcb,const EVP_MD *md,DIGEST_REC *recs,unsigned int n)
+{
+  int rv = 0;
+  int nid = 0;
+  if(CondKAT(KA_GROUP_CORE)) {
+    rv = DIGEST_Multi(md,recs,n);
+  }
+  if((pcb->callback) && (NULL != md)) {
+    nid = EVP_MD_type(md);
+    (*pcb->callback)("ICC_DIGEST_Multi",nid,FIPS_MDbyNID(nid));
+  }
+  return rv;
+}
+
+int my_XOF_CTX_Init(ICClib *pcb,XOF_CTX *ctx,const EVP_MD *md)
+{
+  int rv = 0;
+  int nid = 0;
+  if(CondKAT(KA_GROUP_CORE)) {
+    rv = XOF_CTX_Init(ctx,md);
+  }
+  if((pcb->callback) && (NULL != md)) {
+    nid = EVP_MD_type(md);
+    (*pcb->callback)("ICC_XOF_CTX_Init",nid,FIPS_MDbyNID(nid));
+  }
+  return rv;
+}
+
+int my_XOF_CTX_InitCustom(ICClib *pcb,XOF_CTX *ctx,const EVP_MD *md,const unsigned char *N,size_t Nlen,const unsigned char *S,size_t Slen)
+{
+  int rv = 0;
+  int nid = 0;
+  if(CondKAT(KA_GROUP_CORE)) {
+    rv = XOF_CTX_InitCustom(ctx,md,N,Nlen,S,Slen);
+  }
+  if((pcb->callback) && (NULL != md)) {
+    nid = EVP_MD_type(md);
+    (*pcb->callback)("ICC_XOF_CTX_InitCustom",nid,FIPS_MDbyNID(nid));
+  }
+  return rv;
+}
+
+int my_PHASH_CTX_Init(ICClib *pcb,PHASH_CTX *ctx,const EVP_MD *md,size_t B,const unsigned char *S,size_t Slen)
+{
+  int rv = 0;
+  int nid = 0;
+  if(CondKAT(KA_GROUP_CORE)) {
+    rv = PHASH_CTX_Init(ctx,md,B,S,Slen);
+  }
+  if((pcb->callback) && (NULL != md)) {
+    nid = EVP_MD_type(md);
+    (*pcb->callback)("ICC_PHASH_CTX_Init",nid,FIPS_MDbyNID(nid));
+  }
+  return rv;
+}
+
+int my_HMAC_KEY_Init(ICClib *pcb,HMAC_KEY *hk,const EVP_MD *digest,const unsigned char *key,int keylen)
+{
+  int rv = 0;
+  int nid = 0;
+  int fips = 0;
+  if(CondKAT(KA_GROUP_MAC)) {
+    rv = HMAC_KEY_Init(hk,digest,key,keylen);
+  }
   if((pcb->callback) && (1 == rv)) {
     nid = EVP_MD_type(digest);
     fips = FIPS_MDbyNID(nid);
-    if( 1 == fips) {
-      if((saltlen < 16) ||  (iters < 1000) || (keylen < 14) || (passlen < 10) ){
+    /* SP800-131A, HMAC keys of at least 112 bits */
+    if(keylen < 14) {
+      fips = 0;
+    }
+    (*pcb->callback)("ICC_HMAC_KEY_Init",nid,fips);
+  }
+  return rv;
+}
+
+int my_KMAC_KEY_Init(ICClib *pcb,KMAC_KEY *kk,const EVP_MD *md,const unsigned char *key,size_t keylen,const unsigned char *S,size_t Slen)
+{
+  int rv = 0;
+  int nid = 0;
+  int fips = 0;
+  if(CondKAT(KA_GROUP_MAC)) {
+    rv = KMAC_KEY_Init(kk,md,key,keylen,S,Slen);
+  }
+  if((pcb->callback) && (1 == rv)) {
+    nid = EVP_MD_type(md);
+    fips = FIPS_MDbyNID(nid);
+    /* SP800-131A, MAC keys of at least 112 bits */
+    if(keylen < 14) {
+      fips = 0;
+    }
+    (*pcb->callback)("ICC_KMAC_KEY_Init",nid,fips);
+  }
+  return rv;
+}
+
+int my_TLS_PRF_Init(ICClib *pcb,TLS_PRF_CTX *ctx,const EVP_MD *md,const unsigned char *secret,int seclen)
+{
+  int rv = 0;
+  if(CondKAT(KA_GROUP_KDF)) {
+    rv = TLS_PRF_Init(ctx,md,secret,seclen);
+  }
+  if((pcb->callback) && (1 == rv)) {
+    (*pcb->callback)("ICC_TLS_PRF_Init",EVP_MD_type(md),FIPS_MDbyNID(EVP_MD_type(md)));
+  }
+  return rv;
+}
+
+int my_TLS_PRF_KeyBlock(ICClib *pcb,TLS_PRF_CTX *ctx,const EVP_MD *md,const unsigned char *pms,int pmslen,const unsigned char *crandom,const unsigned char *srandom,const unsigned char *shash,int shashlen,unsigned char *master,unsigned char *keyblock,int kblen)
+{
+  int rv = 0;
+  if(CondKAT(KA_GROUP_KDF)) {
+    rv = TLS_PRF_KeyBlock(ctx,md,pms,pmslen,crandom,srandom,shash,shashlen,master,keyblock,kblen);
+  }
+  if((pcb->callback) && (1 == rv)) {
+    (*pcb->callback)("ICC_TLS_PRF_KeyBlock",EVP_MD_type(md),FIPS_MDbyNID(EVP_MD_type(md)));
+  }
+  return rv;
+}
+
+int my_ECDSA_POOL_Fill(ICClib *pcb,ECDSA_POOL *pool,unsigned int n)
+{
+  int rv = -1;
+  if(!((pcb->flags & ICC_FIPS_FLAG) && getErrorState()) && CondKAT(KA_GROUP_SIG)) {
+    rv = ECDSA_POOL_Fill(pool,n);
+  }
+  return rv;
+}
+
+ECDSA_SIG *my_ECDSA_POOL_Sign(ICClib *pcb,ECDSA_POOL *pool,const unsigned char *dgst,int dlen)
+{
+  ECDSA_SIG *sig = NULL;
+  int nid = 0;
+  if(CondKAT(KA_GROUP_SIG)) {
+    sig = ECDSA_POOL_Sign(pool,dgst,dlen);
+  }
+  if((pcb->callback) && (NULL != sig)) {
+    nid = EC_GROUP_get_curve_name(EC_KEY_get0_group(ECDSA_POOL_get0_key(pool)));
+    (*pcb->callback)("ICC_ECDSA_POOL_Sign",nid,FIPS_ECbyNID(nid));
+  }
+  return sig;
+}
+
+/*! @brief Run a batch of operations, see BATCH_Run()
+  The known answer tests for every group the batch touches run (or have
+  run) before any of it. The FIPS callback sees each successful operation
+  as the single shot API would.
+  @param pcb ICC library context
+  @param ops the operations
+  @param n the number of operations
+  @return 1 if every operation succeeded, 0 otherwise
+*/
+int my_BATCH_Run(ICClib *pcb,BATCH_OP *ops,unsigned int n)
+{
+  int rv = 0;
+  unsigned int i = 0;
+  int groups = 0;
+  int nid = 0;
+  int hnid = 0;
+  int check = 0;
+  int fips = 0;
+  BATCH_OP *op = NULL;
+
+  for(i = 0; (NULL != ops) && (i < n); i++) {
+    switch(ops[i].op) {
+    case ICC_BATCH_DIGEST:
+      groups |= KA_GROUP_CORE;
+      break;
+    case ICC_BATCH_HMAC:
+      groups |= KA_GROUP_MAC;
+      break;
+    case ICC_BATCH_AEAD_SEAL:
+    case ICC_BATCH_AEAD_OPEN:
+      groups |= KA_GROUP_CIPHER;
+      break;
+    case ICC_BATCH_SIGN:
+    case ICC_BATCH_VERIFY:
+    case ICC_BATCH_VERIFY_DIGEST:
+      groups |= KA_GROUP_SIG;
+      break;
+    case ICC_BATCH_DERIVE:
+      groups |= KA_GROUP_PKEY; /* ECDH KAS */
+      break;
+    default:
+      break;
+    }
+  }
+  if((0 == groups) || CondKAT(groups)) {
+    rv = BATCH_Run(ops,n);
+  }
+  if((pcb->callback) && (NULL != ops)) {
+    for(i = 0; i < n; i++) {
+      op = &ops[i];
+      if(1 != op->rv) {
+        continue;
+      }
+      switch(op->op) {
+      case ICC_BATCH_DIGEST:
+        nid = EVP_MD_type(op->md);
+        fips = FIPS_MDbyNID(nid);
+        break;
+      case ICC_BATCH_HMAC:
+        nid = EVP_MD_type(op->md);
+        fips = FIPS_MDbyNID(nid);
+        /* SP800-131A, HMAC keys of at least 112 bits */
+        if(op->keylen < 14) {
+          fips = 0;
+        }
+        break;
+      case ICC_BATCH_AEAD_SEAL:
+      case ICC_BATCH_AEAD_OPEN:
+        nid = EVP_CIPHER_nid(op->cipher);
+        fips = FIPS_CipherbyNID(nid);
+        break;
+      default: /* Sign, verify, derive */
+        fips = PKEY_FIPS_id(op->pkey,&check,&nid);
+        if((ICC_BATCH_SIGN == op->op) && (2 == check)) {
+          fips = 0;
+        }
+        if(NULL != op->md) {
+          hnid = EVP_MD_type(op->md);
+          if(fips && !FIPS_MDbyNID(hnid)) {
+            nid = hnid;
+            fips = 0;
+          }
+        }
+        break;
+      }
+      (*pcb->callback)("ICC_BATCH_Run",nid,fips);
+    }
+  }
+  return rv;
+}
+
+/* Asynchronous private key operations, ICC_PKEY_JOB_THREADS */
+#define PKEY_JOB_MAX_THREADS 16 /*!< Largest worker pool */
+
+/*! @brief One queued RSA/EC private key operation */
+struct PKEY_JOB_t {
+  struct PKEY_JOB_t *next;   /*!< Queue link */
+  int state;                 /*!< PKEY_JOB_IDLE ... PKEY_JOB_FAILED, under pkey_job_mtx */
+  int busy;                  /*!< Owner only, submitted and not yet collected */
+  int op;                    /*!< ICC_PKEY_JOB_SIGN or ICC_PKEY_JOB_DECRYPT */
+  EVP_PKEY *pkey;            /*!< Reference held while the job is queued */
+  const EVP_MD *md;          /*!< Signature digest, may be NULL */
+  int padding;               /*!< RSA padding mode, 0 for the default */
+  unsigned char *in;         /*!< Private copy of the input */
+  size_t inlen;              /*!< Length of in */
+  unsigned char *out;        /*!< Result buffer, kept for reuse */
+  size_t outcap;             /*!< Size of out */
+  size_t outlen;             /*!< Bytes of result */
+  void (*cb)(void *arg);     /*!< Completion callback, may be NULL */
+  void *arg;                 /*!< Callback argument */
+  ICC_Sem done;              /*!< Posted once per completion */
+};
+
+#define PKEY_JOB_IDLE    0 /*!< New, or the last result has been collected */
+#define PKEY_JOB_QUEUED  1 /*!< Waiting for, or running on, a worker */
+#define PKEY_JOB_DONE    2 /*!< Completed O.K., result not yet collected */
+#define PKEY_JOB_FAILED  3 /*!< Completed with an error, not yet collected */
+
+static PKEY_JOB *pkey_job_head = NULL; /*!< Oldest queued job */
+static PKEY_JOB *pkey_job_tail = NULL; /*!< Newest queued job */
+static ICC_Thread pkey_job_thr[PKEY_JOB_MAX_THREADS];
+static int pkey_job_nthr = 0;          /*!< Workers actually started */
+static int pkey_job_state = 0; /*!< 0 not started, 1 running, 2 stopping, -1 no threads, run in line */
+static DWORD pkey_job_pid = 0; /*!< The process the workers were started in */
+
+/*! @brief Set the number of worker threads used for PKEY_JOB_Submit()
+  @param n 1-PKEY_JOB_MAX_THREADS
+  @note Only effective before the first submission
+*/
+static void SetPKEYJobThreads(int n)
+{
+  if((n >= 1) && (n <= PKEY_JOB_MAX_THREADS)) {
+    pkey_job_threads = n;
+  }
+}
+
+/*! @brief Do the private key operation for a job
+  @param job the job
+  @return 1 if O.K., 0 otherwise
+*/
+static int PKEYJobRun(PKEY_JOB *job)
+{
+  int rv = 0;
+  EVP_PKEY_CTX *pctx = NULL;
+
+  pctx = EVP_PKEY_CTX_new(job->pkey,NULL);
+  if(NULL != pctx) {
+    if(ICC_PKEY_JOB_SIGN == job->op) {
+      rv = EVP_PKEY_sign_init(pctx);
+      if((1 == rv) && (NULL != job->md)) {
+        rv = EVP_PKEY_CTX_set_signature_md(pctx,job->md);
+      }
+    } else {
+      rv = EVP_PKEY_decrypt_init(pctx);
+    }
+    if((1 == rv) && (0 != job->padding)) {
+      rv = EVP_PKEY_CTX_set_rsa_padding(pctx,job->padding);
+    }
+    if(1 == rv) {
+      if(ICC_PKEY_JOB_SIGN == job->op) {
+        rv = EVP_PKEY_sign(pctx,job->out,&job->outlen,job->in,job->inlen);
+      } else {
+        rv = EVP_PKEY_decrypt(pctx,job->out,&job->outlen,job->in,job->inlen);
+      }
+    }
+    EVP_PKEY_CTX_free(pctx);
+  }
+  return (1 == rv) ? 1 : 0;
+}
+
+/*! @brief Mark a job complete, wake anyone waiting and call the callback
+  @param job the job, the caller may free it as soon as done is posted
+  @param ok 1 if the operation succeeded
+  @note Called without the queue mutex held
+*/
+static void PKEYJobComplete(PKEY_JOB *job,int ok)
+{
+  void (*cb)(void *arg) = job->cb;
+  void *arg = job->arg;
+
+  EVP_PKEY_free(job->pkey);
+  job->pkey = NULL;
+  OPENSSL_cleanse(job->in,job->inlen);
+  ICC_Free(job->in);
+  job->in = NULL;
+  ICC_LockMutex(&pkey_job_mtx);
+  job->state = ok ? PKEY_JOB_DONE : PKEY_JOB_FAILED;
+  ICC_UnlockMutex(&pkey_job_mtx);
+  ICC_PostSem(&job->done);
+  if(NULL != cb) {
+    (*cb)(arg);
+  }
+}
+
+/*! @brief Take jobs off the queue until told to stop
+  Workers are long lived, so OpenSSL's per thread state (the DRBG
+  instances, the error queue) is set up once rather than per operation
+*/
+static ICC_THREAD_RET ICC_THREAD_CALL pkey_job_worker(void *arg)
+{
+  PKEY_JOB *job = NULL;
+
+  (void)arg;
+  while(1) {
+    if(0 != ICC_WaitSem(&pkey_job_sem,ICC_SEM_FOREVER)) {
+      ICC_Sleep(1);
+      continue;
+    }
+    ICC_LockMutex(&pkey_job_mtx);
+    if(1 != pkey_job_state) {
+      ICC_UnlockMutex(&pkey_job_mtx);
+      break;
+    }
+    job = pkey_job_head;
+    if(NULL != job) {
+      pkey_job_head = job->next;
+      if(NULL == pkey_job_head) {
+        pkey_job_tail = NULL;
+      }
+      job->next = NULL;
+    }
+    ICC_UnlockMutex(&pkey_job_mtx);
+    if(NULL != job) {
+      PKEYJobComplete(job,PKEYJobRun(job));
+      job = NULL;
+    }
+  }
+  return 0;
+}
+
+/*! @brief Reset the queue in a forked child
+  The workers didn't come with us and may have held the locks. Jobs
+  still queued fail, a job a worker had already taken never completes
+  in the child, so don't wait on jobs submitted before a fork()
+*/
+static void PKEYJobForkCheck(void)
+{
+  PKEY_JOB *j = NULL;
+  PKEY_JOB *nx = NULL;
+
+  if((1 == pkey_job_state) && (pkey_job_pid != ICC_GetProcessId())) {
+    ICC_CreateMutex(&pkey_job_mtx);
+    ICC_CreateSem(&pkey_job_sem);
+    j = pkey_job_head;
+    pkey_job_head = pkey_job_tail = NULL;
+    pkey_job_nthr = 0;
+    pkey_job_state = 0;
+    for( ; NULL != j; j = nx) {
+      nx = j->next;
+      j->next = NULL;
+      PKEYJobComplete(j,0);
+    }
+  }
+}
+
+/*! @brief Queue a job, starting the workers on first use
+  @param job the job, fully set up
+  @note If no worker could be started the job runs in line
+*/
+static void PKEYJobQueue(PKEY_JOB *job)
+{
+  int i = 0;
+  int inl = 0;
+
+  PKEYJobForkCheck();
+  ICC_LockMutex(&pkey_job_mtx);
+  if(0 == pkey_job_state) {
+    pkey_job_pid = ICC_GetProcessId();
+    pkey_job_state = 1;
+    for(i = 0; i < pkey_job_threads; i++) {
+      if(0 != ICC_CreateThread(&pkey_job_thr[i],pkey_job_worker,NULL)) {
+        break;
+      }
+    }
+    pkey_job_nthr = i;
+    if(0 == pkey_job_nthr) {
+      pkey_job_state = -1;
+    }
+  }
+  if(1 == pkey_job_state) {
+    if(NULL == pkey_job_tail) {
+      pkey_job_head = job;
+    } else {
+      pkey_job_tail->next = job;
+    }
+    pkey_job_tail = job;
+  } else {
+    inl = 1;
+  }
+  ICC_UnlockMutex(&pkey_job_mtx);
+  if(inl) {
+    PKEYJobComplete(job,PKEYJobRun(job));
+  } else {
+    ICC_PostSem(&pkey_job_sem);
+  }
+}
+
+/*! @brief Stop the workers and fail anything still queued
+  Only called in the library unload path
+*/
+static void PKEYJobStop(void)
+{
+  int i = 0;
+  PKEY_JOB *j = NULL;
+
+  if(0 == pkey_job_threads) {
+    return; /* Never set up */
+  }
+  if((1 == pkey_job_state) && (pkey_job_pid == ICC_GetProcessId())) {
+    ICC_LockMutex(&pkey_job_mtx);
+    pkey_job_state = 2;
+    ICC_UnlockMutex(&pkey_job_mtx);
+    for(i = 0; i < pkey_job_nthr; i++) {
+      ICC_PostSem(&pkey_job_sem);
+    }
+    for(i = 0; i < pkey_job_nthr; i++) {
+      ICC_JoinThread(&pkey_job_thr[i]);
+    }
+    while(NULL != (j = pkey_job_head)) {
+      pkey_job_head = j->next;
+      j->next = NULL;
+      PKEYJobComplete(j,0);
+    }
+    pkey_job_tail = NULL;
+  }
+  ICC_DestroySem(&pkey_job_sem);
+  ICC_DestroyMutex(&pkey_job_mtx);
+  pkey_job_threads = 0;
+  pkey_job_nthr = 0;
+  pkey_job_state = 0;
+}
+
+/*! @brief Allocate an asynchronous private key job
+  @return the job, or NULL
+  @note A job can be reused once its result has been collected
+*/
+PKEY_JOB *PKEY_JOB_new(void)
+{
+  PKEY_JOB *job = NULL;
+
+  job = (PKEY_JOB *)ICC_Calloc(1,sizeof(PKEY_JOB),__FILE__,__LINE__);
+  if((NULL != job) && (0 != ICC_CreateSem(&job->done))) {
+    ICC_Free(job);
+    job = NULL;
+  }
+  return job;
+}
+
+/*! @brief Free a job, waits for it to complete if it's queued
+  @param job the job
+*/
+void PKEY_JOB_free(PKEY_JOB *job)
+{
+  if(NULL != job) {
+    if(job->busy) {
+      PKEYJobForkCheck();
+      ICC_WaitSem(&job->done,ICC_SEM_FOREVER);
+    }
+    if(NULL != job->out) {
+      OPENSSL_cleanse(job->out,job->outcap);
+      ICC_Free(job->out);
+    }
+    ICC_DestroySem(&job->done);
+    ICC_Free(job);
+  }
+}
+
+/*! @brief Collect the result of a job
+  @param job the job
+  @param wait non-zero to block until the job completes
+  @param out the signature or plaintext, may be NULL to just get the status
+  @param outlen In, the size of out, returned, the bytes written
+  @return 1 O.K., 0 failed or nothing submitted, -1 still pending
+  @note A call with out set that doesn't return -1 collects the result,
+  after that the job can be submitted again
+*/
+int PKEY_JOB_Result(PKEY_JOB *job,int wait,unsigned char *out,size_t *outlen)
+{
+  int rv = 0;
+  int state = PKEY_JOB_IDLE;
+
+  if((NULL == job) || !job->busy) {
+    return 0;
+  }
+  PKEYJobForkCheck();
+  ICC_LockMutex(&pkey_job_mtx);
+  state = job->state;
+  ICC_UnlockMutex(&pkey_job_mtx);
+  if((PKEY_JOB_QUEUED == state) && !wait) {
+    return -1;
+  }
+  /* Each completion posts done once, take it if we can collect, 
+     otherwise put it back 
+  */
+  ICC_WaitSem(&job->done,ICC_SEM_FOREVER);
+  ICC_LockMutex(&pkey_job_mtx);
+  state = job->state;
+  if((NULL != out) && (NULL != outlen)) {
+    job->state = PKEY_JOB_IDLE;
+    job->busy = 0;
+  }
+  ICC_UnlockMutex(&pkey_job_mtx);
+  rv = (PKEY_JOB_DONE == state) ? 1 : 0;
+  if((NULL == out) || (NULL == outlen)) {
+    ICC_PostSem(&job->done);
+  } else {
+    if((1 == rv) && (*outlen >= job->outlen)) {
+      memcpy(out,job->out,job->outlen);
+      *outlen = job->outlen;
+    } else {
+      rv = 0;
+    }
+    OPENSSL_cleanse(job->out,job->outcap);
+  }
+  return rv;
+}
+
+/*! @brief Queue an RSA/EC private key operation
+  @param pcb ICC library context
+  @param job the job, idle
+  @param pkey the private key, a reference is held until the job completes
+  @param op ICC_PKEY_JOB_SIGN (in is a digest) or ICC_PKEY_JOB_DECRYPT
+  @param md the signature digest, may be NULL
+  @param padding RSA padding mode, 0 for the default
+  @param in the input, copied
+  @param inlen the length of in
+  @param cb called from the worker thread once the result is available, may be NULL
+  @param arg passed to cb
+  @return 1 if the job was queued, 0 otherwise
+*/
+int my_PKEY_JOB_Submit(ICClib *pcb,PKEY_JOB *job,EVP_PKEY *pkey,int op,const EVP_MD *md,int padding,const unsigned char *in,size_t inlen,void (*cb)(void *arg),void *arg)
+{
+  int rv = 0;
+  int size = 0;
+  int fips = 0;
+  int check = 0;
+  int nid = 0;
+  int hnid = 0;
+
+  if((NULL == job) || job->busy || (NULL == pkey) || 
+     (NULL == in) || (0 == inlen) || (0 == pkey_job_threads) ||
+     ((ICC_PKEY_JOB_SIGN != op) && (ICC_PKEY_JOB_DECRYPT != op))) {
+    return 0;
+  }
+  if(!((pcb->flags & ICC_FIPS_FLAG) && getErrorState()) && 
+     CondKAT((ICC_PKEY_JOB_SIGN == op) ? KA_GROUP_SIG : KA_GROUP_PKEY)) {
+    size = EVP_PKEY_size(pkey);
+    if((size > 0) && (job->outcap < (size_t)size)) {
+      if(NULL != job->out) {
+        ICC_Free(job->out);
+      }
+      job->out = (unsigned char *)ICC_Malloc(size,__FILE__,__LINE__);
+      job->outcap = (NULL == job->out) ? 0 : size;
+    }
+    if((size > 0) && (job->outcap >= (size_t)size)) {
+      job->in = (unsigned char *)ICC_Malloc(inlen,__FILE__,__LINE__);
+    }
+    if((NULL != job->in) && EVP_PKEY_up_ref(pkey)) {
+      memcpy(job->in,in,inlen);
+      job->inlen = inlen;
+      job->outlen = size;
+      job->pkey = pkey;
+      job->op = op;
+      job->md = md;
+      job->padding = padding;
+      job->cb = cb;
+      job->arg = arg;
+      job->next = NULL;
+      job->state = PKEY_JOB_QUEUED;
+      job->busy = 1;
+      rv = 1;
+    } else if(NULL != job->in) {
+      ICC_Free(job->in);
+      job->in = NULL;
+    }
+  }
+  /* Report before queueing, the job may be complete and freed after */
+  if((NULL != pcb->callback) && (1 == rv)) {
+    fips = PKEY_FIPS_id(pkey,&check,&nid);
+    if((ICC_PKEY_JOB_SIGN == op) && (2 == check)) {
+      fips = 0;
+    }
+    if(NULL != md) {
+      hnid = EVP_MD_type(md);
+      if(fips && !FIPS_MDbyNID(hnid)) {
+        nid = hnid;
         fips = 0;
-      }      
+      }
     }
-    (*pcb->callback)("ICC_PKCS5_PBKDF2_HMAC",nid,fips);
+    (*pcb->callback)("ICC_PKEY_JOB_Submit",nid,fips);
+  }
+  if(1 == rv) {
+    PKEYJobQueue(job);
   }
   return rv;
 }
 
+/*! @brief DH key generation for the RFC 7919 groups using the shared
+    fixed base table for g
+    @param dh the DH key
+    @return 1 on success, 0 on error, -1 if this key isn't handled here, 
+    use DH_generate_key()
+    @note Matches OpenSSL's generate_key(): same private key length and
+    distribution, and the public key check in FIPS mode. DH_check_ex() isn't
+    repeated, DH_get_nid() has already matched p and g to the named group
+*/
+static int DHFixedGenerate(DH *dh)
+{
+  int rv = -1;
+  int l = 0;
+  const BIGNUM *p = NULL;
+  const BIGNUM *q = NULL;
+  const BIGNUM *g = NULL;
+  const BIGNUM *priv = NULL;
+  const DH_COMB *comb = NULL;
+  BIGNUM *priv_key = NULL;
+  BIGNUM *pub_key = NULL;
+  BN_CTX *ctx = NULL;
+
+  DH_get0_pqg(dh, &p, &q, &g);
+  DH_get0_key(dh, NULL, &priv);
+  /* DH_set_method() isn't in the ICC API, an engine is the only way to
+     replace the default method */
+  if((DH_OpenSSL() != DH_get_default_method()) || (NULL != DH_get0_engine(dh)) ||
+     (NULL != q) || (NULL != priv)) {
+    return -1;
+  }
+  comb = dh_comb_lookup(dh);
+  if(NULL == comb) {
+    return -1;
+  }
+  l = DH_get_length(dh) ? (int)DH_get_length(dh) : BN_num_bits(p) - 1;
+  if(l > DH_COMB_bits(comb)) {
+    return -1;
+  }
+  rv = 0;
+  ctx = BN_CTX_secure_new();
+  priv_key = BN_secure_new();
+  pub_key = BN_new();
+  if((NULL != ctx) && (NULL != priv_key) && (NULL != pub_key) &&
+     (1 == BN_priv_rand(priv_key, l, BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ANY))) {
+    /* As OpenSSL, for g = 2 and p % 8 == 3 bit 0 isn't secret anyway */
+    if(BN_is_word(g, DH_GENERATOR_2) && !BN_is_bit_set(p, 2)) {
+      BN_clear_bit(priv_key, 0);
+    }
+    if((1 == DH_COMB_exp(comb, pub_key, priv_key, ctx)) &&
+       (!FIPS_mode() || (1 == DH_check_pub_key_ex(dh, pub_key))) &&
+       (1 == DH_set0_key(dh, pub_key, priv_key))) {
+      pub_key = NULL;
+      priv_key = NULL;
+      rv = 1;
+    }
+  }
+  BN_free(pub_key);
+  BN_clear_free(priv_key);
+  BN_CTX_free(ctx);
+  return rv;
+}
+
 int my_DH_generate_key(ICClib *pcb,DH *dh)
 {
   int rv = 0;
   int len = 0;
   int fips = 0;
   RAND_seed(NULL,0); /* Reseed before keygen */
-  rv = DH_generate_key(dh);
+  if(CondKAT(KA_GROUP_PKEY)) {
+    rv = DHFixedGenerate(dh);
+    if(rv < 0) {
+      rv = DH_generate_key(dh);
+    }
+  }
   if((pcb->callback) && (1 == rv) ) {
     len = DH_size(dh);
     if (len >= 256 && len <= 1024)
@@ -3058,7 +6125,9 @@ int my_DH_compute_key(ICClib *pcb,unsigned char *key,BIGNUM *pub_key,DH *dh)
   int rv = 0; 
   int len = 0;   
   int fips = 0;
-  rv = DH_compute_key(key,pub_key,dh);
+  if(CondKAT(KA_GROUP_PKEY)) {
+    rv = DH_compute_key(key,pub_key,dh);
+  }
   if((pcb->callback) && (1 == rv) ) { 
     len = DH_size(dh);
     if (len >= 256 && len <= 1024)
@@ -3078,7 +6147,9 @@ int my_DH_compute_key_padded(ICClib *pcb,unsigned char *key,BIGNUM *pub_key,DH *
   int rv = 0; 
   int len = 0;   
   int fips = 0;
-  rv = DH_compute_key_padded(key,pub_key,dh);
+  if(CondKAT(KA_GROUP_PKEY)) {
+    rv = DH_compute_key_padded(key,pub_key,dh);
+  }
   if((pcb->callback) && (1 == rv) ) { 
     len = DH_size(dh);
     if (len >= 256 && len <= 1024)
@@ -3101,15 +6172,29 @@ unsigned char *HKDF_Extract(ICClib *pcb,const EVP_MD *evp_md,
 			    const unsigned char *key, size_t key_len,
 			    unsigned char *prk, size_t *prk_len)
 {
+    static const unsigned char nosalt[1] = {0};
     unsigned int tmp_len = 0;
+    unsigned char *ret = NULL;
     HMAC_CTX *hmac = NULL;
+
+    *prk_len = 0;
+    /* RFC 5869 2.2, no salt is HashLen zeros, which HMAC pads an empty 
+       key out to anyway. OpenSSL refuses a NULL key on a new digest. 
+    */
+    if (NULL == salt) {
+      salt = nosalt;
+      salt_len = 0;
+    }
     hmac = HMAC_CTX_new();
-    HMAC_Init(hmac,salt, (int)salt_len, evp_md);
-    HMAC_Update(hmac,key,key_len);
-    HMAC_Final(hmac,prk,&tmp_len);
+    if ((NULL != hmac) && (salt_len <= INT_MAX) &&
+        (1 == HMAC_Init_ex(hmac, salt, (int)salt_len, evp_md, NULL)) &&
+        (1 == HMAC_Update(hmac, key, key_len)) &&
+        (1 == HMAC_Final(hmac, prk, &tmp_len))) {
+      *prk_len = tmp_len;
+      ret = prk;
+    }
     HMAC_CTX_free(hmac);
-    *prk_len = tmp_len; 
-    return prk;
+    return ret;
 }
 
 unsigned char *HKDF_Expand(ICClib *pcb,const EVP_MD *evp_md,
@@ -3206,6 +6291,164 @@ unsigned char *HKDF(ICClib *pcb,const EVP_MD *evp_md,
 	 
   return ret;
 }
+
+/*! @brief An HKDF PRK with the HMAC keyed once
+  Each HKDF-Expand block restarts from the keyed inner/outer pad states
+  rather than rekeying HMAC from the PRK. 
+*/
+struct HKDF_CTX_t {
+  const EVP_MD *md;   /*!< The HMAC digest */
+  HMAC_CTX *hmac;     /*!< Keyed with the PRK */
+  int keyed;          /*!< 1 once a PRK has been set */
+};
+
+/*! @brief Allocate an HKDF context
+  @return the context or NULL
+*/
+HKDF_CTX *HKDF_CTX_new(void)
+{
+  struct HKDF_CTX_t *c = NULL;
+
+  c = (struct HKDF_CTX_t *)OPENSSL_zalloc(sizeof(struct HKDF_CTX_t));
+  if(NULL != c) {
+    c->hmac = HMAC_CTX_new();
+    if(NULL == c->hmac) {
+      OPENSSL_free(c);
+      c = NULL;
+    }
+  }
+  return (HKDF_CTX *)c;
+}
+
+/*! @brief Free an HKDF context, the keyed state is cleared
+  @param ctx the context, may be NULL
+*/
+void HKDF_CTX_free(HKDF_CTX *ctx)
+{
+  struct HKDF_CTX_t *c = (struct HKDF_CTX_t *)ctx;
+
+  if(NULL != c) {
+    if(NULL != c->hmac) {
+      HMAC_CTX_free(c->hmac);
+    }
+    OPENSSL_cleanse(c,sizeof(struct HKDF_CTX_t));
+    OPENSSL_free(c);
+  }
+}
+
+/*! @brief Key an HKDF context with a PRK
+  @param pcb ICC library context, may be NULL
+  @param ctx the context
+  @param evp_md the HMAC digest
+  @param prk the pseudo random key, i.e. from HKDF_Extract()
+  @param prk_len the length of the prk
+  @return 1 O.K., 0 on error
+*/
+int HKDF_CTX_Init(ICClib *pcb,HKDF_CTX *ctx,const EVP_MD *evp_md,
+                  const unsigned char *prk, size_t prk_len)
+{
+  struct HKDF_CTX_t *c = (struct HKDF_CTX_t *)ctx;
+  int rv = 0;
+  int nid = 0;
+
+  if((NULL != c) && (NULL != evp_md) && (NULL != prk) && (prk_len <= INT_MAX)) {
+    c->keyed = 0;
+    c->md = evp_md;
+    rv = HMAC_Init_ex(c->hmac, prk, (int)prk_len, evp_md, NULL);
+    if(1 == rv) {
+      c->keyed = 1;
+    }
+  }
+  if((1 == rv) && (NULL != pcb) && (NULL != pcb->callback)) {
+    nid = EVP_MD_type(evp_md);
+    (*pcb->callback)("ICC_HKDF_CTX_Init",nid,FIPS_MDbyNID(nid));
+  }
+  return rv;
+}
+
+/*! @brief HKDF-Extract straight into an HKDF context,
+  the PRK never leaves the context
+  @param pcb ICC library context, may be NULL
+  @param ctx the context
+  @param evp_md the HMAC digest
+  @param salt the salt
+  @param salt_len the length of the salt
+  @param key the input keying material
+  @param key_len the length of the key
+  @return 1 O.K., 0 on error
+*/
+int HKDF_CTX_Extract(ICClib *pcb,HKDF_CTX *ctx,const EVP_MD *evp_md,
+                     const unsigned char *salt, size_t salt_len,
+                     const unsigned char *key, size_t key_len)
+{
+  unsigned char prk[ICC_EVP_MAX_MD_SIZE];
+  size_t prk_len = 0;
+  int rv = 0;
+
+  if((NULL != ctx) && (NULL != evp_md) &&
+     (NULL != HKDF_Extract(pcb,evp_md,salt,salt_len,key,key_len,prk,&prk_len))) {
+    rv = HKDF_CTX_Init(pcb,ctx,evp_md,prk,prk_len);
+  }
+  OPENSSL_cleanse(prk,sizeof(prk));
+  return rv;
+}
+
+/*! @brief HKDF-Expand from a keyed HKDF context, 
+  may be called any number of times with different info
+  @param pcb ICC library context, may be NULL
+  @param ctx a context keyed by HKDF_CTX_Init() or HKDF_CTX_Extract()
+  @param info additional data
+  @param info_len the length of info
+  @param okm the output keying material
+  @param okm_len the length of okm, at most 255 digest lengths
+  @return okm or NULL on error
+  @note The context holds working state, don't share one between threads
+*/
+unsigned char *HKDF_CTX_Expand(ICClib *pcb,HKDF_CTX *ctx,
+                               const unsigned char *info, size_t info_len,
+                               unsigned char *okm, size_t okm_len)
+{
+  struct HKDF_CTX_t *c = (struct HKDF_CTX_t *)ctx;
+  unsigned char *ret = NULL;
+  unsigned char prev[ICC_EVP_MAX_MD_SIZE];
+  size_t dig_len = 0;
+  size_t done_len = 0;
+  size_t copy_len = 0;
+  size_t n = 0;
+  unsigned int i = 0;
+  unsigned char ctr = 0;
+  int nid = 0;
+
+  if((NULL != c) && c->keyed && (NULL != okm) &&
+     ((NULL != info) || (0 == info_len))) {
+    dig_len = EVP_MD_size(c->md);
+    n = (okm_len + dig_len - 1) / dig_len;
+    if(n <= 255) {
+      ret = okm;
+    }
+  }
+  for(i = 1; (NULL != ret) && (i <= n); i++) {
+    ctr = (unsigned char)i;
+    /* NULL key, restart from the keyed pad states */
+    if((1 != HMAC_Init_ex(c->hmac, NULL, 0, NULL, NULL)) ||
+       ((i > 1) && (1 != HMAC_Update(c->hmac, prev, dig_len))) ||
+       ((info_len > 0) && (1 != HMAC_Update(c->hmac, info, info_len))) ||
+       (1 != HMAC_Update(c->hmac, &ctr, 1)) ||
+       (1 != HMAC_Final(c->hmac, prev, NULL))) {
+      ret = NULL;
+      break;
+    }
+    copy_len = (done_len + dig_len > okm_len) ? okm_len - done_len : dig_len;
+    memcpy(okm + done_len, prev, copy_len);
+    done_len += copy_len;
+  }
+  OPENSSL_cleanse(prev,sizeof(prev));
+  if((NULL != ret) && (NULL != pcb) && (NULL != pcb->callback)) {
+    nid = EVP_MD_type(c->md);
+    (*pcb->callback)("ICC_HKDF_CTX_Expand",nid,FIPS_MDbyNID(nid));
+  }
+  return ret;
+}
 /* Copied from OpenSSL-FIPS */
 int dsa_paramgen_check_g(DSA *dsa)
 {
@@ -3432,10 +6675,9 @@ int RSA_FixEncodingZeros(RSA* rsa, const RSA* pub, int allowDisableBlinding)
    return ICC_OSSL_SUCCESS;
 }
 
-/* A noop these days */
 void my_GHASH(AES_GCM_CTX *gcm_ctx,unsigned char *H,unsigned char *Hash,unsigned char *data,unsigned long datalen)
 {
-
+  GHASH(gcm_ctx,H,Hash,data,datalen);
 }
 #define MyCalloc(x,y) ICC_Calloc(x,y,__FILE__,__LINE__)
 #define MyFree(x) ICC_Free(x)
@@ -28,6 +28,7 @@ typedef pthread_mutex_t ICC_Mutex;
 
 #include "iccversion.h"
 #include "iccglobals.h"   /* global definitions */
+#include "cpufeat.h"
 
 
 #include "openssl/rand.h" /* Wrong order for Windows */
@@ -83,7 +84,11 @@ int my_CMAC_Init(CMAC_CTX *cmac_ctx,const EVP_CIPHER *cipher,unsigned char *key,
 int my_CMAC_Final(CMAC_CTX *cmac_ctx,unsigned char *md,unsigned int maclen);
 
 void GenerateRandomSeed (ICClib *pcb,ICC_STATUS *status,int num,unsigned char * buf);
+int TryGenerateRandomSeed (ICClib *pcb,ICC_STATUS *status,int num,unsigned char * buf,void (*cb)(void *arg),void *arg);
 int SetRNGInstances(int i);
+int SetRNGPerThread(int on);
+int SetRNGCache(int bytes);
+int SetRNGReseedThread(int on);
 int GenRNGInstances(void);
 int Set_default_tuner(int alg);
 int Get_default_tuner(void);
@@ -110,9 +115,26 @@ int lib_attach (ICClib * pcb, ICC_STATUS * status);
 int lib_cleanup (ICClib *pcb,ICC_STATUS * status);
 void *lib_init (ICClib * pcb, ICC_STATUS * status, const char *iccpath,const char *a, const char *b);
 int SelfTest (ICClib *pcb,ICC_STATUS * status);
+int SelfTestGroup (ICClib *pcb,ICC_STATUS * status,int groups);
 
 
 const BIGNUM *DH_get_PublicKey (const DH * dh);
+int EVP_CipherUpdate_off(EVP_CIPHER_CTX *ctx,unsigned char *out,int outoff,int outcap,unsigned char *in,int inoff,int inl);
+int EVP_CipherFinal_off(EVP_CIPHER_CTX *ctx,unsigned char *out,int outoff,int outcap);
+int EVP_DigestUpdate_off(EVP_MD_CTX *ctx,unsigned char *in,int inoff,int inl);
+int EVP_DigestFinal_off(EVP_MD_CTX *ctx,unsigned char *out,int outoff,int outcap);
+int EVP_DigestFinal_reset(EVP_MD_CTX *ctx,unsigned char *md,unsigned int *s,const EVP_MD_CTX *prefix);
+int RSA_ThreadCache(RSA *rsa, int n);
+typedef struct PKEY_JOB_t PKEY_JOB;
+PKEY_JOB *PKEY_JOB_new(void);
+void PKEY_JOB_free(PKEY_JOB *job);
+int PKEY_JOB_Result(PKEY_JOB *job,int wait,unsigned char *out,size_t *outlen);
+typedef struct PHASH_CTX_t PHASH_CTX;
+PHASH_CTX *PHASH_CTX_new(void);
+void PHASH_CTX_free(PHASH_CTX *ctx);
+int PHASH_CTX_Init(PHASH_CTX *ctx,const EVP_MD *md,size_t B,const unsigned char *S,size_t Slen);
+int PHASH_CTX_Update(PHASH_CTX *ctx,const unsigned char *in,size_t inlen);
+int PHASH_CTX_Final(PHASH_CTX *ctx,unsigned char *out,size_t outlen);
 RSA * my_RSA_new();
 
 int my_HMAC_Init(HMAC_CTX *ctx, const void *key, int key_len,const EVP_MD *md);
@@ -127,6 +149,19 @@ const FUNC *OS_helpers();
 
 #include "aes_gcm.h"
 #include "aes_ccm.h"
+#include "aes_xts.h"
+#include "chacha_poly.h"
+#include "pbkdf2.h"
+#include "tls_prf.h"
+#include "ecdsa_pool.h"
+#include "batch.h"
+#include "dh_comb.h"
+#include "digest_mb.h"
+#include "xof.h"
+#include "pkey_gen.h"
+
+/*! @brief HKDF PRK context, holds the keyed HMAC state, see HKDF_CTX_Init() */
+typedef struct HKDF_CTX_t HKDF_CTX;
 
 #ifdef  __cplusplus
 }
@@ -14,6 +14,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/wait.h>
+#else
+#include <windows.h>
+#endif
 #if defined(JGSK_WRAP)
 #  include "jcc_a.h"
 #endif
@@ -329,6 +335,7 @@ static  unsigned char buf1[4096];
 static  unsigned char buf2[4096];
 
 static  int tuner = 0; /*! RNG tuning algorithm, 0 = unset, 1 = heuristic, 2 = estimate */
+static  int long_tests = 0; /*! 1 to also run the tests that take minutes, -l */
 
 /*
   uncomment to turn on fine grained stack checks so that you can 
@@ -489,6 +496,20 @@ int doEVPDigestUnitTest(ICC_CTX *ICC_ctx)
   ICC_EVP_MD_CTX *md_ctx = NULL;
   ICC_EVP_MD_CTX *md_ctx2 = NULL;
   const ICC_EVP_MD *md = NULL;
+  ICC_EVP_DigestUpdate_fn dupdate = NULL;
+  unsigned char dgst[2][20];
+  unsigned char mdgst[9][32];
+  ICC_DIGEST_REC drecs[9];
+  ICC_XOF_CTX *xctx = NULL;
+  ICC_PHASH_CTX *pctx = NULL;
+  unsigned char *pbig = NULL;
+  unsigned char xout[2][400];
+  size_t xoff = 0;
+  ICC_CTX_CACHE_COUNTS counts[2];
+  ICC_API_STAT *apis = NULL;
+  ICC_STATUS sts,*status = &sts;
+  int depth = 0;
+  int i = 0;
 
   printf("Starting EVP Digest unit test...\n");
 	
@@ -520,6 +541,131 @@ int doEVPDigestUnitTest(ICC_CTX *ICC_ctx)
     retcode = ICC_EVP_MD_size(ICC_ctx,md);
     retcode = ICC_EVP_MD_block_size(ICC_ctx,md);
     
+    /* The direct bound entry point must give the same result */
+    dupdate = ICC_EVP_DigestUpdate_direct(ICC_ctx);
+    if (NULL == dupdate) {
+      printf("EVP Digest test, ICC_EVP_DigestUpdate_direct() returned NULL\n");
+      rv = ICC_ERROR;
+    } else {
+      md = ICC_EVP_get_digestbyname(ICC_ctx,"SHA1");
+      ICC_EVP_DigestInit(ICC_ctx,md_ctx2,md);
+      ICC_EVP_DigestUpdate(ICC_ctx,md_ctx2,buf1,20);
+      ICC_EVP_DigestFinal(ICC_ctx,md_ctx2,dgst[0],NULL);
+      ICC_EVP_DigestInit(ICC_ctx,md_ctx2,md);
+      (dupdate)(md_ctx2,buf1,20);
+      ICC_EVP_DigestFinal(ICC_ctx,md_ctx2,dgst[1],NULL);
+      if (0 != memcmp(dgst[0],dgst[1],sizeof(dgst[0]))) {
+        printf("EVP Digest test, direct bound update gave a different digest\n");
+        rv = ICC_ERROR;
+      }
+    }
+    /* And the (base, offset, length) variants */
+    md = ICC_EVP_get_digestbyname(ICC_ctx,"SHA1");
+    ICC_EVP_DigestInit(ICC_ctx,md_ctx2,md);
+    ICC_EVP_DigestUpdate(ICC_ctx,md_ctx2,buf1 + 8,20);
+    ICC_EVP_DigestFinal(ICC_ctx,md_ctx2,dgst[0],NULL);
+    ICC_EVP_DigestInit(ICC_ctx,md_ctx2,md);
+    ICC_EVP_DigestUpdate_off(ICC_ctx,md_ctx2,buf1,8,20);
+    if ((20 != ICC_EVP_DigestFinal_off(ICC_ctx,md_ctx2,dgst[1],0,sizeof(dgst[1]))) ||
+        (0 != memcmp(dgst[0],dgst[1],sizeof(dgst[0])))) {
+      printf("EVP Digest test, EVP_DigestUpdate_off gave a different digest\n");
+      rv = ICC_ERROR;
+    }
+    /* Multi-buffer, more messages than lanes and all different lengths */
+    md = ICC_EVP_get_digestbyname(ICC_ctx,"SHA256");
+    for (i = 0; i < 9; i++) {
+      drecs[i].in = buf1;
+      drecs[i].inlen = i * 13;
+      drecs[i].out = mdgst[i];
+      drecs[i].rv = 0;
+    }
+    if (1 != ICC_DIGEST_Multi(ICC_ctx,md,drecs,9)) {
+      printf("EVP Digest test, DIGEST_Multi failed\n");
+      rv = ICC_ERROR;
+    }
+    for (i = 0; (ICC_OSSL_SUCCESS == rv) && (i < 9); i++) {
+      ICC_EVP_DigestInit(ICC_ctx,md_ctx2,md);
+      ICC_EVP_DigestUpdate(ICC_ctx,md_ctx2,buf1,i * 13);
+      ICC_EVP_DigestFinal(ICC_ctx,md_ctx2,buf2,NULL);
+      if (0 != memcmp(buf2,mdgst[i],sizeof(mdgst[i]))) {
+        printf("EVP Digest test, DIGEST_Multi gave a different digest for %d bytes\n",i * 13);
+        rv = ICC_ERROR;
+      }
+    }
+    /* Reset in place, empty and from a pre-absorbed prefix */
+    ICC_EVP_DigestInit(ICC_ctx,md_ctx2,md);
+    ICC_EVP_DigestUpdate(ICC_ctx,md_ctx2,buf1,28);
+    ICC_EVP_DigestFinal(ICC_ctx,md_ctx2,buf2,NULL);
+    ICC_EVP_DigestInit(ICC_ctx,md_ctx,md);
+    ICC_EVP_DigestUpdate(ICC_ctx,md_ctx,buf1,8);
+    ICC_EVP_DigestInit(ICC_ctx,md_ctx2,md);
+    ICC_EVP_DigestUpdate(ICC_ctx,md_ctx2,buf1,28);
+    for (i = 0; (ICC_OSSL_SUCCESS == rv) && (i < 3); i++) {
+      /* The last pass resets to empty, so the whole message goes in again */
+      if ((ICC_OSSL_SUCCESS != ICC_EVP_DigestFinal_reset(ICC_ctx,md_ctx2,mdgst[i],NULL,
+                                                         (2 == i) ? NULL : md_ctx)) ||
+          (0 != memcmp(buf2,mdgst[i],sizeof(mdgst[i])))) {
+        printf("EVP Digest test, EVP_DigestFinal_reset gave a different digest\n");
+        rv = ICC_ERROR;
+      }
+      if (2 == i) {
+        ICC_EVP_DigestUpdate(ICC_ctx,md_ctx2,buf1,28);
+      } else {
+        ICC_EVP_DigestUpdate(ICC_ctx,md_ctx2,buf1 + 8,20);
+      }
+    }
+    ICC_EVP_DigestFinal(ICC_ctx,md_ctx2,mdgst[3],NULL);
+    if ((ICC_OSSL_SUCCESS == rv) && (0 != memcmp(buf2,mdgst[3],sizeof(mdgst[3])))) {
+      printf("EVP Digest test, EVP_DigestFinal_reset to empty gave a different digest\n");
+      rv = ICC_ERROR;
+    }
+    /* With the context cache on a free then new on this thread is a hit */
+    ICC_GetValue(ICC_ctx,status,ICC_CTX_CACHE,&depth,sizeof(depth));
+    i = 4;
+    ICC_SetValue(ICC_ctx,status,ICC_CTX_CACHE,&i);
+    ICC_GetValue(ICC_ctx,status,ICC_CTX_CACHE_STATS,&counts[0],sizeof(counts[0]));
+    ICC_EVP_MD_CTX_free(ICC_ctx,md_ctx2);
+    md_ctx2 = ICC_EVP_MD_CTX_new(ICC_ctx);
+    ICC_GetValue(ICC_ctx,status,ICC_CTX_CACHE_STATS,&counts[1],sizeof(counts[1]));
+    ICC_SetValue(ICC_ctx,status,ICC_CTX_CACHE,&depth);
+    if ((NULL == md_ctx2) || (counts[1].hits != counts[0].hits + 1)) {
+      printf("EVP Digest test, ICC_CTX_CACHE reuse was not counted\n");
+      rv = ICC_ERROR;
+    } else if ((NULL != md) && 
+               ((1 != ICC_EVP_DigestInit(ICC_ctx,md_ctx2,md)) ||
+                (1 != ICC_EVP_DigestUpdate(ICC_ctx,md_ctx2,buf1,28)) ||
+                (1 != ICC_EVP_DigestFinal(ICC_ctx,md_ctx2,mdgst[0],NULL)) ||
+                (0 != memcmp(buf2,mdgst[0],sizeof(mdgst[0]))))) {
+      printf("EVP Digest test, a reused EVP_MD_CTX gave a different digest\n");
+      rv = ICC_ERROR;
+    }
+    /* The stubs count every call while ICC_API_STATS is on */
+    apis = (ICC_API_STAT *)calloc(NUM_ICCFUNCTIONS, sizeof(ICC_API_STAT));
+    if ((NULL != apis) && (NULL != md) && (NULL != md_ctx2)) {
+      i = 1;
+      ICC_SetValue(ICC_ctx,status,ICC_API_STATS,&i);
+      ICC_EVP_DigestInit(ICC_ctx,md_ctx2,md);
+      for (i = 0; i < 3; i++) {
+        ICC_EVP_DigestUpdate(ICC_ctx,md_ctx2,buf1,28);
+      }
+      ICC_EVP_DigestFinal(ICC_ctx,md_ctx2,mdgst[0],NULL);
+      i = 0;
+      ICC_SetValue(ICC_ctx,status,ICC_API_STATS,&i);
+      ICC_GetValue(ICC_ctx,status,ICC_API_STATS_DATA,apis,NUM_ICCFUNCTIONS * sizeof(ICC_API_STAT));
+      for (i = 0; (i < NUM_ICCFUNCTIONS) && (0 != apis[i].calls); i++) {
+        if (NULL != strstr(apis[i].name,"DigestUpdate")) {
+          break;
+        }
+      }
+      if ((i >= NUM_ICCFUNCTIONS) || (3 != apis[i].calls)) {
+        printf("EVP Digest test, ICC_API_STATS didn't count 3 EVP_DigestUpdate calls\n");
+        rv = ICC_ERROR;
+      }
+    }
+    if (NULL != apis) {
+      free(apis);
+    }
+
     ICC_EVP_MD_CTX_cleanup(ICC_ctx,md_ctx2);
     ICC_EVP_MD_CTX_free(ICC_ctx,md_ctx2);
     ICC_EVP_MD_CTX_cleanup(ICC_ctx,md_ctx); 
@@ -531,6 +677,69 @@ int doEVPDigestUnitTest(ICC_CTX *ICC_ctx)
     ICC_EVP_DigestUpdate(ICC_ctx,md_ctx,buf1,20);
     ICC_EVP_DigestFinalXOF(ICC_ctx,md_ctx,buf1,65);
 #endif
+    /* Incremental squeeze, odd sized pieces crossing the SHAKE256 block
+       boundary must match one EVP_DigestFinalXOF() of the total length
+    */
+    md = ICC_EVP_get_digestbyname(ICC_ctx,"SHAKE256");
+    ICC_EVP_DigestInit(ICC_ctx,md_ctx,md);
+    ICC_EVP_DigestUpdate(ICC_ctx,md_ctx,buf1,200);
+    ICC_EVP_DigestFinalXOF(ICC_ctx,md_ctx,xout[0],sizeof(xout[0]));
+    ICC_EVP_MD_CTX_cleanup(ICC_ctx,md_ctx);
+    memset(xout[1],0,sizeof(xout[1]));
+    xctx = ICC_XOF_CTX_new(ICC_ctx);
+    if( (NULL == xctx) || 
+        (1 != ICC_XOF_CTX_Init(ICC_ctx,xctx,md)) ||
+        (1 != ICC_XOF_CTX_Absorb(ICC_ctx,xctx,buf1,7)) ||
+        (1 != ICC_XOF_CTX_Absorb(ICC_ctx,xctx,buf1+7,193)) ) {
+      printf("EVP Digest test, XOF_CTX setup failed\n");
+      rv = ICC_ERROR;
+    } else {
+      for(i = 1; xoff < sizeof(xout[1]); i += 37) {
+        if((xoff + i) > sizeof(xout[1])) {
+          i = (int)(sizeof(xout[1]) - xoff);
+        }
+        ICC_XOF_CTX_Squeeze(ICC_ctx,xctx,xout[1] + xoff,i);
+        xoff += i;
+      }
+      if(0 != memcmp(xout[0],xout[1],sizeof(xout[0]))) {
+        printf("EVP Digest test, XOF_CTX incremental squeeze differs from EVP_DigestFinalXOF\n");
+        rv = ICC_ERROR;
+      }
+    }
+    ICC_XOF_CTX_free(ICC_ctx,xctx);
+    /* ParallelHash256, 3MB so the threaded rounds are used, hashed in
+       one call and in uneven pieces must give the same answer
+    */
+    pctx = ICC_PHASH_CTX_new(ICC_ctx);
+    pbig = (unsigned char *)malloc(3 * 1024 * 1024);
+    if( (NULL == pctx) || (NULL == pbig) ) {
+      printf("EVP Digest test, PHASH_CTX allocation failed\n");
+      rv = ICC_ERROR;
+    } else {
+      for(i = 0; i < (3 * 1024 * 1024); i++) {
+        pbig[i] = buf1[i % sizeof(buf1)] ^ (unsigned char)(i >> 12);
+      }
+      if( (1 != ICC_PHASH_CTX_Init(ICC_ctx,pctx,md,8192,NULL,0)) ||
+          (1 != ICC_PHASH_CTX_Update(ICC_ctx,pctx,pbig,3 * 1024 * 1024)) ||
+          (1 != ICC_PHASH_CTX_Final(ICC_ctx,pctx,xout[0],64)) ) {
+        printf("EVP Digest test, ParallelHash256 failed\n");
+        rv = ICC_ERROR;
+      }
+      ICC_PHASH_CTX_Init(ICC_ctx,pctx,md,8192,NULL,0);
+      for(xoff = 0; xoff < (3 * 1024 * 1024); xoff += 100003) {
+        ICC_PHASH_CTX_Update(ICC_ctx,pctx,pbig + xoff,
+                             ((3 * 1024 * 1024) - xoff < 100003) ? (3 * 1024 * 1024) - xoff : 100003);
+      }
+      ICC_PHASH_CTX_Final(ICC_ctx,pctx,xout[1],64);
+      if(0 != memcmp(xout[0],xout[1],64)) {
+        printf("EVP Digest test, ParallelHash256 depends on how the input was split\n");
+        rv = ICC_ERROR;
+      }
+    }
+    if(NULL != pbig) {
+      free(pbig);
+    }
+    ICC_PHASH_CTX_free(ICC_ctx,pctx);
 
  
     ICC_EVP_MD_CTX_cleanup(ICC_ctx,md_ctx); 
@@ -666,6 +875,7 @@ int doEVPEnvelopeAndSignatureUnitTest(ICC_CTX *ICC_ctx)
   int i1 = 0;
   int rv = ICC_OSSL_SUCCESS;
   int nid = 0;
+  ICC_BATCH_OP vops[2];
 
   memset(key,'1',64);
   memset(iv,'1',64);
@@ -743,6 +953,31 @@ int doEVPEnvelopeAndSignatureUnitTest(ICC_CTX *ICC_ctx)
     ICC_RSA_sign(ICC_ctx,nid,buf2,20,buf1,&uint1,rsa);
     ICC_RSA_verify(ICC_ctx,nid,buf2,20,buf1,uint1,rsa);
     check_stack(1);
+    /* Per thread clones, the signature must still verify against the key */
+    if((ICC_OSSL_SUCCESS != ICC_RSA_ThreadCache(ICC_ctx,rsa,2)) ||
+       (ICC_OSSL_SUCCESS != ICC_RSA_sign(ICC_ctx,nid,buf2,20,buf1,&uint1,rsa)) ||
+       (ICC_OSSL_SUCCESS != ICC_RSA_verify(ICC_ctx,nid,buf2,20,buf1,uint1,rsa))) {
+      printf("\tRSA_ThreadCache sign/verify failed\n");
+      rv = ICC_ERROR;
+    }
+    /* Grouped digest verifies, the second has a damaged digest */
+    memset(vops,0,sizeof(vops));
+    for(int1 = 0; int1 < 2; int1++) {
+      vops[int1].op = ICC_BATCH_VERIFY_DIGEST;
+      vops[int1].pkey = pkey[0];
+      vops[int1].md = md;
+      vops[int1].in = (0 == int1) ? buf2 : buf2 + 1;
+      vops[int1].inlen = 20;
+      vops[int1].out = buf1;
+      vops[int1].outlen = uint1;
+    }
+    if((ICC_OSSL_SUCCESS == ICC_BATCH_Run(ICC_ctx,vops,2)) ||
+       (ICC_OSSL_SUCCESS != vops[0].rv) || (ICC_OSSL_SUCCESS == vops[1].rv)) {
+      printf("\tBATCH_Run digest verify failed\n");
+      rv = ICC_ERROR;
+    }
+    OSSLE(ICC_ctx);
+    check_stack(1);
     ICC_EVP_PKEY_free(ICC_ctx,pkey[0]);
     retcode = ICC_EVP_MD_CTX_cleanup(ICC_ctx,md_ctx);
     retcode = ICC_EVP_MD_CTX_free(ICC_ctx,md_ctx);
@@ -909,6 +1144,59 @@ int doRandUnitTest(ICC_CTX *ICC_ctx)
     }
   }
   ICC_RAND_seed(ICC_ctx,buf,1);
+  /* Scatter output, each buffer filled, none the same */
+  if (ICC_OSSL_SUCCESS == rv) {
+    unsigned char iv[16], nonce[12], pad[8];
+    ICC_RNG_IOV iov[3];
+
+    memset(iv, 0, sizeof(iv));
+    memset(nonce, 0, sizeof(nonce));
+    memset(pad, 0, sizeof(pad));
+    iov[0].buf = iv;
+    iov[0].len = sizeof(iv);
+    iov[1].buf = nonce;
+    iov[1].len = sizeof(nonce);
+    iov[2].buf = pad;
+    iov[2].len = sizeof(pad);
+    if ((1 != ICC_RAND_bytes_v(ICC_ctx, iov, 3)) ||
+        (0 == memcmp(ZERO, iv + 8, 8)) || (0 == memcmp(ZERO, nonce + 4, 8)) ||
+        (0 == memcmp(ZERO, pad, 8)) || (0 == memcmp(iv, nonce, 8)) ||
+        (0 == memcmp(nonce + 4, pad, 8))) {
+      printf("ICC_RAND_bytes_v() failed\n");
+      rv = ICC_ERROR;
+    }
+  }
+#if !defined(_WIN32)
+  /* A fork() child must not repeat the parent's output */
+  if (ICC_OSSL_SUCCESS == rv) {
+    int fds[2];
+    pid_t pid = -1;
+    unsigned char pbuf[16], cbuf[16];
+
+    if (0 == pipe(fds)) {
+      pid = fork();
+      if (0 == pid) {
+        memset(cbuf, 0, sizeof(cbuf));
+        ICC_RAND_bytes(ICC_ctx, cbuf, sizeof(cbuf));
+        if ((ssize_t)sizeof(cbuf) != write(fds[1], cbuf, sizeof(cbuf))) {
+          _exit(1);
+        }
+        _exit(0);
+      }
+      close(fds[1]);
+      if (pid > 0) {
+        ICC_RAND_bytes(ICC_ctx, pbuf, sizeof(pbuf));
+        if (((ssize_t)sizeof(cbuf) != read(fds[0], cbuf, sizeof(cbuf))) ||
+            (0 == memcmp(pbuf, cbuf, sizeof(pbuf)))) {
+          printf("RAND output after fork() failed or matched the parent\n");
+          rv = ICC_ERROR;
+        }
+        waitpid(pid, NULL, 0);
+      }
+      close(fds[0]);
+    }
+  }
+#endif
   check_stack(1);
   if( ICC_OSSL_SUCCESS == rv) {
     printf("Rand Unit test sucessfully completed!\n");
@@ -1392,26 +1680,45 @@ int doCMACUnitTest(ICC_CTX *ICC_ctx)
   };
   
 
+  /* RFC 4493 example 1, empty message */
+  static unsigned char cmac_ka_mac[] = {
+    0xbb,0x1d,0x69,0x29,0xe9,0x59,0x37,0x28,0x7f,0xa3,0x7d,0x12,0x9b,0x75,0x67,0x46
+  };
+
   ICC_CMAC_CTX *cmac_ctx = NULL;
   const ICC_EVP_CIPHER *cip = NULL;
   unsigned char Result[16];
   int maclen = 16;
+  int rv = ICC_OSSL_SUCCESS;
+  int i = 0;
   printf("Starting CMAC unit test...\n");
   check_stack(0);
   cip = ICC_EVP_get_cipherbyname(ICC_ctx,"AES-128-CBC");
   cmac_ctx = ICC_CMAC_CTX_new(ICC_ctx);
   if(NULL != cmac_ctx) {
     ICC_CMAC_Init(ICC_ctx,cmac_ctx,cip,cmac_ka_key,16);
-    ICC_CMAC_Update(ICC_ctx,cmac_ctx,NULL,0);
-    ICC_CMAC_Final(ICC_ctx,cmac_ctx,Result,maclen);
+    /* Second round restarts with the retained key */
+    for(i = 0; i < 2; i++) {
+      if(i > 0) {
+        ICC_CMAC_Init(ICC_ctx,cmac_ctx,NULL,NULL,0);
+      }
+      ICC_CMAC_Update(ICC_ctx,cmac_ctx,NULL,0);
+      ICC_CMAC_Final(ICC_ctx,cmac_ctx,Result,maclen);
+      if(memcmp(Result,cmac_ka_mac,sizeof(cmac_ka_mac)) != 0) {
+        printf("\t\tCMAC known answer failed, round %d\n",i);
+        rv = ICC_FAILURE;
+      }
+    }
     ICC_CMAC_CTX_free(ICC_ctx,cmac_ctx);
     check_stack(1);
     OSSLE(ICC_ctx);
-    printf("CMAC Unit test sucessfully completed!\n");
+    if(ICC_OSSL_SUCCESS == rv) {
+      printf("CMAC Unit test sucessfully completed!\n");
+    }
   } else {
     printf("CMAC not implemented\n");
   }
-  return ICC_OSSL_SUCCESS;
+  return rv;
 
 }
 
@@ -1432,11 +1739,29 @@ int doHMACUnitTest(ICC_CTX *ICC_ctx)
     0x53,0x61,0x6d,0x70,0x6c,0x65,0x20,0x23,
     0x31
   };
+  static const unsigned char kmac_ka_data[] = {
+    0x00,0x01,0x02,0x03
+  };
+  static const unsigned char kmac_ka[] = {
+    0xe5,0x78,0x0b,0x0d,0x3e,0xa6,0xf7,0xd3,
+    0xa4,0x29,0xc5,0x70,0x6a,0xa4,0x3a,0x00,
+    0xfa,0xdb,0xd7,0xd4,0x96,0x28,0x83,0x9e,
+    0x31,0x87,0x24,0x3f,0x45,0x6e,0xe1,0x4e
+  };
 
   ICC_HMAC_CTX *hmac_ctx = NULL;
+  ICC_HMAC_KEY *hk = NULL;
+  ICC_KMAC_KEY *kk = NULL;
   const ICC_EVP_MD *digest = NULL;
   unsigned char Result[20];
+  unsigned char mac[64];
+  unsigned char ref[64];
   unsigned int outlen = 0;
+  unsigned int maclen = 0;
+  int rv = ICC_OSSL_SUCCESS;
+  int i = 0;
+  /* The pad state engine, and the template clone used for other digests */
+  static const char *hk_digests[] = { "SHA1", "SHA256", "SHA512", "SHA3-256", NULL };
 
   printf("Starting HMAC unit test...\n");
   check_stack(0);
@@ -1448,153 +1773,729 @@ int doHMACUnitTest(ICC_CTX *ICC_ctx)
     ICC_HMAC_Final(ICC_ctx,hmac_ctx,Result,&outlen);
     ICC_HMAC_CTX_free(ICC_ctx,hmac_ctx);
     check_stack(1);
-    printf("HMAC Unit test sucessfully completed!\n");
   } else {
     printf("HAMC Not implemented\n");
   }
-  return ICC_OSSL_SUCCESS;
+  /* A key handle must give the same answer as a full HMAC, repeatedly */
+  hk = ICC_HMAC_KEY_new(ICC_ctx);
+  for(i = 0; (NULL != hk) && (NULL != hk_digests[i]); i++) {
+    digest = ICC_EVP_get_digestbyname(ICC_ctx,hk_digests[i]);
+    hmac_ctx = ICC_HMAC_CTX_new(ICC_ctx);
+    if((NULL == digest) || (NULL == hmac_ctx)) {
+      ICC_HMAC_CTX_free(ICC_ctx,hmac_ctx);
+      continue;
+    }
+    ICC_HMAC_Init(ICC_ctx,hmac_ctx,hmac_ka_key,sizeof(hmac_ka_key),digest);
+    ICC_HMAC_Update(ICC_ctx,hmac_ctx,hmac_ka_data,sizeof(hmac_ka_data));
+    ICC_HMAC_Final(ICC_ctx,hmac_ctx,ref,&outlen);
+    ICC_HMAC_CTX_free(ICC_ctx,hmac_ctx);
+    if((1 != ICC_HMAC_KEY_Init(ICC_ctx,hk,digest,hmac_ka_key,sizeof(hmac_ka_key))) ||
+       (1 != ICC_HMAC_KEY_Sign(ICC_ctx,hk,hmac_ka_data,sizeof(hmac_ka_data),mac,&maclen)) ||
+       (maclen != outlen) || (memcmp(mac,ref,outlen) != 0) ||
+       (1 != ICC_HMAC_KEY_Sign(ICC_ctx,hk,hmac_ka_data,sizeof(hmac_ka_data),mac,&maclen)) ||
+       (memcmp(mac,ref,outlen) != 0) ||
+       (1 != ICC_HMAC_KEY_Verify(ICC_ctx,hk,hmac_ka_data,sizeof(hmac_ka_data),ref,outlen))) {
+      printf("\t\tHMAC_KEY %s failed\n",hk_digests[i]);
+      rv = ICC_FAILURE;
+    }
+    ref[0] ^= 1;
+    if(0 != ICC_HMAC_KEY_Verify(ICC_ctx,hk,hmac_ka_data,sizeof(hmac_ka_data),ref,outlen)) {
+      printf("\t\tHMAC_KEY_Verify %s accepted a bad MAC\n",hk_digests[i]);
+      rv = ICC_FAILURE;
+    }
+  }
+  ICC_HMAC_KEY_free(ICC_ctx,hk);
+  /* KMAC, SP800-185 sample 1, the key state must survive repeated use */
+  kk = ICC_KMAC_KEY_new(ICC_ctx);
+  digest = ICC_EVP_get_digestbyname(ICC_ctx,"SHAKE128");
+  for(i = 0; i < 0x20; i++) {
+    ref[i] = (unsigned char)(0x40 + i);
+  }
+  if((NULL == kk) || (NULL == digest) ||
+     (1 != ICC_KMAC_KEY_Init(ICC_ctx,kk,digest,ref,32,NULL,0)) ||
+     (1 != ICC_KMAC_KEY_Sign(ICC_ctx,kk,kmac_ka_data,sizeof(kmac_ka_data),mac,32)) ||
+     (memcmp(mac,kmac_ka,sizeof(kmac_ka)) != 0) ||
+     (1 != ICC_KMAC_KEY_Sign(ICC_ctx,kk,kmac_ka_data,sizeof(kmac_ka_data),mac,32)) ||
+     (memcmp(mac,kmac_ka,sizeof(kmac_ka)) != 0) ||
+     (1 != ICC_KMAC_KEY_Verify(ICC_ctx,kk,kmac_ka_data,sizeof(kmac_ka_data),kmac_ka,sizeof(kmac_ka)))) {
+    printf("\t\tKMAC_KEY failed\n");
+    rv = ICC_FAILURE;
+  }
+  mac[0] ^= 1;
+  if(0 != ICC_KMAC_KEY_Verify(ICC_ctx,kk,kmac_ka_data,sizeof(kmac_ka_data),mac,32)) {
+    printf("\t\tKMAC_KEY_Verify accepted a bad MAC\n");
+    rv = ICC_FAILURE;
+  }
+  ICC_KMAC_KEY_free(ICC_ctx,kk);
+  if(ICC_OSSL_SUCCESS == rv) {
+    printf("HMAC Unit test sucessfully completed!\n");
+  }
+  return rv;
 
 }
 
 
-int doAES_GCMUnitTest(ICC_CTX *ICC_ctx)
+/*! @brief ICC_AES_GCM_EncryptUpdateV()/ICC_AES_GCM_DecryptUpdateV()
+  Scattered aad, input and output, split at different points, must give
+  the same ciphertext and tag as a one shot Seal of the joined data
+  @return ICC_OSSL_SUCCESS, ICC_FAILURE
+*/
+static int doAES_GCMUpdateVTest(ICC_CTX *ICC_ctx)
 {
-
-  /* NIST draft test vector 4 */
-  static unsigned char  gcm_ka_key[] = {
-    0xfe,0xff,0xe9,0x92,0x86,0x65,0x73,0x1c,
-    0x6d,0x6a,0x8f,0x94,0x67,0x30,0x83,0x08
-  };
-
-  static unsigned char gcm_ka_plaintext[] = {
-    0xd9,0x31,0x32,0x25,0xf8,0x84,0x06,0xe5,
-    0xa5,0x59,0x09,0xc5,0xaf,0xf5,0x26,0x9a,
-    0x86,0xa7,0xa9,0x53,0x15,0x34,0xf7,0xda,
-    0x2e,0x4c,0x30,0x3d,0x8a,0x31,0x8a,0x72,
-    0x1c,0x3c,0x0c,0x95,0x95,0x68,0x09,0x53,
-    0x2f,0xcf,0x0e,0x24,0x49,0xa6,0xb5,0x25,
-    0xb1,0x6a,0xed,0xf5,0xaa,0x0d,0xe6,0x57,
-    0xba,0x63,0x7b,0x39
+  static unsigned char key[32] = {
+    0x60,0x3d,0xeb,0x10,0x15,0xca,0x71,0xbe,
+    0x2b,0x73,0xae,0xf0,0x85,0x7d,0x77,0x81,
+    0x1f,0x35,0x2c,0x07,0x3b,0x61,0x08,0xd7,
+    0x2d,0x98,0x10,0xa3,0x09,0x14,0xdf,0xf4
   };
-  static unsigned char gcm_ka_iv[] = {
+  static unsigned char iv[12] = {
     0xca,0xfe,0xba,0xbe,0xfa,0xce,0xdb,0xad,
     0xde,0xca,0xf8,0x88
   };
-  static unsigned char gcm_ka_aad[] = {
-    0xfe,0xed,0xfa,0xce,0xde,0xad,0xbe,0xef,
-    0xfe,0xed,0xfa,0xce,0xde,0xad,0xbe,0xef,
-    0xab,0xad,0xda,0xd2
-  };
-  static unsigned char gcm_ka_ciphertext[] = {
-    0x42,0x83,0x1e,0xc2,0x21,0x77,0x74,0x24,
-    0x4b,0x72,0x21,0xb7,0x84,0xd0,0xd4,0x9c,
-    0xe3,0xaa,0x21,0x2f,0x2c,0x02,0xa4,0xe0,
-    0x35,0xc1,0x7e,0x23,0x29,0xac,0xa1,0x2e,
-    0x21,0xd5,0x14,0xb2,0x54,0x66,0x93,0x1c,
-    0x7d,0x8f,0x6a,0x5a,0xac,0x84,0xaa,0x05,
-    0x1b,0xa3,0x0b,0x39,0x6a,0x0a,0xac,0x97,
-    0x3d,0x58,0xe0,0x91
-  };
-  static unsigned char gcm_ka_authtag[] = {
-    0x5b,0xc9,0x4f,0xbc,0x32,0x21,0xa5,0xdb,
-    0x94,0xfa,0xe9,0x5a,0xe7,0x12,0x1a,0x47
-  };
-  /* We don't run the full test during BVT, takes too long , uses insane memory
-     but it's useful to do it again and again and ...
-  */
-#define TEST_IVS 6666
-  int rv = ICC_OSSL_SUCCESS;
-  unsigned char *ivbuf = NULL;
-  unsigned char Result[16];
-  unsigned long outlen = 0;
-  unsigned long toutlen = 0;
-  unsigned char ciphertext[sizeof(gcm_ka_ciphertext)+32];
-  unsigned char pt[sizeof(gcm_ka_plaintext)];
+  unsigned char aad[17];
+  unsigned char pt[100];
+  unsigned char ref[sizeof(pt) + 16];
+  unsigned char ct[sizeof(pt) + 16];
+  unsigned char dec[sizeof(pt) + 16];
+  unsigned char tag[16];
+  ICC_AES_IOV a[3];
+  ICC_AES_IOV in[3];
+  ICC_AES_IOV out[3];
   ICC_AES_GCM_CTX *gcm_ctx = NULL;
-  static  unsigned char tmp1[16] = {
-    0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,
-    0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,
-  };
-  static unsigned char tmp2[16];
-  int i,j;
-  int err = 0;
-  memset(Result,0,sizeof(Result));
-  memset(ciphertext,0,sizeof(ciphertext));
-  memset(pt,0,sizeof(pt));
-
-
-  printf("Starting AES_GCM unit test...\n");
-  check_stack(0);
-  ivbuf = calloc(8,TEST_IVS);
+  unsigned long outlen = 0;
+  unsigned long fl = 0;
+  int rv = ICC_OSSL_SUCCESS;
+  int i = 0;
 
+  printf("\tTesting AES_GCM scatter/gather API\n");
+  for(i = 0; i < (int)sizeof(aad); i++) {
+    aad[i] = (unsigned char)(0xa0 + i);
+  }
+  for(i = 0; i < (int)sizeof(pt); i++) {
+    pt[i] = (unsigned char)i;
+  }
+  memset(ct,0,sizeof(ct));
   gcm_ctx = ICC_AES_GCM_CTX_new(ICC_ctx);
-  if(NULL != gcm_ctx) {
-    printf("\tTesting AES_GCM IV generation...\n");
-    for(i = 0; i < TEST_IVS; i++) {
-      if( 0 == ICC_AES_GCM_GenerateIV(ICC_ctx,gcm_ctx,&ivbuf[i*8]) ) {
-	err ++;
-      }
-    }
-    if(err) {
-      printf("Bug: AES_GCM IV generation failed due to TRNG seed failure\n");
-    }
-    for(i = 0; i < TEST_IVS; i++) {
-      for(j = i+1; j < TEST_IVS; j++) {
-	if(memcmp(&ivbuf[i*8],&ivbuf[j*8],8) == 0) {
-	  printf("Bug: AES_GCM IV gen returned identical IV's in %d sample test\n",TEST_IVS);
-	  err++;
-	}
-      }
-    }
-
-    if(err) { 
-      printf("\tAES_GCM IV generation failed.\n");
-    } else {
-      printf("\tAES_CGM IV, no repeats in %u samples\n",TEST_IVS);
+  if((NULL == gcm_ctx) ||
+     (1 != ICC_AES_GCM_Seal(ICC_ctx,gcm_ctx,iv,sizeof(iv),key,sizeof(key),aad,sizeof(aad),
+                            pt,sizeof(pt),ref,&outlen)) ||
+     (outlen != sizeof(ref))) {
+    printf("\t\tGCM Seal failed\n");
+    rv = ICC_FAILURE;
+  }
+  if(ICC_OSSL_SUCCESS == rv) {
+    /* aad 5 + 0 + 12, input 1 + 33 + 66, output 16 + 17 + 67 */
+    a[0].base = aad; a[0].len = 5;
+    a[1].base = aad + 5; a[1].len = 0;
+    a[2].base = aad + 5; a[2].len = 12;
+    in[0].base = pt; in[0].len = 1;
+    in[1].base = pt + 1; in[1].len = 33;
+    in[2].base = pt + 34; in[2].len = 66;
+    out[0].base = ct; out[0].len = 16;
+    out[1].base = ct + 16; out[1].len = 17;
+    out[2].base = ct + 33; out[2].len = 67;
+    fl = 0;
+    if((1 != ICC_AES_GCM_Init(ICC_ctx,gcm_ctx,iv,sizeof(iv),key,sizeof(key))) ||
+       (1 != ICC_AES_GCM_EncryptUpdateV(ICC_ctx,gcm_ctx,a,3,in,3,out,3,&outlen)) ||
+       (1 != ICC_AES_GCM_EncryptFinal(ICC_ctx,gcm_ctx,ct + outlen,&fl,tag)) ||
+       ((outlen + fl) != sizeof(pt)) ||
+       (0 != memcmp(ct,ref,sizeof(pt))) || (0 != memcmp(tag,ref + sizeof(pt),16))) {
+      printf("\t\tGCM EncryptUpdateV doesn't match Seal\n");
+      rv = ICC_FAILURE;
     }
-    printf("\tStarting GCM tests\n");
-
-    toutlen = 0;
-    ICC_AES_GCM_Init(ICC_ctx,gcm_ctx,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_key,sizeof(gcm_ka_key));
-
-    ICC_AES_GCM_EncryptUpdate(ICC_ctx,gcm_ctx,gcm_ka_aad,sizeof(gcm_ka_aad),gcm_ka_plaintext,sizeof(gcm_ka_plaintext),ciphertext,&outlen);  
-    toutlen += outlen;
-    ICC_AES_GCM_EncryptFinal(ICC_ctx,gcm_ctx,ciphertext+outlen,&outlen,Result);
-    toutlen += outlen;
-    if(0 != memcmp(Result,gcm_ka_authtag,sizeof(gcm_ka_authtag)) ) {
-      printf("\t\tGCM Encrypt failed (authtag mismatch)\n");
-      rv = ICC_OPENSSL_ERROR;
+  }
+  if(ICC_OSSL_SUCCESS == rv) {
+    /* Decrypt the other way round, input 50 + 49 + 1, output 100 in one */
+    in[0].base = ct; in[0].len = 50;
+    in[1].base = ct + 50; in[1].len = 49;
+    in[2].base = ct + 99; in[2].len = 1;
+    out[0].base = dec; out[0].len = sizeof(pt);
+    fl = 0;
+    memset(dec,0,sizeof(dec));
+    if((1 != ICC_AES_GCM_Init(ICC_ctx,gcm_ctx,iv,sizeof(iv),key,sizeof(key))) ||
+       (1 != ICC_AES_GCM_DecryptUpdateV(ICC_ctx,gcm_ctx,a,3,in,3,out,1,&outlen)) ||
+       (1 != ICC_AES_GCM_DecryptFinal(ICC_ctx,gcm_ctx,dec + outlen,&fl,tag,16)) ||
+       ((outlen + fl) != sizeof(pt)) ||
+       (0 != memcmp(dec,pt,sizeof(pt)))) {
+      printf("\t\tGCM DecryptUpdateV failed\n");
+      rv = ICC_FAILURE;
     }
-    /* IV MUST be supplied */
-    ICC_AES_GCM_Init(ICC_ctx,gcm_ctx,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_key,sizeof(gcm_ka_key));
-    outlen = 0;
-    ICC_AES_GCM_DecryptUpdate(ICC_ctx,gcm_ctx,gcm_ka_aad,sizeof(gcm_ka_aad),ciphertext,toutlen,pt,&outlen);
-    if(1 != ICC_AES_GCM_DecryptFinal(ICC_ctx,gcm_ctx,pt+outlen,&outlen,Result,16)) {
-      printf("\t\tGCM Decrypt failed (authtag mismatch)\n");
-      rv = ICC_OPENSSL_ERROR;
+  }
+  if(ICC_OSSL_SUCCESS == rv) {
+    /* Less output space than input is refused */
+    out[0].len = sizeof(pt) - 1;
+    if((1 != ICC_AES_GCM_Init(ICC_ctx,gcm_ctx,iv,sizeof(iv),key,sizeof(key))) ||
+       (1 == ICC_AES_GCM_DecryptUpdateV(ICC_ctx,gcm_ctx,a,3,in,3,out,1,&outlen))) {
+      printf("\t\tGCM DecryptUpdateV accepted a short output list\n");
+      rv = ICC_FAILURE;
     }
-
-    /* And now - a couple of tests just for completeness
-       all these really do is put a tick in the box WRT test coverage
-
-       GHASH is there are a convenience while testing
-    */
-    ICC_AES_GCM_CTX_ctrl(ICC_ctx,gcm_ctx,ICC_AES_GCM_CTRL_SET_ACCEL,0,NULL);
-    ICC_GHASH(ICC_ctx,gcm_ctx,tmp1,tmp2,gcm_ka_plaintext,sizeof(gcm_ka_plaintext));
-    check_stack(1);
-    if(ICC_OSSL_SUCCESS == rv ) {
-      printf("AES_GCM Unit test sucessfully completed!\n");
-    } 
+  }
+  if(NULL != gcm_ctx) {
     ICC_AES_GCM_CTX_free(ICC_ctx,gcm_ctx);
-  } else {
-    printf("AES_GCM not implemented\n");
   }
-  if(NULL != ivbuf) free(ivbuf);
-  ivbuf = NULL;
   return rv;
 }
-int doAES_CCMUnitTest(ICC_CTX *ICC_ctx)
-{
+
+/*! @brief ICC_AES_GCM_SegmentSeal()/ICC_AES_GCM_SegmentOpen()
+  A three segment object round trips, segments opened at the wrong
+  position, a non final segment passed off as the last one and a cut
+  short final segment are all rejected
+  @return ICC_OSSL_SUCCESS, ICC_FAILURE
+*/
+static int doAES_GCMSegmentTest(ICC_CTX *ICC_ctx)
+{
+#define GCM_SEGS 3
+#define GCM_SEGLEN 40
+  static unsigned char key[16] = {
+    0xad,0x7a,0x2b,0xd0,0x3e,0xac,0x83,0x5a,
+    0x6f,0x62,0x0f,0xdc,0xb5,0x06,0xb3,0x45
+  };
+  static unsigned char nonce[ICC_AES_GCM_SEG_NONCELEN] = {
+    0x12,0x15,0x35,0x24,0xc0,0x89,0x5e
+  };
+  static const unsigned long lens[GCM_SEGS] = { GCM_SEGLEN, GCM_SEGLEN, 25 };
+  unsigned char pt[GCM_SEGS * GCM_SEGLEN];
+  unsigned char ct[GCM_SEGS][GCM_SEGLEN + 16];
+  unsigned long ctlen[GCM_SEGS];
+  unsigned char dec[GCM_SEGLEN];
+  unsigned char zero[GCM_SEGLEN];
+  ICC_AES_GCM_CTX *gcm_ctx = NULL;
+  unsigned long outlen = 0;
+  int rv = ICC_OSSL_SUCCESS;
+  int i = 0;
+
+  printf("\tTesting AES_GCM segmented object API\n");
+  for(i = 0; i < (int)sizeof(pt); i++) {
+    pt[i] = (unsigned char)(i * 7);
+  }
+  memset(zero,0,sizeof(zero));
+  gcm_ctx = ICC_AES_GCM_CTX_new(ICC_ctx);
+  if(NULL == gcm_ctx) {
+    rv = ICC_FAILURE;
+  }
+  for(i = 0; (ICC_OSSL_SUCCESS == rv) && (i < GCM_SEGS); i++) {
+    if((1 != ICC_AES_GCM_SegmentSeal(ICC_ctx,gcm_ctx,key,sizeof(key),nonce,i,(GCM_SEGS - 1) == i,
+                                     NULL,0,pt + i * GCM_SEGLEN,lens[i],ct[i],&ctlen[i])) ||
+       (ctlen[i] != lens[i] + 16)) {
+      printf("\t\tGCM SegmentSeal %d failed\n",i);
+      rv = ICC_FAILURE;
+    }
+  }
+  /* In order, and each one on it's own */
+  for(i = 0; (ICC_OSSL_SUCCESS == rv) && (i < GCM_SEGS); i++) {
+    if((1 != ICC_AES_GCM_SegmentOpen(ICC_ctx,gcm_ctx,key,sizeof(key),nonce,i,(GCM_SEGS - 1) == i,
+                                     NULL,0,ct[i],ctlen[i],dec,&outlen)) ||
+       (outlen != lens[i]) || (0 != memcmp(dec,pt + i * GCM_SEGLEN,lens[i]))) {
+      printf("\t\tGCM SegmentOpen %d failed\n",i);
+      rv = ICC_FAILURE;
+    }
+  }
+  if(ICC_OSSL_SUCCESS == rv) {
+    /* Segments 0 and 1 swapped */
+    memset(dec,0x55,sizeof(dec));
+    if((0 != ICC_AES_GCM_SegmentOpen(ICC_ctx,gcm_ctx,key,sizeof(key),nonce,0,0,
+                                     NULL,0,ct[1],ctlen[1],dec,&outlen)) ||
+       (0 != outlen) || (0 != memcmp(dec,zero,lens[1])) ||
+       (0 != ICC_AES_GCM_SegmentOpen(ICC_ctx,gcm_ctx,key,sizeof(key),nonce,1,0,
+                                     NULL,0,ct[0],ctlen[0],dec,&outlen))) {
+      printf("\t\tGCM SegmentOpen accepted reordered segments\n");
+      rv = ICC_FAILURE;
+    }
+    /* Truncated object, segment 1 presented as the last */
+    if(0 != ICC_AES_GCM_SegmentOpen(ICC_ctx,gcm_ctx,key,sizeof(key),nonce,1,1,
+                                    NULL,0,ct[1],ctlen[1],dec,&outlen)) {
+      printf("\t\tGCM SegmentOpen accepted a truncated object\n");
+      rv = ICC_FAILURE;
+    }
+    /* The real last segment claimed not to be, i.e. the object was extended */
+    if(0 != ICC_AES_GCM_SegmentOpen(ICC_ctx,gcm_ctx,key,sizeof(key),nonce,2,0,
+                                    NULL,0,ct[2],ctlen[2],dec,&outlen)) {
+      printf("\t\tGCM SegmentOpen accepted the last segment as a middle one\n");
+      rv = ICC_FAILURE;
+    }
+    /* Final segment cut short by a byte */
+    if(0 != ICC_AES_GCM_SegmentOpen(ICC_ctx,gcm_ctx,key,sizeof(key),nonce,2,1,
+                                    NULL,0,ct[2],ctlen[2] - 1,dec,&outlen)) {
+      printf("\t\tGCM SegmentOpen accepted a short final segment\n");
+      rv = ICC_FAILURE;
+    }
+  }
+  if(NULL != gcm_ctx) {
+    ICC_AES_GCM_CTX_free(ICC_ctx,gcm_ctx);
+  }
+  return rv;
+#undef GCM_SEGS
+#undef GCM_SEGLEN
+}
+
+/*! @brief ICC_AES_GCM_RecordSeal()/ICC_AES_GCM_RecordOpen(), TLS 1.3 and TLS 1.2 record mode
+  Records round trip, record 0 matches a Seal with the static IV, a
+  changed header or a record out of sequence is rejected and doesn't
+  advance the receiver
+  @return ICC_OSSL_SUCCESS, ICC_FAILURE
+*/
+static int doAES_GCMRecordTest(ICC_CTX *ICC_ctx)
+{
+  static unsigned char key[16] = {
+    0x17,0x42,0x2d,0xda,0x59,0x6e,0xd5,0xd9,
+    0xac,0xd8,0x90,0xe3,0xc6,0x3f,0x50,0x51
+  };
+  static unsigned char siv[12] = {
+    0x5b,0x78,0x92,0x3d,0xee,0x08,0x57,0x90,
+    0x33,0xe5,0x23,0xd9
+  };
+  unsigned char hdr[5] = { 0x17,0x03,0x03,0x00,0x00 };
+  unsigned char pt[64];
+  unsigned char rec[4][sizeof(pt) + 24];
+  unsigned long reclen[4];
+  unsigned char ref[sizeof(pt) + 16];
+  unsigned char dec[sizeof(pt) + 24];
+  ICC_AES_GCM_CTX *s = NULL;
+  ICC_AES_GCM_CTX *d = NULL;
+  unsigned long outlen = 0;
+  int rv = ICC_OSSL_SUCCESS;
+  int mode = 0;
+  int i = 0;
+
+  printf("\tTesting AES_GCM TLS record API\n");
+  for(i = 0; i < (int)sizeof(pt); i++) {
+    pt[i] = (unsigned char)(0x80 ^ i);
+  }
+  for(mode = 0; (ICC_OSSL_SUCCESS == rv) && (mode < 2); mode++) {
+    s = ICC_AES_GCM_CTX_new(ICC_ctx);
+    d = ICC_AES_GCM_CTX_new(ICC_ctx);
+    if((NULL == s) || (NULL == d) ||
+       (1 != ICC_AES_GCM_CTX_ctrl(ICC_ctx,s,mode ? ICC_AES_GCM_CTRL_TLS12 : ICC_AES_GCM_CTRL_TLS13,
+                                  mode ? 4 : 12,siv)) ||
+       (1 != ICC_AES_GCM_CTX_ctrl(ICC_ctx,d,mode ? ICC_AES_GCM_CTRL_TLS12 : ICC_AES_GCM_CTRL_TLS13,
+                                  mode ? 4 : 12,siv))) {
+      printf("\t\tGCM record mode setup failed\n");
+      rv = ICC_FAILURE;
+    }
+    for(i = 0; (ICC_OSSL_SUCCESS == rv) && (i < 4); i++) {
+      if(1 != ICC_AES_GCM_RecordSeal(ICC_ctx,s,(0 == i) ? key : NULL,sizeof(key),hdr,sizeof(hdr),
+                                     pt,sizeof(pt) - i,rec[i],&reclen[i])) {
+        printf("\t\tGCM RecordSeal %d failed\n",i);
+        rv = ICC_FAILURE;
+      }
+    }
+    if((ICC_OSSL_SUCCESS == rv) && (0 == mode)) {
+      /* TLS 1.3 record 0, the nonce is the static IV */
+      ICC_AES_GCM_CTX_free(ICC_ctx,d);
+      d = ICC_AES_GCM_CTX_new(ICC_ctx);
+      if((NULL == d) ||
+         (1 != ICC_AES_GCM_Seal(ICC_ctx,d,siv,sizeof(siv),key,sizeof(key),hdr,sizeof(hdr),
+                                pt,sizeof(pt),ref,&outlen)) ||
+         (reclen[0] != outlen) || (0 != memcmp(ref,rec[0],outlen))) {
+        printf("\t\tGCM RecordSeal doesn't match Seal\n");
+        rv = ICC_FAILURE;
+      }
+      ICC_AES_GCM_CTX_free(ICC_ctx,d);
+      d = ICC_AES_GCM_CTX_new(ICC_ctx);
+      if((NULL == d) || (1 != ICC_AES_GCM_CTX_ctrl(ICC_ctx,d,ICC_AES_GCM_CTRL_TLS13,12,siv))) {
+        rv = ICC_FAILURE;
+      }
+    }
+    if(ICC_OSSL_SUCCESS == rv) {
+      /* Record 0 with the content type changed */
+      hdr[0] ^= 0x01;
+      if(0 != ICC_AES_GCM_RecordOpen(ICC_ctx,d,key,sizeof(key),hdr,sizeof(hdr),rec[0],reclen[0],dec,&outlen)) {
+        printf("\t\tGCM RecordOpen accepted a changed header\n");
+        rv = ICC_FAILURE;
+      }
+      hdr[0] ^= 0x01;
+      /* Record 1 before record 0 */
+      if(0 != ICC_AES_GCM_RecordOpen(ICC_ctx,d,key,sizeof(key),hdr,sizeof(hdr),rec[1],reclen[1],dec,&outlen)) {
+        printf("\t\tGCM RecordOpen accepted a record out of sequence\n");
+        rv = ICC_FAILURE;
+      }
+    }
+    /* Neither failure moved the receiver on, all four now open in order */
+    for(i = 0; (ICC_OSSL_SUCCESS == rv) && (i < 4); i++) {
+      if((1 != ICC_AES_GCM_RecordOpen(ICC_ctx,d,key,sizeof(key),hdr,sizeof(hdr),rec[i],reclen[i],dec,&outlen)) ||
+         (outlen != sizeof(pt) - i) || (0 != memcmp(dec,pt,outlen))) {
+        printf("\t\tGCM RecordOpen %d failed\n",i);
+        rv = ICC_FAILURE;
+      }
+    }
+    /* and a replay of the last one is refused */
+    if((ICC_OSSL_SUCCESS == rv) &&
+       (0 != ICC_AES_GCM_RecordOpen(ICC_ctx,d,NULL,0,hdr,sizeof(hdr),rec[3],reclen[3],dec,&outlen))) {
+      printf("\t\tGCM RecordOpen accepted a replayed record\n");
+      rv = ICC_FAILURE;
+    }
+    if(NULL != s) {
+      ICC_AES_GCM_CTX_free(ICC_ctx,s);
+    }
+    if(NULL != d) {
+      ICC_AES_GCM_CTX_free(ICC_ctx,d);
+    }
+    s = d = NULL;
+  }
+  return rv;
+}
+
+/*! @brief Read the 64 bit big endian invocation field of a generated IV */
+static unsigned long long ivgen_field(unsigned char *iv)
+{
+  unsigned long long n = 0;
+  int i = 0;
+
+  for(i = 0; i < 8; i++) {
+    n = (n << 8) | iv[i];
+  }
+  return n;
+}
+
+/*! @brief ICC_AES_GCM_IVGEN_..() deterministic IV generator
+  IV's keep the fixed field and the invocation field goes up by one
+  each time, so none repeat. With -l the generator is also run to it's
+  2^32 limit, after which it must refuse.
+  @return ICC_OSSL_SUCCESS, ICC_FAILURE
+*/
+static int doAES_GCMIVGenTest(ICC_CTX *ICC_ctx)
+{
+#define GCM_IVGEN_N 1000
+  static unsigned char fixed[8] = {
+    0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08
+  };
+  unsigned char iv[16];
+  unsigned char prev[16];
+  unsigned long long n = 0;
+  ICC_AES_GCM_IVGEN *gen = NULL;
+  int rv = ICC_OSSL_SUCCESS;
+  int i = 0;
+
+  printf("\tTesting AES_GCM deterministic IV generator\n");
+  /* 8 byte fixed field, 16 byte IV's */
+  gen = ICC_AES_GCM_IVGEN_new(ICC_ctx,fixed,sizeof(fixed));
+  if(NULL == gen) {
+    printf("\t\tGCM IVGEN_new failed\n");
+    rv = ICC_FAILURE;
+  } else {
+    if((1 == ICC_AES_GCM_IVGEN_generate(ICC_ctx,gen,iv,12)) ||
+       (1 == ICC_AES_GCM_IVGEN_generate(ICC_ctx,gen,iv,17))) {
+      printf("\t\tGCM IVGEN accepted the wrong IV length\n");
+      rv = ICC_FAILURE;
+    }
+    for(i = 0; (ICC_OSSL_SUCCESS == rv) && (i < GCM_IVGEN_N); i++) {
+      if((1 != ICC_AES_GCM_IVGEN_generate(ICC_ctx,gen,iv,16)) ||
+         (0 != memcmp(iv,fixed,sizeof(fixed)))) {
+        printf("\t\tGCM IVGEN_generate failed\n");
+        rv = ICC_FAILURE;
+      } else if((i > 0) && (ivgen_field(iv + 8) != ivgen_field(prev + 8) + 1)) {
+        /* Unsigned, so a random start near 2^64 wraps cleanly */
+        printf("\t\tGCM IVGEN IV %d isn't the previous one + 1\n",i);
+        rv = ICC_FAILURE;
+      }
+      memcpy(prev,iv,sizeof(iv));
+    }
+    ICC_AES_GCM_IVGEN_free(ICC_ctx,gen);
+  }
+  /* Random fixed field, 12 byte IV's, the invocation field has a random start */
+  gen = ICC_AES_GCM_IVGEN_new(ICC_ctx,NULL,0);
+  if(NULL == gen) {
+    printf("\t\tGCM IVGEN_new (random fixed field) failed\n");
+    rv = ICC_FAILURE;
+  } else {
+    for(i = 0; (ICC_OSSL_SUCCESS == rv) && (i < GCM_IVGEN_N); i++) {
+      if(1 != ICC_AES_GCM_IVGEN_generate(ICC_ctx,gen,iv,12)) {
+        printf("\t\tGCM IVGEN_generate failed\n");
+        rv = ICC_FAILURE;
+      } else if((i > 0) && ((0 != memcmp(iv,prev,4)) ||
+                            (ivgen_field(iv + 4) != ivgen_field(prev + 4) + 1))) {
+        printf("\t\tGCM IVGEN IV %d isn't the previous one + 1\n",i);
+        rv = ICC_FAILURE;
+      }
+      memcpy(prev,iv,12);
+    }
+    if((ICC_OSSL_SUCCESS == rv) && long_tests) {
+      /* GCM_IVGEN_N used, run to the 2^32 limit */
+      printf("\tRunning the AES_GCM IV generator to exhaustion...\n");
+      for(n = GCM_IVGEN_N; n < (1ULL << 32); n++) {
+        if(1 != ICC_AES_GCM_IVGEN_generate(ICC_ctx,gen,iv,12)) {
+          printf("\t\tGCM IVGEN refused early, after %llu IV's\n",n);
+          rv = ICC_FAILURE;
+          break;
+        }
+      }
+      if((ICC_OSSL_SUCCESS == rv) &&
+         ((1 == ICC_AES_GCM_IVGEN_generate(ICC_ctx,gen,iv,12)) ||
+          (1 == ICC_AES_GCM_IVGEN_generate(ICC_ctx,gen,iv,12)))) {
+        printf("\t\tGCM IVGEN didn't refuse after 2^32 IV's\n");
+        rv = ICC_FAILURE;
+      }
+    }
+    ICC_AES_GCM_IVGEN_free(ICC_ctx,gen);
+  }
+  return rv;
+#undef GCM_IVGEN_N
+}
+
+/*! @brief ICC_AES_GCM_EncryptBatch()/ICC_AES_GCM_DecryptBatch()
+  Each batch record must match a one shot Seal, a bad tag fails only
+  that record and clears it's output
+  @return ICC_OSSL_SUCCESS, ICC_FAILURE
+*/
+static int doAES_GCMBatchTest(ICC_CTX *ICC_ctx)
+{
+#define GCM_BATCH_N 3
+  static unsigned char key[16] = {
+    0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,
+    0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f
+  };
+  static unsigned char aad[] = "batch aad";
+  static const unsigned long lens[GCM_BATCH_N] = { 1, 64, 77 };
+  unsigned char iv[GCM_BATCH_N][12];
+  unsigned char pt[GCM_BATCH_N][80];
+  unsigned char ct[GCM_BATCH_N][80];
+  unsigned char tag[GCM_BATCH_N][16];
+  unsigned char dec[GCM_BATCH_N][80];
+  unsigned char ref[80 + 16];
+  ICC_AES_GCM_REC recs[GCM_BATCH_N];
+  ICC_AES_GCM_CTX *gcm_ctx = NULL;
+  unsigned long outlen = 0;
+  int rv = ICC_OSSL_SUCCESS;
+  int i = 0;
+
+  printf("\tTesting AES_GCM batch API\n");
+  for(i = 0; i < GCM_BATCH_N; i++) {
+    memset(iv[i], 0xa0 + i, sizeof(iv[i]));
+    memset(pt[i], 0x30 + i, sizeof(pt[i]));
+    recs[i].iv = iv[i];
+    recs[i].ivlen = sizeof(iv[i]);
+    recs[i].aad = aad;
+    recs[i].aadlen = sizeof(aad) - 1;
+    recs[i].in = pt[i];
+    recs[i].inlen = lens[i];
+    recs[i].out = ct[i];
+    recs[i].tag = tag[i];
+    recs[i].rv = -1;
+  }
+  gcm_ctx = ICC_AES_GCM_CTX_new(ICC_ctx);
+  if((NULL == gcm_ctx) ||
+     (ICC_OSSL_SUCCESS != ICC_AES_GCM_EncryptBatch(ICC_ctx,gcm_ctx,key,sizeof(key),recs,GCM_BATCH_N))) {
+    printf("\t\tGCM EncryptBatch failed\n");
+    rv = ICC_FAILURE;
+  }
+  for(i = 0; (ICC_OSSL_SUCCESS == rv) && (i < GCM_BATCH_N); i++) {
+    if((1 != recs[i].rv) ||
+       (1 != ICC_AES_GCM_Seal(ICC_ctx,gcm_ctx,iv[i],sizeof(iv[i]),key,sizeof(key),
+                              aad,sizeof(aad) - 1,pt[i],lens[i],ref,&outlen)) ||
+       (outlen != lens[i] + 16) ||
+       (0 != memcmp(ref,ct[i],lens[i])) || (0 != memcmp(ref + lens[i],tag[i],16))) {
+      printf("\t\tGCM EncryptBatch record %d doesn't match Seal\n",i);
+      rv = ICC_FAILURE;
+    }
+  }
+  if(ICC_OSSL_SUCCESS == rv) {
+    /* Decrypt with the middle record's tag broken */
+    tag[1][0] ^= 0x01;
+    memset(dec,0x55,sizeof(dec));
+    for(i = 0; i < GCM_BATCH_N; i++) {
+      recs[i].in = ct[i];
+      recs[i].out = dec[i];
+      recs[i].rv = -1;
+    }
+    if((ICC_OSSL_SUCCESS == ICC_AES_GCM_DecryptBatch(ICC_ctx,gcm_ctx,key,sizeof(key),recs,GCM_BATCH_N)) ||
+       (1 != recs[0].rv) || (0 != recs[1].rv) || (1 != recs[2].rv)) {
+      printf("\t\tGCM DecryptBatch didn't isolate the bad record\n");
+      rv = ICC_FAILURE;
+    } else {
+      for(i = 0; i < GCM_BATCH_N; i++) {
+        memset(ref,(1 == i) ? 0 : (0x30 + i),lens[i]);
+        if(0 != memcmp(ref,dec[i],lens[i])) {
+          printf("\t\tGCM DecryptBatch record %d output wrong\n",i);
+          rv = ICC_FAILURE;
+        }
+      }
+    }
+  }
+  if(NULL != gcm_ctx) {
+    ICC_AES_GCM_CTX_free(ICC_ctx,gcm_ctx);
+  }
+  return rv;
+#undef GCM_BATCH_N
+}
+
+int doAES_GCMUnitTest(ICC_CTX *ICC_ctx)
+{
+
+  /* NIST draft test vector 4 */
+  static unsigned char  gcm_ka_key[] = {
+    0xfe,0xff,0xe9,0x92,0x86,0x65,0x73,0x1c,
+    0x6d,0x6a,0x8f,0x94,0x67,0x30,0x83,0x08
+  };
+
+  static unsigned char gcm_ka_plaintext[] = {
+    0xd9,0x31,0x32,0x25,0xf8,0x84,0x06,0xe5,
+    0xa5,0x59,0x09,0xc5,0xaf,0xf5,0x26,0x9a,
+    0x86,0xa7,0xa9,0x53,0x15,0x34,0xf7,0xda,
+    0x2e,0x4c,0x30,0x3d,0x8a,0x31,0x8a,0x72,
+    0x1c,0x3c,0x0c,0x95,0x95,0x68,0x09,0x53,
+    0x2f,0xcf,0x0e,0x24,0x49,0xa6,0xb5,0x25,
+    0xb1,0x6a,0xed,0xf5,0xaa,0x0d,0xe6,0x57,
+    0xba,0x63,0x7b,0x39
+  };
+  static unsigned char gcm_ka_iv[] = {
+    0xca,0xfe,0xba,0xbe,0xfa,0xce,0xdb,0xad,
+    0xde,0xca,0xf8,0x88
+  };
+  static unsigned char gcm_ka_aad[] = {
+    0xfe,0xed,0xfa,0xce,0xde,0xad,0xbe,0xef,
+    0xfe,0xed,0xfa,0xce,0xde,0xad,0xbe,0xef,
+    0xab,0xad,0xda,0xd2
+  };
+  static unsigned char gcm_ka_ciphertext[] = {
+    0x42,0x83,0x1e,0xc2,0x21,0x77,0x74,0x24,
+    0x4b,0x72,0x21,0xb7,0x84,0xd0,0xd4,0x9c,
+    0xe3,0xaa,0x21,0x2f,0x2c,0x02,0xa4,0xe0,
+    0x35,0xc1,0x7e,0x23,0x29,0xac,0xa1,0x2e,
+    0x21,0xd5,0x14,0xb2,0x54,0x66,0x93,0x1c,
+    0x7d,0x8f,0x6a,0x5a,0xac,0x84,0xaa,0x05,
+    0x1b,0xa3,0x0b,0x39,0x6a,0x0a,0xac,0x97,
+    0x3d,0x58,0xe0,0x91
+  };
+  static unsigned char gcm_ka_authtag[] = {
+    0x5b,0xc9,0x4f,0xbc,0x32,0x21,0xa5,0xdb,
+    0x94,0xfa,0xe9,0x5a,0xe7,0x12,0x1a,0x47
+  };
+  /* We don't run the full test during BVT, takes too long , uses insane memory
+     but it's useful to do it again and again and ...
+  */
+#define TEST_IVS 6666
+  int rv = ICC_OSSL_SUCCESS;
+  unsigned char *ivbuf = NULL;
+  unsigned char Result[16];
+  unsigned long outlen = 0;
+  unsigned long toutlen = 0;
+  unsigned char ciphertext[sizeof(gcm_ka_ciphertext)+32];
+  unsigned char pt[sizeof(gcm_ka_plaintext)];
+  ICC_AES_GCM_CTX *gcm_ctx = NULL;
+  static  unsigned char tmp1[16] = {
+    0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,
+    0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,
+  };
+  static unsigned char tmp2[16];
+  int i,j;
+  int err = 0;
+  memset(Result,0,sizeof(Result));
+  memset(ciphertext,0,sizeof(ciphertext));
+  memset(pt,0,sizeof(pt));
+
+
+  printf("Starting AES_GCM unit test...\n");
+  check_stack(0);
+  ivbuf = calloc(8,TEST_IVS);
+
+  gcm_ctx = ICC_AES_GCM_CTX_new(ICC_ctx);
+  if(NULL != gcm_ctx) {
+    printf("\tTesting AES_GCM IV generation...\n");
+    for(i = 0; i < TEST_IVS; i++) {
+      if( 0 == ICC_AES_GCM_GenerateIV(ICC_ctx,gcm_ctx,&ivbuf[i*8]) ) {
+	err ++;
+      }
+    }
+    if(err) {
+      printf("Bug: AES_GCM IV generation failed due to TRNG seed failure\n");
+    }
+    for(i = 0; i < TEST_IVS; i++) {
+      for(j = i+1; j < TEST_IVS; j++) {
+	if(memcmp(&ivbuf[i*8],&ivbuf[j*8],8) == 0) {
+	  printf("Bug: AES_GCM IV gen returned identical IV's in %d sample test\n",TEST_IVS);
+	  err++;
+	}
+      }
+    }
+
+    if(err) { 
+      printf("\tAES_GCM IV generation failed.\n");
+    } else {
+      printf("\tAES_CGM IV, no repeats in %u samples\n",TEST_IVS);
+    }
+    printf("\tStarting GCM tests\n");
+
+    toutlen = 0;
+    ICC_AES_GCM_Init(ICC_ctx,gcm_ctx,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_key,sizeof(gcm_ka_key));
+
+    ICC_AES_GCM_EncryptUpdate(ICC_ctx,gcm_ctx,gcm_ka_aad,sizeof(gcm_ka_aad),gcm_ka_plaintext,sizeof(gcm_ka_plaintext),ciphertext,&outlen);  
+    toutlen += outlen;
+    ICC_AES_GCM_EncryptFinal(ICC_ctx,gcm_ctx,ciphertext+outlen,&outlen,Result);
+    toutlen += outlen;
+    if(0 != memcmp(Result,gcm_ka_authtag,sizeof(gcm_ka_authtag)) ) {
+      printf("\t\tGCM Encrypt failed (authtag mismatch)\n");
+      rv = ICC_OPENSSL_ERROR;
+    }
+    /* IV MUST be supplied */
+    ICC_AES_GCM_Init(ICC_ctx,gcm_ctx,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_key,sizeof(gcm_ka_key));
+    outlen = 0;
+    ICC_AES_GCM_DecryptUpdate(ICC_ctx,gcm_ctx,gcm_ka_aad,sizeof(gcm_ka_aad),ciphertext,toutlen,pt,&outlen);
+    if(1 != ICC_AES_GCM_DecryptFinal(ICC_ctx,gcm_ctx,pt+outlen,&outlen,Result,16)) {
+      printf("\t\tGCM Decrypt failed (authtag mismatch)\n");
+      rv = ICC_OPENSSL_ERROR;
+    }
+    /* One shot variants, fresh context, output is ciphertext || tag */
+    ICC_AES_GCM_CTX_free(ICC_ctx,gcm_ctx);
+    gcm_ctx = ICC_AES_GCM_CTX_new(ICC_ctx);
+    outlen = 0;
+    if((1 != ICC_AES_GCM_Seal(ICC_ctx,gcm_ctx,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_key,sizeof(gcm_ka_key),
+                              gcm_ka_aad,sizeof(gcm_ka_aad),gcm_ka_plaintext,sizeof(gcm_ka_plaintext),
+                              ciphertext,&outlen)) ||
+       (outlen != sizeof(gcm_ka_ciphertext) + 16) ||
+       (0 != memcmp(ciphertext,gcm_ka_ciphertext,sizeof(gcm_ka_ciphertext))) ||
+       (0 != memcmp(ciphertext + sizeof(gcm_ka_ciphertext),gcm_ka_authtag,16)) ) {
+      printf("\t\tGCM Seal failed\n");
+      rv = ICC_OPENSSL_ERROR;
+    }
+    ICC_AES_GCM_CTX_free(ICC_ctx,gcm_ctx);
+    gcm_ctx = ICC_AES_GCM_CTX_new(ICC_ctx);
+    toutlen = outlen;
+    outlen = 0;
+    memset(pt,0,sizeof(pt));
+    if((1 != ICC_AES_GCM_Open(ICC_ctx,gcm_ctx,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_key,sizeof(gcm_ka_key),
+                              gcm_ka_aad,sizeof(gcm_ka_aad),ciphertext,toutlen,pt,&outlen)) ||
+       (outlen != sizeof(gcm_ka_plaintext)) ||
+       (0 != memcmp(pt,gcm_ka_plaintext,sizeof(gcm_ka_plaintext))) ) {
+      printf("\t\tGCM Open failed\n");
+      rv = ICC_OPENSSL_ERROR;
+    }
+    if(ICC_OSSL_SUCCESS != doAES_GCMBatchTest(ICC_ctx)) {
+      rv = ICC_OPENSSL_ERROR;
+    }
+    if(ICC_OSSL_SUCCESS != doAES_GCMIVGenTest(ICC_ctx)) {
+      rv = ICC_OPENSSL_ERROR;
+    }
+    if(ICC_OSSL_SUCCESS != doAES_GCMUpdateVTest(ICC_ctx)) {
+      rv = ICC_OPENSSL_ERROR;
+    }
+    if(ICC_OSSL_SUCCESS != doAES_GCMSegmentTest(ICC_ctx)) {
+      rv = ICC_OPENSSL_ERROR;
+    }
+    if(ICC_OSSL_SUCCESS != doAES_GCMRecordTest(ICC_ctx)) {
+      rv = ICC_OPENSSL_ERROR;
+    }
+
+    /* And now - a couple of tests just for completeness
+       all these really do is put a tick in the box WRT test coverage
+
+       GHASH is there are a convenience while testing
+    */
+    ICC_AES_GCM_CTX_ctrl(ICC_ctx,gcm_ctx,ICC_AES_GCM_CTRL_SET_ACCEL,0,NULL);
+    ICC_GHASH(ICC_ctx,gcm_ctx,tmp1,tmp2,gcm_ka_plaintext,sizeof(gcm_ka_plaintext));
+    check_stack(1);
+    if(ICC_OSSL_SUCCESS == rv ) {
+      printf("AES_GCM Unit test sucessfully completed!\n");
+    } 
+    ICC_AES_GCM_CTX_free(ICC_ctx,gcm_ctx);
+  } else {
+    printf("AES_GCM not implemented\n");
+  }
+  if(NULL != ivbuf) free(ivbuf);
+  ivbuf = NULL;
+  return rv;
+}
+int doAES_CCMUnitTest(ICC_CTX *ICC_ctx)
+{
 
   /* NIST SP800-38C example vector 2 */
   static unsigned char  Key[] = {
@@ -1624,6 +2525,8 @@ int doAES_CCMUnitTest(ICC_CTX *ICC_ctx)
   unsigned char *out = NULL;
   unsigned long outlen = 0;
   int err = 0;
+  int i = 0;
+  ICC_AES_CCM_CTX *ccm_ctx = NULL;
 
   printf("Starting AES_CCM unit test...\n");
   check_stack(0);
@@ -1646,6 +2549,30 @@ int doAES_CCMUnitTest(ICC_CTX *ICC_ctx)
     } else if(memcmp(out,pt,sizeof(pt)) != 0) {
       rv = ICC_FAILURE;
     }
+    /* Reusable context API, two rounds to exercise the retained key */
+    ccm_ctx = ICC_AES_CCM_CTX_new(ICC_ctx);
+    if((NULL == ccm_ctx) || (1 != ICC_AES_CCM_Init(ICC_ctx,ccm_ctx,Key,16,6))) {
+      printf("\t\tAES_CCM_Init failed\n");
+      rv = ICC_FAILURE;
+    } else {
+      for(i = 0; i < 2; i++) {
+        if((1 != ICC_AES_CCM_Seal(ICC_ctx,ccm_ctx,nonce,sizeof(nonce),aad,sizeof(aad),
+                                  pt,sizeof(pt),out,&outlen)) ||
+           (outlen != sizeof(ct)) || (memcmp(out,ct,sizeof(ct)) != 0)) {
+          printf("\t\tAES_CCM_Seal failed\n");
+          rv = ICC_FAILURE;
+        }
+        if((1 != ICC_AES_CCM_Open(ICC_ctx,ccm_ctx,nonce,sizeof(nonce),aad,sizeof(aad),
+                                  ct,sizeof(ct),out,&outlen)) ||
+           (outlen != sizeof(pt)) || (memcmp(out,pt,sizeof(pt)) != 0)) {
+          printf("\t\tAES_CCM_Open failed\n");
+          rv = ICC_FAILURE;
+        }
+      }
+    }
+    if(NULL != ccm_ctx) {
+      ICC_AES_CCM_CTX_free(ICC_ctx,ccm_ctx);
+    }
     
     check_stack(1);
     if(ICC_OSSL_SUCCESS == rv ) {
@@ -1658,6 +2585,317 @@ int doAES_CCMUnitTest(ICC_CTX *ICC_ctx)
 }
 
 
+/*! @brief AES_XTS_Sectors(), IEEE 1619 vector 2 and a run that crosses 2^64 */
+int doAES_XTSUnitTest(ICC_CTX *ICC_ctx)
+{
+  /* IEEE 1619-2007 XTS-AES-128 vector 2, Key1 = 0x11.., Key2 = 0x22.., 
+     data unit 0x3333333333, plaintext 0x44..
+  */
+  static unsigned char ct[] = {
+    0xc4,0x54,0x18,0x5e,0x6a,0x16,0x93,0x6e,
+    0x39,0x33,0x40,0x38,0xac,0xef,0x83,0x8b,
+    0xfb,0x18,0x6f,0xff,0x74,0x80,0xad,0xc4,
+    0x28,0x93,0x82,0xec,0xd6,0xd3,0x94,0xf0
+  };
+  /* The same key and plaintext, data unit 2^64 (tweak 00*8 || 01 00*7) */
+  static unsigned char ct64[] = {
+    0xb5,0xb1,0x6b,0x23,0x7a,0xd8,0x8d,0x58,
+    0x30,0x0e,0x07,0x77,0xd4,0xf7,0x91,0x43,
+    0x94,0xa7,0x11,0x23,0xf5,0x09,0x74,0x42,
+    0xdb,0xdc,0x29,0x31,0x5c,0x49,0x44,0x1b
+  };
+  unsigned char key[32];
+  unsigned char pt[sizeof(ct)];
+  unsigned char out[2 * sizeof(ct)];
+  unsigned char in[2 * sizeof(ct)];
+  unsigned char one[sizeof(ct)];
+  int rv = ICC_OSSL_SUCCESS;
+  ICC_AES_XTS_CTX *enc = NULL;
+  ICC_AES_XTS_CTX *dec = NULL;
+
+  printf("Starting AES_XTS unit test...\n");
+  check_stack(0);
+  memset(key, 0x11, 16);
+  memset(key + 16, 0x22, 16);
+  memset(pt, 0x44, sizeof(pt));
+  memset(in, 0x44, sizeof(in));
+  enc = ICC_AES_XTS_CTX_new(ICC_ctx);
+  dec = ICC_AES_XTS_CTX_new(ICC_ctx);
+  if((NULL == enc) || (NULL == dec) ||
+     (1 != ICC_AES_XTS_Init(ICC_ctx, enc, key, sizeof(key), 1)) ||
+     (1 != ICC_AES_XTS_Init(ICC_ctx, dec, key, sizeof(key), 0))) {
+    printf("\t\tAES_XTS_Init failed\n");
+    rv = ICC_FAILURE;
+  } else {
+    if((1 != ICC_AES_XTS_Sectors(ICC_ctx, enc, 0x3333333333ULL, sizeof(pt), 1, pt, out)) ||
+       (memcmp(out, ct, sizeof(ct)) != 0)) {
+      printf("\t\tAES_XTS known answer failed\n");
+      rv = ICC_FAILURE;
+    }
+    if((1 != ICC_AES_XTS_Sectors(ICC_ctx, dec, 0x3333333333ULL, sizeof(ct), 1, ct, out)) ||
+       (memcmp(out, pt, sizeof(pt)) != 0)) {
+      printf("\t\tAES_XTS known answer decrypt failed\n");
+      rv = ICC_FAILURE;
+    }
+    /* Sectors 2^64-1 and 2^64 in one call, the second tweak carries into
+       the high 8 bytes rather than wrapping to sector 0
+    */
+    if((1 != ICC_AES_XTS_Sectors(ICC_ctx, enc, 0xFFFFFFFFFFFFFFFFULL, sizeof(ct), 2, in, out)) ||
+       (1 != ICC_AES_XTS_Sectors(ICC_ctx, enc, 0xFFFFFFFFFFFFFFFFULL, sizeof(ct), 1, pt, one)) ||
+       (memcmp(out, one, sizeof(one)) != 0) ||
+       (memcmp(out + sizeof(ct), ct64, sizeof(ct64)) != 0)) {
+      printf("\t\tAES_XTS tweak carry failed\n");
+      rv = ICC_FAILURE;
+    }
+  }
+  if(NULL != enc) {
+    ICC_AES_XTS_CTX_free(ICC_ctx, enc);
+  }
+  if(NULL != dec) {
+    ICC_AES_XTS_CTX_free(ICC_ctx, dec);
+  }
+  check_stack(1);
+  if(ICC_OSSL_SUCCESS == rv ) {
+    printf("AES_XTS Unit test sucessfully completed!\n");
+  }
+  return rv;
+}
+
+
+int doCHACHA_POLYUnitTest(ICC_CTX *ICC_ctx)
+{
+  /* RFC 8439 2.8.2 */
+  static unsigned char Key[] = {
+    0x80,0x81,0x82,0x83,0x84,0x85,0x86,0x87,
+    0x88,0x89,0x8a,0x8b,0x8c,0x8d,0x8e,0x8f,
+    0x90,0x91,0x92,0x93,0x94,0x95,0x96,0x97,
+    0x98,0x99,0x9a,0x9b,0x9c,0x9d,0x9e,0x9f
+  };
+  static unsigned char nonce[] = {
+    0x07,0x00,0x00,0x00,0x40,0x41,0x42,0x43,
+    0x44,0x45,0x46,0x47
+  };
+  static unsigned char aad[] = {
+    0x50,0x51,0x52,0x53,0xc0,0xc1,0xc2,0xc3,
+    0xc4,0xc5,0xc6,0xc7
+  };
+  static unsigned char pt[] = {
+    0x4c,0x61,0x64,0x69,0x65,0x73,0x20,0x61,
+    0x6e,0x64,0x20,0x47,0x65,0x6e,0x74,0x6c,
+    0x65,0x6d,0x65,0x6e,0x20,0x6f,0x66,0x20,
+    0x74,0x68,0x65,0x20,0x63,0x6c,0x61,0x73,
+    0x73,0x20,0x6f,0x66,0x20,0x27,0x39,0x39,
+    0x3a,0x20,0x49,0x66,0x20,0x49,0x20,0x63,
+    0x6f,0x75,0x6c,0x64,0x20,0x6f,0x66,0x66,
+    0x65,0x72,0x20,0x79,0x6f,0x75,0x20,0x6f,
+    0x6e,0x6c,0x79,0x20,0x6f,0x6e,0x65,0x20,
+    0x74,0x69,0x70,0x20,0x66,0x6f,0x72,0x20,
+    0x74,0x68,0x65,0x20,0x66,0x75,0x74,0x75,
+    0x72,0x65,0x2c,0x20,0x73,0x75,0x6e,0x73,
+    0x63,0x72,0x65,0x65,0x6e,0x20,0x77,0x6f,
+    0x75,0x6c,0x64,0x20,0x62,0x65,0x20,0x69,
+    0x74,0x2e
+  };
+  static unsigned char ct[] = {
+    0xd3,0x1a,0x8d,0x34,0x64,0x8e,0x60,0xdb,
+    0x7b,0x86,0xaf,0xbc,0x53,0xef,0x7e,0xc2,
+    0xa4,0xad,0xed,0x51,0x29,0x6e,0x08,0xfe,
+    0xa9,0xe2,0xb5,0xa7,0x36,0xee,0x62,0xd6,
+    0x3d,0xbe,0xa4,0x5e,0x8c,0xa9,0x67,0x12,
+    0x82,0xfa,0xfb,0x69,0xda,0x92,0x72,0x8b,
+    0x1a,0x71,0xde,0x0a,0x9e,0x06,0x0b,0x29,
+    0x05,0xd6,0xa5,0xb6,0x7e,0xcd,0x3b,0x36,
+    0x92,0xdd,0xbd,0x7f,0x2d,0x77,0x8b,0x8c,
+    0x98,0x03,0xae,0xe3,0x28,0x09,0x1b,0x58,
+    0xfa,0xb3,0x24,0xe4,0xfa,0xd6,0x75,0x94,
+    0x55,0x85,0x80,0x8b,0x48,0x31,0xd7,0xbc,
+    0x3f,0xf4,0xde,0xf0,0x8e,0x4b,0x7a,0x9d,
+    0xe5,0x76,0xd2,0x65,0x86,0xce,0xc6,0x4b,
+    0x61,0x16,
+    0x1a,0xe1,0x0b,0x59,0x4f,0x09,0xe2,0x6a,
+    0x7e,0x90,0x2e,0xcb,0xd0,0x60,0x06,0x91
+  };
+
+  int rv = ICC_OSSL_SUCCESS;
+  unsigned char *out = NULL;
+  unsigned char tag[16];
+  unsigned long outlen = 0;
+  int i = 0;
+  ICC_CHACHA_POLY_CTX *cp_ctx = NULL;
+  ICC_CHACHA_POLY_REC recs[2];
+  ICC_BATCH_OP ops[3];
+
+  printf("Starting ChaCha20-Poly1305 unit test...\n");
+  check_stack(0);
+  out = malloc(sizeof(ct)*2);
+  cp_ctx = ICC_CHACHA_POLY_CTX_new(ICC_ctx);
+  if((NULL == cp_ctx) || (1 != ICC_CHACHA_POLY_Init(ICC_ctx,cp_ctx,Key,sizeof(Key)))) {
+    printf("\t\tCHACHA_POLY_Init failed\n");
+    rv = ICC_FAILURE;
+  } else {
+    /* Two rounds to exercise the retained key */
+    for(i = 0; i < 2; i++) {
+      if((1 != ICC_CHACHA_POLY_Seal(ICC_ctx,cp_ctx,nonce,sizeof(nonce),aad,sizeof(aad),
+                                    pt,sizeof(pt),out,&outlen)) ||
+         (outlen != sizeof(ct)) || (memcmp(out,ct,sizeof(ct)) != 0)) {
+        printf("\t\tCHACHA_POLY_Seal failed\n");
+        rv = ICC_FAILURE;
+      }
+      if((1 != ICC_CHACHA_POLY_Open(ICC_ctx,cp_ctx,nonce,sizeof(nonce),aad,sizeof(aad),
+                                    ct,sizeof(ct),out,&outlen)) ||
+         (outlen != sizeof(pt)) || (memcmp(out,pt,sizeof(pt)) != 0)) {
+        printf("\t\tCHACHA_POLY_Open failed\n");
+        rv = ICC_FAILURE;
+      }
+    }
+    /* Batch, the second record has a bad tag and must fail on it's own */
+    for(i = 0; i < 2; i++) {
+      recs[i].iv = nonce;
+      recs[i].aad = aad;
+      recs[i].aadlen = sizeof(aad);
+      recs[i].in = ct;
+      recs[i].inlen = sizeof(pt);
+      recs[i].out = out + i * sizeof(pt);
+      recs[i].tag = (0 == i) ? ct + sizeof(pt) : tag;
+      recs[i].rv = -1;
+    }
+    memcpy(tag,ct + sizeof(pt),sizeof(tag));
+    tag[0] ^= 1;
+    if((ICC_OSSL_SUCCESS == ICC_CHACHA_POLY_OpenBatch(ICC_ctx,cp_ctx,recs,2)) ||
+       (1 != recs[0].rv) || (0 != recs[1].rv) ||
+       (memcmp(out,pt,sizeof(pt)) != 0)) {
+      printf("\t\tCHACHA_POLY_OpenBatch failed\n");
+      rv = ICC_FAILURE;
+    }
+    /* The same vector through the generic batch call, the open has a bad tag */
+    memset(ops,0,sizeof(ops));
+    for(i = 0; i < 3; i++) {
+      ops[i].op = (0 == i) ? ICC_BATCH_AEAD_SEAL : ICC_BATCH_AEAD_OPEN;
+      ops[i].cipher = ICC_EVP_get_cipherbyname(ICC_ctx,"ChaCha20-Poly1305");
+      ops[i].key = Key;
+      ops[i].keylen = sizeof(Key);
+      ops[i].iv = nonce;
+      ops[i].ivlen = sizeof(nonce);
+      ops[i].aad = aad;
+      ops[i].aadlen = sizeof(aad);
+      ops[i].in = (0 == i) ? pt : ct;
+      ops[i].inlen = sizeof(pt);
+      ops[i].outlen = sizeof(pt);
+      ops[i].taglen = sizeof(tag);
+      ops[i].rv = -1;
+    }
+    ops[0].out = out;
+    ops[0].tag = out + sizeof(pt);
+    ops[1].tag = ct + sizeof(pt);
+    ops[1].out = out + sizeof(ct);
+    ops[2].tag = tag;
+    ops[2].out = out + sizeof(ct);
+    if((ICC_OSSL_SUCCESS == ICC_BATCH_Run(ICC_ctx,ops,3)) ||
+       (1 != ops[0].rv) || (1 != ops[1].rv) || (0 != ops[2].rv) ||
+       (memcmp(out,ct,sizeof(ct)) != 0)) {
+      printf("\t\tBATCH_Run failed\n");
+      rv = ICC_FAILURE;
+    }
+  }
+  if(NULL != cp_ctx) {
+    ICC_CHACHA_POLY_CTX_free(ICC_ctx,cp_ctx);
+  }
+  check_stack(1);
+  if(ICC_OSSL_SUCCESS == rv ) {
+    printf("ChaCha20-Poly1305 Unit test sucessfully completed!\n");
+  }
+  if(out) free(out);
+  return rv;
+}
+
+
+int doPBKDF2UnitTest(ICC_CTX *ICC_ctx)
+{
+  /* RFC 6070, 4096 iterations and a key longer than one HMAC block */
+  static const unsigned char DK1[20] = {
+    0x4b,0x00,0x79,0x01,0xb7,0x65,0x48,0x9a,
+    0xbe,0xad,0x49,0xd9,0x26,0xf7,0x21,0xd0,
+    0x65,0xa4,0x29,0xc1
+  };
+  static const unsigned char DK2[25] = {
+    0x3d,0x2e,0xec,0x4f,0xe4,0x1c,0x84,0x9b,
+    0x80,0xc8,0xd8,0x36,0x62,0xc0,0xe4,0x4a,
+    0x8b,0x29,0x1a,0x96,0x4c,0xf2,0xf0,0x70,
+    0x38
+  };
+  static const char P2[] = "passwordPASSWORDpassword";
+  static const char S2[] = "saltSALTsaltSALTsaltSALTsaltSALTsalt";
+  int rv = ICC_OSSL_SUCCESS;
+  const ICC_EVP_MD *md = NULL;
+  unsigned char out[3][32];
+  ICC_PBKDF2_REC recs[3];
+  ICC_STATUS sts,*status = &sts;
+  unsigned char lk[2][200];
+  int threads = 0;
+  int i = 0;
+
+  printf("Starting PBKDF2 unit test...\n");
+  check_stack(0);
+  md = ICC_EVP_get_digestbyname(ICC_ctx,"SHA1");
+  if(NULL == md) {
+    printf("\t\tPBKDF2 SHA1 N/A\n");
+  } else {
+    if((1 != ICC_PKCS5_PBKDF2_HMAC(ICC_ctx,"password",8,(unsigned char *)"salt",4,
+                                   4096,md,sizeof(DK1),out[0])) ||
+       (memcmp(out[0],DK1,sizeof(DK1)) != 0)) {
+      printf("\t\tPKCS5_PBKDF2_HMAC failed\n");
+      rv = ICC_FAILURE;
+    }
+    /* Batch, the second entry has the wrong password */
+    for(i = 0; i < 3; i++) {
+      recs[i].pass = P2;
+      recs[i].passlen = strlen(P2);
+      recs[i].salt = (const unsigned char *)S2;
+      recs[i].saltlen = strlen(S2);
+      recs[i].iters = 4096;
+      recs[i].keylen = sizeof(DK2);
+      recs[i].out = out[i];
+      recs[i].expect = (2 == i) ? NULL : DK2;
+      recs[i].rv = -1;
+    }
+    recs[1].passlen--;
+    if((ICC_OSSL_SUCCESS == ICC_PBKDF2_HMAC_Batch(ICC_ctx,md,recs,3)) ||
+       (1 != recs[0].rv) || (0 != recs[1].rv) || (1 != recs[2].rv) ||
+       (memcmp(out[2],DK2,sizeof(DK2)) != 0)) {
+      printf("\t\tPBKDF2_HMAC_Batch failed\n");
+      rv = ICC_FAILURE;
+    }
+  }
+  /* A long key on worker threads must match the single threaded result */
+  md = ICC_EVP_get_digestbyname(ICC_ctx,"SHA256");
+  if(NULL != md) {
+    ICC_GetValue(ICC_ctx,status,ICC_PBKDF2_THREADS,&threads,sizeof(threads));
+    i = 1;
+    ICC_SetValue(ICC_ctx,status,ICC_PBKDF2_THREADS,&i);
+    ICC_PKCS5_PBKDF2_HMAC(ICC_ctx,P2,strlen(P2),(unsigned char *)S2,strlen(S2),
+                          1000,md,sizeof(lk[0]),lk[0]);
+    i = 4;
+    if(ICC_OK != ICC_SetValue(ICC_ctx,status,ICC_PBKDF2_THREADS,&i)) {
+      printf("\t\tSetting ICC_PBKDF2_THREADS failed\n");
+      rv = ICC_FAILURE;
+    }
+    if((1 != ICC_PKCS5_PBKDF2_HMAC(ICC_ctx,P2,strlen(P2),(unsigned char *)S2,
+                                   strlen(S2),1000,md,sizeof(lk[1]),lk[1])) ||
+       (memcmp(lk[0],lk[1],sizeof(lk[0])) != 0)) {
+      printf("\t\tThreaded PKCS5_PBKDF2_HMAC failed\n");
+      rv = ICC_FAILURE;
+    }
+    if(threads > 0) {
+      ICC_SetValue(ICC_ctx,status,ICC_PBKDF2_THREADS,&threads);
+    }
+  }
+  check_stack(1);
+  if(ICC_OSSL_SUCCESS == rv ) {
+    printf("PBKDF2 Unit test sucessfully completed!\n");
+  }
+  return rv;
+}
+
 
 int doDESUnitTest(ICC_CTX *ICC_ctx)
 {
@@ -1880,6 +3118,10 @@ int doECDHTest(ICC_CTX *ICC_ctx)
 
   unsigned char *hash_bufa[SHA1_len];
   unsigned char *hash_bufb[SHA1_len];
+  ICC_EVP_PKEY *pka = NULL, *pkb = NULL;
+  unsigned char pta[133], ptb[133];
+  unsigned char seca[66], secb[66];
+  ICC_BATCH_OP dops[2];
 
   int lena = 0;
   int lenb = 0;
@@ -1905,6 +3147,8 @@ int doECDHTest(ICC_CTX *ICC_ctx)
     method = ICC_EC_GROUP_method_of(ICC_ctx,group);
     
     
+    /* a is only used for ECDH, FIPS keygen takes the Q = d.G pair-wise test */
+    ICC_EC_KEY_set_flags(ICC_ctx,a,ICC_EC_FLAG_KEY_AGREEMENT);
     retcode = ICC_EC_KEY_generate_key(ICC_ctx,a) ;
     if( ICC_OSSL_SUCCESS == retcode) {
       /* For coverage only ... */
@@ -1962,6 +3206,33 @@ int doECDHTest(ICC_CTX *ICC_ctx)
 	retcode = ICC_OSSL_FAILURE;
 	printf("    ECDH key agreement failed!\n");
       }
+      /* The same agreement both ways round with ICC_BATCH_DERIVE,
+         peers passed as uncompressed (4) points
+      */
+      pka = ICC_EVP_PKEY_new(ICC_ctx);
+      pkb = ICC_EVP_PKEY_new(ICC_ctx);
+      if((ICC_OSSL_SUCCESS == retcode) && (NULL != pka) && (NULL != pkb)) {
+        ICC_EVP_PKEY_set1_EC_KEY(ICC_ctx,pka,a);
+        ICC_EVP_PKEY_set1_EC_KEY(ICC_ctx,pkb,b);
+        memset(dops,0,sizeof(dops));
+        dops[0].op = ICC_BATCH_DERIVE;
+        dops[0].pkey = pka;
+        dops[0].in = ptb;
+        dops[0].inlen = (unsigned long)ICC_EC_POINT_point2oct(ICC_ctx,group,ICC_EC_KEY_get0_public_key(ICC_ctx,b),4,ptb,sizeof(ptb),bn_ctx);
+        dops[0].out = seca;
+        dops[0].outlen = sizeof(seca);
+        dops[1].op = ICC_BATCH_DERIVE;
+        dops[1].pkey = pkb;
+        dops[1].in = pta;
+        dops[1].inlen = (unsigned long)ICC_EC_POINT_point2oct(ICC_ctx,group,ICC_EC_KEY_get0_public_key(ICC_ctx,a),4,pta,sizeof(pta),bn_ctx);
+        dops[1].out = secb;
+        dops[1].outlen = sizeof(secb);
+        if((ICC_OSSL_SUCCESS != ICC_BATCH_Run(ICC_ctx,dops,2)) || (48 != dops[0].outlen) ||
+           (dops[0].outlen != dops[1].outlen) || (0 != memcmp(seca,secb,dops[0].outlen))) {
+          retcode = ICC_OSSL_FAILURE;
+          printf("    ICC_BATCH_Run() key agreement failed!\n");
+        }
+      }
   
 
     }
@@ -1978,6 +3249,8 @@ int doECDHTest(ICC_CTX *ICC_ctx)
   if(NULL != x_b) ICC_BN_clear_free(ICC_ctx,x_b);
   if(NULL != x_a) ICC_BN_clear_free(ICC_ctx,x_a);
   if(NULL != bn_ctx) ICC_BN_CTX_free(ICC_ctx,bn_ctx);
+  if(NULL != pka) ICC_EVP_PKEY_free(ICC_ctx,pka);
+  if(NULL != pkb) ICC_EVP_PKEY_free(ICC_ctx,pkb);
   if(NULL != a)   ICC_EC_KEY_free(ICC_ctx,a);
   if(NULL != b)   ICC_EC_KEY_free(ICC_ctx,b);
   ctx = NULL;
@@ -1999,6 +3272,11 @@ int doECDSATest(ICC_CTX *ICC_ctx)
   unsigned char *tmp = NULL;
   unsigned int bufl = 0;
   int nid = 0;
+  int i = 0;
+  ICC_ECDSA_POOL *pool = NULL;
+  ICC_PKEY_JOB *job = NULL;
+  ICC_EVP_PKEY *pkey = NULL;
+  size_t jlen = 0;
 
   printf("Starting ECDSA unit test...\n");
   nid = ICC_OBJ_txt2nid(ICC_ctx,(char *)"secp521r1");
@@ -2050,8 +3328,56 @@ int doECDSATest(ICC_CTX *ICC_ctx)
        that we never actually needed to use in real test cases
     */
     if(NULL != ec_key) {
-      ICC_EC_KEY_check_key(ICC_ctx,ec_key); 
-    }    
+      ICC_EC_KEY_check_key(ICC_ctx,ec_key);
+    }
+    /* Precomputed nonces, then the empty pool fallback */
+    if(retcode == ICC_OSSL_SUCCESS) {
+      printf("   Testing ECDSA nonce pool...\n");
+      pool = ICC_ECDSA_POOL_new(ICC_ctx,ec_key,4);
+      if((NULL == pool) || (4 != ICC_ECDSA_POOL_Fill(ICC_ctx,pool,8))) {
+        retcode = ICC_OSSL_FAILURE;
+      }
+      for(i = 0; (i < 6) && (ICC_OSSL_SUCCESS == retcode); i++) {
+        sig = ICC_ECDSA_POOL_Sign(ICC_ctx,pool,fake_hash,20);
+        if((NULL == sig) ||
+           (1 != ICC_ECDSA_do_verify(ICC_ctx,fake_hash,20,sig,ec_key))) {
+          printf("   ECDSA nonce pool signature %d failed!\n",i);
+          retcode = ICC_OSSL_FAILURE;
+        }
+        if(NULL != sig) ICC_ECDSA_SIG_free(ICC_ctx,sig);
+        sig = NULL;
+      }
+      if((ICC_OSSL_SUCCESS == retcode) &&
+         ((1 != ICC_ECDSA_POOL_Fill(ICC_ctx,pool,1)) ||
+          (ICC_OSSL_SUCCESS != ICC_ECDSA_POOL_Flush(ICC_ctx,pool)) ||
+          (0 != ICC_ECDSA_POOL_Fill(ICC_ctx,pool,0)))) {
+        printf("   ECDSA nonce pool flush failed!\n");
+        retcode = ICC_OSSL_FAILURE;
+      }
+      if(NULL != pool) ICC_ECDSA_POOL_free(ICC_ctx,pool);
+    }
+    /* Asynchronous signing on the worker pool */
+    if(retcode == ICC_OSSL_SUCCESS) {
+      printf("   Testing asynchronous ECDSA sign...\n");
+      pkey = ICC_EVP_PKEY_new(ICC_ctx);
+      job = ICC_PKEY_JOB_new(ICC_ctx);
+      sigbuf = (unsigned char *)calloc(len,1);
+      jlen = len;
+      if((NULL == pkey) || (NULL == job) || (NULL == sigbuf) ||
+         (1 != ICC_EVP_PKEY_set1_EC_KEY(ICC_ctx,pkey,ec_key)) ||
+         (1 != ICC_PKEY_JOB_Submit(ICC_ctx,job,pkey,ICC_PKEY_JOB_SIGN,NULL,0,
+                                   fake_hash,20,NULL,NULL)) ||
+         (1 != ICC_PKEY_JOB_Result(ICC_ctx,job,1,sigbuf,&jlen)) ||
+         (0 != ICC_PKEY_JOB_Result(ICC_ctx,job,0,NULL,NULL)) ||
+         (ICC_OSSL_SUCCESS != ICC_ECDSA_verify(ICC_ctx,0,fake_hash,20,sigbuf,(int)jlen,ec_key))) {
+        printf("   Asynchronous ECDSA sign failed!\n");
+        retcode = ICC_OSSL_FAILURE;
+      }
+      if(NULL != sigbuf) free(sigbuf);
+      sigbuf = NULL;
+      if(NULL != job) ICC_PKEY_JOB_free(ICC_ctx,job);
+      if(NULL != pkey) ICC_EVP_PKEY_free(ICC_ctx,pkey);
+    }
     if(retcode == ICC_OSSL_SUCCESS) {
       printf("ECDSA Unit test sucessfully completed!\n");
     } 
@@ -2067,6 +3393,8 @@ int doTRNGTest(ICC_CTX *ICC_ctx,ICC_STATUS *status)
   char *buffer = NULL;
   int entropy = 0;
   int i;
+  ICC_RNG_STAT *rstats = NULL;
+  unsigned long long seeded = 0;
   printf("Starting TRNG unit test...\n");
   ICC_GetValue(ICC_ctx,status,ICC_ENTROPY_ESTIMATE,&entropy,sizeof(entropy));
   if( ICC_ERROR != status->majRC) {
@@ -2080,8 +3408,23 @@ int doTRNGTest(ICC_CTX *ICC_ctx,ICC_STATUS *status)
       printf("%d ",entropy);
       if(entropy < 60) rv |= ICC_ERROR;
     }
+    printf("\n");
+    /* Everything we just asked for came from a seed RNG */
+    rstats = (ICC_RNG_STAT *)calloc(512, sizeof(ICC_RNG_STAT));
+    if(NULL != rstats) {
+      ICC_GetValue(ICC_ctx,status,ICC_RNG_STATS,rstats,512 * sizeof(ICC_RNG_STAT));
+      for(i = 0; i < 512; i++) {
+        if((ICC_RNG_POOL_SEED == rstats[i].pool) || (ICC_RNG_THREAD_SEED == rstats[i].pool)) {
+          seeded += rstats[i].bytes;
+        }
+      }
+      if(seeded < 1024*10) {
+        printf("ICC_RNG_STATS counted %llu seed bytes, expected at least %d\n",seeded,1024*10);
+        rv |= ICC_ERROR;
+      }
+      free(rstats);
+    }
     if(ICC_OK == rv) rv = ICC_OSSL_SUCCESS;
-    printf("\n");
     if(rv == ICC_OSSL_SUCCESS) {
       printf("TRNG Unit test sucessfully completed!\n");
     } 
@@ -2321,6 +3664,8 @@ int doKDFTest(ICC_CTX *ICC_ctx)
   int srv = 0;
   int err = 0;
   static const char skey[64] = "0123456789001234567890012345678900123456789001234567890";
+  ICC_KDF_REC recs[2];
+  unsigned char bkeys[3][32];
 
   buffer = malloc(BUFSZ);
   printf("Starting SP800-108 KDF unit tests...\n");
@@ -2360,6 +3705,34 @@ int doKDFTest(ICC_CTX *ICC_ctx)
 	  }
 	}
       }
+      /* A batch from one key must match the single calls */
+      if(ICC_OSSL_SUCCESS == rv) {
+	for(j = 0; j < 2; j++) {
+	  recs[j].Label = (unsigned char *)"ICC BVT";
+	  recs[j].Llen = 8;
+	  recs[j].Context = buffer + (j*alglist[i].keylen);
+	  recs[j].Clen = alglist[i].keylen;
+	  recs[j].K0 = bkeys[j];
+	  recs[j].L = alglist[i].keylen;
+	  recs[j].rv = 0;
+	}
+	srv = ICC_SP800_108_KDF_Batch(ICC_ctx,kdf,
+				      buffer,alglist[i].keylen,recs,2);
+	for(j = 0; (1 == srv) && (j < 2); j++) {
+	  ICC_SP800_108_KDF(ICC_ctx,kdf,buffer,alglist[i].keylen,
+			    recs[j].Label,recs[j].Llen,
+			    recs[j].Context,recs[j].Clen,
+			    bkeys[2],recs[j].L);
+	  if((1 != recs[j].rv) || 
+	     memcmp(bkeys[j],bkeys[2],alglist[i].keylen) != 0) {
+	    srv = 0;
+	  }
+	}
+	if(1 != srv) {
+	  printf("SP800-108 KDF batch failed for algorithm %s\n",alglist[i].alg);
+	  rv = ICC_OSSL_FAILURE;
+	}
+      }
     }
     if(rv == ICC_OSSL_SUCCESS) {
       printf("SP800-108 PRNG tests sucessfully completed!\n");
@@ -2380,6 +3753,385 @@ int doKDFTest(ICC_CTX *ICC_ctx)
   return rv;
 }
 
+/*! @brief RFC 5869 HKDF test case, SHA-256 with a 22 byte 0x0b IKM */
+typedef struct {
+  const char *name;
+  const unsigned char *salt;
+  size_t saltlen;
+  const unsigned char *info;
+  size_t infolen;
+  unsigned char prk[32];
+  unsigned char okm[42];
+} HKDF_TEST;
+
+/*! @brief The HKDF context API, ICC_HKDF_CTX_..(), against RFC 5869 test cases 1 and 3
+  Both ways to key a context, from a PRK and by extracting into it, and a
+  second expand from the same context must give the same OKM
+  @return ICC_OSSL_SUCCESS, ICC_OSSL_FAILURE
+*/
+int doHKDFTest(ICC_CTX *ICC_ctx)
+{
+  static const unsigned char salt1[13] = {
+    0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,
+    0x08,0x09,0x0a,0x0b,0x0c
+  };
+  static const unsigned char info1[10] = {
+    0xf0,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,
+    0xf8,0xf9
+  };
+  static const HKDF_TEST tests[] = {
+    { "RFC 5869 A.1", salt1, sizeof(salt1), info1, sizeof(info1),
+      {
+        0x07,0x77,0x09,0x36,0x2c,0x2e,0x32,0xdf,
+        0x0d,0xdc,0x3f,0x0d,0xc4,0x7b,0xba,0x63,
+        0x90,0xb6,0xc7,0x3b,0xb5,0x0f,0x9c,0x31,
+        0x22,0xec,0x84,0x4a,0xd7,0xc2,0xb3,0xe5
+      },
+      {
+        0x3c,0xb2,0x5f,0x25,0xfa,0xac,0xd5,0x7a,
+        0x90,0x43,0x4f,0x64,0xd0,0x36,0x2f,0x2a,
+        0x2d,0x2d,0x0a,0x90,0xcf,0x1a,0x5a,0x4c,
+        0x5d,0xb0,0x2d,0x56,0xec,0xc4,0xc5,0xbf,
+        0x34,0x00,0x72,0x08,0xd5,0xb8,0x87,0x18,
+        0x58,0x65
+      }
+    },
+    /* No salt, no info */
+    { "RFC 5869 A.3", NULL, 0, NULL, 0,
+      {
+        0x19,0xef,0x24,0xa3,0x2c,0x71,0x7b,0x16,
+        0x7f,0x33,0xa9,0x1d,0x6f,0x64,0x8b,0xdf,
+        0x96,0x59,0x67,0x76,0xaf,0xdb,0x63,0x77,
+        0xac,0x43,0x4c,0x1c,0x29,0x3c,0xcb,0x04
+      },
+      {
+        0x8d,0xa4,0xe7,0x75,0xa5,0x63,0xc1,0x8f,
+        0x71,0x5f,0x80,0x2a,0x06,0x3c,0x5a,0x31,
+        0xb8,0xa1,0x1f,0x5c,0x5e,0xe1,0x87,0x9e,
+        0xc3,0x45,0x4e,0x5f,0x3c,0x73,0x8d,0x2d,
+        0x9d,0x20,0x13,0x95,0xfa,0xa4,0xb6,0x1a,
+        0x96,0xc8
+      }
+    }
+  };
+  int rv = ICC_OSSL_SUCCESS;
+  const ICC_EVP_MD *md = NULL;
+  ICC_HKDF_CTX *hctx = NULL;
+  unsigned char ikm[22];
+  unsigned char prk[64];
+  unsigned char okm[42];
+  size_t prklen = 0;
+  int i = 0;
+  int j = 0;
+
+  printf("Starting HKDF context unit tests...\n");
+  memset(ikm,0x0b,sizeof(ikm));
+  md = ICC_EVP_get_digestbyname(ICC_ctx,"SHA256");
+  hctx = ICC_HKDF_CTX_new(ICC_ctx);
+  if((NULL == md) || (NULL == hctx)) {
+    printf("\tHKDF context setup failed\n");
+    rv = ICC_OSSL_FAILURE;
+  }
+  for(i = 0; (ICC_OSSL_SUCCESS == rv) && (i < (int)(sizeof(tests)/sizeof(tests[0]))); i++) {
+    printf("\t%s\n",tests[i].name);
+    prklen = 0;
+    if((NULL == ICC_HKDF_Extract(ICC_ctx,md,tests[i].salt,tests[i].saltlen,ikm,sizeof(ikm),prk,&prklen)) ||
+       (sizeof(tests[i].prk) != prklen) || (0 != memcmp(prk,tests[i].prk,prklen))) {
+      printf("\t\tHKDF_Extract PRK wrong\n");
+      rv = ICC_OSSL_FAILURE;
+      break;
+    }
+    /* j = 0 keyed from the PRK, j = 1 extracted into the context */
+    for(j = 0; (ICC_OSSL_SUCCESS == rv) && (j < 2); j++) {
+      if(1 != ((0 == j) ? ICC_HKDF_CTX_Init(ICC_ctx,hctx,md,tests[i].prk,sizeof(tests[i].prk))
+                        : ICC_HKDF_CTX_Extract(ICC_ctx,hctx,md,tests[i].salt,tests[i].saltlen,
+                                               ikm,sizeof(ikm)))) {
+        printf("\t\tHKDF_CTX_%s failed\n",(0 == j) ? "Init" : "Extract");
+        rv = ICC_OSSL_FAILURE;
+        break;
+      }
+      /* Twice, the context must restart cleanly */
+      memset(okm,0,sizeof(okm));
+      if((okm != ICC_HKDF_CTX_Expand(ICC_ctx,hctx,tests[i].info,tests[i].infolen,okm,sizeof(okm))) ||
+         (0 != memcmp(okm,tests[i].okm,sizeof(okm)))) {
+        printf("\t\tHKDF_CTX_Expand OKM wrong\n");
+        rv = ICC_OSSL_FAILURE;
+      }
+      memset(okm,0,sizeof(okm));
+      if((okm != ICC_HKDF_CTX_Expand(ICC_ctx,hctx,tests[i].info,tests[i].infolen,okm,sizeof(okm))) ||
+         (0 != memcmp(okm,tests[i].okm,sizeof(okm)))) {
+        printf("\t\tHKDF_CTX_Expand OKM wrong on reuse\n");
+        rv = ICC_OSSL_FAILURE;
+      }
+    }
+  }
+  if(NULL != hctx) {
+    ICC_HKDF_CTX_free(ICC_ctx,hctx);
+  }
+  if(ICC_OSSL_SUCCESS == rv) {
+    printf("HKDF context tests sucessfully completed!\n");
+  }
+  return rv;
+}
+
+/*! @brief The TLS PRF context API, ICC_TLS_PRF_..(), TLS 1.2 PRF with SHA-256
+  The PRF against the widely used "test label" vector, whole and with the
+  seed split, then ICC_TLS_PRF_KeyBlock() against EVP_PKEY_TLS1_PRF output
+  @return ICC_OSSL_SUCCESS, ICC_OSSL_FAILURE
+*/
+int doTLSPRFTest(ICC_CTX *ICC_ctx)
+{
+  static const unsigned char secret[16] = {
+    0x9b,0xbe,0x43,0x6b,0xa9,0x40,0xf0,0x17,
+    0xb1,0x76,0x52,0x84,0x9a,0x71,0xdb,0x35
+  };
+  static const unsigned char seed[16] = {
+    0xa0,0xba,0x9f,0x93,0x6c,0xda,0x31,0x18,
+    0x27,0xa6,0xf7,0x96,0xff,0xd5,0x19,0x8c
+  };
+  static const unsigned char prf_kat[100] = {
+    0xe3,0xf2,0x29,0xba,0x72,0x7b,0xe1,0x7b,
+    0x8d,0x12,0x26,0x20,0x55,0x7c,0xd4,0x53,
+    0xc2,0xaa,0xb2,0x1d,0x07,0xc3,0xd4,0x95,
+    0x32,0x9b,0x52,0xd4,0xe6,0x1e,0xdb,0x5a,
+    0x6b,0x30,0x17,0x91,0xe9,0x0d,0x35,0xc9,
+    0xc9,0xa4,0x6b,0x4e,0x14,0xba,0xf9,0xaf,
+    0x0f,0xa0,0x22,0xf7,0x07,0x7d,0xef,0x17,
+    0xab,0xfd,0x37,0x97,0xc0,0x56,0x4b,0xab,
+    0x4f,0xbc,0x91,0x66,0x6e,0x9d,0xef,0x9b,
+    0x97,0xfc,0xe3,0x4f,0x79,0x67,0x89,0xba,
+    0xa4,0x80,0x82,0xd1,0x22,0xee,0x42,0xc5,
+    0xa7,0x2e,0x5a,0x51,0x10,0xff,0xf7,0x01,
+    0x87,0x34,0x7b,0x66
+  };
+  /* pms 00..2f, client random 40..5f, server random 80..9f */
+  static const unsigned char ms_kat[48] = {
+    0xa1,0xb3,0xc5,0x8f,0xbc,0xaf,0xdd,0x22,
+    0x3e,0xc0,0xa7,0x1e,0xfb,0xb1,0xf6,0xbe,
+    0x26,0x86,0x42,0xb5,0xce,0x2a,0xe0,0xa7,
+    0x0f,0x69,0x27,0x3c,0xd5,0xe3,0xaf,0x02,
+    0xec,0x67,0x5c,0xd9,0x02,0xda,0x4b,0x30,
+    0x79,0x93,0xa7,0xa6,0xe3,0xf3,0xc4,0x41
+  };
+  static const unsigned char kb_kat[40] = {
+    0x15,0x27,0xe9,0xa8,0x18,0xca,0xec,0x47,
+    0x42,0x9c,0xc8,0xa0,0xbb,0xbf,0xa3,0x42,
+    0x77,0x5f,0xde,0x4d,0xff,0x6f,0x7c,0x57,
+    0x44,0x92,0xa8,0x26,0xdd,0x8c,0xb3,0x35,
+    0xf1,0xb6,0xfb,0x44,0xa3,0x0a,0xcb,0x26
+  };
+  static const char label[] = "test label";
+  int rv = ICC_OSSL_SUCCESS;
+  const ICC_EVP_MD *md = NULL;
+  ICC_TLS_PRF_CTX *pctx = NULL;
+  unsigned char out[100];
+  unsigned char pms[48];
+  unsigned char crandom[32];
+  unsigned char srandom[32];
+  unsigned char master[48];
+  unsigned char keyblock[40];
+  int i = 0;
+
+  printf("Starting TLS PRF context unit tests...\n");
+  md = ICC_EVP_get_digestbyname(ICC_ctx,"SHA256");
+  pctx = ICC_TLS_PRF_CTX_new(ICC_ctx);
+  if((NULL == md) || (NULL == pctx) ||
+     (1 != ICC_TLS_PRF_Init(ICC_ctx,pctx,md,secret,sizeof(secret)))) {
+    printf("\tTLS PRF context setup failed\n");
+    rv = ICC_OSSL_FAILURE;
+  }
+  if(ICC_OSSL_SUCCESS == rv) {
+    memset(out,0x55,sizeof(out));
+    if((1 != ICC_TLS_PRF_Derive(ICC_ctx,pctx,(const unsigned char *)label,sizeof(label) - 1,
+                                seed,sizeof(seed),NULL,0,out,sizeof(out))) ||
+       (0 != memcmp(out,prf_kat,sizeof(out)))) {
+      printf("\tTLS 1.2 PRF SHA-256 wrong\n");
+      rv = ICC_OSSL_FAILURE;
+    }
+  }
+  /* Same context again, seed in two parts */
+  if(ICC_OSSL_SUCCESS == rv) {
+    memset(out,0x55,sizeof(out));
+    if((1 != ICC_TLS_PRF_Derive(ICC_ctx,pctx,(const unsigned char *)label,sizeof(label) - 1,
+                                seed,5,seed + 5,sizeof(seed) - 5,out,sizeof(out))) ||
+       (0 != memcmp(out,prf_kat,sizeof(out)))) {
+      printf("\tTLS 1.2 PRF SHA-256 wrong with a split seed\n");
+      rv = ICC_OSSL_FAILURE;
+    }
+  }
+  if(ICC_OSSL_SUCCESS == rv) {
+    for(i = 0; i < (int)sizeof(pms); i++) {
+      pms[i] = (unsigned char)i;
+    }
+    for(i = 0; i < (int)sizeof(crandom); i++) {
+      crandom[i] = (unsigned char)(0x40 + i);
+      srandom[i] = (unsigned char)(0x80 + i);
+    }
+    if((1 != ICC_TLS_PRF_KeyBlock(ICC_ctx,pctx,md,pms,sizeof(pms),crandom,srandom,NULL,0,
+                                  master,keyblock,sizeof(keyblock))) ||
+       (0 != memcmp(master,ms_kat,sizeof(master))) ||
+       (0 != memcmp(keyblock,kb_kat,sizeof(keyblock)))) {
+      printf("\tTLS PRF key block wrong\n");
+      rv = ICC_OSSL_FAILURE;
+    }
+  }
+  if(NULL != pctx) {
+    ICC_TLS_PRF_CTX_free(ICC_ctx,pctx);
+  }
+  if(ICC_OSSL_SUCCESS == rv) {
+    printf("TLS PRF context tests sucessfully completed!\n");
+  }
+  return rv;
+}
+
+/*! @brief Read the signature verification cache counts
+  @param ICC_ctx the ICC context
+  @param c the counts
+*/
+static void vc_counts(ICC_CTX *ICC_ctx,ICC_VERIFY_CACHE_COUNTS *c)
+{
+  ICC_STATUS stat;
+
+  memset(c,0,sizeof(ICC_VERIFY_CACHE_COUNTS));
+  ICC_GetValue(ICC_ctx,&stat,ICC_VERIFY_CACHE_STATS,c,sizeof(ICC_VERIFY_CACHE_COUNTS));
+}
+
+/*! @brief The signature verification cache, ICC_VERIFY_CACHE
+  A verify answered from the cache gives the same result as the first,
+  uncached, one. Bad signatures are never stored or served. Overfilling
+  the cache evicts entries and every signature still verifies. The cache
+  counts are only checked if ICC_VERIFY_CACHE is set, i.e. icctest 30
+  with ICC_VERIFY_CACHE=64, the results are checked either way
+  @return ICC_OSSL_SUCCESS, ICC_OSSL_FAILURE
+*/
+int doVerifyCacheTest(ICC_CTX *ICC_ctx)
+{
+  int rv = ICC_OSSL_SUCCESS;
+  ICC_RSA *rsa = NULL;
+  ICC_VERIFY_CACHE_COUNTS c0, c1;
+  unsigned char dgst[32];
+  unsigned char *sigs = NULL;
+  unsigned int slen = 0;
+  int ssize = 0;
+  int nid = 0;
+  int on = 0;
+  int n = 0;
+  int i = 0;
+  int pass = 0;
+
+  printf("Starting signature verification cache unit test...\n");
+  vc_counts(ICC_ctx,&c0);
+  on = (0 != c0.entries);
+  if(!on) {
+    printf("\tICC_VERIFY_CACHE is off, the cache counts aren't checked\n");
+  } else {
+    printf("\tICC_VERIFY_CACHE %llu entries\n",c0.entries);
+  }
+  /* Fill it three times over, if it's a sensible size */
+  n = (on && (c0.entries <= 256)) ? (int)(3 * c0.entries) : 8;
+  nid = ICC_OBJ_txt2nid(ICC_ctx,"SHA256");
+  rsa = ICC_RSA_generate_key(ICC_ctx,2048,0x10001,NULL,NULL);
+  if(NULL != rsa) {
+    ssize = ICC_RSA_size(ICC_ctx,rsa);
+    sigs = (unsigned char *)calloc(n,ssize);
+  }
+  if((NULL == rsa) || (NULL == sigs)) {
+    printf("\tsetup failed\n");
+    rv = ICC_OSSL_FAILURE;
+  }
+  for(i = 0; (ICC_OSSL_SUCCESS == rv) && (i < n); i++) {
+    memset(dgst,0x5a,sizeof(dgst));
+    dgst[0] = (unsigned char)(i >> 8);
+    dgst[1] = (unsigned char)i;
+    if((ICC_OSSL_SUCCESS != ICC_RSA_sign(ICC_ctx,nid,dgst,sizeof(dgst),sigs + i * ssize,&slen,rsa)) ||
+       ((int)slen != ssize)) {
+      printf("\tRSA_sign failed\n");
+      rv = ICC_OSSL_FAILURE;
+    }
+  }
+  /* Same signature twice, uncached then cached */
+  if(ICC_OSSL_SUCCESS == rv) {
+    memset(dgst,0x5a,sizeof(dgst));
+    dgst[0] = 0;
+    dgst[1] = 0;
+    vc_counts(ICC_ctx,&c0);
+    if(ICC_OSSL_SUCCESS != ICC_RSA_verify(ICC_ctx,nid,dgst,sizeof(dgst),sigs,ssize,rsa)) {
+      printf("\tfirst verify failed\n");
+      rv = ICC_OSSL_FAILURE;
+    }
+    vc_counts(ICC_ctx,&c1);
+    if(on && ((c1.stored != c0.stored + 1) || (c1.hits != c0.hits))) {
+      printf("\tfirst verify wasn't stored\n");
+      rv = ICC_OSSL_FAILURE;
+    }
+    if(ICC_OSSL_SUCCESS != ICC_RSA_verify(ICC_ctx,nid,dgst,sizeof(dgst),sigs,ssize,rsa)) {
+      printf("\tcached verify failed\n");
+      rv = ICC_OSSL_FAILURE;
+    }
+    vc_counts(ICC_ctx,&c0);
+    if(on && (c0.hits != c1.hits + 1)) {
+      printf("\tsecond verify wasn't a cache hit\n");
+      rv = ICC_OSSL_FAILURE;
+    }
+  }
+  /* A damaged signature, or the good one on another digest, fails every
+     time and is neither served from nor added to the cache 
+  */
+  for(pass = 0; (ICC_OSSL_SUCCESS == rv) && (pass < 2); pass++) {
+    vc_counts(ICC_ctx,&c0);
+    sigs[ssize - 1] ^= 0x01;
+    i = ICC_RSA_verify(ICC_ctx,nid,dgst,sizeof(dgst),sigs,ssize,rsa);
+    sigs[ssize - 1] ^= 0x01;
+    dgst[31] ^= 0x01;
+    if((ICC_OSSL_SUCCESS == i) ||
+       (ICC_OSSL_SUCCESS == ICC_RSA_verify(ICC_ctx,nid,dgst,sizeof(dgst),sigs,ssize,rsa))) {
+      printf("\ttampered signature verified\n");
+      rv = ICC_OSSL_FAILURE;
+    }
+    dgst[31] ^= 0x01;
+    vc_counts(ICC_ctx,&c1);
+    if(on && ((c1.hits != c0.hits) || (c1.stored != c0.stored))) {
+      printf("\ttampered signature went through the cache\n");
+      rv = ICC_OSSL_FAILURE;
+    }
+  }
+  /* Overfill it, twice round, then damage them all */
+  for(pass = 0; (ICC_OSSL_SUCCESS == rv) && (pass < 3); pass++) {
+    for(i = 0; (ICC_OSSL_SUCCESS == rv) && (i < n); i++) {
+      memset(dgst,0x5a,sizeof(dgst));
+      dgst[0] = (unsigned char)(i >> 8);
+      dgst[1] = (unsigned char)i;
+      if(2 == pass) {
+        sigs[i * ssize + 7] ^= 0x80;
+      }
+      if((2 == pass) == 
+         (ICC_OSSL_SUCCESS == ICC_RSA_verify(ICC_ctx,nid,dgst,sizeof(dgst),sigs + i * ssize,ssize,rsa))) {
+        printf("\tsignature %d wrong with the cache full, pass %d\n",i,pass);
+        rv = ICC_OSSL_FAILURE;
+      }
+    }
+  }
+  vc_counts(ICC_ctx,&c1);
+  if((ICC_OSSL_SUCCESS == rv) && on && (c0.entries <= 256) && (0 == c1.evicted)) {
+    printf("\tnothing evicted filling the cache\n");
+    rv = ICC_OSSL_FAILURE;
+  }
+  if(on) {
+    printf("\t%llu hits %llu misses %llu stored %llu evicted\n",
+           c1.hits,c1.misses,c1.stored,c1.evicted);
+  }
+  if(NULL != sigs) {
+    free(sigs);
+  }
+  if(NULL != rsa) {
+    ICC_RSA_free(ICC_ctx,rsa);
+  }
+  if(ICC_OSSL_SUCCESS == rv) {
+    printf("Signature verification cache tests sucessfully completed!\n");
+  }
+  return rv;
+}
+
 /*!
   @brief do a common subset of the PKCS#8 operations
   - convert an ICC_EVP_PKEY to ICC_PKCS8_PRIV_KEY_INFO
@@ -2528,6 +4280,158 @@ int doPKCS8Test(ICC_CTX *ICC_ctx)
   
   return rc;
 }
+/*! @brief sleep for a few milliseconds, for tests waiting on another thread */
+static void test_sleep(int ms)
+{
+#if defined(_WIN32)
+  Sleep(ms);
+#else
+  usleep(ms * 1000);
+#endif
+}
+
+#define EC_POOL_TEST_KEYS 4 /*!< Keys drawn in a row by doECKeyPoolTest() */
+
+/*! @brief Make a P-256 key through EVP_PKEY_keygen(), which ICC_EC_KEY_POOL serves
+  @param ICC_ctx the ICC context
+  @param cctx a keygen context on P-256
+  @param pub the uncompressed public key (output), 65 bytes
+  @return 1 if a key was made and passed EC_KEY_check_key()
+*/
+static int ecpool_key(ICC_CTX *ICC_ctx,ICC_EVP_PKEY_CTX *cctx,unsigned char *pub)
+{
+  int rv = 0;
+  ICC_EVP_PKEY *pk = NULL;
+  ICC_EC_KEY *ec = NULL;
+  unsigned char *p = pub;
+
+  if((1 == ICC_EVP_PKEY_keygen(ICC_ctx,cctx,&pk)) && (NULL != pk)) {
+    ec = ICC_EVP_PKEY_get1_EC_KEY(ICC_ctx,pk);
+    if((NULL != ec) && (1 == ICC_EC_KEY_check_key(ICC_ctx,ec)) &&
+       (65 == ICC_i2o_ECPublicKey(ICC_ctx,ec,NULL)) &&
+       (65 == ICC_i2o_ECPublicKey(ICC_ctx,ec,&p))) {
+      rv = 1;
+    }
+  }
+  if(NULL != ec) {
+    ICC_EC_KEY_free(ICC_ctx,ec);
+  }
+  if(NULL != pk) {
+    ICC_EVP_PKEY_free(ICC_ctx,pk);
+  }
+  return rv;
+}
+
+/*! @brief The ephemeral key pool, ICC_EC_KEY_POOL
+  Keys from EVP_PKEY_keygen() pass EC_KEY_check_key() and are all 
+  different, and a fork()ed child doesn't get a key still pooled in the 
+  parent. Meaningful with the pool on, i.e. icctest 31 with 
+  ICC_EC_KEY_POOL=4, the checks hold either way
+  @return ICC_OSSL_SUCCESS, ICC_OSSL_FAILURE
+*/
+int doECKeyPoolTest(ICC_CTX *ICC_ctx)
+{
+  int rv = ICC_OSSL_SUCCESS;
+  ICC_EVP_PKEY *params = NULL;
+  ICC_EC_KEY *ec = NULL;
+  ICC_EVP_PKEY_CTX *cctx = NULL;
+  unsigned char pubs[EC_POOL_TEST_KEYS][65];
+  int i = 0;
+  int j = 0;
+
+  printf("Starting EC key pool unit test...\n");
+  printf("\tICC_EC_KEY_POOL %s\n",
+         (NULL != getenv("ICC_EC_KEY_POOL")) ? getenv("ICC_EC_KEY_POOL") : "off");
+  ec = ICC_EC_KEY_new_by_curve_name(ICC_ctx,ICC_OBJ_txt2nid(ICC_ctx,"prime256v1"));
+  params = ICC_EVP_PKEY_new(ICC_ctx);
+  if((NULL == ec) || (NULL == params) || (1 != ICC_EVP_PKEY_set1_EC_KEY(ICC_ctx,params,ec)) ||
+     (NULL == (cctx = ICC_EVP_PKEY_CTX_new(ICC_ctx,params,NULL))) ||
+     (1 != ICC_EVP_PKEY_keygen_init(ICC_ctx,cctx))) {
+    printf("\tsetup failed\n");
+    rv = ICC_OSSL_FAILURE;
+  }
+  /* The first keygen registers the curve, give the worker time to fill it */
+  if((ICC_OSSL_SUCCESS == rv) && (1 != ecpool_key(ICC_ctx,cctx,pubs[0]))) {
+    printf("\tkeygen failed\n");
+    rv = ICC_OSSL_FAILURE;
+  }
+  test_sleep(200);
+  for(i = 0; (ICC_OSSL_SUCCESS == rv) && (i < EC_POOL_TEST_KEYS); i++) {
+    if(1 != ecpool_key(ICC_ctx,cctx,pubs[i])) {
+      printf("\tkey %d failed EC_KEY_check_key()\n",i);
+      rv = ICC_OSSL_FAILURE;
+    }
+    for(j = 0; (ICC_OSSL_SUCCESS == rv) && (j < i); j++) {
+      if(0 == memcmp(pubs[i],pubs[j],sizeof(pubs[i]))) {
+        printf("\tkeys %d and %d are the same\n",j,i);
+        rv = ICC_OSSL_FAILURE;
+      }
+    }
+  }
+#if !defined(_WIN32)
+  /* Refilled, the child's key must not be one the parent's pool holds,
+     the parent gets those from the top of it's pool next
+  */
+  test_sleep(200);
+  if (ICC_OSSL_SUCCESS == rv) {
+    int fds[2];
+    pid_t pid = -1;
+    unsigned char cpub[65];
+
+    if (0 == pipe(fds)) {
+      pid = fork();
+      if (0 == pid) {
+        if ((1 != ecpool_key(ICC_ctx, cctx, cpub)) ||
+            ((ssize_t)sizeof(cpub) != write(fds[1], cpub, sizeof(cpub)))) {
+          _exit(1);
+        }
+        _exit(0);
+      }
+      close(fds[1]);
+      if (pid > 0) {
+        for (i = 0; (ICC_OSSL_SUCCESS == rv) && (i < EC_POOL_TEST_KEYS); i++) {
+          if (1 != ecpool_key(ICC_ctx, cctx, pubs[i])) {
+            printf("\tkeygen after fork() failed\n");
+            rv = ICC_OSSL_FAILURE;
+          }
+        }
+        if ((ssize_t)sizeof(cpub) != read(fds[0], cpub, sizeof(cpub))) {
+          printf("\tkeygen in the fork() child failed\n");
+          rv = ICC_OSSL_FAILURE;
+        }
+        for (i = 0; (ICC_OSSL_SUCCESS == rv) && (i < EC_POOL_TEST_KEYS); i++) {
+          if (0 == memcmp(pubs[i], cpub, sizeof(cpub))) {
+            printf("\tfork() child was given a key from the parent's pool\n");
+            rv = ICC_OSSL_FAILURE;
+          }
+        }
+        waitpid(pid, NULL, 0);
+      }
+      close(fds[0]);
+    }
+  }
+#endif
+  if(NULL != cctx) {
+    ICC_EVP_PKEY_CTX_free(ICC_ctx,cctx);
+  }
+  if(NULL != params) {
+    ICC_EVP_PKEY_free(ICC_ctx,params);
+  }
+  if(NULL != ec) {
+    ICC_EC_KEY_free(ICC_ctx,ec);
+  }
+  if(ICC_OSSL_SUCCESS == rv) {
+    printf("EC key pool tests sucessfully completed!\n");
+  }
+  return rv;
+}
+
+/*! @brief ICC_TryGenerateRandomSeed() callback, counts the calls */
+static void seed_ready_cb(void *arg)
+{
+  (*(volatile int *)arg)++;
+}
+
 /*!
   @brief
   Test the behaviour of ICC_GenerateRandomSeed() when an error is forced
@@ -2540,8 +4444,10 @@ int doGenerateRandomTest(ICC_CTX *ICC_ctx)
 {
   int rc = ICC_OSSL_SUCCESS;
   int retcode = ICC_OSSL_SUCCESS;
+  int i = 0;
   char buffer[80];
   char buffer1[80];
+  volatile int seed_cb_count = 0;
   ICC_STATUS status;
   printf("ICC_GenerateRandomSeed() test\n");
   memset(&status,0,sizeof(status));
@@ -2557,6 +4463,46 @@ int doGenerateRandomTest(ICC_CTX *ICC_ctx)
   if((0 == memcmp(buffer,buffer1,sizeof(buffer))) ) {
     rc = ICC_OSSL_FAILURE;
   }
+  /* Non-blocking variant, it's allowed to ask us to come back later,
+     but then it has to call back, once, and the retry has to work
+  */
+  memset(buffer,0,sizeof(buffer));
+  retcode = ICC_TryGenerateRandomSeed(ICC_ctx,&status,sizeof(buffer),buffer,
+                                      seed_ready_cb,(void *)&seed_cb_count);
+  if(ICC_SEED_WOULDBLOCK == retcode) {
+    for(i = 0; (i < 1000) && (0 == seed_cb_count); i++) {
+      test_sleep(10);
+    }
+    test_sleep(10); /* Long enough to catch a second call */
+    if(1 != seed_cb_count) {
+      printf("ICC_TryGenerateRandomSeed() callback ran %d times, expected once\n",seed_cb_count);
+      rc = ICC_OSSL_FAILURE;
+    }
+    memset(&status,0,sizeof(status));
+    retcode = ICC_TryGenerateRandomSeed(ICC_ctx,&status,sizeof(buffer),buffer,NULL,NULL);
+  } else {
+    test_sleep(10);
+    if(0 != seed_cb_count) {
+      printf("ICC_TryGenerateRandomSeed() callback ran, but the seed was returned\n");
+      rc = ICC_OSSL_FAILURE;
+    }
+  }
+  if(ICC_SEED_READY != retcode) {
+    printf("ICC_TryGenerateRandomSeed() returned %d, expected ICC_SEED_READY\n",retcode);
+    check_status(&status,__FILE__,__LINE__);
+    rc = ICC_OSSL_FAILURE;
+  } else if(0 == memcmp(buffer,buffer1,sizeof(buffer))) {
+    rc = ICC_OSSL_FAILURE;
+  }
+  /* And blocking calls still work after the helper's been and gone */
+  memset(&status,0,sizeof(status));
+  memset(buffer,0,sizeof(buffer));
+  ICC_GenerateRandomSeed(ICC_ctx,&status,sizeof(buffer),buffer);
+  if((ICC_OK != status.majRC) || (0 == memcmp(buffer,buffer1,sizeof(buffer)))) {
+    printf("ICC_GenerateRandomSeed() failed after ICC_TryGenerateRandomSeed()\n");
+    check_status(&status,__FILE__,__LINE__);
+    rc = ICC_OSSL_FAILURE;
+  }
   return rc;
 }
 
@@ -2574,7 +4520,11 @@ int doKWTest(ICC_CTX *ICC_ctx)
   unsigned char key[16] =  {1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16};
   unsigned char out[48];
   unsigned char test1[32];
+  unsigned char out1[48];
   int outl = 0;
+  int outl1 = 0;
+  ICC_SP800_38F_CTX *kwctx = NULL;
+  ICC_SP800_38F_REC recs[2];
 
 
 
@@ -2622,7 +4572,38 @@ int doKWTest(ICC_CTX *ICC_ctx)
       printf("KWDP/KUDP error\n");
       rv = 1;
     }
-
+    /* Reusable context, the same result as the one shot and in place */
+    kwctx = ICC_SP800_38F_CTX_new(ICC_ctx);
+    if((NULL == kwctx) || 
+       (1 != ICC_SP800_38F_CTX_Init(ICC_ctx,kwctx,key,128))) {
+      printf("ICC_SP800_38F_CTX_Init() error\n");
+      rv = ICC_OSSL_FAILURE;
+    } else {
+      ICC_SP800_38F_KW(ICC_ctx,test,32,out,&outl,key,128,ICC_KW_WRAP | ICC_KW_PAD);
+      memcpy(out1,test,32);
+      if((1 != ICC_SP800_38F_KW_CTX(ICC_ctx,kwctx,out1,32,out1,&outl1,ICC_KW_WRAP | ICC_KW_PAD)) ||
+	 (outl1 != outl) || (0 != memcmp(out,out1,outl))) {
+	printf("KWCTX error\n");
+	rv = ICC_OSSL_FAILURE;
+      }
+      /* Batch unwrap, one good, one corrupted */
+      out[3] ^= 1;
+      recs[0].in = out1;
+      recs[0].inl = outl1;
+      recs[0].out = out1;
+      recs[1].in = out;
+      recs[1].inl = outl;
+      recs[1].out = test1;
+      if((2 != ICC_SP800_38F_KW_Batch(ICC_ctx,kwctx,recs,2,ICC_KW_PAD)) ||
+	 (1 != recs[0].rv) || (32 != recs[0].outl) || 
+	 (0 != memcmp(out1,test,32)) || (2 != recs[1].rv)) {
+	printf("KW Batch error\n");
+	rv = ICC_OSSL_FAILURE;
+      }
+    }
+    if(NULL != kwctx) {
+      ICC_SP800_38F_CTX_free(ICC_ctx,kwctx);
+    }
   
     if(rv == ICC_OSSL_SUCCESS) {
       printf("ICC_SP800_38F_KW() tests successfully completed!\n");
@@ -2658,6 +4639,18 @@ int ProbeInt(ICC_CTX *icc_ctx,ICC_VALUE_IDS_ENUM e)
   case ICC_SHIFT:
     tag = "ICC_SHIFT";
     break;
+  case ICC_TRNG_FAILOVERS:
+    tag = "ICC_TRNG_FAILOVERS";
+    break;
+  case ICC_PBKDF2_THREADS:
+    tag = "ICC_PBKDF2_THREADS";
+    break;
+  case ICC_CTX_CACHE:
+    tag = "ICC_CTX_CACHE";
+    break;
+  case ICC_MEM_PROFILE:
+    tag = "ICC_MEM_PROFILE";
+    break;
   default:
     break;
   }
@@ -2692,6 +4685,9 @@ int ProbeStr(ICC_CTX *icc_ctx,ICC_VALUE_IDS_ENUM e)
   case ICC_INSTALL_PATH:
     tag = "ICC_INSTALL_PATH";
     break;
+  case ICC_CPU_FEATURES:
+    tag = "ICC_CPU_FEATURES";
+    break;
   default:
     break;
   }
@@ -2719,6 +4715,11 @@ int doConfigProbes(ICC_CTX *icc_ctx)
   if(version > 8.05) {
     ProbeInt(icc_ctx,ICC_SHIFT);
     ProbeInt(icc_ctx,ICC_LOOPS);
+    ProbeInt(icc_ctx,ICC_TRNG_FAILOVERS);
+    ProbeInt(icc_ctx,ICC_PBKDF2_THREADS);
+    ProbeInt(icc_ctx,ICC_CTX_CACHE);
+    ProbeInt(icc_ctx,ICC_MEM_PROFILE);
+    ProbeInt(icc_ctx,ICC_API_STATS);
   }
   return ICC_OSSL_SUCCESS;
 }
@@ -3075,6 +5076,48 @@ int runTest(ICC_CTX *ICC_ctx,ICC_STATUS *status,int testnum)
       testnum = -1;
     } else testnum++;
     break;
+  case 25:
+    if(doCHACHA_POLYUnitTest(ICC_ctx) != ICC_OSSL_SUCCESS) {
+      printf("ChaCha20-Poly1305 unit test failed!\n");
+      testnum = -1;
+    } else testnum++;
+    break;
+  case 26:
+    if(doPBKDF2UnitTest(ICC_ctx) != ICC_OSSL_SUCCESS) {
+      printf("PBKDF2 unit test failed!\n");
+      testnum = -1;
+    } else testnum++;
+    break;
+  case 27:
+    if(doAES_XTSUnitTest(ICC_ctx) != ICC_OSSL_SUCCESS) {
+      printf("AES_XTS unit test failed!\n");
+      testnum = -1;
+    } else testnum++;
+    break;
+  case 28:
+    if(doHKDFTest(ICC_ctx) != ICC_OSSL_SUCCESS) {
+      printf("HKDF context unit test failed!\n");
+      testnum = -1;
+    } else testnum++;
+    break;
+  case 29:
+    if(doTLSPRFTest(ICC_ctx) != ICC_OSSL_SUCCESS) {
+      printf("TLS PRF context unit test failed!\n");
+      testnum = -1;
+    } else testnum++;
+    break;
+  case 30:
+    if(doVerifyCacheTest(ICC_ctx) != ICC_OSSL_SUCCESS) {
+      printf("Signature verification cache unit test failed!\n");
+      testnum = -1;
+    } else testnum++;
+    break;
+  case 31:
+    if(doECKeyPoolTest(ICC_ctx) != ICC_OSSL_SUCCESS) {
+      printf("EC key pool unit test failed!\n");
+      testnum = -1;
+    } else testnum++;
+    break;
   default:
     testnum = 0;
     break;
@@ -3153,6 +5196,7 @@ int doPreInit() {
 int doPostStartupTest(ICC_CTX *ICC_ctx, ICC_STATUS *status) {
   int rv = ICC_OK;
   int retcode;
+  int i = 0;
   char value[ICC_VALUESIZE];
   char value1[9]; /* Deliberately broken */
 
@@ -3201,6 +5245,23 @@ int doPostStartupTest(ICC_CTX *ICC_ctx, ICC_STATUS *status) {
       printf("SelfTest failed\n");
       rv = ICC_ERROR;
     }
+    if (ICC_OK == rv) {
+      /* One pass of the round robin, then an explicit subset */
+      for (i = 0; (i < ICC_KAT_GROUPS) && (ICC_OK == rv); i++) {
+        retcode = ICC_SelfTestGroup(ICC_ctx, status, ICC_KAT_NEXT);
+        if (ICC_OSSL_SUCCESS != retcode) {
+          printf("SelfTestGroup(ICC_KAT_NEXT) failed\n");
+          rv = ICC_ERROR;
+        }
+      }
+      if (ICC_OK == rv) {
+        retcode = ICC_SelfTestGroup(ICC_ctx, status, ICC_KAT_CORE | ICC_KAT_CIPHER);
+        if (ICC_OSSL_SUCCESS != retcode) {
+          printf("SelfTestGroup(ICC_KAT_CORE | ICC_KAT_CIPHER) failed\n");
+          rv = ICC_ERROR;
+        }
+      }
+    }
     if (ICC_OK == rv) {
       retcode = ICC_SetValue(ICC_ctx, status, ICC_RANDOM_GENERATOR,
                              (char *)"HMAC-SHA256");
@@ -3545,12 +5606,13 @@ int doUnitTest(int test,char *fips, int unicode)
 }
 static void usage(char *prgname,char *text)
 {
-  printf("Usage: %s [n]/[-u]/[-h]\n",prgname);
+  printf("Usage: %s [n]/[-u]/[-l]/[-h]\n",prgname);
   printf("       %s runs the ICC BVT tests, this covers most of the API\n",prgname
 	 );
   printf("           note that correct usage of the ICC API is not guaranteed\n");
   printf("       n = a single test number to run\n");
   printf("       -u<nicode> start ICC with a Unicode path (Windows only)\n");
+  printf("       -l also run the long tests (GCM IV generator exhaustion)\n");
   printf("       -h this text\n");
   if(NULL != text) {
     printf("\n%s\n",text);
@@ -3569,6 +5631,8 @@ int main(int argc, char *argv[])
   while(argc > argi  ) {
     if(strncmp("-u",argv[argi],2) == 0) {
       unicode = 1;;
+    } else if(strncmp("-l",argv[argi],2) == 0) {
+      long_tests = 1;
     } else if(strncmp("-h",argv[argi],2) == 0) {
       usage(argv[0],NULL);
       exit(0);
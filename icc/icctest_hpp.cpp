@@ -0,0 +1,116 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Unit test for the C++17 binding, icc.hpp
+//
+*************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "icc.hpp"
+
+static int check(bool ok, const char *what)
+{
+  if(!ok) {
+    std::printf("FAILURE: %s\n", what);
+  }
+  return ok ? 0 : 1;
+}
+
+/*! @brief AES-GCM seal/open round trip, then a tampered tag and a tampered ciphertext
+  @return the number of failures
+*/
+static int doGCMTest(icc::context &c)
+{
+  static const unsigned char key[32] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+  };
+  static const unsigned char iv[12] = {
+    0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88
+  };
+  static const char aad[] = "header";
+  static const char msg[] = "The quick brown fox jumps over the lazy dog";
+  const std::size_t mlen = sizeof(msg) - 1;
+  std::vector<unsigned char> ct(mlen + icc::gcm_tag_len);
+  std::vector<unsigned char> pt(mlen);
+  std::size_t n = 0;
+  std::size_t ptlen = 0;
+  int fails = 0;
+
+  std::printf("C++ AES-GCM test\n");
+  icc::gcm_ctx g(c);
+
+  n = g.seal(key, iv, icc::bytes_view(aad, sizeof(aad) - 1), icc::bytes_view(msg, mlen), ct);
+  fails += check(n == ct.size(), "seal length");
+  fails += check(0 != std::memcmp(ct.data(), msg, mlen), "seal didn't encrypt");
+
+  /* A second context and an explicit key */
+  icc::gcm_ctx g2(c);
+  fails += check(g2.open(key, iv, icc::bytes_view(aad, sizeof(aad) - 1), ct, pt, ptlen), "open");
+  fails += check((ptlen == mlen) && (0 == std::memcmp(pt.data(), msg, mlen)), "open plaintext");
+
+  /* Kept key, the IV has to change, a repeat is refused and that's thrown, not a mismatch */
+  try {
+    g.open(icc::bytes_view(), iv, icc::bytes_view(aad, sizeof(aad) - 1), ct, pt, ptlen);
+    fails += check(false, "open, repeated IV didn't throw");
+  } catch(const icc::error &) {
+  }
+
+  /* Bad tag, false and not a throw, no plaintext left behind */
+  ct[ct.size() - 1] ^= 0x01;
+  std::memset(pt.data(), 0xaa, pt.size());
+  fails += check(!g2.open(key, iv, icc::bytes_view(aad, sizeof(aad) - 1), ct, pt, ptlen), "open, bad tag");
+  fails += check(0 == ptlen, "open, bad tag length");
+  fails += check(std::vector<unsigned char>(pt.size(), 0) == pt, "open, bad tag cleared");
+  ct[ct.size() - 1] ^= 0x01;
+
+  /* Bad ciphertext */
+  ct[0] ^= 0x80;
+  fails += check(!g2.open(key, iv, icc::bytes_view(aad, sizeof(aad) - 1), ct, pt, ptlen), "open, bad data");
+  ct[0] ^= 0x80;
+
+  /* Bad aad */
+  fails += check(!g2.open(key, iv, icc::bytes_view("HEADER", 6), ct, pt, ptlen), "open, bad aad");
+
+  /* And the context is still usable after a mismatch */
+  fails += check(g2.open(key, iv, icc::bytes_view(aad, sizeof(aad) - 1), ct, pt, ptlen), "open after mismatch");
+
+  /* A key length the C API won't take is thrown, not reported as a mismatch */
+  try {
+    g2.open(icc::bytes_view(key, 7), iv, icc::bytes_view(aad, sizeof(aad) - 1), ct, pt, ptlen);
+    fails += check(false, "open, bad key length didn't throw");
+  } catch(const icc::error &) {
+  }
+  return fails;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *path = NULL;
+  int fails = 0;
+
+#if !defined(ICCPKG)
+  path = "../package";
+#endif
+  if(argc > 1) {
+    path = argv[1];
+  }
+  try {
+    icc::context c(path);
+    fails += doGCMTest(c);
+  } catch(const icc::error &e) {
+    std::printf("FAILURE: %s\n", e.what());
+    fails++;
+  }
+  std::printf("C++ binding tests %s\n", (0 == fails) ? "passed" : "FAILED");
+  return (0 == fails) ? 0 : 1;
+}
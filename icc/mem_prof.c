@@ -0,0 +1,385 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*
+  Sampled allocation accounting by call site, ICC_MEM_PROFILE=n.
+
+  CRYPTO_malloc() already hands the allocator the file and line of the
+  caller, this layer sits behind it, on top of either the slab allocator
+  or the system allocator, and counts 1 in n allocations against their
+  call site.
+
+  - Every block carries a 16 byte header with it's size and the site it
+    was counted against, 0 if it wasn't sampled. Frees and reallocs of a
+    sampled block are always counted, so live bytes stay exact for the
+    sampled blocks whichever thread frees them.
+  - Sites live in one fixed size open addressed table, keyed on the
+    file pointer and line. Slots are claimed with a compare and swap and
+    the counters are atomic adds, no locks anywhere. When the table is
+    full further sites are counted in slot 0, "(other)".
+  - The sampling countdown is per thread.
+  - ICC_GetValue(ICC_MEM_SITES) returns the sites, largest live bytes
+    first, with the counts scaled back up by n. The numbers are
+    estimates unless n is 1.
+  - ICC_SetValue(ICC_MEM_PROFILE) pauses (0) and resumes recording.
+    ICC_MemCheck_start()/ICC_MemCheck_stop() in the wrapper do the same.
+
+  Like the slab allocator this has to be installed while ICC loads,
+  before OpenSSL's first allocation. Platforms without 64 bit atomics
+  don't profile.
+*/
+
+#if defined(__GNUC__) && defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && (2 == __GCC_ATOMIC_LLONG_LOCK_FREE) \
+  && defined(__GCC_ATOMIC_POINTER_LOCK_FREE) && (2 == __GCC_ATOMIC_POINTER_LOCK_FREE)
+#define PROF_ATOMICS
+#define PROF_ADD(p, v) __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#define PROF_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define PROF_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define PROF_CASP(p, o, n) __atomic_compare_exchange_n((p), &(o), (n), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define PROF_CAS64(p, o, n) __atomic_compare_exchange_n((p), &(o), (n), 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#elif defined(_WIN64)
+#define PROF_ATOMICS
+#define PROF_ADD(p, v) ((unsigned long long)InterlockedAdd64((LONG64 volatile *)(p), (LONG64)(v)))
+#define PROF_LOAD(p) (*(p))
+#define PROF_STORE(p, v) InterlockedExchange((LONG volatile *)(p), (LONG)(v))
+#define PROF_CASP(p, o, n) ((o) == InterlockedCompareExchangePointer((PVOID volatile *)(p), (PVOID)(n), (PVOID)(o)))
+#define PROF_CAS64(p, o, n) ((LONG64)(o) == InterlockedCompareExchange64((LONG64 volatile *)(p), (LONG64)(n), (LONG64)(o)))
+#endif
+
+#define PROF_SITES 1024 /*!< Site table size, a power of 2 */
+#define PROF_HDR 16     /*!< Header size, keeps 16 byte alignment */
+
+/*! @brief One call site, slot 0 collects sites that didn't fit */
+typedef struct {
+  const char * volatile file;          /*!< Claims the slot, NULL while free */
+  volatile int line1;                  /*!< line + 1, 0 until the claim completes */
+  volatile unsigned long long allocs;  /*!< Sampled allocations */
+  volatile unsigned long long frees;   /*!< Frees of sampled allocations */
+  volatile unsigned long long live;    /*!< Sampled bytes still allocated */
+  volatile unsigned long long peak;    /*!< Highest live */
+} PROF_SITE;
+
+/*! @brief Block header */
+typedef union {
+  struct {
+    size_t size;        /*!< The caller's size */
+    unsigned int site;  /*!< Slot + 1, 0 if not sampled */
+  } h;
+  unsigned char pad[PROF_HDR];
+} PROF_HDR_T;
+
+static size_t prof_rate = 0;             /*!< ICC_MEM_PROFILE, sample 1 in n, 0 is off */
+static int prof_active = 0;              /*!< OpenSSL accepted the allocator */
+static volatile int prof_recording = 1;  /*!< ICC_SetValue(ICC_MEM_PROFILE) */
+static ICC_ThreadKey prof_key;           /*!< The calling thread's countdown */
+static PROF_SITE prof_sites[PROF_SITES];
+static const char prof_unknown[] = "(unknown)";
+
+#if defined(PROF_ATOMICS)
+
+/* The allocator underneath, slab or system */
+static void *(*prof_base_malloc)(size_t, const char *, int) = NULL;
+static void *(*prof_base_realloc)(void *, size_t, const char *, int) = NULL;
+static void (*prof_base_free)(void *, const char *, int) = NULL;
+
+static void *prof_sys_malloc(size_t sz, const char *file, int line)
+{
+  return malloc(sz);
+}
+
+static void *prof_sys_realloc(void *ptr, size_t sz, const char *file, int line)
+{
+  return realloc(ptr, sz);
+}
+
+static void prof_sys_free(void *ptr, const char *file, int line)
+{
+  free(ptr);
+}
+
+/*! @brief Is this allocation one of the 1 in n ?
+    @return 1 to count it
+*/
+static int prof_sample(void)
+{
+  size_t left = 0;
+
+  if (!prof_recording) {
+    return 0;
+  }
+  if (1 == prof_rate) {
+    return 1;
+  }
+  left = (size_t)ICC_GetThreadValue(&prof_key);
+  if (0 == left) {
+    ICC_SetThreadValue(&prof_key, (void *)(prof_rate - 1));
+    return 1;
+  }
+  ICC_SetThreadValue(&prof_key, (void *)(left - 1));
+  return 0;
+}
+
+/*! @brief Find or claim the slot for a call site
+    @param file the caller's file, may be NULL
+    @param line the caller's line
+    @return slot + 1
+*/
+static unsigned int prof_site(const char *file, int line)
+{
+  PROF_SITE *s = NULL;
+  const char *old = NULL;
+  size_t h = 0;
+  unsigned int i = 0, n = 0;
+
+  if (NULL == file) {
+    file = prof_unknown;
+  }
+  h = (((size_t)file >> 4) * 31 + (size_t)line) * 2654435761u;
+  i = (unsigned int)(h >> 8) & (PROF_SITES - 1);
+  for (n = 1; n < PROF_SITES; n++, i = (i + 1) & (PROF_SITES - 1)) {
+    if (0 == i) {
+      continue;
+    }
+    s = &prof_sites[i];
+    old = PROF_LOAD(&(s->file));
+    if (NULL == old) {
+      if (PROF_CASP(&(s->file), old, file)) {
+        PROF_STORE(&(s->line1), line + 1);
+        return i + 1;
+      }
+      /* lost the race, see who won */
+      old = PROF_LOAD(&(s->file));
+    }
+    if (old == file) {
+      /* the claim may still be completing */
+      while (0 == PROF_LOAD(&(s->line1))) {
+        ;
+      }
+      if (s->line1 == line + 1) {
+        return i + 1;
+      }
+    }
+  }
+  return 1;
+}
+
+/*! @brief Count bytes becoming live at a site
+    @param site slot + 1
+    @param sz bytes, the size increase for a realloc
+    @param alloc 1 for a new allocation
+*/
+static void prof_grow(unsigned int site, size_t sz, int alloc)
+{
+  PROF_SITE *s = &prof_sites[site - 1];
+  unsigned long long live = 0, peak = 0;
+
+  if (alloc) {
+    PROF_ADD(&(s->allocs), 1);
+  }
+  live = PROF_ADD(&(s->live), (unsigned long long)sz);
+  do {
+    peak = PROF_LOAD(&(s->peak));
+    if (live <= peak) {
+      break;
+    }
+  } while (!PROF_CAS64(&(s->peak), peak, live));
+}
+
+/*! @brief Count bytes released at a site
+    @param site slot + 1
+    @param sz bytes, the size decrease for a realloc
+    @param freed 1 for a free
+*/
+static void prof_shrink(unsigned int site, size_t sz, int freed)
+{
+  PROF_SITE *s = &prof_sites[site - 1];
+
+  if (freed) {
+    PROF_ADD(&(s->frees), 1);
+  }
+  PROF_ADD(&(s->live), 0ULL - (unsigned long long)sz);
+}
+
+/*! @brief CRYPTO_malloc() replacement
+    @param sz bytes wanted
+    @param file the caller's file
+    @param line the caller's line
+    @return the memory or NULL, NULL for 0 bytes as OpenSSL would
+*/
+static void *prof_malloc(size_t sz, const char *file, int line)
+{
+  PROF_HDR_T *hdr = NULL;
+
+  if ((0 == sz) || (sz > ((size_t)-1) - PROF_HDR)) {
+    return NULL;
+  }
+  hdr = (PROF_HDR_T *)prof_base_malloc(PROF_HDR + sz, file, line);
+  if (NULL != hdr) {
+    hdr->h.size = sz;
+    hdr->h.site = prof_sample() ? prof_site(file, line) : 0;
+    if (0 != hdr->h.site) {
+      prof_grow(hdr->h.site, sz, 1);
+    }
+  }
+  return (NULL == hdr) ? NULL : (void *)(hdr + 1);
+}
+
+/*! @brief CRYPTO_free() replacement
+    @param ptr memory from prof_malloc() or NULL
+    @param file the caller's file
+    @param line the caller's line
+*/
+static void prof_free(void *ptr, const char *file, int line)
+{
+  PROF_HDR_T *hdr = NULL;
+
+  if (NULL != ptr) {
+    hdr = ((PROF_HDR_T *)ptr) - 1;
+    if (0 != hdr->h.site) {
+      prof_shrink(hdr->h.site, hdr->h.size, 1);
+    }
+    prof_base_free(hdr, file, line);
+  }
+}
+
+/*! @brief CRYPTO_realloc() replacement, the block stays with the site
+    that allocated it
+    @param ptr memory from prof_malloc() or NULL
+    @param sz the new size, 0 frees ptr
+    @param file the caller's file
+    @param line the caller's line
+    @return the memory or NULL, ptr is untouched on failure
+*/
+static void *prof_realloc(void *ptr, size_t sz, const char *file, int line)
+{
+  PROF_HDR_T *hdr = NULL;
+  size_t old = 0;
+
+  if (NULL == ptr) {
+    return prof_malloc(sz, file, line);
+  }
+  if (0 == sz) {
+    prof_free(ptr, file, line);
+    return NULL;
+  }
+  if (sz > ((size_t)-1) - PROF_HDR) {
+    return NULL;
+  }
+  hdr = ((PROF_HDR_T *)ptr) - 1;
+  old = hdr->h.size;
+  hdr = (PROF_HDR_T *)prof_base_realloc(hdr, PROF_HDR + sz, file, line);
+  if (NULL != hdr) {
+    hdr->h.size = sz;
+    if (0 != hdr->h.site) {
+      if (sz > old) {
+        prof_grow(hdr->h.site, sz - old, 0);
+      } else {
+        prof_shrink(hdr->h.site, old - sz, 0);
+      }
+    }
+  }
+  return (NULL == hdr) ? NULL : (void *)(hdr + 1);
+}
+#endif
+
+/*! @brief Install the profiler if ICC_MEM_PROFILE was set
+    @note Must run after slab_init() and before OpenSSL's first allocation
+*/
+static void mem_prof_init(void)
+{
+#if defined(PROF_ATOMICS)
+  if ((prof_rate > 0) && !prof_active) {
+    if (0 != ICC_CreateThreadKey(&prof_key, NULL)) {
+      return;
+    }
+    prof_base_malloc = prof_sys_malloc;
+    prof_base_realloc = prof_sys_realloc;
+    prof_base_free = prof_sys_free;
+#if defined(SLAB_ATOMICS)
+    if (slab_active) {
+      prof_base_malloc = slab_malloc;
+      prof_base_realloc = slab_realloc;
+      prof_base_free = slab_free;
+    }
+#endif
+    prof_sites[0].file = "(other)";
+    prof_sites[0].line1 = 1;
+    if (1 == CRYPTO_set_mem_functions(prof_malloc, prof_realloc, prof_free)) {
+      prof_active = 1;
+    } else {
+      MARK("ICC_MEM_PROFILE", "CRYPTO_set_mem_functions() refused");
+      ICC_DestroyThreadKey(&prof_key);
+    }
+  }
+#endif
+}
+
+/*! @brief Pause or resume recording
+    @param on 0 to pause
+    @return 1, or 0 if the profiler isn't installed
+*/
+static int SetMemProfile(int on)
+{
+  if (!prof_active) {
+    return 0;
+  }
+  prof_recording = (0 != on);
+  return 1;
+}
+
+/*! @brief The sampling rate while recording
+    @return n, 0 if not installed or paused
+*/
+static int GetMemProfile(void)
+{
+  return (prof_active && prof_recording) ? (int)prof_rate : 0;
+}
+
+/*! @brief Copy out the sites, largest live bytes first
+    @param out the caller's array
+    @param n entries in out, unused entries are zeroed
+*/
+static void mem_prof_sites(ICC_MEM_SITE *out, size_t n)
+{
+  ICC_MEM_SITE site;
+  const char *file = NULL;
+  size_t i = 0, j = 0, used = 0, len = 0;
+
+  memset(out, 0, n * sizeof(ICC_MEM_SITE));
+  for (i = 0; prof_active && (i < PROF_SITES); i++) {
+    if ((NULL == prof_sites[i].file) || (0 == prof_sites[i].line1) ||
+        (0 == prof_sites[i].allocs)) {
+      continue;
+    }
+    memset(&site, 0, sizeof(site));
+    file = prof_sites[i].file;
+    len = strlen(file);
+    /* keep the end of long paths, that's the part that identifies it */
+    if (len >= sizeof(site.file)) {
+      file += len - (sizeof(site.file) - 1);
+    }
+    strncpy(site.file, file, sizeof(site.file) - 1);
+    site.line = prof_sites[i].line1 - 1;
+    site.allocs = prof_sites[i].allocs * prof_rate;
+    site.frees = prof_sites[i].frees * prof_rate;
+    site.live = prof_sites[i].live * prof_rate;
+    site.peak = prof_sites[i].peak * prof_rate;
+    /* insertion sort into out, keeping the n largest */
+    for (j = used; (j > 0) && (out[j - 1].live < site.live); j--) {
+      if (j < n) {
+        out[j] = out[j - 1];
+      }
+    }
+    if (j < n) {
+      out[j] = site;
+      if (used < n) {
+        used++;
+      }
+    }
+  }
+}
@@ -0,0 +1,175 @@
+#!/usr/bin/perl
+#
+# * Copyright IBM Corp. 2023
+# *
+# * Licensed under the Apache License 2.0 (the "License").  You may not use
+# * this file except in compliance with the License.  You can obtain a copy
+# * in the file LICENSE in the source distribution.
+#
+# Generate name_hash.h, perfect hash tables for the digest and cipher
+# name lists in name_cache_tables.c, by name and by NID.
+#
+# Usage: perl name_hash.pl name_cache_tables.c obj_mac.h name_hash.h
+#
+# - Names hash case insensitively, the hash is computed over the names
+#   in ASCII and in EBCDIC (IBM-1047) so z/OS builds get their own table.
+# - NIDs are the values EVP_MD_type()/EVP_CIPHER_type() return, taken
+#   from obj_mac.h. Ciphers without an OID have type NID_undef (0),
+#   except 1 and 8 bit CFB which report the CFB128 NID. Where names share
+#   a NID, lookup by NID finds the one that NID is named for.
+# - Every slot table is 4x the list size, rounded up to a power of 2,
+#   and we search for a seed with no collisions.
+#
+use strict;
+use warnings;
+use integer;
+
+if (@ARGV != 3) {
+    die "Usage: $0 name_cache_tables.c obj_mac.h name_hash.h\n";
+}
+my ($tables, $objmac, $out) = @ARGV;
+
+# SN/LN (any case) -> symbol, symbol -> NID, symbols with an OID
+my (%sym, %nid, %oid);
+open my $fh, '<', $objmac or die "Cannot open '$objmac': $!\n";
+while (<$fh>) {
+    if (/^#\s*define\s+[SL]N_(\w+)\s+"([^"]+)"/) {
+        $sym{lc $2} = $1 unless exists $sym{lc $2};
+    } elsif (/^#\s*define\s+NID_(\w+)\s+(\d+)/) {
+        $nid{$1} = $2;
+    } elsif (/^#\s*define\s+OBJ_(\w+)\s/) {
+        $oid{$1} = 1;
+    }
+}
+close $fh;
+
+# The lists, in source order
+my (@lists, $cur);
+open $fh, '<', $tables or die "Cannot open '$tables': $!\n";
+while (<$fh>) {
+    if (/^\s*static\s+(MD|CIP)_CACHE\s+(\w+)\s*\[\]/) {
+        $cur = { kind => $1, name => $2, names => [] };
+        push @lists, $cur;
+    } elsif (defined $cur && /^\s*\{\s*"([^"]+)"/) {
+        push @{$cur->{names}}, $1;
+    } elsif (defined $cur && /^\s*\};/) {
+        undef $cur;
+    }
+}
+close $fh;
+die "No name lists found in '$tables'\n" unless @lists;
+
+# ASCII to IBM-1047 for the characters allowed in a name
+my %e;
+@e{'a'..'i'} = (0x81..0x89); @e{'j'..'r'} = (0x91..0x99); @e{'s'..'z'} = (0xa2..0xa9);
+@e{'A'..'I'} = (0xc1..0xc9); @e{'J'..'R'} = (0xd1..0xd9); @e{'S'..'Z'} = (0xe2..0xe9);
+@e{'0'..'9'} = (0xf0..0xf9); $e{'-'} = 0x60; $e{'_'} = 0x6d; $e{'.'} = 0x4b;
+
+# Must match name_hash() and nid_hash() in nid_cache.c
+sub fold {
+    my ($c, $ebcdic) = @_;
+    return $ebcdic ? ($e{$c} & 0xbf) : (ord($c) | 0x20);
+}
+sub name_hash {
+    my ($s, $seed, $ebcdic) = @_;
+    my $h = $seed;
+    foreach my $c (split //, $s) {
+        $h = (($h ^ fold($c, $ebcdic)) * 16777619) & 0xffffffff;
+    }
+    return ($h ^ ($h >> 15)) & 0xffffffff;
+}
+sub nid_hash {
+    my ($n, $seed) = @_;
+    my $h = ($n * $seed) & 0xffffffff;
+    return ($h ^ ($h >> 15)) & 0xffffffff;
+}
+
+# Find a seed giving each key its own slot
+sub perfect {
+    my ($keys, $mask, $hash) = @_;
+    my $seed = 0x811c9dc5;
+    for (my $tries = 0; $tries < 1000000; $tries++) {
+        my @slot = (-1) x ($mask + 1);
+        my $ok = 1;
+        for (my $i = 0; $i < @$keys; $i++) {
+            my $s = $hash->($keys->[$i], $seed) & $mask;
+            if ($slot[$s] >= 0) { $ok = 0; last; }
+            $slot[$s] = $i;
+        }
+        return ($seed, @slot) if $ok;
+        $seed = (($seed * 69069 + 1) & 0xffffffff) | 1;
+    }
+    die "No perfect hash found\n";
+}
+
+sub table {
+    my ($name, @slot) = @_;
+    my $s = "static const signed char ${name}[" . scalar(@slot) . "] = {";
+    for (my $i = 0; $i < @slot; $i++) {
+        $s .= ($i % 16) ? "," : ($i ? ",\n  " : "\n  ");
+        $s .= sprintf("%2d", $slot[$i]);
+    }
+    return $s . "\n};\n";
+}
+
+open my $oh, '>', $out or die "Cannot open '$out': $!\n";
+print $oh "/* Generated by name_hash.pl from $tables and obj_mac.h, don't edit */\n\n";
+print $oh "#if !defined(NAME_HASH_H)\n#define NAME_HASH_H\n\n";
+foreach my $l (@lists) {
+    my $n = $l->{name};
+    my @names = @{$l->{names}};
+    my (%seen, @nids, @own, %first);
+    die "$n has more than 127 entries\n" if @names > 127;
+    foreach my $x (@names) {
+        die "$n: duplicate name $x\n" if $seen{lc $x}++;
+        foreach my $c (split //, $x) {
+            die "$n: can't hash '$c' in $x\n" unless exists $e{$c};
+        }
+        my $s = $sym{lc $x};
+        die "$n: $x isn't in obj_mac.h\n" unless defined $s && defined $nid{$s};
+        if (('CIP' ne $l->{kind}) || $oid{$s}) {
+            push @nids, $nid{$s};
+        } elsif ($s =~ /^(\w+_cfb)(1|8)$/ && $oid{"${1}128"}) {
+            push @nids, $nid{"${1}128"};
+        } else {
+            push @nids, 0;
+        }
+        push @own, $nid{$s} == $nids[-1];
+    }
+    my $size = 1;
+    $size <<= 1 while $size < 4 * @names;
+    my $mask = $size - 1;
+    my ($aseed, @aslot) = perfect(\@names, $mask, sub { name_hash($_[0], $_[1], 0) });
+    my ($eseed, @eslot) = perfect(\@names, $mask, sub { name_hash($_[0], $_[1], 1) });
+    # Only one name per NID goes in the NID table and 0 is never looked up,
+    # the rest get keys that can't match and are left out
+    foreach my $i (0 .. $#nids) {
+        $first{$nids[$i]} = $i if $own[$i] || !exists $first{$nids[$i]};
+    }
+    my @keys = map { ($nids[$_] && $first{$nids[$_]} == $_) ? $nids[$_] : -1 - $_ } (0 .. $#nids);
+    my ($nseed, @nslot) = perfect(\@keys, $mask, \&nid_hash);
+    @nslot = map { ($_ >= 0 && $keys[$_] < 0) ? -1 : $_ } @nslot;
+
+    my $guard = ($n =~ /^([A-Z])_/) ? "HAVE_$1_ICC" : undef;
+    print $oh "#if defined($guard)\n" if defined $guard;
+    print $oh "/* $n */\n";
+    print $oh "#define ${n}_MASK $mask\n";
+    printf $oh "#define ${n}_NIDSEED 0x%08xU\n", $nseed;
+    print $oh "#if defined(CHARSET_EBCDIC)\n";
+    printf $oh "#define ${n}_SEED 0x%08xU\n", $eseed;
+    print $oh table("${n}_byname", @eslot);
+    print $oh "#else\n";
+    printf $oh "#define ${n}_SEED 0x%08xU\n", $aseed;
+    print $oh table("${n}_byname", @aslot);
+    print $oh "#endif\n";
+    print $oh table("${n}_bynid", @nslot);
+    print $oh "static const int ${n}_nid[" . scalar(@nids) . "] = {";
+    for (my $i = 0; $i < @nids; $i++) {
+        print $oh (($i % 8) ? ", " : ($i ? ",\n  " : "\n  ")), $nids[$i];
+    }
+    print $oh "\n};\n";
+    print $oh "#endif\n" if defined $guard;
+    print $oh "\n";
+}
+print $oh "#endif\n";
+close $oh;
@@ -13,7 +13,7 @@
 
    Note that this creates TWO caches, one to speed name lookups 
   for common objects.
-  The other is nid sorted and used for FIPS allowed algorithm lookups
+  The other is by nid and used for FIPS allowed algorithm lookups
 
   Note: We need both because the names can have alias's and the FIPS algorithm
   lookup has to work for all the alias's. 
@@ -21,10 +21,10 @@
   is enabled then md->nid and check nid is FIPS allowed.
 
  The name cache is relatively obvious, the nid cache less so. 
-        The nid cache ends up populated with nids sorted by order for all the known FIPS allowed ciphers and digests
+        The nid cache holds the nids of all the known FIPS allowed ciphers and digests
         This is complete BY NID as the nids (unlike the names) don't have aliases.
         IF we find the name in the name cache, we have it's nid and FIPS status directly from the found object
-        ELSE we call down to OpenSSL, then we check the nid of the returned EVP_MD against the nid sorted cache
+        ELSE we call down to OpenSSL, then we check the nid of the returned EVP_MD against the nid cache
         because it could have been an alias without an entry in the name cache.
 */
 
@@ -32,81 +32,81 @@
 #define HAVE_C_ICC
 
 #include "name_cache_tables.c"
+#include "name_hash.h" /* Generated from name_cache_tables.c, name_hash.pl */
 
 #undef HAVE_C_ICC
 /* Enable for testing, doesn't use the cache 
  * callbacks with still run, but no FIPS indicators
 #define RAW
 */
-/* Create the space for the NID sorted variants
-*/
-static MD_CACHE md_nids[sizeof(C_diglist)/sizeof(MD_CACHE)];
-static MD_CACHE cip_nids[sizeof(C_ciplist)/sizeof(MD_CACHE)];
-
 
+/* Callback for ICC_EVP_getXYZbyname() calls */
+typedef void * (*NAMEFUNC)(const char *name);
 
-/* name->md, Use case insensitive string compare 
-  works with either MD or Cipher as the cache objects being manipulated 
-  are the same size and contain the same size objects
-  Note that alias's are allowed and this will miss alias's
+/* Both lookups are perfect hashes built at compile time by name_hash.pl,
+   so there's nothing to set up at startup. A name hashes to at most one
+   entry and one case insensitive compare confirms it, a NID likewise.
+   Only the EVP_MD/EVP_CIPHER pointers are filled in, on first use.
 */
-static int mycmp(const void *p1, const void *p2)
-{
-    return strcasecmp(((MD_CACHE *)p1)->name,((MD_CACHE *)p2)->name);
-}
-
-/* nid->fips, 
-  works with either MD or Cipher as the cache objects being manipulated 
-  are the same size and contain the same size objects
+#if defined(CHARSET_EBCDIC)
+#define NAME_FOLD(c) ((c) & 0xbf)
+#else
+#define NAME_FOLD(c) ((c) | 0x20)
+#endif
 
+/*! @brief Case insensitive name hash, must match name_hash.pl
+    @param name the name
+    @param seed the table's seed
+    @return the hash
 */
-static int myNIDcmp(const void *p1, const void *p2)
+static unsigned int name_hash(const char *name, unsigned int seed)
 {
-    return ((MD_CACHE *)p1)->nid - ((MD_CACHE *)p2)->nid;
+    unsigned int h = seed;
+    while('\0' != *name) {
+        h = (h ^ (unsigned char)NAME_FOLD(*name)) * 16777619U;
+        name++;
+    }
+    return (h ^ (h >> 15)) & 0xffffffffU;
 }
-/* Callback for ICC_EVP_getXYZbyname() calls */
 
-typedef void * (*NAMEFUNC)(const char *name);
-/* Callback for EVP_MD_type, EVP_CIPHER_type calls */
-typedef int (*NIDFUNC)(const void *thing);
-
-/* Generic cache setup, basically sort the entries by name 
-  grab the nid and stash that
-  sort the name cache, copy the data to the nid cache and sort that as well.
-  Note we have in effect TWO caches here, one sorted by name, the other by NID
+/*! @brief NID hash, must match name_hash.pl
+    @param nid the NID
+    @param seed the table's seed
+    @return the hash
 */
-
-static void init_caches(MD_CACHE *dig,MD_CACHE *nids,int n,NAMEFUNC func,NIDFUNC nidfunc)
+static unsigned int nid_hash(int nid, unsigned int seed)
 {
-    int i;
-    for(i = 0; i < n;i++) {
-        dig[i].md = (*func)(dig[i].name);
-        if(NULL != dig[i].md) {
-          dig[i].nid = (*nidfunc)(dig[i].md);
-        }
-    }    
-    qsort(dig,n,sizeof(MD_CACHE),mycmp);     /* Sort the name cache */
-    memcpy(nids,dig,sizeof(MD_CACHE)*n);     /* Copy the populated name data to the nid cache */
-    qsort(nids,n,sizeof(MD_CACHE),myNIDcmp); /* Sort that one by NID */
+    unsigned int h = ((unsigned int)nid * seed) & 0xffffffffU;
+    return (h ^ (h >> 15)) & 0xffffffffU;
 }
 
 /*! 
   @brief Lookup a cache entry by name
   @param base of the cache to search
-  @param n number of entries in this cache
+  @param slots the name hash table for base
+  @param mask the table size - 1
+  @param seed the table's seed
   @param name the name of the object to locate
+  @param func looks up the object if it isn't cached yet
   @return the cache entry or NULL on no match
   @note there's an amount of overloading here.
   @note Returns the cache entry not the cipher/digest objecty so we can check whether it's blacklisted
   before calling the underlying functions
-  @note the caches have to be populated. That's done when we create a context.
+  @note Two threads may both fill in md, they store the same pointer
   */
-static MD_CACHE *name_cache_lookup(MD_CACHE *base, int n, const char *name) {
+static MD_CACHE *name_cache_lookup(MD_CACHE *base, const signed char *slots,
+                                   unsigned int mask, unsigned int seed,
+                                   const char *name, NAMEFUNC func) {
   MD_CACHE *tmp = NULL;
-  MD_CACHE mymd; /* Dummy for the compare function */
+  int i;
   if(NULL != name) {
-    mymd.name = name;
-    tmp = bsearch(&mymd, base, n, sizeof(MD_CACHE), mycmp);
+    i = slots[name_hash(name, seed) & mask];
+    if((i >= 0) && (0 == strcasecmp(base[i].name, name))) {
+      tmp = &base[i];
+      if(NULL == tmp->md) {
+        tmp->md = (*func)(tmp->name);
+      }
+    }
   }
   return tmp;
 }
@@ -114,35 +114,40 @@ static MD_CACHE *name_cache_lookup(MD_CACHE *base, int n, const char *name) {
 /*! 
   @brief Lookup a cache entry by nid
   @param base of the cache to search
-  @param n number of entries in this cache
+  @param slots the NID hash table for base
+  @param nids the NID of each entry in base
+  @param mask the table size - 1
+  @param seed the table's seed
   @param nid the nid of the object to locate
   @return the cache entry or NULL on no match
-  @note there's an amount of overloading here.
   @note Returns the cache entry not the cipher/digest object so we can check attributes before returning
-  @note the caches have to be populated. That's done when we create a context.
   */
-static MD_CACHE *NID_cache_lookup(MD_CACHE *base, int n, int nid) {
+static MD_CACHE *NID_cache_lookup(MD_CACHE *base, const signed char *slots,
+                                  const int *nids, unsigned int mask,
+                                  unsigned int seed, int nid) {
   MD_CACHE *tmp = NULL;
-  MD_CACHE mymd; /* Dummy for the compare function */
+  int i;
   if(0 != nid) {
-    mymd.nid = nid;
-    tmp = bsearch(&mymd, base, n, sizeof(MD_CACHE), myNIDcmp);
+    i = slots[nid_hash(nid, seed) & mask];
+    if((i >= 0) && (nid == nids[i])) {
+      tmp = &base[i];
+    }
   }
   return tmp;
 }
 
-
-/*! @brief Init caches for the common digests and ciphers , by name and by nid
-    @note this only being called when signle threaded is dealt with elsewhere in the code
-        but it should be harmless anyway as repeated calls to the sort leave the data in
-        the same place. (FLW)
-*/
-
-static void init_name_caches()
-{
-  init_caches(C_diglist, md_nids,sizeof(C_diglist)/sizeof(MD_CACHE),(NAMEFUNC)EVP_get_digestbyname,(NIDFUNC)EVP_MD_type);
-  init_caches((MD_CACHE *)C_ciplist,cip_nids,sizeof(C_ciplist)/sizeof(MD_CACHE),(NAMEFUNC)EVP_get_cipherbyname,(NIDFUNC)EVP_CIPHER_type);
-}
+#define MD_BYNAME(name) \
+  name_cache_lookup(C_diglist, C_diglist_byname, C_diglist_MASK, C_diglist_SEED, \
+                    (name), (NAMEFUNC)EVP_get_digestbyname)
+#define CIP_BYNAME(name) \
+  name_cache_lookup((MD_CACHE *)C_ciplist, C_ciplist_byname, C_ciplist_MASK, C_ciplist_SEED, \
+                    (name), (NAMEFUNC)EVP_get_cipherbyname)
+#define MD_BYNID(nid) \
+  NID_cache_lookup(C_diglist, C_diglist_bynid, C_diglist_nid, C_diglist_MASK, \
+                   C_diglist_NIDSEED, (nid))
+#define CIP_BYNID(nid) \
+  NID_cache_lookup((MD_CACHE *)C_ciplist, C_ciplist_bynid, C_ciplist_nid, C_ciplist_MASK, \
+                   C_ciplist_NIDSEED, (nid))
 
 /*! @brief Check if a message digest is FIPS approved 
     @param nid the NID to lookup
@@ -152,7 +157,7 @@ static int FIPS_MDbyNID(int nid)
 {
   int fips = 0;
   MD_CACHE *tmp = NULL;
-  tmp = NID_cache_lookup(md_nids,sizeof(C_diglist) / sizeof(MD_CACHE), nid);
+  tmp = MD_BYNID(nid);
   if(tmp != NULL) {
     fips = tmp->fips;
   }
@@ -167,7 +172,7 @@ static int FIPS_CipherbyNID(int nid)
 {
   int fips = 0;
   MD_CACHE *tmp = NULL;
-  tmp = NID_cache_lookup(cip_nids,sizeof(C_ciplist) / sizeof(MD_CACHE), nid);
+  tmp = CIP_BYNID(nid);
   if(tmp != NULL) {
     fips = tmp->fips;
   }
@@ -186,16 +191,16 @@ const EVP_MD * my_EVP_get_digestbyname(ICClib *pcb, const char *name)
     nid = EVP_MD_type(rv); 
   }
 #else
-  tmp = name_cache_lookup(C_diglist, sizeof(C_diglist) / sizeof(MD_CACHE), name);
+  tmp = MD_BYNAME(name);
   if (NULL != tmp) {
     rv = (const EVP_MD *)tmp->md;
     fips = tmp->fips;
-    nid = tmp->nid;
+    nid = C_diglist_nid[tmp - C_diglist];
   } else { /* This is where we need to check the nid cache, aliases for the digest names */
     rv = EVP_get_digestbyname(name);
     if(NULL != rv) {
       nid = EVP_MD_type(rv);
-      tmp = NID_cache_lookup(md_nids,sizeof(C_diglist) / sizeof(MD_CACHE), nid);
+      tmp = MD_BYNID(nid);
       if(tmp != NULL) {
         fips = tmp->fips;
       }
@@ -221,16 +226,16 @@ const EVP_CIPHER * my_EVP_get_cipherbyname(ICClib *pcb, const char *name)
     nid = EVP_CIPHER_type(rv);
   }
 #else  
-  tmp = name_cache_lookup((MD_CACHE *)C_ciplist, sizeof(C_ciplist) / sizeof(CIP_CACHE), name);
+  tmp = CIP_BYNAME(name);
   if (NULL != tmp) {
     rv = (const EVP_CIPHER *)tmp->md;
     fips = tmp->fips;
-    nid = tmp->nid;
+    nid = C_ciplist_nid[tmp - (MD_CACHE *)C_ciplist];
   } else { /* This is where we need to check the nid cache, aliases for the cipher names */
     rv = EVP_get_cipherbyname(name);
     if (NULL != rv) {
       nid = EVP_CIPHER_type(rv);
-      tmp = NID_cache_lookup(cip_nids, sizeof(C_ciplist) / sizeof(CIP_CACHE), nid);
+      tmp = CIP_BYNID(nid);
       if (tmp != NULL) {
         fips = tmp->fips;
       }
@@ -246,3 +251,187 @@ const EVP_CIPHER * my_EVP_get_cipherbyname(ICClib *pcb, const char *name)
 }
 
 
+
+/*
+  Shared EC groups for ICC_EC_KEY_new_by_curve_name()
+  EC_KEY_new_by_curve_name() builds the group from the curve data every call
+  and the generator multiples are never kept. Instead, the FIPS curves are built
+  once, with the generator precomputation, on first use. New keys get a copy
+  of the group, which shares the precomputed table by reference count.
+  The cached groups are never modified after they are published.
+*/
+#define EC_GROUP_CACHE_N 12 /*!< Slots, one per FIPS curve */
+
+static struct {
+  int nid;          /*!< Curve NID */
+  EC_GROUP *group;  /*!< The shared group, NULL until first use */
+} ec_groups[EC_GROUP_CACHE_N] = {
+  {713, NULL}, /* secp224r1  P-224 */
+  {415, NULL}, /* prime256v1 P-256 */
+  {715, NULL}, /* secp384r1  P-384 */
+  {716, NULL}, /* secp521r1  P-521 */
+  {726, NULL}, /* sect233k1  K-233 */
+  {727, NULL}, /* sect233r1  B-233 */
+  {729, NULL}, /* sect283k1  K-283 */
+  {730, NULL}, /* sect283r1  B-283 */
+  {731, NULL}, /* sect409k1  K-409 */
+  {732, NULL}, /* sect409r1  B-409 */
+  {733, NULL}, /* sect571k1  K-571 */
+  {734, NULL}  /* sect571r1  B-571 */
+};
+static ICC_Mutex ec_group_mtx;
+static int ec_group_init = 0; /*!< 1 once the mutex exists */
+
+/*! @brief Create the EC group cache lock
+    @note Called from ICCLoad(), single threaded
+*/
+static void init_ec_group_cache()
+{
+  if((0 == ec_group_init) && (0 == ICC_CreateMutex(&ec_group_mtx))) {
+    ec_group_init = 1;
+  }
+}
+
+/*! @brief Free the cached EC groups
+    @note Only called in the library unload path
+*/
+static void free_ec_group_cache()
+{
+  int i;
+  if(ec_group_init) {
+    for(i = 0; i < EC_GROUP_CACHE_N; i++) {
+      if(NULL != ec_groups[i].group) {
+        EC_GROUP_free(ec_groups[i].group);
+        ec_groups[i].group = NULL;
+      }
+    }
+    ICC_DestroyMutex(&ec_group_mtx);
+    ec_group_init = 0;
+  }
+}
+
+/*! @brief Check if a curve is FIPS approved
+    @param nid the curve NID
+    @return 1 for FIPS 0 otherwise
+*/
+static int FIPS_ECbyNID(int nid)
+{
+  int i;
+  int fips = 0;
+  for(i = 0; i < EC_GROUP_CACHE_N; i++) {
+    if(nid == ec_groups[i].nid) {
+      fips = 1;
+      break;
+    }
+  }
+  return fips;
+}
+
+/*! @brief Return the shared group for a curve, building it on first use
+    @param nid the curve NID
+    @return the group, NULL if the curve isn't cached. Don't modify or free it
+    @note P-256 isn't precomputed, OpenSSL's nistz256 code has a static table
+*/
+static const EC_GROUP *ec_group_lookup(int nid)
+{
+  int i;
+  EC_GROUP *grp = NULL;
+
+  if(ec_group_init) {
+    for(i = 0; i < EC_GROUP_CACHE_N; i++) {
+      if(nid == ec_groups[i].nid) {
+        /* Unlocked peek, published entries never change */
+        grp = ec_groups[i].group;
+        if(NULL == grp) {
+          ICC_LockMutex(&ec_group_mtx);
+          grp = ec_groups[i].group;
+          if(NULL == grp) {
+            grp = EC_GROUP_new_by_curve_name(nid);
+            if((NULL != grp) && (415 != nid) && 
+               (1 != EC_GROUP_precompute_mult(grp, NULL))) {
+              EC_GROUP_free(grp);
+              grp = NULL;
+            }
+            ec_groups[i].group = grp;
+          }
+          ICC_UnlockMutex(&ec_group_mtx);
+        }
+        break;
+      }
+    }
+  }
+  return grp;
+}
+
+/*
+  Fixed base tables for the RFC 7919 groups, ICC_DH_generate_key()
+  Every key in a named group has the same p and g so the Montgomery
+  context for p and the powers of g are built once, on first use,
+  and shared read only by all DH objects in that group. 
+  Tables cover the private key length DH_new_by_nid() sets for the group.
+*/
+#define DH_COMB_CACHE_N 5 /*!< Slots, one per FFDHE group */
+
+static struct {
+  int nid;          /*!< Group NID */
+  DH_COMB *comb;    /*!< The shared table, NULL until first use */
+} dh_combs[DH_COMB_CACHE_N] = {
+  {1126, NULL}, /* ffdhe2048 */
+  {1127, NULL}, /* ffdhe3072 */
+  {1128, NULL}, /* ffdhe4096 */
+  {1129, NULL}, /* ffdhe6144 */
+  {1130, NULL}  /* ffdhe8192 */
+};
+
+/*! @brief Free the cached DH tables
+    @note Only called in the library unload path
+*/
+static void free_dh_comb_cache()
+{
+  int i;
+  for(i = 0; i < DH_COMB_CACHE_N; i++) {
+    DH_COMB_free(dh_combs[i].comb);
+    dh_combs[i].comb = NULL;
+  }
+}
+
+/*! @brief Return the shared fixed base table for a DH key's group
+    @param dh the DH key
+    @return the table, NULL if the parameters aren't a named group
+    @note Shares the EC group cache lock, the tables are only built once 
+*/
+static const DH_COMB *dh_comb_lookup(const DH *dh)
+{
+  int i;
+  int nid;
+  DH *named = NULL;
+  const BIGNUM *p = NULL;
+  const BIGNUM *g = NULL;
+  DH_COMB *comb = NULL;
+
+  if(ec_group_init) {
+    nid = DH_get_nid(dh);
+    for(i = 0; i < DH_COMB_CACHE_N; i++) {
+      if(nid == dh_combs[i].nid) {
+        /* Unlocked peek, published entries never change */
+        comb = dh_combs[i].comb;
+        if(NULL == comb) {
+          ICC_LockMutex(&ec_group_mtx);
+          comb = dh_combs[i].comb;
+          if(NULL == comb) {
+            named = DH_new_by_nid(nid);
+            if(NULL != named) {
+              DH_get0_pqg(named, &p, NULL, &g);
+              comb = DH_COMB_new(p, g, (int)DH_get_length(named));
+              DH_free(named);
+            }
+            dh_combs[i].comb = comb;
+          }
+          ICC_UnlockMutex(&ec_group_mtx);
+        }
+        break;
+      }
+    }
+  }
+  return comb;
+}
@@ -0,0 +1,283 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*
+  Faster DH and DSA parameter generation, ICC_PARAMGEN_THREADS and
+  ICC_DH_NAMED_GROUPS.
+
+  A DH safe prime, or a FIPS 186 DSA p and q, is found by testing
+  random candidates until one passes, how long that takes is
+  essentially luck. With ICC_PARAMGEN_THREADS=n, n independent
+  searches are run at once and the first to finish wins, the rest are
+  stopped through their BN_GENCB callback.
+
+  - Each search is a complete, unmodified DH_generate_parameters_ex()
+    or DSA_generate_parameters_ex() into it's own object, so the
+    result (and the DSA seed counter and h) is exactly what a single
+    search would have returned.
+  - Only used when the caller gave no callback and, for DSA, no seed.
+    Otherwise, or for sizes below PARAM_PAR_MIN_BITS, the serial
+    OpenSSL search is used as before.
+  - A thread that can't be started isn't replaced, the caller searches
+    in any case.
+
+  ICC_DH_NAMED_GROUPS=1 lets ICC_DH_generate_parameters() with
+  generator 2 return a validated named group instead of generating
+  one, RFC 7919 ffdhe2048 - ffdhe8192 for those sizes and RFC 3526
+  group 5 for 1536 bits. Off by default, the groups are public and
+  shared which isn't what every caller asking for new parameters
+  wants.
+*/
+
+#define PARAM_PAR_MAX_THREADS 16  /*!< Limit for ICC_PARAMGEN_THREADS */
+#define PARAM_PAR_MIN_BITS 2048   /*!< Smaller parameters are quick enough */
+
+static int param_par_threads = 1; /*!< ICC_PARAMGEN_THREADS, 1 is off */
+static int dh_named_groups = 0;   /*!< ICC_DH_NAMED_GROUPS, 1 on */
+
+/*! @brief One parameter search race */
+typedef struct {
+  ICC_Mutex mtx;       /*!< Protects winner */
+  int winner;          /*!< Index of the first search to finish, -1 none */
+  volatile int done;   /*!< Set once there's a winner */
+} PARAM_RACE;
+
+/*! @brief One search in the race */
+typedef struct {
+  PARAM_RACE *race;
+  int idx;             /*!< Index in the race */
+  int bits;
+  int generator;       /*!< DH only */
+  DH *dh;              /*!< DH search, or NULL */
+  DSA *dsa;            /*!< DSA search, or NULL */
+  int counter;         /*!< DSA counter */
+  unsigned long h;     /*!< DSA h */
+  int rv;              /*!< 1 O.K. */
+  int started;         /*!< Running on thr */
+  ICC_Thread thr;
+} PARAM_SEARCH;
+
+/*! @brief Set the number of parameter searches run at once
+  @param n 1-PARAM_PAR_MAX_THREADS, 1 is off
+*/
+static void SetParamGenThreads(int n)
+{
+  if((n >= 1) && (n <= PARAM_PAR_MAX_THREADS)) {
+    param_par_threads = n;
+  }
+}
+
+/*! @brief BN_GENCB callback, stop once another search has won */
+static int param_par_cb(int a, int b, BN_GENCB *cb)
+{
+  PARAM_RACE *race = (PARAM_RACE *)BN_GENCB_get_arg(cb);
+  return (0 == race->done) ? 1 : 0;
+}
+
+/*! @brief Run one search
+  @param ps the search, dh or dsa is already allocated
+*/
+static void param_par_search(PARAM_SEARCH *ps)
+{
+  BN_GENCB *cb = NULL;
+
+  ps->rv = 0;
+  cb = BN_GENCB_new();
+  if(NULL != cb) {
+    ERR_set_mark();
+    BN_GENCB_set(cb,param_par_cb,ps->race);
+    if(NULL != ps->dh) {
+      ps->rv = DH_generate_parameters_ex(ps->dh,ps->bits,ps->generator,cb);
+    } else {
+      ps->rv = DSA_generate_parameters_ex(ps->dsa,ps->bits,NULL,0,&ps->counter,&ps->h,cb);
+    }
+  }
+  if(1 == ps->rv) {
+    ICC_LockMutex(&ps->race->mtx);
+    if(ps->race->winner < 0) {
+      ps->race->winner = ps->idx;
+      ps->race->done = 1;
+    }
+    ICC_UnlockMutex(&ps->race->mtx);
+  } else if(NULL != cb) {
+    /* Stopped because another search won isn't an error */
+    if(0 != ps->race->done) {
+      ERR_pop_to_mark();
+    }
+  }
+  BN_GENCB_free(cb);
+}
+
+static ICC_THREAD_RET ICC_THREAD_CALL param_par_worker(void *arg)
+{
+  param_par_search((PARAM_SEARCH *)arg);
+  return 0;
+}
+
+/*! @brief Race param_par_threads DH or DSA parameter searches
+  @param bits the size of p
+  @param generator DH generator, or 0 for DSA
+  @param dh set to the DH parameters for a DH race, else NULL
+  @param dsa set to the DSA parameters for a DSA race, else NULL
+  @param counter_ret DSA counter, may be NULL
+  @param h_ret DSA h, may be NULL
+  @return 1 O.K., 0 all the searches failed
+*/
+static int param_par_race(int bits, int generator, DH **dh, DSA **dsa,
+                          int *counter_ret, unsigned long *h_ret)
+{
+  PARAM_RACE race;
+  PARAM_SEARCH ps[PARAM_PAR_MAX_THREADS];
+  int nthr = param_par_threads;
+  int i = 0;
+  int rv = 0;
+
+  memset(ps,0,sizeof(ps));
+  race.winner = -1;
+  race.done = 0;
+  if(0 != ICC_CreateMutex(&race.mtx)) {
+    return 0;
+  }
+  for(i = 0; i < nthr; i++) {
+    ps[i].race = &race;
+    ps[i].idx = i;
+    ps[i].bits = bits;
+    ps[i].generator = generator;
+    if(NULL != dh) {
+      ps[i].dh = DH_new();
+    } else {
+      ps[i].dsa = DSA_new();
+    }
+    if((NULL == ps[i].dh) && (NULL == ps[i].dsa)) {
+      break;
+    }
+  }
+  nthr = i;
+  for(i = 1; i < nthr; i++) {
+    ps[i].started = (0 == ICC_CreateThread(&(ps[i].thr),param_par_worker,&ps[i]));
+  }
+  if(nthr > 0) {
+    param_par_search(&ps[0]);
+  }
+  for(i = 1; i < nthr; i++) {
+    if(ps[i].started) {
+      ICC_JoinThread(&(ps[i].thr));
+    }
+  }
+  ICC_DestroyMutex(&race.mtx);
+  for(i = 0; i < nthr; i++) {
+    if(i == race.winner) {
+      rv = 1;
+      if(NULL != dh) {
+        *dh = ps[i].dh;
+      } else {
+        *dsa = ps[i].dsa;
+        if(NULL != counter_ret) {
+          *counter_ret = ps[i].counter;
+        }
+        if(NULL != h_ret) {
+          *h_ret = ps[i].h;
+        }
+      }
+    } else {
+      DH_free(ps[i].dh);
+      DSA_free(ps[i].dsa);
+    }
+  }
+  return rv;
+}
+
+/*! @brief The named group to use for a DH parameter request
+  @param bits the size of p
+  @param generator the generator
+  @return the group (caller frees) or NULL to generate parameters
+*/
+static DH *DHNamedGroup(int bits, int generator)
+{
+  DH *dh = NULL;
+  BIGNUM *p = NULL;
+  BIGNUM *g = NULL;
+  int nid = NID_undef;
+
+  if(!dh_named_groups || (2 != generator)) {
+    return NULL;
+  }
+  switch(bits) {
+  case 2048:
+    nid = NID_ffdhe2048;
+    break;
+  case 3072:
+    nid = NID_ffdhe3072;
+    break;
+  case 4096:
+    nid = NID_ffdhe4096;
+    break;
+  case 6144:
+    nid = NID_ffdhe6144;
+    break;
+  case 8192:
+    nid = NID_ffdhe8192;
+    break;
+  case 1536:
+    /* RFC 3526 group 5, there's no RFC 7919 group this size */
+    dh = DH_new();
+    p = BN_get_rfc3526_prime_1536(NULL);
+    g = BN_new();
+    if((NULL == dh) || (NULL == p) || (NULL == g) || !BN_set_word(g,2) ||
+       !DH_set0_pqg(dh,p,NULL,g)) {
+      BN_free(g);
+      BN_free(p);
+      DH_free(dh);
+      dh = NULL;
+    }
+    return dh;
+  default:
+    return NULL;
+  }
+  return DH_new_by_nid(nid);
+}
+
+/*! @brief DH parameters, named group, parallel or serial search
+  @return the parameters or NULL
+*/
+static DH *DHParamGen(int bits, int generator, void (*callback)(int,int,void *), void *cb_arg)
+{
+  DH *dh = NULL;
+
+  dh = DHNamedGroup(bits,generator);
+  if((NULL == dh) && (param_par_threads > 1) && (NULL == callback) &&
+     (bits >= PARAM_PAR_MIN_BITS)) {
+    if(!param_par_race(bits,generator,&dh,NULL,NULL,NULL)) {
+      dh = NULL;
+    }
+  }
+  if(NULL == dh) {
+    dh = DH_generate_parameters(bits,generator,callback,cb_arg);
+  }
+  return dh;
+}
+
+/*! @brief DSA parameters, parallel or serial search
+  @return the parameters or NULL
+*/
+static DSA *DSAParamGen(int bits, unsigned char *seed, int seed_len, int *counter_ret,
+                        unsigned long *h_ret, void (*callback)(int,int,void *), void *cb_arg)
+{
+  DSA *dsa = NULL;
+
+  if((param_par_threads > 1) && (NULL == callback) && ((NULL == seed) || (0 == seed_len)) &&
+     (bits >= PARAM_PAR_MIN_BITS)) {
+    if(!param_par_race(bits,0,NULL,&dsa,counter_ret,h_ret)) {
+      dsa = NULL;
+    }
+  }
+  if(NULL == dsa) {
+    dsa = DSA_generate_parameters(bits,seed,seed_len,counter_ret,h_ret,callback,cb_arg);
+  }
+  return dsa;
+}
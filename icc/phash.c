@@ -0,0 +1,405 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*
+  SP800-185 ParallelHash128/ParallelHash256, PHASH_CTX.
+
+  The input is cut into B byte leaves, each leaf is hashed with
+  SHAKE128/SHAKE256 (cSHAKE with empty N and S) to 32/64 bytes and the
+  chaining values, in order, are absorbed by the outer
+  cSHAKE(N="ParallelHash",S). The leaves are independent so large
+  inputs are hashed on several threads.
+
+  - PHASH_CTX_Update() takes any length. Only a partial leaf is ever
+    copied, whole leaves are hashed straight from the caller's buffer.
+  - Leaves are hashed in rounds of up to PHASH_ROUND. A round of at
+    least 2 * PHASH_SEG_MIN bytes is split across up to phash_threads
+    threads (ICC_PHASH_THREADS), the caller hashes the first segment.
+    A segment whose thread couldn't be started is hashed in line.
+    Threads are started per round, not pooled, the cost is noise at
+    these sizes.
+  - Smaller rounds, and 1 thread, absorb each chaining value as it's
+    produced.
+  - The result doesn't depend on the thread count or how the input
+    was split between calls.
+*/
+
+#define PHASH_MAX_THREADS 16            /*!< Limit for ICC_PHASH_THREADS */
+#define PHASH_ROUND 4096                /*!< Leaves hashed per round */
+#define PHASH_SEG_MIN (256 * 1024)      /*!< Smallest per thread share of a round, bytes */
+#define PHASH_MAX_CV 64                 /*!< Chaining value length, ParallelHash256 */
+
+static int phash_threads = 0; /*!< ICC_PHASH_THREADS, 0 one per CPU up to PHASH_MAX_THREADS */
+
+/*! @brief ParallelHash state */
+struct PHASH_CTX_t {
+  XOF_CTX *outer;        /*!< cSHAKE(N="ParallelHash",S) over the chaining values */
+  XOF_CTX *leaf;         /*!< The caller's leaf hash */
+  const EVP_MD *md;      /*!< SHAKE128 or SHAKE256 */
+  size_t B;              /*!< Leaf size, bytes */
+  size_t cvlen;          /*!< 32 or 64 */
+  uint64_t n;            /*!< Leaves absorbed so far */
+  unsigned char *part;   /*!< The partial leaf, B bytes */
+  size_t pnum;           /*!< Bytes in part */
+  unsigned char *cv;     /*!< PHASH_ROUND chaining values, only allocated for threaded rounds */
+  int state;             /*!< 0 not initialized, 1 absorbing, 2 finished */
+};
+
+/*! @brief A threaded round, one thread's share */
+typedef struct {
+  const EVP_MD *md;
+  const unsigned char *in; /*!< The first leaf */
+  size_t B;
+  size_t count;            /*!< Leaves */
+  size_t cvlen;
+  unsigned char *cv;       /*!< count chaining values */
+  int rv;                  /*!< 1 O.K. */
+  int started;             /*!< Running on thr */
+  ICC_Thread thr;
+} PHASH_SEG;
+
+/*! @brief Set the number of threads used for large ParallelHash inputs
+  @param n 1-PHASH_MAX_THREADS, 1 is single threaded
+*/
+static void SetPHashThreads(int n)
+{
+  if((n >= 1) && (n <= PHASH_MAX_THREADS)) {
+    phash_threads = n;
+  }
+}
+
+/*! @brief The number of threads a round may use */
+static size_t phash_nthreads(void)
+{
+  int n = phash_threads;
+
+  if(0 == n) {
+    n = ICC_GetCPUCount();
+    if(n > PHASH_MAX_THREADS) {
+      n = PHASH_MAX_THREADS;
+    }
+    if(n < 1) {
+      n = 1;
+    }
+    phash_threads = n;
+  }
+  return (size_t)n;
+}
+
+/*! @brief SP800-185 left_encode()/right_encode()
+  @param out 9 bytes at least
+  @param x the value
+  @param right 1 for right_encode()
+  @return the number of bytes used
+*/
+static size_t phash_encode(unsigned char *out, uint64_t x, int right)
+{
+  size_t n = 1;
+  size_t i = 0;
+  size_t off = right ? 0 : 1;
+
+  while((n < 8) && (0 != (x >> (8 * n)))) {
+    n++;
+  }
+  for(i = 0; i < n; i++) {
+    out[off + n - 1 - i] = (unsigned char)(x >> (8 * i));
+  }
+  out[right ? n : 0] = (unsigned char)n;
+  return n + 1;
+}
+
+/*! @brief Hash whole leaves
+  @param x a context to use
+  @param md SHAKE128 or SHAKE256
+  @param in the first leaf
+  @param B leaf size
+  @param count the number of leaves
+  @param cvlen chaining value length
+  @param cv count * cvlen bytes of output
+  @return 1 O.K., 0 otherwise
+*/
+static int phash_leaves(XOF_CTX *x,const EVP_MD *md,const unsigned char *in,
+                        size_t B,size_t count,size_t cvlen,unsigned char *cv)
+{
+  int rv = 1;
+  size_t i = 0;
+
+  for(i = 0; (1 == rv) && (i < count); i++) {
+    rv = XOF_CTX_Init(x,md) &&
+         XOF_CTX_Absorb(x,in + (i * B),B) &&
+         XOF_CTX_Squeeze(x,cv + (i * cvlen),cvlen);
+  }
+  return rv;
+}
+
+/*! @brief Hash one thread's share of a round */
+static int phash_segment(PHASH_SEG *seg)
+{
+  int rv = 0;
+  XOF_CTX *x = NULL;
+
+  x = XOF_CTX_new();
+  if(NULL != x) {
+    rv = phash_leaves(x,seg->md,seg->in,seg->B,seg->count,seg->cvlen,seg->cv);
+    XOF_CTX_free(x);
+  }
+  return rv;
+}
+
+static ICC_THREAD_RET ICC_THREAD_CALL phash_worker(void *arg)
+{
+  PHASH_SEG *seg = (PHASH_SEG *)arg;
+
+  seg->rv = phash_segment(seg);
+  return 0;
+}
+
+/*! @brief Hash count whole leaves from in and absorb the chaining values
+  @param ctx the context
+  @param in the first leaf
+  @param count the number of leaves, at most PHASH_ROUND
+  @return 1 O.K., 0 otherwise
+*/
+static int phash_round(PHASH_CTX *ctx,const unsigned char *in,size_t count)
+{
+  int rv = 1;
+  PHASH_SEG seg[PHASH_MAX_THREADS];
+  unsigned char cv[PHASH_MAX_CV];
+  size_t nthr = 0;
+  size_t per = 0;
+  size_t i = 0;
+  size_t done = 0;
+
+  nthr = (count * ctx->B) / PHASH_SEG_MIN;
+  if(nthr > phash_nthreads()) {
+    nthr = phash_nthreads();
+  }
+  if(nthr > count) {
+    nthr = count;
+  }
+  if((nthr > 1) && (NULL == ctx->cv)) {
+    ctx->cv = (unsigned char *)ICC_Malloc(PHASH_ROUND * PHASH_MAX_CV,__FILE__,__LINE__);
+  }
+  if((nthr < 2) || (NULL == ctx->cv)) {
+    for(i = 0; (1 == rv) && (i < count); i++) {
+      rv = phash_leaves(ctx->leaf,ctx->md,in + (i * ctx->B),ctx->B,1,ctx->cvlen,cv) &&
+           XOF_CTX_Absorb(ctx->outer,cv,ctx->cvlen);
+    }
+  } else {
+    per = count / nthr;
+    for(i = 0; i < nthr; i++) {
+      seg[i].md = ctx->md;
+      seg[i].B = ctx->B;
+      seg[i].cvlen = ctx->cvlen;
+      seg[i].in = in + (done * ctx->B);
+      seg[i].cv = ctx->cv + (done * ctx->cvlen);
+      seg[i].count = (i == (nthr - 1)) ? (count - done) : per;
+      seg[i].rv = 0;
+      seg[i].started = 0;
+      done += seg[i].count;
+      if(i > 0) {
+        seg[i].started = (0 == ICC_CreateThread(&(seg[i].thr),phash_worker,&seg[i]));
+      }
+    }
+    seg[0].rv = phash_leaves(ctx->leaf,ctx->md,seg[0].in,ctx->B,seg[0].count,ctx->cvlen,seg[0].cv);
+    for(i = 1; i < nthr; i++) {
+      if(seg[i].started) {
+        ICC_JoinThread(&(seg[i].thr));
+      } else {
+        seg[i].rv = phash_segment(&seg[i]);
+      }
+    }
+    for(i = 0; i < nthr; i++) {
+      if(1 != seg[i].rv) {
+        rv = 0;
+      }
+    }
+    if(1 == rv) {
+      rv = XOF_CTX_Absorb(ctx->outer,ctx->cv,count * ctx->cvlen);
+    }
+  }
+  if(1 == rv) {
+    ctx->n += count;
+  }
+  return rv;
+}
+
+/*! @brief Allocate a ParallelHash context
+  @return the context, or NULL
+*/
+PHASH_CTX *PHASH_CTX_new(void)
+{
+  PHASH_CTX *ctx = NULL;
+
+  ctx = (PHASH_CTX *)ICC_Calloc(1,sizeof(PHASH_CTX),__FILE__,__LINE__);
+  if(NULL != ctx) {
+    ctx->outer = XOF_CTX_new();
+    ctx->leaf = XOF_CTX_new();
+    if((NULL == ctx->outer) || (NULL == ctx->leaf)) {
+      PHASH_CTX_free(ctx);
+      ctx = NULL;
+    }
+  }
+  return ctx;
+}
+
+/*! @brief Free a ParallelHash context
+  @param ctx the context, may be NULL
+*/
+void PHASH_CTX_free(PHASH_CTX *ctx)
+{
+  if(NULL != ctx) {
+    XOF_CTX_free(ctx->outer);
+    XOF_CTX_free(ctx->leaf);
+    if(NULL != ctx->part) {
+      OPENSSL_cleanse(ctx->part,ctx->B);
+      ICC_Free(ctx->part);
+    }
+    if(NULL != ctx->cv) {
+      ICC_Free(ctx->cv);
+    }
+    ICC_Free(ctx);
+  }
+}
+
+/*! @brief Start a ParallelHash computation
+  @param ctx the context, may be reused
+  @param md SHAKE128 for ParallelHash128, SHAKE256 for ParallelHash256
+  @param B the leaf size, bytes
+  @param S customization string, may be NULL if Slen is 0
+  @param Slen length of S
+  @return 1 O.K., 0 otherwise
+*/
+int PHASH_CTX_Init(PHASH_CTX *ctx,const EVP_MD *md,size_t B,const unsigned char *S,size_t Slen)
+{
+  unsigned char enc[9];
+  size_t n = 0;
+
+  if((NULL == ctx) || (NULL == md) || (0 == B)) {
+    return 0;
+  }
+  ctx->state = 0;
+  switch(EVP_MD_type(md)) {
+  case NID_shake128:
+    ctx->cvlen = 32;
+    break;
+  case NID_shake256:
+    ctx->cvlen = 64;
+    break;
+  default:
+    return 0;
+  }
+  if((NULL != ctx->part) && (ctx->B != B)) {
+    OPENSSL_cleanse(ctx->part,ctx->B);
+    ICC_Free(ctx->part);
+    ctx->part = NULL;
+  }
+  if(NULL == ctx->part) {
+    ctx->part = (unsigned char *)ICC_Malloc(B,__FILE__,__LINE__);
+    if(NULL == ctx->part) {
+      return 0;
+    }
+  }
+  ctx->md = md;
+  ctx->B = B;
+  ctx->n = 0;
+  ctx->pnum = 0;
+  if(1 != XOF_CTX_InitCustom(ctx->outer,md,(const unsigned char *)"ParallelHash",12,S,Slen)) {
+    return 0;
+  }
+  n = phash_encode(enc,(uint64_t)B,0);
+  XOF_CTX_Absorb(ctx->outer,enc,n);
+  ctx->state = 1;
+  return 1;
+}
+
+/*! @brief Add input
+  @param ctx the context
+  @param in the input
+  @param inlen the length of the input, any size
+  @return 1 O.K., 0 otherwise
+*/
+int PHASH_CTX_Update(PHASH_CTX *ctx,const unsigned char *in,size_t inlen)
+{
+  int rv = 1;
+  size_t k = 0;
+  size_t count = 0;
+
+  if((NULL == ctx) || (1 != ctx->state) || ((NULL == in) && (0 != inlen))) {
+    return 0;
+  }
+  /* Finish a partial leaf first */
+  if(0 != ctx->pnum) {
+    k = ctx->B - ctx->pnum;
+    if(inlen < k) {
+      memcpy(ctx->part + ctx->pnum,in,inlen);
+      ctx->pnum += inlen;
+      return 1;
+    }
+    memcpy(ctx->part + ctx->pnum,in,k);
+    in += k;
+    inlen -= k;
+    ctx->pnum = 0;
+    rv = phash_round(ctx,ctx->part,1);
+  }
+  /* Whole leaves straight from the caller's buffer */
+  while((1 == rv) && (inlen >= ctx->B)) {
+    count = inlen / ctx->B;
+    if(count > PHASH_ROUND) {
+      count = PHASH_ROUND;
+    }
+    rv = phash_round(ctx,in,count);
+    in += count * ctx->B;
+    inlen -= count * ctx->B;
+  }
+  if((1 == rv) && (0 != inlen)) {
+    memcpy(ctx->part,in,inlen);
+    ctx->pnum = inlen;
+  }
+  if(1 != rv) {
+    ctx->state = 0;
+  }
+  return rv;
+}
+
+/*! @brief Finish, ParallelHash with an outlen * 8 bit result
+  @param ctx the context
+  @param out the result
+  @param outlen the number of bytes wanted
+  @return 1 O.K., 0 otherwise
+  @note The context must be initialized again before reuse
+*/
+int PHASH_CTX_Final(PHASH_CTX *ctx,unsigned char *out,size_t outlen)
+{
+  int rv = 1;
+  unsigned char cv[PHASH_MAX_CV];
+  unsigned char enc[9];
+  size_t n = 0;
+
+  if((NULL == ctx) || (1 != ctx->state) || (NULL == out) || (0 == outlen)) {
+    return 0;
+  }
+  /* The last leaf may be short */
+  if(0 != ctx->pnum) {
+    rv = phash_leaves(ctx->leaf,ctx->md,ctx->part,ctx->pnum,1,ctx->cvlen,cv) &&
+         XOF_CTX_Absorb(ctx->outer,cv,ctx->cvlen);
+    ctx->n++;
+    ctx->pnum = 0;
+  }
+  if(1 == rv) {
+    /* right_encode(n) || right_encode(L) */
+    n = phash_encode(enc,ctx->n,1);
+    XOF_CTX_Absorb(ctx->outer,enc,n);
+    n = phash_encode(enc,(uint64_t)outlen * 8,1);
+    XOF_CTX_Absorb(ctx->outer,enc,n);
+    rv = XOF_CTX_Squeeze(ctx->outer,out,outlen);
+  }
+  OPENSSL_cleanse(ctx->part,ctx->B);
+  ctx->state = 2;
+  return rv;
+}
@@ -16,7 +16,24 @@
    It sucks in macros which resolve to function references on older compilers
    and that in turn makes libicc.a directly dependent on openssl
 */
+#if defined(__linux) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* sched_getcpu() */
+#endif
 #include "platform.h"
+#if !defined(_WIN32)
+#include <time.h> /* nanosleep */
+#endif
+#if defined(__linux)
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ICC_MAX_CPUS 4096  /*!< CPU's we track the NUMA node of */
+#define ICC_MAX_NODES 256  /*!< Nodes we look for */
+
+static unsigned char cpu_node[ICC_MAX_CPUS]; /*!< NUMA node of each CPU */
+static int cpu_nodes = 0;                    /*!< Nodes found, 0 until ICC_GetNodeCount() */
+#endif
 
 #if defined(__OS2__)
     char LoadError[256];
@@ -90,6 +107,13 @@ ICCSTATIC int ICC_LockMutex(ICC_Mutex* mutexPtr)
     rc = ((rc == WAIT_OBJECT_0) ? 0 : GetLastError());
     return rc;
 }
+ICCSTATIC int ICC_TryLockMutex(ICC_Mutex* mutexPtr)
+{
+    int rc = 0;
+    rc = WaitForSingleObject(*mutexPtr, 0);
+    rc = ((rc == WAIT_OBJECT_0) ? 0 : 1);
+    return rc;
+}
 ICCSTATIC int ICC_UnlockMutex(ICC_Mutex* mutexPtr)
 {
     return (ReleaseMutex(*mutexPtr) ? 0 : GetLastError());
@@ -98,6 +122,100 @@ ICCSTATIC int ICC_DestroyMutex(ICC_Mutex* mutexPtr)
 {
     return (CloseHandle(*mutexPtr) ? 0 : GetLastError());
 }
+ICCSTATIC int ICC_GetCPUCount(void)
+{
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+}
+ICCSTATIC int ICC_GetCurrentCPU(int *node)
+{
+    int cpu = (int)GetCurrentProcessorNumber();
+    UCHAR n = 0;
+    if (NULL != node) {
+        *node = GetNumaProcessorNode((UCHAR)cpu, &n) ? (int)n : 0;
+    }
+    return cpu;
+}
+ICCSTATIC int ICC_GetNodeCount(void)
+{
+    ULONG h = 0;
+    return GetNumaHighestNodeNumber(&h) ? (int)h + 1 : 1;
+}
+ICCSTATIC int ICC_CreateThreadKey(ICC_ThreadKey* keyPtr, ICC_ThreadKeyDtor dtor)
+{
+    int rc = 0;
+    *keyPtr = FlsAlloc((PFLS_CALLBACK_FUNCTION)dtor);
+    rc = ((*keyPtr == FLS_OUT_OF_INDEXES) ? GetLastError() : 0);
+    return rc;
+}
+ICCSTATIC void* ICC_GetThreadValue(ICC_ThreadKey* keyPtr)
+{
+    return FlsGetValue(*keyPtr);
+}
+ICCSTATIC int ICC_SetThreadValue(ICC_ThreadKey* keyPtr, void *value)
+{
+    return (FlsSetValue(*keyPtr, value) ? 0 : GetLastError());
+}
+ICCSTATIC int ICC_DestroyThreadKey(ICC_ThreadKey* keyPtr)
+{
+    return (FlsFree(*keyPtr) ? 0 : GetLastError());
+}
+ICCSTATIC int ICC_CreateThread(ICC_Thread* thrPtr, ICC_ThreadFunc fn, void *arg)
+{
+    *thrPtr = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)fn, arg, 0, NULL);
+    return ((NULL == *thrPtr) ? GetLastError() : 0);
+}
+ICCSTATIC int ICC_JoinThread(ICC_Thread* thrPtr)
+{
+    int rc = 0;
+    rc = WaitForSingleObject(*thrPtr, INFINITE);
+    rc = ((rc == WAIT_OBJECT_0) ? 0 : 1);
+    CloseHandle(*thrPtr);
+    return rc;
+}
+ICCSTATIC int ICC_CreateSem(ICC_Sem* semPtr)
+{
+    *semPtr = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+    return ((NULL == *semPtr) ? GetLastError() : 0);
+}
+ICCSTATIC int ICC_PostSem(ICC_Sem* semPtr)
+{
+    return (ReleaseSemaphore(*semPtr, 1, NULL) ? 0 : GetLastError());
+}
+ICCSTATIC int ICC_WaitSem(ICC_Sem* semPtr, unsigned int ms)
+{
+    DWORD rc = WaitForSingleObject(*semPtr, (ICC_SEM_FOREVER == ms) ? INFINITE : ms);
+    return ((WAIT_OBJECT_0 == rc) ? 0 : 1);
+}
+ICCSTATIC int ICC_DestroySem(ICC_Sem* semPtr)
+{
+    return (CloseHandle(*semPtr) ? 0 : GetLastError());
+}
+ICCSTATIC void ICC_Sleep(unsigned int ms)
+{
+    Sleep(ms);
+}
+ICCSTATIC unsigned long long ICC_GetTimeUS(void)
+{
+    LARGE_INTEGER f, c;
+    unsigned long long rv = 0;
+    if (QueryPerformanceFrequency(&f) && QueryPerformanceCounter(&c) && (f.QuadPart > 0)) {
+        rv = (unsigned long long)(c.QuadPart / f.QuadPart) * 1000000ULL +
+             (unsigned long long)((c.QuadPart % f.QuadPart) * 1000000 / f.QuadPart);
+    }
+    return rv;
+}
+ICCSTATIC unsigned long long ICC_GetTimeNS(void)
+{
+    LARGE_INTEGER f, c;
+    unsigned long long rv = 0;
+    if (QueryPerformanceFrequency(&f) && QueryPerformanceCounter(&c) && (f.QuadPart > 0)) {
+        rv = (unsigned long long)(c.QuadPart / f.QuadPart) * 1000000000ULL +
+             (unsigned long long)((c.QuadPart % f.QuadPart) * 1000000000 / f.QuadPart);
+    }
+    return rv;
+}
 
 #elif defined(__linux) || defined(_AIX) || defined(__sun) || defined(__hpux) || defined(__APPLE__) || defined(__MVS__)
 
@@ -134,6 +252,10 @@ ICCSTATIC int ICC_LockMutex(ICC_Mutex* mutexPtr)
 {
     return pthread_mutex_lock(mutexPtr);
 }
+ICCSTATIC int ICC_TryLockMutex(ICC_Mutex* mutexPtr)
+{
+    return pthread_mutex_trylock(mutexPtr);
+}
 ICCSTATIC int ICC_UnlockMutex(ICC_Mutex* mutexPtr)
 {
     return pthread_mutex_unlock(mutexPtr);
@@ -144,6 +266,190 @@ ICCSTATIC int ICC_DestroyMutex(ICC_Mutex* mutexPtr)
     rc = pthread_mutex_destroy(mutexPtr);
     return rc;
 }
+ICCSTATIC int ICC_GetCPUCount(void)
+{
+    int n = 0;
+#if defined(_SC_NPROCESSORS_ONLN)
+    n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 0) {
+      n = 0;
+    }
+#endif
+    return n;
+}
+ICCSTATIC int ICC_GetCurrentCPU(int *node)
+{
+    int cpu = -1;
+#if defined(__linux)
+    cpu = sched_getcpu();
+    if (NULL != node) {
+        *node = ((cpu >= 0) && (cpu < ICC_MAX_CPUS)) ? (int)cpu_node[cpu] : 0;
+    }
+#else
+    if (NULL != node) {
+        *node = 0;
+    }
+#endif
+    return cpu;
+}
+/* Linux: each node's CPU's are listed in sysfs as ranges, "0-15,32-47" */
+ICCSTATIC int ICC_GetNodeCount(void)
+{
+#if defined(__linux)
+    char path[64];
+    char buf[1024];
+    FILE *f = NULL;
+    char *p = NULL;
+    int n = 0, a = 0, b = 0;
+
+    if (0 == cpu_nodes) {
+        memset(cpu_node, 0, sizeof(cpu_node));
+        cpu_nodes = 1;
+        for (n = 0; n < ICC_MAX_NODES; n++) {
+            sprintf(path, "/sys/devices/system/node/node%d/cpulist", n);
+            f = fopen(path, "r");
+            if (NULL == f) {
+                continue; /* Node numbers can have holes */
+            }
+            if (NULL != fgets(buf, sizeof(buf), f)) {
+                p = buf;
+                while ((*p >= '0') && (*p <= '9')) {
+                    a = b = (int)strtol(p, &p, 10);
+                    if ('-' == *p) {
+                        b = (int)strtol(p + 1, &p, 10);
+                    }
+                    for (; (a <= b) && (a < ICC_MAX_CPUS); a++) {
+                        cpu_node[a] = (unsigned char)n;
+                    }
+                    if (',' == *p) {
+                        p++;
+                    }
+                }
+            }
+            fclose(f);
+            cpu_nodes = n + 1;
+        }
+    }
+    return cpu_nodes;
+#else
+    return 1;
+#endif
+}
+ICCSTATIC int ICC_CreateThreadKey(ICC_ThreadKey* keyPtr, ICC_ThreadKeyDtor dtor)
+{
+    return pthread_key_create(keyPtr, dtor);
+}
+ICCSTATIC void* ICC_GetThreadValue(ICC_ThreadKey* keyPtr)
+{
+    return pthread_getspecific(*keyPtr);
+}
+ICCSTATIC int ICC_SetThreadValue(ICC_ThreadKey* keyPtr, void *value)
+{
+    return pthread_setspecific(*keyPtr, value);
+}
+ICCSTATIC int ICC_DestroyThreadKey(ICC_ThreadKey* keyPtr)
+{
+    return pthread_key_delete(*keyPtr);
+}
+ICCSTATIC int ICC_CreateThread(ICC_Thread* thrPtr, ICC_ThreadFunc fn, void *arg)
+{
+    return pthread_create(thrPtr, NULL, fn, arg);
+}
+ICCSTATIC int ICC_JoinThread(ICC_Thread* thrPtr)
+{
+    return pthread_join(*thrPtr, NULL);
+}
+ICCSTATIC int ICC_CreateSem(ICC_Sem* semPtr)
+{
+    int rc = 0;
+    semPtr->n = 0;
+    rc = pthread_mutex_init(&semPtr->m, NULL);
+    if (0 == rc) {
+        rc = pthread_cond_init(&semPtr->c, NULL);
+        if (0 != rc) {
+            pthread_mutex_destroy(&semPtr->m);
+        }
+    }
+    return rc;
+}
+ICCSTATIC int ICC_PostSem(ICC_Sem* semPtr)
+{
+    int rc = pthread_mutex_lock(&semPtr->m);
+    if (0 == rc) {
+        semPtr->n++;
+        rc = pthread_cond_signal(&semPtr->c);
+        pthread_mutex_unlock(&semPtr->m);
+    }
+    return rc;
+}
+ICCSTATIC int ICC_WaitSem(ICC_Sem* semPtr, unsigned int ms)
+{
+    int rc = 0;
+    struct timeval tv;
+    struct timespec ts;
+
+    if ((0 != ms) && (ICC_SEM_FOREVER != ms)) {
+        /* pthread_cond_timedwait() wants an absolute wall clock deadline */
+        gettimeofday(&tv, NULL);
+        ts.tv_sec = tv.tv_sec + ms / 1000;
+        ts.tv_nsec = (long)tv.tv_usec * 1000L + (long)(ms % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+    }
+    rc = pthread_mutex_lock(&semPtr->m);
+    if (0 == rc) {
+        while ((0 == semPtr->n) && (0 == rc)) {
+            if (0 == ms) {
+                rc = 1;
+            } else if (ICC_SEM_FOREVER == ms) {
+                rc = pthread_cond_wait(&semPtr->c, &semPtr->m);
+            } else {
+                rc = pthread_cond_timedwait(&semPtr->c, &semPtr->m, &ts);
+            }
+        }
+        if (0 != semPtr->n) {
+            semPtr->n--;
+            rc = 0;
+        }
+        pthread_mutex_unlock(&semPtr->m);
+    }
+    return rc;
+}
+ICCSTATIC int ICC_DestroySem(ICC_Sem* semPtr)
+{
+    int rc = pthread_cond_destroy(&semPtr->c);
+    pthread_mutex_destroy(&semPtr->m);
+    return rc;
+}
+ICCSTATIC void ICC_Sleep(unsigned int ms)
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+}
+ICCSTATIC unsigned long long ICC_GetTimeUS(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)(ts.tv_nsec / 1000);
+    }
+#endif
+    return (unsigned long long)time(NULL) * 1000000ULL;
+}
+ICCSTATIC unsigned long long ICC_GetTimeNS(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+    }
+#endif
+    return (unsigned long long)time(NULL) * 1000000000ULL;
+}
 
 /* There's a problem with RTLD_LOCAL on Apple, probably with how we link - look at "bundle" etc 
    and see if it can be fixed.
@@ -321,6 +627,10 @@ ICCSTATIC int ICC_LockMutex(ICC_Mutex* mutexPtr)
 {
     return pthread_mutex_lock(mutexPtr);
 }
+ICCSTATIC int ICC_TryLockMutex(ICC_Mutex* mutexPtr)
+{
+    return pthread_mutex_trylock(mutexPtr);
+}
 ICCSTATIC int ICC_UnlockMutex(ICC_Mutex* mutexPtr)
 {
     return pthread_mutex_unlock(mutexPtr);
@@ -331,6 +641,143 @@ ICCSTATIC int ICC_DestroyMutex(ICC_Mutex* mutexPtr)
     rc = pthread_mutex_destroy(mutexPtr);
     return rc;
 }
+ICCSTATIC int ICC_GetCPUCount(void)
+{
+    int n = 0;
+#if defined(_SC_NPROCESSORS_ONLN)
+    n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 0) {
+      n = 0;
+    }
+#endif
+    return n;
+}
+ICCSTATIC int ICC_GetCurrentCPU(int *node)
+{
+    if (NULL != node) {
+        *node = 0;
+    }
+    return -1;
+}
+ICCSTATIC int ICC_GetNodeCount(void)
+{
+    return 1;
+}
+ICCSTATIC int ICC_CreateThreadKey(ICC_ThreadKey* keyPtr, ICC_ThreadKeyDtor dtor)
+{
+    return pthread_key_create(keyPtr, dtor);
+}
+ICCSTATIC void* ICC_GetThreadValue(ICC_ThreadKey* keyPtr)
+{
+    return pthread_getspecific(*keyPtr);
+}
+ICCSTATIC int ICC_SetThreadValue(ICC_ThreadKey* keyPtr, void *value)
+{
+    return pthread_setspecific(*keyPtr, value);
+}
+ICCSTATIC int ICC_DestroyThreadKey(ICC_ThreadKey* keyPtr)
+{
+    return pthread_key_delete(*keyPtr);
+}
+ICCSTATIC int ICC_CreateThread(ICC_Thread* thrPtr, ICC_ThreadFunc fn, void *arg)
+{
+    return pthread_create(thrPtr, NULL, fn, arg);
+}
+ICCSTATIC int ICC_JoinThread(ICC_Thread* thrPtr)
+{
+    return pthread_join(*thrPtr, NULL);
+}
+ICCSTATIC int ICC_CreateSem(ICC_Sem* semPtr)
+{
+    int rc = 0;
+    semPtr->n = 0;
+    rc = pthread_mutex_init(&semPtr->m, NULL);
+    if (0 == rc) {
+        rc = pthread_cond_init(&semPtr->c, NULL);
+        if (0 != rc) {
+            pthread_mutex_destroy(&semPtr->m);
+        }
+    }
+    return rc;
+}
+ICCSTATIC int ICC_PostSem(ICC_Sem* semPtr)
+{
+    int rc = pthread_mutex_lock(&semPtr->m);
+    if (0 == rc) {
+        semPtr->n++;
+        rc = pthread_cond_signal(&semPtr->c);
+        pthread_mutex_unlock(&semPtr->m);
+    }
+    return rc;
+}
+ICCSTATIC int ICC_WaitSem(ICC_Sem* semPtr, unsigned int ms)
+{
+    int rc = 0;
+    struct timeval tv;
+    struct timespec ts;
+
+    if ((0 != ms) && (ICC_SEM_FOREVER != ms)) {
+        /* pthread_cond_timedwait() wants an absolute wall clock deadline */
+        gettimeofday(&tv, NULL);
+        ts.tv_sec = tv.tv_sec + ms / 1000;
+        ts.tv_nsec = (long)tv.tv_usec * 1000L + (long)(ms % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+    }
+    rc = pthread_mutex_lock(&semPtr->m);
+    if (0 == rc) {
+        while ((0 == semPtr->n) && (0 == rc)) {
+            if (0 == ms) {
+                rc = 1;
+            } else if (ICC_SEM_FOREVER == ms) {
+                rc = pthread_cond_wait(&semPtr->c, &semPtr->m);
+            } else {
+                rc = pthread_cond_timedwait(&semPtr->c, &semPtr->m, &ts);
+            }
+        }
+        if (0 != semPtr->n) {
+            semPtr->n--;
+            rc = 0;
+        }
+        pthread_mutex_unlock(&semPtr->m);
+    }
+    return rc;
+}
+ICCSTATIC int ICC_DestroySem(ICC_Sem* semPtr)
+{
+    int rc = pthread_cond_destroy(&semPtr->c);
+    pthread_mutex_destroy(&semPtr->m);
+    return rc;
+}
+ICCSTATIC void ICC_Sleep(unsigned int ms)
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+}
+ICCSTATIC unsigned long long ICC_GetTimeUS(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)(ts.tv_nsec / 1000);
+    }
+#endif
+    return (unsigned long long)time(NULL) * 1000000ULL;
+}
+ICCSTATIC unsigned long long ICC_GetTimeNS(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+    }
+#endif
+    return (unsigned long long)time(NULL) * 1000000000ULL;
+}
 ICCSTATIC void* ICC_LoadLibrary(const char* path)
 {
    return ((void *)OpenSrvpgm((char *) path));
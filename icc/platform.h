@@ -232,6 +232,51 @@ typedef pthread_mutex_t ICC_Mutex;
 
 #endif
 
+/* Thread local storage keys. 
+   The destructor registered with a key is called with the thread's value
+   when a thread exits. 
+   On Windows this is backed by fiber local storage (FlsAlloc) as that's
+   the only OS facility that calls back at thread exit, so destructors
+   must be declared ICC_TLS_CALLBACK to get the calling convention right.
+*/
+#if defined(_WIN32)
+  typedef DWORD ICC_ThreadKey;
+# define ICC_TLS_CALLBACK WINAPI
+#else
+  typedef pthread_key_t ICC_ThreadKey;
+# define ICC_TLS_CALLBACK
+#endif
+  typedef void (ICC_TLS_CALLBACK *ICC_ThreadKeyDtor)(void *);
+
+/* Internal worker threads. 
+   Thread functions must be declared 
+   static ICC_THREAD_RET ICC_THREAD_CALL fn(void *arg) and return 0.
+*/
+#if defined(_WIN32)
+  typedef HANDLE ICC_Thread;
+# define ICC_THREAD_RET DWORD
+# define ICC_THREAD_CALL WINAPI
+#else
+  typedef pthread_t ICC_Thread;
+# define ICC_THREAD_RET void *
+# define ICC_THREAD_CALL
+#endif
+  typedef ICC_THREAD_RET (ICC_THREAD_CALL *ICC_ThreadFunc)(void *);
+
+/* Counting semaphore, lets worker threads block until there's work 
+   rather than poll.
+*/
+#if defined(_WIN32)
+  typedef HANDLE ICC_Sem;
+#else
+  typedef struct {
+    pthread_mutex_t m;
+    pthread_cond_t c;
+    unsigned int n;
+  } ICC_Sem;
+#endif
+#define ICC_SEM_FOREVER 0xffffffffU /*!< ICC_WaitSem() timeout, don't time out */
+
 /* Maximum path allowed by the OS */
 #if defined(__MVS__) || defined(AS400)
 # define MAX_PATH 256
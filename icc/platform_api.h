@@ -98,6 +98,13 @@ ICCSTATIC int   ICC_CreateMutex(ICC_Mutex* mutexPtrRef);
 */
 ICCSTATIC int   ICC_LockMutex(ICC_Mutex* mutexPtr);
 
+/*!
+  @brief attempts to aquire a lock on the given mutex without blocking.
+  @param mutexPtr a pointer to the mutex to lock
+  @return  0 if the lock was taken, non-zero if it was busy or on failure
+*/
+ICCSTATIC int   ICC_TryLockMutex(ICC_Mutex* mutexPtr);
+
 /*!
   @brief releases a lock on the given mutex.
   @param mutexPtr a pointer to the mutex to unlock
@@ -114,6 +121,124 @@ ICCSTATIC int   ICC_UnlockMutex(ICC_Mutex* mutexPtr);
 */
 ICCSTATIC int   ICC_DestroyMutex(ICC_Mutex* mutexPtr);
 
+/*!
+  @brief Returns the number of online CPU's
+  @return the number of CPU's, or 0 if that can't be determined
+*/
+ICCSTATIC int   ICC_GetCPUCount(void);
+
+/*!
+  @brief Returns the CPU the caller is running on
+  @param node where to return that CPU's NUMA node, 0 if unknown. May be NULL
+  @return the CPU number, or -1 if that can't be determined
+  @note the caller may be migrated as soon as this returns.
+  Nodes are only known after ICC_GetNodeCount() has been called.
+*/
+ICCSTATIC int   ICC_GetCurrentCPU(int *node);
+
+/*!
+  @brief Returns the number of NUMA nodes, reads the topology on the first call
+  @return the node count, 1 if that can't be determined
+*/
+ICCSTATIC int   ICC_GetNodeCount(void);
+
+/*!
+  @brief Create a thread local storage key
+  @param keyPtr a pointer to the key to initialize
+  @param dtor a function called with a thread's (non-NULL) value at thread exit. 
+         May be NULL.
+  @return 0 on sucess, non-zero on failure
+*/
+ICCSTATIC int   ICC_CreateThreadKey(ICC_ThreadKey* keyPtr, ICC_ThreadKeyDtor dtor);
+
+/*!
+  @brief Return the calling thread's value for a thread local storage key
+  @param keyPtr a pointer to the key
+  @return the value last set by this thread or NULL
+*/
+ICCSTATIC void* ICC_GetThreadValue(ICC_ThreadKey* keyPtr);
+
+/*!
+  @brief Set the calling thread's value for a thread local storage key
+  @param keyPtr a pointer to the key
+  @param value the value to store
+  @return 0 on sucess, non-zero on failure
+*/
+ICCSTATIC int   ICC_SetThreadValue(ICC_ThreadKey* keyPtr, void *value);
+
+/*!
+  @brief destroy a thread local storage key
+  - Values held by other threads are NOT passed to the destructor on
+    Unix-like systems, on Windows they are. Callers which need to 
+    clean up must track their own allocations and cope with either behaviour.
+  @param keyPtr a pointer to the key to destroy
+  @return 0 on sucess, non-zero on failure
+*/
+ICCSTATIC int   ICC_DestroyThreadKey(ICC_ThreadKey* keyPtr);
+
+/*!
+  @brief Start a worker thread
+  @param thrPtr a pointer to the thread handle to initialize
+  @param fn the thread function
+  @param arg the argument passed to fn
+  @return 0 on sucess, non-zero on failure
+*/
+ICCSTATIC int   ICC_CreateThread(ICC_Thread* thrPtr, ICC_ThreadFunc fn, void *arg);
+
+/*!
+  @brief Wait for a worker thread to exit and release it
+  @param thrPtr a pointer to the thread handle
+  @return 0 on sucess, non-zero on failure
+*/
+ICCSTATIC int   ICC_JoinThread(ICC_Thread* thrPtr);
+
+/*!
+  @brief Create a counting semaphore, initially 0
+  @param semPtr a pointer to the semaphore to initialize
+  @return 0 on sucess, non-zero on failure
+*/
+ICCSTATIC int   ICC_CreateSem(ICC_Sem* semPtr);
+
+/*!
+  @brief Add one to a semaphore, wakes one waiter
+  @param semPtr a pointer to the semaphore
+  @return 0 on sucess, non-zero on failure
+*/
+ICCSTATIC int   ICC_PostSem(ICC_Sem* semPtr);
+
+/*!
+  @brief Wait for a semaphore to be non-zero and take one
+  @param semPtr a pointer to the semaphore
+  @param ms how long to wait in milliseconds, 0 to poll, ICC_SEM_FOREVER not to time out
+  @return 0 if one was taken, non-zero on a time out or failure
+*/
+ICCSTATIC int   ICC_WaitSem(ICC_Sem* semPtr, unsigned int ms);
+
+/*!
+  @brief destroy a semaphore, nothing may be waiting on it
+  @param semPtr a pointer to the semaphore
+  @return 0 on sucess, non-zero on failure
+*/
+ICCSTATIC int   ICC_DestroySem(ICC_Sem* semPtr);
+
+/*!
+  @brief Suspend the calling thread
+  @param ms the time to sleep in milliseconds
+*/
+ICCSTATIC void  ICC_Sleep(unsigned int ms);
+
+/*!
+  @brief A monotonic clock for measuring intervals
+  @return microseconds since an arbitrary start point
+*/
+ICCSTATIC unsigned long long ICC_GetTimeUS(void);
+/*!
+  @brief A monotonic clock for timing short calls
+  @return nanoseconds since an arbitrary start point, the resolution 
+  is whatever the platform clock gives
+*/
+ICCSTATIC unsigned long long ICC_GetTimeNS(void);
+
 #ifdef OS400
 void	* GetSrvpgmSymbol(unsigned long long * handle, char * symbolname);
 unsigned long long * OpenSrvpgm(const char * srvpgmName);
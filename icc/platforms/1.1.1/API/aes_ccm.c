@@ -9,7 +9,9 @@
 
 /* Note !
    AES-CCM is defined as a one-shot encrypt/mac operation
-   hence there's no AES_CCM_CTX, no Init/Update/Final
+   hence there's no Update/Final. 
+   The AES_CCM_CTX only exists to keep the cipher lookup and key
+   expansion across messages under the same key.
    It'll also eat a LOT of RAM for long messages.
 */
 #ifndef AES_DEBUG
@@ -160,4 +162,343 @@ int AES_CCM_Decrypt(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
   return rv;
 }
 
+/*! @brief Gather a fragment list into one buffer for CCM
+    @param v the fragments
+    @param n the number of fragments
+    @param p where to return a pointer to the contiguous data, NULL if there is none
+    @param len where to return the total length
+    @param tmp where to return an allocated buffer, NULL if the data was
+    used in place, free with OPENSSL_clear_free(*tmp,*len)
+    @return 1 if O.K., 0 on allocation failure
+    @note An input in one fragment is used in place. CCM processes
+    AAD and data in one pass, so only multi fragment input is copied.
+*/
+static int iov_gather(AES_IOV *v, unsigned int n, unsigned char **p,
+                      unsigned long *len, unsigned char **tmp)
+{
+  int rv = 1;
+  unsigned int i = 0;
+  unsigned int used = 0;
+  unsigned long l = 0;
+
+  *p = NULL;
+  *tmp = NULL;
+  *len = 0;
+  for (i = 0; (NULL != v) && (i < n); i++) {
+    if (v[i].len > 0) {
+      *p = v[i].base;
+      l += v[i].len;
+      used++;
+    }
+  }
+  if (used > 1) {
+    *p = *tmp = OPENSSL_malloc(l);
+    if (NULL != *tmp) {
+      l = 0;
+      for (i = 0; i < n; i++) {
+        if (v[i].len > 0) {
+          memcpy(*tmp + l, v[i].base, v[i].len);
+          l += v[i].len;
+        }
+      }
+    } else {
+      rv = 0;
+      l = 0;
+    }
+  }
+  *len = l;
+  return rv;
+}
+
+static int AES_CCM_commonV(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
+                           unsigned char *key,unsigned int keylen,
+                           AES_IOV *aad,unsigned int naad,
+                           AES_IOV *data,unsigned int ndata,
+                           unsigned char *out, unsigned long *outlen,
+                           unsigned int taglen,int enc
+                           )
+{
+  int rv = 0;
+  unsigned char *a = NULL, *atmp = NULL;
+  unsigned char *d = NULL, *dtmp = NULL;
+  unsigned long alen = 0, dlen = 0;
+
+  *outlen = 0;
+  if (iov_gather(aad, naad, &a, &alen, &atmp) &&
+      iov_gather(data, ndata, &d, &dlen, &dtmp)) {
+    rv = AES_CCM_common(pcb,iv,ivlen,
+                        key,keylen,
+                        a,alen,
+                        d,dlen,
+                        out,outlen,
+                        taglen,enc);
+  }
+  if (NULL != atmp) {
+    OPENSSL_clear_free(atmp, alen);
+  }
+  if (NULL != dtmp) {
+    OPENSSL_clear_free(dtmp, dlen);
+  }
+  return rv;
+}
+
+int AES_CCM_EncryptV(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
+                     unsigned char *key,unsigned int keylen,
+                     AES_IOV *aad,unsigned int naad,
+                     AES_IOV *data,unsigned int ndata,
+                     unsigned char *out, unsigned long *outlen,
+                     unsigned int taglen
+                     )
+{
+  return AES_CCM_commonV(pcb,iv,ivlen,key,keylen,aad,naad,data,ndata,
+                         out,outlen,taglen,1);
+}
+
+int AES_CCM_DecryptV(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
+                     unsigned char *key,unsigned int keylen,
+                     AES_IOV *aad,unsigned int naad,
+                     AES_IOV *data,unsigned int ndata,
+                     unsigned char *out, unsigned long *outlen,
+                     unsigned int taglen
+                     )
+{
+  return AES_CCM_commonV(pcb,iv,ivlen,key,keylen,aad,naad,data,ndata,
+                         out,outlen,taglen,0);
+}
+
+/* Note we need to look these up
+   because the accelerated and non-acclerated objects are different
+   and this has the capability probes done 
+   */
+static const EVP_CIPHER *ccm_128 = NULL;
+static const EVP_CIPHER *ccm_192 = NULL;
+static const EVP_CIPHER *ccm_256 = NULL;
+
+/*! @brief Create a reusable AES_CCM context
+    @return the context or NULL
+*/
+AES_CCM_CTX *AES_CCM_CTX_new(void)
+{
+  AES_CCM_CTX_t *c = NULL;
+
+  c = OPENSSL_malloc(sizeof(AES_CCM_CTX_t));
+  if (NULL != c) {
+    memset(c, 0, sizeof(AES_CCM_CTX_t));
+    c->ctx[0] = EVP_CIPHER_CTX_new();
+    c->ctx[1] = EVP_CIPHER_CTX_new();
+    if ((NULL == c->ctx[0]) || (NULL == c->ctx[1])) {
+      AES_CCM_CTX_free((AES_CCM_CTX *)c);
+      c = NULL;
+    }
+  }
+  return (AES_CCM_CTX *)c;
+}
+
+/*! @brief Free an AES_CCM context
+    @param ctx the context, may be NULL
+*/
+void AES_CCM_CTX_free(AES_CCM_CTX *ctx)
+{
+  AES_CCM_CTX_t *c = (AES_CCM_CTX_t *)ctx;
 
+  if (NULL != c) {
+    if (NULL != c->ctx[0]) {
+      EVP_CIPHER_CTX_free(c->ctx[0]);
+    }
+    if (NULL != c->ctx[1]) {
+      EVP_CIPHER_CTX_free(c->ctx[1]);
+    }
+    OPENSSL_cleanse(c, sizeof(AES_CCM_CTX_t));
+    OPENSSL_free(c);
+  }
+}
+
+/*! @brief Set the key and tag length for following AES_CCM_Seal()/AES_CCM_Open() calls
+    @param pcb The internal ICC_CTX
+    @param ctx an AES_CCM_CTX
+    @param key an aes key 16,24 or 32 bytes long
+    @param keylen the length of the key
+    @param taglen the tag length, 4,6,8,10,12,14 or 16
+    @return 1 if O.K., 0 otherwise
+    @note The key is expanded on the first Seal() and the first Open(), and  
+    again only if the IV (nonce) length changes as CCM bakes that into the key setup
+*/
+int AES_CCM_Init(ICClib *pcb, AES_CCM_CTX *ctx, unsigned char *key,
+                 unsigned int keylen, unsigned int taglen)
+{
+  AES_CCM_CTX_t *c = (AES_CCM_CTX_t *)ctx;
+  const EVP_CIPHER *cip = NULL;
+  int rv = 0;
+
+  switch (keylen) {
+  case 16:
+    if (NULL == ccm_128) {
+      ccm_128 = EVP_get_cipherbyname("aes-128-ccm");
+    }
+    cip = ccm_128;
+    break;
+  case 24:
+    if (NULL == ccm_192) {
+      ccm_192 = EVP_get_cipherbyname("aes-192-ccm");
+    }
+    cip = ccm_192;
+    break;
+  case 32:
+    if (NULL == ccm_256) {
+      ccm_256 = EVP_get_cipherbyname("aes-256-ccm");
+    }
+    cip = ccm_256;
+    break;
+  default:
+    break;
+  }
+  if ((NULL != c) && (NULL != key) && (NULL != cip) &&
+      (taglen >= 4) && (taglen <= 16) && (0 == (taglen & 1))) {
+    c->cipher = cip;
+    memcpy(c->key, key, keylen);
+    c->klen = keylen;
+    c->taglen = taglen;
+    c->ivlen[0] = c->ivlen[1] = 0; /* Not keyed yet */
+    rv = 1;
+  }
+  if ((1 == rv) && pcb && pcb->callback) {
+    pcb->callback("AES_CCM_Init", EVP_CIPHER_type(cip), 1);
+  }
+  return rv;
+}
+
+/*! @brief Start a message, rekey only if the IV length changed 
+    @param c an AES_CCM_CTX
+    @note Encrypt and decrypt each have their own EVP context, OpenSSL
+    won't switch direction on a keyed CCM context without a new key
+    @param iv the IV (nonce) 7-13 bytes
+    @param ivlen the length of the IV
+    @param enc 1 encrypt, 0 decrypt
+    @return 1 if O.K., 0 otherwise
+*/
+static int ccm_start(AES_CCM_CTX_t *c, unsigned char *iv, unsigned int ivlen,
+                     int enc)
+{
+  int rv = 0;
+
+  if ((NULL != c->cipher) && (NULL != iv)) {
+    if (ivlen == c->ivlen[enc]) {
+      rv = EVP_CipherInit_ex(c->ctx[enc], NULL, NULL, NULL, iv, enc);
+    } else {
+      c->ivlen[enc] = 0;
+      rv = EVP_CipherInit_ex(c->ctx[enc], c->cipher, NULL, NULL, NULL, enc);
+      if (1 == rv) {
+        rv = EVP_CIPHER_CTX_ctrl(c->ctx[enc], EVP_CTRL_AEAD_SET_IVLEN, ivlen, 0);
+      }
+      if (1 == rv) {
+        rv = EVP_CIPHER_CTX_ctrl(c->ctx[enc], EVP_CTRL_AEAD_SET_TAG, c->taglen, NULL);
+      }
+      if (1 == rv) {
+        rv = EVP_CipherInit_ex(c->ctx[enc], NULL, NULL, c->key, iv, enc);
+      }
+      if (1 == rv) {
+        c->ivlen[enc] = ivlen;
+      }
+    }
+  }
+  return rv;
+}
+
+/*! @brief The body of AES_CCM_Seal()/AES_CCM_Open() */
+static int AES_CCM_ctx_common(AES_CCM_CTX_t *c, unsigned char *iv,
+                              unsigned int ivlen,
+                              unsigned char *aad, unsigned long aadlen,
+                              unsigned char *data, unsigned long datalen,
+                              unsigned char *out, unsigned long *outlen,
+                              int enc)
+{
+  int rv = 0;
+  int chunklen = 0;
+  unsigned char tag[16];
+  static unsigned char empty[1] = {0};
+  EVP_CIPHER_CTX *ctx = NULL;
+
+  *outlen = 0;
+  if (NULL == data) {
+    data = empty; /* OpenSSL only computes the tag if it's given an input */
+    datalen = 0;
+  }
+  if ((NULL != c) && (enc || (datalen >= c->taglen))) {
+    if (!enc) {
+      datalen -= c->taglen;
+      memcpy(tag, data + datalen, c->taglen);
+    }
+    enc = enc ? 1 : 0;
+    ctx = c->ctx[enc];
+    rv = ccm_start(c, iv, ivlen, enc);
+    if ((1 == rv) && !enc) {
+      rv = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, c->taglen, tag);
+    }
+    if (1 == rv) {
+      rv = EVP_CipherUpdate(ctx, NULL, &chunklen, NULL, datalen);
+    }
+    if ((1 == rv) && (NULL != aad) && (aadlen > 0)) {
+      rv = EVP_CipherUpdate(ctx, NULL, &chunklen, aad, aadlen);
+    }
+    if (1 == rv) {
+      chunklen = 0;
+      rv = EVP_CipherUpdate(ctx, out, &chunklen, data, datalen);
+      *outlen = chunklen;
+    }
+    if (enc && (1 == rv)) {
+      rv = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, c->taglen, out + *outlen);
+      *outlen += c->taglen;
+    }
+    if (1 != rv) {
+      if (!enc && (NULL != out)) {
+        memset(out, 0, datalen);
+      }
+      *outlen = 0;
+      rv = 0;
+    }
+  }
+  return rv;
+}
+
+/*! @brief AES CCM encrypt with a reusable context
+    @param ctx an AES_CCM_CTX set up with AES_CCM_Init()
+    @param iv the IV (nonce) 7-13 bytes
+    @param ivlen the length of the IV
+    @param aad additional authentication data, may be NULL
+    @param aadlen the length of the aad
+    @param data the plaintext
+    @param datalen the length of the plaintext
+    @param out the output buffer, at least datalen + taglen bytes, 
+    receives ciphertext || tag
+    @param outlen a place to store the output length
+    @return 1 if O.K., 0 otherwise
+*/
+int AES_CCM_Seal(AES_CCM_CTX *ctx, unsigned char *iv, unsigned int ivlen,
+                 unsigned char *aad, unsigned long aadlen,
+                 unsigned char *data, unsigned long datalen,
+                 unsigned char *out, unsigned long *outlen)
+{
+  return AES_CCM_ctx_common((AES_CCM_CTX_t *)ctx, iv, ivlen, aad, aadlen,
+                            data, datalen, out, outlen, 1);
+}
+
+/*! @brief AES CCM decrypt with a reusable context
+    @param ctx an AES_CCM_CTX set up with AES_CCM_Init()
+    @param iv the IV (nonce) 7-13 bytes
+    @param ivlen the length of the IV
+    @param aad additional authentication data, may be NULL
+    @param aadlen the length of the aad
+    @param data ciphertext || tag
+    @param datalen the length of the ciphertext and tag
+    @param out the output buffer, at least datalen - taglen bytes
+    @param outlen a place to store the plaintext length
+    @return 1 if the tag matched, 0 otherwise, the output is cleared on failure
+*/
+int AES_CCM_Open(AES_CCM_CTX *ctx, unsigned char *iv, unsigned int ivlen,
+                 unsigned char *aad, unsigned long aadlen,
+                 unsigned char *data, unsigned long datalen,
+                 unsigned char *out, unsigned long *outlen)
+{
+  return AES_CCM_ctx_common((AES_CCM_CTX_t *)ctx, iv, ivlen, aad, aadlen,
+                            data, datalen, out, outlen, 0);
+}
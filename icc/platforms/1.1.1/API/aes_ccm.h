@@ -15,6 +15,32 @@
 extern "C" {
 #endif
 
+/*! @brief A reusable AES_CCM context, keeps the cipher and expanded key between messages */
+typedef struct AES_CCM_struct {
+  EVP_CIPHER_CTX *ctx[2];     /*!< OpenSSL's underlying CCM contexts, [0] decrypt, [1] encrypt */
+  const EVP_CIPHER *cipher;   /*!< cipher used */
+  unsigned char key[32];      /*!< The key, needed again if the IV length changes */
+  unsigned int klen;          /*!< Key length */
+  unsigned int taglen;        /*!< Tag length */
+  unsigned int ivlen[2];      /*!< IV length ctx[] is keyed for, 0 if not keyed */
+} AES_CCM_CTX_t;
+
+typedef struct AES_CCM_CTX_t AES_CCM_CTX;
+
+AES_CCM_CTX *AES_CCM_CTX_new(void);
+void AES_CCM_CTX_free(AES_CCM_CTX *ctx);
+int AES_CCM_Init(ICClib *pcb,AES_CCM_CTX *ctx,
+                 unsigned char *key,unsigned int keylen,
+                 unsigned int taglen);
+int AES_CCM_Seal(AES_CCM_CTX *ctx,unsigned char *iv,unsigned int ivlen,
+                 unsigned char *aad, unsigned long aadlen,
+                 unsigned char *data,unsigned long datalen,
+                 unsigned char *out, unsigned long *outlen);
+int AES_CCM_Open(AES_CCM_CTX *ctx,unsigned char *iv,unsigned int ivlen,
+                 unsigned char *aad, unsigned long aadlen,
+                 unsigned char *data,unsigned long datalen,
+                 unsigned char *out, unsigned long *outlen);
+
 int AES_CCM_Encrypt(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
                     unsigned char *key,unsigned int keylen,
                     unsigned char *aad, unsigned long aadlen,
@@ -33,6 +59,22 @@ int AES_CCM_Decrypt(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
                     );
 
 
+int AES_CCM_EncryptV(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
+                     unsigned char *key,unsigned int keylen,
+                     AES_IOV *aad,unsigned int naad,
+                     AES_IOV *data,unsigned int ndata,
+                     unsigned char *out, unsigned long *outlen,
+                     unsigned int taglen
+                     );
+
+int AES_CCM_DecryptV(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
+                     unsigned char *key,unsigned int keylen,
+                     AES_IOV *aad,unsigned int naad,
+                     AES_IOV *data,unsigned int ndata,
+                     unsigned char *out, unsigned long *outlen,
+                     unsigned int taglen
+                     );
+
 #ifdef __cplusplus
 }
 #endif
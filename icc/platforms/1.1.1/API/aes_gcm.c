@@ -23,6 +23,7 @@
 #include "openssl/rand.h"
 
 #include "icclib.h"
+#include "icc_probes.h"
 /*
 #include "aes_gcm.h"
 */
@@ -128,6 +129,123 @@ int AES_GCM_GenerateIV_NIST(AES_GCM_CTX *gcm_ctx, int ivlen,
   }
   return rv;
 }
+/* 64 bit atomic add where the compiler has it, otherwise a lock */
+#if defined(__GNUC__) && defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && (2 == __GCC_ATOMIC_LLONG_LOCK_FREE)
+#define IVGEN_NEXT(g) __atomic_fetch_add(&((g)->count), 1ULL, __ATOMIC_RELAXED)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h>
+#define IVGEN_NEXT(g) ((unsigned long long)_InterlockedIncrement64((volatile __int64 *)&((g)->count)) - 1ULL)
+#endif
+
+/** 
+    @brief Create a deterministic IV generator (SP800-38D 8.2.1)
+    @param fixed the fixed field, i.e. a device/connection identifier,
+    NULL for 4 random bytes
+    @param fixedlen length of the fixed field, 4 - 8 bytes
+    @return the generator or NULL
+    @note One generator per key. IV's are the fixed field followed by a 64 bit
+    big endian invocation field which starts at a random value and is
+    incremented atomically, so threads can share a generator without locking
+    and no cipher operation is done per IV.
+*/
+AES_GCM_IVGEN *AES_GCM_IVGEN_new(unsigned char *fixed, unsigned int fixedlen)
+{
+  AES_GCM_IVGEN_t *g = NULL;
+  unsigned char tmp[8];
+  int i = 0;
+
+  if (NULL == fixed) {
+    fixedlen = 4;
+  }
+  if ((fixedlen >= 4) && (fixedlen <= (IVBLEN - 8))) {
+    g = OPENSSL_malloc(sizeof(AES_GCM_IVGEN_t));
+  }
+  if (NULL != g) {
+    memset(g, 0, sizeof(AES_GCM_IVGEN_t));
+    g->fixedlen = fixedlen;
+    if (NULL != fixed) {
+      memcpy(g->fixed, fixed, fixedlen);
+    } else if (1 != RAND_bytes(g->fixed, fixedlen)) {
+      OPENSSL_free(g);
+      g = NULL;
+    }
+  }
+  if (NULL != g) {
+    if (1 == RAND_bytes(tmp, sizeof(tmp))) {
+      for (i = 0; i < sizeof(tmp); i++) {
+        g->start = (g->start << 8) | tmp[i];
+      }
+    } else {
+      OPENSSL_free(g);
+      g = NULL;
+    }
+    memset(tmp, 0, sizeof(tmp));
+  }
+#if !defined(IVGEN_NEXT)
+  if (NULL != g) {
+    g->lock = CRYPTO_THREAD_lock_new();
+    if (NULL == g->lock) {
+      OPENSSL_free(g);
+      g = NULL;
+    }
+  }
+#endif
+  return (AES_GCM_IVGEN *)g;
+}
+
+/** 
+    @brief Get the next IV from a deterministic IV generator
+    @param gen the generator
+    @param iv buffer for the IV
+    @param ivlen length of the IV, must be fixedlen + 8 (12 with a 4 byte fixed field)
+    @return 1 if O.K. 0 if ivlen is wrong or AES_GCM_IVGEN_MAX IV's have been 
+     generated, the key must be changed and a new generator used.
+*/
+int AES_GCM_IVGEN_generate(AES_GCM_IVGEN *gen, unsigned char *iv, unsigned int ivlen)
+{
+  AES_GCM_IVGEN_t *g = (AES_GCM_IVGEN_t *)gen;
+  unsigned long long n = 0;
+  int rv = 0;
+  int i = 0;
+
+  if ((NULL != g) && (NULL != iv) && (ivlen == g->fixedlen + 8)) {
+#if defined(IVGEN_NEXT)
+    n = IVGEN_NEXT(g);
+#else
+    CRYPTO_THREAD_write_lock(g->lock);
+    n = g->count++;
+    CRYPTO_THREAD_unlock(g->lock);
+#endif
+    if (n < AES_GCM_IVGEN_MAX) {
+      memcpy(iv, g->fixed, g->fixedlen);
+      n += g->start;
+      for (i = 7; i >= 0; i--) {
+        iv[g->fixedlen + i] = (unsigned char)(n & 0xff);
+        n >>= 8;
+      }
+      rv = 1;
+    }
+  }
+  return rv;
+}
+
+/** 
+    @brief Free a deterministic IV generator
+    @param gen the generator
+*/
+void AES_GCM_IVGEN_free(AES_GCM_IVGEN *gen)
+{
+  AES_GCM_IVGEN_t *g = (AES_GCM_IVGEN_t *)gen;
+
+  if (NULL != g) {
+    if (NULL != g->lock) {
+      CRYPTO_THREAD_lock_free(g->lock);
+    }
+    memset(g, 0, sizeof(AES_GCM_IVGEN_t));
+    OPENSSL_free(g);
+  }
+}
+
 /** 
     @brief IV generator for AES_GCM IV's
     @param gcm_ctx An AES_GCM context
@@ -199,6 +317,442 @@ int AES_GCM_GenerateIV(AES_GCM_CTX *gcm_ctx,unsigned char out[8])
 
 
 
+#if defined(__s390__) && !defined(__MVS__) && !defined(OPENSSL_NO_ASM)
+/*
+  Direct KMA (CPACF Message-Security-Assist 8) path for AES-GCM.
+  OpenSSL's EVP GCM on s390x also ends up in KMA, but this skips the
+  EVP ctrl/dispatch per call and keeps the parameter block in our context.
+  Mirrors the non-TLS code in OpenSSL's crypto/evp/e_aes.c 
+  Code is big-endian.
+*/
+#define AES_GCM_KMA 1
+
+extern void s390x_km(const unsigned char *in, size_t len, unsigned char *out,
+                     unsigned int fc, void *param);
+extern void s390x_kma(const unsigned char *aad, size_t alen,
+                      const unsigned char *in, size_t len, unsigned char *out,
+                      unsigned int fc, void *param);
+
+/* Constants from s390x_arch.h */
+#define CS390X_AES_128  18
+#define CS390X_DECRYPT  0x80
+#define CS390X_KMA_LPC  0x100
+#define CS390X_KMA_LAAD 0x200
+#define CS390X_KMA_HS   0x400
+
+#define KMA_AES_FC(keylen) (CS390X_AES_128 + ((((keylen) << 3) - 128) >> 6))
+
+/*! @brief State for the direct KMA path */
+typedef struct {
+  union {
+    double align;
+    /*! KMA-GCM-AES parameter block 
+      (see z/Architecture Principles of Operation >= SA22-7832-11) */
+    struct {
+      unsigned char reserved[12];
+      union {
+        unsigned int w;
+        unsigned char b[4];
+      } cv;
+      union {
+        unsigned long long g[2];
+        unsigned char b[16];
+      } t;
+      unsigned char h[16];
+      unsigned long long taadl;
+      unsigned long long tpcl;
+      union {
+        unsigned long long g[2];
+        unsigned int w[4];
+      } j0;
+      unsigned char k[32];
+    } param;
+  } kma;
+  unsigned int fc;          /*!< Function code and flags */
+  unsigned char ares[16];   /*!< aad residue */
+  unsigned char mres[16];   /*!< data residue, hashed at the next block or Final */
+  unsigned char kres[16];   /*!< key stream for the data residue */
+  int areslen;
+  int mreslen;
+} KMA_GCM_t;
+
+/*! @brief Check the same capability OS_helpers() gates "AES-GCM" on 
+    @return 1 if KMA can do GCM with all AES key sizes 
+*/
+static int kma_capable(void)
+{
+  return (OS_CpuFeatures() & ICC_CPUF_CPACF_KMA) ? 1 : 0;
+}
+
+/*! @brief Start a message on the KMA path, set the key if needed, and 
+    compute J0 from the IV 
+    @param a an AES_GCM_CTX context
+    @param enc 1 encrypt, 0 decrypt
+    @return 1 if O.K., 0 otherwise
+*/
+static int kma_start(AES_GCM_CTX_t *a, int enc)
+{
+  KMA_GCM_t *k = (KMA_GCM_t *)a->direct;
+  unsigned char blk[32];
+  unsigned long long bits = 0;
+  unsigned long n = 0;
+  int i = 0;
+
+  if ((16 != a->klen) && (24 != a->klen) && (32 != a->klen)) {
+    return 0;
+  }
+  if (NULL == a->iv || 0 == a->ivlen) {
+    return 0;
+  }
+  if (!a->keyed) {
+    memcpy(k->kma.param.k, a->key, a->klen);
+    k->fc = KMA_AES_FC(a->klen); /* No HS, KMA derives H on the next call */
+    a->keyed = 1;
+  }
+  k->fc = (k->fc & CS390X_KMA_HS) | KMA_AES_FC(a->klen) | (enc ? 0 : CS390X_DECRYPT);
+
+  k->kma.param.t.g[0] = 0;
+  k->kma.param.t.g[1] = 0;
+  k->kma.param.tpcl = 0;
+  k->kma.param.taadl = 0;
+  k->areslen = 0;
+  k->mreslen = 0;
+
+  if (12 == a->ivlen) {
+    memcpy(&k->kma.param.j0, a->iv, 12);
+    k->kma.param.j0.w[3] = 1;
+    k->kma.param.cv.w = 1;
+  } else {
+    /* J0 = GHASH(IV || 0 pad || 0^64 || [len(IV)]64) */
+    n = a->ivlen & ~15UL;
+    if (n) {
+      s390x_kma(a->iv, n, NULL, 0, NULL, k->fc, &k->kma.param);
+      k->fc |= CS390X_KMA_HS;
+    }
+    memset(blk, 0, sizeof(blk));
+    memcpy(blk, a->iv + n, a->ivlen - n);
+    i = (a->ivlen - n) ? 16 : 0;
+    bits = (unsigned long long)a->ivlen << 3;
+    memcpy(blk + i + 8, &bits, 8);
+    s390x_kma(blk, i + 16, NULL, 0, NULL, k->fc, &k->kma.param);
+    k->fc |= CS390X_KMA_HS;
+
+    k->kma.param.j0.g[0] = k->kma.param.t.g[0];
+    k->kma.param.j0.g[1] = k->kma.param.t.g[1];
+    k->kma.param.cv.w = k->kma.param.j0.w[3];
+    k->kma.param.t.g[0] = 0;
+    k->kma.param.t.g[1] = 0;
+  }
+  return 1;
+}
+
+/*! @brief Hash aad on the KMA path, whole blocks go to KMA, 
+    the rest is held until more aad, data or Final arrives
+    @param k KMA state
+    @param aad the aad
+    @param len length of the aad
+    @return 1 if O.K., 0 if data has already been processed or aad is too long
+*/
+static int kma_aad(KMA_GCM_t *k, const unsigned char *aad, size_t len)
+{
+  unsigned long long alen = 0;
+  int n = 0;
+  int rem = 0;
+
+  if (k->kma.param.tpcl) {
+    return 0;
+  }
+  alen = k->kma.param.taadl + len;
+  if (alen > (1ULL << 61) || alen < len) {
+    return 0;
+  }
+  k->kma.param.taadl = alen;
+
+  n = k->areslen;
+  if (n) {
+    while (n && len) {
+      k->ares[n] = *aad;
+      n = (n + 1) & 0xf;
+      ++aad;
+      --len;
+    }
+    /* ares is a complete block if the offset wrapped */
+    if (!n) {
+      s390x_kma(k->ares, 16, NULL, 0, NULL, k->fc, &k->kma.param);
+      k->fc |= CS390X_KMA_HS;
+    }
+    k->areslen = n;
+  }
+  rem = len & 0xf;
+  len &= ~(size_t)0xf;
+  if (len) {
+    s390x_kma(aad, len, NULL, 0, NULL, k->fc, &k->kma.param);
+    aad += len;
+    k->fc |= CS390X_KMA_HS;
+  }
+  if (rem) {
+    k->areslen = rem;
+    memcpy(k->ares, aad, rem);
+  }
+  return 1;
+}
+
+/*! @brief En/decrypt and hash data on the KMA path. Whole blocks go 
+    through KMA, a partial last block is en/decrypted now and 
+    hashed once it's completed or at Final
+    @param k KMA state
+    @param in input
+    @param out output, all of len is always written
+    @param len length of in
+    @return 1 if O.K., 0 if the message is too long
+*/
+static int kma_data(KMA_GCM_t *k, const unsigned char *in,
+                    unsigned char *out, size_t len)
+{
+  const unsigned char *inptr = NULL;
+  unsigned long long mlen = 0;
+  union {
+    unsigned int w[4];
+    unsigned char b[16];
+  } buf;
+  size_t inlen = 0;
+  int n = 0;
+  int rem = 0;
+  int i = 0;
+
+  mlen = k->kma.param.tpcl + len;
+  if (mlen > ((1ULL << 36) - 32) || mlen < len) {
+    return 0;
+  }
+  k->kma.param.tpcl = mlen;
+
+  n = k->mreslen;
+  if (n) {
+    inptr = in;
+    inlen = len;
+    while (n && inlen) {
+      k->mres[n] = *inptr;
+      n = (n + 1) & 0xf;
+      ++inptr;
+      --inlen;
+    }
+    /* mres is a complete block if the offset wrapped */
+    if (!n) {
+      s390x_kma(k->ares, k->areslen, k->mres, 16, buf.b,
+                k->fc | CS390X_KMA_LAAD, &k->kma.param);
+      k->fc |= CS390X_KMA_HS;
+      k->areslen = 0;
+      /* The head of this block was returned by the previous call */
+      n = k->mreslen;
+      while (n) {
+        *out = buf.b[n];
+        n = (n + 1) & 0xf;
+        ++out;
+        ++in;
+        --len;
+      }
+      k->mreslen = 0;
+    }
+  }
+  rem = len & 0xf;
+  len &= ~(size_t)0xf;
+  if (len) {
+    s390x_kma(k->ares, k->areslen, in, len, out,
+              k->fc | CS390X_KMA_LAAD, &k->kma.param);
+    in += len;
+    out += len;
+    k->fc |= CS390X_KMA_HS;
+    k->areslen = 0;
+  }
+  /* Remainder, en/decrypt it now with the next counter block, KMA hashes
+     it later */
+  if (rem) {
+    if (!k->mreslen) {
+      buf.w[0] = k->kma.param.j0.w[0];
+      buf.w[1] = k->kma.param.j0.w[1];
+      buf.w[2] = k->kma.param.j0.w[2];
+      buf.w[3] = k->kma.param.cv.w + 1;
+      s390x_km(buf.b, 16, k->kres, k->fc & 0x1f, &k->kma.param.k);
+    }
+    n = k->mreslen;
+    for (i = 0; i < rem; i++) {
+      k->mres[n + i] = in[i];
+      out[i] = in[i] ^ k->kres[n + i];
+    }
+    k->mreslen += rem;
+  }
+  return 1;
+}
+
+/*! @brief Complete the hash on the KMA path
+    @param k KMA state
+    @return the (16 byte) tag, in the parameter block
+*/
+static const unsigned char *kma_final(KMA_GCM_t *k)
+{
+  unsigned char tmp[16];
+
+  k->kma.param.taadl <<= 3;
+  k->kma.param.tpcl <<= 3;
+  s390x_kma(k->ares, k->areslen, k->mres, k->mreslen, tmp,
+            k->fc | CS390X_KMA_LAAD | CS390X_KMA_LPC, &k->kma.param);
+  /* Already en/decrypted and returned */
+  OPENSSL_cleanse(tmp, sizeof(tmp));
+  k->areslen = 0;
+  k->mreslen = 0;
+  return k->kma.param.t.b;
+}
+
+/*! @brief The AES_GCM_En/DecryptUpdate() body for the KMA path 
+    @return 1 if O.K., 0 otherwise
+    @note The direction was fixed by kma_start()
+*/
+static int kma_update(AES_GCM_CTX_t *a, unsigned char *aad,
+                      unsigned long aadlen, unsigned char *data,
+                      unsigned long datalen, unsigned char *out,
+                      unsigned long *outlen)
+{
+  KMA_GCM_t *k = (KMA_GCM_t *)a->direct;
+  int rv = 1;
+
+  if (NULL != aad) {
+    rv = kma_aad(k, aad, aadlen);
+  }
+  if ((1 == rv) && (NULL != data)) {
+    rv = kma_data(k, data, out, datalen);
+    if ((1 == rv) && (NULL != outlen)) {
+      *outlen = datalen;
+    }
+  }
+  return rv;
+}
+#endif
+
+#if (defined(__powerpc64__) || defined(_ARCH_PPC64)) && !defined(OPENSSL_NO_ASM)
+/*
+  Direct POWER8 path for AES-GCM, vcipher AES (aesp8-ppc) and vpmsumd 
+  GHASH (ghashp8-ppc) via CRYPTO_gcm128. OpenSSL's EVP GCM ends up in the 
+  same assembler, this skips the EVP ctrl/dispatch per call and keeps the
+  key schedule in our context, as the KMA path does on z.
+*/
+#define AES_GCM_HW 1
+#define HW_GCM_CPUF ICC_CPUF_VCRYPTO
+#define hwaes_set_encrypt_key aes_p8_set_encrypt_key
+#define hwaes_encrypt aes_p8_encrypt
+#define hwaes_ctr32_encrypt_blocks aes_p8_ctr32_encrypt_blocks
+#elif defined(__aarch64__) && !defined(OPENSSL_NO_ASM)
+/*
+  The same on ARMv8, AESE/AESD (aesv8-armx) and PMULL GHASH (ghashv8-armx)
+*/
+#define AES_GCM_HW 1
+#define HW_GCM_CPUF (ICC_CPUF_ARMAES | ICC_CPUF_PMULL)
+#define hwaes_set_encrypt_key aes_v8_set_encrypt_key
+#define hwaes_encrypt aes_v8_encrypt
+#define hwaes_ctr32_encrypt_blocks aes_v8_ctr32_encrypt_blocks
+#endif
+
+#if defined(AES_GCM_HW)
+extern int hwaes_set_encrypt_key(const unsigned char *userKey, const int bits,
+                                 AES_KEY *key);
+extern void hwaes_encrypt(const unsigned char *in, unsigned char *out,
+                          const AES_KEY *key);
+extern void hwaes_ctr32_encrypt_blocks(const unsigned char *in, unsigned char *out,
+                                       size_t blocks, const AES_KEY *key,
+                                       const unsigned char ivec[16]);
+
+/*! @brief State for the POWER8/ARMv8 path */
+typedef struct {
+  AES_KEY ks;            /*!< Key schedule, in the assembler's format */
+  GCM128_CONTEXT *gcm;   /*!< H, the GHASH tables and the running GHASH, from the first key */
+  int enc;               /*!< 1 encrypt, 0 decrypt, from hw_start() */
+} HW_GCM_t;
+
+/*! @brief Check the capabilities the POWER8/ARMv8 path needs
+    @return 1 if the AES and carry-less multiply instructions are there
+*/
+static int hw_capable(void)
+{
+  return (HW_GCM_CPUF == (OS_CpuFeatures() & HW_GCM_CPUF)) ? 1 : 0;
+}
+
+/*! @brief Release the POWER8/ARMv8 path state
+    @param p the state
+*/
+static void hw_free(HW_GCM_t *p)
+{
+  if (NULL != p->gcm) {
+    CRYPTO_gcm128_release(p->gcm);
+  }
+  OPENSSL_secure_clear_free(p, sizeof(HW_GCM_t));
+}
+
+/*! @brief Start a message on the POWER8/ARMv8 path, set the key if needed
+    @param a an AES_GCM_CTX context
+    @param enc 1 encrypt, 0 decrypt
+    @return 1 if O.K., 0 otherwise
+*/
+static int hw_start(AES_GCM_CTX_t *a, int enc)
+{
+  HW_GCM_t *p = (HW_GCM_t *)a->direct;
+
+  if ((16 != a->klen) && (24 != a->klen) && (32 != a->klen)) {
+    return 0;
+  }
+  if (NULL == a->iv || 0 == a->ivlen) {
+    return 0;
+  }
+  if (!a->keyed) {
+    if (0 != hwaes_set_encrypt_key(a->key, (int)(a->klen * 8), &p->ks)) {
+      return 0;
+    }
+    /* Both compute H from the key schedule */
+    if (NULL == p->gcm) {
+      p->gcm = CRYPTO_gcm128_new(&p->ks, (block128_f)hwaes_encrypt);
+      if (NULL == p->gcm) {
+        return 0;
+      }
+    } else {
+      CRYPTO_gcm128_init(p->gcm, &p->ks, (block128_f)hwaes_encrypt);
+    }
+    a->keyed = 1;
+  }
+  CRYPTO_gcm128_setiv(p->gcm, a->iv, a->ivlen);
+  p->enc = enc;
+  return 1;
+}
+
+/*! @brief The AES_GCM_En/DecryptUpdate() body for the POWER8/ARMv8 path 
+    @return 1 if O.K., 0 otherwise
+    @note The direction was fixed by hw_start()
+*/
+static int hw_update(AES_GCM_CTX_t *a, unsigned char *aad,
+                     unsigned long aadlen, unsigned char *data,
+                     unsigned long datalen, unsigned char *out,
+                     unsigned long *outlen)
+{
+  HW_GCM_t *p = (HW_GCM_t *)a->direct;
+  int rv = 1;
+
+  if ((NULL != aad) && (0 != CRYPTO_gcm128_aad(p->gcm, aad, aadlen))) {
+    rv = 0; /* aad after data, or too long */
+  }
+  if ((1 == rv) && (NULL != data)) {
+    if (p->enc) {
+      rv = CRYPTO_gcm128_encrypt_ctr32(p->gcm, data, out, datalen,
+                                       (ctr128_f)hwaes_ctr32_encrypt_blocks);
+    } else {
+      rv = CRYPTO_gcm128_decrypt_ctr32(p->gcm, data, out, datalen,
+                                       (ctr128_f)hwaes_ctr32_encrypt_blocks);
+    }
+    rv = (0 == rv) ? 1 : 0;
+    if ((1 == rv) && (NULL != outlen)) {
+      *outlen = datalen;
+    }
+  }
+  return rv;
+}
+#endif
+
 int AES_GCM_CTX_ctrl(AES_GCM_CTX *ain, int mode, int accel, void *ptr)
 {
   int rv = 1;
@@ -206,15 +760,78 @@ int AES_GCM_CTX_ctrl(AES_GCM_CTX *ain, int mode, int accel, void *ptr)
 
   switch(mode) {
   case AES_GCM_CTRL_SET_ACCEL:
+    /* Only ever switch paths between messages */
+#if defined(AES_GCM_KMA)
+    if (AES_GCM_ACCEL_DIRECT == accel) {
+      if (NULL == a->direct) {
+        if (kma_capable()) {
+          a->direct = OPENSSL_secure_malloc(sizeof(KMA_GCM_t));
+        }
+        if (NULL != a->direct) {
+          memset(a->direct, 0, sizeof(KMA_GCM_t));
+          a->keyed = 0;
+        } else {
+          rv = 0;
+        }
+      }
+    } else if (NULL != a->direct) {
+      OPENSSL_secure_clear_free(a->direct, sizeof(KMA_GCM_t));
+      a->direct = NULL;
+      a->keyed = 0;
+    }
+#elif defined(AES_GCM_HW)
+    if (AES_GCM_ACCEL_DIRECT == accel) {
+      if (NULL == a->direct) {
+        if (hw_capable()) {
+          a->direct = OPENSSL_secure_zalloc(sizeof(HW_GCM_t));
+        }
+        if (NULL != a->direct) {
+          a->keyed = 0;
+        } else {
+          rv = 0;
+        }
+      }
+    } else if (NULL != a->direct) {
+      hw_free((HW_GCM_t *)a->direct);
+      a->direct = NULL;
+      a->keyed = 0;
+    }
+#else
+    if (AES_GCM_ACCEL_DIRECT == accel) {
+      rv = 0; /* No direct path on this platform */
+    }
+#endif
     break;
   case AES_GCM_CTRL_GET_ACCEL:
-    *(int *)ptr = 1; /* Stuck at 4bit tables, implemented in assembler */
+    /* Stuck at 4bit tables, implemented in assembler */
+    *(int *)ptr = (NULL != a->direct) ? AES_GCM_ACCEL_DIRECT : 1;
     break;
   case AES_GCM_CTRL_TLS12: /* TLS 1.2 IV rollover */
      a->flags |= AES_GCM_CTRL_TLS12;
+     /* With the 4 byte salt: record mode, sequence restarts at 0 */
+     if (NULL != ptr) {
+       if (4 == accel) {
+         memset(a->recIV, 0, sizeof(a->recIV));
+         memcpy(a->recIV, ptr, 4);
+         a->seq = 0;
+         a->flags |= AES_GCM_FLAG_RECORD;
+       } else {
+         rv = 0;
+       }
+     }
      break;
   case AES_GCM_CTRL_TLS13: /* TLS 1.3 IV rollover */
     a->flags |= AES_GCM_CTRL_TLS13;
+    /* With the 12 byte static IV: record mode, sequence restarts at 0 */
+    if (NULL != ptr) {
+      if (12 == accel) {
+        memcpy(a->recIV, ptr, sizeof(a->recIV));
+        a->seq = 0;
+        a->flags |= AES_GCM_FLAG_RECORD;
+      } else {
+        rv = 0;
+      }
+    }
     break;  
   default:
     rv = 0;
@@ -226,10 +843,8 @@ int AES_GCM_CTX_ctrl(AES_GCM_CTX *ain, int mode, int accel, void *ptr)
 AES_GCM_CTX *AES_GCM_CTX_new()
 {
   AES_GCM_CTX_t *ctx = NULL;
-  ctx = OPENSSL_malloc(sizeof(AES_GCM_CTX_t));
-  if(NULL != ctx) {
-    memset(ctx,0,sizeof(AES_GCM_CTX_t));
-  }
+  /* Holds the key, from the secure heap if there is one */
+  ctx = OPENSSL_secure_zalloc(sizeof(AES_GCM_CTX_t));
   return (AES_GCM_CTX *)ctx;
 }
 
@@ -248,8 +863,19 @@ void AES_GCM_CTX_free(AES_GCM_CTX *ctx)
     EVP_CIPHER_CTX_cleanup(a->IVctx);
     EVP_CIPHER_CTX_free(a->IVctx);
   }
-  memset(a,0,sizeof(AES_GCM_CTX_t));
-  OPENSSL_free(ctx);
+  if(NULL != a->gh) {
+    CRYPTO_gcm128_release(a->gh);
+  }
+#if defined(AES_GCM_KMA)
+  if(NULL != a->direct) {
+    OPENSSL_secure_clear_free(a->direct, sizeof(KMA_GCM_t));
+  }
+#elif defined(AES_GCM_HW)
+  if(NULL != a->direct) {
+    hw_free((HW_GCM_t *)a->direct);
+  }
+#endif
+  OPENSSL_secure_clear_free(ctx,sizeof(AES_GCM_CTX_t));
 }
 static void XOR(unsigned char *a,unsigned char *b,int l)
 {
@@ -272,9 +898,118 @@ static void XOR(unsigned char *a,unsigned char *b,int l)
     otherwise, Y is the output from the previous invocation and
     the GHASH can be chained.   
 */
+/*! @brief Leading fields of OpenSSL 1.1.1's struct gcm128_context 
+   (crypto/modes/modes_local.h). The relative position of these is fixed,
+   OpenSSL's assembler GHASH modules depend on it.
+*/
+typedef struct {
+  unsigned char Yi[16];
+  unsigned char EKi[16];
+  unsigned char EK0[16];
+  unsigned char len[16];
+  unsigned char Xi[16];  /*!< The running GHASH value */
+  unsigned char H[16];
+} GCM128_HEAD;
+
+/*! @brief block128_f used to set up a gcm128 context for a given hash key
+    rather than an AES key. OpenSSL computes H = E(0) with this, 
+    so we just return H
+    @param in ignored
+    @param out H
+    @param key H
+*/
+static void ghash_key(const unsigned char in[16], unsigned char out[16],
+                      const void *key)
+{
+  memcpy(out, key, 16);
+}
+
+/** @brief Calculate the GHASH of an arbitrary data stream
+    @param gcm_ctx an AES GSM context
+    @param H the hash key
+    @param Hash is the input/output, (AES_BLOCK_SIZE long)
+    @param X the input data
+    @param Xlen is the length of the input data 0 <= X <= 2^64 BITS
+    @return 1 if O.K. 0 on error (X is too long)
+    @note The last block of X will be 0 padded - so no partial blocks
+    unless you want this.
+    @note Y should be initialized to 0 if this is the first pass
+    otherwise, Y is the output from the previous invocation and
+    the GHASH can be chained.   
+    @note This uses OpenSSL's gcm128 code, so the same accelerated
+    (PCLMULQDQ, PMULL, vpmsumd, KIMD) GHASH as the bulk GCM path.
+    The expanded H table is kept in gcm_ctx and only rebuilt when H changes,
+    H is key derived so that check is constant time.
+*/
 void GHASH(AES_GCM_CTX *gcm_ctx,unsigned char *H, unsigned char *Hash, unsigned char *X,unsigned long Xlen)
 {
+  AES_GCM_CTX_t *a = (AES_GCM_CTX_t *)gcm_ctx;
+  GCM128_CONTEXT *g = NULL;
+  GCM128_HEAD *gh = NULL;
+  static const unsigned char zeros[16] = {0};
+  unsigned int n = 0;
+
+  if (NULL != a) {
+    if ((NULL != a->gh) && (0 != CRYPTO_memcmp(a->ghH, H, sizeof(a->ghH)))) {
+      CRYPTO_gcm128_release(a->gh);
+      a->gh = NULL;
+    }
+    if (NULL == a->gh) {
+      memcpy(a->ghH, H, sizeof(a->ghH));
+      a->gh = CRYPTO_gcm128_new(a->ghH, (block128_f)ghash_key);
+    }
+    g = a->gh;
+  } else {
+    g = CRYPTO_gcm128_new(H, (block128_f)ghash_key);
+  }
+  if (NULL != g) {
+    gh = (GCM128_HEAD *)g;
+    memset(gh->len, 0, sizeof(gh->len));
+    memcpy(gh->Xi, Hash, sizeof(gh->Xi));
+    if (Xlen > 0) {
+      CRYPTO_gcm128_aad(g, X, Xlen);
+      /* Zero pad any partial last block, that also completes it's multiply */
+      n = (unsigned int)(Xlen % 16);
+      if (0 != n) {
+        CRYPTO_gcm128_aad(g, zeros, 16 - n);
+      }
+    }
+    memcpy(Hash, gh->Xi, sizeof(gh->Xi));
+    if (NULL == a) {
+      CRYPTO_gcm128_release(g);
+    }
+  }
+}
 
+/** @brief (Re)start the GCM operation on the OpenSSL context
+    @param a an AES_GCM_CTX context
+    @param enc 1 encrypt, 0 decrypt
+    @return 1 if O.K., 0 otherwise
+    @note The key schedule and GHASH key are only recomputed when the key
+    (or key size) changed since the last start, otherwise only the IV/counter
+    state is reset. The first use of a key costs a full key setup, following 
+    messages under the same key (i.e. TLS records) only the IV setup.
+*/
+static int gcm_start(AES_GCM_CTX_t *a, int enc)
+{
+  int rv = 1;
+#if defined(AES_GCM_KMA)
+  if (NULL != a->direct) {
+    return kma_start(a, enc);
+  }
+#elif defined(AES_GCM_HW)
+  if (NULL != a->direct) {
+    return hw_start(a, enc);
+  }
+#endif
+  if (a->cipher != EVP_CIPHER_CTX_cipher(a->ctx)) {
+    rv = EVP_CipherInit_ex(a->ctx, a->cipher, NULL, NULL, NULL, enc);
+    a->keyed = 0;
+  }
+  EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_SET_IVLEN, a->ivlen, NULL);
+  rv = EVP_CipherInit_ex(a->ctx, NULL, NULL, a->keyed ? NULL : a->key, a->iv, enc);
+  a->keyed = (1 == rv);
+  return rv;
 }
 
 /** @brief
@@ -315,7 +1050,7 @@ int AES_GCM_Init(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *iv, unsigned long
         a->ivlen = ivlen;
      }
 
-     if ((NULL != a->ctx) && (NULL == key)) {
+     if ((NULL != a->ctx) && (NULL == key) && !(a->flags & AES_GCM_FLAG_RECNONCE)) {
 
         /* This context has been used before and it's an IV rollover with the same mask, ensure that the IV has changed accordingly */
         if (a->flags & AES_GCM_CTRL_TLS13) {
@@ -376,8 +1111,13 @@ int AES_GCM_Init(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *iv, unsigned long
   }
 
   if ((NULL != key) && (klen > 0)) {
-     a->klen = klen;
-     memcpy(a->key, key, klen);
+     /* The same key again (i.e. per segment calls) keeps the expanded key,
+        compared in constant time, it is the secret key */
+     if ((klen != a->klen) || (0 != CRYPTO_memcmp(a->key, key, klen))) {
+        a->klen = klen;
+        memcpy(a->key, key, klen);
+        a->keyed = 0; /* New key, expand it on next use */
+     }
   }
   
   /* we need to have an iv before we create a context for the first time */
@@ -421,11 +1161,7 @@ int AES_GCM_Init(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *iv, unsigned long
   */
   if( 1 == rv) {
     if (a->iv && (1 == a->init)) {
-      if (a->enc) {
-        EVP_EncryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
-      } else {
-        EVP_DecryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
-     }
+      gcm_start(a, a->enc);
     } else {
       /* EVP_EncryptInit_ex will happen in the AES_GCM_??cryptUpdate */
       a->init = 0;
@@ -436,6 +1172,7 @@ int AES_GCM_Init(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *iv, unsigned long
     nid = EVP_CIPHER_type(a->cipher);
     pcb->callback("AES_GCM_Init",nid,1);
   }
+  ICC_PROBE4(gcm__init, ain, klen, ivlen, rv);
   return rv;
 }
 
@@ -468,14 +1205,19 @@ int AES_GCM_EncryptUpdate(AES_GCM_CTX *ain, unsigned char *aad,
     *outlen = 0;
   }
   if (0 == a->init) {
-    if (NULL == EVP_CIPHER_CTX_cipher(a->ctx)) {
-      rv = EVP_EncryptInit_ex(a->ctx, a->cipher, NULL, NULL, NULL);
-    }
-    EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_SET_IVLEN, a->ivlen, NULL);
-    rv = EVP_EncryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
+    rv = gcm_start(a, 1);
     a->init = 1;
     a->enc = 1;
   }
+#if defined(AES_GCM_KMA)
+  if ((1 == rv) && (NULL != a->direct)) {
+    rv = kma_update(a, aad, aadlen, data, datalen, out, outlen);
+  } else
+#elif defined(AES_GCM_HW)
+  if ((1 == rv) && (NULL != a->direct)) {
+    rv = hw_update(a, aad, aadlen, data, datalen, out, outlen);
+  } else
+#endif
   if (1 == rv) {
     if (NULL != aad) {
       rv = EVP_EncryptUpdate(a->ctx, NULL, &outl, aad, aadlen);
@@ -518,13 +1260,18 @@ int AES_GCM_EncryptUpdate(AES_GCM_CTX *ain, unsigned char *aad,
       *outlen = 0;
     }
     if (0 == a->init) {
-      if (NULL == EVP_CIPHER_CTX_cipher(a->ctx)) {
-        rv = EVP_DecryptInit_ex(a->ctx, a->cipher, NULL, NULL, NULL);
-      }
-      EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_SET_IVLEN, a->ivlen, NULL);
-      rv = EVP_DecryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
+      rv = gcm_start(a, 0);
       a->init = 1;
     }
+#if defined(AES_GCM_KMA)
+    if ((1 == rv) && (NULL != a->direct)) {
+      rv = kma_update(a, aad, aadlen, data, datalen, out, outlen);
+    } else
+#elif defined(AES_GCM_HW)
+    if ((1 == rv) && (NULL != a->direct)) {
+      rv = hw_update(a, aad, aadlen, data, datalen, out, outlen);
+    } else
+#endif
     if (1 == rv) {
       if (NULL != aad) {
         rv = EVP_DecryptUpdate(a->ctx, NULL, &outl, aad, aadlen);
@@ -553,21 +1300,34 @@ int AES_GCM_EncryptUpdate(AES_GCM_CTX *ain, unsigned char *aad,
     int outl = 0;
 
     if (0 == a->init) {
-      if (NULL == EVP_CIPHER_CTX_cipher(a->ctx)) {
-        rv = EVP_EncryptInit_ex(a->ctx, a->cipher, NULL, NULL, NULL);
-      }
-      EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_SET_IVLEN, a->ivlen, NULL);
-      rv = EVP_EncryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
-
+      rv = gcm_start(a, 1);
       a->init = 1;
       a->enc = 1;
     }
-    outl = *outlen;
-    EVP_EncryptFinal_ex(a->ctx, out, &outl);
-    *outlen = outl;
-    EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_GET_TAG, 16, hash);
+#if defined(AES_GCM_KMA)
+    if (NULL != a->direct) {
+      *outlen = 0;
+      if (1 == rv) {
+        memcpy(hash, kma_final((KMA_GCM_t *)a->direct), AES_BLOCK_SIZE);
+      }
+    } else
+#elif defined(AES_GCM_HW)
+    if (NULL != a->direct) {
+      *outlen = 0;
+      if (1 == rv) {
+        CRYPTO_gcm128_tag(((HW_GCM_t *)a->direct)->gcm, hash, AES_BLOCK_SIZE);
+      }
+    } else
+#endif
+    {
+      outl = *outlen;
+      EVP_EncryptFinal_ex(a->ctx, out, &outl);
+      *outlen = outl;
+      EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_GET_TAG, 16, hash);
+    }
 
     a->init = 2;
+    ICC_PROBE3(gcm__final, ain, 1, rv);
     return rv;
   }
 
@@ -588,18 +1348,535 @@ int AES_GCM_EncryptUpdate(AES_GCM_CTX *ain, unsigned char *aad,
     int rv = 1;
 
     if (0 == a->init) {
-      if (NULL == EVP_CIPHER_CTX_cipher(a->ctx)) {
-        rv = EVP_DecryptInit_ex(a->ctx, a->cipher, NULL, NULL, NULL);
-      }
-      EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_SET_IVLEN, a->ivlen, NULL);
-      rv = EVP_DecryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
+      rv = gcm_start(a, 0);
       a->enc = 0;
       a->init = 1;
     }
-    EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_AEAD_SET_TAG, hlen, hash);
-    outl = *outlen;
-    rv = EVP_DecryptFinal_ex(a->ctx, out, &outl);
-    *outlen = outl;
+#if defined(AES_GCM_KMA)
+    if (NULL != a->direct) {
+      *outlen = 0;
+      if ((1 == rv) && (hlen > 0) && (hlen <= AES_BLOCK_SIZE)) {
+        rv = (0 == CRYPTO_memcmp(kma_final((KMA_GCM_t *)a->direct), hash, hlen)) ? 1 : 0;
+      } else {
+        rv = 0;
+      }
+    } else
+#elif defined(AES_GCM_HW)
+    if (NULL != a->direct) {
+      *outlen = 0;
+      if ((1 == rv) && (hlen > 0) && (hlen <= AES_BLOCK_SIZE)) {
+        /* Constant time compare of hlen bytes */
+        rv = (0 == CRYPTO_gcm128_finish(((HW_GCM_t *)a->direct)->gcm, hash, hlen)) ? 1 : 0;
+      } else {
+        rv = 0;
+      }
+    } else
+#endif
+    {
+      EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_AEAD_SET_TAG, hlen, hash);
+      outl = *outlen;
+      rv = EVP_DecryptFinal_ex(a->ctx, out, &outl);
+      *outlen = outl;
+    }
     a->init = 2;
+    ICC_PROBE3(gcm__final, ain, 0, rv);
     return rv;
   }
+
+  /** @brief One shot AES GCM encrypt, Init + EncryptUpdate + EncryptFinal
+      @param pcb The internal ICC_CTX
+      @param ain an AES_GCM_CTX pointer, reusable across calls
+      @param iv The IV
+      @param ivlen the length of the IV
+      @param key an aes key 16,24 or 32 bytes long, NULL to reuse the
+      key already set in ain
+      @param klen the length of the aes key
+      @param aad additional authentication data (hashed, not encrypted), may be NULL
+      @param aadlen the length of the aad
+      @param data data to encrypt
+      @param datalen the length of the data
+      @param out the output buffer, at least datalen + AES_BLOCK_SIZE
+      bytes, receives ciphertext || tag
+      @param outlen a place to store the length of the output (datalen + 16)
+      @return 1 if O.K., 0 otherwise
+      @note Keeping the context and passing a NULL key on later calls
+      avoids the key setup, see gcm_start()
+  */
+  int AES_GCM_Seal(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *iv,
+                   unsigned long ivlen, unsigned char *key, unsigned int klen,
+                   unsigned char *aad, unsigned long aadlen,
+                   unsigned char *data, unsigned long datalen,
+                   unsigned char *out, unsigned long *outlen) {
+    int rv = 1;
+    unsigned long l = 0;
+    unsigned long fl = 0;
+
+    *outlen = 0;
+    rv = AES_GCM_Init(pcb, ain, iv, ivlen, key, klen);
+    if (1 == rv) {
+      rv = AES_GCM_EncryptUpdate(ain, aad, aadlen, data, datalen, out, &l);
+    }
+    if (1 == rv) {
+      rv = AES_GCM_EncryptFinal(ain, out + l, &fl, out + l + fl);
+    }
+    if (1 == rv) {
+      *outlen = l + fl + AES_BLOCK_SIZE;
+    }
+    return rv;
+  }
+
+  /** @brief One shot AES GCM decrypt, Init + DecryptUpdate + DecryptFinal
+      @param pcb The internal ICC_CTX
+      @param ain an AES_GCM_CTX pointer, reusable across calls
+      @param iv The IV
+      @param ivlen the length of the IV
+      @param key an aes key 16,24 or 32 bytes long, NULL to reuse the
+      key already set in ain
+      @param klen the length of the aes key
+      @param aad additional authentication data, may be NULL
+      @param aadlen the length of the aad
+      @param data ciphertext || tag as produced by AES_GCM_Seal()
+      @param datalen the length of ciphertext + tag (>= AES_BLOCK_SIZE)
+      @param out the output buffer, at least datalen - AES_BLOCK_SIZE bytes
+      @param outlen a place to store the length of the plaintext
+      @return 1 if the tag matched, 0 otherwise
+      @note On a tag mismatch the output buffer is cleared, no unauthenticated
+      plaintext is returned
+  */
+  int AES_GCM_Open(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *iv,
+                   unsigned long ivlen, unsigned char *key, unsigned int klen,
+                   unsigned char *aad, unsigned long aadlen,
+                   unsigned char *data, unsigned long datalen,
+                   unsigned char *out, unsigned long *outlen) {
+    int rv = 0;
+    unsigned long l = 0;
+    unsigned long fl = 0;
+    unsigned long clen = 0;
+
+    *outlen = 0;
+    if (datalen >= AES_BLOCK_SIZE) {
+      clen = datalen - AES_BLOCK_SIZE;
+      rv = AES_GCM_Init(pcb, ain, iv, ivlen, key, klen);
+      if (1 == rv) {
+        rv = AES_GCM_DecryptUpdate(ain, aad, aadlen, data, clen, out, &l);
+      }
+      if (1 == rv) {
+        rv = AES_GCM_DecryptFinal(ain, out + l, &fl, data + clen, AES_BLOCK_SIZE);
+      }
+      if (1 == rv) {
+        *outlen = l + fl;
+      } else {
+        if (NULL != out) {
+          memset(out, 0, clen);
+        }
+      }
+    }
+    return rv;
+  }
+
+  /** @brief Build the IV for one segment of a segmented (STREAM) AES GCM object
+      IV = nonce prefix (7 bytes) || segment number (32 bit big endian) || last flag
+      @param iv 12 byte IV buffer
+      @param nonce AES_GCM_SEG_NONCELEN byte per object nonce prefix
+      @param seg segment number
+      @param last 1 if this is the final segment
+  */
+  static void seg_iv(unsigned char iv[12], const unsigned char *nonce,
+                     unsigned long seg, int last) {
+    memcpy(iv, nonce, AES_GCM_SEG_NONCELEN);
+    iv[7] = (unsigned char)(seg >> 24);
+    iv[8] = (unsigned char)(seg >> 16);
+    iv[9] = (unsigned char)(seg >> 8);
+    iv[10] = (unsigned char)seg;
+    iv[11] = last ? 1 : 0;
+  }
+
+  /** @brief Encrypt one segment of a segmented (STREAM construction) AES GCM object
+      @param pcb The internal ICC_CTX
+      @param ain an AES_GCM_CTX pointer, one per thread, reusable across segments
+      @param key an aes key 16,24 or 32 bytes long
+      @param klen the length of the aes key
+      @param nonce AES_GCM_SEG_NONCELEN byte nonce prefix, unique per object/key
+      @param seg the segment number 0 - 2^32-1
+      @param last 1 if this is the final segment of the object, 0 otherwise
+      @param aad additional authentication data for this segment, may be NULL
+      @param aadlen the length of the aad
+      @param data the segment plaintext
+      @param datalen the length of the segment
+      @param out the output buffer, at least datalen + AES_BLOCK_SIZE bytes,
+      receives ciphertext || tag
+      @param outlen a place to store the length of the output (datalen + 16)
+      @return 1 if O.K., 0 otherwise
+      @note Segments are independent, so they can be processed in any order
+      and by as many threads as the caller likes, each with it's own AES_GCM_CTX.
+      The segment number and last flag are bound into the IV so reordering, 
+      truncation or extension of the object is detected on decrypt.
+      The expanded key is retained while the same key is passed.
+  */
+  int AES_GCM_SegmentSeal(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *key,
+                          unsigned int klen, unsigned char *nonce,
+                          unsigned long seg, int last,
+                          unsigned char *aad, unsigned long aadlen,
+                          unsigned char *data, unsigned long datalen,
+                          unsigned char *out, unsigned long *outlen) {
+    int rv = 0;
+    unsigned char iv[12];
+
+    *outlen = 0;
+    if ((NULL != key) && (NULL != nonce) && (seg <= 0xffffffffUL)) {
+      seg_iv(iv, nonce, seg, last);
+      rv = AES_GCM_Seal(pcb, ain, iv, sizeof(iv), key, klen, aad, aadlen,
+                        data, datalen, out, outlen);
+    }
+    return rv;
+  }
+
+  /** @brief Decrypt one segment of a segmented (STREAM construction) AES GCM object
+      @param pcb The internal ICC_CTX
+      @param ain an AES_GCM_CTX pointer, one per thread, reusable across segments
+      @param key an aes key 16,24 or 32 bytes long
+      @param klen the length of the aes key
+      @param nonce AES_GCM_SEG_NONCELEN byte nonce prefix used to encrypt the object
+      @param seg the segment number 0 - 2^32-1
+      @param last 1 if this is the final segment of the object, 0 otherwise
+      @param aad additional authentication data for this segment, may be NULL
+      @param aadlen the length of the aad
+      @param data ciphertext || tag as produced by AES_GCM_SegmentSeal()
+      @param datalen the length of ciphertext + tag (>= AES_BLOCK_SIZE)
+      @param out the output buffer, at least datalen - AES_BLOCK_SIZE bytes
+      @param outlen a place to store the length of the plaintext
+      @return 1 if the tag matched, 0 otherwise
+      @note Any single segment can be decrypted (random access). 
+      A reader must only accept the object as complete after a segment 
+      flagged last has been verified. On a tag mismatch the output is cleared.
+  */
+  int AES_GCM_SegmentOpen(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *key,
+                          unsigned int klen, unsigned char *nonce,
+                          unsigned long seg, int last,
+                          unsigned char *aad, unsigned long aadlen,
+                          unsigned char *data, unsigned long datalen,
+                          unsigned char *out, unsigned long *outlen) {
+    int rv = 0;
+    unsigned char iv[12];
+
+    *outlen = 0;
+    if ((NULL != key) && (NULL != nonce) && (seg <= 0xffffffffUL)) {
+      seg_iv(iv, nonce, seg, last);
+      rv = AES_GCM_Open(pcb, ain, iv, sizeof(iv), key, klen, aad, aadlen,
+                        data, datalen, out, outlen);
+    }
+    return rv;
+  }
+
+  /** @brief Seal or open one TLS record on a context in record mode
+      @param pcb The internal ICC_CTX
+      @param a an AES_GCM_CTX in record mode, see AES_GCM_CTX_ctrl()
+      @param key an aes key, NULL to reuse the key already set in a
+      @param klen the length of the aes key
+      @param hdr the record header, 5 bytes for TLS 1.2
+      @param hdrlen the length of the record header
+      @param data the record payload, for open explicit nonce (TLS 1.2) || ciphertext || tag
+      @param datalen the length of the payload
+      @param out the output buffer
+      @param outlen a place to store the length of the output
+      @param enc 1 seal, 0 open
+      @return 1 if O.K., 0 otherwise
+      @note The nonce comes from the static IV and the sequence number held
+      in the context, so the caller IV rollover checks in AES_GCM_Init() are
+      skipped for these calls. The sequence number only advances on success.
+  */
+  static int AES_GCM_Record(ICClib *pcb, AES_GCM_CTX_t *a, unsigned char *key,
+                            unsigned int klen, unsigned char *hdr,
+                            unsigned long hdrlen, unsigned char *data,
+                            unsigned long datalen, unsigned char *out,
+                            unsigned long *outlen, int enc) {
+    int rv = 0;
+    int i = 0;
+    unsigned int flags = 0;
+    unsigned long plen = 0;
+    unsigned long l = 0;
+    unsigned char iv[12];
+    unsigned char seq[8];
+    unsigned char aad[13];
+
+    *outlen = 0;
+    if ((NULL == a) || !(a->flags & AES_GCM_FLAG_RECORD) ||
+        (0xffffffffffffffffULL == a->seq)) {
+      /* Not in record mode, or the key must be changed before 2^64 records */
+      return 0;
+    }
+    for (i = 0; i < 8; i++) {
+      seq[i] = (unsigned char)(a->seq >> (56 - 8 * i));
+    }
+    flags = a->flags;
+    a->flags = (flags & ~(AES_GCM_CTRL_TLS13 | AES_GCM_CTRL_TLS12)) |
+               AES_GCM_FLAG_RECNONCE;
+    if (flags & AES_GCM_CTRL_TLS13) {
+      /* RFC 8446 5.3: static IV XOR the padded sequence number, aad is the header */
+      memcpy(iv, a->recIV, sizeof(iv));
+      XOR(iv + 4, seq, 8);
+      if (enc) {
+        rv = AES_GCM_Seal(pcb, (AES_GCM_CTX *)a, iv, sizeof(iv), key, klen,
+                          hdr, hdrlen, data, datalen, out, outlen);
+      } else {
+        rv = AES_GCM_Open(pcb, (AES_GCM_CTX *)a, iv, sizeof(iv), key, klen,
+                          hdr, hdrlen, data, datalen, out, outlen);
+      }
+    } else if ((NULL != hdr) && (5 == hdrlen) && (NULL != out) &&
+               (enc || ((NULL != data) && (datalen >= 8 + AES_BLOCK_SIZE)))) {
+      /* RFC 5288: salt || explicit nonce, the explicit nonce is the sequence
+         number on seal and is carried at the front of the record.
+         RFC 5246 6.2.3.3: aad is seq || type || version || plaintext length */
+      plen = enc ? datalen : datalen - 8 - AES_BLOCK_SIZE;
+      if (plen <= 0xffff) {
+        memcpy(iv, a->recIV, 4);
+        memcpy(iv + 4, enc ? seq : data, 8);
+        memcpy(aad, seq, 8);
+        memcpy(aad + 8, hdr, 3);
+        aad[11] = (unsigned char)(plen >> 8);
+        aad[12] = (unsigned char)plen;
+        if (enc) {
+          memcpy(out, seq, 8);
+          rv = AES_GCM_Seal(pcb, (AES_GCM_CTX *)a, iv, sizeof(iv), key, klen,
+                            aad, sizeof(aad), data, datalen, out + 8, &l);
+          if (1 == rv) {
+            *outlen = l + 8;
+          }
+        } else {
+          rv = AES_GCM_Open(pcb, (AES_GCM_CTX *)a, iv, sizeof(iv), key, klen,
+                            aad, sizeof(aad), data + 8, datalen - 8, out,
+                            outlen);
+        }
+      }
+    }
+    a->flags = flags;
+    if (1 == rv) {
+      a->seq++;
+    } else {
+      *outlen = 0;
+      rv = 0;
+    }
+    return rv;
+  }
+
+  /** @brief Encrypt one TLS record, the nonce is derived in the context
+      @param pcb The internal ICC_CTX
+      @param ain an AES_GCM_CTX put in record mode by AES_GCM_CTX_ctrl()
+      AES_GCM_CTRL_TLS13 (12 byte static IV) or AES_GCM_CTRL_TLS12 (4 byte salt)
+      @param key an aes key 16,24 or 32 bytes long, NULL to reuse the
+      key already set in ain
+      @param klen the length of the aes key
+      @param hdr the record header. TLS 1.3: used as is as the aad.
+      TLS 1.2: 5 bytes, type, version and (ignored) length
+      @param hdrlen the length of the record header
+      @param data the record plaintext
+      @param datalen the length of the plaintext
+      @param out the output buffer, datalen + 16 bytes (TLS 1.3),
+      datalen + 24 bytes (TLS 1.2), receives [explicit nonce ||] ciphertext || tag
+      @param outlen a place to store the length of the output
+      @return 1 if O.K., 0 otherwise
+  */
+  int AES_GCM_RecordSeal(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *key,
+                         unsigned int klen, unsigned char *hdr,
+                         unsigned long hdrlen, unsigned char *data,
+                         unsigned long datalen, unsigned char *out,
+                         unsigned long *outlen) {
+    return AES_GCM_Record(pcb, (AES_GCM_CTX_t *)ain, key, klen, hdr, hdrlen,
+                          data, datalen, out, outlen, 1);
+  }
+
+  /** @brief Decrypt and verify one TLS record, the nonce is derived in the context
+      @param pcb The internal ICC_CTX
+      @param ain an AES_GCM_CTX put in record mode by AES_GCM_CTX_ctrl()
+      @param key an aes key 16,24 or 32 bytes long, NULL to reuse the
+      key already set in ain
+      @param klen the length of the aes key
+      @param hdr the record header, as for AES_GCM_RecordSeal()
+      @param hdrlen the length of the record header
+      @param data the record payload, [explicit nonce ||] ciphertext || tag
+      @param datalen the length of the payload 
+      @param out the output buffer, at least datalen - 16 bytes
+      @param outlen a place to store the length of the plaintext
+      @return 1 if the tag matched, 0 otherwise, the output is cleared on failure
+  */
+  int AES_GCM_RecordOpen(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *key,
+                         unsigned int klen, unsigned char *hdr,
+                         unsigned long hdrlen, unsigned char *data,
+                         unsigned long datalen, unsigned char *out,
+                         unsigned long *outlen) {
+    return AES_GCM_Record(pcb, (AES_GCM_CTX_t *)ain, key, klen, hdr, hdrlen,
+                          data, datalen, out, outlen, 0);
+  }
+
+  /** @brief Scatter/gather AES_GCM update
+      @param ain the (opaque) AES_GCM_CTX context
+      @param aad aad fragments, may be NULL
+      @param naad number of aad fragments
+      @param in input fragments
+      @param nin number of input fragments
+      @param out output fragments, at least as many bytes in total as the input
+      @param nout number of output fragments
+      @param outlen a place to store the total length of the output data
+      @param enc 1 encrypt, 0 decrypt
+      @return 1 if O.K., 0 otherwise
+      @note Fragments are handed to the cipher in place, input and
+      output lists don't need to be split at the same points.
+  */
+  static int AES_GCM_UpdateV(AES_GCM_CTX *ain, AES_IOV *aad, unsigned int naad,
+                             AES_IOV *in, unsigned int nin, AES_IOV *out,
+                             unsigned int nout, unsigned long *outlen, int enc) {
+    int rv = 1;
+    unsigned int i = 0;
+    unsigned int j = 0;
+    unsigned long ioff = 0;
+    unsigned long ooff = 0;
+    unsigned long n = 0;
+    unsigned long l = 0;
+
+    *outlen = 0;
+    for (i = 0; (1 == rv) && (NULL != aad) && (i < naad); i++) {
+      if ((NULL != aad[i].base) && (aad[i].len > 0)) {
+        rv = enc ? AES_GCM_EncryptUpdate(ain, aad[i].base, aad[i].len, NULL, 0, NULL, &l)
+                 : AES_GCM_DecryptUpdate(ain, aad[i].base, aad[i].len, NULL, 0, NULL, &l);
+      }
+    }
+    i = 0;
+    while ((1 == rv) && (NULL != in) && (i < nin)) {
+      if (ioff >= in[i].len) {
+        i++;
+        ioff = 0;
+        continue;
+      }
+      if ((NULL == out) || (j >= nout)) {
+        rv = 0; /* Output is too short */
+        break;
+      }
+      if (ooff >= out[j].len) {
+        j++;
+        ooff = 0;
+        continue;
+      }
+      n = in[i].len - ioff;
+      if (n > (out[j].len - ooff)) {
+        n = out[j].len - ooff;
+      }
+      rv = enc ? AES_GCM_EncryptUpdate(ain, NULL, 0, in[i].base + ioff, n, out[j].base + ooff, &l)
+               : AES_GCM_DecryptUpdate(ain, NULL, 0, in[i].base + ioff, n, out[j].base + ooff, &l);
+      *outlen += l;
+      ioff += n;
+      ooff += n;
+    }
+    return rv;
+  }
+
+  /** @brief Scatter/gather AES_GCM encrypt update, see AES_GCM_UpdateV()
+      @return 1 if O.K., 0 otherwise
+  */
+  int AES_GCM_EncryptUpdateV(AES_GCM_CTX *ain, AES_IOV *aad, unsigned int naad,
+                             AES_IOV *in, unsigned int nin, AES_IOV *out,
+                             unsigned int nout, unsigned long *outlen) {
+    return AES_GCM_UpdateV(ain, aad, naad, in, nin, out, nout, outlen, 1);
+  }
+
+  /** @brief Scatter/gather AES_GCM decrypt update, see AES_GCM_UpdateV()
+      @return 1 if O.K., 0 otherwise
+  */
+  int AES_GCM_DecryptUpdateV(AES_GCM_CTX *ain, AES_IOV *aad, unsigned int naad,
+                             AES_IOV *in, unsigned int nin, AES_IOV *out,
+                             unsigned int nout, unsigned long *outlen) {
+    return AES_GCM_UpdateV(ain, aad, naad, in, nin, out, nout, outlen, 0);
+  }
+
+  /** @brief Process an array of independent records under one key
+      @param pcb The internal ICC_CTX
+      @param ain an AES_GCM_CTX pointer
+      @param key an aes key 16,24 or 32 bytes long, NULL to reuse the
+      key already set in ain
+      @param klen the length of the aes key
+      @param recs the records
+      @param n the number of records
+      @param enc 1 encrypt, 0 decrypt
+      @return 1 if every record was processed O.K., 0 otherwise
+      @note The key is expanded once for the whole batch, each record only
+      costs an IV setup. Records are independent, a failure in one
+      (i.e. a tag mismatch) doesn't stop the rest, check recs[i].rv.
+      On a decrypt failure that record's output is cleared.
+  */
+  static int AES_GCM_Batch(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *key,
+                           unsigned int klen, AES_GCM_REC *recs,
+                           unsigned int n, int enc) {
+    int rv = 1;
+    unsigned int i = 0;
+    unsigned long l = 0;
+    unsigned long fl = 0;
+    AES_GCM_REC *r = NULL;
+
+    if (NULL == recs) {
+      rv = 0;
+      n = 0;
+    }
+    for (i = 0; i < n; i++) {
+      r = &recs[i];
+      l = 0;
+      fl = 0;
+      /* Only the first record gets a (new) key */
+      r->rv = AES_GCM_Init(pcb, ain, r->iv, r->ivlen, (0 == i) ? key : NULL,
+                           (0 == i) ? klen : 0);
+      if (enc) {
+        if (1 == r->rv) {
+          r->rv = AES_GCM_EncryptUpdate(ain, r->aad, r->aadlen, r->in, r->inlen,
+                                        r->out, &l);
+        }
+        if (1 == r->rv) {
+          r->rv = AES_GCM_EncryptFinal(ain, r->out + l, &fl, r->tag);
+        }
+      } else {
+        if (1 == r->rv) {
+          r->rv = AES_GCM_DecryptUpdate(ain, r->aad, r->aadlen, r->in, r->inlen,
+                                        r->out, &l);
+        }
+        if (1 == r->rv) {
+          r->rv = AES_GCM_DecryptFinal(ain, r->out + l, &fl, r->tag,
+                                       AES_BLOCK_SIZE);
+        }
+        if ((1 != r->rv) && (NULL != r->out)) {
+          memset(r->out, 0, r->inlen);
+        }
+      }
+      if (1 != r->rv) {
+        r->rv = 0;
+        rv = 0;
+      }
+    }
+    return rv;
+  }
+
+  /** @brief Encrypt an array of independent records under one key
+      @param pcb The internal ICC_CTX
+      @param ain an AES_GCM_CTX pointer
+      @param key an aes key, NULL to reuse the key already set in ain
+      @param klen the length of the aes key
+      @param recs the records, out and tag are written
+      @param n the number of records
+      @return 1 if every record was encrypted, 0 otherwise
+  */
+  int AES_GCM_EncryptBatch(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *key,
+                           unsigned int klen, AES_GCM_REC *recs,
+                           unsigned int n) {
+    return AES_GCM_Batch(pcb, ain, key, klen, recs, n, 1);
+  }
+
+  /** @brief Decrypt and verify an array of independent records under one key
+      @param pcb The internal ICC_CTX
+      @param ain an AES_GCM_CTX pointer
+      @param key an aes key, NULL to reuse the key already set in ain
+      @param klen the length of the aes key
+      @param recs the records, tag is checked and out written
+      @param n the number of records
+      @return 1 if every record decrypted with a matching tag, 0 otherwise
+  */
+  int AES_GCM_DecryptBatch(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *key,
+                           unsigned int klen, AES_GCM_REC *recs,
+                           unsigned int n) {
+    return AES_GCM_Batch(pcb, ain, key, klen, recs, n, 0);
+  }
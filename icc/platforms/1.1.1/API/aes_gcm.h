@@ -21,8 +21,19 @@ extern "C" {
 #define AES_GCM_CTRL_GET_ACCEL 1
 #define AES_GCM_CTRL_TLS13 2
 #define AES_GCM_CTRL_TLS12 4
+/*! flags bit, set when AES_GCM_CTRL_TLS13/TLS12 was given a static IV,
+    the context then builds record nonces itself, see AES_GCM_RecordSeal() */
+#define AES_GCM_FLAG_RECORD 0x100
+/*! flags bit, set only while a record call runs, the nonce was derived 
+    internally so AES_GCM_Init() skips the caller IV rollover checks */
+#define AES_GCM_FLAG_RECNONCE 0x200
+
+/*! AES_GCM_CTRL_SET_ACCEL value to select the direct (s390x KMA, POWER8, ARMv8) path 
+    Must match ICC_GCM_ACCEL_direct */
+#define AES_GCM_ACCEL_DIRECT 5
 
 #define IVBLEN 16 /* Length of the fixed internal IV buffer */
+#define AES_GCM_SEG_NONCELEN 7 /* Nonce prefix length for AES_GCM_SegmentSeal()/Open() */
 
 #include "openssl/modes.h"
 /*! @brief The structure of the AES_GCM context */
@@ -46,16 +57,65 @@ typedef struct AES_GCM_struct {
   ** AES_GCM_EncryptFinal 0,1-> 2 */
   unsigned int enc;           /*!< 0 = decrypt */
   unsigned int flags;
+  unsigned int keyed;         /*!< 1 if ctx holds the expanded key for key[], only the IV needs resetting */
+  GCM128_CONTEXT *gh;         /*!< GHASH() state, tables for ghH */
+  unsigned char ghH[16];      /*!< Hash key gh was set up for */
+  void *direct;               /*!< Direct path state, s390x KMA or POWER8/ARMv8, NULL unless AES_GCM_ACCEL_DIRECT was selected */
+  unsigned char recIV[12];    /*!< Record mode: TLS 1.3 static IV, or TLS 1.2 salt in the first 4 bytes */
+  unsigned long long seq;     /*!< Record mode: sequence number of the next record */
 } AES_GCM_CTX_t;
 
 
 typedef struct AES_GCM_CTX_t AES_GCM_CTX;
 
+/*! @brief One fragment of a scatter/gather list for the ..V() AES_GCM/AES_CCM calls 
+    @note Must match the layout of ICC_AES_IOV in icc.h
+*/
+typedef struct AES_IOV_t {
+  unsigned char *base;   /*!< Fragment data */
+  unsigned long len;     /*!< Fragment length */
+} AES_IOV;
+
+/*! @brief Deterministic (SP800-38D 8.2.1) IV generator, safe to share 
+    between threads
+    IV = fixed field || 64 bit big endian invocation counter
+*/
+typedef struct AES_GCM_IVGEN_struct {
+  unsigned long long count;      /*!< IV's handed out, updated atomically */
+  unsigned long long start;      /*!< Random starting point of the invocation field */
+  unsigned char fixed[IVBLEN];   /*!< Fixed field */
+  unsigned int fixedlen;         /*!< Length of the fixed field */
+  CRYPTO_RWLOCK *lock;           /*!< Only used without 64 bit atomics */
+} AES_GCM_IVGEN_t;
+
+typedef struct AES_GCM_IVGEN_t AES_GCM_IVGEN;
+
+#define AES_GCM_IVGEN_MAX (1ULL << 32) /*!< Invocation limit per key */
+
+/*! @brief One record for AES_GCM_EncryptBatch()/AES_GCM_DecryptBatch() 
+    @note Must match the layout of ICC_AES_GCM_REC in icc.h
+*/
+typedef struct AES_GCM_REC_t {
+  unsigned char *iv;     /*!< IV for this record */
+  unsigned long ivlen;   /*!< Length of the IV */
+  unsigned char *aad;    /*!< Additional authentication data, may be NULL */
+  unsigned long aadlen;  /*!< Length of the aad */
+  unsigned char *in;     /*!< Input, plaintext or ciphertext */
+  unsigned long inlen;   /*!< Length of the input */
+  unsigned char *out;    /*!< Output, at least inlen bytes */
+  unsigned char *tag;    /*!< 16 byte tag, written on encrypt, checked on decrypt */
+  int rv;                /*!< 1 if this record was processed O.K. */
+} AES_GCM_REC;
+
 int AES_GCM_GenerateIV(AES_GCM_CTX *gcm_ctx,unsigned char out[8]);
 int AES_GCM_GenerateIV_NIST(AES_GCM_CTX *gcm_ctx,int ivlen,unsigned char *iv);
+AES_GCM_IVGEN *AES_GCM_IVGEN_new(unsigned char *fixed,unsigned int fixedlen);
+int AES_GCM_IVGEN_generate(AES_GCM_IVGEN *gen,unsigned char *iv,unsigned int ivlen);
+void AES_GCM_IVGEN_free(AES_GCM_IVGEN *gen);
 AES_GCM_CTX *AES_GCM_CTX_new();
 void AES_GCM_CTX_free(AES_GCM_CTX *ctx);
 int AES_GCM_CTX_ctrl(AES_GCM_CTX *ain, int mode, int accel, void *ptr);
+void GHASH(AES_GCM_CTX *gcm_ctx,unsigned char *H, unsigned char *Hash, unsigned char *X,unsigned long Xlen);
 
 int AES_GCM_Init(ICClib *pcb,AES_GCM_CTX *ain,
 		 unsigned char *iv,unsigned long ivlen,
@@ -79,6 +139,66 @@ int AES_GCM_DecryptFinal(AES_GCM_CTX *ain,
 			 unsigned char *out, unsigned long *outlen,
 			 unsigned char *hash,unsigned int hlen);
 
+int AES_GCM_Seal(ICClib *pcb,AES_GCM_CTX *ain,
+		 unsigned char *iv,unsigned long ivlen,
+		 unsigned char *key, unsigned int klen,
+		 unsigned char *aad,unsigned long aadlen,
+		 unsigned char *data,unsigned long datalen,
+		 unsigned char *out, unsigned long *outlen);
+
+int AES_GCM_Open(ICClib *pcb,AES_GCM_CTX *ain,
+		 unsigned char *iv,unsigned long ivlen,
+		 unsigned char *key, unsigned int klen,
+		 unsigned char *aad,unsigned long aadlen,
+		 unsigned char *data,unsigned long datalen,
+		 unsigned char *out, unsigned long *outlen);
+
+int AES_GCM_SegmentSeal(ICClib *pcb,AES_GCM_CTX *ain,
+			unsigned char *key, unsigned int klen,
+			unsigned char *nonce,unsigned long seg,int last,
+			unsigned char *aad,unsigned long aadlen,
+			unsigned char *data,unsigned long datalen,
+			unsigned char *out, unsigned long *outlen);
+
+int AES_GCM_SegmentOpen(ICClib *pcb,AES_GCM_CTX *ain,
+			unsigned char *key, unsigned int klen,
+			unsigned char *nonce,unsigned long seg,int last,
+			unsigned char *aad,unsigned long aadlen,
+			unsigned char *data,unsigned long datalen,
+			unsigned char *out, unsigned long *outlen);
+
+int AES_GCM_RecordSeal(ICClib *pcb,AES_GCM_CTX *ain,
+		       unsigned char *key,unsigned int klen,
+		       unsigned char *hdr,unsigned long hdrlen,
+		       unsigned char *data,unsigned long datalen,
+		       unsigned char *out,unsigned long *outlen);
+
+int AES_GCM_RecordOpen(ICClib *pcb,AES_GCM_CTX *ain,
+		       unsigned char *key,unsigned int klen,
+		       unsigned char *hdr,unsigned long hdrlen,
+		       unsigned char *data,unsigned long datalen,
+		       unsigned char *out,unsigned long *outlen);
+
+int AES_GCM_EncryptUpdateV(AES_GCM_CTX *ain,
+			   AES_IOV *aad,unsigned int naad,
+			   AES_IOV *in,unsigned int nin,
+			   AES_IOV *out,unsigned int nout,
+			   unsigned long *outlen);
+
+int AES_GCM_DecryptUpdateV(AES_GCM_CTX *ain,
+			   AES_IOV *aad,unsigned int naad,
+			   AES_IOV *in,unsigned int nin,
+			   AES_IOV *out,unsigned int nout,
+			   unsigned long *outlen);
+
+int AES_GCM_EncryptBatch(ICClib *pcb,AES_GCM_CTX *ain,
+			 unsigned char *key, unsigned int klen,
+			 AES_GCM_REC *recs,unsigned int n);
+
+int AES_GCM_DecryptBatch(ICClib *pcb,AES_GCM_CTX *ain,
+			 unsigned char *key, unsigned int klen,
+			 AES_GCM_REC *recs,unsigned int n);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,171 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+
+/* Note !
+   Bulk AES-XTS for storage, a run of consecutive sectors (data units)
+   in one call with the tweaks derived from the first data unit number.
+   The key schedule is done once in AES_XTS_Init(), each sector 
+   then only costs a tweak reset. OpenSSL's XTS assembler already 
+   interleaves several blocks within a sector, so we keep sectors
+   whole rather than splitting them further.
+*/
+#ifndef AES_DEBUG
+# ifndef NDEBUG
+#  define NDEBUG
+# endif
+#endif
+#include <string.h>
+
+#include "openssl/evp.h"
+#include "icclib.h"
+
+/* Note we need to look these up
+   because the accelerated and non-acclerated objects are different
+   and this has the capability probes done 
+   */
+static const EVP_CIPHER *xts_128 = NULL;
+static const EVP_CIPHER *xts_256 = NULL;
+
+/*! @brief Create an AES_XTS context
+    @return the context or NULL
+*/
+AES_XTS_CTX *AES_XTS_CTX_new(void)
+{
+  AES_XTS_CTX_t *x = NULL;
+
+  x = OPENSSL_malloc(sizeof(AES_XTS_CTX_t));
+  if (NULL != x) {
+    memset(x, 0, sizeof(AES_XTS_CTX_t));
+    x->enc = -1;
+    x->ctx = EVP_CIPHER_CTX_new();
+    if (NULL == x->ctx) {
+      OPENSSL_free(x);
+      x = NULL;
+    }
+  }
+  return (AES_XTS_CTX *)x;
+}
+
+/*! @brief Free an AES_XTS context
+    @param ctx the context, may be NULL
+*/
+void AES_XTS_CTX_free(AES_XTS_CTX *ctx)
+{
+  AES_XTS_CTX_t *x = (AES_XTS_CTX_t *)ctx;
+
+  if (NULL != x) {
+    if (NULL != x->ctx) {
+      EVP_CIPHER_CTX_free(x->ctx);
+    }
+    OPENSSL_cleanse(x, sizeof(AES_XTS_CTX_t));
+    OPENSSL_free(x);
+  }
+}
+
+/*! @brief Set the key and direction of an AES_XTS context
+    @param pcb The internal ICC_CTX
+    @param ctx an AES_XTS_CTX
+    @param key the XTS key, Key1 || Key2
+    @param keylen the length of the key, 32 (AES-128-XTS) or 64 (AES-256-XTS)
+    @param enc 1 encrypt, 0 decrypt
+    @return 1 if O.K., 0 otherwise (including Key1 == Key2)
+*/
+int AES_XTS_Init(ICClib *pcb, AES_XTS_CTX *ctx, unsigned char *key,
+                 unsigned int keylen, int enc)
+{
+  AES_XTS_CTX_t *x = (AES_XTS_CTX_t *)ctx;
+  const EVP_CIPHER *cip = NULL;
+  int rv = 0;
+
+  switch (keylen) {
+  case 32:
+    if (NULL == xts_128) {
+      xts_128 = EVP_get_cipherbyname("aes-128-xts");
+    }
+    cip = xts_128;
+    break;
+  case 64:
+    if (NULL == xts_256) {
+      xts_256 = EVP_get_cipherbyname("aes-256-xts");
+    }
+    cip = xts_256;
+    break;
+  default:
+    break;
+  }
+  if ((NULL != x) && (NULL != key) && (NULL != cip)) {
+    enc = enc ? 1 : 0;
+    x->enc = -1;
+    /* Key1 and Key2 must differ, SP800-38E/FIPS 140 IG C.I */
+    if (0 != CRYPTO_memcmp(key, key + keylen / 2, keylen / 2)) {
+      rv = EVP_CipherInit_ex(x->ctx, cip, NULL, key, NULL, enc);
+    }
+    if (1 == rv) {
+      x->enc = enc;
+    }
+  }
+  if ((1 == rv) && pcb && pcb->callback) {
+    pcb->callback("AES_XTS_Init", EVP_CIPHER_type(cip), 1);
+  }
+  return rv;
+}
+
+/*! @brief Encrypt or decrypt a run of consecutive sectors
+    @param ctx an AES_XTS_CTX set up with AES_XTS_Init()
+    @param dun the data unit (sector) number of the first sector
+    @param sectorlen the sector size, 16 bytes - AES_XTS_MAX_SECTOR
+    @param nsectors the number of sectors
+    @param in the input, nsectors * sectorlen bytes
+    @param out the output, nsectors * sectorlen bytes, may be the same as in
+    @return 1 if O.K., 0 otherwise
+    @note The tweak for sector i is dun + i, as a 128 bit little endian 
+    value (IEEE 1619, dm-crypt "plain64"), a run that crosses 2^64 carries
+    into the upper 8 bytes.
+*/
+int AES_XTS_Sectors(AES_XTS_CTX *ctx, unsigned long long dun,
+                    unsigned long sectorlen, unsigned long nsectors,
+                    unsigned char *in, unsigned char *out)
+{
+  AES_XTS_CTX_t *x = (AES_XTS_CTX_t *)ctx;
+  unsigned char tweak[16];
+  unsigned long long t = 0;
+  unsigned long i = 0;
+  int rv = 0;
+  int outl = 0;
+  int j = 0;
+
+  if ((NULL != x) && (x->enc >= 0) && (NULL != in) && (NULL != out) &&
+      (sectorlen >= 16) && (sectorlen <= AES_XTS_MAX_SECTOR)) {
+    rv = 1;
+    memset(tweak, 0, sizeof(tweak));
+    t = dun;
+    for (j = 0; j < 8; j++) {
+      tweak[j] = (unsigned char)(t & 0xff);
+      t >>= 8;
+    }
+    for (i = 0; (1 == rv) && (i < nsectors); i++) {
+      if (i > 0) {
+        /* 128 bit little endian increment, a run past 2^64-1 carries
+           into the high half
+        */
+        for (j = 0; (j < 16) && (0 == ++tweak[j]); j++)
+          ;
+      }
+      /* Key NULL: only the tweak is reset */
+      rv = EVP_CipherInit_ex(x->ctx, NULL, NULL, NULL, tweak, -1);
+      if (1 == rv) {
+        rv = EVP_CipherUpdate(x->ctx, out, &outl, in, (int)sectorlen);
+      }
+      in += sectorlen;
+      out += sectorlen;
+    }
+    OPENSSL_cleanse(tweak, sizeof(tweak));
+  }
+  return rv;
+}
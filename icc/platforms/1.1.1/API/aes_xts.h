@@ -0,0 +1,41 @@
+/* crypto/aes/aes_xts.h */
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+#ifndef HEADER_AES_XTS_H
+#define HEADER_AES_XTS_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AES_XTS_MAX_SECTOR (1UL << 24) /*!< Largest data unit, SP800-38E 2^20 blocks */
+
+/*! @brief An AES_XTS context for bulk sector (data unit) processing, holds the expanded keys */
+typedef struct AES_XTS_struct {
+  EVP_CIPHER_CTX *ctx;        /*!< OpenSSL's underlying XTS context */
+  int enc;                    /*!< 1 encrypt, 0 decrypt, -1 no key set */
+} AES_XTS_CTX_t;
+
+typedef struct AES_XTS_CTX_t AES_XTS_CTX;
+
+AES_XTS_CTX *AES_XTS_CTX_new(void);
+void AES_XTS_CTX_free(AES_XTS_CTX *ctx);
+int AES_XTS_Init(ICClib *pcb,AES_XTS_CTX *ctx,
+                 unsigned char *key,unsigned int keylen,
+                 int enc);
+int AES_XTS_Sectors(AES_XTS_CTX *ctx,unsigned long long dun,
+                    unsigned long sectorlen,unsigned long nsectors,
+                    unsigned char *in,unsigned char *out);
+
+#ifdef __cplusplus
+}
+#endif
+                                                                           
+#endif
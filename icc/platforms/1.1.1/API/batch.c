@@ -0,0 +1,418 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+
+/* Note !
+   Run an array of small independent operations (digest, HMAC,
+   AEAD seal/open, sign, verify, key agreement) in one call. Each crossing of the
+   ICC stubs (and for GSKit the extra wrapper) costs more than
+   the work for a short message, so callers such as the JNI layer
+   hand over the lot at once.
+   One digest, HMAC and cipher context is allocated per call and
+   reset between operations.
+   Digest verifies are run last, grouped by key and digest, so one
+   EVP_PKEY_CTX (and the key's cached Montgomery context) serves each
+   run of signatures made with the same key, e.g. certificate chains
+   that share an issuer.
+   Key agreement skips the EVP_PKEY_CTX and the peer EVP_PKEY entirely,
+   the peer's encoded public value goes straight to X25519() or
+   ECDH_compute_key(). One EC_POINT and BN_CTX are kept while the curve
+   doesn't change.
+*/
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "openssl/evp.h"
+#include "openssl/hmac.h"
+#include "openssl/ec.h"
+#include "icclib.h"
+
+/* From crypto/ec/curve25519.c, returns 0 for an all zero result */
+int X25519(uint8_t out_shared_key[32], const uint8_t private_key[32],
+           const uint8_t peer_public_value[32]);
+
+/*! @brief The per call working contexts, allocated on first use */
+typedef struct BATCH_CTX_t {
+  EVP_MD_CTX *mctx;
+  HMAC_CTX *hctx;
+  EVP_CIPHER_CTX *cctx;
+  EVP_PKEY_CTX *vctx;   /*!< Digest verify context, set up for vkey and vmd */
+  EVP_PKEY *vkey;       /*!< The key vctx is set up for, NULL if none */
+  const EVP_MD *vmd;    /*!< The digest vctx is set up for */
+  EC_POINT *peer;       /*!< Decoded ECDH peer, points on curve pnid */
+  int pnid;             /*!< The curve peer was created for */
+  BN_CTX *bnctx;        /*!< Point decoding scratch */
+} BATCH_CTX;
+
+/*! @brief One shot digest
+    @param b the working contexts
+    @param op the operation
+    @return 1 if O.K., 0 otherwise
+*/
+static int batch_digest(BATCH_CTX *b, BATCH_OP *op)
+{
+  int rv = 0;
+  unsigned int s = 0;
+
+  if (NULL == b->mctx) {
+    b->mctx = EVP_MD_CTX_new();
+  }
+  if ((NULL != b->mctx) && (NULL != op->md) && (NULL != op->out) &&
+      (op->outlen >= (unsigned long)EVP_MD_size(op->md))) {
+    EVP_MD_CTX_reset(b->mctx);
+    rv = EVP_DigestInit_ex(b->mctx, op->md, NULL);
+    if (1 == rv) {
+      rv = EVP_DigestUpdate(b->mctx, op->in, op->inlen);
+    }
+    if (1 == rv) {
+      rv = EVP_DigestFinal_ex(b->mctx, op->out, &s);
+    }
+    if (1 == rv) {
+      op->outlen = s;
+    }
+  }
+  return (1 == rv) ? 1 : 0;
+}
+
+/*! @brief One shot HMAC
+    @param b the working contexts
+    @param op the operation
+    @return 1 if O.K., 0 otherwise
+*/
+static int batch_hmac(BATCH_CTX *b, BATCH_OP *op)
+{
+  int rv = 0;
+  unsigned int s = 0;
+
+  if (NULL == b->hctx) {
+    b->hctx = HMAC_CTX_new();
+  }
+  if ((NULL != b->hctx) && (NULL != op->md) && (NULL != op->key) &&
+      (op->keylen <= INT_MAX) && (NULL != op->out) &&
+      (op->outlen >= (unsigned long)EVP_MD_size(op->md))) {
+    rv = HMAC_Init_ex(b->hctx, op->key, (int)op->keylen, op->md, NULL);
+    if (1 == rv) {
+      rv = HMAC_Update(b->hctx, op->in, op->inlen);
+    }
+    if (1 == rv) {
+      rv = HMAC_Final(b->hctx, op->out, &s);
+    }
+    if (1 == rv) {
+      op->outlen = s;
+    }
+  }
+  return (1 == rv) ? 1 : 0;
+}
+
+/*! @brief One shot AEAD seal or open
+    @param b the working contexts
+    @param op the operation
+    @param enc 1 seal, 0 open
+    @return 1 if O.K., 0 otherwise. On an open failure the output is cleared
+    @note only AEAD modes that don't need the lengths up front,
+    i.e. GCM and ChaCha20-Poly1305, CCM has it's own API
+*/
+static int batch_aead(BATCH_CTX *b, BATCH_OP *op, int enc)
+{
+  int rv = 0;
+  int chunklen = 0;
+  int fl = 0;
+  const EVP_CIPHER *c = op->cipher;
+
+  if (NULL == b->cctx) {
+    b->cctx = EVP_CIPHER_CTX_new();
+  }
+  if ((NULL != b->cctx) && (NULL != c) &&
+      ((EVP_CIPH_GCM_MODE == EVP_CIPHER_mode(c)) ||
+       (NID_chacha20_poly1305 == EVP_CIPHER_nid(c))) &&
+      (NULL != op->key) && (op->keylen == (unsigned long)EVP_CIPHER_key_length(c)) &&
+      (NULL != op->iv) && (op->ivlen > 0) && (op->ivlen <= INT_MAX) &&
+      (NULL != op->tag) && (op->taglen > 0) && (op->taglen <= 16) &&
+      (op->aadlen <= INT_MAX) && (op->inlen <= INT_MAX) &&
+      ((0 == op->inlen) || ((NULL != op->in) && (NULL != op->out))) &&
+      (op->outlen >= op->inlen)) {
+    EVP_CIPHER_CTX_reset(b->cctx);
+    rv = EVP_CipherInit_ex(b->cctx, c, NULL, NULL, NULL, enc);
+    if (1 == rv) {
+      rv = EVP_CIPHER_CTX_ctrl(b->cctx, EVP_CTRL_AEAD_SET_IVLEN,
+                               (int)op->ivlen, NULL);
+    }
+    if (1 == rv) {
+      rv = EVP_CipherInit_ex(b->cctx, NULL, NULL, op->key, op->iv, enc);
+    }
+    if ((1 == rv) && !enc) {
+      rv = EVP_CIPHER_CTX_ctrl(b->cctx, EVP_CTRL_AEAD_SET_TAG,
+                               (int)op->taglen, op->tag);
+    }
+    if ((1 == rv) && (NULL != op->aad) && (op->aadlen > 0)) {
+      rv = EVP_CipherUpdate(b->cctx, NULL, &chunklen, op->aad, (int)op->aadlen);
+    }
+    if ((1 == rv) && (op->inlen > 0)) {
+      rv = EVP_CipherUpdate(b->cctx, op->out, &chunklen, op->in, (int)op->inlen);
+    }
+    if (1 == rv) {
+      rv = EVP_CipherFinal_ex(b->cctx,
+                              (NULL != op->out) ? op->out + op->inlen : NULL, &fl);
+    }
+    if ((1 == rv) && enc) {
+      rv = EVP_CIPHER_CTX_ctrl(b->cctx, EVP_CTRL_AEAD_GET_TAG,
+                               (int)op->taglen, op->tag);
+    }
+    if (1 == rv) {
+      op->outlen = op->inlen;
+    } else {
+      if (!enc && (NULL != op->out)) {
+        memset(op->out, 0, op->inlen);
+      }
+      rv = 0;
+    }
+  }
+  return rv;
+}
+
+/*! @brief One shot sign or verify
+    @param b the working contexts
+    @param op the operation
+    @param sign 1 sign, 0 verify
+    @return 1 if O.K. (or the signature matched), 0 otherwise
+*/
+static int batch_sig(BATCH_CTX *b, BATCH_OP *op, int sign)
+{
+  int rv = 0;
+  size_t siglen = 0;
+
+  if (NULL == b->mctx) {
+    b->mctx = EVP_MD_CTX_new();
+  }
+  if ((NULL != b->mctx) && (NULL != op->pkey) && (NULL != op->out)) {
+    EVP_MD_CTX_reset(b->mctx);
+    siglen = op->outlen;
+    if (sign) {
+      rv = EVP_DigestSignInit(b->mctx, NULL, op->md, NULL, op->pkey);
+      if (1 == rv) {
+        rv = EVP_DigestSign(b->mctx, op->out, &siglen, op->in, op->inlen);
+      }
+      if (1 == rv) {
+        op->outlen = siglen;
+      }
+    } else {
+      rv = EVP_DigestVerifyInit(b->mctx, NULL, op->md, NULL, op->pkey);
+      if (1 == rv) {
+        rv = EVP_DigestVerify(b->mctx, op->out, siglen, op->in, op->inlen);
+      }
+    }
+  }
+  return (1 == rv) ? 1 : 0;
+}
+
+/*! @brief Verify a signature over a digest
+    @param b the working contexts
+    @param op the operation
+    @return 1 if the signature matched, 0 otherwise
+    @note The verify context is kept while the key and digest are unchanged
+*/
+static int batch_vdigest(BATCH_CTX *b, BATCH_OP *op)
+{
+  int rv = 0;
+
+  if ((NULL == op->pkey) || (NULL == op->in) || (NULL == op->out)) {
+    return 0;
+  }
+  if ((NULL == b->vkey) || (op->pkey != b->vkey) || (op->md != b->vmd)) {
+    EVP_PKEY_CTX_free(b->vctx);
+    b->vkey = NULL;
+    b->vmd = NULL;
+    b->vctx = EVP_PKEY_CTX_new(op->pkey, NULL);
+    if ((NULL != b->vctx) && (1 == EVP_PKEY_verify_init(b->vctx)) &&
+       ((NULL == op->md) || (0 < EVP_PKEY_CTX_set_signature_md(b->vctx, op->md)))) {
+      b->vkey = op->pkey;
+      b->vmd = op->md;
+    }
+  }
+  if (NULL != b->vkey) {
+    rv = EVP_PKEY_verify(b->vctx, op->out, op->outlen, op->in, op->inlen);
+  }
+  return (1 == rv) ? 1 : 0;
+}
+
+/*! @brief Key agreement, X25519 or ECDH without a KDF
+    @param b the working contexts
+    @param op the operation, pkey our private key, in the peer's public
+           value, 32 bytes for X25519 or an encoded point on pkey's curve
+    @return 1 if O.K., 0 otherwise
+    @note The peer point is rejected unless it decodes onto the curve and
+    isn't the point at infinity, as for EVP_PKEY_derive() 
+*/
+static int batch_derive(BATCH_CTX *b, BATCH_OP *op)
+{
+  int rv = 0;
+  int nid = 0;
+  int len = 0;
+  size_t plen = 32;
+  unsigned char priv[32];
+  EC_KEY *eck = NULL;
+  const EC_GROUP *grp = NULL;
+
+  if ((NULL == op->pkey) || (NULL == op->in) || (NULL == op->out)) {
+    return 0;
+  }
+  switch (EVP_PKEY_id(op->pkey)) {
+  case EVP_PKEY_X25519:
+    if ((32 == op->inlen) && (op->outlen >= 32) &&
+        (1 == EVP_PKEY_get_raw_private_key(op->pkey, priv, &plen)) && (32 == plen)) {
+      rv = X25519(op->out, priv, op->in);
+      if (1 == rv) {
+        op->outlen = 32;
+      }
+    }
+    OPENSSL_cleanse(priv, sizeof(priv));
+    break;
+  case EVP_PKEY_EC:
+    eck = EVP_PKEY_get0_EC_KEY(op->pkey);
+    grp = (NULL == eck) ? NULL : EC_KEY_get0_group(eck);
+    if (NULL == grp) {
+      break;
+    }
+    nid = EC_GROUP_get_curve_name(grp);
+    if ((NULL == b->peer) || (0 == nid) || (nid != b->pnid)) {
+      EC_POINT_free(b->peer);
+      b->peer = EC_POINT_new(grp);
+      b->pnid = nid;
+    }
+    if (NULL == b->bnctx) {
+      b->bnctx = BN_CTX_new();
+    }
+    len = (EC_GROUP_get_degree(grp) + 7) / 8;
+    if ((NULL != b->peer) && (NULL != b->bnctx) && (op->outlen >= (unsigned long)len) &&
+        (1 == EC_POINT_oct2point(grp, b->peer, op->in, op->inlen, b->bnctx)) &&
+        !EC_POINT_is_at_infinity(grp, b->peer) &&
+        (len == ECDH_compute_key(op->out, len, b->peer, eck, NULL))) {
+      op->outlen = len;
+      rv = 1;
+    }
+    break;
+  default:
+    break;
+  }
+  return (1 == rv) ? 1 : 0;
+}
+
+/*! @brief qsort() order for digest verifies, by key, then digest, then position */
+static int batch_key_cmp(const void *a, const void *b)
+{
+  const BATCH_OP *x = *(const BATCH_OP * const *)a;
+  const BATCH_OP *y = *(const BATCH_OP * const *)b;
+
+  if (x->pkey != y->pkey) {
+    return ((size_t)x->pkey < (size_t)y->pkey) ? -1 : 1;
+  }
+  if (x->md != y->md) {
+    return ((size_t)x->md < (size_t)y->md) ? -1 : 1;
+  }
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+/*! @brief Run an array of independent operations
+    @param ops the operations
+    @param n the number of operations
+    @return 1 if every operation succeeded, 0 otherwise
+    @note Operations are independent, a failure in one doesn't
+    stop the rest, check ops[i].rv.
+*/
+int BATCH_Run(BATCH_OP *ops, unsigned int n)
+{
+  int rv = 1;
+  unsigned int i = 0;
+  unsigned int j = 0;
+  unsigned int m = 0;
+  BATCH_OP *op = NULL;
+  BATCH_OP **grp = NULL;
+  BATCH_CTX b;
+
+  memset(&b, 0, sizeof(b));
+  if (NULL == ops) {
+    rv = 0;
+    n = 0;
+  }
+  for (i = 0; i < n; i++) {
+    op = &ops[i];
+    switch (op->op) {
+    case ICC_BATCH_DIGEST:
+      op->rv = batch_digest(&b, op);
+      break;
+    case ICC_BATCH_HMAC:
+      op->rv = batch_hmac(&b, op);
+      break;
+    case ICC_BATCH_AEAD_SEAL:
+      op->rv = batch_aead(&b, op, 1);
+      break;
+    case ICC_BATCH_AEAD_OPEN:
+      op->rv = batch_aead(&b, op, 0);
+      break;
+    case ICC_BATCH_SIGN:
+      op->rv = batch_sig(&b, op, 1);
+      break;
+    case ICC_BATCH_VERIFY:
+      op->rv = batch_sig(&b, op, 0);
+      break;
+    case ICC_BATCH_VERIFY_DIGEST:
+      m++; /* Later, grouped by key */
+      break;
+    case ICC_BATCH_DERIVE:
+      op->rv = batch_derive(&b, op);
+      break;
+    default:
+      op->rv = 0;
+      break;
+    }
+  }
+  if (m > 0) {
+    grp = (BATCH_OP **)OPENSSL_malloc(m * sizeof(BATCH_OP *));
+    for (i = 0; i < n; i++) {
+      if (ICC_BATCH_VERIFY_DIGEST == ops[i].op) {
+        if (NULL != grp) {
+          grp[j++] = &ops[i];
+        } else {
+          ops[i].rv = batch_vdigest(&b, &ops[i]);
+        }
+      }
+    }
+    if (NULL != grp) {
+      qsort(grp, m, sizeof(BATCH_OP *), batch_key_cmp);
+      for (j = 0; j < m; j++) {
+        grp[j]->rv = batch_vdigest(&b, grp[j]);
+      }
+      OPENSSL_free(grp);
+    }
+  }
+  for (i = 0; (NULL != ops) && (i < n); i++) {
+    if (1 != ops[i].rv) {
+      rv = 0;
+    }
+  }
+  if (NULL != b.mctx) {
+    EVP_MD_CTX_free(b.mctx);
+  }
+  if (NULL != b.hctx) {
+    HMAC_CTX_free(b.hctx);
+  }
+  if (NULL != b.cctx) {
+    EVP_CIPHER_CTX_free(b.cctx);
+  }
+  if (NULL != b.vctx) {
+    EVP_PKEY_CTX_free(b.vctx);
+  }
+  if (NULL != b.peer) {
+    EC_POINT_free(b.peer);
+  }
+  if (NULL != b.bnctx) {
+    BN_CTX_free(b.bnctx);
+  }
+  return rv;
+}
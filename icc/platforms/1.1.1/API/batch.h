@@ -0,0 +1,51 @@
+/* crypto/batch/batch.h */
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+#ifndef HEADER_BATCH_H
+#define HEADER_BATCH_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! @brief One operation for BATCH_Run()
+    @note Must match the layout of ICC_BATCH_OP in icc.h
+    op is one of the ICC_BATCH_ values in iccglobals.h
+*/
+typedef struct BATCH_OP_t {
+  int op;                   /*!< ICC_BATCH_DIGEST ... ICC_BATCH_DERIVE */
+  const EVP_MD *md;         /*!< Digest, HMAC, sign and verify, may be NULL for Ed25519/Ed448 */
+  const EVP_CIPHER *cipher; /*!< AEAD only, GCM or ChaCha20-Poly1305 */
+  EVP_PKEY *pkey;           /*!< Sign and verify, for derive our private key, X25519 or EC */
+  unsigned char *key;       /*!< HMAC and AEAD key */
+  unsigned long keylen;     /*!< Length of the key */
+  unsigned char *iv;        /*!< AEAD nonce */
+  unsigned long ivlen;      /*!< Length of the nonce */
+  unsigned char *aad;       /*!< AEAD additional authentication data, may be NULL */
+  unsigned long aadlen;     /*!< Length of the aad */
+  unsigned char *in;        /*!< Input, data to hash/MAC/sign/verify or plaintext/ciphertext.
+                                 For derive, the peer's public value, 32 bytes X25519 or an encoded EC point */
+  unsigned long inlen;      /*!< Length of the input */
+  unsigned char *out;       /*!< Output, the digest, MAC, signature, AEAD output or shared secret.
+                                 For verify, the signature to check */
+  unsigned long outlen;     /*!< In, the size of out. Returned, the bytes written.
+                                 For verify, the signature length */
+  unsigned char *tag;       /*!< AEAD tag, written on seal, checked on open */
+  unsigned long taglen;     /*!< Length of the tag */
+  int rv;                   /*!< Returned, 1 if this operation succeeded */
+} BATCH_OP;
+
+int BATCH_Run(BATCH_OP *ops,unsigned int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,279 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+
+/* Note !
+   One shot ChaCha20-Poly1305 (RFC 8439) on a reusable keyed context,
+   the same shape as AES_CCM_Seal()/AES_CCM_Open(), plus a batch call
+   for many small independent messages under one key.
+   OpenSSL's ChaCha20 assembler already runs 4 or 8 blocks across
+   SIMD lanes within a message, what a batch saves is the per message
+   context setup and API overhead.
+*/
+#ifndef AES_DEBUG
+# ifndef NDEBUG
+#  define NDEBUG
+# endif
+#endif
+#include <string.h>
+#include <limits.h>
+
+#include "openssl/evp.h"
+#include "icclib.h"
+
+/* Note we need to look this up
+   because the accelerated and non-acclerated objects are different
+   and this has the capability probes done
+   */
+static const EVP_CIPHER *chacha_poly = NULL;
+
+/*! @brief Create a ChaCha20-Poly1305 context
+    @return the context or NULL
+*/
+CHACHA_POLY_CTX *CHACHA_POLY_CTX_new(void)
+{
+  CHACHA_POLY_CTX_t *c = NULL;
+
+  c = OPENSSL_malloc(sizeof(CHACHA_POLY_CTX_t));
+  if (NULL != c) {
+    memset(c, 0, sizeof(CHACHA_POLY_CTX_t));
+    c->ctx = EVP_CIPHER_CTX_new();
+    if (NULL == c->ctx) {
+      OPENSSL_free(c);
+      c = NULL;
+    }
+  }
+  return (CHACHA_POLY_CTX *)c;
+}
+
+/*! @brief Free a ChaCha20-Poly1305 context
+    @param ctx the context, may be NULL
+*/
+void CHACHA_POLY_CTX_free(CHACHA_POLY_CTX *ctx)
+{
+  CHACHA_POLY_CTX_t *c = (CHACHA_POLY_CTX_t *)ctx;
+
+  if (NULL != c) {
+    if (NULL != c->ctx) {
+      EVP_CIPHER_CTX_free(c->ctx);
+    }
+    OPENSSL_cleanse(c, sizeof(CHACHA_POLY_CTX_t));
+    OPENSSL_free(c);
+  }
+}
+
+/*! @brief Set the key for following Seal/Open calls
+    @param pcb The internal ICC_CTX
+    @param ctx a CHACHA_POLY_CTX
+    @param key the key
+    @param keylen the length of the key, must be 32
+    @return 1 if O.K., 0 otherwise
+*/
+int CHACHA_POLY_Init(ICClib *pcb, CHACHA_POLY_CTX *ctx, unsigned char *key,
+                     unsigned int keylen)
+{
+  CHACHA_POLY_CTX_t *c = (CHACHA_POLY_CTX_t *)ctx;
+  int rv = 0;
+
+  if (NULL == chacha_poly) {
+    chacha_poly = EVP_get_cipherbyname("ChaCha20-Poly1305");
+  }
+  if ((NULL != c) && (NULL != key) && (NULL != chacha_poly) &&
+      (CHACHA_POLY_KEYLEN == keylen)) {
+    c->keyed = 0;
+    rv = EVP_CipherInit_ex(c->ctx, chacha_poly, NULL, key, NULL, 1);
+    if (1 == rv) {
+      c->keyed = 1;
+    }
+  }
+  if ((1 == rv) && pcb && pcb->callback) {
+    pcb->callback("CHACHA_POLY_Init", EVP_CIPHER_type(chacha_poly), 1);
+  }
+  return rv;
+}
+
+/*! @brief Process one message on a keyed context
+    @param c a keyed CHACHA_POLY_CTX
+    @param iv the 12 byte nonce
+    @param aad additional authentication data, may be NULL
+    @param aadlen the length of the aad
+    @param in the input
+    @param inlen the length of the input
+    @param out the output, inlen bytes
+    @param tag the 16 byte tag, written on encrypt, checked on decrypt
+    @param enc 1 encrypt, 0 decrypt
+    @return 1 if O.K., 0 otherwise. On a decrypt failure the output is cleared
+*/
+static int chacha_poly_msg(CHACHA_POLY_CTX_t *c, unsigned char *iv,
+                           unsigned char *aad, unsigned long aadlen,
+                           unsigned char *in, unsigned long inlen,
+                           unsigned char *out, unsigned char *tag, int enc)
+{
+  int rv = 0;
+  int chunklen = 0;
+  int fl = 0;
+
+  if ((NULL != c) && c->keyed && (NULL != iv) && (NULL != tag) &&
+      (aadlen <= INT_MAX) && (inlen <= INT_MAX) &&
+      ((0 == inlen) || ((NULL != in) && (NULL != out)))) {
+    /* Key NULL: only the nonce is reset, the counter and Poly1305 state
+       restart from it */
+    rv = EVP_CipherInit_ex(c->ctx, NULL, NULL, NULL, iv, enc);
+    if ((1 == rv) && !enc) {
+      rv = EVP_CIPHER_CTX_ctrl(c->ctx, EVP_CTRL_AEAD_SET_TAG,
+                               CHACHA_POLY_TAGLEN, tag);
+    }
+    if ((1 == rv) && (NULL != aad) && (aadlen > 0)) {
+      rv = EVP_CipherUpdate(c->ctx, NULL, &chunklen, aad, (int)aadlen);
+    }
+    if ((1 == rv) && (inlen > 0)) {
+      rv = EVP_CipherUpdate(c->ctx, out, &chunklen, in, (int)inlen);
+    }
+    if (1 == rv) {
+      rv = EVP_CipherFinal_ex(c->ctx, (NULL != out) ? out + inlen : NULL, &fl);
+    }
+    if ((1 == rv) && enc) {
+      rv = EVP_CIPHER_CTX_ctrl(c->ctx, EVP_CTRL_AEAD_GET_TAG,
+                               CHACHA_POLY_TAGLEN, tag);
+    }
+    if (1 != rv) {
+      if (!enc && (NULL != out)) {
+        memset(out, 0, inlen);
+      }
+      rv = 0;
+    }
+  }
+  return rv;
+}
+
+/*! @brief ChaCha20-Poly1305 encrypt with a reusable context
+    @param ctx a CHACHA_POLY_CTX set up with CHACHA_POLY_Init()
+    @param iv the nonce
+    @param ivlen the length of the nonce, must be 12
+    @param aad additional authentication data, may be NULL
+    @param aadlen the length of the aad
+    @param data the plaintext
+    @param datalen the length of the plaintext
+    @param out the output buffer, at least datalen + 16 bytes,
+    receives ciphertext || tag
+    @param outlen a place to store the output length
+    @return 1 if O.K., 0 otherwise
+*/
+int CHACHA_POLY_Seal(CHACHA_POLY_CTX *ctx, unsigned char *iv,
+                     unsigned int ivlen, unsigned char *aad,
+                     unsigned long aadlen, unsigned char *data,
+                     unsigned long datalen, unsigned char *out,
+                     unsigned long *outlen)
+{
+  int rv = 0;
+
+  if (NULL != outlen) {
+    *outlen = 0;
+    if ((CHACHA_POLY_IVLEN == ivlen) && (NULL != out)) {
+      rv = chacha_poly_msg((CHACHA_POLY_CTX_t *)ctx, iv, aad, aadlen,
+                           data, datalen, out, out + datalen, 1);
+    }
+    if (1 == rv) {
+      *outlen = datalen + CHACHA_POLY_TAGLEN;
+    }
+  }
+  return rv;
+}
+
+/*! @brief ChaCha20-Poly1305 decrypt with a reusable context
+    @param ctx a CHACHA_POLY_CTX set up with CHACHA_POLY_Init()
+    @param iv the nonce
+    @param ivlen the length of the nonce, must be 12
+    @param aad additional authentication data, may be NULL
+    @param aadlen the length of the aad
+    @param data ciphertext || tag
+    @param datalen the length of the ciphertext and tag
+    @param out the output buffer, at least datalen - 16 bytes
+    @param outlen a place to store the plaintext length
+    @return 1 if the tag matched, 0 otherwise, the output is cleared on failure
+*/
+int CHACHA_POLY_Open(CHACHA_POLY_CTX *ctx, unsigned char *iv,
+                     unsigned int ivlen, unsigned char *aad,
+                     unsigned long aadlen, unsigned char *data,
+                     unsigned long datalen, unsigned char *out,
+                     unsigned long *outlen)
+{
+  int rv = 0;
+  unsigned char tag[CHACHA_POLY_TAGLEN];
+
+  if (NULL != outlen) {
+    *outlen = 0;
+    if ((CHACHA_POLY_IVLEN == ivlen) && (NULL != data) &&
+        (datalen >= CHACHA_POLY_TAGLEN)) {
+      datalen -= CHACHA_POLY_TAGLEN;
+      memcpy(tag, data + datalen, CHACHA_POLY_TAGLEN);
+      rv = chacha_poly_msg((CHACHA_POLY_CTX_t *)ctx, iv, aad, aadlen,
+                           data, datalen, out, tag, 0);
+    }
+    if (1 == rv) {
+      *outlen = datalen;
+    }
+  }
+  return rv;
+}
+
+/*! @brief Process an array of independent records under one key
+    @param ctx a CHACHA_POLY_CTX set up with CHACHA_POLY_Init()
+    @param recs the records
+    @param n the number of records
+    @param enc 1 encrypt, 0 decrypt
+    @return 1 if every record was processed O.K., 0 otherwise
+    @note Records are independent, a failure in one (i.e. a tag mismatch)
+    doesn't stop the rest, check recs[i].rv.
+    On a decrypt failure that record's output is cleared.
+*/
+static int CHACHA_POLY_Batch(CHACHA_POLY_CTX *ctx, CHACHA_POLY_REC *recs,
+                             unsigned int n, int enc)
+{
+  int rv = 1;
+  unsigned int i = 0;
+  CHACHA_POLY_REC *r = NULL;
+
+  if (NULL == recs) {
+    rv = 0;
+    n = 0;
+  }
+  for (i = 0; i < n; i++) {
+    r = &recs[i];
+    r->rv = chacha_poly_msg((CHACHA_POLY_CTX_t *)ctx, r->iv, r->aad, r->aadlen,
+                            r->in, r->inlen, r->out, r->tag, enc);
+    if (1 != r->rv) {
+      rv = 0;
+    }
+  }
+  return rv;
+}
+
+/*! @brief Encrypt an array of independent records under one key
+    @param ctx a CHACHA_POLY_CTX set up with CHACHA_POLY_Init()
+    @param recs the records, out and tag are written
+    @param n the number of records
+    @return 1 if every record was encrypted, 0 otherwise
+*/
+int CHACHA_POLY_SealBatch(CHACHA_POLY_CTX *ctx, CHACHA_POLY_REC *recs,
+                          unsigned int n)
+{
+  return CHACHA_POLY_Batch(ctx, recs, n, 1);
+}
+
+/*! @brief Decrypt and verify an array of independent records under one key
+    @param ctx a CHACHA_POLY_CTX set up with CHACHA_POLY_Init()
+    @param recs the records, tag is checked and out written
+    @param n the number of records
+    @return 1 if every record decrypted with a matching tag, 0 otherwise
+*/
+int CHACHA_POLY_OpenBatch(CHACHA_POLY_CTX *ctx, CHACHA_POLY_REC *recs,
+                          unsigned int n)
+{
+  return CHACHA_POLY_Batch(ctx, recs, n, 0);
+}
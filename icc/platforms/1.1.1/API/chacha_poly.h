@@ -0,0 +1,65 @@
+/* crypto/chacha/chacha_poly.h */
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+#ifndef HEADER_CHACHA_POLY_H
+#define HEADER_CHACHA_POLY_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHACHA_POLY_KEYLEN 32 /*!< ChaCha20 key length */
+#define CHACHA_POLY_IVLEN  12 /*!< RFC 8439 nonce length */
+#define CHACHA_POLY_TAGLEN 16 /*!< Poly1305 tag length */
+
+/*! @brief A reusable ChaCha20-Poly1305 context, keeps the key between messages */
+typedef struct CHACHA_POLY_struct {
+  EVP_CIPHER_CTX *ctx;        /*!< OpenSSL's underlying ChaCha20-Poly1305 context */
+  int keyed;                  /*!< 1 once a key has been set */
+} CHACHA_POLY_CTX_t;
+
+typedef struct CHACHA_POLY_CTX_t CHACHA_POLY_CTX;
+
+/*! @brief One record for CHACHA_POLY_SealBatch()/CHACHA_POLY_OpenBatch()
+    @note Must match the layout of ICC_CHACHA_POLY_REC in icc.h
+*/
+typedef struct CHACHA_POLY_REC_t {
+  unsigned char *iv;     /*!< 12 byte nonce for this record */
+  unsigned char *aad;    /*!< Additional authentication data, may be NULL */
+  unsigned long aadlen;  /*!< Length of the aad */
+  unsigned char *in;     /*!< Input, plaintext or ciphertext */
+  unsigned long inlen;   /*!< Length of the input */
+  unsigned char *out;    /*!< Output, at least inlen bytes */
+  unsigned char *tag;    /*!< 16 byte tag, written on seal, checked on open */
+  int rv;                /*!< Returned, 1 if this record was processed O.K. */
+} CHACHA_POLY_REC;
+
+CHACHA_POLY_CTX *CHACHA_POLY_CTX_new(void);
+void CHACHA_POLY_CTX_free(CHACHA_POLY_CTX *ctx);
+int CHACHA_POLY_Init(ICClib *pcb,CHACHA_POLY_CTX *ctx,
+                     unsigned char *key,unsigned int keylen);
+int CHACHA_POLY_Seal(CHACHA_POLY_CTX *ctx,unsigned char *iv,unsigned int ivlen,
+                     unsigned char *aad, unsigned long aadlen,
+                     unsigned char *data,unsigned long datalen,
+                     unsigned char *out, unsigned long *outlen);
+int CHACHA_POLY_Open(CHACHA_POLY_CTX *ctx,unsigned char *iv,unsigned int ivlen,
+                     unsigned char *aad, unsigned long aadlen,
+                     unsigned char *data,unsigned long datalen,
+                     unsigned char *out, unsigned long *outlen);
+int CHACHA_POLY_SealBatch(CHACHA_POLY_CTX *ctx,
+                          CHACHA_POLY_REC *recs,unsigned int n);
+int CHACHA_POLY_OpenBatch(CHACHA_POLY_CTX *ctx,
+                          CHACHA_POLY_REC *recs,unsigned int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,231 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+
+/* Note !
+   Fixed base exponentiation for DH key generation.
+   The generator of a named group never changes, so g^(j.2^(4i)) for
+   every 4 bit window i and digit j can be computed once. g^x is then
+   one Montgomery multiply per window of x, and no squarings,
+   against roughly one squaring per bit for BN_mod_exp_mont_consttime().
+
+   The table is public data (powers of g), the exponent isn't.
+   Each window reads all 16 entries of its row and keeps the one it needs
+   with a mask so the memory access pattern doesn't depend on x.
+
+   A table is built once and only read afterwards, it can be shared
+   between threads without locking.
+*/
+#include <string.h>
+
+#include "openssl/bn.h"
+#include "openssl/crypto.h"
+#include "crypto/bn.h"
+#include "dh_comb.h"
+
+#define DH_COMB_ROW (1 << DH_COMB_WINDOW) /*!< Entries per window */
+
+/*! @brief Fixed base table */
+struct DH_COMB_t {
+  BN_MONT_CTX *mont;  /*!< Montgomery context for p */
+  BIGNUM *one;        /*!< R mod p, top fixed at nw words */
+  int bits;           /*!< Largest exponent handled */
+  int nwin;           /*!< Windows, bits/DH_COMB_WINDOW rounded up */
+  int nw;             /*!< Words per entry, the size of p */
+  BN_ULONG *tbl;      /*!< nwin rows of DH_COMB_ROW entries, Montgomery form */
+};
+
+/*! @brief Constant time table read
+    @param out nw words
+    @param row the row for this window
+    @param nw words per entry
+    @param idx the entry wanted, secret
+*/
+static void comb_gather(BN_ULONG *out, const BN_ULONG *row, int nw, unsigned int idx)
+{
+  unsigned int j;
+  int k;
+  BN_ULONG mask;
+
+  memset(out, 0, nw * sizeof(BN_ULONG));
+  for (j = 0; j < DH_COMB_ROW; j++) {
+    /* all ones when j == idx, both are < 16 */
+    mask = (BN_ULONG)0 - (BN_ULONG)(((j ^ idx) - 1) >> (sizeof(unsigned int) * 8 - 1));
+    for (k = 0; k < nw; k++) {
+      out[k] |= row[k] & mask;
+    }
+    row += nw;
+  }
+}
+
+/*! @brief Build the table for a fixed generator
+    @param p the odd modulus
+    @param g the generator, 1 < g < p
+    @param bits the largest exponent the table will be used for
+    @return the table or NULL
+*/
+DH_COMB *DH_COMB_new(const BIGNUM *p, const BIGNUM *g, int bits)
+{
+  DH_COMB *comb = NULL;
+  BN_CTX *ctx = NULL;
+  BIGNUM *base = NULL;
+  BIGNUM *e = NULL;
+  BN_ULONG *row = NULL;
+  int ok = 0;
+  int i, j;
+
+  if ((NULL == p) || (NULL == g) || (bits <= 0) || !BN_is_odd(p) ||
+      (BN_cmp(g, BN_value_one()) <= 0) || (BN_cmp(g, p) >= 0)) {
+    return NULL;
+  }
+  comb = OPENSSL_zalloc(sizeof(DH_COMB));
+  ctx = BN_CTX_new();
+  if ((NULL == comb) || (NULL == ctx)) {
+    goto err;
+  }
+  BN_CTX_start(ctx);
+  base = BN_CTX_get(ctx);
+  e = BN_CTX_get(ctx);
+  comb->mont = BN_MONT_CTX_new();
+  comb->one = BN_new();
+  comb->bits = bits;
+  comb->nwin = (bits + DH_COMB_WINDOW - 1) / DH_COMB_WINDOW;
+  comb->nw = bn_get_top(p);
+  comb->tbl = OPENSSL_malloc((size_t)comb->nwin * DH_COMB_ROW * comb->nw * sizeof(BN_ULONG));
+  if ((NULL == e) || (NULL == comb->mont) || (NULL == comb->one) ||
+      (NULL == comb->tbl) ||
+      (1 != BN_MONT_CTX_set(comb->mont, p, ctx)) ||
+      (1 != bn_to_mont_fixed_top(comb->one, BN_value_one(), comb->mont, ctx)) ||
+      (1 != bn_to_mont_fixed_top(base, g, comb->mont, ctx))) {
+    goto err;
+  }
+  /* row i holds (g^(2^(4i)))^j, base steps up by 2^4 each row */
+  row = comb->tbl;
+  for (i = 0; i < comb->nwin; i++) {
+    if ((1 != bn_copy_words(row, comb->one, comb->nw)) ||
+        (NULL == BN_copy(e, base)) ||
+        (1 != bn_copy_words(row + comb->nw, e, comb->nw))) {
+      goto err;
+    }
+    for (j = 2; j < DH_COMB_ROW; j++) {
+      if ((1 != bn_mul_mont_fixed_top(e, e, base, comb->mont, ctx)) ||
+          (1 != bn_copy_words(row + j * comb->nw, e, comb->nw))) {
+        goto err;
+      }
+    }
+    for (j = 0; j < DH_COMB_WINDOW; j++) {
+      if (1 != bn_mul_mont_fixed_top(base, base, base, comb->mont, ctx)) {
+        goto err;
+      }
+    }
+    row += DH_COMB_ROW * comb->nw;
+  }
+  ok = 1;
+err:
+  if (NULL != ctx) {
+    BN_CTX_end(ctx);
+    BN_CTX_free(ctx);
+  }
+  if (!ok) {
+    DH_COMB_free(comb);
+    comb = NULL;
+  }
+  return comb;
+}
+
+/*! @brief Free a table
+    @param comb the table, may be NULL
+*/
+void DH_COMB_free(DH_COMB *comb)
+{
+  if (NULL != comb) {
+    BN_MONT_CTX_free(comb->mont);
+    BN_free(comb->one);
+    OPENSSL_free(comb->tbl);
+    OPENSSL_free(comb);
+  }
+}
+
+/*! @brief The largest exponent a table handles
+    @param comb the table
+    @return the size in bits
+*/
+int DH_COMB_bits(const DH_COMB *comb)
+{
+  return (NULL == comb) ? 0 : comb->bits;
+}
+
+/*! @brief r = g^x mod p
+    @param comb the table for g and p
+    @param r the result
+    @param x the exponent, secret, no longer than DH_COMB_bits()
+    @param ctx scratch, a secure BN_CTX is best as x is copied into it
+    @return 1 on success, 0 otherwise
+*/
+int DH_COMB_exp(const DH_COMB *comb, BIGNUM *r, const BIGNUM *x, BN_CTX *ctx)
+{
+  int rv = 0;
+  int i;
+  int xw;
+  unsigned int d;
+  BIGNUM *acc = NULL;
+  BIGNUM *t = NULL;
+  BIGNUM *xb = NULL;
+  BN_ULONG *xd = NULL;
+  const BN_ULONG *row = NULL;
+
+  if ((NULL == comb) || (NULL == r) || (NULL == x) || (NULL == ctx) ||
+      BN_is_negative(x) || (BN_num_bits(x) > comb->bits)) {
+    return 0;
+  }
+  xw = (comb->nwin * DH_COMB_WINDOW + BN_BITS2 - 1) / BN_BITS2;
+  BN_CTX_start(ctx);
+  acc = BN_CTX_get(ctx);
+  t = BN_CTX_get(ctx);
+  xb = BN_CTX_get(ctx);
+  /* Copies of R fix the size of acc and t at nw words,
+     which keeps bn_mul_mont_fixed_top() on the same code path every call
+  */
+  if ((NULL == xb) || (NULL == bn_wexpand(xb, xw)) ||
+      (NULL == BN_copy(acc, comb->one)) || (NULL == BN_copy(t, comb->one))) {
+    goto err;
+  }
+  xd = bn_get_words(xb);
+  if (1 != bn_copy_words(xd, x, xw)) {
+    goto err;
+  }
+  row = comb->tbl;
+  for (i = 0; i < comb->nwin; i++) {
+    /* BN_BITS2 is a multiple of the window, digits never straddle words */
+    d = (unsigned int)(xd[(i * DH_COMB_WINDOW) / BN_BITS2] >>
+                       ((i * DH_COMB_WINDOW) % BN_BITS2)) & (DH_COMB_ROW - 1);
+    if (0 == i) {
+      comb_gather(bn_get_words(acc), row, comb->nw, d);
+    } else {
+      comb_gather(bn_get_words(t), row, comb->nw, d);
+      if (1 != bn_mul_mont_fixed_top(acc, acc, t, comb->mont, ctx)) {
+        goto err;
+      }
+    }
+    row += DH_COMB_ROW * comb->nw;
+  }
+  rv = BN_from_montgomery(r, acc, comb->mont, ctx);
+err:
+  if (NULL != xd) {
+    OPENSSL_cleanse(xd, xw * sizeof(BN_ULONG));
+  }
+  if (NULL != t) {
+    BN_clear(t);
+  }
+  if (NULL != acc) {
+    BN_clear(acc);
+  }
+  d = 0;
+  BN_CTX_end(ctx);
+  return rv;
+}
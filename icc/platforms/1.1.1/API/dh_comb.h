@@ -0,0 +1,32 @@
+/* crypto/dh/dh_comb.h */
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+#ifndef HEADER_DH_COMB_H
+#define HEADER_DH_COMB_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DH_COMB_WINDOW 4 /*!< Exponent bits per table row */
+
+/*! @brief Fixed base table for g^x mod p */
+typedef struct DH_COMB_t DH_COMB;
+
+DH_COMB *DH_COMB_new(const BIGNUM *p,const BIGNUM *g,int bits);
+void DH_COMB_free(DH_COMB *comb);
+int DH_COMB_exp(const DH_COMB *comb,BIGNUM *r,const BIGNUM *x,BN_CTX *ctx);
+int DH_COMB_bits(const DH_COMB *comb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,226 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+
+/* Note !
+   Digest many independent messages in one call.
+   On x86_64 SHA-224/SHA-256 use OpenSSL's multi-buffer code (the one
+   behind the AES-CBC-HMAC-SHA256 TLS multi-block cipher). That hashes
+   one message per SIMD lane, 4 lanes SSE/AVX, 8 lanes AVX2 and
+   two at a time interleaved with the SHA extensions, selected from
+   OPENSSL_ia32cap_P at run time. Lanes may have different lengths,
+   a lane that runs out of blocks is masked off. But the assembler stops
+   at the first group of lanes (4, or 2 with the SHA extensions) with
+   nothing left, so lanes are kept longest first and the ones still
+   running are always at the front.
+   Padding is done here, the assembler only does whole blocks.
+
+   Everything else (SHA-512, the other platforms) loops over one
+   reused EVP_MD_CTX, which still saves the per message ICC call and
+   context allocation.
+*/
+#include <string.h>
+
+#include "openssl/evp.h"
+#include "openssl/crypto.h"
+#include "digest_mb.h"
+
+#if defined(__x86_64) || defined(__x86_64__) || defined(_M_AMD64) || defined(_M_X64)
+#define DIGEST_MB_ASM
+#endif
+
+#if defined(DIGEST_MB_ASM)
+
+#define MB_LANES 8     /*!< Messages per assembler call */
+#define MB_CHUNK 1024  /*!< Most blocks per lane per call */
+
+/*! @brief Transposed SHA-256 state, h[word][lane], as sha256-mb-x86_64.pl */
+typedef struct {
+  unsigned int h[8][MB_LANES];
+} SHA256_MB_CTX;
+
+/*! @brief Lane input, lanes with blocks <= 0 are skipped */
+typedef struct {
+  const unsigned char *ptr;
+  int blocks;
+} HASH_DESC;
+
+/* From sha256-mb-x86_64, num 1 for lanes 0-3, 2 for all 8 */
+void sha256_multi_block(SHA256_MB_CTX *ctx, const HASH_DESC *inp, int num);
+
+static const unsigned int sha256_iv[8] = {
+  0x6a09e667U, 0xbb67ae85U, 0x3c6ef372U, 0xa54ff53aU,
+  0x510e527fU, 0x9b05688cU, 0x1f83d9abU, 0x5be0cd19U
+};
+
+static const unsigned int sha224_iv[8] = {
+  0xc1059ed8U, 0x367cd507U, 0x3070dd17U, 0xf70e5939U,
+  0xffc00b31U, 0x68581511U, 0x64f98fa7U, 0xbefa4fa4U
+};
+
+/*! @brief Hash up to MB_LANES messages together
+    @param lane the messages, already checked
+    @param k the number of messages, 1 to MB_LANES
+    @param iv the initial state
+    @param words the digest length in 32 bit words, 7 or 8
+*/
+static void mb_sha256(DIGEST_REC **lane, int k, const unsigned int *iv, int words)
+{
+  unsigned char storage[sizeof(SHA256_MB_CTX) + 32];
+  unsigned char tail[MB_LANES][128];
+  SHA256_MB_CTX *ctx = NULL;
+  HASH_DESC d[MB_LANES];
+  const unsigned char *p[MB_LANES];
+  size_t left[MB_LANES];
+  size_t b = 0;
+  size_t r = 0;
+  unsigned int hi, lo;
+  DIGEST_REC *t = NULL;
+  int num = (k > 4) ? 2 : 1;
+  int more = 0;
+  int i, j;
+
+  /* Longest first, see the note at the top */
+  for (i = 1; i < k; i++) {
+    t = lane[i];
+    for (j = i; (j > 0) && ((lane[j - 1]->inlen / 64) < (t->inlen / 64)); j--) {
+      lane[j] = lane[j - 1];
+    }
+    lane[j] = t;
+  }
+  /* align */
+  ctx = (SHA256_MB_CTX *)(storage + 32 - ((size_t)storage % 32));
+  memset(d, 0, sizeof(d));
+  for (i = 0; i < MB_LANES; i++) {
+    for (j = 0; j < 8; j++) {
+      ctx->h[j][i] = iv[j];
+    }
+    p[i] = (i < k) ? lane[i]->in : NULL;
+    left[i] = (i < k) ? (lane[i]->inlen / 64) : 0;
+  }
+  /* Whole blocks, in steps that keep blocks inside an int */
+  do {
+    more = 0;
+    for (i = 0; i < MB_LANES; i++) {
+      b = (left[i] > MB_CHUNK) ? MB_CHUNK : left[i];
+      d[i].ptr = p[i];
+      d[i].blocks = (int)b;
+      p[i] += 64 * b;
+      left[i] -= b;
+      more |= (b > 0);
+    }
+    if (more) {
+      sha256_multi_block(ctx, d, num);
+    }
+  } while (more);
+  /* The last partial block, the 0x80 pad and the length in bits */
+  for (i = 0; i < k; i++) {
+    r = lane[i]->inlen % 64;
+    memset(tail[i], 0, sizeof(tail[i]));
+    if (r > 0) {
+      memcpy(tail[i], p[i], r);
+    }
+    tail[i][r] = 0x80;
+    b = (r < 56) ? 64 : 128;
+    hi = (unsigned int)((lane[i]->inlen >> 29) & 0xffffffffU);
+    lo = (unsigned int)((lane[i]->inlen << 3) & 0xffffffffU);
+    for (j = 0; j < 4; j++) {
+      tail[i][b - 8 + j] = (unsigned char)(hi >> (24 - 8 * j));
+      tail[i][b - 4 + j] = (unsigned char)(lo >> (24 - 8 * j));
+    }
+    d[i].ptr = tail[i];
+    d[i].blocks = (int)(b / 64);
+  }
+  sha256_multi_block(ctx, d, num);
+  for (i = 0; i < k; i++) {
+    for (j = 0; j < words; j++) {
+      lane[i]->out[4 * j] = (unsigned char)(ctx->h[j][i] >> 24);
+      lane[i]->out[4 * j + 1] = (unsigned char)(ctx->h[j][i] >> 16);
+      lane[i]->out[4 * j + 2] = (unsigned char)(ctx->h[j][i] >> 8);
+      lane[i]->out[4 * j + 3] = (unsigned char)(ctx->h[j][i]);
+    }
+    lane[i]->rv = 1;
+  }
+  OPENSSL_cleanse(tail, sizeof(tail));
+  OPENSSL_cleanse(storage, sizeof(storage));
+}
+#endif
+
+/*! @brief Digest an array of independent messages
+    @param md the digest
+    @param recs the messages
+    @param n the number of messages
+    @return 1 if every message was hashed, 0 otherwise, check recs[i].rv
+*/
+int DIGEST_Multi(const EVP_MD *md, DIGEST_REC *recs, unsigned int n)
+{
+  int rv = 1;
+  unsigned int i = 0;
+  unsigned int s = 0;
+  EVP_MD_CTX *mctx = NULL;
+  DIGEST_REC *rec = NULL;
+#if defined(DIGEST_MB_ASM)
+  DIGEST_REC *lane[MB_LANES];
+  const unsigned int *iv = NULL;
+  int words = 0;
+  int k = 0;
+#endif
+
+  if ((NULL == md) || (NULL == recs)) {
+    return 0;
+  }
+  for (i = 0; i < n; i++) {
+    recs[i].rv = 0;
+  }
+#if defined(DIGEST_MB_ASM)
+  if (EVP_sha256() == md) {
+    iv = sha256_iv;
+    words = 8;
+  } else if (EVP_sha224() == md) {
+    iv = sha224_iv;
+    words = 7;
+  }
+  if (NULL != iv) {
+    for (i = 0; i < n; i++) {
+      rec = &recs[i];
+      if ((NULL == rec->out) || ((NULL == rec->in) && (rec->inlen > 0))) {
+        continue;
+      }
+      lane[k++] = rec;
+      if (MB_LANES == k) {
+        mb_sha256(lane, k, iv, words);
+        k = 0;
+      }
+    }
+    if (k > 0) {
+      mb_sha256(lane, k, iv, words);
+    }
+  } else
+#endif
+  {
+    mctx = EVP_MD_CTX_new();
+    for (i = 0; (NULL != mctx) && (i < n); i++) {
+      rec = &recs[i];
+      if ((NULL == rec->out) || ((NULL == rec->in) && (rec->inlen > 0))) {
+        continue;
+      }
+      if ((1 == EVP_DigestInit_ex(mctx, md, NULL)) &&
+          (1 == EVP_DigestUpdate(mctx, rec->in, rec->inlen)) &&
+          (1 == EVP_DigestFinal_ex(mctx, rec->out, &s))) {
+        rec->rv = 1;
+      }
+    }
+    EVP_MD_CTX_free(mctx);
+  }
+  for (i = 0; i < n; i++) {
+    if (1 != recs[i].rv) {
+      rv = 0;
+    }
+  }
+  return rv;
+}
@@ -0,0 +1,34 @@
+/* crypto/sha/digest_mb.h */
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+#ifndef HEADER_DIGEST_MB_H
+#define HEADER_DIGEST_MB_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! @brief One message for DIGEST_Multi()
+    @note Must match the layout of ICC_DIGEST_REC in icc.h
+*/
+typedef struct DIGEST_REC_t {
+  const unsigned char *in;     /*!< The message */
+  size_t inlen;                /*!< The length of the message, may differ per entry */
+  unsigned char *out;          /*!< The digest, EVP_MD_size() bytes */
+  int rv;                      /*!< Returned, 1 if hashed */
+} DIGEST_REC;
+
+int DIGEST_Multi(const EVP_MD *md,DIGEST_REC *recs,unsigned int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,228 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+
+/* Note !
+   Precomputed ECDSA nonces for one signing key.
+   ECDSA_sign_setup() does the expensive part of a signature, picking k
+   from the DRBG, the scalar multiply k.G and the inversion of k, none
+   of which depend on the message. ECDSA_POOL_Fill() does that ahead of 
+   time (idle time, or a thread of the caller's) and ECDSA_POOL_Sign() 
+   only has the modular arithmetic left.
+   
+   Zeroization: every (k^-1, r) pair is used for exactly one signature 
+   and cleared as it's taken. ECDSA_POOL_Flush() and ECDSA_POOL_free()
+   clear any not used. Pairs made before a fork() are never used in the
+   child, both processes would sign with the same k and reveal the key.
+   A pool created with depth 0 never holds nonces, i.e. is disabled.
+*/
+#include <string.h>
+
+#include "openssl/ec.h"
+#include "openssl/ecdsa.h"
+#include "openssl/crypto.h"
+#include "icclib.h"
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+/*! @brief One precomputed nonce */
+typedef struct {
+  BIGNUM *kinv;   /*!< k^-1 mod order */
+  BIGNUM *r;      /*!< x coordinate of k.G mod order */
+} ECDSA_NONCE;
+
+/*! @brief ECDSA nonce pool */
+struct ECDSA_POOL_t {
+  EC_KEY *key;            /*!< The signing key, reference held */
+  CRYPTO_RWLOCK *lock;    /*!< Protects n and nonces */
+  unsigned int depth;     /*!< Most held */
+  unsigned int n;         /*!< Currently held */
+  long pid;               /*!< The process the nonces were made in */
+  ECDSA_NONCE *nonces;    /*!< depth entries */
+};
+
+/*! @brief The current process, no fork() on Windows */
+static long pool_pid(void)
+{
+#if defined(_WIN32)
+  return 0;
+#else
+  return (long)getpid();
+#endif
+}
+
+/*! @brief Clear the held nonces
+    @param pool the pool, locked by the caller
+*/
+static void pool_clear(ECDSA_POOL *pool)
+{
+  while (pool->n > 0) {
+    pool->n--;
+    BN_clear_free(pool->nonces[pool->n].kinv);
+    BN_clear_free(pool->nonces[pool->n].r);
+    pool->nonces[pool->n].kinv = NULL;
+    pool->nonces[pool->n].r = NULL;
+  }
+}
+
+/*! @brief Create a nonce pool for a signing key
+    @param key an EC key with a private key, a reference is taken
+    @param depth the most nonces held, 0 disables precomputation
+    @return the pool or NULL
+    @note The key must not be changed while the pool exists, 
+    ECDSA_POOL_Flush() first if it is
+*/
+ECDSA_POOL *ECDSA_POOL_new(EC_KEY *key, unsigned int depth)
+{
+  ECDSA_POOL *pool = NULL;
+
+  if ((NULL != key) && (depth <= ECDSA_POOL_MAX)) {
+    pool = OPENSSL_zalloc(sizeof(ECDSA_POOL));
+    if (NULL != pool) {
+      pool->lock = CRYPTO_THREAD_lock_new();
+      if (depth > 0) {
+        pool->nonces = OPENSSL_zalloc(depth * sizeof(ECDSA_NONCE));
+      }
+      if ((NULL == pool->lock) || ((depth > 0) && (NULL == pool->nonces)) ||
+          (1 != EC_KEY_up_ref(key))) {
+        CRYPTO_THREAD_lock_free(pool->lock);
+        OPENSSL_free(pool->nonces);
+        OPENSSL_free(pool);
+        pool = NULL;
+      } else {
+        pool->key = key;
+        pool->depth = depth;
+        pool->pid = pool_pid();
+      }
+    }
+  }
+  return pool;
+}
+
+/*! @brief Free a nonce pool, clearing any unused nonces
+    @param pool the pool, may be NULL
+*/
+void ECDSA_POOL_free(ECDSA_POOL *pool)
+{
+  if (NULL != pool) {
+    pool_clear(pool);
+    OPENSSL_free(pool->nonces);
+    CRYPTO_THREAD_lock_free(pool->lock);
+    EC_KEY_free(pool->key);
+    OPENSSL_free(pool);
+  }
+}
+
+/*! @brief Precompute nonces
+    @param pool the pool
+    @param n the most to add in this call
+    @return the number held now, -1 on error
+    @note The work is done outside the lock, signing isn't held up
+*/
+int ECDSA_POOL_Fill(ECDSA_POOL *pool, unsigned int n)
+{
+  int rv = -1;
+  unsigned int i = 0;
+  BIGNUM *kinv = NULL;
+  BIGNUM *r = NULL;
+
+  if (NULL != pool) {
+    rv = (int)pool->n;
+    for (i = 0; (i < n) && ((unsigned int)rv < pool->depth); i++) {
+      if (1 != ECDSA_sign_setup(pool->key, NULL, &kinv, &r)) {
+        rv = -1;
+        break;
+      }
+      CRYPTO_THREAD_write_lock(pool->lock);
+      if (pool->pid != pool_pid()) {
+        pool_clear(pool);
+        pool->pid = pool_pid();
+      }
+      if (pool->n < pool->depth) {
+        pool->nonces[pool->n].kinv = kinv;
+        pool->nonces[pool->n].r = r;
+        pool->n++;
+        kinv = r = NULL;
+      }
+      rv = (int)pool->n;
+      CRYPTO_THREAD_unlock(pool->lock);
+      BN_clear_free(kinv);
+      BN_clear_free(r);
+      kinv = r = NULL;
+    }
+  }
+  return rv;
+}
+
+/*! @brief Clear all the held nonces
+    @param pool the pool
+    @return 1 if O.K., 0 otherwise
+*/
+int ECDSA_POOL_Flush(ECDSA_POOL *pool)
+{
+  int rv = 0;
+
+  if (NULL != pool) {
+    CRYPTO_THREAD_write_lock(pool->lock);
+    pool_clear(pool);
+    CRYPTO_THREAD_unlock(pool->lock);
+    rv = 1;
+  }
+  return rv;
+}
+
+/*! @brief Sign a digest, using a precomputed nonce when there's one
+    @param pool the pool
+    @param dgst the digest
+    @param dlen the length of the digest
+    @return the signature or NULL
+    @note An empty pool signs as ECDSA_do_sign()
+*/
+ECDSA_SIG *ECDSA_POOL_Sign(ECDSA_POOL *pool, const unsigned char *dgst, int dlen)
+{
+  ECDSA_SIG *sig = NULL;
+  BIGNUM *kinv = NULL;
+  BIGNUM *r = NULL;
+
+  if ((NULL != pool) && (NULL != dgst)) {
+    CRYPTO_THREAD_write_lock(pool->lock);
+    if (pool->pid != pool_pid()) {
+      /* fork()ed, the parent has these too */
+      pool_clear(pool);
+      pool->pid = pool_pid();
+    }
+    if (pool->n > 0) {
+      pool->n--;
+      kinv = pool->nonces[pool->n].kinv;
+      r = pool->nonces[pool->n].r;
+      pool->nonces[pool->n].kinv = NULL;
+      pool->nonces[pool->n].r = NULL;
+    }
+    CRYPTO_THREAD_unlock(pool->lock);
+    if (NULL != kinv) {
+      sig = ECDSA_do_sign_ex(dgst, dlen, kinv, r, pool->key);
+      BN_clear_free(kinv);
+      BN_clear_free(r);
+    }
+    /* Empty, or s came out 0 and needs a new k */
+    if (NULL == sig) {
+      sig = ECDSA_do_sign(dgst, dlen, pool->key);
+    }
+  }
+  return sig;
+}
+
+/*! @brief The key a pool signs with
+    @param pool the pool
+    @return the key or NULL
+*/
+const EC_KEY *ECDSA_POOL_get0_key(const ECDSA_POOL *pool)
+{
+  return (NULL != pool) ? pool->key : NULL;
+}
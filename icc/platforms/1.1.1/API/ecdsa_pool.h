@@ -0,0 +1,34 @@
+/* crypto/ec/ecdsa_pool.h */
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+#ifndef HEADER_ECDSA_POOL_H
+#define HEADER_ECDSA_POOL_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ECDSA_POOL_MAX 256 /*!< Largest number of precomputed nonces held */
+
+/*! @brief Precomputed ECDSA nonces (k^-1, r) for one EC key */
+typedef struct ECDSA_POOL_t ECDSA_POOL;
+
+ECDSA_POOL *ECDSA_POOL_new(EC_KEY *key,unsigned int depth);
+void ECDSA_POOL_free(ECDSA_POOL *pool);
+int ECDSA_POOL_Fill(ECDSA_POOL *pool,unsigned int n);
+int ECDSA_POOL_Flush(ECDSA_POOL *pool);
+ECDSA_SIG *ECDSA_POOL_Sign(ECDSA_POOL *pool,const unsigned char *dgst,int dlen);
+const EC_KEY *ECDSA_POOL_get0_key(const ECDSA_POOL *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,542 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+
+/* Note !
+   PBKDF2 (SP800-132/RFC 8018) with HMAC-SHA1/SHA2.
+   Almost all the time goes in the iterations, each one is two HMAC
+   blocks of fixed length. OpenSSL runs those through a full HMAC
+   (context copy, Update, Final) every time. Here the inner and outer
+   pad states are computed once and each iteration is exactly two calls
+   of the digest's compression function on a pre-padded block.
+   Other digests go to OpenSSL's PKCS5_PBKDF2_HMAC().
+   The same pad states back HMAC_KEY, a reusable HMAC key handle for
+   signing many short messages under one key.
+*/
+#include <string.h>
+
+#include "openssl/evp.h"
+#include "openssl/sha.h"
+#include "openssl/crypto.h"
+#include "openssl/hmac.h"
+#include "icclib.h"
+
+/*! @brief Working digest state, large enough for any supported digest */
+typedef union {
+  SHA_CTX sha1;
+  SHA256_CTX sha256;
+  SHA512_CTX sha512;
+} PBKDF2_HCTX;
+
+/*! @brief The largest supported digest block */
+#define PBKDF2_MAX_BLOCK SHA512_CBLOCK
+
+/*! @brief The low level digest operations used by PBKDF2_HMAC() */
+typedef struct {
+  int nid;                 /*!< The digest NID */
+  unsigned int hlen;       /*!< Digest length */
+  unsigned int blen;       /*!< Block length */
+  unsigned int slen;       /*!< Size of the chaining state at the start of the context */
+  int (*init)(void *c);
+  int (*update)(void *c,const void *data,size_t len);
+  int (*final)(unsigned char *md,void *c);
+  void (*transform)(void *c,const unsigned char *data);
+  void (*state)(const void *c,unsigned char *md,unsigned int hlen);
+} PBKDF2_MD;
+
+/* Adapters from the typed OpenSSL calls */
+#define PBKDF2_WRAP(N,T) \
+static int N##_init(void *c) { return N##_Init((T *)c); } \
+static int N##_update(void *c,const void *d,size_t l) { return N##_Update((T *)c,d,l); } \
+static int N##_final(unsigned char *md,void *c) { return N##_Final(md,(T *)c); }
+
+PBKDF2_WRAP(SHA1,SHA_CTX)
+PBKDF2_WRAP(SHA224,SHA256_CTX)
+PBKDF2_WRAP(SHA256,SHA256_CTX)
+PBKDF2_WRAP(SHA384,SHA512_CTX)
+PBKDF2_WRAP(SHA512,SHA512_CTX)
+
+static void sha1_transform(void *c,const unsigned char *d)
+{
+  SHA1_Transform((SHA_CTX *)c,d);
+}
+static void sha256_transform(void *c,const unsigned char *d)
+{
+  SHA256_Transform((SHA256_CTX *)c,d);
+}
+static void sha512_transform(void *c,const unsigned char *d)
+{
+  SHA512_Transform((SHA512_CTX *)c,d);
+}
+
+/*! @brief Write the 32 bit chaining words out as the BE digest */
+static void sha32_state(const unsigned int *h,unsigned char *md,unsigned int hlen)
+{
+  unsigned int i = 0;
+  for(i = 0; i < hlen/4; i++) {
+    md[4*i]   = (unsigned char)(h[i] >> 24);
+    md[4*i+1] = (unsigned char)(h[i] >> 16);
+    md[4*i+2] = (unsigned char)(h[i] >> 8);
+    md[4*i+3] = (unsigned char)(h[i]);
+  }
+}
+static void sha1_state(const void *c,unsigned char *md,unsigned int hlen)
+{
+  const SHA_CTX *s = (const SHA_CTX *)c;
+  unsigned int h[5];
+
+  h[0] = s->h0;
+  h[1] = s->h1;
+  h[2] = s->h2;
+  h[3] = s->h3;
+  h[4] = s->h4;
+  sha32_state(h,md,hlen);
+}
+static void sha256_state(const void *c,unsigned char *md,unsigned int hlen)
+{
+  sha32_state(((const SHA256_CTX *)c)->h,md,hlen);
+}
+static void sha512_state(const void *c,unsigned char *md,unsigned int hlen)
+{
+  const SHA512_CTX *s = (const SHA512_CTX *)c;
+  unsigned int i = 0;
+  int j = 0;
+  for(i = 0; i < hlen/8; i++) {
+    for(j = 0; j < 8; j++) {
+      md[8*i+j] = (unsigned char)(s->h[i] >> (56 - 8*j));
+    }
+  }
+}
+
+static const PBKDF2_MD PBKDF2_MDS[] = {
+  {NID_sha1,SHA_DIGEST_LENGTH,SHA_CBLOCK,5*sizeof(SHA_LONG),
+   SHA1_init,SHA1_update,SHA1_final,sha1_transform,sha1_state},
+  {NID_sha224,SHA224_DIGEST_LENGTH,SHA256_CBLOCK,8*sizeof(SHA_LONG),
+   SHA224_init,SHA224_update,SHA224_final,sha256_transform,sha256_state},
+  {NID_sha256,SHA256_DIGEST_LENGTH,SHA256_CBLOCK,8*sizeof(SHA_LONG),
+   SHA256_init,SHA256_update,SHA256_final,sha256_transform,sha256_state},
+  {NID_sha384,SHA384_DIGEST_LENGTH,SHA512_CBLOCK,8*sizeof(SHA_LONG64),
+   SHA384_init,SHA384_update,SHA384_final,sha512_transform,sha512_state},
+  {NID_sha512,SHA512_DIGEST_LENGTH,SHA512_CBLOCK,8*sizeof(SHA_LONG64),
+   SHA512_init,SHA512_update,SHA512_final,sha512_transform,sha512_state},
+  {0,0,0,0,NULL,NULL,NULL,NULL,NULL}
+};
+
+/*! @brief Find the low level operations for a digest
+    @param digest the digest
+    @return the operations or NULL if this digest isn't handled here
+*/
+static const PBKDF2_MD *pbkdf2_md(const EVP_MD *digest)
+{
+  int i = 0;
+  int nid = EVP_MD_type(digest);
+  for(i = 0; 0 != PBKDF2_MDS[i].nid; i++) {
+    if(nid == PBKDF2_MDS[i].nid) {
+      return &PBKDF2_MDS[i];
+    }
+  }
+  return NULL;
+}
+
+/*! @brief Compute the HMAC inner and outer pad states for a key
+    @param m the digest operations
+    @param pass the HMAC key (passphrase)
+    @param passlen the length of the key
+    @param ictx the digest state after key^ipad
+    @param octx the digest state after key^opad
+*/
+static void pbkdf2_pads(const PBKDF2_MD *m,const char *pass,int passlen,
+                        PBKDF2_HCTX *ictx,PBKDF2_HCTX *octx)
+{
+  unsigned char k[PBKDF2_MAX_BLOCK];
+  unsigned int i = 0;
+
+  memset(k,0,sizeof(k));
+  if((unsigned int)passlen > m->blen) {
+    m->init(ictx);
+    m->update(ictx,pass,passlen);
+    m->final(k,ictx);
+  } else if(passlen > 0) {
+    memcpy(k,pass,passlen);
+  }
+  for(i = 0; i < m->blen; i++) {
+    k[i] ^= 0x36;
+  }
+  m->init(ictx);
+  m->update(ictx,k,m->blen);
+  for(i = 0; i < m->blen; i++) {
+    k[i] ^= 0x36 ^ 0x5c;
+  }
+  m->init(octx);
+  m->update(octx,k,m->blen);
+  OPENSSL_cleanse(k,sizeof(k));
+}
+
+/*! @brief Compute one PBKDF2 output block 
+    T_j = U_1 ^ U_2 ^ ... ^ U_iters
+    @param m the digest operations
+    @param ictx the inner pad state
+    @param octx the outer pad state
+    @param salt the salt
+    @param saltlen the length of the salt
+    @param iters the iteration count
+    @param j the block index, from 1
+    @param T the output block, hlen bytes
+*/
+static void pbkdf2_block(const PBKDF2_MD *m,
+                         const PBKDF2_HCTX *ictx,const PBKDF2_HCTX *octx,
+                         const unsigned char *salt,int saltlen,
+                         int iters,unsigned int j,unsigned char *T)
+{
+  PBKDF2_HCTX c;
+  unsigned char blk[PBKDF2_MAX_BLOCK];
+  unsigned char J[4];
+  unsigned long bits = 0;
+  unsigned int i = 0;
+  int k = 0;
+
+  /* U_1 = PRF(P, S || INT(j)) */
+  J[0] = (unsigned char)(j >> 24);
+  J[1] = (unsigned char)(j >> 16);
+  J[2] = (unsigned char)(j >> 8);
+  J[3] = (unsigned char)j;
+  memcpy(&c,ictx,sizeof(c));
+  m->update(&c,salt,saltlen);
+  m->update(&c,J,4);
+  m->final(blk,&c);
+  memcpy(&c,octx,sizeof(c));
+  m->update(&c,blk,m->hlen);
+  m->final(blk,&c);
+  memcpy(T,blk,m->hlen);
+
+  /* From here every HMAC input is hlen bytes after the one pad block,
+     so pad it once, as the final block of a blen+hlen byte message.
+     Then each half of an HMAC is one compression from the pad state 
+     and the digest out of one half is the message for the next.
+  */
+  memset(blk + m->hlen,0,m->blen - m->hlen);
+  blk[m->hlen] = 0x80;
+  bits = (m->blen + m->hlen) * 8;
+  blk[m->blen - 2] = (unsigned char)(bits >> 8);
+  blk[m->blen - 1] = (unsigned char)bits;
+  for(k = 1; k < iters; k++) {
+    memcpy(&c,ictx,m->slen);
+    m->transform(&c,blk);
+    m->state(&c,blk,m->hlen);
+    memcpy(&c,octx,m->slen);
+    m->transform(&c,blk);
+    m->state(&c,blk,m->hlen);
+    for(i = 0; i < m->hlen; i++) {
+      T[i] ^= blk[i];
+    }
+  }
+  OPENSSL_cleanse(&c,sizeof(c));
+  OPENSSL_cleanse(blk,sizeof(blk));
+}
+
+/*! @brief Is this a call the engine handles, rather than PKCS5_PBKDF2_HMAC()
+    @return the digest operations or NULL
+*/
+static const PBKDF2_MD *pbkdf2_check(const char *pass, int passlen,
+                                     const unsigned char *salt, int saltlen,
+                                     int iters, const EVP_MD *digest,
+                                     int keylen, unsigned char *out)
+{
+  const PBKDF2_MD *m = NULL;
+
+  if(NULL != digest) {
+    m = pbkdf2_md(digest);
+  }
+  if((iters < 1) || (keylen < 1) || (NULL == out) ||
+     (passlen < 0) || (saltlen < 0) ||
+     ((NULL == pass) && (0 != passlen)) ||
+     ((NULL == salt) && (0 != saltlen))) {
+    m = NULL;
+  }
+  return m;
+}
+
+/*! @brief Compute output blocks first, first+step, ... of a PBKDF2 key
+    @param m the digest operations
+    @param first the first block, from 1
+    @param step the block stride, 1 for all blocks
+    @note out is the whole key, only the selected blocks are written
+*/
+static void pbkdf2_blocks(const PBKDF2_MD *m,const char *pass, int passlen,
+                          const unsigned char *salt, int saltlen, int iters,
+                          int keylen, unsigned char *out,
+                          unsigned int first,unsigned int step)
+{
+  PBKDF2_HCTX ictx;
+  PBKDF2_HCTX octx;
+  unsigned char T[EVP_MAX_MD_SIZE];
+  unsigned int j = first;
+  unsigned long off = (unsigned long)(first - 1) * m->hlen;
+  int len = 0;
+
+  if(off >= (unsigned long)keylen) {
+    return;
+  }
+  pbkdf2_pads(m,pass,passlen,&ictx,&octx);
+  while(off < (unsigned long)keylen) {
+    len = ((unsigned long)keylen - off > m->hlen) ? (int)m->hlen : (int)(keylen - off);
+    pbkdf2_block(m,&ictx,&octx,salt,saltlen,iters,j,T);
+    memcpy(out + off,T,len);
+    j += step;
+    off += (unsigned long)step * m->hlen;
+  }
+  OPENSSL_cleanse(&ictx,sizeof(ictx));
+  OPENSSL_cleanse(&octx,sizeof(octx));
+  OPENSSL_cleanse(T,sizeof(T));
+}
+
+/*! @brief PBKDF2 HMAC
+    @param pass the passphrase
+    @param passlen the length of the passphrase
+    @param salt the salt
+    @param saltlen the length of the salt
+    @param iters the iteration count
+    @param digest the HMAC digest
+    @param keylen the length of the output
+    @param out the output buffer, keylen bytes
+    @return 1 on success, 0 on failure
+    @note Gives the same results as PKCS5_PBKDF2_HMAC() and has the
+    same parameter handling, unusual parameters are passed to it
+*/
+int PBKDF2_HMAC(const char *pass, int passlen,
+                const unsigned char *salt, int saltlen, int iters,
+                const EVP_MD *digest, int keylen, unsigned char *out)
+{
+  int rv = 0;
+  const PBKDF2_MD *m = NULL;
+
+  m = pbkdf2_check(pass,passlen,salt,saltlen,iters,digest,keylen,out);
+  if(NULL == m) {
+    rv = PKCS5_PBKDF2_HMAC(pass,passlen,salt,saltlen,iters,digest,keylen,out);
+  } else {
+    pbkdf2_blocks(m,pass,passlen,salt,saltlen,iters,keylen,out,1,1);
+    rv = 1;
+  }
+  return rv;
+}
+
+/*! @brief Compute a subset of the output blocks of a PBKDF2 HMAC key.
+    The blocks are independent iteration chains so callers can run
+    disjoint subsets on different threads.
+    @param pass the passphrase
+    @param passlen the length of the passphrase
+    @param salt the salt
+    @param saltlen the length of the salt
+    @param iters the iteration count
+    @param digest the HMAC digest
+    @param keylen the length of the whole key
+    @param out the whole key buffer, keylen bytes
+    @param first the first block to compute, from 1
+    @param step the block stride
+    @return 1 on success, 0 if the parameters or digest aren't handled here,
+    use PBKDF2_HMAC() for those
+    @note A first block past the end of the key computes nothing, 
+    so only checks the parameters
+*/
+int PBKDF2_HMAC_Blocks(const char *pass, int passlen,
+                       const unsigned char *salt, int saltlen, int iters,
+                       const EVP_MD *digest, int keylen, unsigned char *out,
+                       unsigned int first, unsigned int step)
+{
+  int rv = 0;
+  const PBKDF2_MD *m = NULL;
+
+  m = pbkdf2_check(pass,passlen,salt,saltlen,iters,digest,keylen,out);
+  if((NULL != m) && (first > 0) && (step > 0)) {
+    pbkdf2_blocks(m,pass,passlen,salt,saltlen,iters,keylen,out,first,step);
+    rv = 1;
+  }
+  return rv;
+}
+
+/*! @brief PBKDF2 HMAC for an array of independent passphrases
+    i.e. checking a set of stored password hashes
+    @param digest the HMAC digest
+    @param recs the entries
+    @param n the number of entries
+    @return 1 if all entries were derived (and matched), 0 otherwise
+    @note Entries are independent, check recs[i].rv
+*/
+int PBKDF2_HMAC_Batch(const EVP_MD *digest,PBKDF2_REC *recs,unsigned int n)
+{
+  int rv = 1;
+  unsigned int i = 0;
+  PBKDF2_REC *r = NULL;
+
+  if((NULL == recs) || (NULL == digest)) {
+    rv = 0;
+    n = 0;
+  }
+  for(i = 0; i < n; i++) {
+    r = &recs[i];
+    r->rv = 0;
+    if((NULL != r->out) && (r->keylen > 0)) {
+      r->rv = PBKDF2_HMAC(r->pass,r->passlen,r->salt,r->saltlen,r->iters,
+                          digest,r->keylen,r->out);
+    }
+    if((1 == r->rv) && (NULL != r->expect) &&
+       (0 != CRYPTO_memcmp(r->out,r->expect,r->keylen))) {
+      r->rv = 0;
+    }
+    if(1 != r->rv) {
+      rv = 0;
+    }
+  }
+  return rv;
+}
+
+/*! @brief A reusable HMAC key, the pads are computed once
+    @note Read only after HMAC_KEY_Init(), so one key may be used
+    from many threads
+*/
+struct HMAC_KEY_t {
+  const EVP_MD *md;       /*!< The digest */
+  const PBKDF2_MD *m;     /*!< Low level operations, NULL for other digests */
+  PBKDF2_HCTX ictx;       /*!< State after key^ipad */
+  PBKDF2_HCTX octx;       /*!< State after key^opad */
+  HMAC_CTX *hmac;         /*!< Keyed template for digests without m */
+  int keyed;              /*!< 1 once a key has been set */
+};
+
+/*! @brief Allocate an HMAC key handle
+    @return the handle or NULL
+*/
+HMAC_KEY *HMAC_KEY_new(void)
+{
+  return (HMAC_KEY *)OPENSSL_zalloc(sizeof(struct HMAC_KEY_t));
+}
+
+/*! @brief Free an HMAC key handle, the key state is cleared
+    @param hk the handle, may be NULL
+*/
+void HMAC_KEY_free(HMAC_KEY *hk)
+{
+  if(NULL != hk) {
+    if(NULL != hk->hmac) {
+      HMAC_CTX_free(hk->hmac);
+    }
+    OPENSSL_cleanse(hk,sizeof(struct HMAC_KEY_t));
+    OPENSSL_free(hk);
+  }
+}
+
+/*! @brief Set the key and digest for an HMAC key handle
+    @param hk the handle
+    @param digest the digest, any digest HMAC supports
+    @param key the HMAC key
+    @param keylen the length of the key
+    @return 1 on success, 0 on failure
+*/
+int HMAC_KEY_Init(HMAC_KEY *hk,const EVP_MD *digest,
+                  const unsigned char *key,int keylen)
+{
+  int rv = 0;
+
+  if((NULL != hk) && (NULL != digest) && (keylen >= 0) &&
+     ((NULL != key) || (0 == keylen))) {
+    hk->keyed = 0;
+    hk->md = digest;
+    hk->m = pbkdf2_md(digest);
+    if(NULL != hk->m) {
+      pbkdf2_pads(hk->m,(const char *)key,keylen,&hk->ictx,&hk->octx);
+      rv = 1;
+    } else {
+      if(NULL == hk->hmac) {
+        hk->hmac = HMAC_CTX_new();
+      }
+      if(NULL != hk->hmac) {
+        rv = HMAC_Init_ex(hk->hmac,key,keylen,digest,NULL);
+      }
+    }
+    if(1 == rv) {
+      hk->keyed = 1;
+    }
+  }
+  return rv;
+}
+
+/*! @brief One shot HMAC under a key handle
+    @param hk a handle set up with HMAC_KEY_Init()
+    @param msg the message
+    @param msglen the length of the message
+    @param mac the output, EVP_MD_size() of the digest
+    @param maclen if not NULL, the length of the MAC is returned here
+    @return 1 on success, 0 on failure
+*/
+int HMAC_KEY_Sign(const HMAC_KEY *hk,const unsigned char *msg,size_t msglen,
+                  unsigned char *mac,unsigned int *maclen)
+{
+  int rv = 0;
+  PBKDF2_HCTX c;
+  unsigned char ih[EVP_MAX_MD_SIZE];
+  HMAC_CTX *w = NULL;
+
+  if(NULL != maclen) {
+    *maclen = 0;
+  }
+  if((NULL == hk) || !hk->keyed || (NULL == mac) ||
+     ((NULL == msg) && (0 != msglen))) {
+    return 0;
+  }
+  if(NULL != hk->m) {
+    /* Start each half from a copy of it's pad state */
+    memcpy(&c,&hk->ictx,sizeof(c));
+    hk->m->update(&c,msg,msglen);
+    hk->m->final(ih,&c);
+    memcpy(&c,&hk->octx,sizeof(c));
+    hk->m->update(&c,ih,hk->m->hlen);
+    hk->m->final(mac,&c);
+    OPENSSL_cleanse(&c,sizeof(c));
+    OPENSSL_cleanse(ih,sizeof(ih));
+    if(NULL != maclen) {
+      *maclen = hk->m->hlen;
+    }
+    rv = 1;
+  } else {
+    /* Clone the keyed template, the handle itself isn't touched */
+    w = HMAC_CTX_new();
+    if((NULL != w) && (1 == HMAC_CTX_copy(w,hk->hmac)) &&
+       (1 == HMAC_Update(w,msg,msglen))) {
+      rv = HMAC_Final(w,mac,maclen);
+    }
+    HMAC_CTX_free(w);
+  }
+  return rv;
+}
+
+/*! @brief Verify an HMAC under a key handle
+    @param hk a handle set up with HMAC_KEY_Init()
+    @param msg the message
+    @param msglen the length of the message
+    @param mac the MAC to check
+    @param maclen the length of the MAC, may be truncated but not below 
+    half the digest length or 10 bytes
+    @return 1 if the MAC matched, 0 otherwise
+    @note The comparison is constant time
+*/
+int HMAC_KEY_Verify(const HMAC_KEY *hk,const unsigned char *msg,size_t msglen,
+                    const unsigned char *mac,unsigned int maclen)
+{
+  int rv = 0;
+  unsigned char tmp[EVP_MAX_MD_SIZE];
+  unsigned int tlen = 0;
+
+  if((NULL != mac) && (maclen >= 10) &&
+     (1 == HMAC_KEY_Sign(hk,msg,msglen,tmp,&tlen)) &&
+     (maclen <= tlen) && (2 * maclen >= tlen) &&
+     (0 == CRYPTO_memcmp(tmp,mac,maclen))) {
+    rv = 1;
+  }
+  OPENSSL_cleanse(tmp,sizeof(tmp));
+  return rv;
+}
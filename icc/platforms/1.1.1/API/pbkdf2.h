@@ -0,0 +1,58 @@
+/* crypto/evp/pbkdf2.h */
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+#ifndef HEADER_PBKDF2_H
+#define HEADER_PBKDF2_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! @brief One entry for PBKDF2_HMAC_Batch()
+    @note Must match the layout of ICC_PBKDF2_REC in icc.h
+*/
+typedef struct PBKDF2_REC_t {
+  const char *pass;            /*!< The passphrase */
+  int passlen;                 /*!< The length of the passphrase */
+  const unsigned char *salt;   /*!< The salt */
+  int saltlen;                 /*!< The length of the salt */
+  int iters;                   /*!< The iteration count */
+  int keylen;                  /*!< The derived key length */
+  unsigned char *out;          /*!< The derived key, keylen bytes */
+  const unsigned char *expect; /*!< If not NULL, the key out must match */
+  int rv;                      /*!< Returned, 1 if derived (and matched) */
+} PBKDF2_REC;
+
+int PBKDF2_HMAC(const char *pass, int passlen,
+                const unsigned char *salt, int saltlen, int iters,
+                const EVP_MD *digest, int keylen, unsigned char *out);
+int PBKDF2_HMAC_Blocks(const char *pass, int passlen,
+                       const unsigned char *salt, int saltlen, int iters,
+                       const EVP_MD *digest, int keylen, unsigned char *out,
+                       unsigned int first, unsigned int step);
+int PBKDF2_HMAC_Batch(const EVP_MD *digest,PBKDF2_REC *recs,unsigned int n);
+
+/*! @brief A reusable HMAC key handle, holds the precomputed pad states */
+typedef struct HMAC_KEY_t HMAC_KEY;
+
+HMAC_KEY *HMAC_KEY_new(void);
+void HMAC_KEY_free(HMAC_KEY *hk);
+int HMAC_KEY_Init(HMAC_KEY *hk,const EVP_MD *digest,
+                  const unsigned char *key,int keylen);
+int HMAC_KEY_Sign(const HMAC_KEY *hk,const unsigned char *msg,size_t msglen,
+                  unsigned char *mac,unsigned int *maclen);
+int HMAC_KEY_Verify(const HMAC_KEY *hk,const unsigned char *msg,size_t msglen,
+                    const unsigned char *mac,unsigned int maclen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+
+/* Note !
+   What key a keygen context will produce. OpenSSL 1.1.1 has no getter
+   for the key type of a context created by id, or the curve set with
+   EVP_PKEY_CTX_set_ec_paramgen_curve_nid(), both are needed to hand
+   out a pre-generated ephemeral key in place of running the keygen. 
+*/
+#include "openssl/evp.h"
+#include "openssl/ec.h"
+#include "openssl/err.h"
+#include "crypto/evp.h"
+#include "pkey_gen.h"
+
+/*! @brief The curve a keygen context's EC key parameters are on
+  @param pk the parameters
+  @return the curve NID, NID_undef if it's not a named curve
+*/
+static int pkey_gen_curve(const EVP_PKEY *pk)
+{
+  int nid = NID_undef;
+  const EC_GROUP *grp = NULL;
+
+  if(EVP_PKEY_EC == EVP_PKEY_base_id(pk)) {
+    grp = EC_KEY_get0_group(EVP_PKEY_get0_EC_KEY((EVP_PKEY *)pk));
+    if((NULL != grp) && 
+       (OPENSSL_EC_NAMED_CURVE == EC_GROUP_get_asn1_flag(grp))) {
+      nid = EC_GROUP_get_curve_name(grp);
+    }
+  }
+  return nid;
+}
+
+/*! @brief The key an EVP_PKEY_keygen() on this context would make
+  Only plain contexts qualify, no engine, no keygen callback and 
+  initialized for keygen
+  @param ctx the keygen context
+  @return NID_X25519 or NID_X448, the curve NID for an EC key on a named
+  curve, otherwise NID_undef
+  @note For an EC context created by id the curve is read back by
+  generating the parameters on a copy of the context
+*/
+int EVP_PKEY_CTX_keygen_nid(EVP_PKEY_CTX *ctx)
+{
+  int nid = NID_undef;
+  EVP_PKEY_CTX *dctx = NULL;
+  EVP_PKEY *params = NULL;
+
+  if((NULL == ctx) || (NULL == ctx->pmeth) || (NULL != ctx->engine) ||
+     (NULL != ctx->pkey_gencb) || (EVP_PKEY_OP_KEYGEN != ctx->operation)) {
+    return NID_undef;
+  }
+  switch(ctx->pmeth->pkey_id) {
+  case NID_X25519:
+  case NID_X448:
+    nid = ctx->pmeth->pkey_id;
+    break;
+  case EVP_PKEY_EC:
+    if(NULL != ctx->pkey) {
+      nid = pkey_gen_curve(ctx->pkey);
+    } else {
+      ERR_set_mark();
+      dctx = EVP_PKEY_CTX_dup(ctx);
+      if((NULL != dctx) && (1 == EVP_PKEY_paramgen_init(dctx)) &&
+         (1 == EVP_PKEY_paramgen(dctx, &params))) {
+        nid = pkey_gen_curve(params);
+      }
+      EVP_PKEY_free(params);
+      EVP_PKEY_CTX_free(dctx);
+      ERR_pop_to_mark();
+    }
+    break;
+  default:
+    break;
+  }
+  return nid;
+}
@@ -0,0 +1,24 @@
+/* crypto/evp/pkey_gen.h */
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+#ifndef HEADER_PKEY_GEN_H
+#define HEADER_PKEY_GEN_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int EVP_PKEY_CTX_keygen_nid(EVP_PKEY_CTX *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
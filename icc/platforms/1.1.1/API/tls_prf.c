@@ -0,0 +1,249 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+
+/* Note !
+   The TLS 1.0-1.2 PRF (RFC 2246/5246) on a reusable context.
+   Going through EVP_PKEY_TLS1_PRF every handshake does an EVP_PKEY_CTX
+   setup and rekeys HMAC from the secret for each of the master secret,
+   key block and finished messages. Here the secret is keyed into HMAC
+   once per context and every P_hash step restarts from that state.
+   TLS_PRF_KeyBlock() runs the master secret and key block derivations 
+   in one call and leaves the context keyed with the master secret
+   for the finished messages.
+*/
+#include <string.h>
+#include <limits.h>
+
+#include "openssl/evp.h"
+#include "openssl/hmac.h"
+#include "openssl/crypto.h"
+#include "icclib.h"
+
+/*! @brief TLS PRF context */
+struct TLS_PRF_CTX_t {
+  HMAC_CTX *h[2];   /*!< Keyed P_hash state, the second one only for MD5+SHA1 */
+  int n;            /*!< Number of P_hash functions in use, 1 or 2 */
+  int keyed;        /*!< 1 once a secret has been set */
+};
+
+/*! @brief Allocate a TLS PRF context
+    @return the context or NULL
+*/
+TLS_PRF_CTX *TLS_PRF_CTX_new(void)
+{
+  TLS_PRF_CTX *c = NULL;
+
+  c = (TLS_PRF_CTX *)OPENSSL_zalloc(sizeof(TLS_PRF_CTX));
+  if(NULL != c) {
+    c->h[0] = HMAC_CTX_new();
+    c->h[1] = HMAC_CTX_new();
+    if((NULL == c->h[0]) || (NULL == c->h[1])) {
+      TLS_PRF_CTX_free(c);
+      c = NULL;
+    }
+  }
+  return c;
+}
+
+/*! @brief Free a TLS PRF context, the keyed state is cleared
+    @param ctx the context, may be NULL
+*/
+void TLS_PRF_CTX_free(TLS_PRF_CTX *ctx)
+{
+  if(NULL != ctx) {
+    HMAC_CTX_free(ctx->h[0]);
+    HMAC_CTX_free(ctx->h[1]);
+    OPENSSL_cleanse(ctx,sizeof(TLS_PRF_CTX));
+    OPENSSL_free(ctx);
+  }
+}
+
+/*! @brief Set the PRF digest and secret
+    @param ctx the context
+    @param md the PRF digest, MD5-SHA1 gives the TLS 1.0/1.1 PRF
+    @param secret the secret
+    @param seclen the length of the secret
+    @return 1 on success, 0 on failure
+*/
+int TLS_PRF_Init(TLS_PRF_CTX *ctx,const EVP_MD *md,
+                 const unsigned char *secret,int seclen)
+{
+  int rv = 0;
+  int half = 0;
+
+  if((NULL != ctx) && (NULL != md) && (seclen >= 0) &&
+     ((NULL != secret) || (0 == seclen))) {
+    ctx->keyed = 0;
+    if(NID_md5_sha1 == EVP_MD_type(md)) {
+      /* TLS 1.0/1.1: P_MD5 over the first half ^ P_SHA1 over the second,
+         the halves share the middle byte for an odd length
+      */
+      half = (seclen + 1) / 2;
+      ctx->n = 2;
+      rv = HMAC_Init_ex(ctx->h[0],secret,half,EVP_md5(),NULL);
+      if(1 == rv) {
+        rv = HMAC_Init_ex(ctx->h[1],secret + (seclen - half),half,EVP_sha1(),NULL);
+      }
+    } else {
+      ctx->n = 1;
+      rv = HMAC_Init_ex(ctx->h[0],secret,seclen,md,NULL);
+    }
+    if(1 == rv) {
+      ctx->keyed = 1;
+    }
+  }
+  return rv;
+}
+
+/*! @brief P_hash(secret, label || seed1 || seed2), xor'd into out
+    @return 1 on success, 0 on failure
+*/
+static int p_hash(HMAC_CTX *h,const unsigned char *label,int labellen,
+                  const unsigned char *seed1,int seed1len,
+                  const unsigned char *seed2,int seed2len,
+                  unsigned char *out,int outlen)
+{
+  unsigned char A[EVP_MAX_MD_SIZE];
+  unsigned char T[EVP_MAX_MD_SIZE];
+  unsigned int alen = 0;
+  unsigned int tlen = 0;
+  int rv = 1;
+  int i = 0;
+  int first = 1;
+
+  while((1 == rv) && (outlen > 0)) {
+    /* A(i) = HMAC(secret, A(i-1)), A(0) = the seed. 
+       A NULL key restarts from the keyed state */
+    rv = HMAC_Init_ex(h,NULL,0,NULL,NULL);
+    if(first) {
+      rv &= HMAC_Update(h,label,labellen);
+      rv &= HMAC_Update(h,seed1,seed1len);
+      rv &= HMAC_Update(h,seed2,seed2len);
+      first = 0;
+    } else {
+      rv &= HMAC_Update(h,A,alen);
+    }
+    rv &= HMAC_Final(h,A,&alen);
+    /* HMAC(secret, A(i) || seed) */
+    rv &= HMAC_Init_ex(h,NULL,0,NULL,NULL);
+    rv &= HMAC_Update(h,A,alen);
+    rv &= HMAC_Update(h,label,labellen);
+    rv &= HMAC_Update(h,seed1,seed1len);
+    rv &= HMAC_Update(h,seed2,seed2len);
+    rv &= HMAC_Final(h,T,&tlen);
+    for(i = 0; (i < (int)tlen) && (outlen > 0); i++,outlen--) {
+      *out++ ^= T[i];
+    }
+  }
+  OPENSSL_cleanse(A,sizeof(A));
+  OPENSSL_cleanse(T,sizeof(T));
+  return rv;
+}
+
+/*! @brief Derive PRF(secret, label, seed1 || seed2) from a keyed context
+    @param ctx a context set up with TLS_PRF_Init() or TLS_PRF_KeyBlock()
+    @param label the label, i.e. "client finished"
+    @param labellen the length of the label
+    @param seed1 the first part of the seed, may be NULL
+    @param seed1len the length of seed1
+    @param seed2 the second part of the seed, may be NULL
+    @param seed2len the length of seed2
+    @param out the output
+    @param outlen the length of the output
+    @return 1 on success, 0 on failure, the output is cleared on failure
+    @note The context holds working state, don't share one between threads
+*/
+int TLS_PRF_Derive(TLS_PRF_CTX *ctx,const unsigned char *label,int labellen,
+                   const unsigned char *seed1,int seed1len,
+                   const unsigned char *seed2,int seed2len,
+                   unsigned char *out,int outlen)
+{
+  int rv = 0;
+  int i = 0;
+
+  if((NULL != ctx) && ctx->keyed && (NULL != out) && (outlen > 0) &&
+     (labellen >= 0) && (seed1len >= 0) && (seed2len >= 0) &&
+     ((NULL != label) || (0 == labellen)) &&
+     ((NULL != seed1) || (0 == seed1len)) &&
+     ((NULL != seed2) || (0 == seed2len))) {
+    memset(out,0,outlen);
+    rv = 1;
+    for(i = 0; (1 == rv) && (i < ctx->n); i++) {
+      rv = p_hash(ctx->h[i],label,labellen,seed1,seed1len,seed2,seed2len,
+                  out,outlen);
+    }
+    if(1 != rv) {
+      OPENSSL_cleanse(out,outlen);
+      rv = 0;
+    }
+  }
+  return rv;
+}
+
+/*! @brief The TLS 1.0-1.2 key schedule in one call
+    master_secret = PRF(pms, "master secret", client_random || server_random)
+    or with a session hash (RFC 7627)
+    master_secret = PRF(pms, "extended master secret", session_hash)
+    key_block = PRF(master_secret, "key expansion", server_random || client_random)
+    @param ctx the context, left keyed with the master secret for the
+           finished messages
+    @param md the PRF digest
+    @param pms the pre-master secret
+    @param pmslen the length of the pre-master secret
+    @param crandom the 32 byte client random
+    @param srandom the 32 byte server random
+    @param shash the session hash for the extended master secret, or NULL
+    @param shashlen the length of the session hash
+    @param master the 48 byte master secret output
+    @param keyblock the key block output
+    @param kblen the length of the key block
+    @return 1 on success, 0 on failure, the outputs are cleared on failure
+*/
+int TLS_PRF_KeyBlock(TLS_PRF_CTX *ctx,const EVP_MD *md,
+                     const unsigned char *pms,int pmslen,
+                     const unsigned char *crandom,const unsigned char *srandom,
+                     const unsigned char *shash,int shashlen,
+                     unsigned char *master,unsigned char *keyblock,int kblen)
+{
+  static const char ms_label[] = "master secret";
+  static const char ems_label[] = "extended master secret";
+  static const char kb_label[] = "key expansion";
+  int rv = 0;
+
+  if((NULL != crandom) && (NULL != srandom) && (NULL != master) &&
+     (NULL != keyblock) && (kblen > 0)) {
+    rv = TLS_PRF_Init(ctx,md,pms,pmslen);
+    if(1 == rv) {
+      if(NULL != shash) {
+        rv = TLS_PRF_Derive(ctx,(const unsigned char *)ems_label,sizeof(ems_label) - 1,
+                            shash,shashlen,NULL,0,master,TLS_PRF_MASTER_LEN);
+      } else {
+        rv = TLS_PRF_Derive(ctx,(const unsigned char *)ms_label,sizeof(ms_label) - 1,
+                            crandom,TLS_PRF_RANDOM_LEN,srandom,TLS_PRF_RANDOM_LEN,
+                            master,TLS_PRF_MASTER_LEN);
+      }
+    }
+    if(1 == rv) {
+      rv = TLS_PRF_Init(ctx,md,master,TLS_PRF_MASTER_LEN);
+    }
+    if(1 == rv) {
+      rv = TLS_PRF_Derive(ctx,(const unsigned char *)kb_label,sizeof(kb_label) - 1,
+                          srandom,TLS_PRF_RANDOM_LEN,crandom,TLS_PRF_RANDOM_LEN,
+                          keyblock,kblen);
+    }
+    if(1 != rv) {
+      OPENSSL_cleanse(master,TLS_PRF_MASTER_LEN);
+      OPENSSL_cleanse(keyblock,kblen);
+      if(NULL != ctx) {
+        ctx->keyed = 0;
+      }
+    }
+  }
+  return rv;
+}
@@ -0,0 +1,42 @@
+/* crypto/kdf/tls_prf.h */
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+#ifndef HEADER_TLS_PRF_H
+#define HEADER_TLS_PRF_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TLS_PRF_RANDOM_LEN 32 /*!< Client and server random length */
+#define TLS_PRF_MASTER_LEN 48 /*!< Master secret length */
+
+/*! @brief A reusable TLS 1.0-1.2 PRF context, holds the secret as keyed HMAC state */
+typedef struct TLS_PRF_CTX_t TLS_PRF_CTX;
+
+TLS_PRF_CTX *TLS_PRF_CTX_new(void);
+void TLS_PRF_CTX_free(TLS_PRF_CTX *ctx);
+int TLS_PRF_Init(TLS_PRF_CTX *ctx,const EVP_MD *md,
+                 const unsigned char *secret,int seclen);
+int TLS_PRF_Derive(TLS_PRF_CTX *ctx,const unsigned char *label,int labellen,
+                   const unsigned char *seed1,int seed1len,
+                   const unsigned char *seed2,int seed2len,
+                   unsigned char *out,int outlen);
+int TLS_PRF_KeyBlock(TLS_PRF_CTX *ctx,const EVP_MD *md,
+                     const unsigned char *pms,int pmslen,
+                     const unsigned char *crandom,const unsigned char *srandom,
+                     const unsigned char *shash,int shashlen,
+                     unsigned char *master,unsigned char *keyblock,int kblen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
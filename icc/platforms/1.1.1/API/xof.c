@@ -0,0 +1,396 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+
+/* Note !
+   Incremental SHAKE128/SHAKE256. EVP_DigestFinalXOF() pads and squeezes
+   once, a caller wanting more output than it asked for has to start
+   again. Here the sponge is kept after the first squeeze so output can
+   be taken in as many pieces as the caller likes, the concatenation is
+   the same as one squeeze of the total length.
+
+   This drives OpenSSL's Keccak code (keccak1600.c or the keccak1600
+   assembler, the same SHA3_absorb()/SHA3_squeeze() m_sha3.c uses)
+   directly. SHA3_squeeze() emits the current block, permutes, emits the
+   next and so on, it never permutes after the last block. So every
+   squeeze here asks it for one byte more than it needs: that leaves the
+   state permuted onto the next, not yet used, block and the next call
+   carries on from there. Requests of more than a block go straight into
+   the caller's buffer, only the last partial block is buffered.
+
+   cSHAKE (SP800-185) is the same sponge with a different pad and the
+   function name/customization string prefixed as a whole block.
+
+   KMAC is cSHAKE(N="KMAC",S) with the key as a whole block prefix too.
+   KMAC_KEY keeps the state after the key block, each MAC starts from a
+   copy of it, so a MAC costs the message and the final permutation.
+*/
+#include <string.h>
+
+#include "openssl/evp.h"
+#include "openssl/crypto.h"
+#include "xof.h"
+
+/* keccak1600.c or the keccak1600 assembler, as used by m_sha3.c */
+size_t SHA3_absorb(uint64_t A[5][5], const unsigned char *inp, size_t len,
+                   size_t r);
+void SHA3_squeeze(uint64_t A[5][5], unsigned char *out, size_t len, size_t r);
+
+#define XOF_MAX_RATE 168  /*!< SHAKE128, SHAKE256 is 136 */
+#define XOF_PAD 0x1f      /*!< SHAKE domain separation and first pad bit */
+#define CSHAKE_PAD 0x04   /*!< cSHAKE domain separation and first pad bit */
+
+/*! @brief SHAKE sponge state */
+struct XOF_CTX_t {
+  uint64_t A[5][5];     /*!< Keccak state */
+  size_t r;             /*!< Rate, bytes, 0 until initialized */
+  size_t num;           /*!< Absorbing: input held in buf.
+                             Squeezing: output left at the end of buf */
+  int squeezing;        /*!< Padded, no more input */
+  unsigned char pad;    /*!< XOF_PAD or CSHAKE_PAD */
+  unsigned char buf[XOF_MAX_RATE + 8]; /*!< Partial input block, or the current output block,
+                                            + room for the byte of the next one */
+};
+
+/*! @brief Allocate an XOF context
+    @return the context or NULL
+*/
+XOF_CTX *XOF_CTX_new(void)
+{
+  return (XOF_CTX *)OPENSSL_zalloc(sizeof(XOF_CTX));
+}
+
+/*! @brief Free an XOF context, the state is erased
+    @param ctx the context, may be NULL
+*/
+void XOF_CTX_free(XOF_CTX *ctx)
+{
+  if (NULL != ctx) {
+    OPENSSL_clear_free(ctx, sizeof(XOF_CTX));
+  }
+}
+
+/*! @brief Start a new SHAKE computation
+    @param ctx the context
+    @param md SHAKE128 or SHAKE256
+    @return 1 on success, 0 if md isn't an XOF
+*/
+int XOF_CTX_Init(XOF_CTX *ctx, const EVP_MD *md)
+{
+  int rv = 0;
+  size_t r = 0;
+
+  if ((NULL != ctx) && (NULL != md) &&
+      (0 != (EVP_MD_flags(md) & EVP_MD_FLAG_XOF))) {
+    r = (size_t)EVP_MD_block_size(md);
+    if ((r > 0) && (r <= XOF_MAX_RATE) && (0 == (r % 8))) {
+      OPENSSL_cleanse(ctx, sizeof(XOF_CTX));
+      ctx->r = r;
+      ctx->pad = XOF_PAD;
+      rv = 1;
+    }
+  }
+  return rv;
+}
+
+/*! @brief SP800-185 left_encode() of a byte count, as bits
+    @param out 9 bytes at least
+    @param len the byte count
+    @return the number of bytes used
+*/
+static size_t xof_left_encode_bits(unsigned char *out, size_t len)
+{
+  uint64_t bits = (uint64_t)len * 8;
+  size_t n = 1;
+  size_t i = 0;
+
+  while ((n < 8) && (0 != (bits >> (8 * n)))) {
+    n++;
+  }
+  out[0] = (unsigned char)n;
+  for (i = 0; i < n; i++) {
+    out[n - i] = (unsigned char)(bits >> (8 * i));
+  }
+  return n + 1;
+}
+
+/*! @brief Zero fill and absorb the partial input block, for bytepad()
+    @param ctx the context, absorbing
+*/
+static void xof_absorb_pad_block(XOF_CTX *ctx)
+{
+  if (0 != ctx->num) {
+    memset(ctx->buf + ctx->num, 0, ctx->r - ctx->num);
+    SHA3_absorb(ctx->A, ctx->buf, ctx->r, ctx->r);
+    ctx->num = 0;
+  }
+}
+
+/*! @brief Absorb SP800-185 encode_string()
+    @param ctx the context, absorbing
+    @param s the string, may be NULL if len is 0
+    @param len the length of s
+*/
+static void xof_absorb_string(XOF_CTX *ctx, const unsigned char *s, size_t len)
+{
+  unsigned char enc[9];
+  size_t n = 0;
+
+  n = xof_left_encode_bits(enc, len);
+  XOF_CTX_Absorb(ctx, enc, n);
+  XOF_CTX_Absorb(ctx, s, len);
+}
+
+/*! @brief Start a new cSHAKE computation (SP800-185)
+    @param ctx the context
+    @param md SHAKE128 or SHAKE256, cSHAKE128 or cSHAKE256 is used
+    @param N function name, may be NULL if Nlen is 0
+    @param Nlen length of N
+    @param S customization string, may be NULL if Slen is 0
+    @param Slen length of S
+    @return 1 on success, 0 if md isn't an XOF
+    @note With N and S both empty this is plain SHAKE, as the standard requires
+*/
+int XOF_CTX_InitCustom(XOF_CTX *ctx, const EVP_MD *md,
+                       const unsigned char *N, size_t Nlen,
+                       const unsigned char *S, size_t Slen)
+{
+  unsigned char enc[2];
+
+  if (((NULL == N) && (0 != Nlen)) || ((NULL == S) && (0 != Slen)) ||
+      (1 != XOF_CTX_Init(ctx, md))) {
+    return 0;
+  }
+  if ((0 != Nlen) || (0 != Slen)) {
+    ctx->pad = CSHAKE_PAD;
+    /* bytepad(encode_string(N) || encode_string(S), rate) */
+    enc[0] = 1;
+    enc[1] = (unsigned char)ctx->r;
+    XOF_CTX_Absorb(ctx, enc, 2);
+    xof_absorb_string(ctx, N, Nlen);
+    xof_absorb_string(ctx, S, Slen);
+    xof_absorb_pad_block(ctx);
+  }
+  return 1;
+}
+
+/*! @brief Absorb input
+    @param ctx the context
+    @param in the input
+    @param inlen the length of the input
+    @return 1 on success, 0 if not initialized or already squeezing
+*/
+int XOF_CTX_Absorb(XOF_CTX *ctx, const unsigned char *in, size_t inlen)
+{
+  size_t rem = 0;
+
+  if ((NULL == ctx) || (0 == ctx->r) || ctx->squeezing ||
+      ((NULL == in) && (0 != inlen))) {
+    return 0;
+  }
+  if (0 != ctx->num) {
+    rem = ctx->r - ctx->num;
+    if (inlen < rem) {
+      memcpy(ctx->buf + ctx->num, in, inlen);
+      ctx->num += inlen;
+      return 1;
+    }
+    memcpy(ctx->buf + ctx->num, in, rem);
+    SHA3_absorb(ctx->A, ctx->buf, ctx->r, ctx->r);
+    in += rem;
+    inlen -= rem;
+    ctx->num = 0;
+  }
+  if (inlen >= ctx->r) {
+    rem = SHA3_absorb(ctx->A, in, inlen, ctx->r);
+    in += inlen - rem;
+    inlen = rem;
+  }
+  if (0 != inlen) {
+    memcpy(ctx->buf, in, inlen);
+    ctx->num = inlen;
+  }
+  return 1;
+}
+
+/*! @brief Squeeze output, the first call pads the input.
+    Repeated calls continue the output stream
+    @param ctx the context
+    @param out where to put the output
+    @param outlen the number of bytes wanted
+    @return 1 on success, 0 if not initialized
+*/
+int XOF_CTX_Squeeze(XOF_CTX *ctx, unsigned char *out, size_t outlen)
+{
+  size_t r = 0;
+  size_t n = 0;
+
+  if ((NULL == ctx) || (0 == ctx->r) || ((NULL == out) && (0 != outlen))) {
+    return 0;
+  }
+  r = ctx->r;
+  if (!ctx->squeezing) {
+    memset(ctx->buf + ctx->num, 0, r - ctx->num);
+    ctx->buf[ctx->num] = ctx->pad;
+    ctx->buf[r - 1] |= 0x80;
+    SHA3_absorb(ctx->A, ctx->buf, r, r);
+    OPENSSL_cleanse(ctx->buf, sizeof(ctx->buf));
+    ctx->num = 0;
+    ctx->squeezing = 1;
+  }
+  /* What's left of the current block */
+  if (0 != ctx->num) {
+    n = (outlen < ctx->num) ? outlen : ctx->num;
+    memcpy(out, ctx->buf + (r - ctx->num), n);
+    ctx->num -= n;
+    out += n;
+    outlen -= n;
+  }
+  /* Whole blocks, the extra byte is the first output byte after them */
+  if (outlen > r) {
+    n = ((outlen - 1) / r) * r;
+    SHA3_squeeze(ctx->A, out, n + 1, r);
+    out += n;
+    outlen -= n;
+  }
+  /* The last, maybe partial, block */
+  if (0 != outlen) {
+    SHA3_squeeze(ctx->A, ctx->buf, r + 1, r);
+    memcpy(out, ctx->buf, outlen);
+    ctx->num = r - outlen;
+  }
+  return 1;
+}
+
+/*! @brief KMAC key, the sponge after the key block */
+struct KMAC_KEY_t {
+  XOF_CTX keyed; /*!< cSHAKE(N="KMAC",S) || bytepad(encode_string(K)) absorbed */
+};
+
+#define KMAC_MIN_MAC 4 /*!< SP800-185, don't accept fewer than 32 bits */
+
+/*! @brief Allocate a KMAC key
+    @return the key or NULL
+*/
+KMAC_KEY *KMAC_KEY_new(void)
+{
+  return (KMAC_KEY *)OPENSSL_zalloc(sizeof(KMAC_KEY));
+}
+
+/*! @brief Free a KMAC key, the state is erased
+    @param kk the key, may be NULL
+*/
+void KMAC_KEY_free(KMAC_KEY *kk)
+{
+  if (NULL != kk) {
+    OPENSSL_clear_free(kk, sizeof(KMAC_KEY));
+  }
+}
+
+/*! @brief Set the key
+    @param kk the key
+    @param md SHAKE128 for KMAC128, SHAKE256 for KMAC256
+    @param key the key
+    @param keylen the key length
+    @param S customization string, may be NULL if Slen is 0
+    @param Slen length of S
+    @return 1 on success, 0 otherwise
+*/
+int KMAC_KEY_Init(KMAC_KEY *kk, const EVP_MD *md,
+                  const unsigned char *key, size_t keylen,
+                  const unsigned char *S, size_t Slen)
+{
+  unsigned char enc[2];
+
+  if ((NULL == kk) || ((NULL == key) && (0 != keylen)) ||
+      (1 != XOF_CTX_InitCustom(&kk->keyed, md,
+                               (const unsigned char *)"KMAC", 4, S, Slen))) {
+    return 0;
+  }
+  /* bytepad(encode_string(K), rate) */
+  enc[0] = 1;
+  enc[1] = (unsigned char)kk->keyed.r;
+  XOF_CTX_Absorb(&kk->keyed, enc, 2);
+  xof_absorb_string(&kk->keyed, key, keylen);
+  xof_absorb_pad_block(&kk->keyed);
+  return 1;
+}
+
+/*! @brief One shot KMAC of a message, starts from a copy of the key state
+    @param kk the key, set up with KMAC_KEY_Init()
+    @param msg the message
+    @param msglen the length of the message
+    @param mac the output buffer
+    @param maclen the MAC length wanted, bytes, part of the MAC
+    @return 1 on success, 0 otherwise
+    @note The key isn't modified, one key may be used from many threads at once
+*/
+int KMAC_KEY_Sign(const KMAC_KEY *kk, const unsigned char *msg, size_t msglen,
+                  unsigned char *mac, size_t maclen)
+{
+  int rv = 0;
+  XOF_CTX x;
+  unsigned char enc[9];
+  uint64_t bits = 0;
+  size_t n = 1;
+  size_t i = 0;
+
+  if ((NULL == kk) || (0 == kk->keyed.r) || (NULL == mac) || (0 == maclen)) {
+    return 0;
+  }
+  memcpy(&x, &kk->keyed, sizeof(x));
+  if (1 == XOF_CTX_Absorb(&x, msg, msglen)) {
+    /* right_encode(L) */
+    bits = (uint64_t)maclen * 8;
+    while ((n < 8) && (0 != (bits >> (8 * n)))) {
+      n++;
+    }
+    for (i = 0; i < n; i++) {
+      enc[n - 1 - i] = (unsigned char)(bits >> (8 * i));
+    }
+    enc[n] = (unsigned char)n;
+    XOF_CTX_Absorb(&x, enc, n + 1);
+    rv = XOF_CTX_Squeeze(&x, mac, maclen);
+  }
+  OPENSSL_cleanse(&x, sizeof(x));
+  return rv;
+}
+
+/*! @brief Check a KMAC, in constant time
+    @param kk the key, set up with KMAC_KEY_Init()
+    @param msg the message
+    @param msglen the length of the message
+    @param mac the MAC to check
+    @param maclen the length of mac, at least 4 bytes
+    @return 1 if the MAC matched, 0 otherwise
+*/
+int KMAC_KEY_Verify(const KMAC_KEY *kk, const unsigned char *msg, size_t msglen,
+                    const unsigned char *mac, size_t maclen)
+{
+  int rv = 0;
+  unsigned char tmp[256];
+  unsigned char *p = tmp;
+
+  if ((NULL == mac) || (maclen < KMAC_MIN_MAC)) {
+    return 0;
+  }
+  if (maclen > sizeof(tmp)) {
+    p = (unsigned char *)OPENSSL_malloc(maclen);
+  }
+  if ((NULL != p) &&
+      (1 == KMAC_KEY_Sign(kk, msg, msglen, p, maclen)) &&
+      (0 == CRYPTO_memcmp(p, mac, maclen))) {
+    rv = 1;
+  }
+  if (p == tmp) {
+    OPENSSL_cleanse(tmp, sizeof(tmp));
+  } else {
+    OPENSSL_clear_free(p, maclen);
+  }
+  return rv;
+}
@@ -0,0 +1,47 @@
+/* crypto/sha/xof.h */
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+#ifndef HEADER_XOF_H
+#define HEADER_XOF_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! @brief Incremental SHAKE128/SHAKE256, absorb then squeeze repeatedly */
+typedef struct XOF_CTX_t XOF_CTX;
+
+XOF_CTX *XOF_CTX_new(void);
+void XOF_CTX_free(XOF_CTX *ctx);
+int XOF_CTX_Init(XOF_CTX *ctx,const EVP_MD *md);
+int XOF_CTX_InitCustom(XOF_CTX *ctx,const EVP_MD *md,
+                       const unsigned char *N,size_t Nlen,
+                       const unsigned char *S,size_t Slen);
+int XOF_CTX_Absorb(XOF_CTX *ctx,const unsigned char *in,size_t inlen);
+int XOF_CTX_Squeeze(XOF_CTX *ctx,unsigned char *out,size_t outlen);
+
+/*! @brief KMAC128/KMAC256 key, absorbed once, used for many messages */
+typedef struct KMAC_KEY_t KMAC_KEY;
+
+KMAC_KEY *KMAC_KEY_new(void);
+void KMAC_KEY_free(KMAC_KEY *kk);
+int KMAC_KEY_Init(KMAC_KEY *kk,const EVP_MD *md,
+                  const unsigned char *key,size_t keylen,
+                  const unsigned char *S,size_t Slen);
+int KMAC_KEY_Sign(const KMAC_KEY *kk,const unsigned char *msg,size_t msglen,
+                  unsigned char *mac,size_t maclen);
+int KMAC_KEY_Verify(const KMAC_KEY *kk,const unsigned char *msg,size_t msglen,
+                    const unsigned char *mac,size_t maclen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,7 +5,17 @@
 # in the one shared lib this is easier maintenance
 #
 OSSL_XTRA_OBJ = aes_gcm$(OBJSUFX) \
-		aes_ccm$(OBJSUFX)
+		aes_ccm$(OBJSUFX) \
+		aes_xts$(OBJSUFX) \
+		chacha_poly$(OBJSUFX) \
+		pbkdf2$(OBJSUFX) \
+		tls_prf$(OBJSUFX) \
+		ecdsa_pool$(OBJSUFX) \
+		batch$(OBJSUFX) \
+		dh_comb$(OBJSUFX) \
+		digest_mb$(OBJSUFX) \
+		xof$(OBJSUFX) \
+		pkey_gen$(OBJSUFX)
 
 #		icc_cmac$(OBJSUFX)
 
@@ -15,6 +25,36 @@ aes_gcm$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/aes_gcm.c platforms/$(OPENSSL
 aes_ccm$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/aes_ccm.c platforms/$(OPENSSL_LIBVER)/API/aes_ccm.h platforms/$(OPENSSL_LIBVER)/API/aes_gcm.h
 	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/aes_ccm.c $(OUT)$@
 
+aes_xts$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/aes_xts.c platforms/$(OPENSSL_LIBVER)/API/aes_xts.h
+	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/aes_xts.c $(OUT)$@
+
+chacha_poly$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/chacha_poly.c platforms/$(OPENSSL_LIBVER)/API/chacha_poly.h
+	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/chacha_poly.c $(OUT)$@
+
+pbkdf2$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/pbkdf2.c platforms/$(OPENSSL_LIBVER)/API/pbkdf2.h
+	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/pbkdf2.c $(OUT)$@
+
+tls_prf$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/tls_prf.c platforms/$(OPENSSL_LIBVER)/API/tls_prf.h
+	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/tls_prf.c $(OUT)$@
+
+ecdsa_pool$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/ecdsa_pool.c platforms/$(OPENSSL_LIBVER)/API/ecdsa_pool.h
+	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/ecdsa_pool.c $(OUT)$@
+
+batch$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/batch.c platforms/$(OPENSSL_LIBVER)/API/batch.h
+	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/batch.c $(OUT)$@
+
+dh_comb$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/dh_comb.c platforms/$(OPENSSL_LIBVER)/API/dh_comb.h
+	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/dh_comb.c $(OUT)$@
+
+digest_mb$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/digest_mb.c platforms/$(OPENSSL_LIBVER)/API/digest_mb.h
+	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/digest_mb.c $(OUT)$@
+
+xof$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/xof.c platforms/$(OPENSSL_LIBVER)/API/xof.h
+	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/xof.c $(OUT)$@
+
+pkey_gen$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/pkey_gen.c platforms/$(OPENSSL_LIBVER)/API/pkey_gen.h
+	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/pkey_gen.c $(OUT)$@
+
 #aes_gcm.c: platforms/$(OPENSSL_LIBVER)/API/aes_gcm.c
 #	$(CP) platforms/$(OPENSSL_LIBVER)/API/aes_gcm.c $@
 
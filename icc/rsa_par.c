@@ -0,0 +1,386 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*
+  Threaded prime search for single RSA key generation,
+  ICC_RSA_KEYGEN_THREADS.
+
+  Nearly all of an RSA keygen is spent drawing and rejecting prime
+  candidates, and the time a key takes varies a lot with how many
+  candidates it needs. The search for p, then for q, is split across
+  up to rsa_par_threads threads, each drawing it's own candidates, and
+  the first candidate any thread proves (probably) prime is used.
+
+  - The same rules as the FIPS module keygen (fips_rsa_builtin_keygen)
+    are applied to every candidate. pbits random bits, odd, at least
+    0xB504F334 << (pbits - 32), gcd(candidate - 1, e) == 1, passes
+    BN_is_prime_fasttest_ex() with the same round count, and for q
+    |q - p| > 2^(pbits - 100). n, d, the CRT values and the d size
+    retry are computed the same way.
+  - The 5 * pbits candidate limit is shared by all the threads.
+  - Candidates are drawn with BN_rand(), i.e. each thread uses the ICC
+    DRBG instance it's given from the pool.
+  - Once a prime is found the other threads abandon their Miller-Rabin
+    tests through the BN_GENCB callback.
+  - A thread that can't be started isn't replaced, the caller searches
+    in any case.
+  - Only used with no callback, bits >= RSA_PAR_MIN_BITS, the default
+    RSA method and a key that has no preloaded p and q (the NIST test
+    case), everything else goes to RSA_generate_key_ex() as before.
+    The pair-wise test in my_RSA_generate_key_ex() is unchanged.
+*/
+
+#define RSA_PAR_MAX_THREADS 16   /*!< Limit for ICC_RSA_KEYGEN_THREADS */
+#define RSA_PAR_MIN_BITS 2048    /*!< Smaller keys are quick enough */
+
+static int rsa_par_threads = 1; /*!< ICC_RSA_KEYGEN_THREADS, 1 is off */
+
+/*! @brief One prime search, shared by the threads */
+typedef struct {
+  ICC_Mutex mtx;       /*!< Protects tries and found */
+  int pbits;           /*!< Bits in p and q */
+  const BIGNUM *e;     /*!< Public exponent */
+  const BIGNUM *lo;    /*!< Smallest acceptable candidate */
+  const BIGNUM *dmin;  /*!< |q - p| must exceed this */
+  const BIGNUM *p;     /*!< NULL searching for p, p searching for q */
+  BIGNUM *found;       /*!< The prime */
+  int tries;           /*!< Candidates tested, all threads */
+  volatile int done;   /*!< 0 searching, 1 found, -1 failed */
+} RSA_PAR_SEARCH;
+
+/*! @brief A search thread */
+typedef struct {
+  RSA_PAR_SEARCH *s;
+  int started;         /*!< Running on thr */
+  ICC_Thread thr;
+} RSA_PAR_WORKER;
+
+/*! @brief Set the number of threads used to search for RSA primes
+  @param n 1-RSA_PAR_MAX_THREADS, 1 is off
+*/
+static void SetRSAKeygenThreads(int n)
+{
+  if((n >= 1) && (n <= RSA_PAR_MAX_THREADS)) {
+    rsa_par_threads = n;
+  }
+}
+
+/*! @brief Finish the search
+  @param s the search
+  @param rv 1 found, c is the prime, -1 failed
+  @param c the candidate or NULL
+*/
+static void rsa_par_finish(RSA_PAR_SEARCH *s, int rv, const BIGNUM *c)
+{
+  ICC_LockMutex(&s->mtx);
+  if(0 == s->done) {
+    if((1 == rv) && (NULL == BN_copy(s->found,c))) {
+      rv = -1;
+    }
+    s->done = rv;
+  }
+  ICC_UnlockMutex(&s->mtx);
+}
+
+/*! @brief BN_GENCB callback, stop a primality test once another
+  thread has finished the search
+*/
+static int rsa_par_cb(int a, int b, BN_GENCB *cb)
+{
+  RSA_PAR_SEARCH *s = (RSA_PAR_SEARCH *)BN_GENCB_get_arg(cb);
+  return (0 == s->done) ? 1 : 0;
+}
+
+/*! @brief Draw and test candidates until the search is done
+  @param s the search
+*/
+static void rsa_par_search(RSA_PAR_SEARCH *s)
+{
+  BN_CTX *ctx = NULL;
+  BN_GENCB *cb = NULL;
+  BIGNUM *c = NULL;
+  BIGNUM *r1 = NULL;
+  BIGNUM *r2 = NULL;
+  unsigned long error = 0;
+  int r = 0;
+  int rv = -1;
+
+  ctx = BN_CTX_new();
+  cb = BN_GENCB_new();
+  c = BN_secure_new();
+  r1 = BN_new();
+  r2 = BN_new();
+  if((NULL != ctx) && (NULL != cb) && (NULL != c) && (NULL != r1) && (NULL != r2)) {
+    BN_GENCB_set(cb,rsa_par_cb,s);
+    BN_set_flags(c,BN_FLG_CONSTTIME);
+    BN_set_flags(r1,BN_FLG_CONSTTIME);
+    BN_set_flags(r2,BN_FLG_CONSTTIME);
+    rv = 0;
+    while((0 == rv) && (0 == s->done)) {
+      if(!BN_rand(c,s->pbits,0,1)) {
+        rv = -1;
+        break;
+      }
+      /* Out of range candidates don't count as tries */
+      if(BN_cmp(c,s->lo) < 0) {
+        continue;
+      }
+      if(NULL != s->p) {
+        if(!BN_sub(r2,c,s->p)) {
+          rv = -1;
+          break;
+        }
+        if(BN_ucmp(r2,s->dmin) <= 0) {
+          continue;
+        }
+      }
+      ICC_LockMutex(&s->mtx);
+      if(s->tries >= (5 * s->pbits)) {
+        rv = -1;
+      } else {
+        s->tries++;
+      }
+      ICC_UnlockMutex(&s->mtx);
+      if(0 != rv) {
+        break;
+      }
+      if(!BN_sub(r2,c,BN_value_one())) {
+        rv = -1;
+        break;
+      }
+      ERR_set_mark();
+      if(NULL != BN_mod_inverse(r1,r2,s->e,ctx)) {
+        /* GCD == 1 since inverse exists */
+        r = BN_is_prime_fasttest_ex(c,(s->pbits > 1024) ? 4 : 5,ctx,0,cb);
+        if(r > 0) {
+          rv = 1;
+        } else if(r < 0) {
+          /* Either we were stopped or it failed */
+          if(0 != s->done) {
+            ERR_pop_to_mark();
+          } else {
+            rv = -1;
+          }
+        }
+      } else {
+        error = ERR_peek_last_error();
+        if((ERR_GET_LIB(error) == ERR_LIB_BN) &&
+           (ERR_GET_REASON(error) == BN_R_NO_INVERSE)) {
+          /* GCD != 1 */
+          ERR_pop_to_mark();
+        } else {
+          rv = -1;
+        }
+      }
+    }
+  }
+  if(0 != rv) {
+    rsa_par_finish(s,rv,c);
+  }
+  BN_free(r2);
+  BN_free(r1);
+  BN_clear_free(c);
+  BN_GENCB_free(cb);
+  BN_CTX_free(ctx);
+}
+
+static ICC_THREAD_RET ICC_THREAD_CALL rsa_par_worker(void *arg)
+{
+  RSA_PAR_WORKER *w = (RSA_PAR_WORKER *)arg;
+
+  rsa_par_search(w->s);
+  return 0;
+}
+
+/*! @brief Find one prime on up to rsa_par_threads threads
+  @param s the search, found, tries and done are set here
+  @return 1 O.K., 0 no prime found or an error
+*/
+static int rsa_par_prime(RSA_PAR_SEARCH *s)
+{
+  RSA_PAR_WORKER w[RSA_PAR_MAX_THREADS];
+  int nthr = rsa_par_threads;
+  int i = 0;
+
+  if(0 != ICC_CreateMutex(&s->mtx)) {
+    return 0;
+  }
+  s->tries = 0;
+  s->done = 0;
+  for(i = 1; i < nthr; i++) {
+    w[i].s = s;
+    w[i].started = (0 == ICC_CreateThread(&(w[i].thr),rsa_par_worker,&w[i]));
+  }
+  rsa_par_search(s);
+  for(i = 1; i < nthr; i++) {
+    if(w[i].started) {
+      ICC_JoinThread(&(w[i].thr));
+    }
+  }
+  ICC_DestroyMutex(&s->mtx);
+  return (1 == s->done) ? 1 : 0;
+}
+
+/*! @brief Should this keygen use the threaded search
+  @param rsa the key
+  @param bits the modulus size
+  @param e the public exponent
+  @param callback the caller's BN_GENCB
+  @return 1 yes
+*/
+static int RSAKeygenParallelOK(RSA *rsa, int bits, const BIGNUM *e, void *callback)
+{
+  const BIGNUM *p = NULL;
+  const BIGNUM *q = NULL;
+
+  if((rsa_par_threads < 2) || (NULL != callback) || (NULL == e) ||
+     (bits < RSA_PAR_MIN_BITS) || (((bits / 2) & 0xFF) != 0)) {
+    return 0;
+  }
+  if(RSA_get_method(rsa) != RSA_get_default_method()) {
+    return 0;
+  }
+  if((BN_num_bits(e) > 256) || (BN_cmp(e,BN_value_one()) <= 0) || !BN_is_odd(e) ||
+     (BN_get_word(e) < RSA_F4)) {
+    return 0;
+  }
+  RSA_get0_factors(rsa,&p,&q);
+  if(((NULL != p) && !BN_is_zero(p)) || ((NULL != q) && !BN_is_zero(q))) {
+    return 0;
+  }
+  return 1;
+}
+
+/*! @brief Generate an RSA key, searching for p and q on several threads.
+  The same key generation as the FIPS module, see the notes at the top
+  @param rsa the key
+  @param bits the modulus size
+  @param e the public exponent
+  @return 1 O.K., 0 failed
+*/
+static int RSAKeygenParallel(RSA *rsa, int bits, const BIGNUM *e)
+{
+  RSA_PAR_SEARCH s;
+  BN_CTX *ctx = NULL;
+  BIGNUM *lo = NULL, *dmin = NULL, *r0 = NULL, *r1 = NULL, *r2 = NULL, *tmp = NULL;
+  BIGNUM *n = NULL, *ee = NULL, *d = NULL, *p = NULL, *q = NULL;
+  BIGNUM *dmp1 = NULL, *dmq1 = NULL, *iqmp = NULL;
+  BIGNUM *dc = NULL;
+  int pbits = bits / 2;
+  int tries = 0;
+  int rv = 0;
+
+  memset(&s,0,sizeof(s));
+  ctx = BN_CTX_new();
+  lo = BN_new();
+  dmin = BN_new();
+  r0 = BN_new();
+  r1 = BN_new();
+  r2 = BN_new();
+  dc = BN_new();
+  n = BN_new();
+  ee = BN_dup(e);
+  d = BN_secure_new();
+  p = BN_secure_new();
+  q = BN_secure_new();
+  dmp1 = BN_secure_new();
+  dmq1 = BN_secure_new();
+  iqmp = BN_secure_new();
+  if((NULL == ctx) || (NULL == lo) || (NULL == dmin) || (NULL == r0) ||
+     (NULL == r1) || (NULL == r2) || (NULL == dc) || (NULL == n) ||
+     (NULL == ee) || (NULL == d) || (NULL == p) || (NULL == q) ||
+     (NULL == dmp1) || (NULL == dmq1) || (NULL == iqmp)) {
+    goto err;
+  }
+  BN_set_flags(r0,BN_FLG_CONSTTIME);
+  BN_set_flags(r1,BN_FLG_CONSTTIME);
+  BN_set_flags(r2,BN_FLG_CONSTTIME);
+  BN_set_flags(p,BN_FLG_CONSTTIME);
+  BN_set_flags(q,BN_FLG_CONSTTIME);
+  /* approximate minimum p and q, minimum p and q difference */
+  if(!BN_set_word(lo,0xB504F334) || !BN_lshift(lo,lo,pbits - 32) ||
+     !BN_one(dmin) || !BN_lshift(dmin,dmin,pbits - 100)) {
+    goto err;
+  }
+  s.pbits = pbits;
+  s.e = ee;
+  s.lo = lo;
+  s.dmin = dmin;
+  /* d is too small is vanishingly rare, the bound only stops a broken
+     RNG looping forever */
+  for(tries = 0; (0 == rv) && (tries < 16); tries++) {
+    s.p = NULL;
+    s.found = p;
+    if(!rsa_par_prime(&s)) {
+      break;
+    }
+    s.p = p;
+    s.found = q;
+    if(!rsa_par_prime(&s)) {
+      break;
+    }
+    if(BN_cmp(p,q) < 0) {
+      tmp = p;
+      p = q;
+      q = tmp;
+    }
+    if(!BN_mul(n,p,q,ctx) ||
+       !BN_sub(r1,p,BN_value_one()) ||   /* p-1 */
+       !BN_sub(r2,q,BN_value_one()) ||   /* q-1 */
+       !BN_gcd(r0,r1,r2,ctx) ||
+       !BN_div(r0,NULL,r1,r0,ctx) ||
+       !BN_mul(r0,r0,r2,ctx) ||          /* lcm(p-1, q-1) */
+       !BN_mod_inverse(d,ee,r0,ctx)) {
+      break;
+    }
+    if(BN_num_bits(d) < pbits) {
+      continue;
+    }
+    BN_with_flags(dc,d,BN_FLG_CONSTTIME);
+    if(!BN_mod(dmp1,dc,r1,ctx) ||         /* d mod (p-1) */
+       !BN_mod(dmq1,dc,r2,ctx) ||         /* d mod (q-1) */
+       !BN_mod_inverse(iqmp,q,p,ctx)) {   /* q^-1 mod p */
+      break;
+    }
+    rv = 1;
+  }
+  if(1 == rv) {
+    if(RSA_set0_key(rsa,n,ee,d)) {
+      n = ee = d = NULL;
+      if(RSA_set0_factors(rsa,p,q)) {
+        p = q = NULL;
+        if(RSA_set0_crt_params(rsa,dmp1,dmq1,iqmp)) {
+          dmp1 = dmq1 = iqmp = NULL;
+        } else {
+          rv = 0;
+        }
+      } else {
+        rv = 0;
+      }
+    } else {
+      rv = 0;
+    }
+  }
+err:
+  BN_free(dc); /* Shares d's data, not cleared */
+  BN_clear_free(iqmp);
+  BN_clear_free(dmq1);
+  BN_clear_free(dmp1);
+  BN_clear_free(q);
+  BN_clear_free(p);
+  BN_clear_free(d);
+  BN_free(ee);
+  BN_free(n);
+  BN_clear_free(r2);
+  BN_clear_free(r1);
+  BN_clear_free(r0);
+  BN_free(dmin);
+  BN_free(lo);
+  BN_CTX_free(ctx);
+  return rv;
+}
@@ -264,7 +264,8 @@ int SetStatusOK (ICClib *pcb,ICC_STATUS * stat)
 {
   /* Bug 2124, needs to be cleared as it may be uninitialized */
   stat->mode = 0;
-  strncpy(stat->desc,"O.K.",ICC_DESCLENGTH);
+  /* Not strncpy(), that zero fills all ICC_DESCLENGTH bytes on every call */
+  memcpy(stat->desc,"O.K.",sizeof("O.K."));
   stat->majRC = 0;
   stat->minRC = 0;
   SetFlags(pcb,stat);
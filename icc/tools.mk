@@ -18,7 +18,14 @@ TOOLS =	 \
 	smalltest4$(EXESUFX) \
 	GenRndData2$(EXESUFX) \
 	GenRndDataFIPS$(EXESUFX) \
-	sha256x$(EXESUFX)
+	sha256x$(EXESUFX) \
+	trcdump$(EXESUFX) \
+	iccbench_rng$(EXESUFX) \
+	iccbench_cipher$(EXESUFX) \
+	iccbench_pkey$(EXESUFX) \
+	iccbench_trng$(EXESUFX) \
+	iccbench_compare$(EXESUFX) \
+	iccstartup$(EXESUFX)
 
 # Disabled. Tried, didn't work
 #	FIPS_mem_collector$(EXESUFX) \
@@ -30,7 +37,7 @@ TOOLS =	 \
 GENRND_OBJS = GenRndData$(OBJSUFX) platform$(OBJSUFX) \
 	timer_entropy$(OBJSUFX) nist_algs$(OBJSUFX) \
 	noise_to_entropy$(OBJSUFX) \
-	TRNG_ALT4$(OBJSUFX) looper$(OBJSUFX) \
+	TRNG_ALT4$(OBJSUFX) OS_helpers$(OBJSUFX) looper$(OBJSUFX) \
 	$(ASMOBJS)
 
 GENRNDFIPS_OBJS =  GenRndDataFIPS$(OBJSUFX) platform$(OBJSUFX) \
@@ -65,6 +72,14 @@ $(SDK_DIR)/GenRndData.exe: GenRndData.exe
 	-$(CP) GenRndData.exe.manifest $(SDK_DIR)/
 
 
+#- Binary trace decoder, see tracer.h
+trcdump$(OBJSUFX): tools/trcdump.c tracer.h
+	-$(CC) $(CFLAGS) -I./ tools/trcdump.c
+
+trcdump$(EXESUFX): trcdump$(OBJSUFX)
+	-$(LD) $(LDFLAGS) trcdump$(OBJSUFX) $(LDLIBS)
+	-$(CP) trcdump$(EXESUFX) $(SDK_DIR)/
+
 #- Compile hash check tool
 sha256x$(OBJSUFX): tools/sha256x.c 
 	-$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR)  tools/sha256x.c 
@@ -100,6 +115,90 @@ GenRndData2.exe: GenRndData2$(OBJSUFX) $(ICCLIB)
 	-$(MT) -manifest $@.manifest  -outputresource:$@\;1
 	-$(CP) GenRndData2.exe $(SDK_DIR)/
 
+#- Multi-threaded RNG throughput/latency benchmark
+
+iccbench_rng$(OBJSUFX): tools/iccbench_rng.c tools/iccbench.h tools/icctimer.h $(SDK_DIR)/icc.h $(SDK_DIR)/icc_a.h $(SDK_DIR)/iccglobals.h
+	-$(CC) $(CFLAGS) -I $(SDK_DIR) tools/iccbench_rng.c
+
+iccbench_rng: iccbench_rng$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) iccbench_rng$(OBJSUFX) $(ICCLIB) $(LDLIBS) -lm
+	-$(CP) iccbench_rng $(SDK_DIR)/
+
+iccbench_rng.exe: iccbench_rng$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) iccbench_rng$(OBJSUFX) $(ICCLIB) $(LDLIBS)
+	-$(MT) -manifest $@.manifest  -outputresource:$@\;1
+	-$(CP) iccbench_rng.exe $(SDK_DIR)/
+
+#- Cipher and AEAD throughput benchmark, ICC APIs against the EVP stubs
+
+iccbench_cipher$(OBJSUFX): tools/iccbench_cipher.c tools/iccbench.h tools/icctimer.h $(SDK_DIR)/icc.h $(SDK_DIR)/icc_a.h $(SDK_DIR)/iccglobals.h
+	-$(CC) $(CFLAGS) -I $(SDK_DIR) tools/iccbench_cipher.c
+
+iccbench_cipher: iccbench_cipher$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) iccbench_cipher$(OBJSUFX) $(ICCLIB) $(LDLIBS) -lm
+	-$(CP) iccbench_cipher $(SDK_DIR)/
+
+iccbench_cipher.exe: iccbench_cipher$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) iccbench_cipher$(OBJSUFX) $(ICCLIB) $(LDLIBS)
+	-$(MT) -manifest $@.manifest  -outputresource:$@\;1
+	-$(CP) iccbench_cipher.exe $(SDK_DIR)/
+
+#- Asymmetric and KDF latency/throughput benchmark
+
+iccbench_pkey$(OBJSUFX): tools/iccbench_pkey.c tools/iccbench.h tools/icctimer.h $(SDK_DIR)/icc.h $(SDK_DIR)/icc_a.h $(SDK_DIR)/iccglobals.h
+	-$(CC) $(CFLAGS) -I $(SDK_DIR) tools/iccbench_pkey.c
+
+iccbench_pkey: iccbench_pkey$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) iccbench_pkey$(OBJSUFX) $(ICCLIB) $(LDLIBS) -lm
+	-$(CP) iccbench_pkey $(SDK_DIR)/
+
+iccbench_pkey.exe: iccbench_pkey$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) iccbench_pkey$(OBJSUFX) $(ICCLIB) $(LDLIBS)
+	-$(MT) -manifest $@.manifest  -outputresource:$@\;1
+	-$(CP) iccbench_pkey.exe $(SDK_DIR)/
+
+#- Entropy source characterization, per tuner and under CPU load
+
+iccbench_trng$(OBJSUFX): tools/iccbench_trng.c tools/iccbench.h tools/icctimer.h $(SDK_DIR)/icc.h $(SDK_DIR)/icc_a.h $(SDK_DIR)/iccglobals.h
+	-$(CC) $(CFLAGS) -I $(SDK_DIR) tools/iccbench_trng.c
+
+iccbench_trng: iccbench_trng$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) iccbench_trng$(OBJSUFX) $(ICCLIB) $(LDLIBS) -lm
+	-$(CP) iccbench_trng $(SDK_DIR)/
+
+iccbench_trng.exe: iccbench_trng$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) iccbench_trng$(OBJSUFX) $(ICCLIB) $(LDLIBS)
+	-$(MT) -manifest $@.manifest  -outputresource:$@\;1
+	-$(CP) iccbench_trng.exe $(SDK_DIR)/
+
+#- Compare iccbench -j results against a baseline, needs no ICC
+
+iccbench_compare$(OBJSUFX): tools/iccbench_compare.c
+	-$(CC) $(CFLAGS) tools/iccbench_compare.c
+
+iccbench_compare: iccbench_compare$(OBJSUFX)
+	-$(LD) $(LDFLAGS) iccbench_compare$(OBJSUFX) $(LDLIBS) -lm
+	-$(CP) iccbench_compare $(SDK_DIR)/
+
+iccbench_compare.exe: iccbench_compare$(OBJSUFX)
+	-$(LD) $(LDFLAGS) iccbench_compare$(OBJSUFX) $(LDLIBS)
+	-$(MT) -manifest $@.manifest  -outputresource:$@\;1
+	-$(CP) iccbench_compare.exe $(SDK_DIR)/
+
+#- Startup latency benchmark, runs itself as fresh child processes
+
+iccstartup$(OBJSUFX): tools/iccstartup.c tools/icctimer.h $(SDK_DIR)/icc.h $(SDK_DIR)/icc_a.h $(SDK_DIR)/iccglobals.h
+	-$(CC) $(CFLAGS) -I $(SDK_DIR) tools/iccstartup.c
+
+iccstartup: iccstartup$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) iccstartup$(OBJSUFX) $(ICCLIB) $(LDLIBS)
+	-$(CP) iccstartup $(SDK_DIR)/
+
+iccstartup.exe: iccstartup$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) iccstartup$(OBJSUFX) $(ICCLIB) $(LDLIBS)
+	-$(MT) -manifest $@.manifest  -outputresource:$@\;1
+	-$(CP) iccstartup.exe $(SDK_DIR)/
+
 #- FIPS specific RNG data generator	
 
 GenRndDataFIPS$(OBJSUFX): tools/GenRndDataFIPS.c 
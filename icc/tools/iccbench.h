@@ -0,0 +1,183 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Common result records for the iccbench tools.
+//
+// With -j the iccbench tools write JSON lines to stdout, one object per
+// line, rather than a table. Each run (each child for iccbench_trng)
+// starts with a meta record describing where it ran
+//
+//   {"schema":"iccbench-1","type":"meta","tool":"iccbench_rng",
+//    "host":"...","os":"Linux 5.14.0 x86_64","cpu":"...","icc":"8.9.12.0",
+//    "fips":"off","trng":"TRNG_HW","prng":"SHA256","rng_instances":7,
+//    "rng_tuner":2}
+//
+// cpu is ICC_CPU_CAPABILITY_MASK, the CPU features the crypto code is
+// using, trng and prng ICC_SEED_GENERATOR and ICC_RANDOM_GENERATOR.
+// Then one point record per test point
+//
+//   {"schema":"iccbench-1","type":"point","tool":"iccbench_rng",
+//    "key":"RAND/-/t4/b1024","n":1234567,"mean_ns":812.4,"sd_ns":95.1,
+//    "p50_ns":768,"p90_ns":960,"p99_ns":1536,"p999_ns":3072,
+//    "ops_per_sec":4919384,"mb_per_sec":5037.45}
+//
+// key names the point and is the same from run to run, it's what
+// iccbench_compare matches a baseline against. n is the number of timed
+// calls and mean_ns/sd_ns the mean and standard deviation of a call,
+// the percentiles are bucketed as ICC_API_STATS is. A point that failed
+// has "failed":true and no figures. Tools may append their own fields to
+// a point, iccbench_compare ignores those.
+//
+// Bump the schema name if an existing field changes meaning.
+*************************************************************************/
+
+#if !defined(ICCBENCH_H)
+#define ICCBENCH_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/utsname.h>
+#endif
+
+#include "icc.h"
+
+#define ICCBENCH_SCHEMA "iccbench-1"
+
+/*! @brief Write a string as a JSON string */
+static void iccbench_str(FILE *f, const char *s)
+{
+  fputc('"', f);
+  for (; (NULL != s) && ('\0' != *s); s++) {
+    if (('"' == *s) || ('\\' == *s)) {
+      fprintf(f, "\\%c", *s);
+    } else if ((unsigned char)*s < 0x20) {
+      fprintf(f, "\\u%04x", (unsigned char)*s);
+    } else {
+      fputc(*s, f);
+    }
+  }
+  fputc('"', f);
+}
+
+/*! @brief Write the meta record for this run
+    @param f where to write it
+    @param ctx an attached ICC context
+    @param tool the tool name
+*/
+static void iccbench_meta(FILE *f, ICC_CTX *ctx, const char *tool)
+{
+  ICC_STATUS status;
+  char buf[256];
+  int n = -1;
+
+  memset(&status, 0, sizeof(status));
+  fprintf(f, "{\"schema\":\"%s\",\"type\":\"meta\",\"tool\":", ICCBENCH_SCHEMA);
+  iccbench_str(f, tool);
+  memset(buf, 0, sizeof(buf));
+#if defined(_WIN32)
+  {
+    DWORD len = sizeof(buf) - 1;
+    GetComputerNameA(buf, &len);
+  }
+  fprintf(f, ",\"host\":");
+  iccbench_str(f, buf);
+  fprintf(f, ",\"os\":\"Windows\"");
+#else
+  {
+    struct utsname u;
+    memset(&u, 0, sizeof(u));
+    uname(&u);
+    fprintf(f, ",\"host\":");
+    iccbench_str(f, u.nodename);
+    sprintf(buf, "%.60s %.60s %.60s", u.sysname, u.release, u.machine);
+    fprintf(f, ",\"os\":");
+    iccbench_str(f, buf);
+  }
+#endif
+  memset(buf, 0, sizeof(buf));
+  ICC_GetValue(ctx, &status, ICC_CPU_CAPABILITY_MASK, buf, 20);
+  fprintf(f, ",\"cpu\":");
+  iccbench_str(f, buf);
+  memset(buf, 0, sizeof(buf));
+  ICC_GetValue(ctx, &status, ICC_VERSION, buf, sizeof(buf) - 1);
+  fprintf(f, ",\"icc\":");
+  iccbench_str(f, buf);
+  memset(buf, 0, sizeof(buf));
+  ICC_GetValue(ctx, &status, ICC_FIPS_APPROVED_MODE, buf, 20);
+  fprintf(f, ",\"fips\":");
+  iccbench_str(f, buf);
+  memset(buf, 0, sizeof(buf));
+  ICC_GetValue(ctx, &status, ICC_SEED_GENERATOR, buf, 20);
+  fprintf(f, ",\"trng\":");
+  iccbench_str(f, buf);
+  memset(buf, 0, sizeof(buf));
+  ICC_GetValue(ctx, &status, ICC_RANDOM_GENERATOR, buf, 20);
+  fprintf(f, ",\"prng\":");
+  iccbench_str(f, buf);
+  ICC_GetValue(ctx, &status, ICC_RNG_INSTANCES, &n, sizeof(n));
+  fprintf(f, ",\"rng_instances\":%d", n);
+  n = -1;
+  ICC_GetValue(ctx, &status, ICC_RNG_TUNER, &n, sizeof(n));
+  fprintf(f, ",\"rng_tuner\":%d}\n", n);
+  fflush(f);
+}
+
+/*! @brief Write a point record
+    @param f where to write it
+    @param tool the tool name
+    @param key the point's name, stable across runs
+    @param n timed calls, 0 if the point failed
+    @param sum sum of the call times in ns
+    @param sum2 sum of the squares of the call times
+    @param pct p50, p90, p99 and p99.9 in ns, may be NULL
+    @param ops calls per second over all threads
+    @param mbps MB per second, < 0 if there's no meaningful size
+    @param extra more fields, ',' separated, may be NULL
+*/
+static void iccbench_point(FILE *f, const char *tool, const char *key, unsigned long long n,
+                           double sum, double sum2, const unsigned long long *pct, double ops,
+                           double mbps, const char *extra)
+{
+  double mean = 0.0, var = 0.0;
+
+  fprintf(f, "{\"schema\":\"%s\",\"type\":\"point\",\"tool\":", ICCBENCH_SCHEMA);
+  iccbench_str(f, tool);
+  fprintf(f, ",\"key\":");
+  iccbench_str(f, key);
+  if (0 == n) {
+    fprintf(f, ",\"failed\":true}\n");
+    fflush(f);
+    return;
+  }
+  mean = sum / (double)n;
+  if (n > 1) {
+    var = (sum2 - sum * mean) / (double)(n - 1);
+  }
+  fprintf(f, ",\"n\":%llu,\"mean_ns\":%.1f,\"sd_ns\":%.1f", n, mean, (var > 0.0) ? sqrt(var) : 0.0);
+  if (NULL != pct) {
+    fprintf(f, ",\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu",
+            pct[0], pct[1], pct[2], pct[3]);
+  }
+  fprintf(f, ",\"ops_per_sec\":%.1f", ops);
+  if (mbps >= 0.0) {
+    fprintf(f, ",\"mb_per_sec\":%.2f", mbps);
+  }
+  if (NULL != extra) {
+    fprintf(f, ",%s", extra);
+  }
+  fprintf(f, "}\n");
+  fflush(f);
+}
+
+#endif
@@ -0,0 +1,495 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Cipher and AEAD throughput benchmark.
+//
+// Encrypts messages of 16 bytes to 16MB (x4 steps) from 1..N threads,
+// in place and out of place, through the ICC specific APIs and through
+// the generic EVP stubs, and reports ops/s, MB/s and latency percentiles
+// for each point, as a table or as iccbench.h JSON records (-j).
+//
+// Each ICC API case is run both ways where the API allows it, so the
+// setup cost shows up as the difference between the pair
+//   GCM-Init      AES_GCM_Init()+EncryptUpdate()+EncryptFinal(), re-keyed
+//                 every message
+//   GCM-Seal      AES_GCM_Seal() keyed once, NULL key after that
+//   CCM-Encrypt   AES_CCM_Encrypt(), key and mode setup every message
+//   CCM-Seal      AES_CCM_Seal() on a context keyed once
+//   CHACHA-Seal   CHACHA_POLY_Seal() on a context keyed once
+//   XTS-Sectors   AES_XTS_Sectors(), one data unit per message
+// and the EVP cases re-IV a keyed EVP_CIPHER_CTX per message, as
+// "openssl speed -evp" does, so they line up against that directly
+//   EVP-AES-128-GCM EVP-CHACHA20-POLY1305 EVP-AES-128-XTS
+//   EVP-AES-128-CBC EVP-AES-128-CTR
+//
+// Keys are AES-128 throughout (AES-128-XTS, 2x128), 12 byte IVs and
+// 16 byte tags, with 13 bytes of AAD on the AEAD cases, a TLS header.
+//
+// Latencies are bucketed as ICC_API_STATS does, so the percentiles are
+// within 25%, and include the timing overhead, a few ns.
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "icc.h"
+#include "iccbench.h"
+#include "icctimer.h"
+
+#define MAX_THREADS 256
+#define DEF_THREADS 4
+#define MAX_MSG (16 * 1024 * 1024) /*!< Largest message in the sweep */
+#define MIN_MSG 16                 /*!< Smallest, each step is x4 */
+#define SLACK 64                   /*!< Room in the buffers for tags and padding */
+#define AADLEN 13
+
+enum {
+  C_GCM_INIT, C_GCM_SEAL, C_CCM_ENCRYPT, C_CCM_SEAL, C_CHACHA_SEAL, C_XTS_SECTORS,
+  C_EVP_GCM, C_EVP_CHACHA, C_EVP_XTS, C_EVP_CBC, C_EVP_CTR, C_COUNT
+};
+
+/*! @brief The cases, in C_ order */
+static const struct {
+  const char *name;
+  const char *evp; /*!< EVP cipher name for the EVP cases */
+  int aead;        /*!< Tag to fetch after EVP_EncryptFinal() */
+} cases[C_COUNT] = {
+  { "GCM-Init", NULL, 0 },
+  { "GCM-Seal", NULL, 0 },
+  { "CCM-Encrypt", NULL, 0 },
+  { "CCM-Seal", NULL, 0 },
+  { "CHACHA-Seal", NULL, 0 },
+  { "XTS-Sectors", NULL, 0 },
+  { "EVP-AES-128-GCM", "AES-128-GCM", 1 },
+  { "EVP-CHACHA20-POLY1305", "CHACHA20-POLY1305", 1 },
+  { "EVP-AES-128-XTS", "AES-128-XTS", 0 },
+  { "EVP-AES-128-CBC", "AES-128-CBC", 0 },
+  { "EVP-AES-128-CTR", "AES-128-CTR", 0 }
+};
+
+/*! XTS wants Key1 != Key2, CHACHA a 32 byte key, everything else AES-128 */
+static unsigned char key[32] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+  0xf0, 0xe1, 0xd2, 0xc3, 0xb4, 0xa5, 0x96, 0x87, 0x78, 0x69, 0x5a, 0x4b, 0x3c, 0x2d, 0x1e, 0x0f
+};
+static unsigned char iv[16] = {
+  0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88, 0, 0, 0, 0
+};
+static unsigned char aad[AADLEN] = { 0x17, 0x03, 0x03, 0x40, 0x00 };
+
+/*! @brief One thread's share of a test point */
+typedef struct {
+  ICC_CTX *ctx;
+  int c;                       /*!< Case */
+  int size;                    /*!< Message size */
+  int inplace;                 /*!< Output over the input */
+  unsigned char *in;
+  unsigned char *out;
+  volatile int ready;          /*!< Set up and waiting for go */
+  int failed;
+  unsigned long long ops;
+  double sum;                  /*!< Sum of the call times in ns */
+  double sum2;                 /*!< and of their squares */
+  unsigned long long hist[ICC_API_BUCKETS];
+#if defined(_WIN32)
+  HANDLE thr;
+#else
+  pthread_t thr;
+#endif
+} WORK;
+
+static volatile int go = 0;   /*!< Start counting */
+static volatile int stop = 0; /*!< Stop counting */
+
+static void sleep_ms(int ms)
+{
+#if defined(_WIN32)
+  Sleep(ms);
+#else
+  usleep(ms * 1000);
+#endif
+}
+
+/*! @brief Latency bucket, the inverse of ICC_API_BUCKET_NS() */
+static int bucket(unsigned long long ns)
+{
+  int b = ICC_API_BUCKETS - 1;
+  while ((b > 0) && (ICC_API_BUCKET_NS(b) > ns)) {
+    b--;
+  }
+  return b;
+}
+
+/*! @brief Benchmark thread
+    @param arg the WORK
+*/
+#if defined(_WIN32)
+static DWORD WINAPI worker(void *arg)
+#else
+static void *worker(void *arg)
+#endif
+{
+  WORK *w = (WORK *)arg;
+  ICC_CTX *ctx = w->ctx;
+  ICC_AES_GCM_CTX *gcm = NULL;
+  ICC_AES_CCM_CTX *ccm = NULL;
+  ICC_CHACHA_POLY_CTX *cp = NULL;
+  ICC_AES_XTS_CTX *xts = NULL;
+  ICC_EVP_CIPHER_CTX *ectx = NULL;
+  const ICC_EVP_CIPHER *cip = NULL;
+  unsigned char tag[16];
+  unsigned char *out = w->inplace ? w->in : w->out;
+  unsigned long outl = 0, tl = 0;
+  unsigned long long t0 = 0, t1 = 0, dun = 0;
+  int l = 0, ok = 1;
+
+  switch (w->c) {
+  case C_GCM_INIT:
+    gcm = ICC_AES_GCM_CTX_new(ctx);
+    ok = (NULL != gcm);
+    break;
+  case C_GCM_SEAL:
+    gcm = ICC_AES_GCM_CTX_new(ctx);
+    ok = (NULL != gcm) &&
+         (1 == ICC_AES_GCM_Seal(ctx, gcm, iv, 12, key, 16, aad, AADLEN, w->in, w->size, w->out, &outl));
+    break;
+  case C_CCM_ENCRYPT:
+    break;
+  case C_CCM_SEAL:
+    ccm = ICC_AES_CCM_CTX_new(ctx);
+    ok = (NULL != ccm) && (1 == ICC_AES_CCM_Init(ctx, ccm, key, 16, 16));
+    break;
+  case C_CHACHA_SEAL:
+    cp = ICC_CHACHA_POLY_CTX_new(ctx);
+    ok = (NULL != cp) && (1 == ICC_CHACHA_POLY_Init(ctx, cp, key, 32));
+    break;
+  case C_XTS_SECTORS:
+    xts = ICC_AES_XTS_CTX_new(ctx);
+    ok = (NULL != xts) && (1 == ICC_AES_XTS_Init(ctx, xts, key, 32, 1));
+    break;
+  default:
+    cip = ICC_EVP_get_cipherbyname(ctx, cases[w->c].evp);
+    ectx = ICC_EVP_CIPHER_CTX_new(ctx);
+    ok = (NULL != cip) && (NULL != ectx) && (1 == ICC_EVP_EncryptInit(ctx, ectx, cip, key, iv));
+    break;
+  }
+  w->failed = !ok;
+  w->ready = 1;
+  while (!go) {
+    sleep_ms(1);
+  }
+  while (!stop && !w->failed) {
+    t0 = now_ns();
+    switch (w->c) {
+    case C_GCM_INIT:
+      ok = (1 == ICC_AES_GCM_Init(ctx, gcm, iv, 12, key, 16)) &&
+           (1 == ICC_AES_GCM_EncryptUpdate(ctx, gcm, aad, AADLEN, w->in, w->size, out, &outl)) &&
+           (1 == ICC_AES_GCM_EncryptFinal(ctx, gcm, out + outl, &tl, tag));
+      break;
+    case C_GCM_SEAL:
+      ok = (1 == ICC_AES_GCM_Seal(ctx, gcm, iv, 12, NULL, 16, aad, AADLEN, w->in, w->size, out, &outl));
+      break;
+    case C_CCM_ENCRYPT:
+      ok = (1 == ICC_AES_CCM_Encrypt(ctx, iv, 12, key, 16, aad, AADLEN, w->in, w->size, out, &outl, 16));
+      break;
+    case C_CCM_SEAL:
+      ok = (1 == ICC_AES_CCM_Seal(ctx, ccm, iv, 12, aad, AADLEN, w->in, w->size, out, &outl));
+      break;
+    case C_CHACHA_SEAL:
+      ok = (1 == ICC_CHACHA_POLY_Seal(ctx, cp, iv, 12, aad, AADLEN, w->in, w->size, out, &outl));
+      break;
+    case C_XTS_SECTORS:
+      ok = (1 == ICC_AES_XTS_Sectors(ctx, xts, dun++, w->size, 1, w->in, out));
+      break;
+    default:
+      ok = (1 == ICC_EVP_EncryptInit(ctx, ectx, NULL, NULL, iv));
+      if (ok && cases[w->c].aead) {
+        ok = (1 == ICC_EVP_EncryptUpdate(ctx, ectx, NULL, &l, aad, AADLEN));
+      }
+      ok = ok && (1 == ICC_EVP_EncryptUpdate(ctx, ectx, out, &l, w->in, w->size)) &&
+           (1 == ICC_EVP_EncryptFinal(ctx, ectx, out + l, &l));
+      if (ok && cases[w->c].aead) {
+        ok = (1 == ICC_EVP_CIPHER_CTX_ctrl(ctx, ectx, ICC_EVP_CTRL_GCM_GET_TAG, 16, tag));
+      }
+      break;
+    }
+    t1 = now_ns();
+    w->failed = !ok;
+    w->ops++;
+    w->sum += (double)(t1 - t0);
+    w->sum2 += (double)(t1 - t0) * (double)(t1 - t0);
+    w->hist[bucket(t1 - t0)]++;
+  }
+  if (NULL != gcm) {
+    ICC_AES_GCM_CTX_free(ctx, gcm);
+  }
+  if (NULL != ccm) {
+    ICC_AES_CCM_CTX_free(ctx, ccm);
+  }
+  if (NULL != cp) {
+    ICC_CHACHA_POLY_CTX_free(ctx, cp);
+  }
+  if (NULL != xts) {
+    ICC_AES_XTS_CTX_free(ctx, xts);
+  }
+  if (NULL != ectx) {
+    ICC_EVP_CIPHER_CTX_free(ctx, ectx);
+  }
+  return 0;
+}
+
+/*! @brief The latency below which a fraction of the calls completed */
+static unsigned long long pctile(const unsigned long long *hist, unsigned long long n, double p)
+{
+  unsigned long long c = 0;
+  int b = 0;
+  for (b = 0; b < ICC_API_BUCKETS; b++) {
+    c += hist[b];
+    if ((double)c >= p * (double)n) {
+      break;
+    }
+  }
+  return ICC_API_BUCKET_NS((b < ICC_API_BUCKETS) ? b : ICC_API_BUCKETS - 1);
+}
+
+static int json = 0; /*!< -j, iccbench.h records rather than a table */
+
+/*! @brief Run and report one test point
+    @return 0 on success
+*/
+static int run_point(ICC_CTX *ctx, int c, int nthr, int size, int inplace, int ms)
+{
+  static WORK w[MAX_THREADS];
+  unsigned long long hist[ICC_API_BUCKETS];
+  unsigned long long pct[4];
+  unsigned long long ops = 0, t0 = 0, t1 = 0;
+  double secs = 0.0, sum = 0.0, sum2 = 0.0;
+  char key[128];
+  int i = 0, b = 0, failed = 0;
+
+  memset(hist, 0, sizeof(hist));
+  go = stop = 0;
+  for (i = 0; i < nthr; i++) {
+    memset(&w[i], 0, sizeof(WORK));
+    w[i].ctx = ctx;
+    w[i].c = c;
+    w[i].size = size;
+    w[i].inplace = inplace;
+    w[i].in = (unsigned char *)calloc(1, size + SLACK);
+    w[i].out = (unsigned char *)calloc(1, size + SLACK);
+    if ((NULL == w[i].in) || (NULL == w[i].out)) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+#if defined(_WIN32)
+    w[i].thr = CreateThread(NULL, 0, worker, &w[i], 0, NULL);
+    if (NULL == w[i].thr) {
+#else
+    if (0 != pthread_create(&w[i].thr, NULL, worker, &w[i])) {
+#endif
+      fprintf(stderr, "Can't create thread %d\n", i);
+      exit(1);
+    }
+  }
+  for (i = 0; i < nthr; i++) {
+    while (!w[i].ready) {
+      sleep_ms(1);
+    }
+  }
+  t0 = now_ns();
+  go = 1;
+  sleep_ms(ms);
+  stop = 1;
+  for (i = 0; i < nthr; i++) {
+#if defined(_WIN32)
+    WaitForSingleObject(w[i].thr, INFINITE);
+    CloseHandle(w[i].thr);
+#else
+    pthread_join(w[i].thr, NULL);
+#endif
+  }
+  t1 = now_ns();
+  for (i = 0; i < nthr; i++) {
+    ops += w[i].ops;
+    sum += w[i].sum;
+    sum2 += w[i].sum2;
+    failed |= w[i].failed;
+    for (b = 0; b < ICC_API_BUCKETS; b++) {
+      hist[b] += w[i].hist[b];
+    }
+    free(w[i].in);
+    free(w[i].out);
+  }
+  secs = (double)(t1 - t0) / 1.0e9;
+  if (json) {
+    sprintf(key, "%s/t%d/b%d/%s", cases[c].name, nthr, size, inplace ? "in" : "out");
+    pct[0] = pctile(hist, ops, 0.5);
+    pct[1] = pctile(hist, ops, 0.9);
+    pct[2] = pctile(hist, ops, 0.99);
+    pct[3] = pctile(hist, ops, 0.999);
+    iccbench_point(stdout, "iccbench_cipher", key, failed ? 0 : ops, sum, sum2, pct,
+                   (double)ops / secs, (double)ops * size / secs / 1.0e6, NULL);
+  } else if (failed) {
+    printf("%-21s %3s %3d %8d  failed\n", cases[c].name, inplace ? "in" : "out", nthr, size);
+  } else {
+    printf("%-21s %3s %3d %8d %12.0f %10.2f %10llu %10llu %10llu %10llu\n",
+           cases[c].name, inplace ? "in" : "out", nthr, size, (double)ops / secs,
+           (double)ops * size / secs / 1.0e6, pctile(hist, ops, 0.5),
+           pctile(hist, ops, 0.9), pctile(hist, ops, 0.99), pctile(hist, ops, 0.999));
+  }
+  fflush(stdout);
+  return failed;
+}
+
+/*! @brief Sweep threads, message sizes and in/out of place for one case
+    @param place 1 in place, 2 out of place, 3 both
+*/
+static int sweep(ICC_CTX *ctx, int c, int maxthr, int maxmsg, int place, int ms)
+{
+  int rv = 0;
+  int t = 0, s = 0, p = 0;
+
+  if ((NULL != cases[c].evp) && (NULL == ICC_EVP_get_cipherbyname(ctx, cases[c].evp))) {
+    if (!json) {
+      printf("%-21s not available\n", cases[c].name);
+    }
+    return 0;
+  }
+  for (t = 1; 0 == rv; t *= 2) {
+    if (t > maxthr) {
+      t = maxthr;
+    }
+    for (s = MIN_MSG; (s <= maxmsg) && (0 == rv); s *= 4) {
+      for (p = 1; (p >= 0) && (0 == rv); p--) {
+        if (place & (p ? 1 : 2)) {
+          rv = run_point(ctx, c, t, s, p, ms);
+        }
+      }
+    }
+    if (t == maxthr) {
+      break;
+    }
+  }
+  return rv;
+}
+
+static void usage(const char *me)
+{
+  int i = 0;
+#if !defined(ICCPKG)
+  fprintf(stderr, "Usage: %s pathToICC [-t threads] [-d ms] [-s maxbytes] [-p in|out|both] [-c case] [-j]\n", me);
+  fprintf(stderr, "       pathToICC is the path to the ICC libraries passed to ICC_Init()\n");
+#else
+  fprintf(stderr, "Usage: %s [-t threads] [-d ms] [-s maxbytes] [-p in|out|both] [-c case] [-j]\n", me);
+#endif
+  fprintf(stderr, "       -t most threads, default %d, the sweep doubles from 1\n", DEF_THREADS);
+  fprintf(stderr, "       -d time per point in ms, default 200\n");
+  fprintf(stderr, "       -s largest message, default %d, the sweep is x4 from %d\n", MAX_MSG, MIN_MSG);
+  fprintf(stderr, "       -p in place, out of place or both, default both\n");
+  fprintf(stderr, "       -j write iccbench.h JSON records to stdout rather than a table\n");
+  fprintf(stderr, "       -c case to run, may be repeated, default all of:\n");
+  for (i = 0; i < C_COUNT; i++) {
+    fprintf(stderr, "          %s\n", cases[i].name);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  ICC_STATUS stat, *status = &stat;
+  ICC_CTX *ctx = NULL;
+  const char *path = NULL;
+  char buf[256];
+  int run[C_COUNT];
+  int any = 0;
+  int maxthr = DEF_THREADS;
+  int maxmsg = MAX_MSG;
+  int place = 3;
+  int ms = 200;
+  int i = 1, c = 0, rv = 0;
+
+  memset(run, 0, sizeof(run));
+#if !defined(ICCPKG)
+  if (argc < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  path = argv[i++];
+#endif
+  for (; i < argc; i++) {
+    if ((0 == strcmp(argv[i], "-t")) && (i + 1 < argc)) {
+      maxthr = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-d")) && (i + 1 < argc)) {
+      ms = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-s")) && (i + 1 < argc)) {
+      maxmsg = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-p")) && (i + 1 < argc)) {
+      i++;
+      place = (0 == strcmp(argv[i], "in")) ? 1 : (0 == strcmp(argv[i], "out")) ? 2 :
+              (0 == strcmp(argv[i], "both")) ? 3 : 0;
+    } else if ((0 == strcmp(argv[i], "-c")) && (i + 1 < argc)) {
+      i++;
+      for (c = 0; (c < C_COUNT) && strcmp(argv[i], cases[c].name); c++)
+        ;
+      if (c == C_COUNT) {
+        usage(argv[0]);
+        return 1;
+      }
+      run[c] = any = 1;
+    } else if (0 == strcmp(argv[i], "-j")) {
+      json = 1;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((maxthr < 1) || (maxthr > MAX_THREADS) || (ms < 1) || (0 == place) ||
+      (maxmsg < MIN_MSG) || (maxmsg > MAX_MSG)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  memset(status, 0, sizeof(ICC_STATUS));
+  ctx = ICC_Init(status, path);
+  if (NULL == ctx) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    return 1;
+  }
+  ICC_SetValue(ctx, status, ICC_FIPS_APPROVED_MODE, "off");
+  if (ICC_ERROR == ICC_Attach(ctx, status)) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    ICC_Cleanup(ctx, status);
+    return 1;
+  }
+
+  if (json) {
+    iccbench_meta(stdout, ctx, "iccbench_cipher");
+  } else {
+    memset(buf, 0, sizeof(buf));
+    ICC_GetValue(ctx, status, ICC_VERSION, buf, sizeof(buf) - 1);
+    printf("ICC %s\n\n", buf);
+    printf("%-21s %3s %3s %8s %12s %10s %10s %10s %10s %10s\n", "case", "buf", "thr",
+           "bytes", "ops/s", "MB/s", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns");
+  }
+  for (c = 0; c < C_COUNT; c++) {
+    if (!any || run[c]) {
+      rv |= sweep(ctx, c, maxthr, maxmsg, place, ms);
+    }
+  }
+  ICC_Cleanup(ctx, status);
+  return rv;
+}
@@ -0,0 +1,371 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Compare iccbench results against a baseline.
+//
+// Reads two files of iccbench.h records, as written by the iccbench
+// tools with -j, matches the points by tool and key and flags a point
+// as a regression when the current mean call time is both
+//   - more than -t percent (default 5) slower than the baseline, and
+//   - slower with one sided significance -a (default 0.01) by Welch's
+//     t-test on n, mean_ns and sd_ns
+// and as an improvement the same way the other way round. Points with
+// fewer than two calls on either side only get the threshold test.
+//
+// The calls in one run aren't independent samples, so with the millions
+// of calls of a fast point almost any difference is "significant", the
+// threshold is what keeps the noise out there, the t-test is what keeps
+// it out for the slow points, keygen, with few calls.
+//
+// The meta records are compared too and any difference other than the
+// ICC version (host, CPU capabilities, FIPS mode, TRNG/PRNG settings) is
+// warned about, as the comparison isn't like for like.
+//
+// Exits 0 if there are no regressions, 1 if any point regressed or a
+// point that passed in the baseline failed, 2 if the input can't be
+// read, so it can be used as a gate.
+//
+// Usage: iccbench_compare [-t percent] [-a alpha] [-q] baseline current
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_LINE 4096
+#define MAX_STR 128
+
+/*! @brief One point record */
+typedef struct {
+  char tool[MAX_STR];
+  char key[MAX_STR];
+  int failed;
+  double n;
+  double mean;
+  double sd;
+  int seen;                    /*!< Matched against the other file */
+} POINT;
+
+/*! @brief The fields of a meta record we compare */
+static const char *meta_fields[] = {
+  "host", "os", "cpu", "fips", "trng", "prng", "rng_instances", "rng_tuner", NULL
+};
+
+/*! @brief One results file */
+typedef struct {
+  const char *name;
+  char meta[MAX_LINE];         /*!< The first meta record */
+  char icc[MAX_STR];
+  POINT *p;
+  int n;
+} RESULTS;
+
+/*! @brief Find the value of a field in a record
+    @param rec the record
+    @param field the field name
+    @return a pointer to the value or NULL
+*/
+static const char *field(const char *rec, const char *field)
+{
+  char pat[MAX_STR + 4];
+  const char *s = NULL;
+
+  sprintf(pat, "\"%.120s\":", field);
+  s = strstr(rec, pat);
+  return (NULL != s) ? s + strlen(pat) : NULL;
+}
+
+/*! @brief Copy a field's value, strings are unquoted
+    @param rec the record
+    @param name the field name
+    @param out where to put it, MAX_STR bytes
+    @return 1 if the field was found
+*/
+static int field_str(const char *rec, const char *name, char *out)
+{
+  const char *s = field(rec, name);
+  int i = 0;
+
+  out[0] = '\0';
+  if (NULL == s) {
+    return 0;
+  }
+  if ('"' == *s) {
+    for (s++; ('\0' != *s) && ('"' != *s) && (i < MAX_STR - 1); s++) {
+      if (('\\' == *s) && ('\0' != s[1])) {
+        s++;
+      }
+      out[i++] = *s;
+    }
+  } else {
+    for (; ('\0' != *s) && (',' != *s) && ('}' != *s) && (i < MAX_STR - 1); s++) {
+      out[i++] = *s;
+    }
+  }
+  out[i] = '\0';
+  return 1;
+}
+
+/*! @brief A numeric field's value, 0 if it's missing */
+static double field_num(const char *rec, const char *name)
+{
+  const char *s = field(rec, name);
+  return (NULL != s) ? strtod(s, NULL) : 0.0;
+}
+
+/*! @brief Read a results file
+    @return 0 on success
+*/
+static int load(RESULTS *r)
+{
+  char line[MAX_LINE];
+  char tmp[MAX_STR];
+  FILE *f = NULL;
+  POINT *p = NULL;
+  int max = 0;
+
+  f = fopen(r->name, "r");
+  if (NULL == f) {
+    fprintf(stderr, "Can't open %s\n", r->name);
+    return 1;
+  }
+  while (NULL != fgets(line, sizeof(line), f)) {
+    if (!field_str(line, "schema", tmp) || strncmp(tmp, "iccbench-", 9)) {
+      continue;
+    }
+    if (strcmp(tmp, "iccbench-1")) {
+      fprintf(stderr, "%s: unknown schema %s\n", r->name, tmp);
+      fclose(f);
+      return 1;
+    }
+    field_str(line, "type", tmp);
+    if (0 == strcmp(tmp, "meta")) {
+      if ('\0' == r->meta[0]) {
+        strcpy(r->meta, line);
+        field_str(line, "icc", r->icc);
+      }
+    } else if (0 == strcmp(tmp, "point")) {
+      if (r->n == max) {
+        max = (0 == max) ? 256 : max * 2;
+        p = (POINT *)realloc(r->p, max * sizeof(POINT));
+        if (NULL == p) {
+          fprintf(stderr, "Out of memory\n");
+          fclose(f);
+          return 1;
+        }
+        r->p = p;
+      }
+      p = &r->p[r->n++];
+      memset(p, 0, sizeof(POINT));
+      field_str(line, "tool", p->tool);
+      field_str(line, "key", p->key);
+      p->failed = (NULL != strstr(line, "\"failed\":true"));
+      p->n = field_num(line, "n");
+      p->mean = field_num(line, "mean_ns");
+      p->sd = field_num(line, "sd_ns");
+    }
+  }
+  fclose(f);
+  if (0 == r->n) {
+    fprintf(stderr, "%s: no iccbench points\n", r->name);
+    return 1;
+  }
+  return 0;
+}
+
+/*! @brief Find a point by tool and key */
+static POINT *find(RESULTS *r, const POINT *p)
+{
+  int i = 0;
+  for (i = 0; i < r->n; i++) {
+    if ((0 == strcmp(r->p[i].key, p->key)) && (0 == strcmp(r->p[i].tool, p->tool))) {
+      return &r->p[i];
+    }
+  }
+  return NULL;
+}
+
+/*! @brief The one sided critical value of Student's t
+    @param alpha the significance
+    @param df degrees of freedom
+    @return t such that P(T > t) = alpha
+    @note The normal quantile by bisection, then the Cornish-Fisher
+    expansion of t in it, good to a few % down to df = 3
+*/
+static double t_crit(double alpha, double df)
+{
+  double lo = 0.0, hi = 10.0, z = 0.0, z2 = 0.0;
+  int i = 0;
+
+  for (i = 0; i < 60; i++) {
+    z = (lo + hi) / 2.0;
+    if (0.5 * erfc(z / sqrt(2.0)) > alpha) {
+      lo = z;
+    } else {
+      hi = z;
+    }
+  }
+  if (df < 1.0) {
+    df = 1.0;
+  }
+  z2 = z * z;
+  return z + z * (z2 + 1.0) / (4.0 * df) + z * ((5.0 * z2 + 16.0) * z2 + 3.0) / (96.0 * df * df) +
+         z * (((3.0 * z2 + 19.0) * z2 + 17.0) * z2 - 15.0) / (384.0 * df * df * df);
+}
+
+/*! @brief Compare one point
+    @return -1 regressed, 1 improved, 0 neither
+*/
+static int compare(const POINT *b, const POINT *c, double pct, double alpha, double *tv)
+{
+  double vb = 0.0, vc = 0.0, se = 0.0, df = 0.0, change = 0.0;
+  int slower = 0;
+
+  *tv = 0.0;
+  if (b->mean <= 0.0) {
+    return 0;
+  }
+  change = (c->mean - b->mean) * 100.0 / b->mean;
+  slower = (change > 0.0);
+  if (fabs(change) <= pct) {
+    return 0;
+  }
+  if ((b->n < 2.0) || (c->n < 2.0)) {
+    return slower ? -1 : 1;
+  }
+  vb = b->sd * b->sd / b->n;
+  vc = c->sd * c->sd / c->n;
+  se = sqrt(vb + vc);
+  if (se <= 0.0) {
+    return slower ? -1 : 1;
+  }
+  *tv = (c->mean - b->mean) / se;
+  df = (vb + vc) * (vb + vc) /
+       ((vb * vb / (b->n - 1.0)) + (vc * vc / (c->n - 1.0)));
+  if (fabs(*tv) <= t_crit(alpha, df)) {
+    return 0;
+  }
+  return slower ? -1 : 1;
+}
+
+/*! @brief Warn about meta differences, other than the ICC version */
+static void compare_meta(const RESULTS *b, const RESULTS *c)
+{
+  char vb[MAX_STR], vc[MAX_STR];
+  int i = 0;
+
+  printf("baseline %s: ICC %s\n", b->name, ('\0' != b->icc[0]) ? b->icc : "unknown");
+  printf("current  %s: ICC %s\n", c->name, ('\0' != c->icc[0]) ? c->icc : "unknown");
+  if (('\0' == b->meta[0]) || ('\0' == c->meta[0])) {
+    printf("warning: no meta record, can't check the runs are like for like\n");
+    return;
+  }
+  for (i = 0; NULL != meta_fields[i]; i++) {
+    field_str(b->meta, meta_fields[i], vb);
+    field_str(c->meta, meta_fields[i], vc);
+    if (strcmp(vb, vc)) {
+      printf("warning: %s differs, baseline %s, current %s\n", meta_fields[i], vb, vc);
+    }
+  }
+}
+
+static void usage(const char *me)
+{
+  fprintf(stderr, "Usage: %s [-t percent] [-a alpha] [-q] baseline current\n", me);
+  fprintf(stderr, "       baseline, current: iccbench -j output\n");
+  fprintf(stderr, "       -t smallest change in the mean to flag, default 5 (%%)\n");
+  fprintf(stderr, "       -a one sided significance for Welch's t-test, default 0.01\n");
+  fprintf(stderr, "       -q only print regressions, improvements and problems\n");
+}
+
+int main(int argc, char *argv[])
+{
+  RESULTS base, cur;
+  POINT *b = NULL, *c = NULL;
+  const char *verdict = NULL;
+  double pct = 5.0;
+  double alpha = 0.01;
+  double tv = 0.0;
+  int quiet = 0;
+  int regressed = 0, improved = 0, missing = 0, added = 0;
+  int i = 1, v = 0;
+
+  memset(&base, 0, sizeof(base));
+  memset(&cur, 0, sizeof(cur));
+  for (; i < argc; i++) {
+    if ((0 == strcmp(argv[i], "-t")) && (i + 1 < argc)) {
+      pct = atof(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-a")) && (i + 1 < argc)) {
+      alpha = atof(argv[++i]);
+    } else if (0 == strcmp(argv[i], "-q")) {
+      quiet = 1;
+    } else if ((NULL == base.name) && ('-' != argv[i][0])) {
+      base.name = argv[i];
+    } else if ((NULL == cur.name) && ('-' != argv[i][0])) {
+      cur.name = argv[i];
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if ((NULL == cur.name) || (pct < 0.0) || (alpha <= 0.0) || (alpha >= 0.5)) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (load(&base) || load(&cur)) {
+    return 2;
+  }
+  compare_meta(&base, &cur);
+  printf("\n%-16s %-40s %12s %12s %8s %8s  %s\n", "tool", "key", "base ns", "cur ns",
+         "change", "t", "verdict");
+  for (i = 0; i < base.n; i++) {
+    b = &base.p[i];
+    c = find(&cur, b);
+    if (NULL == c) {
+      missing++;
+      if (!quiet) {
+        printf("%-16s %-40s %12.1f %12s %8s %8s  missing\n", b->tool, b->key, b->mean, "-", "-", "-");
+      }
+      continue;
+    }
+    c->seen = 1;
+    tv = 0.0;
+    if (b->failed || c->failed) {
+      v = (c->failed && !b->failed) ? -1 : 0;
+      verdict = (-1 == v) ? "FAILED" : c->failed ? "failed, as baseline" : "fixed";
+    } else {
+      v = compare(b, c, pct, alpha, &tv);
+      verdict = (-1 == v) ? "REGRESSED" : (1 == v) ? "improved" : "ok";
+    }
+    if (-1 == v) {
+      regressed++;
+    } else if (1 == v) {
+      improved++;
+    }
+    if (!quiet || (0 != v)) {
+      printf("%-16s %-40s %12.1f %12.1f %7.1f%% %8.1f  %s\n", b->tool, b->key, b->mean, c->mean,
+             (b->mean > 0.0) ? (c->mean - b->mean) * 100.0 / b->mean : 0.0, tv, verdict);
+    }
+  }
+  for (i = 0; i < cur.n; i++) {
+    if (!cur.p[i].seen) {
+      added++;
+      if (!quiet) {
+        printf("%-16s %-40s %12s %12.1f %8s %8s  new\n", cur.p[i].tool, cur.p[i].key, "-",
+               cur.p[i].mean, "-", "-");
+      }
+    }
+  }
+  printf("\n%d points, %d regressed, %d improved, %d missing, %d new (threshold %.1f%%, alpha %g)\n",
+         base.n, regressed, improved, missing, added, pct, alpha);
+  free(base.p);
+  free(cur.p);
+  return (regressed > 0) ? 1 : 0;
+}
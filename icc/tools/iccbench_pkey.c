@@ -0,0 +1,730 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Asymmetric and KDF latency/throughput benchmark.
+//
+// Times, from 1..N threads, through the ICC API
+//   RSA 2048/3072/4096  keygen (RSA_generate_key_ex), sign/verify
+//                       (RSA_sign/RSA_verify, SHA-256 PKCS#1),
+//                       encrypt/decrypt (OAEP)
+//   ECDSA, every NIST curve the library has: keygen, sign, verify
+//   ECDH, same curves: ECDH_compute_key
+//   DH, the RFC 7919 ffdhe2048/3072/4096 groups: keygen and derive
+//   PBKDF2-HMAC-SHA256 at each -i iteration count, 32 bytes out
+//   HKDF-SHA256 and SP800-108 SHA256-CTR, 32 bytes out
+// and reports ops/s, mean, p50/p90/p99 and max latency per test.
+//
+// Keygen latency is heavy tailed, prime search is a random walk and in
+// FIPS mode (the default here) every new key also has a pair-wise
+// consistency test, so look at p99 and max as well as the mean there.
+// -f off drops the pair-wise test. ICC_RSA_KEY_POOL hides RSA keygen
+// time behind a background thread, leave it unset to measure keygen.
+//
+// Keys for the sign/verify/encrypt/derive tests are generated once and
+// shared by the threads, keygen makes a new key every call.
+//
+// Latencies are bucketed as ICC_API_STATS does, so the percentiles are
+// within 25%, the mean and max are exact.
+//
+// -j writes the iccbench.h records rather than a table, with max_ns
+// added to each point, for iccbench_compare.
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "icc.h"
+#include "iccbench.h"
+#include "icctimer.h"
+
+#define MAX_THREADS 256
+#define MAX_ITERS 16
+
+enum {
+  T_RSA_KEYGEN, T_RSA_SIGN, T_RSA_VERIFY, T_RSA_ENC, T_RSA_DEC,
+  T_EC_KEYGEN, T_ECDSA_SIGN, T_ECDSA_VERIFY, T_ECDH,
+  T_DH_KEYGEN, T_DH_DERIVE,
+  T_PBKDF2, T_HKDF, T_KDF108
+};
+
+static const int rsa_bits[] = { 2048, 3072, 4096, 0 };
+
+/*! The FIPS 186-4 curves, any the library doesn't have are skipped */
+static const char *curves[] = {
+  "secp224r1", "prime256v1", "secp384r1", "secp521r1",
+  "sect233k1", "sect283k1", "sect409k1", "sect571k1",
+  "sect233r1", "sect283r1", "sect409r1", "sect571r1",
+  NULL
+};
+
+/*! RFC 7919 Appendix A, g = 2, q = (p-1)/2 */
+static const char ffdhe2048[] =
+  "FFFFFFFFFFFFFFFFADF85458A2BB4A9AAFDC5620273D3CF1D8B9C583CE2D3695"
+  "A9E13641146433FBCC939DCE249B3EF97D2FE363630C75D8F681B202AEC4617A"
+  "D3DF1ED5D5FD65612433F51F5F066ED0856365553DED1AF3B557135E7F57C935"
+  "984F0C70E0E68B77E2A689DAF3EFE8721DF158A136ADE73530ACCA4F483A797A"
+  "BC0AB182B324FB61D108A94BB2C8E3FBB96ADAB760D7F4681D4F42A3DE394DF4"
+  "AE56EDE76372BB190B07A7C8EE0A6D709E02FCE1CDF7E2ECC03404CD28342F61"
+  "9172FE9CE98583FF8E4F1232EEF28183C3FE3B1B4C6FAD733BB5FCBC2EC22005"
+  "C58EF1837D1683B2C6F34A26C1B2EFFA886B423861285C97FFFFFFFFFFFFFFFF";
+
+static const char ffdhe3072[] =
+  "FFFFFFFFFFFFFFFFADF85458A2BB4A9AAFDC5620273D3CF1D8B9C583CE2D3695"
+  "A9E13641146433FBCC939DCE249B3EF97D2FE363630C75D8F681B202AEC4617A"
+  "D3DF1ED5D5FD65612433F51F5F066ED0856365553DED1AF3B557135E7F57C935"
+  "984F0C70E0E68B77E2A689DAF3EFE8721DF158A136ADE73530ACCA4F483A797A"
+  "BC0AB182B324FB61D108A94BB2C8E3FBB96ADAB760D7F4681D4F42A3DE394DF4"
+  "AE56EDE76372BB190B07A7C8EE0A6D709E02FCE1CDF7E2ECC03404CD28342F61"
+  "9172FE9CE98583FF8E4F1232EEF28183C3FE3B1B4C6FAD733BB5FCBC2EC22005"
+  "C58EF1837D1683B2C6F34A26C1B2EFFA886B4238611FCFDCDE355B3B6519035B"
+  "BC34F4DEF99C023861B46FC9D6E6C9077AD91D2691F7F7EE598CB0FAC186D91C"
+  "AEFE130985139270B4130C93BC437944F4FD4452E2D74DD364F2E21E71F54BFF"
+  "5CAE82AB9C9DF69EE86D2BC522363A0DABC521979B0DEADA1DBF9A42D5C4484E"
+  "0ABCD06BFA53DDEF3C1B20EE3FD59D7C25E41D2B66C62E37FFFFFFFFFFFFFFFF";
+
+static const char ffdhe4096[] =
+  "FFFFFFFFFFFFFFFFADF85458A2BB4A9AAFDC5620273D3CF1D8B9C583CE2D3695"
+  "A9E13641146433FBCC939DCE249B3EF97D2FE363630C75D8F681B202AEC4617A"
+  "D3DF1ED5D5FD65612433F51F5F066ED0856365553DED1AF3B557135E7F57C935"
+  "984F0C70E0E68B77E2A689DAF3EFE8721DF158A136ADE73530ACCA4F483A797A"
+  "BC0AB182B324FB61D108A94BB2C8E3FBB96ADAB760D7F4681D4F42A3DE394DF4"
+  "AE56EDE76372BB190B07A7C8EE0A6D709E02FCE1CDF7E2ECC03404CD28342F61"
+  "9172FE9CE98583FF8E4F1232EEF28183C3FE3B1B4C6FAD733BB5FCBC2EC22005"
+  "C58EF1837D1683B2C6F34A26C1B2EFFA886B4238611FCFDCDE355B3B6519035B"
+  "BC34F4DEF99C023861B46FC9D6E6C9077AD91D2691F7F7EE598CB0FAC186D91C"
+  "AEFE130985139270B4130C93BC437944F4FD4452E2D74DD364F2E21E71F54BFF"
+  "5CAE82AB9C9DF69EE86D2BC522363A0DABC521979B0DEADA1DBF9A42D5C4484E"
+  "0ABCD06BFA53DDEF3C1B20EE3FD59D7C25E41D2B669E1EF16E6F52C3164DF4FB"
+  "7930E9E4E58857B6AC7D5F42D69F6D187763CF1D5503400487F55BA57E31CC7A"
+  "7135C886EFB4318AED6A1E012D9E6832A907600A918130C46DC778F971AD0038"
+  "092999A333CB8B7A1A1DB93D7140003C2A4ECEA9F98D0ACC0A8291CDCEC97DCF"
+  "8EC9B55A7F88A46B4DB5A851F44182E1C68A007E5E655F6AFFFFFFFFFFFFFFFF";
+
+static const struct {
+  const char *name;
+  const char *p;
+} groups[] = {
+  { "ffdhe2048", ffdhe2048 },
+  { "ffdhe3072", ffdhe3072 },
+  { "ffdhe4096", ffdhe4096 },
+  { NULL, NULL }
+};
+
+static unsigned char dgst[32] = "0123456789abcdef0123456789abcdef";
+static unsigned char salt[16] = "saltsaltsaltsalt";
+static const char pass[] = "passwordpassword";
+
+/*! @brief The keys and settings for one group of tests, shared by the threads */
+typedef struct {
+  ICC_CTX *ctx;
+  const char *name;          /*!< For the report, e.g. RSA-2048 */
+  int bits;                  /*!< RSA */
+  int nid;                   /*!< EC curve, RSA_sign digest */
+  ICC_RSA *rsa;
+  ICC_BIGNUM *e;
+  unsigned char sig[1024];   /*!< A signature to verify */
+  unsigned int siglen;
+  unsigned char ct[512];     /*!< A ciphertext to decrypt */
+  int ctlen;
+  ICC_EC_KEY *ec;
+  ICC_EC_KEY *ecpeer;
+  ICC_DH *dh;
+  ICC_DH *dhpeer;
+  unsigned char p[512];      /*!< DH group */
+  unsigned char q[512];
+  int plen;
+  const ICC_EVP_MD *md;
+  const ICC_KDF *kdf;
+  int iters;                 /*!< PBKDF2 */
+} KEYS;
+
+/*! @brief One thread's share of a test */
+typedef struct {
+  KEYS *k;
+  int test;
+  volatile int ready;        /*!< Set up and waiting for go */
+  int failed;
+  unsigned long long ops;
+  unsigned long long total;  /*!< ns */
+  double total2;             /*!< Sum of the squares */
+  unsigned long long max;
+  unsigned long long hist[ICC_API_BUCKETS];
+#if defined(_WIN32)
+  HANDLE thr;
+#else
+  pthread_t thr;
+#endif
+} WORK;
+
+static volatile int go = 0;   /*!< Start counting */
+static volatile int stop = 0; /*!< Stop counting */
+
+static void sleep_ms(int ms)
+{
+#if defined(_WIN32)
+  Sleep(ms);
+#else
+  usleep(ms * 1000);
+#endif
+}
+
+/*! @brief Latency bucket, the inverse of ICC_API_BUCKET_NS() */
+static int bucket(unsigned long long ns)
+{
+  int b = ICC_API_BUCKETS - 1;
+  while ((b > 0) && (ICC_API_BUCKET_NS(b) > ns)) {
+    b--;
+  }
+  return b;
+}
+
+/*! @brief Hex to binary
+    @return the length, 0 if it won't fit
+*/
+static int unhex(const char *hex, unsigned char *out, int max)
+{
+  int n = (int)strlen(hex) / 2;
+  int i = 0, v = 0;
+
+  if (n > max) {
+    return 0;
+  }
+  for (i = 0; i < n; i++) {
+    sscanf(hex + 2 * i, "%2x", &v);
+    out[i] = (unsigned char)v;
+  }
+  return n;
+}
+
+/*! @brief A DH key with the group in k
+    @return the key, NULL on failure
+*/
+static ICC_DH *dh_new(KEYS *k)
+{
+  ICC_CTX *ctx = k->ctx;
+  ICC_DH *dh = ICC_DH_new(ctx);
+  ICC_BIGNUM *p = ICC_BN_bin2bn(ctx, k->p, k->plen, NULL);
+  ICC_BIGNUM *q = ICC_BN_bin2bn(ctx, k->q, k->plen, NULL);
+  ICC_BIGNUM *g = ICC_BN_new(ctx);
+
+  if ((NULL != dh) && (NULL != p) && (NULL != q) && (NULL != g) &&
+      (1 == ICC_BN_set_word(ctx, g, 2)) && (1 == ICC_DH_set0_pqg(ctx, dh, p, q, g))) {
+    return dh;
+  }
+  if (NULL != p) {
+    ICC_BN_clear_free(ctx, p);
+  }
+  if (NULL != q) {
+    ICC_BN_clear_free(ctx, q);
+  }
+  if (NULL != g) {
+    ICC_BN_clear_free(ctx, g);
+  }
+  if (NULL != dh) {
+    ICC_DH_free(ctx, dh);
+  }
+  return NULL;
+}
+
+/*! @brief Benchmark thread
+    @param arg the WORK
+*/
+#if defined(_WIN32)
+static DWORD WINAPI worker(void *arg)
+#else
+static void *worker(void *arg)
+#endif
+{
+  WORK *w = (WORK *)arg;
+  KEYS *k = w->k;
+  ICC_CTX *ctx = k->ctx;
+  ICC_RSA *rsa = NULL;
+  ICC_EC_KEY *ec = NULL;
+  ICC_DH *dh = NULL;
+  unsigned char out[1024];
+  unsigned int olen = 0;
+  unsigned long long t0 = 0, ns = 0;
+  int ok = 1;
+
+  if (T_EC_KEYGEN == w->test) {
+    ec = ICC_EC_KEY_new_by_curve_name(ctx, k->nid);
+    w->failed = (NULL == ec);
+  }
+  w->ready = 1;
+  while (!go) {
+    sleep_ms(1);
+  }
+  /* At least one call each, keygen can outlast the time per test */
+  while (!w->failed) {
+    /* Fresh keys are made outside the timing */
+    if (T_RSA_KEYGEN == w->test) {
+      rsa = ICC_RSA_new(ctx);
+    } else if (T_DH_KEYGEN == w->test) {
+      dh = dh_new(k);
+    }
+    olen = sizeof(out);
+    t0 = now_ns();
+    switch (w->test) {
+    case T_RSA_KEYGEN:
+      ok = (NULL != rsa) && (1 == ICC_RSA_generate_key_ex(ctx, rsa, k->bits, k->e, NULL));
+      break;
+    case T_RSA_SIGN:
+      ok = (1 == ICC_RSA_sign(ctx, k->nid, dgst, 32, out, &olen, k->rsa));
+      break;
+    case T_RSA_VERIFY:
+      ok = (1 == ICC_RSA_verify(ctx, k->nid, dgst, 32, k->sig, k->siglen, k->rsa));
+      break;
+    case T_RSA_ENC:
+      ok = (0 < ICC_RSA_public_encrypt(ctx, 32, dgst, out, k->rsa, ICC_RSA_PKCS1_OAEP_PADDING));
+      break;
+    case T_RSA_DEC:
+      ok = (32 == ICC_RSA_private_decrypt(ctx, k->ctlen, k->ct, out, k->rsa, ICC_RSA_PKCS1_OAEP_PADDING));
+      break;
+    case T_EC_KEYGEN:
+      ok = (1 == ICC_EC_KEY_generate_key(ctx, ec));
+      break;
+    case T_ECDSA_SIGN:
+      ok = (1 == ICC_ECDSA_sign(ctx, 0, dgst, 32, out, &olen, k->ec));
+      break;
+    case T_ECDSA_VERIFY:
+      ok = (1 == ICC_ECDSA_verify(ctx, 0, dgst, 32, k->sig, k->siglen, k->ec));
+      break;
+    case T_ECDH:
+      ok = (0 < ICC_ECDH_compute_key(ctx, out, 66, ICC_EC_KEY_get0_public_key(ctx, k->ecpeer), k->ec, NULL));
+      break;
+    case T_DH_KEYGEN:
+      ok = (NULL != dh) && (1 == ICC_DH_generate_key(ctx, dh));
+      break;
+    case T_DH_DERIVE:
+      ok = (0 < ICC_DH_compute_key(ctx, out, (ICC_BIGNUM *)ICC_DH_get_PublicKey(ctx, k->dhpeer), k->dh));
+      break;
+    case T_PBKDF2:
+      ok = (1 == ICC_PKCS5_PBKDF2_HMAC(ctx, pass, sizeof(pass) - 1, salt, sizeof(salt), k->iters, k->md, 32, out));
+      break;
+    case T_HKDF:
+      ok = (NULL != ICC_HKDF(ctx, k->md, salt, sizeof(salt), dgst, 32, (unsigned char *)pass, 8, out, 32));
+      break;
+    default:
+      ok = (1 == ICC_SP800_108_KDF(ctx, k->kdf, dgst, 32, salt, sizeof(salt), (unsigned char *)pass, 8, out, 32));
+      break;
+    }
+    ns = now_ns() - t0;
+    if (NULL != rsa) {
+      ICC_RSA_free(ctx, rsa);
+      rsa = NULL;
+    }
+    if (NULL != dh) {
+      ICC_DH_free(ctx, dh);
+      dh = NULL;
+    }
+    w->failed = !ok;
+    w->ops++;
+    w->total += ns;
+    w->total2 += (double)ns * (double)ns;
+    if (ns > w->max) {
+      w->max = ns;
+    }
+    w->hist[bucket(ns)]++;
+    if (stop) {
+      break;
+    }
+  }
+  if (NULL != ec) {
+    ICC_EC_KEY_free(ctx, ec);
+  }
+  return 0;
+}
+
+/*! @brief The latency below which a fraction of the calls completed */
+static unsigned long long pctile(const unsigned long long *hist, unsigned long long n, double p)
+{
+  unsigned long long c = 0;
+  int b = 0;
+  for (b = 0; b < ICC_API_BUCKETS; b++) {
+    c += hist[b];
+    if ((double)c >= p * (double)n) {
+      break;
+    }
+  }
+  return ICC_API_BUCKET_NS((b < ICC_API_BUCKETS) ? b : ICC_API_BUCKETS - 1);
+}
+
+static int json = 0; /*!< -j, iccbench.h records rather than a table */
+
+/*! @brief Run and report one test at one thread count
+    @param op the operation, for the report
+    @return 0 on success
+*/
+static int run_point(KEYS *k, int test, const char *op, int nthr, int ms)
+{
+  static WORK w[MAX_THREADS];
+  unsigned long long hist[ICC_API_BUCKETS];
+  unsigned long long pct[4];
+  unsigned long long ops = 0, total = 0, max = 0, t0 = 0, t1 = 0;
+  double secs = 0.0, total2 = 0.0;
+  char key[128], extra[64];
+  int i = 0, b = 0, failed = 0;
+
+  memset(hist, 0, sizeof(hist));
+  go = stop = 0;
+  for (i = 0; i < nthr; i++) {
+    memset(&w[i], 0, sizeof(WORK));
+    w[i].k = k;
+    w[i].test = test;
+#if defined(_WIN32)
+    w[i].thr = CreateThread(NULL, 0, worker, &w[i], 0, NULL);
+    if (NULL == w[i].thr) {
+#else
+    if (0 != pthread_create(&w[i].thr, NULL, worker, &w[i])) {
+#endif
+      fprintf(stderr, "Can't create thread %d\n", i);
+      exit(1);
+    }
+  }
+  for (i = 0; i < nthr; i++) {
+    while (!w[i].ready) {
+      sleep_ms(1);
+    }
+  }
+  t0 = now_ns();
+  go = 1;
+  sleep_ms(ms);
+  stop = 1;
+  for (i = 0; i < nthr; i++) {
+#if defined(_WIN32)
+    WaitForSingleObject(w[i].thr, INFINITE);
+    CloseHandle(w[i].thr);
+#else
+    pthread_join(w[i].thr, NULL);
+#endif
+  }
+  t1 = now_ns();
+  for (i = 0; i < nthr; i++) {
+    ops += w[i].ops;
+    total += w[i].total;
+    total2 += w[i].total2;
+    failed |= w[i].failed;
+    if (w[i].max > max) {
+      max = w[i].max;
+    }
+    for (b = 0; b < ICC_API_BUCKETS; b++) {
+      hist[b] += w[i].hist[b];
+    }
+  }
+  secs = (double)(t1 - t0) / 1.0e9;
+  if (json) {
+    sprintf(key, "%.64s/%s/t%d", k->name, op, nthr);
+    sprintf(extra, "\"max_ns\":%llu", max);
+    pct[0] = pctile(hist, ops, 0.5);
+    pct[1] = pctile(hist, ops, 0.9);
+    pct[2] = pctile(hist, ops, 0.99);
+    pct[3] = pctile(hist, ops, 0.999);
+    iccbench_point(stdout, "iccbench_pkey", key, failed ? 0 : ops, (double)total, total2, pct,
+                   (double)ops / secs, -1.0, extra);
+    return (failed || (0 == ops)) ? 1 : 0;
+  }
+  if (failed || (0 == ops)) {
+    printf("%-22s %-8s %3d  failed\n", k->name, op, nthr);
+    return 1;
+  }
+  printf("%-22s %-8s %3d %8llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", k->name, op, nthr,
+         ops, (double)ops / secs, (double)total / ops / 1000.0, pctile(hist, ops, 0.5) / 1000.0,
+         pctile(hist, ops, 0.9) / 1000.0, pctile(hist, ops, 0.99) / 1000.0, max / 1000.0);
+  fflush(stdout);
+  return 0;
+}
+
+/*! @brief Run one test over the thread counts */
+static int sweep(KEYS *k, int test, const char *op, int maxthr, int ms)
+{
+  int rv = 0;
+  int t = 0;
+
+  for (t = 1; 0 == rv; t *= 2) {
+    if (t > maxthr) {
+      t = maxthr;
+    }
+    rv = run_point(k, test, op, t, ms);
+    if (t == maxthr) {
+      break;
+    }
+  }
+  return rv;
+}
+
+/*! @brief RSA tests at one key size */
+static int rsa_tests(KEYS *k, int maxthr, int ms)
+{
+  ICC_CTX *ctx = k->ctx;
+  char name[32];
+  int rv = 0;
+
+  sprintf(name, "RSA-%d", k->bits);
+  k->name = name;
+  k->nid = ICC_OBJ_txt2nid(ctx, (char *)"SHA256");
+  k->e = ICC_BN_new(ctx);
+  k->rsa = ICC_RSA_new(ctx);
+  k->siglen = sizeof(k->sig);
+  if ((NULL == k->e) || (NULL == k->rsa) || (1 != ICC_BN_set_word(ctx, k->e, 0x10001)) ||
+      (1 != ICC_RSA_generate_key_ex(ctx, k->rsa, k->bits, k->e, NULL)) ||
+      (1 != ICC_RSA_sign(ctx, k->nid, dgst, 32, k->sig, &k->siglen, k->rsa)) ||
+      (0 >= (k->ctlen = ICC_RSA_public_encrypt(ctx, 32, dgst, k->ct, k->rsa, ICC_RSA_PKCS1_OAEP_PADDING)))) {
+    fprintf(json ? stderr : stdout, "%-22s setup failed\n", name);
+    rv = 1;
+  } else {
+    rv |= sweep(k, T_RSA_KEYGEN, "keygen", maxthr, ms);
+    rv |= sweep(k, T_RSA_SIGN, "sign", maxthr, ms);
+    rv |= sweep(k, T_RSA_VERIFY, "verify", maxthr, ms);
+    rv |= sweep(k, T_RSA_ENC, "encrypt", maxthr, ms);
+    rv |= sweep(k, T_RSA_DEC, "decrypt", maxthr, ms);
+  }
+  if (NULL != k->rsa) {
+    ICC_RSA_free(ctx, k->rsa);
+  }
+  if (NULL != k->e) {
+    ICC_BN_clear_free(ctx, k->e);
+  }
+  return rv;
+}
+
+/*! @brief ECDSA and ECDH tests on one curve */
+static int ec_tests(KEYS *k, const char *curve, int maxthr, int ms)
+{
+  ICC_CTX *ctx = k->ctx;
+  char name[32];
+  int rv = 0;
+
+  k->nid = ICC_OBJ_txt2nid(ctx, (char *)curve);
+  if ((0 == k->nid) || (NULL == (k->ec = ICC_EC_KEY_new_by_curve_name(ctx, k->nid)))) {
+    fprintf(json ? stderr : stdout, "%-22s not available\n", curve);
+    return 0;
+  }
+  k->ecpeer = ICC_EC_KEY_new_by_curve_name(ctx, k->nid);
+  k->siglen = sizeof(k->sig);
+  if ((NULL == k->ecpeer) || (1 != ICC_EC_KEY_generate_key(ctx, k->ec)) ||
+      (1 != ICC_EC_KEY_generate_key(ctx, k->ecpeer)) ||
+      (1 != ICC_ECDSA_sign(ctx, 0, dgst, 32, k->sig, &k->siglen, k->ec))) {
+    fprintf(json ? stderr : stdout, "%-22s setup failed\n", curve);
+    rv = 1;
+  } else {
+    sprintf(name, "ECDSA-%s", curve);
+    k->name = name;
+    rv |= sweep(k, T_EC_KEYGEN, "keygen", maxthr, ms);
+    rv |= sweep(k, T_ECDSA_SIGN, "sign", maxthr, ms);
+    rv |= sweep(k, T_ECDSA_VERIFY, "verify", maxthr, ms);
+    sprintf(name, "ECDH-%s", curve);
+    rv |= sweep(k, T_ECDH, "derive", maxthr, ms);
+  }
+  ICC_EC_KEY_free(ctx, k->ec);
+  if (NULL != k->ecpeer) {
+    ICC_EC_KEY_free(ctx, k->ecpeer);
+  }
+  return rv;
+}
+
+/*! @brief DH tests in one group */
+static int dh_tests(KEYS *k, int g, int maxthr, int ms)
+{
+  ICC_CTX *ctx = k->ctx;
+  char name[32];
+  int rv = 0;
+  int i = 0, c = 0;
+
+  sprintf(name, "DH-%s", groups[g].name);
+  k->name = name;
+  k->plen = unhex(groups[g].p, k->p, sizeof(k->p));
+  /* q = (p-1)/2 */
+  for (i = 0; i < k->plen; i++) {
+    k->q[i] = (unsigned char)((k->p[i] >> 1) | c);
+    c = (k->p[i] & 1) << 7;
+  }
+  k->dh = dh_new(k);
+  k->dhpeer = dh_new(k);
+  if ((NULL == k->dh) || (NULL == k->dhpeer) || (1 != ICC_DH_generate_key(ctx, k->dh)) ||
+      (1 != ICC_DH_generate_key(ctx, k->dhpeer))) {
+    fprintf(json ? stderr : stdout, "%-22s setup failed\n", name);
+    rv = 1;
+  } else {
+    rv |= sweep(k, T_DH_KEYGEN, "keygen", maxthr, ms);
+    rv |= sweep(k, T_DH_DERIVE, "derive", maxthr, ms);
+  }
+  if (NULL != k->dh) {
+    ICC_DH_free(ctx, k->dh);
+  }
+  if (NULL != k->dhpeer) {
+    ICC_DH_free(ctx, k->dhpeer);
+  }
+  return rv;
+}
+
+/*! @brief PBKDF2, HKDF and SP800-108 */
+static int kdf_tests(KEYS *k, const int *iters, int niters, int maxthr, int ms)
+{
+  ICC_CTX *ctx = k->ctx;
+  char name[32];
+  int rv = 0;
+  int i = 0;
+
+  k->md = ICC_EVP_get_digestbyname(ctx, "SHA256");
+  if (NULL == k->md) {
+    fprintf(json ? stderr : stdout, "%-22s not available\n", "SHA256");
+    return 1;
+  }
+  k->name = name;
+  for (i = 0; i < niters; i++) {
+    sprintf(name, "PBKDF2-SHA256-%d", iters[i]);
+    k->iters = iters[i];
+    rv |= sweep(k, T_PBKDF2, "derive", maxthr, ms);
+  }
+  strcpy(name, "HKDF-SHA256");
+  rv |= sweep(k, T_HKDF, "derive", maxthr, ms);
+  strcpy(name, "SP800-108-SHA256-CTR");
+  k->kdf = ICC_SP800_108_get_KDFbyname(ctx, (char *)"SHA256-CTR");
+  if (NULL == k->kdf) {
+    fprintf(json ? stderr : stdout, "%-22s not available\n", name);
+  } else {
+    rv |= sweep(k, T_KDF108, "derive", maxthr, ms);
+  }
+  return rv;
+}
+
+static void usage(const char *me)
+{
+#if !defined(ICCPKG)
+  fprintf(stderr, "Usage: %s pathToICC [-t threads] [-d ms] [-f on|off] [-a RSA|EC|DH|KDF] [-i iterations] [-j]\n", me);
+  fprintf(stderr, "       pathToICC is the path to the ICC libraries passed to ICC_Init()\n");
+#else
+  fprintf(stderr, "Usage: %s [-t threads] [-d ms] [-f on|off] [-a RSA|EC|DH|KDF] [-i iterations] [-j]\n", me);
+#endif
+  fprintf(stderr, "       -t most threads, default 1, the sweep doubles from 1\n");
+  fprintf(stderr, "       -d time per test in ms, default 1000, each thread makes at least one call\n");
+  fprintf(stderr, "       -f FIPS mode, default on\n");
+  fprintf(stderr, "       -a tests to run, may be repeated, default all\n");
+  fprintf(stderr, "       -i PBKDF2 iteration count, may be repeated, default 1000 10000 100000\n");
+  fprintf(stderr, "       -j write iccbench.h JSON records to stdout rather than a table\n");
+}
+
+int main(int argc, char *argv[])
+{
+  ICC_STATUS stat, *status = &stat;
+  ICC_CTX *ctx = NULL;
+  KEYS keys;
+  const char *path = NULL;
+  const char *fips = "on";
+  char buf[256];
+  int iters[MAX_ITERS];
+  int niters = 0;
+  int tests = 0;
+  int maxthr = 1;
+  int ms = 1000;
+  int i = 1, rv = 0;
+
+#if !defined(ICCPKG)
+  if (argc < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  path = argv[i++];
+#endif
+  for (; i < argc; i++) {
+    if ((0 == strcmp(argv[i], "-t")) && (i + 1 < argc)) {
+      maxthr = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-d")) && (i + 1 < argc)) {
+      ms = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-f")) && (i + 1 < argc)) {
+      fips = argv[++i];
+    } else if ((0 == strcmp(argv[i], "-a")) && (i + 1 < argc)) {
+      i++;
+      tests |= (0 == strcmp(argv[i], "RSA")) ? 1 : (0 == strcmp(argv[i], "EC")) ? 2 :
+               (0 == strcmp(argv[i], "DH")) ? 4 : (0 == strcmp(argv[i], "KDF")) ? 8 : 0;
+    } else if ((0 == strcmp(argv[i], "-i")) && (i + 1 < argc) && (niters < MAX_ITERS)) {
+      iters[niters++] = atoi(argv[++i]);
+    } else if (0 == strcmp(argv[i], "-j")) {
+      json = 1;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((maxthr < 1) || (maxthr > MAX_THREADS) || (ms < 1) ||
+      (strcmp(fips, "on") && strcmp(fips, "off"))) {
+    usage(argv[0]);
+    return 1;
+  }
+  for (i = 0; i < niters; i++) {
+    if (iters[i] < 1) {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (0 == tests) {
+    tests = 1 | 2 | 4 | 8;
+  }
+  if (0 == niters) {
+    iters[niters++] = 1000;
+    iters[niters++] = 10000;
+    iters[niters++] = 100000;
+  }
+
+  memset(status, 0, sizeof(ICC_STATUS));
+  ctx = ICC_Init(status, path);
+  if (NULL == ctx) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    return 1;
+  }
+  ICC_SetValue(ctx, status, ICC_FIPS_APPROVED_MODE, fips);
+  if (ICC_ERROR == ICC_Attach(ctx, status)) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    ICC_Cleanup(ctx, status);
+    return 1;
+  }
+
+  if (json) {
+    iccbench_meta(stdout, ctx, "iccbench_pkey");
+  } else {
+    memset(buf, 0, sizeof(buf));
+    ICC_GetValue(ctx, status, ICC_VERSION, buf, sizeof(buf) - 1);
+    printf("ICC %s, FIPS %s, ICC_RSA_KEY_POOL %s\n\n", buf, fips,
+           (NULL != getenv("ICC_RSA_KEY_POOL")) ? getenv("ICC_RSA_KEY_POOL") : "unset");
+    printf("%-22s %-8s %3s %8s %10s %10s %10s %10s %10s %10s\n", "test", "op", "thr", "calls",
+           "ops/s", "mean us", "p50 us", "p90 us", "p99 us", "max us");
+  }
+  memset(&keys, 0, sizeof(keys));
+  keys.ctx = ctx;
+  if (tests & 1) {
+    for (i = 0; 0 != rsa_bits[i]; i++) {
+      keys.bits = rsa_bits[i];
+      rv |= rsa_tests(&keys, maxthr, ms);
+    }
+  }
+  if (tests & 2) {
+    for (i = 0; NULL != curves[i]; i++) {
+      rv |= ec_tests(&keys, curves[i], maxthr, ms);
+    }
+  }
+  if (tests & 4) {
+    for (i = 0; NULL != groups[i].name; i++) {
+      rv |= dh_tests(&keys, i, maxthr, ms);
+    }
+  }
+  if (tests & 8) {
+    rv |= kdf_tests(&keys, iters, niters, maxthr, ms);
+  }
+  ICC_Cleanup(ctx, status);
+  return rv;
+}
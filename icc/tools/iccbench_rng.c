@@ -0,0 +1,462 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: RNG throughput and contention benchmark.
+//
+// Drives ICC_RAND_bytes(), ICC_GenerateRandomSeed() and ICC_RNG_Generate()
+// (one context per thread, per DRBG mode) from 1..N threads over a sweep
+// of request sizes, 8 bytes to 1MB, and reports ops/s, MB/s and latency
+// percentiles for each point. At the end the pool slot lock waits from
+// ICC_RNG_STATS are printed, those are what to look at when sizing
+// ICC_RNG_INSTANCES.
+//
+// The pool size and seed source are fixed at ICC_Init(), so compare
+// settings by running once per setting, e.g.
+//
+//   for n in 1 7 auto; do for t in TRNG_OS TRNG_HW TRNG_FIPS; do
+//     ICC_RNG_INSTANCES=$n ICC_TRNG=$t ./iccbench_rng ../package -a RAND
+//   done; done
+//
+// Latencies are bucketed as ICC_API_STATS does, so the percentiles are
+// within 25%, and include the timing overhead, a few ns.
+//
+// -j writes the iccbench.h records rather than a table, for
+// iccbench_compare.
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "icc.h"
+#include "iccbench.h"
+#include "icctimer.h"
+
+/*! DRBG modes, as GenRndData2's alglist less the TRNG's and test taps */
+static const char *alglist[] = {
+  "DSS_3_1_SHA","DSS_3_2_SHA","DSS_3_1_SHArev","DSS_3_2_SHArev",
+  "DSS_3_1_SHAgp","DSS_3_1_SHArevgp",
+  "AES-128-ECB","AES-192-ECB","AES-256-ECB",
+  "AES-128-ECB-NODF","AES-192-ECB-NODF","AES-256-ECB-NODF",
+  "SHA1","SHA224","SHA256","SHA384","SHA512",
+  "HMAC-SHA1","HMAC-SHA224","HMAC-SHA256","HMAC-SHA384","HMAC-SHA512",
+  NULL
+};
+
+#define MAX_THREADS 256
+#define DEF_THREADS 8
+#define MAX_REQ (1024 * 1024) /*!< Largest request in the sweep */
+#define MIN_REQ 8             /*!< Smallest, each step is x8 */
+
+enum { API_RAND = 1, API_SEED = 2, API_DRBG = 4 };
+
+/*! @brief One thread's share of a test point */
+typedef struct {
+  ICC_CTX *ctx;
+  int api;
+  const char *mode;            /*!< DRBG mode for API_DRBG */
+  int size;                    /*!< Request size */
+  unsigned char *buf;
+  volatile int ready;          /*!< Set up and waiting for go */
+  int failed;
+  unsigned long long ops;
+  double sum;                  /*!< Sum of the call times in ns */
+  double sum2;                 /*!< and of their squares */
+  unsigned long long hist[ICC_API_BUCKETS];
+#if defined(_WIN32)
+  HANDLE thr;
+#else
+  pthread_t thr;
+#endif
+} WORK;
+
+static volatile int go = 0;   /*!< Start counting */
+static volatile int stop = 0; /*!< Stop counting */
+
+static void sleep_ms(int ms)
+{
+#if defined(_WIN32)
+  Sleep(ms);
+#else
+  usleep(ms * 1000);
+#endif
+}
+
+/*! @brief Latency bucket, the inverse of ICC_API_BUCKET_NS() */
+static int bucket(unsigned long long ns)
+{
+  int b = ICC_API_BUCKETS - 1;
+  while ((b > 0) && (ICC_API_BUCKET_NS(b) > ns)) {
+    b--;
+  }
+  return b;
+}
+
+/*! @brief Benchmark thread
+    @param arg the WORK
+*/
+#if defined(_WIN32)
+static DWORD WINAPI worker(void *arg)
+#else
+static void *worker(void *arg)
+#endif
+{
+  WORK *w = (WORK *)arg;
+  ICC_STATUS status;
+  ICC_PRNG_CTX *rctx = NULL;
+  ICC_PRNG *rng = NULL;
+  unsigned long long t0 = 0, t1 = 0;
+
+  memset(&status, 0, sizeof(status));
+  if (API_DRBG == w->api) {
+    rng = ICC_get_RNGbyname(w->ctx, w->mode);
+    rctx = ICC_RNG_CTX_new(w->ctx);
+    if ((NULL == rng) || (NULL == rctx) ||
+        (SP800_90RUN != ICC_RNG_CTX_Init(w->ctx, rctx, rng, NULL, 0, 0, 0))) {
+      w->failed = 1;
+    }
+  }
+  w->ready = 1;
+  while (!go) {
+    sleep_ms(1);
+  }
+  while (!stop && !w->failed) {
+    t0 = now_ns();
+    switch (w->api) {
+    case API_RAND:
+      if (1 != ICC_RAND_bytes(w->ctx, w->buf, w->size)) {
+        w->failed = 1;
+      }
+      break;
+    case API_SEED:
+      ICC_GenerateRandomSeed(w->ctx, &status, w->size, w->buf);
+      if (ICC_OK != status.majRC) {
+        w->failed = 1;
+      }
+      break;
+    default:
+      switch (ICC_RNG_Generate(w->ctx, rctx, w->buf, w->size, NULL, 0)) {
+      case SP800_90RUN:
+      case SP800_90RESEED:
+        break;
+      default:
+        w->failed = 1;
+        break;
+      }
+      break;
+    }
+    t1 = now_ns();
+    w->ops++;
+    w->sum += (double)(t1 - t0);
+    w->sum2 += (double)(t1 - t0) * (double)(t1 - t0);
+    w->hist[bucket(t1 - t0)]++;
+  }
+  if (NULL != rctx) {
+    ICC_RNG_CTX_free(w->ctx, rctx);
+  }
+  return 0;
+}
+
+/*! @brief The latency below which a fraction of the calls completed */
+static unsigned long long pctile(const unsigned long long *hist, unsigned long long n, double p)
+{
+  unsigned long long c = 0;
+  int b = 0;
+  for (b = 0; b < ICC_API_BUCKETS; b++) {
+    c += hist[b];
+    if ((double)c >= p * (double)n) {
+      break;
+    }
+  }
+  return ICC_API_BUCKET_NS((b < ICC_API_BUCKETS) ? b : ICC_API_BUCKETS - 1);
+}
+
+static int json = 0; /*!< -j, iccbench.h records rather than a table */
+
+/*! @brief Run and report one test point
+    @return 0 on success
+*/
+static int run_point(ICC_CTX *ctx, int api, const char *mode, int nthr, int size, int ms)
+{
+  static WORK w[MAX_THREADS];
+  unsigned long long hist[ICC_API_BUCKETS];
+  unsigned long long pct[4];
+  unsigned long long ops = 0, t0 = 0, t1 = 0;
+  double secs = 0.0, sum = 0.0, sum2 = 0.0;
+  const char *name = (API_RAND == api) ? "RAND" : (API_SEED == api) ? "SEED" : "DRBG";
+  char key[128];
+  int i = 0, b = 0, failed = 0;
+
+  memset(hist, 0, sizeof(hist));
+  go = stop = 0;
+  for (i = 0; i < nthr; i++) {
+    memset(&w[i], 0, sizeof(WORK));
+    w[i].ctx = ctx;
+    w[i].api = api;
+    w[i].mode = mode;
+    w[i].size = size;
+    w[i].buf = (unsigned char *)malloc(size);
+    if (NULL == w[i].buf) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+#if defined(_WIN32)
+    w[i].thr = CreateThread(NULL, 0, worker, &w[i], 0, NULL);
+    if (NULL == w[i].thr) {
+#else
+    if (0 != pthread_create(&w[i].thr, NULL, worker, &w[i])) {
+#endif
+      fprintf(stderr, "Can't create thread %d\n", i);
+      exit(1);
+    }
+  }
+  for (i = 0; i < nthr; i++) {
+    while (!w[i].ready) {
+      sleep_ms(1);
+    }
+  }
+  t0 = now_ns();
+  go = 1;
+  sleep_ms(ms);
+  stop = 1;
+  for (i = 0; i < nthr; i++) {
+#if defined(_WIN32)
+    WaitForSingleObject(w[i].thr, INFINITE);
+    CloseHandle(w[i].thr);
+#else
+    pthread_join(w[i].thr, NULL);
+#endif
+  }
+  t1 = now_ns();
+  for (i = 0; i < nthr; i++) {
+    ops += w[i].ops;
+    sum += w[i].sum;
+    sum2 += w[i].sum2;
+    failed |= w[i].failed;
+    for (b = 0; b < ICC_API_BUCKETS; b++) {
+      hist[b] += w[i].hist[b];
+    }
+    free(w[i].buf);
+  }
+  secs = (double)(t1 - t0) / 1.0e9;
+  if (json) {
+    sprintf(key, "%s/%.40s/t%d/b%d", name, (NULL != mode) ? mode : "-", nthr, size);
+    pct[0] = pctile(hist, ops, 0.5);
+    pct[1] = pctile(hist, ops, 0.9);
+    pct[2] = pctile(hist, ops, 0.99);
+    pct[3] = pctile(hist, ops, 0.999);
+    iccbench_point(stdout, "iccbench_rng", key, failed ? 0 : ops, sum, sum2, pct,
+                   (double)ops / secs, (double)ops * size / secs / 1.0e6, NULL);
+    return failed;
+  }
+  if (failed) {
+    printf("%-6s %-17s %3d %8d  failed\n", name, (NULL != mode) ? mode : "-", nthr, size);
+    return 1;
+  }
+  printf("%-6s %-17s %3d %8d %12.0f %10.2f %10llu %10llu %10llu %10llu\n",
+         name, (NULL != mode) ? mode : "-", nthr, size, (double)ops / secs,
+         (double)ops * size / secs / 1.0e6, pctile(hist, ops, 0.5),
+         pctile(hist, ops, 0.9), pctile(hist, ops, 0.99), pctile(hist, ops, 0.999));
+  fflush(stdout);
+  return 0;
+}
+
+/*! @brief Sweep threads and request sizes for one API/mode */
+static int sweep(ICC_CTX *ctx, int api, const char *mode, int maxthr, int maxreq, int ms)
+{
+  int rv = 0;
+  int t = 0, s = 0;
+
+  if ((API_DRBG == api) && (NULL == ICC_get_RNGbyname(ctx, mode))) {
+    if (!json) {
+      printf("%-6s %-17s not available\n", "DRBG", mode);
+    }
+    return 0;
+  }
+  for (t = 1; 0 == rv; t *= 2) {
+    if (t > maxthr) {
+      t = maxthr;
+    }
+    for (s = MIN_REQ; (s <= maxreq) && (0 == rv); s *= 8) {
+      rv = run_point(ctx, api, mode, t, s, ms);
+    }
+    if (t == maxthr) {
+      break;
+    }
+  }
+  return rv;
+}
+
+/*! @brief Print the pool lock waits, ICC_RNG_STATS */
+static void pool_waits(ICC_CTX *ctx)
+{
+  ICC_STATUS status;
+  ICC_RNG_STAT *st = NULL;
+  unsigned long long n[5], ns[5];
+  int slots[5];
+  int i = 0;
+
+  memset(&status, 0, sizeof(status));
+  memset(n, 0, sizeof(n));
+  memset(ns, 0, sizeof(ns));
+  memset(slots, 0, sizeof(slots));
+  st = (ICC_RNG_STAT *)calloc(1024, sizeof(ICC_RNG_STAT));
+  if (NULL == st) {
+    return;
+  }
+  ICC_GetValue(ctx, &status, ICC_RNG_STATS, st, 1024 * sizeof(ICC_RNG_STAT));
+  for (i = 0; i < 1024; i++) {
+    if ((st[i].pool > 0) && (st[i].pool < 5)) {
+      slots[st[i].pool]++;
+      n[st[i].pool] += st[i].waits;
+      ns[st[i].pool] += st[i].wait_ns;
+    }
+  }
+  printf("\nPool lock waits (ICC_RNG_STATS)\n");
+  printf("  PRNG pool %3d slots %12llu waits %12llu ms\n", slots[ICC_RNG_POOL_PRNG],
+         n[ICC_RNG_POOL_PRNG], ns[ICC_RNG_POOL_PRNG] / 1000000ULL);
+  printf("  seed pool %3d slots %12llu waits %12llu ms\n", slots[ICC_RNG_POOL_SEED],
+         n[ICC_RNG_POOL_SEED], ns[ICC_RNG_POOL_SEED] / 1000000ULL);
+  free(st);
+}
+
+static void usage(const char *me)
+{
+  int i = 0;
+#if !defined(ICCPKG)
+  fprintf(stderr, "Usage: %s pathToICC [-t threads] [-d ms] [-r maxbytes] [-a RAND|SEED|DRBG] [-m mode] [-j]\n", me);
+  fprintf(stderr, "       pathToICC is the path to the ICC libraries passed to ICC_Init()\n");
+#else
+  fprintf(stderr, "Usage: %s [-t threads] [-d ms] [-r maxbytes] [-a RAND|SEED|DRBG] [-m mode] [-j]\n", me);
+#endif
+  fprintf(stderr, "       -t most threads, default %d, the sweep doubles from 1\n", DEF_THREADS);
+  fprintf(stderr, "       -d time per point in ms, default 500\n");
+  fprintf(stderr, "       -r largest request, default %d, the sweep is x8 from %d\n", MAX_REQ, MIN_REQ);
+  fprintf(stderr, "       -a API to test, may be repeated, default all\n");
+  fprintf(stderr, "       -j write iccbench.h JSON records to stdout rather than a table\n");
+  fprintf(stderr, "       -m DRBG mode for -a DRBG, may be repeated, default all of:\n");
+  for (i = 0; NULL != alglist[i]; i++) {
+    fprintf(stderr, "          %s\n", alglist[i]);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  ICC_STATUS stat, *status = &stat;
+  ICC_CTX *ctx = NULL;
+  const char *path = NULL;
+  const char *modes[64];
+  char buf[256];
+  int nmodes = 0;
+  int apis = 0;
+  int maxthr = DEF_THREADS;
+  int maxreq = MAX_REQ;
+  int ms = 500;
+  int rng_n = 0;
+  int i = 1, rv = 0;
+
+#if !defined(ICCPKG)
+  if (argc < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  path = argv[i++];
+#endif
+  for (; i < argc; i++) {
+    if ((0 == strcmp(argv[i], "-t")) && (i + 1 < argc)) {
+      maxthr = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-d")) && (i + 1 < argc)) {
+      ms = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-r")) && (i + 1 < argc)) {
+      maxreq = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-a")) && (i + 1 < argc)) {
+      i++;
+      apis |= (0 == strcmp(argv[i], "RAND")) ? API_RAND :
+              (0 == strcmp(argv[i], "SEED")) ? API_SEED :
+              (0 == strcmp(argv[i], "DRBG")) ? API_DRBG : 0;
+    } else if ((0 == strcmp(argv[i], "-m")) && (i + 1 < argc) && (nmodes < 63)) {
+      modes[nmodes++] = argv[++i];
+    } else if (0 == strcmp(argv[i], "-j")) {
+      json = 1;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((maxthr < 1) || (maxthr > MAX_THREADS) || (ms < 1) ||
+      (maxreq < MIN_REQ) || (maxreq > 64 * MAX_REQ)) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (0 == apis) {
+    apis = API_RAND | API_SEED | API_DRBG;
+  }
+  if (0 == nmodes) {
+    for (nmodes = 0; NULL != alglist[nmodes]; nmodes++) {
+      modes[nmodes] = alglist[nmodes];
+    }
+  }
+
+  memset(status, 0, sizeof(ICC_STATUS));
+  ctx = ICC_Init(status, path);
+  if (NULL == ctx) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    return 1;
+  }
+  ICC_SetValue(ctx, status, ICC_FIPS_APPROVED_MODE, "off");
+  if (ICC_ERROR == ICC_Attach(ctx, status)) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    ICC_Cleanup(ctx, status);
+    return 1;
+  }
+
+  if (json) {
+    iccbench_meta(stdout, ctx, "iccbench_rng");
+  } else {
+    memset(buf, 0, sizeof(buf));
+    ICC_GetValue(ctx, status, ICC_VERSION, buf, sizeof(buf) - 1);
+    printf("ICC %s\n", buf);
+    ICC_GetValue(ctx, status, ICC_RNG_INSTANCES, &rng_n, sizeof(rng_n));
+    printf("ICC_RNG_INSTANCES %d (env %s)\n", rng_n,
+           (NULL != getenv("ICC_RNG_INSTANCES")) ? getenv("ICC_RNG_INSTANCES") : "unset");
+    memset(buf, 0, sizeof(buf));
+    ICC_GetValue(ctx, status, ICC_SEED_GENERATOR, buf, 20);
+    printf("ICC_TRNG %s (env %s)\n", buf, (NULL != getenv("ICC_TRNG")) ? getenv("ICC_TRNG") : "unset");
+    memset(buf, 0, sizeof(buf));
+    ICC_GetValue(ctx, status, ICC_RANDOM_GENERATOR, buf, 20);
+    printf("Default DRBG %s\n\n", buf);
+
+    printf("%-6s %-17s %3s %8s %12s %10s %10s %10s %10s %10s\n", "API", "mode", "thr",
+           "bytes", "ops/s", "MB/s", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns");
+  }
+  if (apis & API_RAND) {
+    rv |= sweep(ctx, API_RAND, NULL, maxthr, maxreq, ms);
+  }
+  if (apis & API_SEED) {
+    rv |= sweep(ctx, API_SEED, NULL, maxthr, maxreq, ms);
+  }
+  if (apis & API_DRBG) {
+    for (i = 0; i < nmodes; i++) {
+      rv |= sweep(ctx, API_DRBG, modes[i], maxthr, maxreq, ms);
+    }
+  }
+  if (!json) {
+    pool_waits(ctx);
+  }
+  ICC_Cleanup(ctx, status);
+  return rv;
+}
@@ -0,0 +1,424 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Entropy source characterization benchmark.
+//
+// The automated form of TRNG/sampler.c and DELTA/Delta_test.c, run on
+// the real library through the SP800-90 API tap points. For each
+// seed source it reports
+//   NOISE_x  raw noise source bytes per second
+//   ETAP_x   health tested entropy bytes per second
+//   TRNG_x   conditioned seed bytes per second
+// with the entropy estimate (SP800_90_GETENTROPY) and the rate of
+// noise buffers discarded by the health tests (SP800_90_GETRETRIES),
+// idle and with threads spinning on every CPU.
+//
+// The tuner is fixed when the library starts, so each ICC_RNG_TUNER
+// value is run in a fresh copy of this program, which also reports the
+// CalcShift() time (ICC_STARTUP_TIMES calibrate) and the shift and loop
+// count the tuner picked. -s and -l set ICC_SHIFT and ICC_LOOPS to check
+// a manual tuning.
+//
+// Run this on a new VM type or hypervisor before trusting TRNG_HW or
+// TRNG_FIPS there: a NOISE rate that collapses under load, an entropy
+// estimate near 50 or a retry rate that climbs under load mean the timer
+// source will starve. TRNG_OS is the fallback.
+//
+// -j writes the iccbench.h records rather than a table, a meta record
+// per tuner and a point per generate call size of CHUNK bytes, with the
+// entropy and retries added, for iccbench_compare.
+//
+// Usage: iccbench_trng pathToICC [-d ms] [-m mode] [-T tuner] [-L threads] [-s shift] [-l loops] [-j]
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#include "icc.h"
+#include "iccbench.h"
+#include "icctimer.h"
+
+/*! The tap points, as GenRndData2's alglist */
+static const char *modes[] = {
+  "NOISE_HW", "ETAP_HW", "TRNG_HW",
+  "NOISE_FIPS", "ETAP_FIPS", "TRNG_FIPS",
+  "NOISE_OS", "ETAP_OS", "TRNG_OS",
+  NULL
+};
+
+#define MAX_LIST 16
+#define MAX_LOAD 256
+#define CHUNK 4096 /*!< Bytes per generate call */
+
+static volatile int spin = 0; /*!< Load threads run while set */
+static int json = 0;          /*!< -j, iccbench.h records rather than a table */
+
+static int ncpus(void)
+{
+#if defined(_WIN32)
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return (int)si.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? (int)n : 1;
+#endif
+}
+
+/*! @brief Set or clear an environment variable for the children
+    @param name the variable
+    @param value the value, NULL to clear it
+*/
+static void set_env(const char *name, const char *value)
+{
+#if defined(_WIN32)
+  char tmp[256];
+  _snprintf(tmp, sizeof(tmp) - 1, "%s=%s", name, (NULL != value) ? value : "");
+  tmp[sizeof(tmp) - 1] = '\0';
+  _putenv(tmp);
+#else
+  if (NULL != value) {
+    setenv(name, value, 1);
+  } else {
+    unsetenv(name);
+  }
+#endif
+}
+
+/*! @brief CPU load thread */
+#if defined(_WIN32)
+static DWORD WINAPI loader(void *arg)
+#else
+static void *loader(void *arg)
+#endif
+{
+  volatile unsigned long x = 0;
+  while (spin) {
+    x++;
+  }
+  return 0;
+}
+
+/*! @brief Start or stop n load threads
+    @param n threads, 0 to stop the ones running
+*/
+static void load(int n)
+{
+#if defined(_WIN32)
+  static HANDLE thr[MAX_LOAD];
+#else
+  static pthread_t thr[MAX_LOAD];
+#endif
+  static int running = 0;
+  int i = 0;
+
+  if (0 == n) {
+    spin = 0;
+    for (i = 0; i < running; i++) {
+#if defined(_WIN32)
+      WaitForSingleObject(thr[i], INFINITE);
+      CloseHandle(thr[i]);
+#else
+      pthread_join(thr[i], NULL);
+#endif
+    }
+    running = 0;
+    return;
+  }
+  spin = 1;
+  for (running = 0; running < n; running++) {
+#if defined(_WIN32)
+    thr[running] = CreateThread(NULL, 0, loader, NULL, 0, NULL);
+    if (NULL == thr[running]) {
+#else
+    if (0 != pthread_create(&thr[running], NULL, loader, NULL)) {
+#endif
+      fprintf(stderr, "Can't create load thread %d\n", running);
+      break;
+    }
+  }
+}
+
+/*! @brief Time one tap point
+    @param ctx ICC context
+    @param mode the tap point
+    @param nload load threads running, for the report
+    @param tuner the tuner, for the report
+    @param ms time to run
+    @return 0 on success
+*/
+static int run_mode(ICC_CTX *ctx, const char *mode, int nload, int tuner, int ms)
+{
+  static unsigned char buf[CHUNK];
+  ICC_PRNG *rng = NULL;
+  ICC_PRNG_CTX *rctx = NULL;
+  unsigned long long t0 = 0, t1 = 0, tp = 0, bytes = 0, end = 0;
+  unsigned int ent = 0, retries = 0;
+  double secs = 0.0, sum = 0.0, sum2 = 0.0;
+  char key[64], extra[64];
+  int rv = 1;
+
+  sprintf(key, "%.20s/L%d/T%d", mode, nload, tuner);
+  rng = ICC_get_RNGbyname(ctx, mode);
+  if (NULL == rng) {
+    if (!json) {
+      printf("%-10s %4d  not available\n", mode, nload);
+    }
+    return 0;
+  }
+  rctx = ICC_RNG_CTX_new(ctx);
+  if ((NULL != rctx) && (SP800_90RUN == ICC_RNG_CTX_Init(ctx, rctx, rng, NULL, 0, 0, 0))) {
+    t0 = tp = now_ns();
+    end = t0 + (unsigned long long)ms * 1000000ULL;
+    do {
+      if (SP800_90RUN != ICC_RNG_Generate(ctx, rctx, buf, CHUNK, NULL, 0)) {
+        break;
+      }
+      bytes += CHUNK;
+      t1 = now_ns();
+      sum += (double)(t1 - tp);
+      sum2 += (double)(t1 - tp) * (double)(t1 - tp);
+      tp = t1;
+    } while (t1 < end);
+    ICC_RNG_CTX_ctrl(ctx, rctx, SP800_90_GETENTROPY, 0, &ent);
+    ICC_RNG_CTX_ctrl(ctx, rctx, SP800_90_GETRETRIES, 0, &retries);
+    if (json) {
+      secs = (double)(t1 - t0) / 1.0e9;
+      sprintf(extra, "\"entropy\":%u,\"retries\":%u", ent, retries);
+      iccbench_point(stdout, "iccbench_trng", key, (t1 >= end) ? bytes / CHUNK : 0, sum, sum2, NULL,
+                     (double)(bytes / CHUNK) / secs, (double)bytes / secs / 1.0e6, extra);
+      rv = (t1 >= end) ? 0 : 1;
+    } else if (t1 >= end) {
+      secs = (double)(t1 - t0) / 1.0e9;
+      printf("%-10s %4d %12.0f %10u %10u %12.2f\n", mode, nload, (double)bytes / secs, ent,
+             retries, (double)retries * 1048576.0 / (double)bytes);
+      rv = 0;
+    } else {
+      printf("%-10s %4d  failed after %llu bytes, entropy %u, retries %u\n", mode, nload, bytes,
+             ent, retries);
+    }
+  } else if (json) {
+    iccbench_point(stdout, "iccbench_trng", key, 0, 0.0, 0.0, NULL, 0.0, -1.0, NULL);
+  } else {
+    printf("%-10s %4d  failed to instantiate\n", mode, nload);
+  }
+  if (NULL != rctx) {
+    ICC_RNG_CTX_free(ctx, rctx);
+  }
+  fflush(stdout);
+  return rv;
+}
+
+/*! @brief One tuner, in it's own process as the tuner is set at startup
+    @return 0 on success
+*/
+static int child(const char *path, const char **mlist, int nmodes, const int *loads, int nloads, int ms)
+{
+  ICC_STATUS stat, *status = &stat;
+  ICC_CTX *ctx = NULL;
+  ICC_STARTUP_TIMING st;
+  char buf[256];
+  int tuner = -1, shift = -1, loops = -1;
+  int i = 0, j = 0, rv = 0;
+
+  memset(status, 0, sizeof(ICC_STATUS));
+  ctx = ICC_Init(status, path);
+  if (NULL == ctx) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    return 1;
+  }
+  /* The tap points aren't available in FIPS mode */
+  ICC_SetValue(ctx, status, ICC_FIPS_APPROVED_MODE, "off");
+  if (ICC_ERROR == ICC_Attach(ctx, status)) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    ICC_Cleanup(ctx, status);
+    return 1;
+  }
+  memset(&st, 0, sizeof(st));
+  ICC_GetValue(ctx, status, ICC_STARTUP_TIMES, &st, sizeof(st));
+  ICC_GetValue(ctx, status, ICC_RNG_TUNER, &tuner, sizeof(tuner));
+  ICC_GetValue(ctx, status, ICC_SHIFT, &shift, sizeof(shift));
+  ICC_GetValue(ctx, status, ICC_LOOPS, &loops, sizeof(loops));
+  if (json) {
+    iccbench_meta(stdout, ctx, "iccbench_trng");
+  } else {
+    memset(buf, 0, sizeof(buf));
+    ICC_GetValue(ctx, status, ICC_SEED_GENERATOR, buf, 20);
+    printf("\nICC_RNG_TUNER %d, ICC_SHIFT %d, ICC_LOOPS %d, CalcShift %llu us, ICC_TRNG %s\n",
+           tuner, shift, loops, st.calibrate, buf);
+    printf("%-10s %4s %12s %10s %10s %12s\n", "mode", "load", "bytes/s", "entropy", "retries", "retries/MB");
+  }
+  for (j = 0; j < nloads; j++) {
+    if (loads[j] > 0) {
+      load(loads[j]);
+    }
+    for (i = 0; i < nmodes; i++) {
+      rv |= run_mode(ctx, mlist[i], loads[j], tuner, ms);
+    }
+    load(0);
+  }
+  ICC_Cleanup(ctx, status);
+  return rv;
+}
+
+/*! @brief Run this program again with the same arguments and -child
+    @return the child's exit status, 0 on success
+*/
+static int spawn(char **argv)
+{
+#if defined(_WIN32)
+  fflush(stdout);
+  return (int)_spawnvp(_P_WAIT, argv[0], (const char *const *)argv);
+#else
+  int st = 0;
+  pid_t pid = -1;
+
+  fflush(stdout);
+  pid = fork();
+  if (0 == pid) {
+    execvp(argv[0], argv);
+    _exit(127);
+  }
+  if ((pid < 0) || (pid != waitpid(pid, &st, 0))) {
+    return 1;
+  }
+  return (WIFEXITED(st) && (0 == WEXITSTATUS(st))) ? 0 : 1;
+#endif
+}
+
+static void usage(const char *me)
+{
+  int i = 0;
+#if !defined(ICCPKG)
+  fprintf(stderr, "Usage: %s pathToICC [-d ms] [-m mode] [-T tuner] [-L threads] [-s shift] [-l loops] [-j]\n", me);
+  fprintf(stderr, "       pathToICC is the path to the ICC libraries passed to ICC_Init()\n");
+#else
+  fprintf(stderr, "Usage: %s [-d ms] [-m mode] [-T tuner] [-L threads] [-s shift] [-l loops] [-j]\n", me);
+#endif
+  fprintf(stderr, "       -d time per point in ms, default 1000\n");
+  fprintf(stderr, "       -T ICC_RNG_TUNER value, may be repeated, default 0 1 2\n");
+  fprintf(stderr, "       -L load threads, may be repeated, default 0 and one per CPU (%d)\n", ncpus());
+  fprintf(stderr, "       -s ICC_SHIFT, -l ICC_LOOPS, manual tuning, default auto\n");
+  fprintf(stderr, "       -j write iccbench.h JSON records to stdout rather than a table\n");
+  fprintf(stderr, "       -m tap point, may be repeated, default all of:\n");
+  for (i = 0; NULL != modes[i]; i++) {
+    fprintf(stderr, "          %s\n", modes[i]);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  const char *path = NULL;
+  const char *mlist[MAX_LIST];
+  const char *shift = NULL;
+  const char *loops = NULL;
+  char **cargv = NULL;
+  char tun[16];
+  int tuners[MAX_LIST];
+  int loads[MAX_LIST];
+  int nmodes = 0, ntuners = 0, nloads = 0;
+  int childmode = 0;
+  int ms = 1000;
+  int i = 1, n = 0, rv = 0;
+
+  if ((argc > 1) && (0 == strcmp(argv[1], "-child"))) {
+    childmode = 1;
+    i++;
+  }
+#if !defined(ICCPKG)
+  if (argc < i + 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  path = argv[i++];
+#endif
+  for (; i < argc; i++) {
+    if ((0 == strcmp(argv[i], "-d")) && (i + 1 < argc)) {
+      ms = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-m")) && (i + 1 < argc) && (nmodes < MAX_LIST)) {
+      mlist[nmodes++] = argv[++i];
+    } else if ((0 == strcmp(argv[i], "-T")) && (i + 1 < argc) && (ntuners < MAX_LIST)) {
+      tuners[ntuners++] = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-L")) && (i + 1 < argc) && (nloads < MAX_LIST)) {
+      loads[nloads++] = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-s")) && (i + 1 < argc)) {
+      shift = argv[++i];
+    } else if ((0 == strcmp(argv[i], "-l")) && (i + 1 < argc)) {
+      loops = argv[++i];
+    } else if (0 == strcmp(argv[i], "-j")) {
+      json = 1;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  for (i = 0; i < nloads; i++) {
+    if ((loads[i] < 0) || (loads[i] > MAX_LOAD)) {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (ms < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (0 == nmodes) {
+    for (nmodes = 0; NULL != modes[nmodes]; nmodes++) {
+      mlist[nmodes] = modes[nmodes];
+    }
+  }
+  if (0 == nloads) {
+    loads[nloads++] = 0;
+    loads[nloads++] = (ncpus() < MAX_LOAD) ? ncpus() : MAX_LOAD;
+  }
+  if (childmode) {
+    return child(path, mlist, nmodes, loads, nloads, ms);
+  }
+
+  if (0 == ntuners) {
+    for (ntuners = 0; ntuners < 3; ntuners++) {
+      tuners[ntuners] = ntuners;
+    }
+  }
+  set_env("ICC_SHIFT", shift);
+  set_env("ICC_LOOPS", loops);
+  /* The children get everything but the tuners, which come from the environment */
+  cargv = (char **)calloc(argc + 2, sizeof(char *));
+  if (NULL == cargv) {
+    return 1;
+  }
+  cargv[n++] = argv[0];
+  cargv[n++] = (char *)"-child";
+  for (i = 1; i < argc; i++) {
+    if ((0 == strcmp(argv[i], "-T")) && (i + 1 < argc)) {
+      i++;
+    } else {
+      cargv[n++] = argv[i];
+    }
+  }
+  cargv[n] = NULL;
+  for (i = 0; i < ntuners; i++) {
+    sprintf(tun, "%d", tuners[i]);
+    set_env("ICC_RNG_TUNER", tun);
+    rv |= spawn(cargv);
+  }
+  free(cargv);
+  return rv;
+}
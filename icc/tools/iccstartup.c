@@ -0,0 +1,322 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Startup latency benchmark.
+//
+// Runs itself repeatedly as a fresh child process and times each phase
+// of getting to the first crypto operation:
+//   load    exec, dynamic linking and process exit, i.e. the wall time
+//           of the child less the phases it timed itself
+//   init    ICC_Init(), which loads the crypto library
+//   attach  ICC_SetValue(ICC_FIPS_APPROVED_MODE) and ICC_Attach()
+//   first   the first SHA-256 digest and ICC_RAND_bytes()
+//   cleanup ICC_Cleanup()
+// for FIPS mode on and off, and with and without ICC_RUN_POST=1
+// (full POST in non-FIPS mode). Built with -DICCPKG it does the same
+// through the iccpkg wrapper, where FIPS on/off selects the C/N tree.
+//
+// Reports min/p50/p90/p99/max and mean in us over the runs per variant,
+// the baseline for startup changes and a regression check for them.
+//
+// Usage: iccstartup pathToICC [-n runs] [-f on|off] [-p 0|1]
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#include "icc.h"
+#include "icctimer.h"
+
+#define PHASES 5
+#define MAX_RUNS 10000
+#define DEF_RUNS 20
+#define CHILD_TAG "ICCSTARTUP"
+
+static const char *phase_names[PHASES] = { "load", "init", "attach", "first", "cleanup" };
+
+/*! @brief Set or clear an environment variable for the children
+    @param name the variable
+    @param value the value, NULL to clear it
+*/
+static void set_env(const char *name, const char *value)
+{
+#if defined(_WIN32)
+  char tmp[256];
+  _snprintf(tmp, sizeof(tmp) - 1, "%s=%s", name, (NULL != value) ? value : "");
+  tmp[sizeof(tmp) - 1] = '\0';
+  _putenv(tmp);
+#else
+  if (NULL != value) {
+    setenv(name, value, 1);
+  } else {
+    unsetenv(name);
+  }
+#endif
+}
+
+/*! @brief The child, time one startup and print the phases
+    @param path the ICC path, may be NULL
+    @param fips "on" or "off"
+    @return 0 on success
+*/
+static int child(const char *path, const char *fips)
+{
+  ICC_STATUS stat, *status = &stat;
+  ICC_CTX *ctx = NULL;
+  ICC_EVP_MD_CTX *md_ctx = NULL;
+  const ICC_EVP_MD *md = NULL;
+  unsigned char buf[64];
+  unsigned int len = 0;
+  unsigned long long t[PHASES];
+  int rv = 0;
+
+  memset(status, 0, sizeof(ICC_STATUS));
+  t[0] = now_ns();
+  ctx = ICC_Init(status, path);
+  t[1] = now_ns();
+  if (NULL == ctx) {
+    fprintf(stderr, "ICC_Init failed [%s]\n", status->desc);
+    return 1;
+  }
+  ICC_SetValue(ctx, status, ICC_FIPS_APPROVED_MODE, fips);
+  if (ICC_ERROR == ICC_Attach(ctx, status)) {
+    fprintf(stderr, "ICC_Attach failed [%s]\n", status->desc);
+    rv = 1;
+  }
+  t[2] = now_ns();
+  if (0 == rv) {
+    md = ICC_EVP_get_digestbyname(ctx, "SHA256");
+    md_ctx = ICC_EVP_MD_CTX_new(ctx);
+    if ((NULL == md) || (NULL == md_ctx)) {
+      rv = 1;
+    } else {
+      ICC_EVP_DigestInit(ctx, md_ctx, md);
+      ICC_EVP_DigestUpdate(ctx, md_ctx, (unsigned char *)CHILD_TAG, sizeof(CHILD_TAG));
+      ICC_EVP_DigestFinal(ctx, md_ctx, buf, &len);
+      if (1 != ICC_RAND_bytes(ctx, buf, 16)) {
+        rv = 1;
+      }
+    }
+    if (NULL != md_ctx) {
+      ICC_EVP_MD_CTX_free(ctx, md_ctx);
+    }
+  }
+  t[3] = now_ns();
+  ICC_Cleanup(ctx, status);
+  t[4] = now_ns();
+  if (0 != rv) {
+    fprintf(stderr, "First crypto operation failed\n");
+    return 1;
+  }
+  /* init attach first cleanup, load is worked out by the parent */
+  printf("%s %llu %llu %llu %llu\n", CHILD_TAG, t[1] - t[0], t[2] - t[1], t[3] - t[2], t[4] - t[3]);
+  fflush(stdout);
+  return 0;
+}
+
+/*! @brief Run one child and collect it's phases
+    @param me this program
+    @param path the ICC path, may be NULL
+    @param fips "on" or "off"
+    @param ph where to return the phases in ns
+    @return 0 on success
+*/
+static int run_child(const char *me, const char *path, const char *fips, unsigned long long *ph)
+{
+  char line[256];
+  unsigned long long t0 = 0, wall = 0;
+  int rv = 1;
+  FILE *f = NULL;
+
+  memset(line, 0, sizeof(line));
+  t0 = now_ns();
+#if defined(_WIN32)
+  {
+    char cmd[1024];
+    _snprintf(cmd, sizeof(cmd) - 1, "\"%s\" -child %s %s", me, fips, (NULL != path) ? path : "");
+    cmd[sizeof(cmd) - 1] = '\0';
+    f = _popen(cmd, "r");
+    if (NULL != f) {
+      if (NULL == fgets(line, sizeof(line) - 1, f)) {
+        line[0] = '\0';
+      }
+      rv = _pclose(f);
+    }
+  }
+#else
+  {
+    int fds[2];
+    int st = 0;
+    pid_t pid = -1;
+    char *argv[5];
+
+    if (0 == pipe(fds)) {
+      pid = fork();
+      if (0 == pid) {
+        close(fds[0]);
+        dup2(fds[1], 1);
+        close(fds[1]);
+        argv[0] = (char *)me;
+        argv[1] = (char *)"-child";
+        argv[2] = (char *)fips;
+        argv[3] = (char *)path;
+        argv[4] = NULL;
+        execvp(me, argv);
+        _exit(127);
+      }
+      close(fds[1]);
+      if (pid > 0) {
+        f = fdopen(fds[0], "r");
+        if ((NULL == f) || (NULL == fgets(line, sizeof(line) - 1, f))) {
+          line[0] = '\0';
+        }
+        waitpid(pid, &st, 0);
+        rv = (WIFEXITED(st) && (0 == WEXITSTATUS(st))) ? 0 : 1;
+      }
+      if (NULL != f) {
+        fclose(f);
+      } else {
+        close(fds[0]);
+      }
+    }
+  }
+#endif
+  wall = now_ns() - t0;
+  if ((0 == rv) && (4 == sscanf(line, CHILD_TAG " %llu %llu %llu %llu", &ph[1], &ph[2], &ph[3], &ph[4]))) {
+    ph[0] = wall - ph[1] - ph[2] - ph[3] - ph[4];
+    return 0;
+  }
+  return 1;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+  unsigned long long x = *(const unsigned long long *)a;
+  unsigned long long y = *(const unsigned long long *)b;
+  return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+/*! @brief Print the distribution of one phase, in us
+    @param name the phase
+    @param v the runs, sorted here
+    @param n the number of runs
+*/
+static void report(const char *name, unsigned long long *v, int n)
+{
+  unsigned long long sum = 0;
+  int i = 0;
+
+  qsort(v, n, sizeof(unsigned long long), cmp_ull);
+  for (i = 0; i < n; i++) {
+    sum += v[i];
+  }
+  printf("  %-8s %10llu %10llu %10llu %10llu %10llu %10llu\n", name, v[0] / 1000,
+         v[n / 2] / 1000, v[(n * 9) / 10] / 1000, v[(n * 99) / 100] / 1000,
+         v[n - 1] / 1000, sum / n / 1000);
+}
+
+/*! @brief Run and report one variant
+    @return 0 on success
+*/
+static int variant(const char *me, const char *path, const char *fips, int post, int runs)
+{
+  static unsigned long long v[PHASES][MAX_RUNS];
+  unsigned long long ph[PHASES];
+  int i = 0, j = 0, ok = 0;
+
+  set_env("ICC_RUN_POST", post ? "1" : NULL);
+  for (i = 0; i < runs; i++) {
+    if (0 == run_child(me, path, fips, ph)) {
+      for (j = 0; j < PHASES; j++) {
+        v[j][ok] = ph[j];
+      }
+      ok++;
+    }
+  }
+  printf("\nFIPS %s, ICC_RUN_POST %s, %d of %d runs\n", fips, post ? "1" : "unset", ok, runs);
+  if (ok > 0) {
+    printf("  %-8s %10s %10s %10s %10s %10s %10s\n", "phase us", "min", "p50", "p90", "p99", "max", "mean");
+    for (j = 0; j < PHASES; j++) {
+      report(phase_names[j], v[j], ok);
+    }
+  }
+  return (ok == runs) ? 0 : 1;
+}
+
+static void usage(const char *me)
+{
+#if !defined(ICCPKG)
+  fprintf(stderr, "Usage: %s pathToICC [-n runs] [-f on|off] [-p 0|1]\n", me);
+  fprintf(stderr, "       pathToICC is the path to the ICC libraries passed to ICC_Init()\n");
+#else
+  fprintf(stderr, "Usage: %s [-n runs] [-f on|off] [-p 0|1]\n", me);
+#endif
+  fprintf(stderr, "       -n fresh processes per variant, default %d\n", DEF_RUNS);
+  fprintf(stderr, "       -f only FIPS mode on or off, default both\n");
+  fprintf(stderr, "       -p only without (0) or with (1) ICC_RUN_POST=1, default both\n");
+}
+
+int main(int argc, char *argv[])
+{
+  const char *path = NULL;
+  const char *fips = NULL;
+  int post = -1;
+  int runs = DEF_RUNS;
+  int i = 1, rv = 0;
+
+  if ((argc >= 3) && (0 == strcmp(argv[1], "-child"))) {
+    return child((argc > 3) ? argv[3] : NULL, argv[2]);
+  }
+#if !defined(ICCPKG)
+  if (argc < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  path = argv[i++];
+#endif
+  for (; i < argc; i++) {
+    if ((0 == strcmp(argv[i], "-n")) && (i + 1 < argc)) {
+      runs = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-f")) && (i + 1 < argc)) {
+      fips = argv[++i];
+    } else if ((0 == strcmp(argv[i], "-p")) && (i + 1 < argc)) {
+      post = atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((runs < 1) || (runs > MAX_RUNS) ||
+      ((NULL != fips) && strcmp(fips, "on") && strcmp(fips, "off"))) {
+    usage(argv[0]);
+    return 1;
+  }
+  if ((NULL == fips) || (0 == strcmp(fips, "off"))) {
+    if (post != 1) {
+      rv |= variant(argv[0], path, "off", 0, runs);
+    }
+    if (post != 0) {
+      rv |= variant(argv[0], path, "off", 1, runs);
+    }
+  }
+  /* ICC_RUN_POST is ignored in FIPS mode, POST always runs */
+  if ((NULL == fips) || (0 == strcmp(fips, "on"))) {
+    rv |= variant(argv[0], path, "on", 0, runs);
+  }
+  return rv;
+}
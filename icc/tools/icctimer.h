@@ -0,0 +1,42 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: The monotonic ns clock the timing tools share,
+//              iccbench_* and iccstartup.
+//
+*************************************************************************/
+
+#if !defined(ICCTIMER_H)
+#define ICCTIMER_H
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/*! @brief A monotonic time in ns */
+static unsigned long long now_ns(void)
+{
+#if defined(_WIN32)
+  static LARGE_INTEGER f;
+  LARGE_INTEGER c;
+  if (0 == f.QuadPart) {
+    QueryPerformanceFrequency(&f);
+  }
+  QueryPerformanceCounter(&c);
+  return (unsigned long long)((double)c.QuadPart * 1.0e9 / (double)f.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+#endif
@@ -9,6 +9,14 @@
 /*************************************************************************
 // Description: sha256sum with ICC specific bonus (parse ICCSIG.txt, check lib)
 //
+// Given more than one file, a directory or options it runs in batch
+// mode: every file under the paths is hashed, memory mapped, by a pool
+// of threads, then each ICCSIG.txt found is checked against the library
+// next to it as for a single ICCSIG.txt and one report is written, in
+// path order so that reports can be diffed.
+//
+// Usage: sha256x file
+//        sha256x [-t threads] [-o report] path [path ...]
 *************************************************************************/
 
 
@@ -62,12 +70,21 @@ Equivalent environment variable (none)
 */
 #include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #if defined(_WIN32)
 #include <windows.h>
 #define off_t long
 #define strdup(x) _strdup(x)
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #endif
 #include "openssl/err.h"
 #include "openssl/evp.h"
@@ -247,6 +264,10 @@ static void usage(char *pname, char *str) {
   printf("\tReplicates sha256sum unless the target is ICCSIG.txt\n");
   printf("\tin which case it parses ICCSIG.txt for the library file name"
          "\tand hash and checks that as well\n");
+  printf("usage:\t %s [-t threads] [-o report] path [path ...]\n", pname);
+  printf("\tHashes every file under the paths in parallel and checks each\n"
+         "\tICCSIG.txt found against its library, writing one report\n"
+         "\tto stdout or the -o file. -t defaults to one thread per CPU\n");
 }
 static char iccsig[] = "ICCSIG.txt";
 
@@ -271,6 +292,458 @@ int sha256sum(char *fname,char lclhash[80])
    }
    return rv;
 }
+
+/* Batch mode, many files hashed concurrently */
+
+#define MAX_THREADS 64
+
+/*! @brief One file to hash */
+typedef struct {
+  char *path;
+  char hash[80];
+  int ok;                      /*!< 1 if hashed */
+} ENTRY;
+
+static ENTRY *entries = NULL;
+static int nentries = 0;
+static int maxentries = 0;
+static int next_entry = 0;     /*!< Next to hash, under lock */
+static const EVP_MD *sha256 = NULL;
+#if defined(_WIN32)
+static CRITICAL_SECTION lock;
+#else
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static int AddEntry(const char *path)
+{
+  ENTRY *tmp = NULL;
+
+  if (nentries == maxentries) {
+    maxentries = (0 == maxentries) ? 1024 : maxentries * 2;
+    tmp = (ENTRY *)realloc(entries, maxentries * sizeof(ENTRY));
+    if (NULL == tmp) {
+      return 0;
+    }
+    entries = tmp;
+  }
+  memset(&entries[nentries], 0, sizeof(ENTRY));
+  entries[nentries].path = strdup(path);
+  if (NULL == entries[nentries].path) {
+    return 0;
+  }
+  nentries++;
+  return 1;
+}
+
+static int IsDir(const char *path)
+{
+#if defined(_WIN32)
+  DWORD a = GetFileAttributesA(path);
+  return (INVALID_FILE_ATTRIBUTES != a) && (a & FILE_ATTRIBUTE_DIRECTORY);
+#else
+  struct stat st;
+  return (0 == stat(path, &st)) && S_ISDIR(st.st_mode);
+#endif
+}
+
+/*! @brief Add a file, or every file under a directory
+  @param path the file or directory
+  @param top 1 for a path from the command line, symbolic links
+  to directories are only followed there, so there are no loops
+  @return 0 if we ran out of memory
+*/
+static int Walk(const char *path, int top)
+{
+  char *sub = NULL;
+  int rv = 1;
+#if defined(_WIN32)
+  WIN32_FIND_DATAA fd;
+  HANDLE h = INVALID_HANDLE_VALUE;
+  DWORD a = GetFileAttributesA(path);
+
+  if ((INVALID_FILE_ATTRIBUTES == a) || !(a & FILE_ATTRIBUTE_DIRECTORY)) {
+    /* Unreadable files are added, to be reported */
+    return AddEntry(path);
+  }
+  if (!top && (a & FILE_ATTRIBUTE_REPARSE_POINT)) {
+    return 1;
+  }
+  sub = (char *)malloc(strlen(path) + MAX_PATH + 3);
+  if (NULL == sub) {
+    return 0;
+  }
+  sprintf(sub, "%s\\*", path);
+  h = FindFirstFileA(sub, &fd);
+  if (INVALID_HANDLE_VALUE != h) {
+    do {
+      if (strcmp(fd.cFileName, ".") && strcmp(fd.cFileName, "..")) {
+        sprintf(sub, "%s%s%s", path, strchr("/\\", path[strlen(path) - 1]) ? "" : "\\", fd.cFileName);
+        rv = Walk(sub, 0);
+      }
+    } while (rv && FindNextFileA(h, &fd));
+    FindClose(h);
+  }
+  free(sub);
+#else
+  struct stat st;
+  struct dirent *de = NULL;
+  DIR *d = NULL;
+
+  if ((top ? stat(path, &st) : lstat(path, &st)) != 0) {
+    return AddEntry(path);
+  }
+  if (S_ISLNK(st.st_mode)) {
+    /* Follow links to files, not to directories */
+    if ((0 == stat(path, &st)) && S_ISREG(st.st_mode)) {
+      return AddEntry(path);
+    }
+    return 1;
+  }
+  if (S_ISREG(st.st_mode)) {
+    return AddEntry(path);
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    return 1;
+  }
+  d = opendir(path);
+  if (NULL == d) {
+    return AddEntry(path);
+  }
+  while (rv && (NULL != (de = readdir(d)))) {
+    if (0 == strcmp(de->d_name, ".") || 0 == strcmp(de->d_name, "..")) {
+      continue;
+    }
+    sub = (char *)malloc(strlen(path) + strlen(de->d_name) + 2);
+    if (NULL == sub) {
+      rv = 0;
+      break;
+    }
+    sprintf(sub, "%s%s%s", path, ('/' == path[strlen(path) - 1]) ? "" : "/", de->d_name);
+    rv = Walk(sub, 0);
+    free(sub);
+  }
+  closedir(d);
+#endif
+  return rv;
+}
+
+/*! @brief Hash a file, memory mapped, safe to call from many threads
+  @param fname the file
+  @param lclhash where to put the hash as hex
+  @return 1 on success
+  @note Falls back to reads where the file can't be mapped, empty
+  files, files too large for the address space, pipes
+*/
+static int HashMapped(const char *fname, char lclhash[80])
+{
+  unsigned char buf[16384];
+  unsigned char hashout[64];
+  unsigned int hlen = 0;
+  EVP_MD_CTX *md_ctx = NULL;
+  int ok = 1;
+  int i = 0;
+#if defined(_WIN32)
+  HANDLE fh = INVALID_HANDLE_VALUE;
+  HANDLE mh = NULL;
+  LARGE_INTEGER sz;
+  void *p = NULL;
+  DWORD n = 0;
+
+  fh = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                   FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (INVALID_HANDLE_VALUE == fh) {
+    return 0;
+  }
+  md_ctx = EVP_MD_CTX_new();
+  if ((NULL == md_ctx) || (1 != EVP_DigestInit(md_ctx, sha256))) {
+    ok = 0;
+  } else {
+    sz.QuadPart = 0;
+    if (GetFileSizeEx(fh, &sz) && (sz.QuadPart > 0) && ((ULONGLONG)sz.QuadPart <= (SIZE_T)-1)) {
+      mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (NULL != mh) {
+        p = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+      }
+    }
+    if (NULL != p) {
+      ok = EVP_DigestUpdate(md_ctx, p, (size_t)sz.QuadPart);
+      UnmapViewOfFile(p);
+    } else {
+      while (ReadFile(fh, buf, sizeof(buf), &n, NULL) && (n > 0)) {
+        EVP_DigestUpdate(md_ctx, buf, n);
+      }
+    }
+    if (NULL != mh) {
+      CloseHandle(mh);
+    }
+  }
+  CloseHandle(fh);
+#else
+  struct stat st;
+  void *p = MAP_FAILED;
+  ssize_t n = 0;
+  int fd = -1;
+
+  fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  md_ctx = EVP_MD_CTX_new();
+  if ((NULL == md_ctx) || (1 != EVP_DigestInit(md_ctx, sha256))) {
+    ok = 0;
+  } else {
+    if ((0 == fstat(fd, &st)) && S_ISREG(st.st_mode) && (st.st_size > 0) &&
+        ((off_t)(size_t)st.st_size == st.st_size)) {
+      p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (MAP_FAILED != p) {
+#if defined(MADV_SEQUENTIAL)
+      madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+      ok = EVP_DigestUpdate(md_ctx, p, (size_t)st.st_size);
+      munmap(p, (size_t)st.st_size);
+    } else {
+      while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        EVP_DigestUpdate(md_ctx, buf, (size_t)n);
+      }
+      if (n < 0) {
+        ok = 0;
+      }
+    }
+  }
+  close(fd);
+#endif
+  if (ok && (1 == EVP_DigestFinal(md_ctx, hashout, &hlen))) {
+    for (i = 0; i < (int)hlen; i++) {
+      sprintf(lclhash + (2 * i), "%02x", (unsigned int)hashout[i]);
+    }
+  } else {
+    ok = 0;
+  }
+  if (NULL != md_ctx) {
+    EVP_MD_CTX_free(md_ctx);
+  }
+  return ok;
+}
+
+/*! @brief Hashing thread, takes files from the list until it's empty */
+#if defined(_WIN32)
+static DWORD WINAPI HashWorker(void *arg)
+#else
+static void *HashWorker(void *arg)
+#endif
+{
+  int i = 0;
+
+  for (;;) {
+#if defined(_WIN32)
+    EnterCriticalSection(&lock);
+    i = next_entry++;
+    LeaveCriticalSection(&lock);
+#else
+    pthread_mutex_lock(&lock);
+    i = next_entry++;
+    pthread_mutex_unlock(&lock);
+#endif
+    if (i >= nentries) {
+      break;
+    }
+    entries[i].ok = HashMapped(entries[i].path, entries[i].hash);
+  }
+  return 0;
+}
+
+static int CmpEntry(const void *a, const void *b)
+{
+  return strcmp(((const ENTRY *)a)->path, ((const ENTRY *)b)->path);
+}
+
+static int NumCPUs(void)
+{
+#if defined(_WIN32)
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return (int)si.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? (int)n : 1;
+#endif
+}
+
+/*! @brief Check an ICCSIG.txt against the library it names
+  @param out the report
+  @param e the ICCSIG.txt
+  @return 0 if it matches, 1 if it doesn't or the library is missing
+*/
+static int CheckSig(FILE *out, ENTRY *e)
+{
+  char lib[NAMELEN];
+  char libhash[80];
+  char sighash[80];
+  char libname[NAMELEN];
+  ENTRY key, *le = NULL;
+  FILE *f = NULL;
+  int rv = 1;
+
+  libname[0] = '\0';
+  sighash[0] = '\0';
+  f = fopen(e->path, "rb");
+  if (NULL != f) {
+    ReadConfigItems(f, libname, sighash);
+    fclose(f);
+  }
+  if ('\0' == libname[0]) {
+    fprintf(out, "ICCSIG %s: no library name, not checked\n", e->path);
+    return 0;
+  }
+  if (strlen(e->path) - strlen(iccsig) + strlen(libname) >= NAMELEN) {
+    fprintf(out, "ICCSIG %s: library path too long\n", e->path);
+    return 1;
+  }
+  strcpy(lib, e->path);
+  strcpy(lib + strlen(lib) - strlen(iccsig), libname);
+  /* Usually the library was under the same path, so is already hashed */
+  key.path = lib;
+  le = (ENTRY *)bsearch(&key, entries, nentries, sizeof(ENTRY), CmpEntry);
+  if (NULL != le) {
+    strcpy(libhash, le->hash);
+    rv = le->ok ? 0 : 1;
+  } else {
+    rv = HashMapped(lib, libhash) ? 0 : 1;
+  }
+  if (0 != rv) {
+    fprintf(out, "ICCSIG %s: could not read %s\n", e->path, lib);
+  } else if (0 != strcmp(libhash, sighash)) {
+    fprintf(out, "ICCSIG %s: hash does NOT match %s\n", e->path, lib);
+    rv = 1;
+  } else {
+    fprintf(out, "ICCSIG %s: hash matches %s\n", e->path, lib);
+  }
+  return rv;
+}
+
+/*! @brief Batch mode
+  @return 0 all OK, 1 an ICCSIG.txt check failed, 2 a file couldn't be read
+*/
+static int Batch(int argc, char *argv[])
+{
+#if defined(_WIN32)
+  HANDLE thr[MAX_THREADS];
+#else
+  pthread_t thr[MAX_THREADS];
+#endif
+  FILE *out = stdout;
+  const char *report = NULL;
+  char tmp[NAMELEN];
+  int nthr = NumCPUs();
+  int started = 0;
+  int unreadable = 0, sigs = 0, bad = 0;
+  int i = 1, rv = 0;
+
+  for (; (i < argc) && ('-' == argv[i][0]); i++) {
+    if ((0 == strcmp(argv[i], "-t")) && (i + 1 < argc)) {
+      nthr = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-o")) && (i + 1 < argc)) {
+      report = argv[++i];
+    } else {
+      break;
+    }
+  }
+  if ((i == argc) || (nthr < 1)) {
+    usage(argv[0], "Need at least one path\n");
+    return 2;
+  }
+  if (nthr > MAX_THREADS) {
+    nthr = MAX_THREADS;
+  }
+  for (; i < argc; i++) {
+    if (!Walk(argv[i], 1)) {
+      fprintf(stderr, "Out of memory\n");
+      return 2;
+    }
+  }
+  if (0 == nentries) {
+    fprintf(stderr, "No files found\n");
+    return 2;
+  }
+  qsort(entries, nentries, sizeof(ENTRY), CmpEntry);
+  if (nthr > nentries) {
+    nthr = nentries;
+  }
+  OPENSSL_init_crypto(OPENSSL_INIT_NO_LOAD_CONFIG | OPENSSL_INIT_ADD_ALL_DIGESTS, NULL);
+  sha256 = EVP_get_digestbyname("SHA256");
+  if (NULL == sha256) {
+    fprintf(stderr, "SHA256 not available\n");
+    return 2;
+  }
+#if defined(_WIN32)
+  InitializeCriticalSection(&lock);
+#endif
+  for (started = 0; started < nthr; started++) {
+#if defined(_WIN32)
+    thr[started] = CreateThread(NULL, 0, HashWorker, NULL, 0, NULL);
+    if (NULL == thr[started]) {
+#else
+    if (0 != pthread_create(&thr[started], NULL, HashWorker, NULL)) {
+#endif
+      break;
+    }
+  }
+  if (0 == started) {
+    /* No threads, do it here */
+    HashWorker(NULL);
+  }
+  for (i = 0; i < started; i++) {
+#if defined(_WIN32)
+    WaitForSingleObject(thr[i], INFINITE);
+    CloseHandle(thr[i]);
+#else
+    pthread_join(thr[i], NULL);
+#endif
+  }
+#if defined(_WIN32)
+  DeleteCriticalSection(&lock);
+#endif
+  if (NULL != report) {
+    out = fopen(report, "w");
+    if (NULL == out) {
+      fprintf(stderr, "Could not open %s\n", report);
+      return 2;
+    }
+  }
+  for (i = 0; i < nentries; i++) {
+    if (entries[i].ok) {
+      fprintf(out, "%s %s\n", entries[i].hash, entries[i].path);
+    } else {
+      fprintf(out, "Could not read %s\n", entries[i].path);
+      unreadable++;
+    }
+  }
+  for (i = 0; i < nentries; i++) {
+    strncpy(tmp, entries[i].path, NAMELEN - 1);
+    tmp[NAMELEN - 1] = '\0';
+    if (entries[i].ok && (0 == strcmp(mybasename(tmp), iccsig))) {
+      sigs++;
+      bad += CheckSig(out, &entries[i]);
+    }
+  }
+  fprintf(out, "%d files, %d unreadable, %d %s checked, %d failed\n", nentries, unreadable,
+          sigs, iccsig, bad);
+  if (stdout != out) {
+    fclose(out);
+  }
+  rv = (bad > 0) ? 1 : (unreadable > 0) ? 2 : 0;
+  for (i = 0; i < nentries; i++) {
+    free(entries[i].path);
+  }
+  free(entries);
+  entries = NULL;
+  nentries = maxentries = 0;
+  OPENSSL_cleanup();
+  return rv;
+}
+
 char tmppath[NAMELEN];
 char filename[NAMELEN];
 
@@ -289,6 +762,9 @@ int main(int argc, char *argv[])
     usage(argv[0], "Insufficient arguments, need filename\n");
     exit(1);
   }
+  if ((argc > 2) || ('-' == argv[1][0]) || IsDir(argv[1])) {
+    return Batch(argc, argv);
+  }
   /* Do sha256 sum unconditionally*/
   if( 0 != sha256sum(argv[1],myhash) ) {
    strncpy(tmppath,argv[1],NAMELEN-1);
@@ -0,0 +1,165 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: decode a binary trace (<application>.<pid>.<tag>.trc)
+// written by the ring buffer tracer in tracer.h into the same layout as
+// the text trace log.
+//
+// Usage: trcdump file.trc [file.trc ...]
+//
+// Events are printed per thread, oldest first. The first column is
+// TRACE_CLOCK() ticks since that thread's first kept event, in ICC that's
+// the cycle counter which may only be 32 bits wide, wraps are undone
+// between consecutive events. Ticks aren't comparable between threads.
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tracer.h"
+
+/*! @brief A string from the trace file */
+typedef struct {
+  unsigned long long addr;
+  char *text;
+} STR;
+
+static STR *strs = NULL;
+static unsigned int nstrs = 0;
+
+/*! @brief The text for an address recorded in an event
+    @param addr the address
+    @return the text, "?" if it wasn't written
+*/
+static const char *lookup(unsigned long long addr)
+{
+  unsigned int i = 0;
+  for (i = 0; i < nstrs; i++) {
+    if (strs[i].addr == addr) {
+      return strs[i].text;
+    }
+  }
+  return "?";
+}
+
+/*! @brief Advance a thread's tick count, allowing for a narrow counter
+    @param prev the previous raw tick
+    @param cur this raw tick
+    @return ticks between them
+*/
+static unsigned long long tick_delta(unsigned long long prev, unsigned long long cur)
+{
+  if ((cur < prev) && (prev <= 0xffffffffULL)) {
+    return cur + 0x100000000ULL - prev;
+  }
+  return cur - prev;
+}
+
+/*! @brief Decode one file
+    @param name the file
+    @return 0 on success
+*/
+static int dump(const char *name)
+{
+  FILE *f = NULL;
+  TRACE_FILE_HDR hdr;
+  TRACE_STR_HDR sh;
+  TRACE_REC ev;
+  unsigned int i = 0;
+  unsigned int tid = 0;
+  unsigned long long prev = 0, ticks = 0;
+  int rv = 1;
+
+  f = fopen(name, "rb");
+  if (NULL == f) {
+    fprintf(stderr, "%s: can't open\n", name);
+    return 1;
+  }
+  if ((1 != fread(&hdr, sizeof(hdr), 1, f)) || (0 != strcmp(hdr.magic, "ICCTRC1")) ||
+      (sizeof(TRACE_REC) != hdr.recsize)) {
+    fprintf(stderr, "%s: not a trace file, or from a different build\n", name);
+    fclose(f);
+    return 1;
+  }
+  hdr.tag[sizeof(hdr.tag) - 1] = '\0';
+  strs = (STR *)calloc(hdr.nstrings + 1, sizeof(STR));
+  for (nstrs = 0; (NULL != strs) && (nstrs < hdr.nstrings); nstrs++) {
+    if (1 != fread(&sh, sizeof(sh), 1, f)) {
+      break;
+    }
+    strs[nstrs].addr = sh.addr;
+    strs[nstrs].text = (char *)calloc(1, sh.len + 1);
+    if ((NULL == strs[nstrs].text) ||
+        (sh.len != fread(strs[nstrs].text, 1, sh.len, f))) {
+      break;
+    }
+  }
+  if (nstrs == hdr.nstrings) {
+    printf("%s: pid %u %s, %u events, %llu ticks in %llu us\n", name, hdr.pid,
+           hdr.tag, hdr.nevents, tick_delta(hdr.tick[0], hdr.tick[1]),
+           hdr.usec[1] - hdr.usec[0]);
+    for (i = 0; i < hdr.nevents; i++) {
+      if (1 != fread(&ev, sizeof(ev), 1, f)) {
+        break;
+      }
+      if (ev.tid != tid) {
+        tid = ev.tid;
+        ticks = 0;
+        prev = ev.tick;
+        printf("--- thread %u\n", tid);
+      }
+      ticks += tick_delta(prev, ev.tick);
+      prev = ev.tick;
+      ev.x[sizeof(ev.x) - 1] = ev.y[sizeof(ev.y) - 1] = '\0';
+      printf("%16llu:%-16s:%-8u:%-1s:%*s", ticks, lookup(ev.file), tid, hdr.tag,
+             (ev.depth < 40) ? ev.depth : 40, "");
+      switch (ev.kind) {
+      case TRC_IN:
+        printf(">%s\n", lookup(ev.func));
+        break;
+      case TRC_OUT:
+        printf("<%s\n", lookup(ev.func));
+        break;
+      case TRC_OUTRC:
+        printf("<%s (%d)\n", lookup(ev.func), ev.rc);
+        break;
+      default:
+        printf("!%s %s %s\n", lookup(ev.func), ev.x, ev.y);
+        break;
+      }
+    }
+    rv = (i == hdr.nevents) ? 0 : 1;
+  }
+  if (0 != rv) {
+    fprintf(stderr, "%s: truncated\n", name);
+  }
+  for (i = 0; (NULL != strs) && (i < hdr.nstrings); i++) {
+    free(strs[i].text);
+  }
+  free(strs);
+  strs = NULL;
+  nstrs = 0;
+  fclose(f);
+  return rv;
+}
+
+int main(int argc, char *argv[])
+{
+  int i = 0;
+  int rv = 0;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file.trc [file.trc ...]\n", argv[0]);
+    return 1;
+  }
+  for (i = 1; i < argc; i++) {
+    rv |= dump(argv[i]);
+  }
+  return rv;
+}
@@ -27,6 +27,53 @@
 extern int TRACE_indent;
 extern FILE *logfile;
 extern unsigned long trace_counter;
+extern int trace_binary;
+
+/* Binary trace event kinds */
+#define TRC_IN    1
+#define TRC_OUT   2
+#define TRC_OUTRC 3
+#define TRC_MARK  4
+
+/*! @brief One binary trace event, fixed size so a ring slot is one store.
+  file and func are the addresses of __FILE__ and __func__, the strings
+  are written once per trace file, MARK() text is copied in, truncated.
+  Decoded by tools/trcdump.c
+*/
+typedef struct TRACE_REC_t {
+  unsigned long long tick;   /*!< TRACE_CLOCK() */
+  unsigned long long file;   /*!< __FILE__ */
+  unsigned long long func;   /*!< __func__ */
+  unsigned int tid;          /*!< Thread, numbered from 1 as threads start tracing */
+  int rc;                    /*!< OUTRC() return code */
+  unsigned char kind;        /*!< TRC_IN .. TRC_MARK */
+  unsigned char depth;       /*!< Call depth on this thread */
+  unsigned char pad[2];
+  char x[28];                /*!< MARK() first argument */
+  char y[32];                /*!< MARK() second argument */
+} TRACE_REC;
+
+/*! @brief Start of a .trc file, followed by the strings then the events */
+typedef struct TRACE_FILE_HDR_t {
+  char magic[8];                /*!< "ICCTRC1" */
+  unsigned int recsize;         /*!< sizeof(TRACE_REC) */
+  unsigned int pid;
+  unsigned int nstrings;        /*!< String records, a TRACE_STR_HDR then the text */
+  unsigned int nevents;         /*!< TRACE_REC's */
+  unsigned long long tick[2];   /*!< TRACE_CLOCK() at TRACE_START() and TRACE_END() */
+  unsigned long long usec[2];   /*!< Wall clock at the same points, calibrates tick */
+  char tag[8];                  /*!< FIPS_TAG */
+} TRACE_FILE_HDR;
+
+/*! @brief One string in a .trc file */
+typedef struct TRACE_STR_HDR_t {
+  unsigned long long addr; /*!< The value in TRACE_REC file or func */
+  unsigned int len;        /*!< Bytes of text that follow, no terminator */
+  unsigned int pad;
+} TRACE_STR_HDR;
+
+void TRACE_EVENT(int kind, const char *file, const char *fn, int rc, const char *x, const char *y);
+
 #if !defined(NON_FIPS_ICC)
 #   define FIPS_TAG "S"
 #else 
@@ -53,11 +100,12 @@ void TRACE_END(const char* fn);
 
 #define TRACE_START_EX(source, application) TRACE_START(source, application, __FILE__)
 #define TRACE_END_EX() TRACE_END(__FILE__)
-#define IN() if(NULL != logfile) { fprintf(logfile,"%-16s:%-16s:%-8d:%-1s:%*s>%s\n",TimeMark(),__FILE__,mypid(),FIPS_TAG,(TRACE_indent < 40) ? TRACE_indent++:40,"",__func__); fflush(logfile);}
-#define OUT() if (NULL != logfile) { fprintf(logfile,"%-16s:%-16s:%-8d:%-1s:%*s<%s\n",TimeMark(),__FILE__,mypid(),FIPS_TAG,((--TRACE_indent) < 40) ? TRACE_indent:40,"",__func__);fflush(logfile);}
+/* The binary ring buffers are checked first, that's the mode meant to be left on */
+#define IN() if(trace_binary) { TRACE_EVENT(TRC_IN,__FILE__,__func__,0,NULL,NULL); } else if(NULL != logfile) { fprintf(logfile,"%-16s:%-16s:%-8d:%-1s:%*s>%s\n",TimeMark(),__FILE__,mypid(),FIPS_TAG,(TRACE_indent < 40) ? TRACE_indent++:40,"",__func__); fflush(logfile);}
+#define OUT() if(trace_binary) { TRACE_EVENT(TRC_OUT,__FILE__,__func__,0,NULL,NULL); } else if (NULL != logfile) { fprintf(logfile,"%-16s:%-16s:%-8d:%-1s:%*s<%s\n",TimeMark(),__FILE__,mypid(),FIPS_TAG,((--TRACE_indent) < 40) ? TRACE_indent:40,"",__func__);fflush(logfile);}
 /* Out with integer return code */
-#define OUTRC(rc) if(NULL != logfile) { fprintf(logfile,"%-16s:%-16s:%-8d:%1s:%*s<%s (%d)\n" ,TimeMark(),__FILE__,mypid(),FIPS_TAG,((--TRACE_indent) < 40) ? TRACE_indent : 40, "", __func__,rc);fflush(logfile);}
-#define MARK(x,y) if(NULL != logfile) { fprintf(logfile,"%-16s:%-16s:%-8d:%-1s:%*s!%s %s %s\n",TimeMark(),__FILE__,mypid(),FIPS_TAG,(TRACE_indent < 40) ? TRACE_indent:40,"",__func__,x,y);fflush(logfile);}
+#define OUTRC(rc) if(trace_binary) { TRACE_EVENT(TRC_OUTRC,__FILE__,__func__,(int)(rc),NULL,NULL); } else if(NULL != logfile) { fprintf(logfile,"%-16s:%-16s:%-8d:%1s:%*s<%s (%d)\n" ,TimeMark(),__FILE__,mypid(),FIPS_TAG,((--TRACE_indent) < 40) ? TRACE_indent : 40, "", __func__,rc);fflush(logfile);}
+#define MARK(x,y) if(trace_binary) { TRACE_EVENT(TRC_MARK,__FILE__,__func__,0,x,y); } else if(NULL != logfile) { fprintf(logfile,"%-16s:%-16s:%-8d:%-1s:%*s!%s %s %s\n",TimeMark(),__FILE__,mypid(),FIPS_TAG,(TRACE_indent < 40) ? TRACE_indent:40,"",__func__,x,y);fflush(logfile);}
 
 /* Include this ONLY in one file which will contain the active tracing code */
 
@@ -186,6 +234,310 @@ pid_t mypid() {
 #endif
 
 
+/*
+  Binary tracing.
+  Enabled instead of the text log if <application>.trc exists where the
+  .log file would be looked for. Each thread records fixed size events 
+  into it's own ring buffer, no locks, no formatting and no I/O, so
+  tracing can stay on in production. The last TRACE_RING_SIZE events per
+  thread are kept and written to <application>.<pid>.<FIPS_TAG>.trc by 
+  TRACE_END(), tools/trcdump.c turns that back into text.
+  A ring is only taken or released when a thread first traces or exits,
+  a ring left by an exited thread is reused by the next new one.
+*/
+#if !defined(TRACE_CLOCK)
+#  define TRACE_CLOCK() trace_usec()
+#endif
+
+#define TRACE_RING_SIZE 4096 /*!< Events kept per thread, a power of 2 */
+
+/*! @brief One thread's events */
+typedef struct TRACE_RING_t {
+  TRACE_REC ev[TRACE_RING_SIZE];
+  unsigned long long head;    /*!< Events written, only the owner writes */
+  int depth;                  /*!< Owner's call depth */
+  unsigned int tid;           /*!< Owner, a new number each time the ring is taken */
+  int idle;                   /*!< Owner exited, reusable, under trace_mtx */
+  struct TRACE_RING_t *next;  /*!< All rings */
+} TRACE_RING;
+
+int trace_binary = 0;
+static TRACE_RING *trace_rings = NULL;
+static unsigned int trace_tids = 0;
+static char trace_path[1024];
+static unsigned long long trace_tick0 = 0;
+static unsigned long long trace_usec0 = 0;
+
+#if defined(_WIN32)
+static CRITICAL_SECTION trace_mtx;
+static DWORD trace_key = FLS_OUT_OF_INDEXES;
+#  define TRACE_LOCK() EnterCriticalSection(&trace_mtx)
+#  define TRACE_UNLOCK() LeaveCriticalSection(&trace_mtx)
+#  define TRACE_GET() ((TRACE_RING *)FlsGetValue(trace_key))
+#  define TRACE_SET(r) FlsSetValue(trace_key, (r))
+
+static unsigned long long trace_usec(void)
+{
+  FILETIME ft;
+  GetSystemTimeAsFileTime(&ft);
+  return ((((unsigned long long)ft.dwHighDateTime) << 32) | ft.dwLowDateTime) / 10;
+}
+#else
+#  include <pthread.h>
+#  include <sys/time.h>
+static pthread_mutex_t trace_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t trace_key;
+#  define TRACE_LOCK() pthread_mutex_lock(&trace_mtx)
+#  define TRACE_UNLOCK() pthread_mutex_unlock(&trace_mtx)
+#  define TRACE_GET() ((TRACE_RING *)pthread_getspecific(trace_key))
+#  define TRACE_SET(r) pthread_setspecific(trace_key, (r))
+
+static unsigned long long trace_usec(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return ((unsigned long long)tv.tv_sec) * 1000000ULL + tv.tv_usec;
+}
+#endif
+
+/*! @brief Thread exit, the ring (and it's events) stay for the dump
+    @param ptr the thread's ring
+*/
+#if defined(_WIN32)
+static VOID WINAPI trace_thread_exit(PVOID ptr)
+#else
+static void trace_thread_exit(void *ptr)
+#endif
+{
+  TRACE_RING *r = (TRACE_RING *)ptr;
+  if (NULL != r) {
+    TRACE_LOCK();
+    r->idle = 1;
+    TRACE_UNLOCK();
+  }
+}
+
+/*! @brief The calling thread's ring, reuses an idle one or creates one
+    @return the ring or NULL
+*/
+static TRACE_RING *trace_ring(void)
+{
+  TRACE_RING *r = TRACE_GET();
+
+  if ((NULL == r) && trace_binary) {
+    TRACE_LOCK();
+    for (r = trace_rings; (NULL != r) && !r->idle; r = r->next) {
+      ;
+    }
+    if (NULL == r) {
+      r = (TRACE_RING *)calloc(1, sizeof(TRACE_RING));
+      if (NULL != r) {
+        r->next = trace_rings;
+        trace_rings = r;
+      }
+    }
+    if (NULL != r) {
+      r->idle = 0;
+      r->depth = 0;
+      r->tid = ++trace_tids;
+    }
+    TRACE_UNLOCK();
+    if (NULL != r) {
+      TRACE_SET(r);
+    }
+  }
+  return r;
+}
+
+/*! @brief Copy MARK() text into an event, truncated
+    @param dst the event field
+    @param n sizeof the field
+    @param src the text, may be NULL
+*/
+static void trace_copy(char *dst, size_t n, const char *src)
+{
+  size_t i = 0;
+  if (NULL != src) {
+    for (i = 0; (i < n - 1) && ('\0' != src[i]); i++) {
+      dst[i] = src[i];
+    }
+  }
+  dst[i] = '\0';
+}
+
+/*! @brief Record one event in this thread's ring, called by IN(), OUT(),
+    OUTRC() and MARK() in binary mode
+    @param kind TRC_IN .. TRC_MARK
+    @param file __FILE__
+    @param fn __func__
+    @param rc return code for TRC_OUTRC
+    @param x MARK() first argument
+    @param y MARK() second argument
+*/
+void TRACE_EVENT(int kind, const char *file, const char *fn, int rc, const char *x, const char *y)
+{
+  TRACE_RING *r = trace_ring();
+  TRACE_REC *e = NULL;
+
+  if (NULL == r) {
+    return;
+  }
+  if (((TRC_OUT == kind) || (TRC_OUTRC == kind)) && (r->depth > 0)) {
+    r->depth--;
+  }
+  e = &(r->ev[r->head & (TRACE_RING_SIZE - 1)]);
+  e->tick = TRACE_CLOCK();
+  e->file = (unsigned long long)(size_t)file;
+  e->func = (unsigned long long)(size_t)fn;
+  e->tid = r->tid;
+  e->rc = rc;
+  e->kind = (unsigned char)kind;
+  e->depth = (unsigned char)((r->depth < 255) ? r->depth : 255);
+  e->x[0] = e->y[0] = '\0';
+  if (TRC_MARK == kind) {
+    trace_copy(e->x, sizeof(e->x), x);
+    trace_copy(e->y, sizeof(e->y), y);
+  }
+  if (TRC_IN == kind) {
+    r->depth++;
+  }
+  r->head++;
+}
+
+#define TRACE_STRS 8192 /*!< Distinct __FILE__/__func__ addresses written, a power of 2 */
+
+/*! @brief Add an address to the dump's string set
+    @param set the set
+    @param addr the address
+    @return 1 if it was new
+*/
+static int trace_str_add(unsigned long long *set, unsigned long long addr)
+{
+  size_t i = (size_t)((addr >> 3) * 2654435761u) & (TRACE_STRS - 1);
+  size_t n = 0;
+
+  for (n = 0; (0 != addr) && (n < TRACE_STRS); n++, i = (i + 1) & (TRACE_STRS - 1)) {
+    if (set[i] == addr) {
+      return 0;
+    }
+    if (0 == set[i]) {
+      set[i] = addr;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*! @brief Write every ring to trace_path and release them
+    @note only called from TRACE_END(), events still being written 
+    by other threads at this point may be lost
+*/
+static void trace_dump(void)
+{
+  TRACE_FILE_HDR hdr;
+  TRACE_STR_HDR str;
+  TRACE_RING *r = NULL;
+  unsigned long long *set = NULL;
+  unsigned long long i = 0, n = 0;
+  FILE *f = NULL;
+  size_t k = 0;
+
+  trace_binary = 0;
+  /* Before the rings go, FlsFree() runs trace_thread_exit() for every thread */
+#if defined(_WIN32)
+  FlsFree(trace_key);
+#else
+  pthread_key_delete(trace_key);
+#endif
+  memset(&hdr, 0, sizeof(hdr));
+  strcpy(hdr.magic, "ICCTRC1");
+  hdr.recsize = sizeof(TRACE_REC);
+  hdr.pid = (unsigned int)mypid();
+  hdr.tick[0] = trace_tick0;
+  hdr.tick[1] = TRACE_CLOCK();
+  hdr.usec[0] = trace_usec0;
+  hdr.usec[1] = trace_usec();
+  strncpy(hdr.tag, FIPS_TAG, sizeof(hdr.tag) - 1);
+  set = (unsigned long long *)calloc(TRACE_STRS, sizeof(unsigned long long));
+  TRACE_LOCK();
+  if (NULL != set) {
+    for (r = trace_rings; NULL != r; r = r->next) {
+      n = (r->head < TRACE_RING_SIZE) ? r->head : TRACE_RING_SIZE;
+      hdr.nevents += (unsigned int)n;
+      for (i = 0; i < n; i++) {
+        hdr.nstrings += trace_str_add(set, r->ev[i].file);
+        hdr.nstrings += trace_str_add(set, r->ev[i].func);
+      }
+    }
+    f = fopen(trace_path, "wb");
+  }
+  if (NULL != f) {
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    for (k = 0; k < TRACE_STRS; k++) {
+      if (0 != set[k]) {
+        memset(&str, 0, sizeof(str));
+        str.addr = set[k];
+        str.len = (unsigned int)strlen((const char *)(size_t)set[k]);
+        fwrite(&str, sizeof(str), 1, f);
+        fwrite((const char *)(size_t)set[k], 1, str.len, f);
+      }
+    }
+    /* Each ring oldest first */
+    for (r = trace_rings; NULL != r; r = r->next) {
+      n = (r->head < TRACE_RING_SIZE) ? r->head : TRACE_RING_SIZE;
+      for (i = r->head - n; i < r->head; i++) {
+        fwrite(&(r->ev[i & (TRACE_RING_SIZE - 1)]), sizeof(TRACE_REC), 1, f);
+      }
+    }
+    fclose(f);
+  }
+  while (NULL != trace_rings) {
+    r = trace_rings;
+    trace_rings = r->next;
+    free(r);
+  }
+  TRACE_UNLOCK();
+  if (NULL != set) {
+    free(set);
+  }
+#if defined(_WIN32)
+  DeleteCriticalSection(&trace_mtx);
+#endif
+}
+
+/*! @brief Turn on binary tracing
+    @param path the .trc file that enabled it, the output goes beside it
+    @return 1 if binary tracing started
+*/
+static int trace_binary_start(const char *path)
+{
+  size_t len = strlen(path) - strlen(".trc");
+
+  if (trace_binary || (len + 16 >= sizeof(trace_path))) {
+    return trace_binary;
+  }
+#if defined(_WIN32)
+  InitializeCriticalSection(&trace_mtx);
+  trace_key = FlsAlloc(trace_thread_exit);
+  if (FLS_OUT_OF_INDEXES == trace_key) {
+    DeleteCriticalSection(&trace_mtx);
+    return 0;
+  }
+#else
+  if (0 != pthread_key_create(&trace_key, trace_thread_exit)) {
+    return 0;
+  }
+#endif
+  memcpy(trace_path, path, len);
+  /* Each ICC in the process traces separately, the tag keeps them apart */
+  sprintf(trace_path + len, ".%d.%s.trc", (int)mypid(), FIPS_TAG);
+  trace_tick0 = TRACE_CLOCK();
+  trace_usec0 = trace_usec();
+  trace_binary = 1;
+  return 1;
+}
+
+
 void TRACE_START(const char *source, const char *application, const char *fn)
 {
   FILE *tmpfile = NULL;
@@ -214,6 +566,24 @@ void TRACE_START(const char *source, const char *application, const char *fn)
   if(NULL != path) {
     tmpishere = path;
   }
+  /* <application>.trc selects the binary ring buffers instead of the log */
+  alen = strlen(tmpishere);
+  if((alen > 0) && ((alen + strlen(application) + 6) < sizeof(trc_buffer))) {
+    sprintf(trc_buffer,"%s.trc",application);
+    tmpfile = fopen(trc_buffer,"r");
+    if(NULL == tmpfile) {
+      sprintf(trc_buffer,"%s%s%s.trc",tmpishere,
+              ((tmpishere[alen-1] != '\\') && (tmpishere[alen-1] != '/')) ? "/" : "",
+              application);
+      tmpfile = fopen(trc_buffer,"r");
+    }
+    if(NULL != tmpfile) {
+      fclose(tmpfile);
+      if(trace_binary_start(trc_buffer)) {
+        return;
+      }
+    }
+  }
   /* Try the local dir first */
   strcpy(trc_buffer,trc_abuf);
   tmpfile = fopen(trc_buffer,"r");
@@ -252,6 +622,9 @@ void TRACE_START(const char *source, const char *application, const char *fn)
 void TRACE_END(const char* fn)
 {
   char buffer[256];
+  if(trace_binary) {
+    trace_dump();
+  }
   if(NULL != logfile) {
     TimeStamp(buffer);
     fprintf(logfile,"%-16s:%-16s:%-8d:%1s,%s\n",TimeMark(),fn,mypid(),FIPS_TAG,buffer);
@@ -0,0 +1,429 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*
+  Signature verification result cache, ICC_VERIFY_CACHE.
+
+  Applications verify the same signatures over and over, intermediate
+  CA certificates, signed configuration, token signing keys. With the
+  cache on a signature that verified is remembered and the next verify
+  of the same (public key, digest algorithm, message digest, signature)
+  returns 1 without the public key operation.
+
+  - Only successes are stored, a failure is always verified again.
+  - An entry is a SHA-256 over the DER public key, the digest NID, the
+    RSA padding parameters, the message digest and the signature, each
+    length prefixed, and the time it was stored. Nothing else is kept.
+  - ICC_VERIFY_CACHE=n entries, split over VC_STRIPES stripes each with
+    it's own lock, picked by the entry hash. A stripe is VC_WAYS way set
+    associative, the oldest entry in a set is replaced.
+  - Entries expire ICC_VERIFY_CACHE_TTL seconds after they were stored.
+  - Used by RSA_verify(), ECDSA_verify(), EVP_DigestVerifyFinal() and
+    EVP_DigestVerify() with RSA, RSA-PSS and EC keys.
+  - Off by default. In FIPS mode only used if ICC_VERIFY_CACHE_FIPS=1
+    as well, a cache hit isn't a self tested signature verification.
+  - Hits, misses, stores and evictions are counted per stripe under
+    it's lock, ICC_GetValue(ICC_VERIFY_CACHE_STATS) adds them up.
+*/
+
+#define VC_STRIPES 16      /*!< Locks */
+#define VC_WAYS 4          /*!< Entries per set */
+#define VC_MAX  (1 << 20)  /*!< Largest ICC_VERIFY_CACHE */
+
+/*! @brief One remembered good signature */
+typedef struct {
+  unsigned char h[SHA256_DIGEST_LENGTH]; /*!< Hash of what was verified */
+  unsigned long long t;                  /*!< ICC_GetTimeUS() when stored */
+  int used;                              /*!< 0 empty */
+} VC_ENTRY;
+
+/*! @brief One lock's share of the cache */
+typedef struct {
+  ICC_Mutex mtx;
+  VC_ENTRY *e;               /*!< vc_sets * VC_WAYS entries */
+  ICC_VERIFY_CACHE_COUNTS n; /*!< This stripe's counts, entries unused */
+} VC_STRIPE;
+
+static int verify_cache_size = 0;      /*!< ICC_VERIFY_CACHE, entries, 0 off */
+static int verify_cache_ttl = 300;     /*!< ICC_VERIFY_CACHE_TTL, seconds */
+static int verify_cache_fips = 0;      /*!< ICC_VERIFY_CACHE_FIPS, use it in FIPS mode */
+static int vc_ok = 0;                  /*!< Set up */
+static size_t vc_sets = 0;             /*!< Sets per stripe */
+static VC_STRIPE vc_stripes[VC_STRIPES];
+
+/*! @brief Set the number of entries
+  @param n 0 (off) to VC_MAX, rounded up to a multiple of VC_STRIPES * VC_WAYS
+  @note Only effective before the library is loaded
+*/
+static void SetVerifyCache(int n)
+{
+  if((n >= 0) && (n <= VC_MAX)) {
+    verify_cache_size = n;
+  }
+}
+
+/*! @brief Set the entry lifetime
+  @param n seconds, at least 1
+*/
+static void SetVerifyCacheTTL(int n)
+{
+  if(n >= 1) {
+    verify_cache_ttl = n;
+  }
+}
+
+/*! @brief Allocate the cache, at load */
+static void verify_cache_init(void)
+{
+  int i = 0;
+  int j = 0;
+
+  if(verify_cache_size > 0) {
+    vc_sets = ((size_t)verify_cache_size + (VC_STRIPES * VC_WAYS) - 1) / (VC_STRIPES * VC_WAYS);
+    for(i = 0; i < VC_STRIPES; i++) {
+      memset(&vc_stripes[i].n,0,sizeof(vc_stripes[i].n));
+      vc_stripes[i].e = (VC_ENTRY *)ICC_Calloc(vc_sets * VC_WAYS,sizeof(VC_ENTRY),__FILE__,__LINE__);
+      if((NULL == vc_stripes[i].e) || (0 != ICC_CreateMutex(&vc_stripes[i].mtx))) {
+        if(NULL != vc_stripes[i].e) {
+          ICC_Free(vc_stripes[i].e);
+          vc_stripes[i].e = NULL;
+        }
+        break;
+      }
+    }
+    if(VC_STRIPES == i) {
+      vc_ok = 1;
+    } else {
+      for(j = 0; j < i; j++) {
+        ICC_DestroyMutex(&vc_stripes[j].mtx);
+        ICC_Free(vc_stripes[j].e);
+        vc_stripes[j].e = NULL;
+      }
+    }
+  }
+}
+
+/*! @brief Free the cache, at unload
+    @note no other thread may be using ICC
+*/
+static void verify_cache_final(void)
+{
+  int i = 0;
+
+  if(vc_ok) {
+    vc_ok = 0;
+    for(i = 0; i < VC_STRIPES; i++) {
+      ICC_DestroyMutex(&vc_stripes[i].mtx);
+      ICC_Free(vc_stripes[i].e);
+      vc_stripes[i].e = NULL;
+    }
+  }
+}
+
+/*! @brief Is the cache usable from this context
+  @param pcb the ICC context
+  @return 1 if it is
+*/
+static int vc_use(ICClib *pcb)
+{
+  return vc_ok && (NULL != pcb) &&
+         (!(pcb->flags & ICC_FIPS_FLAG) || verify_cache_fips);
+}
+
+/*! @brief Add a length prefixed field to the entry hash */
+static void vc_field(SHA256_CTX *c,const unsigned char *p,size_t len)
+{
+  unsigned char l[4];
+
+  l[0] = (unsigned char)(len >> 24);
+  l[1] = (unsigned char)(len >> 16);
+  l[2] = (unsigned char)(len >> 8);
+  l[3] = (unsigned char)len;
+  SHA256_Update(c,l,sizeof(l));
+  if(0 != len) {
+    SHA256_Update(c,p,len);
+  }
+}
+
+/*! @brief Compute the entry hash
+  @param h the result
+  @param der the DER public key
+  @param derlen it's length
+  @param params the digest NID, the RSA padding, PSS salt length and MGF1 digest NID
+  @param dgst the message digest
+  @param dlen it's length
+  @param sig the signature
+  @param slen it's length
+*/
+static void vc_hash(unsigned char *h,const unsigned char *der,int derlen,const int params[4],
+                    const unsigned char *dgst,size_t dlen,const unsigned char *sig,size_t slen)
+{
+  SHA256_CTX c;
+  unsigned char p[16];
+  int i = 0;
+
+  for(i = 0; i < 4; i++) {
+    p[4 * i] = (unsigned char)((unsigned int)params[i] >> 24);
+    p[4 * i + 1] = (unsigned char)((unsigned int)params[i] >> 16);
+    p[4 * i + 2] = (unsigned char)((unsigned int)params[i] >> 8);
+    p[4 * i + 3] = (unsigned char)params[i];
+  }
+  SHA256_Init(&c);
+  vc_field(&c,der,(size_t)derlen);
+  vc_field(&c,p,sizeof(p));
+  vc_field(&c,dgst,dlen);
+  vc_field(&c,sig,slen);
+  SHA256_Final(h,&c);
+  OPENSSL_cleanse(&c,sizeof(c));
+}
+
+/*! @brief Find the set an entry hash maps to
+  @param h the entry hash
+  @param set returns the first entry of the set
+  @return the stripe
+*/
+static VC_STRIPE *vc_set(const unsigned char *h,VC_ENTRY **set)
+{
+  VC_STRIPE *s = &vc_stripes[h[0] % VC_STRIPES];
+  size_t i = ((size_t)h[1] << 24) | ((size_t)h[2] << 16) | ((size_t)h[3] << 8) | h[4];
+
+  *set = s->e + ((i % vc_sets) * VC_WAYS);
+  return s;
+}
+
+/*! @brief Look an entry up
+  @param h the entry hash
+  @return 1 if this signature verified within the TTL
+*/
+static int vc_lookup(const unsigned char *h)
+{
+  int rv = 0;
+  int i = 0;
+  VC_STRIPE *s = NULL;
+  VC_ENTRY *set = NULL;
+  unsigned long long now = ICC_GetTimeUS();
+  unsigned long long ttl = (unsigned long long)verify_cache_ttl * 1000000ULL;
+
+  s = vc_set(h,&set);
+  ICC_LockMutex(&s->mtx);
+  for(i = 0; i < VC_WAYS; i++) {
+    if(set[i].used && (0 == memcmp(set[i].h,h,SHA256_DIGEST_LENGTH))) {
+      if((now >= set[i].t) && ((now - set[i].t) < ttl)) {
+        rv = 1;
+      } else {
+        set[i].used = 0;
+      }
+      break;
+    }
+  }
+  if(rv) {
+    s->n.hits++;
+  } else {
+    s->n.misses++;
+  }
+  ICC_UnlockMutex(&s->mtx);
+  return rv;
+}
+
+/*! @brief Remember a good signature
+  @param h the entry hash
+*/
+static void vc_store(const unsigned char *h)
+{
+  int i = 0;
+  int victim = 0;
+  VC_STRIPE *s = NULL;
+  VC_ENTRY *set = NULL;
+
+  s = vc_set(h,&set);
+  ICC_LockMutex(&s->mtx);
+  for(i = 0; i < VC_WAYS; i++) {
+    if(!set[i].used || (0 == memcmp(set[i].h,h,SHA256_DIGEST_LENGTH))) {
+      victim = i;
+      break;
+    }
+    if(set[i].t < set[victim].t) {
+      victim = i;
+    }
+  }
+  if(set[victim].used && (0 != memcmp(set[victim].h,h,SHA256_DIGEST_LENGTH))) {
+    s->n.evicted++;
+  }
+  memcpy(set[victim].h,h,SHA256_DIGEST_LENGTH);
+  set[victim].t = ICC_GetTimeUS();
+  set[victim].used = 1;
+  s->n.stored++;
+  ICC_UnlockMutex(&s->mtx);
+}
+
+/*! @brief Sum the counts, for ICC_GetValue(ICC_VERIFY_CACHE_STATS)
+  @param pcb the ICC context
+  @param stats the result, entries is 0 if this context doesn't use the cache
+*/
+static void vc_stats(ICClib *pcb,ICC_VERIFY_CACHE_COUNTS *stats)
+{
+  int i = 0;
+
+  memset(stats,0,sizeof(ICC_VERIFY_CACHE_COUNTS));
+  if(vc_ok) {
+    for(i = 0; i < VC_STRIPES; i++) {
+      ICC_LockMutex(&vc_stripes[i].mtx);
+      stats->hits += vc_stripes[i].n.hits;
+      stats->misses += vc_stripes[i].n.misses;
+      stats->stored += vc_stripes[i].n.stored;
+      stats->evicted += vc_stripes[i].n.evicted;
+      ICC_UnlockMutex(&vc_stripes[i].mtx);
+    }
+    if(vc_use(pcb)) {
+      stats->entries = (unsigned long long)vc_sets * VC_WAYS * VC_STRIPES;
+    }
+  }
+}
+
+/*! @brief Entry hash for an RSA_verify()/ECDSA_verify() call
+  @param h the result
+  @param rsa the RSA key, or NULL
+  @param eckey the EC key, or NULL
+  @param nid the digest NID
+  @param dgst the message digest
+  @param dlen it's length
+  @param sig the signature
+  @param slen it's length
+  @return 1 if h was set, 0 if the key couldn't be encoded
+*/
+static int vc_key_low(unsigned char *h,RSA *rsa,EC_KEY *eckey,int nid,
+                      const unsigned char *dgst,int dlen,const unsigned char *sig,int slen)
+{
+  int rv = 0;
+  int derlen = 0;
+  unsigned char *der = NULL;
+  int params[4];
+
+  if((NULL == dgst) || (NULL == sig) || (dlen < 0) || (slen < 0)) {
+    return 0;
+  }
+  if(NULL != rsa) {
+    derlen = i2d_RSA_PUBKEY(rsa,&der);
+  } else if(NULL != eckey) {
+    derlen = i2d_EC_PUBKEY(eckey,&der);
+  }
+  if((derlen > 0) && (NULL != der)) {
+    params[0] = nid;
+    params[1] = (NULL != rsa) ? RSA_PKCS1_PADDING : 0;
+    params[2] = 0;
+    params[3] = 0;
+    vc_hash(h,der,derlen,params,dgst,(size_t)dlen,sig,(size_t)slen);
+    rv = 1;
+  }
+  if(NULL != der) {
+    OPENSSL_free(der);
+  }
+  return rv;
+}
+
+/*! @brief Can an EVP digest verify go through the cache
+  @param pcb the ICC context
+  @param ctx the digest context, set up with EVP_DigestVerifyInit()
+  @return 1 for RSA, RSA-PSS and EC keys with a digest, when the cache is usable
+  @note These are the key types EVP_DigestVerify() does as update then final
+*/
+static int vc_use_evp(ICClib *pcb,EVP_MD_CTX *ctx)
+{
+  int rv = 0;
+  EVP_PKEY_CTX *pctx = NULL;
+  EVP_PKEY *pkey = NULL;
+
+  if(vc_use(pcb) && (NULL != ctx) && (NULL != EVP_MD_CTX_md(ctx))) {
+    pctx = EVP_MD_CTX_pkey_ctx(ctx);
+    pkey = (NULL != pctx) ? EVP_PKEY_CTX_get0_pkey(pctx) : NULL;
+    if(NULL != pkey) {
+      switch(EVP_PKEY_base_id(pkey)) {
+      case EVP_PKEY_RSA:
+      case EVP_PKEY_RSA_PSS:
+      case EVP_PKEY_EC:
+        rv = 1;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  return rv;
+}
+
+/*! @brief EVP_DigestVerifyFinal() through the cache
+  @param pcb the ICC context
+  @param ctx the digest context, set up with EVP_DigestVerifyInit()
+  @param sig the signature
+  @param siglen it's length
+  @param rv returns the result if this returns 1
+  @return 1 if the cache handled it, 0 if the caller has to verify
+  @note The digest context isn't finalized, as EVP_DigestVerifyFinal()
+  doesn't finalize it either
+*/
+static int vc_digest_verify(ICClib *pcb,EVP_MD_CTX *ctx,const unsigned char *sig,size_t siglen,int *rv)
+{
+  int done = 0;
+  EVP_PKEY_CTX *pctx = NULL;
+  EVP_PKEY *pkey = NULL;
+  EVP_MD_CTX *tmp = NULL;
+  const EVP_MD *md = NULL;
+  const EVP_MD *mgf1 = NULL;
+  unsigned char dgst[EVP_MAX_MD_SIZE];
+  unsigned int dlen = 0;
+  unsigned char h[SHA256_DIGEST_LENGTH];
+  unsigned char *der = NULL;
+  int derlen = 0;
+  int params[4];
+
+  if((NULL == sig) || !vc_use_evp(pcb,ctx)) {
+    return 0;
+  }
+  pctx = EVP_MD_CTX_pkey_ctx(ctx);
+  md = EVP_MD_CTX_md(ctx);
+  pkey = EVP_PKEY_CTX_get0_pkey(pctx);
+  memset(params,0,sizeof(params));
+  params[0] = EVP_MD_type(md);
+  if(EVP_PKEY_EC != EVP_PKEY_base_id(pkey)) {
+    if(EVP_PKEY_CTX_get_rsa_padding(pctx,&params[1]) <= 0) {
+      return 0;
+    }
+    if(RSA_PKCS1_PSS_PADDING == params[1]) {
+      if((EVP_PKEY_CTX_get_rsa_pss_saltlen(pctx,&params[2]) <= 0) ||
+         (EVP_PKEY_CTX_get_rsa_mgf1_md(pctx,&mgf1) <= 0) || (NULL == mgf1)) {
+        return 0;
+      }
+      params[3] = EVP_MD_type(mgf1);
+    }
+  }
+  tmp = EVP_MD_CTX_new();
+  if((NULL != tmp) && (1 == EVP_MD_CTX_copy_ex(tmp,ctx)) &&
+     (1 == EVP_DigestFinal_ex(tmp,dgst,&dlen))) {
+    derlen = i2d_PUBKEY(pkey,&der);
+    if((derlen > 0) && (NULL != der)) {
+      vc_hash(h,der,derlen,params,dgst,dlen,sig,siglen);
+      if(vc_lookup(h)) {
+        *rv = 1;
+      } else {
+        /* As EVP_DigestVerifyFinal() does for these key types */
+        *rv = EVP_PKEY_verify(pctx,sig,siglen,dgst,dlen);
+        if(1 == *rv) {
+          vc_store(h);
+        }
+      }
+      done = 1;
+    }
+  }
+  if(NULL != der) {
+    OPENSSL_free(der);
+  }
+  if(NULL != tmp) {
+    EVP_MD_CTX_free(tmp);
+  }
+  return done;
+}
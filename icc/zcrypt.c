@@ -0,0 +1,277 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*
+  RSA offload to Crypto Express adapters on Linux on Z, ICC_ZCRYPT.
+
+  CPACF only covers symmetric algorithms and hashes, RSA runs on the
+  general purpose cores. With ICC_ZCRYPT=bits the RSA modular
+  exponentiations for keys of at least that size are sent to the
+  Crypto Express (CEX) adapters through the kernel zcrypt driver,
+  /dev/z90crypt, the same way libica does for clear keys.
+
+  - Private key operations with CRT parameters go through ICARSACRT,
+    public key operations through ICARSAMODEXPO. They're hooked in
+    the default RSA method (rsa_mod_exp and bn_mod_exp), so blinding,
+    padding and every RSA entry point are unchanged.
+  - A CRT result is checked with the public key before it's used, as
+    rsa_ossl_mod_exp() does, a mismatch is recomputed in software.
+  - Anything the adapters can't take, smaller or odd sized keys,
+    unbalanced primes, more than ZCRYPT_MAX_BITS, or a driver error,
+    runs in software. ENODEV (no adapters online) stops further
+    offload attempts.
+  - The ioctl is synchronous, the driver queues and spreads requests
+    from all the calling threads across the online adapters, that's
+    where the concurrency comes from.
+  - Non-FIPS builds, Linux on s390x only. The adapters are outside
+    the module boundary so the FIPS module never offloads.
+*/
+
+#if defined(__linux__) && defined(__s390x__) && (NON_FIPS_ICC == 1)
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#define ZCRYPT_MAX_BITS 4096               /*!< Largest modulus the adapters take */
+#define ZCRYPT_MAX_BYTES (ZCRYPT_MAX_BITS / 8)
+#define ZCRYPT_DEV "/dev/z90crypt"
+
+/* From the kernel's asm/zcrypt.h */
+struct ica_rsa_modexpo {
+  char *inputdata;
+  unsigned int inputdatalength;
+  char *outputdata;
+  unsigned int outputdatalength;
+  char *b_key;
+  char *n_modulus;
+};
+
+struct ica_rsa_modexpo_crt {
+  char *inputdata;
+  unsigned int inputdatalength;
+  char *outputdata;
+  unsigned int outputdatalength;
+  char *bp_key;
+  char *bq_key;
+  char *np_prime;
+  char *nq_prime;
+  char *u_mult_inv;
+};
+
+#define ZCRYPT_IOCTL_MAGIC 'z'
+#define ICARSAMODEXPO _IOC(_IOC_READ | _IOC_WRITE, ZCRYPT_IOCTL_MAGIC, 0x05, 0)
+#define ICARSACRT     _IOC(_IOC_READ | _IOC_WRITE, ZCRYPT_IOCTL_MAGIC, 0x06, 0)
+
+static int zcrypt_bits = 0;  /*!< ICC_ZCRYPT, smallest modulus to offload, 0 off */
+static int zcrypt_fd = -1;   /*!< /dev/z90crypt */
+
+/*! @brief The software implementations, used as the fallback */
+static int (*zcrypt_sw_mod_exp)(BIGNUM *r0, const BIGNUM *I, RSA *rsa, BN_CTX *ctx) = NULL;
+static int (*zcrypt_sw_bn_mod_exp)(BIGNUM *r, const BIGNUM *a, const BIGNUM *p,
+                                   const BIGNUM *m, BN_CTX *ctx, BN_MONT_CTX *m_ctx) = NULL;
+
+/*! @brief Turn offload on or off
+  @param n smallest modulus, bits, to offload, 0 off
+  Opens the zcrypt device the first time, if that fails offload stays off
+*/
+static void SetZcrypt(int n)
+{
+  if((n < 0) || (n > ZCRYPT_MAX_BITS)) {
+    return;
+  }
+  if((n > 0) && (zcrypt_fd < 0)) {
+    zcrypt_fd = open(ZCRYPT_DEV, O_RDWR);
+    if(zcrypt_fd < 0) {
+      MARK("ICC_ZCRYPT, can't open", ZCRYPT_DEV);
+      n = 0;
+    }
+  }
+  zcrypt_bits = n;
+}
+
+/*! @brief Stop offloading after the driver reported no adapters */
+static void zcrypt_error(void)
+{
+  if(ENODEV == errno) {
+    zcrypt_bits = 0;
+  }
+}
+
+/*! @brief Should a modulus of this size go to the adapters
+  @param m the modulus
+  @return the modulus length in bytes, 0 not offloaded
+*/
+static int zcrypt_size(const BIGNUM *m)
+{
+  int bits = BN_num_bits(m);
+
+  if((0 == zcrypt_bits) || (bits < zcrypt_bits) || (bits > ZCRYPT_MAX_BITS) ||
+     !BN_is_odd(m)) {
+    return 0;
+  }
+  return (bits + 7) / 8;
+}
+
+/*! @brief bn_mod_exp hook, r = a^p mod m, the RSA public operation
+  and the result check
+*/
+static int zcrypt_bn_mod_exp(BIGNUM *r, const BIGNUM *a, const BIGNUM *p,
+                             const BIGNUM *m, BN_CTX *ctx, BN_MONT_CTX *m_ctx)
+{
+  struct ica_rsa_modexpo mex;
+  unsigned char buf[4 * ZCRYPT_MAX_BYTES];
+  unsigned char *in = buf;
+  unsigned char *out = buf + ZCRYPT_MAX_BYTES;
+  unsigned char *b = buf + (2 * ZCRYPT_MAX_BYTES);
+  unsigned char *n = buf + (3 * ZCRYPT_MAX_BYTES);
+  int len = 0;
+  int rv = 0;
+
+  len = zcrypt_size(m);
+  if((len > 0) && (BN_ucmp(a,m) < 0) && !BN_is_negative(a) &&
+     (BN_num_bytes(p) <= len) &&
+     (BN_bn2binpad(a,in,len) == len) &&
+     (BN_bn2binpad(p,b,len) == len) &&
+     (BN_bn2binpad(m,n,len) == len)) {
+    memset(&mex,0,sizeof(mex));
+    mex.inputdata = (char *)in;
+    mex.inputdatalength = len;
+    mex.outputdata = (char *)out;
+    mex.outputdatalength = len;
+    mex.b_key = (char *)b;
+    mex.n_modulus = (char *)n;
+    if(0 == ioctl(zcrypt_fd,ICARSAMODEXPO,&mex)) {
+      rv = (NULL != BN_bin2bn(out,len,r));
+    } else {
+      zcrypt_error();
+    }
+    /* p is secret when rsa_ossl_mod_exp() has no CRT parameters */
+    OPENSSL_cleanse(buf,sizeof(buf));
+  }
+  if(!rv) {
+    rv = (*zcrypt_sw_bn_mod_exp)(r,a,p,m,ctx,m_ctx);
+  }
+  return rv;
+}
+
+/*! @brief rsa_mod_exp hook, the RSA private operation with CRT */
+static int zcrypt_rsa_mod_exp(BIGNUM *r0, const BIGNUM *I, RSA *rsa, BN_CTX *ctx)
+{
+  struct ica_rsa_modexpo_crt crt;
+  unsigned char buf[5 * ZCRYPT_MAX_BYTES];
+  const BIGNUM *n = NULL, *e = NULL, *d = NULL;
+  const BIGNUM *p = NULL, *q = NULL;
+  const BIGNUM *dmp1 = NULL, *dmq1 = NULL, *iqmp = NULL;
+  BIGNUM *vrfy = NULL;
+  unsigned char *in = buf;
+  unsigned char *out = NULL;
+  unsigned char *bp = NULL, *bq = NULL, *np = NULL, *nq = NULL, *u = NULL;
+  int len = 0;
+  int plen = 0;
+  int qlen = 0;
+  int rv = 0;
+
+  RSA_get0_key(rsa,&n,&e,&d);
+  RSA_get0_factors(rsa,&p,&q);
+  RSA_get0_crt_params(rsa,&dmp1,&dmq1,&iqmp);
+  if((NULL != n) && (NULL != e) && (NULL != p) && (NULL != q) &&
+     (NULL != dmp1) && (NULL != dmq1) && (NULL != iqmp) &&
+     (0 == RSA_get_multi_prime_extra_count(rsa))) {
+    len = zcrypt_size(n);
+  }
+  /* The p values carry 8 bytes of padding, see libica */
+  qlen = (len + 1) / 2;
+  plen = qlen + 8;
+  if((len > 0) && (BN_ucmp(I,n) < 0) && !BN_is_negative(I) &&
+     (BN_num_bytes(p) <= qlen) && (BN_num_bytes(q) <= qlen) &&
+     (BN_cmp(p,q) > 0)) {
+    out = in + len;
+    bp = out + len;
+    bq = bp + plen;
+    np = bq + qlen;
+    nq = np + plen;
+    u = nq + qlen;
+    if((BN_bn2binpad(I,in,len) == len) &&
+       (BN_bn2binpad(dmp1,bp,plen) == plen) &&
+       (BN_bn2binpad(dmq1,bq,qlen) == qlen) &&
+       (BN_bn2binpad(p,np,plen) == plen) &&
+       (BN_bn2binpad(q,nq,qlen) == qlen) &&
+       (BN_bn2binpad(iqmp,u,plen) == plen)) {
+      memset(&crt,0,sizeof(crt));
+      crt.inputdata = (char *)in;
+      crt.inputdatalength = len;
+      crt.outputdata = (char *)out;
+      crt.outputdatalength = len;
+      crt.bp_key = (char *)bp;
+      crt.bq_key = (char *)bq;
+      crt.np_prime = (char *)np;
+      crt.nq_prime = (char *)nq;
+      crt.u_mult_inv = (char *)u;
+      if(0 == ioctl(zcrypt_fd,ICARSACRT,&crt)) {
+        rv = (NULL != BN_bin2bn(out,len,r0));
+      } else {
+        zcrypt_error();
+      }
+    }
+    OPENSSL_cleanse(buf,sizeof(buf));
+  }
+  /* Check the result with the public key before it's released */
+  if(rv) {
+    BN_CTX_start(ctx);
+    vrfy = BN_CTX_get(ctx);
+    rv = (NULL != vrfy) &&
+         (*zcrypt_sw_bn_mod_exp)(vrfy,r0,e,n,ctx,NULL) &&
+         (0 == BN_cmp(vrfy,I));
+    BN_CTX_end(ctx);
+  }
+  if(!rv) {
+    rv = (*zcrypt_sw_mod_exp)(r0,I,rsa,ctx);
+  }
+  return rv;
+}
+
+/*! @brief Hook the RSA method, the hooks only offload once ICC_ZCRYPT is set
+  @param meth the method being set up as the default
+*/
+static void ZcryptSetMethod(RSA_METHOD *meth)
+{
+  zcrypt_sw_mod_exp = RSA_meth_get_mod_exp(meth);
+  zcrypt_sw_bn_mod_exp = RSA_meth_get_bn_mod_exp(meth);
+  if((NULL != zcrypt_sw_mod_exp) && (NULL != zcrypt_sw_bn_mod_exp)) {
+    RSA_meth_set_mod_exp(meth,zcrypt_rsa_mod_exp);
+    RSA_meth_set_bn_mod_exp(meth,zcrypt_bn_mod_exp);
+  }
+}
+
+/*! @brief Close the zcrypt device, library unload */
+static void ZcryptClose(void)
+{
+  zcrypt_bits = 0;
+  if(zcrypt_fd >= 0) {
+    close(zcrypt_fd);
+    zcrypt_fd = -1;
+  }
+}
+
+#else
+
+static void SetZcrypt(int n)
+{
+}
+
+static void ZcryptSetMethod(RSA_METHOD *meth)
+{
+}
+
+static void ZcryptClose(void)
+{
+}
+
+#endif
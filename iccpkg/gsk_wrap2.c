@@ -100,8 +100,6 @@ static PF_C_GetFL hook;
 
 static int trace_inited = 0; /* This is NOT locked, best effort only */
 static int ref_count = 0; /* This is NOT locked, best effort only */
-static int Ccache_init = 0; /* Status of the FIPS object caches */
-static int Ncache_init = 0; /* Status of the non-FIPS object caches */
 /*! 
   This is actually a GSkit enum and is used to control the loading of the two
   libraries. The value passed in is a pointer to an integer, in that integer
@@ -234,6 +232,7 @@ int ICC_LINKAGE ICC_GetValue(ICC_CTX *pcb,ICC_STATUS* status,ICC_VALUE_IDS_ENUM
       case ICC_INDUCED_FAILURE:
       case ICC_LOOPS:
       case ICC_SHIFT:
+      case ICC_TRNG_FAILOVERS:
 	tmp = sizeof(int);
 	if (valueLength < tmp) {
 	  rv = invalid_status(status);
@@ -452,14 +451,41 @@ const char *gskiccs_Crypto_VersionInfo[] = {
 static int ignore_fips = 0;
 static int env_tested = 0;
 
+/*! @brief Pause or resume allocation profiling in the underlying ICC's
+    @param ctx the wrapper context
+    @param on 0 to pause
+    @return ICC_OK, or ICC_NOT_IMPLEMENTED if neither ICC was loaded 
+    with ICC_MEM_PROFILE set
+*/
+static int MemCheck(ICC_CTX *ctx,int on)
+{
+  ICC_STATUS status;
+
+  memset(&status,0,sizeof(status));
+  ICC_SetValue(ctx,&status,ICC_MEM_PROFILE,&on);
+  return (ICC_OK == status.majRC) ? ICC_OK : ICC_NOT_IMPLEMENTED;
+}
+
+/*! @brief Resume allocation profiling, the counts are returned by
+    ICC_GetValue(ICC_MEM_SITES) 
+    @param ctx the wrapper context
+    @param mode unused
+    @return ICC_OK, or ICC_NOT_IMPLEMENTED if profiling wasn't enabled at load
+*/
 int ICC_MemCheck_start(ICC_CTX *ctx,int mode)
 {
-  return ICC_NOT_IMPLEMENTED;
+  return MemCheck(ctx,1);
 }
 
+/*! @brief Pause allocation profiling, blocks already counted are still 
+    tracked until they are freed
+    @param ctx the wrapper context
+    @param mode unused
+    @return ICC_OK, or ICC_NOT_IMPLEMENTED if profiling wasn't enabled at load
+*/
 int ICC_MemCheck_stop(ICC_CTX *ctx,int mode)
 {
-  return ICC_NOT_IMPLEMENTED;
+  return MemCheck(ctx,0);
 }
 
 static int default_status(ICC_STATUS *status)
@@ -588,6 +614,10 @@ ICC_CTX * ICC_LINKAGE ICC_Init(ICC_STATUS* status,const char* iccpath)
   return (ICC_CTX *)wctx;
 }
 
+/* Called from ICC_Attach(), loads only the tree asked for, the C/ tree if 
+   fips is set, otherwise N/. The other tree is only loaded (and its
+   integrity check and POST run) if this one fails.
+*/
 static void ICC_InitReal(WICC_CTX *wctx, ICC_STATUS *status, int fips) {
   char *tmppath = NULL;
   ICC_STATUS *stat = NULL;
@@ -856,10 +886,7 @@ int ICC_LINKAGE ICC_Attach(ICC_CTX *pcb,ICC_STATUS* status)
       }
 #   if 0      
       if (NULL != wctx->Cctx) {
-        if (0 == Ccache_init) {
-          Ccache_init = 1;
-          init_caches(wctx);
-        }
+        init_caches(wctx); /* Once per tree, name_cache.c */
       }
 #   endif      
 #endif
@@ -875,10 +902,7 @@ int ICC_LINKAGE ICC_Attach(ICC_CTX *pcb,ICC_STATUS* status)
       } 
 #   if 0      
       if (NULL != wctx->Nctx) {
-        if (0 == Ncache_init) {
-          Ncache_init = 1;
-          init_caches(wctx);
-        }
+        init_caches(wctx); /* Once per tree, name_cache.c */
       }
 #   endif           
 #endif
@@ -1029,8 +1053,9 @@ int ICC_LINKAGE ICC_Cleanup(ICC_CTX *pcb,ICC_STATUS *status)
   /* We accept that this won't always work but it avoids a file handle leak in most cases */
   ref_count--;
   if(0 >= ref_count) {
-    Ccache_init = 0;
-    Ncache_init = 0;
+#if 0
+    free_caches();
+#endif
     TRACE_END_EX();
     trace_inited = 0;
     ref_count = 0;
@@ -16,6 +16,39 @@
   variant
 */
 
+/* 
+  One cache per library tree (C, N) shared by every context, the EVP
+  objects belong to the loaded library not the context.
+  The first context to attach builds it, contexts that arrive while
+  that's happening just miss until it's published, so there's no lock
+  on the lookup path.
+  Once published the cache is read only until the last context is
+  cleaned up.
+  Platforms without atomics don't cache.
+*/
+#if defined(__GNUC__) && defined(__GCC_ATOMIC_INT_LOCK_FREE) && (2 == __GCC_ATOMIC_INT_LOCK_FREE)
+#define NC_ATOMICS
+#define NC_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define NC_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define NC_CAS(p, o, n) __atomic_compare_exchange_n((p), &(o), (n), 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)
+#elif defined(_WIN32)
+#define NC_ATOMICS
+#define NC_LOAD(p) InterlockedCompareExchange((LONG volatile *)(p), 0, 0)
+#define NC_STORE(p, v) InterlockedExchange((LONG volatile *)(p), (LONG)(v))
+#define NC_CAS(p, o, n) ((LONG)(o) == InterlockedCompareExchange((LONG volatile *)(p), (LONG)(n), (LONG)(o)))
+#endif
+
+#define NC_EMPTY 0    /*!< Not built */
+#define NC_BUILDING 1 /*!< A context is filling it */
+#define NC_READY 2    /*!< Published, read only */
+
+#if defined(HAVE_C_ICC)
+static volatile int Ccache = NC_EMPTY; /*!< State of the FIPS tree cache */
+#endif
+#if defined(HAVE_N_ICC)
+static volatile int Ncache = NC_EMPTY; /*!< State of the non-FIPS tree cache */
+#endif
+
 /* name->md, Use case insensitive string compare 
   works with either MD or Cipher as the cache objects being manipulated 
   are the same size and contain the same size objects
@@ -42,7 +75,44 @@ static void init_cache(ICC_CTX *ctx,MD_CACHE *dig,int n,NAMEFUNC func)
     qsort(dig,n,sizeof(MD_CACHE),mycmp);
 }
 
-/*! 
+/*! @brief Is a tree's cache published
+    @param state the tree's cache state
+    @return 1 if lookups can use it
+*/
+static int cache_ready(volatile int *state)
+{
+#if defined(NC_ATOMICS)
+  return (NC_READY == NC_LOAD(state)) ? 1 : 0;
+#else
+  return 0;
+#endif
+}
+
+/*! @brief Claim a tree's cache for building, once per load
+    @param state the tree's cache state
+    @return 1 if the caller builds and publishes it
+*/
+static int cache_claim(volatile int *state)
+{
+  int rv = 0;
+#if defined(NC_ATOMICS)
+  int expect = NC_EMPTY;
+  rv = NC_CAS(state, expect, NC_BUILDING) ? 1 : 0;
+#endif
+  return rv;
+}
+
+/*! @brief Publish a tree's cache after cache_claim()
+    @param state the tree's cache state
+*/
+static void cache_publish(volatile int *state)
+{
+#if defined(NC_ATOMICS)
+  NC_STORE(state, NC_READY);
+#endif
+}
+
+/*!
   @brief Lookup a cache entry by name
   @param base of the cache to search
   @param n number of entries in this cache
@@ -51,7 +121,7 @@ static void init_cache(ICC_CTX *ctx,MD_CACHE *dig,int n,NAMEFUNC func)
   @note there's an amount of overloading here.
   @note Returns the cache entry not the cipher/digest objecty so we can check whether it's blacklisted
   before calling the underlying functions
-  @note the caches have to be populated. That's done when we create a context.
+  @note the caller checks cache_ready() first
   */
 static MD_CACHE *cache_lookup(MD_CACHE *base, int n, const char *name) {
   MD_CACHE *tmp = NULL;
@@ -64,30 +134,42 @@ static MD_CACHE *cache_lookup(MD_CACHE *base, int n, const char *name) {
 }
 
 
-/*! @brief Init caches for the current contexts 
+/*! @brief Build the shared caches for the trees this context uses
     @param An ICC context pointer
-    @note this only being called when necessary is dealt with elsewhere in the code
-        but it should be harmless anyway as repeated calls to the sort leave the data in
-        the same place. (FLW)
+    @note Only the first context per tree does any work, the rest
+    see the flag and return
 */
-
-
 static void init_caches(WICC_CTX *wctx) 
 {
 #if defined(HAVE_C_ICC)  
-  if(wctx->Cctx) {
+  if(wctx->Cctx && cache_claim(&Ccache)) {
     init_cache(wctx->Cctx,C_diglist,sizeof(C_diglist)/sizeof(MD_CACHE),(NAMEFUNC)ICCC_EVP_get_digestbyname);
     init_cache(wctx->Cctx,(MD_CACHE *)C_ciplist,sizeof(C_ciplist)/sizeof(MD_CACHE),(NAMEFUNC)ICCC_EVP_get_cipherbyname);
+    cache_publish(&Ccache);
   } 
 #endif
 #if defined(HAVE_N_ICC)  
-  if(wctx->Nctx) {
+  if(wctx->Nctx && cache_claim(&Ncache)) {
     init_cache(wctx->Nctx,N_diglist,sizeof(N_diglist)/sizeof(MD_CACHE),(NAMEFUNC)ICCN_EVP_get_digestbyname);
     init_cache(wctx->Nctx,(MD_CACHE *)N_ciplist,sizeof(N_ciplist)/sizeof(MD_CACHE),(NAMEFUNC)ICCN_EVP_get_cipherbyname);
+    cache_publish(&Ncache);
   } 
 #endif  
 }
 
+/*! @brief Drop the shared caches
+    @note Only when the last context is gone, nothing can be reading them
+*/
+static void free_caches(void)
+{
+#if defined(HAVE_C_ICC)
+  Ccache = NC_EMPTY;
+#endif
+#if defined(HAVE_N_ICC)
+  Ncache = NC_EMPTY;
+#endif
+}
+
 
 
 #if defined(JGSK_WRAP)
@@ -103,7 +185,7 @@ const ICC_EVP_MD * ICC_EVP_get_digestbyname(ICC_CTX *ctx, const char *name)
   MD_CACHE *tmp = NULL;
 #if defined(HAVE_C_ICC)
   if (wctx->Cctx) {
-    tmp = cache_lookup( C_diglist, sizeof(C_diglist) / sizeof(MD_CACHE), name);
+    tmp = cache_ready(&Ccache) ? cache_lookup(C_diglist, sizeof(C_diglist) / sizeof(MD_CACHE), name) : NULL;
     if (NULL != tmp) {
       if (0 == tmp->block) {
         rv = (ICC_EVP_MD *)tmp->md;
@@ -115,7 +197,7 @@ const ICC_EVP_MD * ICC_EVP_get_digestbyname(ICC_CTX *ctx, const char *name)
 #endif
 #if defined(HAVE_N_ICC)
   if (wctx->Nctx) {
-    tmp = cache_lookup(N_diglist, sizeof(N_diglist) / sizeof(MD_CACHE), name);
+    tmp = cache_ready(&Ncache) ? cache_lookup(N_diglist, sizeof(N_diglist) / sizeof(MD_CACHE), name) : NULL;
     if (NULL != tmp) {
       if (0 == tmp->block) {
         rv = tmp->md;
@@ -142,7 +224,7 @@ const ICC_EVP_CIPHER *ICC_EVP_get_cipherbyname(ICC_CTX *ctx, const char *name)
   MD_CACHE *tmp = NULL;
 #if defined(HAVE_C_ICC)  
   if (wctx->Cctx) {
-    tmp = cache_lookup((MD_CACHE *)C_ciplist, sizeof(C_ciplist) / sizeof(CIP_CACHE), name);
+    tmp = cache_ready(&Ccache) ? cache_lookup((MD_CACHE *)C_ciplist, sizeof(C_ciplist) / sizeof(CIP_CACHE), name) : NULL;
     if (NULL != tmp) {
       if (0 == tmp->block) {
         rv = (const ICC_EVP_CIPHER *)tmp->md;
@@ -154,7 +236,7 @@ const ICC_EVP_CIPHER *ICC_EVP_get_cipherbyname(ICC_CTX *ctx, const char *name)
 #endif
 #if defined(HAVE_N_ICC)  
   if (wctx->Nctx) {
-    tmp = cache_lookup((MD_CACHE *)N_ciplist, sizeof(N_ciplist) / sizeof(CIP_CACHE), name);
+    tmp = cache_ready(&Ncache) ? cache_lookup((MD_CACHE *)N_ciplist, sizeof(N_ciplist) / sizeof(CIP_CACHE), name) : NULL;
     if (NULL != tmp) {
       if (0 == tmp->block) {
         rv = (const ICC_EVP_CIPHER *)tmp->md;